@@ -19,6 +19,7 @@ See License.txt for details.
 
 // STL includes
 #include <algorithm>
+#include <atomic>
 #include <string>
 
 #ifdef PLUS_USE_OpenIGTLink
@@ -46,6 +47,23 @@ std::string PlusCommon::GetPlusLibVersionString()
 }
 
 
+namespace
+{
+  std::atomic<bool> PerformanceStatisticsEnabled(false);
+}
+
+//----------------------------------------------------------------------------
+void PlusCommon::SetPerformanceStatisticsEnabled(bool enabled)
+{
+  PerformanceStatisticsEnabled.store(enabled);
+}
+
+//----------------------------------------------------------------------------
+bool PlusCommon::GetPerformanceStatisticsEnabled()
+{
+  return PerformanceStatisticsEnabled.load(std::memory_order_relaxed);
+}
+
 //----------------------------------------------------------------------------
 PlusStatus PlusCommon::WriteToFile(igsioTrackedFrame* frame, const std::string& filename, vtkMatrix4x4* imageToTracker)
 {
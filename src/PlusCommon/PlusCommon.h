@@ -54,6 +54,13 @@ namespace PlusCommon
   vtkPlusCommonExport std::string GetPlusLibVersionString();
 
   vtkPlusCommonExport PlusStatus WriteToFile(igsioTrackedFrame* frame, const std::string& filename, vtkMatrix4x4* imageToTracker);
+
+  /*!
+  Enable or disable measuring performance statistics (buffer lock wait times, message packing times) in the whole process.
+  Disabled by default, then each measurement point only costs a flag check. Can be called from any thread.
+  */
+  vtkPlusCommonExport void SetPerformanceStatisticsEnabled(bool enabled);
+  vtkPlusCommonExport bool GetPerformanceStatisticsEnabled();
   
 #ifdef PLUS_USE_OpenIGTLink
   /*! Convert between ITK and IGTL scalar pixel types */
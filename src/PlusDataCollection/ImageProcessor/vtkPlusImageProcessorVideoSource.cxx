@@ -17,6 +17,23 @@ See License.txt for details.
 #include "vtkIGSIOTransformRepository.h"
 #include "vtksys/SystemTools.hxx"
 
+// STL includes
+#include <chrono>
+
+//----------------------------------------------------------------------------
+
+namespace
+{
+  const int DEFAULT_NUMBER_OF_PROCESSING_THREADS = 1;
+
+  // Frames that are queued, being processed or waiting for an earlier frame, per processing thread.
+  // Further input frames are left in the input buffer until the processing threads catch up.
+  const int MAX_NUMBER_OF_PENDING_FRAMES_PER_THREAD = 4;
+
+  // How often the waiting processing threads check whether they have to stop
+  const int PROCESSING_QUEUE_WAIT_TIMEOUT_MSEC = 100;
+}
+
 //----------------------------------------------------------------------------
 
 vtkStandardNewMacro(vtkPlusImageProcessorVideoSource);
@@ -29,6 +46,11 @@ vtkPlusImageProcessorVideoSource::vtkPlusImageProcessorVideoSource()
   , ProcessingAlgorithmAccessMutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
   , GracePeriodLogLevel(vtkPlusLogger::LOG_LEVEL_DEBUG)
   , ProcessorAlgorithm(NULL)
+  , NumberOfProcessingThreads(DEFAULT_NUMBER_OF_PROCESSING_THREADS)
+  , ProcessingQueueOpen(false)
+  , NextQueuedSequenceNumber(0)
+  , NextInputFrameUid(0)
+  , NextOutputSequenceNumber(0)
 {
   this->MissingInputGracePeriodSec = 2.0;
 
@@ -42,6 +64,11 @@ vtkPlusImageProcessorVideoSource::vtkPlusImageProcessorVideoSource()
 //----------------------------------------------------------------------------
 vtkPlusImageProcessorVideoSource::~vtkPlusImageProcessorVideoSource()
 {
+  // The processing threads use the processors
+  if (!this->ProcessingWorkers.empty())
+  {
+    this->InternalStopRecording();
+  }
   if (this->TransformRepository)
   {
     this->TransformRepository->Delete();
@@ -52,12 +79,58 @@ vtkPlusImageProcessorVideoSource::~vtkPlusImageProcessorVideoSource()
     this->ProcessorAlgorithm->Delete();
     this->ProcessorAlgorithm = NULL;
   }
+  this->ClearProcessorPool();
 }
 
 //----------------------------------------------------------------------------
 void vtkPlusImageProcessorVideoSource::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfProcessingThreads: " << this->NumberOfProcessingThreads << std::endl;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusImageProcessorVideoSource::ClearProcessorPool()
+{
+  for (std::vector<vtkPlusTrackedFrameProcessor*>::iterator it = this->ProcessorPool.begin(); it != this->ProcessorPool.end(); ++it)
+  {
+    (*it)->Delete();
+  }
+  this->ProcessorPool.clear();
+  for (std::vector<vtkIGSIOTransformRepository*>::iterator it = this->ProcessorPoolTransformRepositories.begin(); it != this->ProcessorPoolTransformRepositories.end(); ++it)
+  {
+    (*it)->Delete();
+  }
+  this->ProcessorPoolTransformRepositories.clear();
+}
+
+//----------------------------------------------------------------------------
+vtkPlusTrackedFrameProcessor* vtkPlusImageProcessorVideoSource::CreateProcessor(vtkXMLDataElement* processorElement, vtkIGSIOTransformRepository* transformRepository)
+{
+  const char* processorType = processorElement->GetAttribute("Type");
+
+  // Instantiate processor corresponding to the specified type
+  vtkSmartPointer<vtkPlusBoneEnhancer> boneEnhancer = vtkSmartPointer<vtkPlusBoneEnhancer>::New();
+  vtkSmartPointer<vtkPlusTransverseProcessEnhancer> TransverseProcessEnhancer = vtkSmartPointer<vtkPlusTransverseProcessEnhancer>::New();
+  vtkPlusTrackedFrameProcessor* processor = NULL;
+  if (!(STRCASECMP(boneEnhancer->GetProcessorTypeName(), processorType)))
+  {
+    boneEnhancer->SetTransformRepository(transformRepository);
+    boneEnhancer->ReadConfiguration(processorElement);
+    processor = boneEnhancer;
+  }
+  else if (!(STRCASECMP(TransverseProcessEnhancer->GetProcessorTypeName(), processorType)))
+  {
+    TransverseProcessEnhancer->SetTransformRepository(transformRepository);
+    TransverseProcessEnhancer->ReadConfiguration(processorElement);
+    processor = TransverseProcessEnhancer;
+  }
+  else
+  {
+    return NULL;
+  }
+  processor->Register(this);
+  return processor;
 }
 
 //----------------------------------------------------------------------------
@@ -65,6 +138,12 @@ PlusStatus vtkPlusImageProcessorVideoSource::ReadConfiguration(vtkXMLDataElement
 {
   XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_READING(deviceConfig, rootConfigElement);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(EnableProcessing, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfProcessingThreads, deviceConfig);
+  if (this->NumberOfProcessingThreads < 1)
+  {
+    LOG_WARNING("NumberOfProcessingThreads must be at least 1. Using " << DEFAULT_NUMBER_OF_PROCESSING_THREADS << ".");
+    this->NumberOfProcessingThreads = DEFAULT_NUMBER_OF_PROCESSING_THREADS;
+  }
 
   // Read transform repository configuration
   if (this->TransformRepository->ReadConfiguration(rootConfigElement) != PLUS_SUCCESS)
@@ -79,6 +158,7 @@ PlusStatus vtkPlusImageProcessorVideoSource::ReadConfiguration(vtkXMLDataElement
     this->ProcessorAlgorithm->Delete();
     this->ProcessorAlgorithm = NULL;
   }
+  this->ClearProcessorPool();
   int numberOfNestedElements = deviceConfig->GetNumberOfNestedElements();
   for (int nestedElemIndex = 0; nestedElemIndex < numberOfNestedElements; ++nestedElemIndex)
   {
@@ -104,30 +184,26 @@ PlusStatus vtkPlusImageProcessorVideoSource::ReadConfiguration(vtkXMLDataElement
       return PLUS_FAIL;
     }
 
-    // Instantiate processor corresponding to the specified type
-    vtkSmartPointer<vtkPlusBoneEnhancer> boneEnhancer = vtkSmartPointer<vtkPlusBoneEnhancer>::New();
-    vtkSmartPointer<vtkPlusTransverseProcessEnhancer> TransverseProcessEnhancer = vtkSmartPointer<vtkPlusTransverseProcessEnhancer>::New();
-    if (!(STRCASECMP(boneEnhancer->GetProcessorTypeName(), processorType)))
-    {
-      boneEnhancer->SetTransformRepository(this->TransformRepository);
-      boneEnhancer->ReadConfiguration(processorElement);
-      this->ProcessorAlgorithm = boneEnhancer;
-      this->ProcessorAlgorithm->Register(this);
-      break;                  // If only one processor is allowed per ImageProcessor class, we can break out when we find it.
-    }
-    else if (!(STRCASECMP(TransverseProcessEnhancer->GetProcessorTypeName(), processorType)))
-    {
-      TransverseProcessEnhancer->SetTransformRepository(this->TransformRepository);
-      TransverseProcessEnhancer->ReadConfiguration(processorElement);
-      this->ProcessorAlgorithm = TransverseProcessEnhancer;
-      this->ProcessorAlgorithm->Register(this);
-      break;
-    }
-    else
+    this->ProcessorAlgorithm = this->CreateProcessor(processorElement, this->TransformRepository);
+    if (this->ProcessorAlgorithm == NULL)
     {
       LOG_ERROR("Unknown processor type: " << processorType);
       return PLUS_FAIL;
     }
+
+    // Additional instances for parallel processing, each with its own copy of the transform repository
+    for (int i = 1; i < this->NumberOfProcessingThreads; ++i)
+    {
+      vtkIGSIOTransformRepository* transformRepository = vtkIGSIOTransformRepository::New();
+      this->ProcessorPoolTransformRepositories.push_back(transformRepository);
+      if (transformRepository->ReadConfiguration(rootConfigElement) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to read transform repository configuration");
+        return PLUS_FAIL;
+      }
+      this->ProcessorPool.push_back(this->CreateProcessor(processorElement, transformRepository));
+    }
+    break;                  // If only one processor is allowed per ImageProcessor class, we can break out when we find it.
   }
 
   return PLUS_SUCCESS;
@@ -138,6 +214,10 @@ PlusStatus vtkPlusImageProcessorVideoSource::WriteConfiguration(vtkXMLDataElemen
 {
   XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_WRITING(deviceElement, rootConfig);
   deviceElement->SetAttribute("EnableCapturing", this->EnableProcessing ? "TRUE" : "FALSE");
+  if (this->NumberOfProcessingThreads != DEFAULT_NUMBER_OF_PROCESSING_THREADS)
+  {
+    deviceElement->SetIntAttribute("NumberOfProcessingThreads", this->NumberOfProcessingThreads);
+  }
 
   // Write processor elements
   if (this->ProcessorAlgorithm != NULL)
@@ -235,6 +315,26 @@ PlusStatus vtkPlusImageProcessorVideoSource::InternalUpdate()
       this->LastProcessedInputDataTimestamp = oldestTrackingTimestamp;
     }
   }
+
+  if (this->OutputChannels.empty())
+  {
+    LOG_ERROR("No output channels defined");
+    return PLUS_FAIL;
+  }
+  vtkPlusChannel* outputChannel = this->OutputChannels[0];
+
+  vtkPlusDataSource* aSource(NULL);
+  if (outputChannel->GetVideoSource(aSource) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to retrieve the video source in the image processor device.");
+    return PLUS_FAIL;
+  }
+
+  if (!this->ProcessorPool.empty())
+  {
+    return this->InternalUpdateParallel(outputChannel);
+  }
+
   igsioTrackedFrame trackedFrame;
   if (this->InputChannels[0]->GetTrackedFrame(trackedFrame) != PLUS_SUCCESS)
   {
@@ -245,12 +345,6 @@ PlusStatus vtkPlusImageProcessorVideoSource::InternalUpdate()
 
   LOG_TRACE("Image to be processed: timestamp=" << trackedFrame.GetTimestamp());
 
-  if (this->OutputChannels.empty())
-  {
-    LOG_ERROR("No output channels defined");
-    return PLUS_FAIL;
-  }
-  vtkPlusChannel* outputChannel = this->OutputChannels[0];
   double latestFrameAlreadyAddedTimestamp = 0;
   outputChannel->GetMostRecentTimestamp(latestFrameAlreadyAddedTimestamp);
 
@@ -269,23 +363,262 @@ PlusStatus vtkPlusImageProcessorVideoSource::InternalUpdate()
     return PLUS_FAIL;
   }
 
-  vtkPlusDataSource* aSource(NULL);
-  if (outputChannel->GetVideoSource(aSource) != PLUS_SUCCESS)
+  vtkIGSIOTrackedFrameList* processedFrames = this->ProcessorAlgorithm->GetOutputFrames();
+  if (processedFrames == NULL || processedFrames->GetNumberOfTrackedFrames() < 1)
   {
-    LOG_ERROR("Unable to retrieve the video source in the image processor device.");
+    LOG_ERROR("Failed to retrieve processed frame");
     return PLUS_FAIL;
   }
 
-  PlusStatus status = PLUS_SUCCESS;
+  PlusStatus status = this->AddProcessedFrame(aSource, processedFrames->GetTrackedFrame(0), frameTimestamp);
 
-  vtkIGSIOTrackedFrameList* processedFrames = this->ProcessorAlgorithm->GetOutputFrames();
-  if (processedFrames == NULL || processedFrames->GetNumberOfTrackedFrames() < 1)
+  this->Modified();
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusImageProcessorVideoSource::InternalStartRecording()
+{
+  if (this->ProcessorPool.empty())
   {
-    LOG_ERROR("Failed to retrieve processed frame");
+    // Only the latest frame is processed, in the data capture thread
+    return PLUS_SUCCESS;
+  }
+
+  {
+    std::lock_guard<std::mutex> queueGuard(this->ProcessingQueueMutex);
+    this->ProcessingQueue.clear();
+    this->ProcessingQueueOpen = true;
+  }
+  {
+    std::lock_guard<std::mutex> outputGuard(this->ProcessedFramesMutex);
+    this->ProcessedFrames.clear();
+    this->NextOutputSequenceNumber = 0;
+  }
+  this->NextQueuedSequenceNumber = 0;
+  this->NextInputFrameUid = 0;
+
+  std::vector<vtkPlusTrackedFrameProcessor*> processors;
+  processors.push_back(this->ProcessorAlgorithm);
+  processors.insert(processors.end(), this->ProcessorPool.begin(), this->ProcessorPool.end());
+
+  // All workers are created before the threads are started, as the threads keep a pointer to their worker
+  this->ProcessingWorkers.resize(processors.size());
+  for (unsigned int i = 0; i < processors.size(); ++i)
+  {
+    ProcessingWorker& worker = this->ProcessingWorkers[i];
+    worker.Self = this;
+    worker.Processor = processors[i];
+    worker.Active = std::make_pair(true, true);
+    worker.ThreadId = -1;
+  }
+  for (std::vector<ProcessingWorker>::iterator it = this->ProcessingWorkers.begin(); it != this->ProcessingWorkers.end(); ++it)
+  {
+    it->ThreadId = this->Threader->SpawnThread((vtkThreadFunctionType)&ProcessingThread, &(*it));
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusImageProcessorVideoSource::InternalStopRecording()
+{
+  if (this->ProcessingWorkers.empty())
+  {
+    return PLUS_SUCCESS;
+  }
+
+  {
+    std::lock_guard<std::mutex> queueGuard(this->ProcessingQueueMutex);
+    this->ProcessingQueueOpen = false;
+    for (std::vector<ProcessingWorker>::iterator it = this->ProcessingWorkers.begin(); it != this->ProcessingWorkers.end(); ++it)
+    {
+      it->Active.first = false;
+    }
+  }
+  this->ProcessingQueueChanged.notify_all();
+
+  // The threads process the queued frames before they stop
+  for (std::vector<ProcessingWorker>::iterator it = this->ProcessingWorkers.begin(); it != this->ProcessingWorkers.end(); ++it)
+  {
+    while (it->Active.second)
+    {
+      // Wait until the thread stops
+      vtkIGSIOAccurateTimer::Delay(0.05);
+    }
+  }
+  this->ProcessingWorkers.clear();
+
+  std::lock_guard<std::mutex> outputGuard(this->ProcessedFramesMutex);
+  if (!this->ProcessedFrames.empty())
+  {
+    LOG_ERROR("Processed frames are not added to the output, as an earlier frame is missing. Number of frames: " << this->ProcessedFrames.size() << ". Device ID: " << this->GetDeviceId());
+    this->ProcessedFrames.clear();
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void* vtkPlusImageProcessorVideoSource::ProcessingThread(vtkMultiThreader::ThreadInfo* data)
+{
+  ProcessingWorker* worker = (ProcessingWorker*)(data->UserData);
+  vtkPlusImageProcessorVideoSource* self = worker->Self;
+
+  while (true)
+  {
+    ProcessingJob job;
+    {
+      std::unique_lock<std::mutex> queueLock(self->ProcessingQueueMutex);
+      if (self->ProcessingQueue.empty())
+      {
+        if (!worker->Active.first)
+        {
+          // Stop is requested and all the queued frames are taken
+          break;
+        }
+        self->ProcessingQueueChanged.wait_for(queueLock, std::chrono::milliseconds(PROCESSING_QUEUE_WAIT_TIMEOUT_MSEC));
+        continue;
+      }
+      job = self->ProcessingQueue.front();
+      self->ProcessingQueue.pop_front();
+    }
+
+    worker->Processor->SetInputFrames(job.InputFrames);
+    job.Status = worker->Processor->Update();
+    vtkIGSIOTrackedFrameList* processedFrames = worker->Processor->GetOutputFrames();
+    if (job.Status == PLUS_SUCCESS && processedFrames != NULL && processedFrames->GetNumberOfTrackedFrames() > 0)
+    {
+      job.OutputFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+      job.OutputFrames->AddTrackedFrame(processedFrames->GetTrackedFrame(0), vtkIGSIOTrackedFrameList::ADD_INVALID_FRAME);
+    }
+    worker->Processor->SetInputFrames(NULL);
+
+    // The result is always stored, even if processing failed, so that the later frames are not held back
+    self->AddProcessedFrameInOrder(job);
+  }
+
+  worker->Active.second = false;
+  return NULL;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusImageProcessorVideoSource::InternalUpdateParallel(vtkPlusChannel* outputChannel)
+{
+  vtkPlusDataSource* inputSource(NULL);
+  if (this->InputChannels[0]->GetVideoSource(inputSource) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to retrieve the input video source in the image processor device.");
     return PLUS_FAIL;
   }
 
-  igsioTrackedFrame* processedTrackedFrame = processedFrames->GetTrackedFrame(0);
+  // Frames that are already in the output (e.g., when processing is restarted) are not processed again
+  double latestFrameAlreadyAddedTimestamp = 0;
+  outputChannel->GetMostRecentTimestamp(latestFrameAlreadyAddedTimestamp);
+
+  BufferItemUidType oldestInputFrameUid = inputSource->GetOldestItemUidInBuffer();
+  BufferItemUidType latestInputFrameUid = inputSource->GetLatestItemUidInBuffer();
+  if (this->NextInputFrameUid < oldestInputFrameUid)
+  {
+    if (this->NextInputFrameUid > 0)
+    {
+      LOG_WARNING("Input frames were removed from the buffer before they could be processed. Number of skipped frames: " << oldestInputFrameUid - this->NextInputFrameUid << ". Device ID: " << this->GetDeviceId());
+    }
+    this->NextInputFrameUid = oldestInputFrameUid;
+  }
+
+  const unsigned long maxNumberOfPendingFrames = MAX_NUMBER_OF_PENDING_FRAMES_PER_THREAD * (this->ProcessorPool.size() + 1);
+  PlusStatus status = PLUS_SUCCESS;
+  for (; this->NextInputFrameUid <= latestInputFrameUid; ++this->NextInputFrameUid)
+  {
+    {
+      std::lock_guard<std::mutex> outputGuard(this->ProcessedFramesMutex);
+      if (this->NextQueuedSequenceNumber - this->NextOutputSequenceNumber >= maxNumberOfPendingFrames)
+      {
+        // The processing threads are busy, the remaining frames are queued in a later update
+        break;
+      }
+    }
+
+    double frameTimestamp(0);
+    if (inputSource->GetTimeStamp(this->NextInputFrameUid, frameTimestamp) != ITEM_OK)
+    {
+      LOG_ERROR("Unable to get timestamp of input frame UID: " << this->NextInputFrameUid << ". Device ID: " << this->GetDeviceId());
+      status = PLUS_FAIL;
+      continue;
+    }
+    if (frameTimestamp <= latestFrameAlreadyAddedTimestamp)
+    {
+      continue;
+    }
+
+    igsioTrackedFrame* trackedFrame = new igsioTrackedFrame;
+    if (this->InputChannels[0]->GetTrackedFrame(frameTimestamp, *trackedFrame) != PLUS_SUCCESS)
+    {
+      delete trackedFrame;
+      LOG_ERROR("Error while getting tracked frame at timestamp " << std::fixed << frameTimestamp << ". Device ID: " << this->GetDeviceId());
+      status = PLUS_FAIL;
+      continue;
+    }
+
+    ProcessingJob job;
+    job.Timestamp = frameTimestamp;
+    job.Status = PLUS_FAIL;
+    job.InputFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    job.InputFrames->TakeTrackedFrame(trackedFrame, vtkIGSIOTrackedFrameList::ADD_INVALID_FRAME);
+    {
+      std::lock_guard<std::mutex> queueGuard(this->ProcessingQueueMutex);
+      if (!this->ProcessingQueueOpen)
+      {
+        // Recording is not started or it is being stopped
+        break;
+      }
+      job.SequenceNumber = this->NextQueuedSequenceNumber++;
+      this->ProcessingQueue.push_back(job);
+    }
+    this->ProcessingQueueChanged.notify_one();
+    this->LastProcessedInputDataTimestamp = frameTimestamp;
+  }
+
+  this->Modified();
+  return status;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusImageProcessorVideoSource::AddProcessedFrameInOrder(const ProcessingJob& job)
+{
+  std::lock_guard<std::mutex> outputGuard(this->ProcessedFramesMutex);
+  this->ProcessedFrames[job.SequenceNumber] = job;
+
+  vtkPlusDataSource* aSource(NULL);
+  if (this->OutputChannels[0]->GetVideoSource(aSource) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to retrieve the video source in the image processor device.");
+  }
+
+  // Reorder stage: frames are added in input order, so a frame waits until all earlier frames are processed
+  for (std::map<unsigned long, ProcessingJob>::iterator it = this->ProcessedFrames.find(this->NextOutputSequenceNumber);
+       it != this->ProcessedFrames.end(); it = this->ProcessedFrames.find(this->NextOutputSequenceNumber))
+  {
+    const ProcessingJob& processedJob = it->second;
+    if (processedJob.Status != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to process frame at timestamp " << std::fixed << processedJob.Timestamp);
+    }
+    else if (processedJob.OutputFrames == NULL)
+    {
+      LOG_ERROR("Failed to retrieve processed frame");
+    }
+    else if (aSource != NULL)
+    {
+      this->AddProcessedFrame(aSource, processedJob.OutputFrames->GetTrackedFrame(0), processedJob.Timestamp);
+    }
+    this->ProcessedFrames.erase(it);
+    ++this->NextOutputSequenceNumber;
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusImageProcessorVideoSource::AddProcessedFrame(vtkPlusDataSource* aSource, igsioTrackedFrame* processedTrackedFrame, double frameTimestamp)
+{
   // Generate unique frame number (not used for filtering, so the actual increment value does not matter)
   this->FrameNumber++;
 
@@ -311,13 +644,7 @@ PlusStatus vtkPlusImageProcessorVideoSource::InternalUpdate()
   }
 
   igsioTrackedFrame::FieldMapType customFields = processedTrackedFrame->GetCustomFields();
-  if (aSource->AddItem(processedTrackedFrame->GetImageData(), this->FrameNumber, frameTimestamp, frameTimestamp, &customFields) != PLUS_SUCCESS)
-  {
-    status = PLUS_FAIL;
-  }
-
-  this->Modified();
-  return status;
+  return aSource->AddItem(processedTrackedFrame->GetImageData(), this->FrameNumber, frameTimestamp, frameTimestamp, &customFields);
 }
 
 //-----------------------------------------------------------------------------
@@ -10,7 +10,16 @@ See License.txt for details.
 #include "vtkPlusDataCollectionExport.h"
 
 #include "vtkPlusDevice.h"
+#include "vtkIGSIOTrackedFrameList.h"
+
+// STL includes
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
 #include <string>
+#include <utility>
+#include <vector>
 
 //class vtkIGSIOTransformRepository;
 class vtkPlusTrackedFrameProcessor;
@@ -19,6 +28,11 @@ class vtkPlusTrackedFrameProcessor;
 \class vtkPlusImageProcessorVideoSource 
 \brief Virtual device that performs real-time image processing on the input channel
 
+If NumberOfProcessingThreads is larger than 1 then each processor instance of the pool is used by its own processing thread
+while recording. The data capture thread queues every new input frame, the processing threads take the frames from the queue,
+and the processed frames are added to the output in input order: a frame that is processed before an earlier frame waits
+until the earlier frame is added.
+
 \ingroup PlusLibDataCollection
 */
 class vtkPlusDataCollectionExport vtkPlusImageProcessorVideoSource : public vtkPlusDevice
@@ -42,6 +56,12 @@ public:
   vtkGetMacro(EnableProcessing, bool);
   void SetEnableProcessing(bool aValue);
 
+  /*!
+    Number of frames processed concurrently. If larger than 1 then all input frames acquired since the last update
+    are processed (instead of only the latest one) by a pool of processor instances and added to the output in timestamp order.
+  */
+  vtkGetMacro(NumberOfProcessingThreads, int);
+
   virtual bool IsTracker() const { return false; }
   virtual bool IsVirtual() const { return true; }
 
@@ -49,6 +69,52 @@ protected:
   virtual PlusStatus InternalConnect();
   virtual PlusStatus InternalDisconnect();
 
+  /*! Start the processing threads if frames are processed in parallel */
+  virtual PlusStatus InternalStartRecording();
+
+  /*! Process and add to the output the frames that are already queued, then stop the processing threads */
+  virtual PlusStatus InternalStopRecording();
+
+  /*! A processing thread and the processor instance that it uses */
+  struct ProcessingWorker
+  {
+    vtkPlusImageProcessorVideoSource* Self;
+    vtkPlusTrackedFrameProcessor* Processor;
+    /*! first is the request to run, second is true while the thread is running */
+    std::pair<bool, bool> Active;
+    int ThreadId;
+  };
+
+  /*! An input frame that is queued for processing and its result */
+  struct ProcessingJob
+  {
+    /*! Position of the frame in the input order */
+    unsigned long SequenceNumber;
+    double Timestamp;
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> InputFrames;
+    /*! Copy of the processed frame, as the processor overwrites its output when it processes the next frame */
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> OutputFrames;
+    PlusStatus Status;
+  };
+
+  /*! Thread that processes queued frames with the processor of its worker */
+  static void* ProcessingThread(vtkMultiThreader::ThreadInfo* data);
+
+  /*! Queue all input frames that have been acquired since the last queued frame for the processing threads */
+  PlusStatus InternalUpdateParallel(vtkPlusChannel* outputChannel);
+
+  /*! Store a processed frame and add it and the following processed frames to the output, if all earlier frames are already added */
+  void AddProcessedFrameInOrder(const ProcessingJob& job);
+
+  /*! Add a processed frame to the output video source */
+  PlusStatus AddProcessedFrame(vtkPlusDataSource* aSource, igsioTrackedFrame* processedTrackedFrame, double frameTimestamp);
+
+  /*! Create a processor from a Processor element. Returns NULL if the type is unknown. */
+  vtkPlusTrackedFrameProcessor* CreateProcessor(vtkXMLDataElement* processorElement, vtkIGSIOTransformRepository* transformRepository);
+
+  /*! Delete the additional processor instances used for parallel processing */
+  void ClearProcessorPool();
+
   vtkPlusImageProcessorVideoSource();
   virtual ~vtkPlusImageProcessorVideoSource();
 
@@ -69,6 +135,45 @@ protected:
 
   vtkPlusTrackedFrameProcessor* ProcessorAlgorithm;
 
+  int NumberOfProcessingThreads;
+
+  /*!
+    Additional processor instances for parallel processing (ProcessorAlgorithm is the first one in the pool).
+    Processors update their transform repository with each frame, therefore each has its own repository.
+  */
+  std::vector<vtkPlusTrackedFrameProcessor*> ProcessorPool;
+  std::vector<vtkIGSIOTransformRepository*> ProcessorPoolTransformRepositories;
+
+  /*! One worker for ProcessorAlgorithm and one for each processor of ProcessorPool, only while recording */
+  std::vector<ProcessingWorker> ProcessingWorkers;
+
+  /*! Frames waiting for a processing thread, in input order */
+  std::deque<ProcessingJob> ProcessingQueue;
+
+  /*! True while the processing threads accept new frames */
+  bool ProcessingQueueOpen;
+
+  /*! Protects ProcessingQueue and ProcessingQueueOpen */
+  std::mutex ProcessingQueueMutex;
+
+  /*! Signaled when a frame is queued or the processing threads are requested to stop */
+  std::condition_variable ProcessingQueueChanged;
+
+  /*! Sequence number of the next queued frame */
+  unsigned long NextQueuedSequenceNumber;
+
+  /*! UID of the next input frame to queue (0 if no frame has been queued yet) */
+  BufferItemUidType NextInputFrameUid;
+
+  /*! Processed frames that are waiting for an earlier frame to be added to the output, by sequence number */
+  std::map<unsigned long, ProcessingJob> ProcessedFrames;
+
+  /*! Sequence number of the next frame to add to the output */
+  unsigned long NextOutputSequenceNumber;
+
+  /*! Protects ProcessedFrames, NextOutputSequenceNumber and adding frames to the output */
+  std::mutex ProcessedFramesMutex;
+
 private:
   vtkPlusImageProcessorVideoSource(const vtkPlusImageProcessorVideoSource&);  // Not implemented.
   void operator=(const vtkPlusImageProcessorVideoSource&);  // Not implemented. 
@@ -7,6 +7,7 @@ See License.txt for details.
 // Local includes
 #include "PlusConfigure.h"
 #include "igtlPlusClientInfoMessage.h"
+#include "igtlPlusTrackedFrameMessage.h"
 #include "vtkPlusDataSource.h"
 #include "vtkPlusIgtlMessageFactory.h"
 #include "vtkPlusOpenIGTLinkDevice.h"
@@ -63,6 +64,10 @@ void vtkPlusOpenIGTLinkDevice::PrintSelf(ostream& os, vtkIndent indent)
   {
     os << indent << "Image stream: " << this->ImageMessageEmbeddedTransformName.GetTransformName() << "\n";
   }
+  if (!this->ImageCompression.empty())
+  {
+    os << indent << "Image compression: " << this->ImageCompression << " (predictor: " << (this->ImageCompressionPredictor.empty() ? "NONE" : this->ImageCompressionPredictor) << ")\n";
+  }
 }
 //----------------------------------------------------------------------------
 std::string vtkPlusOpenIGTLinkDevice::GetSdkVersion()
@@ -179,12 +184,17 @@ PlusStatus vtkPlusOpenIGTLinkDevice::SendRequestedMessageTypes()
   // Set message type
   clientInfo.IgtlMessageTypes.push_back(this->MessageType);
 
+  // Tracked frame fields can be decoded in any encoding, servers that do not know the binary encoding ignore the request
+  clientInfo.SetTrackedFrameFieldsVersion(igtl::PlusTrackedFrameMessage::FIELDS_VERSION_LATEST);
+
   // Set any requested image streams
   if (this->ImageMessageEmbeddedTransformName.IsValid())
   {
     PlusIgtlClientInfo::ImageStream is;
     is.Name = this->ImageMessageEmbeddedTransformName.From();
     is.EmbeddedTransformToFrame = this->ImageMessageEmbeddedTransformName.To();
+    is.Compression = this->ImageCompression;
+    is.CompressionPredictor = this->ImageCompressionPredictor;
     clientInfo.ImageStreams.push_back(is);
   }
 
@@ -325,6 +335,8 @@ PlusStatus vtkPlusOpenIGTLinkDevice::ReadConfiguration(vtkXMLDataElement* rootCo
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(IgtlMessageCrcCheckEnabled, deviceConfig);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(UseReceivedTimestamps, deviceConfig);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(ReconnectOnReceiveTimeout, deviceConfig);
+  XML_READ_STRING_ATTRIBUTE_OPTIONAL(ImageCompression, deviceConfig);
+  XML_READ_STRING_ATTRIBUTE_OPTIONAL(ImageCompressionPredictor, deviceConfig);
   return PLUS_SUCCESS;
 }
 
@@ -340,6 +352,8 @@ PlusStatus vtkPlusOpenIGTLinkDevice::WriteConfiguration(vtkXMLDataElement* rootC
   deviceConfig->SetAttribute("IgtlMessageCrcCheckEnabled", this->IgtlMessageCrcCheckEnabled ? "true" : "false");
   deviceConfig->SetAttribute("UseReceivedTimestamps", this->UseReceivedTimestamps ? "true" : "false");
   deviceConfig->SetAttribute("ReconnectOnReceiveTimeout", this->ReconnectOnReceiveTimeout ? "true" : "false");
+  XML_WRITE_STRING_ATTRIBUTE_IF_NOT_EMPTY(ImageCompression, deviceConfig);
+  XML_WRITE_STRING_ATTRIBUTE_IF_NOT_EMPTY(ImageCompressionPredictor, deviceConfig);
   return PLUS_SUCCESS;
 }
 
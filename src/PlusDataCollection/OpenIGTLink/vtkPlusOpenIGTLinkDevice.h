@@ -62,6 +62,19 @@ public:
   /*! Get image streams to be sent when message type is a type that sends an image */
   vtkGetMacro(ImageMessageEmbeddedTransformName, igsioTransformName);
 
+  /*!
+    Set lossless compression method requested for the image stream (ZLIB). Empty for uncompressed images.
+    Servers that do not support compression ignore the request and send uncompressed images.
+  */
+  vtkSetStdStringMacro(ImageCompression);
+  /*! Get lossless compression method requested for the image stream */
+  vtkGetStdStringMacro(ImageCompression);
+
+  /*! Set prediction requested before compression of the image stream (NONE or DELTA) */
+  vtkSetStdStringMacro(ImageCompressionPredictor);
+  /*! Get prediction requested before compression of the image stream */
+  vtkGetStdStringMacro(ImageCompressionPredictor);
+
   /*! Set OpenIGTLink server address */
   vtkSetStdStringMacro(ServerAddress);
   /*! Get OpenIGTLink server address */
@@ -129,6 +142,12 @@ protected:
   /*! Image stream to send when message type wants to send an image */
   igsioTransformName ImageMessageEmbeddedTransformName;
 
+  /*! Lossless compression method requested for the image stream, empty if not compressed */
+  std::string ImageCompression;
+
+  /*! Prediction requested before compression of the image stream */
+  std::string ImageCompressionPredictor;
+
   /*! OpenIGTLink server address */
   std::string ServerAddress;
 
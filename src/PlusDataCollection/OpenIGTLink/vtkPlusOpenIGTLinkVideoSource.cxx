@@ -18,10 +18,29 @@ See License.txt for details.
 #include <vtkImageData.h>
 #include <vtkObjectFactory.h>
 
+// STL includes
+#include <algorithm>
+#include <chrono>
+
 vtkStandardNewMacro(vtkPlusOpenIGTLinkVideoSource);
 
+namespace
+{
+  // How often the waiting threads check whether they have to stop
+  const int RECEIVE_QUEUE_WAIT_TIMEOUT_MSEC = 100;
+}
+
 //----------------------------------------------------------------------------
 vtkPlusOpenIGTLinkVideoSource::vtkPlusOpenIGTLinkVideoSource()
+  : ImageDecompressor(vtkSmartPointer<vtkPlusIgtlImageCompressor>::New())
+  , VideoDecoder(vtkSmartPointer<vtkIGSIOFrameConverter>::New())
+  , UseReceiverThread(false)
+  , ReceiveQueueLength(3)
+  , NumberOfReceiveMessages(0)
+  , ReceiverThreadActive(std::make_pair(false, false))
+  , ReceiverThreadId(-1)
+  , DecoderThreadActive(std::make_pair(false, false))
+  , DecoderThreadId(-1)
 {
   this->RequireImageOrientationInConfiguration = true;
 }
@@ -29,12 +48,259 @@ vtkPlusOpenIGTLinkVideoSource::vtkPlusOpenIGTLinkVideoSource()
 //----------------------------------------------------------------------------
 vtkPlusOpenIGTLinkVideoSource::~vtkPlusOpenIGTLinkVideoSource()
 {
+  if (this->Recording)
+  {
+    this->StopRecording();
+  }
 }
 
 //----------------------------------------------------------------------------
 void vtkPlusOpenIGTLinkVideoSource::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "UseReceiverThread: " << (this->UseReceiverThread ? "true" : "false") << "\n";
+  os << indent << "ReceiveQueueLength: " << this->ReceiveQueueLength << "\n";
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkVideoSource::InternalStartRecording()
+{
+  {
+    std::lock_guard<std::mutex> queueGuard(this->ReceiveQueueMutex);
+    this->ReceivedMessages.clear();
+  }
+
+  // The data capture thread is only needed if it has to poll the socket
+  this->StartThreadForInternalUpdates = !this->UseReceiverThread;
+  if (!this->UseReceiverThread)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  this->DecoderThreadActive = std::make_pair(true, true);
+  this->DecoderThreadId = this->Threader->SpawnThread((vtkThreadFunctionType)&DecoderThread, this);
+  this->ReceiverThreadActive = std::make_pair(true, true);
+  this->ReceiverThreadId = this->Threader->SpawnThread((vtkThreadFunctionType)&ReceiverThread, this);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkVideoSource::InternalStopRecording()
+{
+  // Stop the receiver first, so that no more messages are queued for the decoder
+  if (this->ReceiverThreadId >= 0)
+  {
+    this->ReceiverThreadActive.first = false;
+    this->ReceiveQueueChanged.notify_all();
+    while (this->ReceiverThreadActive.second)
+    {
+      // Wait until the thread stops
+      vtkIGSIOAccurateTimer::Delay(0.05);
+    }
+    this->ReceiverThreadId = -1;
+  }
+
+  if (this->DecoderThreadId >= 0)
+  {
+    this->DecoderThreadActive.first = false;
+    this->ReceiveQueueChanged.notify_all();
+    while (this->DecoderThreadActive.second)
+    {
+      vtkIGSIOAccurateTimer::Delay(0.05);
+    }
+    this->DecoderThreadId = -1;
+  }
+
+  // Frames that were not decoded yet are dropped, as when recording is stopped while they are received
+  std::lock_guard<std::mutex> queueGuard(this->ReceiveQueueMutex);
+  while (!this->ReceivedMessages.empty())
+  {
+    this->FreeReceiveMessages.push_back(this->ReceivedMessages.front());
+    this->ReceivedMessages.pop_front();
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void* vtkPlusOpenIGTLinkVideoSource::ReceiverThread(vtkMultiThreader::ThreadInfo* data)
+{
+  vtkPlusOpenIGTLinkVideoSource* self = (vtkPlusOpenIGTLinkVideoSource*)(data->UserData);
+
+  while (self->ReceiverThreadActive.first)
+  {
+    ReceivedMessage receivedMessage;
+    bool messageReceived(false);
+    if (self->ReceiveMessage(receivedMessage, messageReceived) != PLUS_SUCCESS)
+    {
+      if (self->ReceiverThreadActive.first && self->GetConnected())
+      {
+        self->OnReceiveTimeout();
+      }
+      // Disconnected or the connection failed, do not retry receiving immediately
+      vtkIGSIOAccurateTimer::Delay(self->DelayBetweenRetryAttemptsSec);
+      continue;
+    }
+    if (!messageReceived)
+    {
+      continue;
+    }
+
+    {
+      std::lock_guard<std::mutex> queueGuard(self->ReceiveQueueMutex);
+      self->ReceivedMessages.push_back(receivedMessage);
+    }
+    self->ReceiveQueueChanged.notify_all();
+  }
+
+  self->ReceiverThreadActive.second = false;
+  return NULL;
+}
+
+//----------------------------------------------------------------------------
+void* vtkPlusOpenIGTLinkVideoSource::DecoderThread(vtkMultiThreader::ThreadInfo* data)
+{
+  vtkPlusOpenIGTLinkVideoSource* self = (vtkPlusOpenIGTLinkVideoSource*)(data->UserData);
+
+  while (self->DecoderThreadActive.first)
+  {
+    ReceivedMessage receivedMessage;
+    {
+      std::unique_lock<std::mutex> queueLock(self->ReceiveQueueMutex);
+      if (self->ReceivedMessages.empty())
+      {
+        self->ReceiveQueueChanged.wait_for(queueLock, std::chrono::milliseconds(RECEIVE_QUEUE_WAIT_TIMEOUT_MSEC));
+        continue;
+      }
+      receivedMessage = self->ReceivedMessages.front();
+      self->ReceivedMessages.pop_front();
+    }
+
+    if (self->IsRecording())
+    {
+      // Errors are logged, the next frame is decoded regardless
+      self->AddReceivedMessage(receivedMessage);
+    }
+    self->ReleaseReceiveMessage(receivedMessage);
+  }
+
+  self->DecoderThreadActive.second = false;
+  return NULL;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkVideoSource::ReceiveMessage(ReceivedMessage& receivedMessage, bool& messageReceived)
+{
+  messageReceived = false;
+
+  igtl::MessageHeader::Pointer headerMsg;
+  if (this->ReceiveMessageHeader(headerMsg) == PLUS_FAIL)
+  {
+    return PLUS_FAIL;
+  }
+  if (headerMsg == nullptr)
+  {
+    // Not a problem, just no messages received this timeout period
+    return PLUS_SUCCESS;
+  }
+
+  // We've received valid header data
+  headerMsg->Unpack(this->IgtlMessageCrcCheckEnabled);
+  double receiveTime = vtkIGSIOAccurateTimer::GetSystemTime();
+
+  igtl::MessageBase::Pointer bodyMsg = this->AcquireReceiveMessage(headerMsg);
+  if (bodyMsg.IsNull())
+  {
+    // if the data type is unknown, skip reading.
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> socketGuard(this->SocketMutex);
+    this->ClientSocket->Skip(headerMsg->GetBodySizeToRead(), 0);
+    return PLUS_SUCCESS;
+  }
+
+  receivedMessage.MessageType = headerMsg->GetMessageType();
+  receivedMessage.Message = bodyMsg;
+  receivedMessage.ReceiveTime = receiveTime;
+
+  // The buffer of a reused message is only reallocated if the size of the message changed
+  bodyMsg->SetMessageHeader(headerMsg);
+  bodyMsg->AllocateBuffer();
+  int numOfBytesReceived = 0;
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> socketGuard(this->SocketMutex);
+    numOfBytesReceived = this->ClientSocket->Receive(bodyMsg->GetBufferBodyPointer(), bodyMsg->GetBufferBodySize());
+  }
+  if (numOfBytesReceived != bodyMsg->GetBufferBodySize())
+  {
+    LOG_ERROR("Couldn't receive " << receivedMessage.MessageType << " message body from OpenIGTLink device " << this->GetDeviceId());
+    this->ReleaseReceiveMessage(receivedMessage);
+    return PLUS_FAIL;
+  }
+
+  messageReceived = true;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+igtl::MessageBase::Pointer vtkPlusOpenIGTLinkVideoSource::AcquireReceiveMessage(igtl::MessageHeader::Pointer headerMsg)
+{
+  const std::string messageType = headerMsg->GetMessageType();
+  {
+    std::unique_lock<std::mutex> queueLock(this->ReceiveQueueMutex);
+    while (true)
+    {
+      for (std::vector<ReceivedMessage>::iterator it = this->FreeReceiveMessages.begin(); it != this->FreeReceiveMessages.end(); ++it)
+      {
+        if (it->MessageType == messageType)
+        {
+          igtl::MessageBase::Pointer message = it->Message;
+          this->FreeReceiveMessages.erase(it);
+          return message;
+        }
+      }
+      if (this->NumberOfReceiveMessages < std::max(this->ReceiveQueueLength, 1))
+      {
+        this->NumberOfReceiveMessages++;
+        break;
+      }
+      if (!this->FreeReceiveMessages.empty())
+      {
+        // Message type changed, replace a message of another type
+        this->FreeReceiveMessages.erase(this->FreeReceiveMessages.begin());
+        break;
+      }
+      if (!this->ReceiverThreadActive.first)
+      {
+        return NULL;
+      }
+      // All messages are waiting for decoding, the receiver waits for the decoder
+      this->ReceiveQueueChanged.wait_for(queueLock, std::chrono::milliseconds(RECEIVE_QUEUE_WAIT_TIMEOUT_MSEC));
+    }
+  }
+
+  igtl::MessageBase::Pointer bodyMsg = this->MessageFactory->CreateReceiveMessage(headerMsg);
+  if (bodyMsg.IsNull()
+      || (typeid(*bodyMsg) != typeid(igtl::ImageMessage)
+          && typeid(*bodyMsg) != typeid(igtl::PlusCompressedImageMessage)
+          && typeid(*bodyMsg) != typeid(igtl::PlusTrackedFrameMessage)
+#if defined(OpenIGTLink_ENABLE_VIDEOSTREAMING)
+          && typeid(*bodyMsg) != typeid(igtl::VideoMessage)
+#endif
+         ))
+  {
+    std::lock_guard<std::mutex> queueGuard(this->ReceiveQueueMutex);
+    this->NumberOfReceiveMessages--;
+    return NULL;
+  }
+  return bodyMsg;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkVideoSource::ReleaseReceiveMessage(const ReceivedMessage& receivedMessage)
+{
+  {
+    std::lock_guard<std::mutex> queueGuard(this->ReceiveQueueMutex);
+    this->FreeReceiveMessages.push_back(receivedMessage);
+  }
+  this->ReceiveQueueChanged.notify_all();
 }
 
 //----------------------------------------------------------------------------
@@ -47,8 +313,9 @@ PlusStatus vtkPlusOpenIGTLinkVideoSource::InternalUpdate()
     return PLUS_SUCCESS;
   }
 
-  igtl::MessageHeader::Pointer headerMsg;
-  if (ReceiveMessageHeader(headerMsg) == PLUS_FAIL)
+  ReceivedMessage receivedMessage;
+  bool messageReceived(false);
+  if (this->ReceiveMessage(receivedMessage, messageReceived) == PLUS_FAIL)
   {
     if (!this->IsRecording() || !this->GetConnected())
     {
@@ -59,32 +326,113 @@ PlusStatus vtkPlusOpenIGTLinkVideoSource::InternalUpdate()
     return PLUS_FAIL;
   }
 
-  if (headerMsg == nullptr)
+  if (!messageReceived)
   {
     // Not a problem, just no messages received this timeout period
     return PLUS_SUCCESS;
   }
 
-  // We've received valid header data
-  headerMsg->Unpack(this->IgtlMessageCrcCheckEnabled);
+  PlusStatus status = this->AddReceivedMessage(receivedMessage);
+  this->ReleaseReceiveMessage(receivedMessage);
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkVideoSource::AddReceivedMessage(const ReceivedMessage& receivedMessage)
+{
+  vtkPlusDataSource* aSource = NULL;
+  if (this->GetFirstActiveOutputVideoSource(aSource) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Unable to retrieve the video source in the OpenIGTLinkVideo device.");
+    return PLUS_FAIL;
+  }
 
-  // Set unfiltered and filtered timestamp by converting UTC to system timestamp
-  double unfilteredTimestamp = vtkIGSIOAccurateTimer::GetSystemTime();
+  // The time of reception is used as timestamp, unless the timestamp of a tracked frame message is used
+  double unfilteredTimestamp = receivedMessage.ReceiveTime;
 
+  igtl::MessageBase* bodyMsg = receivedMessage.Message.GetPointer();
   igsioTrackedFrame trackedFrame;
-  igtl::MessageBase::Pointer bodyMsg = this->MessageFactory->CreateReceiveMessage(headerMsg);
+  igsioTrackedFrame::FieldMapType customFields;
+  PlusStatus status = PLUS_FAIL;
 
   if (typeid(*bodyMsg) == typeid(igtl::ImageMessage))
   {
-    if (vtkPlusIgtlMessageCommon::UnpackImageMessage(bodyMsg, this->ClientSocket, trackedFrame, this->ImageMessageEmbeddedTransformName, this->IgtlMessageCrcCheckEnabled) != PLUS_SUCCESS)
+    // The pixels are added to the buffer directly from the received message
+    igtl::ImageMessage::Pointer imageMsg = static_cast<igtl::ImageMessage*>(bodyMsg);
+    if (vtkPlusIgtlMessageCommon::UnpackImageMessage(imageMsg, this->ImageMessageEmbeddedTransformName, customFields, this->IgtlMessageCrcCheckEnabled) != PLUS_SUCCESS)
     {
       LOG_ERROR("Couldn't get image from OpenIGTLink server!");
       return PLUS_FAIL;
     }
+    int imgSize[3] = {0};
+    imageMsg->GetDimensions(imgSize);
+    FrameSizeType frameSize = { static_cast<unsigned int>(imgSize[0]), static_cast<unsigned int>(imgSize[1]), static_cast<unsigned int>(imgSize[2]) };
+    igsioCommon::VTKScalarPixelType pixelType = PlusCommon::GetVTKScalarPixelTypeFromIGTL(imageMsg->GetScalarType());
+    unsigned int numberOfScalarComponents = imageMsg->GetNumComponents();
+    US_IMAGE_TYPE imageType = US_IMG_BRIGHTNESS;
+    if (imageMsg->GetScalarType() == igtl::ImageMessage::TYPE_INT8 && imageMsg->GetNumComponents() == igtl::ImageMessage::DTYPE_VECTOR)
+    {
+      imageType = US_IMG_RGB_COLOR;
+    }
+
+    if (this->InitializeVideoBuffer(aSource, frameSize, pixelType, numberOfScalarComponents, imageType) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    // The timestamps are already defined, so we don't need to filter them,
+    // for simplicity, we increase frame number always by 1.
+    this->FrameNumber++;
+    // Received images are in the default orientation of unpacked video frames
+    status = aSource->AddItem(imageMsg->GetScalarPointer(), US_IMG_ORIENT_MF, frameSize, pixelType, numberOfScalarComponents, imageType, 0,
+                              this->FrameNumber, unfilteredTimestamp, unfilteredTimestamp, &customFields);
+    this->Modified();
+    return status;
+  }
+#if defined(OpenIGTLink_ENABLE_VIDEOSTREAMING)
+  else if (typeid(*bodyMsg) == typeid(igtl::VideoMessage))
+  {
+    // The decoded image is added to the buffer directly
+    igtl::VideoMessage::Pointer videoMsg = static_cast<igtl::VideoMessage*>(bodyMsg);
+    vtkSmartPointer<vtkImageData> decodedImage;
+    if (vtkPlusIgtlMessageCommon::UnpackVideoMessage(videoMsg, this->VideoDecoder, decodedImage, this->ImageMessageEmbeddedTransformName, customFields, this->IgtlMessageCrcCheckEnabled) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Couldn't get video frame from OpenIGTLink server!");
+      return PLUS_FAIL;
+    }
+    int dimensions[3] = {0};
+    decodedImage->GetDimensions(dimensions);
+    FrameSizeType frameSize = { static_cast<unsigned int>(dimensions[0]), static_cast<unsigned int>(dimensions[1]), static_cast<unsigned int>(dimensions[2]) };
+    unsigned int numberOfScalarComponents = decodedImage->GetNumberOfScalarComponents();
+    US_IMAGE_TYPE imageType = (numberOfScalarComponents == 3 ? US_IMG_RGB_COLOR : US_IMG_BRIGHTNESS);
+
+    if (this->InitializeVideoBuffer(aSource, frameSize, decodedImage->GetScalarType(), numberOfScalarComponents, imageType) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    this->FrameNumber++;
+    status = aSource->AddItem(decodedImage, US_IMG_ORIENT_MF, imageType, this->FrameNumber, unfilteredTimestamp, unfilteredTimestamp, &customFields);
+    this->Modified();
+    return status;
+  }
+#endif
+  else if (typeid(*bodyMsg) == typeid(igtl::PlusCompressedImageMessage))
+  {
+    igtl::PlusCompressedImageMessage::Pointer compressedImageMsg = static_cast<igtl::PlusCompressedImageMessage*>(bodyMsg);
+    if (vtkPlusIgtlMessageCommon::UnpackCompressedImageMessage(compressedImageMsg, trackedFrame, this->ImageMessageEmbeddedTransformName, this->ImageDecompressor, this->IgtlMessageCrcCheckEnabled) != PLUS_SUCCESS)
+    {
+      if (this->ImageDecompressor->GetWaitingForKeyFrame())
+      {
+        // Joined a predicted stream or missed a frame, decoding resumes at the next key frame
+        return PLUS_SUCCESS;
+      }
+      LOG_ERROR("Couldn't get compressed image from OpenIGTLink server!");
+      return PLUS_FAIL;
+    }
   }
   else if (typeid(*bodyMsg) == typeid(igtl::PlusTrackedFrameMessage))
   {
-    if (vtkPlusIgtlMessageCommon::UnpackTrackedFrameMessage(bodyMsg, this->ClientSocket, trackedFrame, this->ImageMessageEmbeddedTransformName, this->IgtlMessageCrcCheckEnabled) != PLUS_SUCCESS)
+    igtl::PlusTrackedFrameMessage::Pointer trackedFrameMsg = static_cast<igtl::PlusTrackedFrameMessage*>(bodyMsg);
+    if (vtkPlusIgtlMessageCommon::UnpackTrackedFrameMessage(trackedFrameMsg, trackedFrame, this->ImageMessageEmbeddedTransformName, this->IgtlMessageCrcCheckEnabled) != PLUS_SUCCESS)
     {
       LOG_ERROR("Couldn't get tracked frame from OpenIGTLink server!");
       return PLUS_FAIL;
@@ -99,59 +447,69 @@ PlusStatus vtkPlusOpenIGTLinkVideoSource::InternalUpdate()
   }
   else
   {
-    // if the data type is unknown, skip reading.
-    igsioLockGuard<vtkIGSIORecursiveCriticalSection> socketGuard(this->SocketMutex);
-    this->ClientSocket->Skip(headerMsg->GetBodySizeToRead(), 0);
-    return PLUS_SUCCESS;
+    LOG_ERROR("Unsupported message type received by the OpenIGTLinkVideo device: " << receivedMessage.MessageType);
+    return PLUS_FAIL;
   }
 
   // No need to filter already filtered timestamped items received over OpenIGTLink
   // If the original timestamps are not used it's still safer not to use filtering, as filtering assumes uniform frame rate, which is not guaranteed
   double filteredTimestamp = unfilteredTimestamp;
 
-  // The timestamps are already defined, so we don't need to filter them,
-  // for simplicity, we increase frame number always by 1.
-  this->FrameNumber++;
-
-  vtkPlusDataSource* aSource = NULL;
-  if (this->GetFirstActiveOutputVideoSource(aSource) != PLUS_SUCCESS)
+  igsioVideoFrame* videoFrame = trackedFrame.GetImageData();
+  if (videoFrame == NULL)
   {
-    LOG_ERROR("Unable to retrieve the video source in the OpenIGTLinkVideo device.");
+    LOG_ERROR("Invalid video frame received, cannot add it to the video buffer");
     return PLUS_FAIL;
   }
-
-  // If the buffer is empty, set the pixel type and frame size to the first received properties
-  if (aSource->GetNumberOfItems() == 0)
+  unsigned int numberOfScalarComponents(1);
+  if (videoFrame->GetNumberOfScalarComponents(numberOfScalarComponents) != PLUS_SUCCESS)
   {
-    igsioVideoFrame* videoFrame = trackedFrame.GetImageData();
-    if (videoFrame == NULL)
-    {
-      LOG_ERROR("Invalid video frame received, cannot use it to initialize the video buffer");
-      return PLUS_FAIL;
-    }
-    aSource->SetPixelType(videoFrame->GetVTKScalarPixelType());
-    unsigned int numberOfScalarComponents(1);
-    if (videoFrame->GetNumberOfScalarComponents(numberOfScalarComponents) != PLUS_SUCCESS)
-    {
-      LOG_ERROR("Unable to retrieve number of scalar components.");
-      return PLUS_FAIL;
-    }
-    aSource->SetNumberOfScalarComponents(numberOfScalarComponents);
-    aSource->SetImageType(videoFrame->GetImageType());
-    aSource->SetInputFrameSize(trackedFrame.GetFrameSize());
+    LOG_ERROR("Unable to retrieve number of scalar components.");
+    return PLUS_FAIL;
+  }
+  if (this->InitializeVideoBuffer(aSource, trackedFrame.GetFrameSize(), videoFrame->GetVTKScalarPixelType(), numberOfScalarComponents, videoFrame->GetImageType()) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
   }
-  igsioTrackedFrame::FieldMapType customFields = trackedFrame.GetCustomFields();
-  PlusStatus status = aSource->AddItem(trackedFrame.GetImageData(), this->FrameNumber, unfilteredTimestamp, filteredTimestamp, &customFields);
+
+  // The timestamps are already defined, so we don't need to filter them,
+  // for simplicity, we increase frame number always by 1.
+  this->FrameNumber++;
+  customFields = trackedFrame.GetCustomFields();
+  status = aSource->AddItem(videoFrame, this->FrameNumber, unfilteredTimestamp, filteredTimestamp, &customFields);
   this->Modified();
 
   return status;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkVideoSource::InitializeVideoBuffer(vtkPlusDataSource* aSource, const FrameSizeType& frameSize, igsioCommon::VTKScalarPixelType pixelType,
+    unsigned int numberOfScalarComponents, US_IMAGE_TYPE imageType)
+{
+  // If the buffer is empty, set the pixel type and frame size to the first received properties
+  if (aSource->GetNumberOfItems() != 0)
+  {
+    return PLUS_SUCCESS;
+  }
+  aSource->SetPixelType(pixelType);
+  aSource->SetNumberOfScalarComponents(numberOfScalarComponents);
+  aSource->SetImageType(imageType);
+  aSource->SetInputFrameSize(frameSize);
+  return PLUS_SUCCESS;
+}
+
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusOpenIGTLinkVideoSource::ReadConfiguration(vtkXMLDataElement* rootConfigElement)
 {
   XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_READING(deviceConfig, rootConfigElement);
   XML_READ_STRING_ATTRIBUTE_OPTIONAL(ImageMessageEmbeddedTransformName, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(UseReceiverThread, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, ReceiveQueueLength, deviceConfig);
+  if (this->ReceiveQueueLength < 1)
+  {
+    LOG_WARNING("ReceiveQueueLength of device " << this->GetDeviceId() << " is invalid: " << this->ReceiveQueueLength << ". A single message will be used.");
+    this->ReceiveQueueLength = 1;
+  }
   return PLUS_SUCCESS;
 }
 
@@ -160,6 +518,11 @@ PlusStatus vtkPlusOpenIGTLinkVideoSource::WriteConfiguration(vtkXMLDataElement*
 {
   XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_WRITING(deviceConfig, rootConfigElement);
   deviceConfig->SetAttribute("ImageMessageEmbeddedTransformName", this->ImageMessageEmbeddedTransformName.GetTransformName().c_str());
+  if (this->UseReceiverThread)
+  {
+    deviceConfig->SetAttribute("UseReceiverThread", "TRUE");
+    deviceConfig->SetIntAttribute("ReceiveQueueLength", this->ReceiveQueueLength);
+  }
   return PLUS_SUCCESS;
 }
 
@@ -10,14 +10,33 @@
 #include "PlusConfigure.h"
 #include "vtkPlusDataCollectionExport.h"
 #include "vtkPlusOpenIGTLinkDevice.h"
+#include "vtkPlusIgtlImageCompressor.h"
 #include "vtkPlusIgtlMessageFactory.h"
 
+// IGSIO includes
+#include <vtkIGSIOFrameConverter.h>
+
+// STL includes
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+class vtkPlusDataSource;
+
 /*!
   \class vtkPlusOpenIGTLinkVideoSource
   \brief VTK interface for video input from OpenIGTLink image message
 
   vtkPlusOpenIGTLinkVideoSource is a class for providing video input interfaces between VTK and OpenIGTLink ready video device.
 
+  Messages are received into reused messages, so the buffer of a frame is only allocated when the frame size changes, and
+  IMAGE pixels are added to the video buffer directly from the received message. If UseReceiverThread is enabled then
+  a receiver thread reads the socket and a decoder thread unpacks and decodes (CIMAGE, VIDEO) the messages and adds the
+  frames to the buffer, so receiving the next frame is not delayed by decoding. At most ReceiveQueueLength messages are
+  in use; when all are waiting for decoding, the receiver thread stops reading the socket until one is released.
+
   \ingroup PlusLibDataCollection
 */
 class vtkPlusDataCollectionExport vtkPlusOpenIGTLinkVideoSource : public vtkPlusOpenIGTLinkDevice
@@ -44,10 +63,102 @@ public:
   /*! Verify the device is correctly configured */
   virtual PlusStatus NotifyConfigured();
 
+  /*! Receive and decode the messages in dedicated threads instead of the data capture thread */
+  vtkGetMacro(UseReceiverThread, bool);
+  vtkSetMacro(UseReceiverThread, bool);
+  vtkBooleanMacro(UseReceiverThread, bool);
+
+  /*! Maximum number of messages that are received but not yet added to the buffer */
+  vtkGetMacro(ReceiveQueueLength, int);
+  vtkSetMacro(ReceiveQueueLength, int);
+
 protected:
   vtkPlusOpenIGTLinkVideoSource();
   virtual ~vtkPlusOpenIGTLinkVideoSource();
 
+  /*! A message that is received from the server. Messages are reused for receiving later messages of the same type. */
+  struct ReceivedMessage
+  {
+    std::string MessageType;
+    igtl::MessageBase::Pointer Message;
+    /*! System time when the message was received */
+    double ReceiveTime;
+    ReceivedMessage()
+      : ReceiveTime(0.0)
+    {
+    }
+  };
+
+  /*! Start the receiver and decoder threads if they are enabled */
+  virtual PlusStatus InternalStartRecording();
+
+  /*! Stop the receiver and decoder threads */
+  virtual PlusStatus InternalStopRecording();
+
+  /*! Thread that receives the messages and queues them for decoding */
+  static void* ReceiverThread(vtkMultiThreader::ThreadInfo* data);
+
+  /*! Thread that adds the frames of the queued messages to the buffer */
+  static void* DecoderThread(vtkMultiThreader::ThreadInfo* data);
+
+  /*!
+    Receive the next message. messageReceived is false if no (supported) message is received in the receive timeout.
+    Returns PLUS_FAIL if there was a socket error.
+  */
+  PlusStatus ReceiveMessage(ReceivedMessage& receivedMessage, bool& messageReceived);
+
+  /*!
+    Get a message that the body of a message can be received into, reusing a released message of the same type if possible.
+    If all messages are in use then it waits until one is released or the receiver thread is stopped.
+    Returns NULL if the message type is not supported or no message is available.
+  */
+  igtl::MessageBase::Pointer AcquireReceiveMessage(igtl::MessageHeader::Pointer headerMsg);
+
+  /*! Make the message available for receiving new messages */
+  void ReleaseReceiveMessage(const ReceivedMessage& receivedMessage);
+
+  /*! Unpack the message and add its frame to the video buffer */
+  PlusStatus AddReceivedMessage(const ReceivedMessage& receivedMessage);
+
+  /*! If the buffer is empty, set the pixel type and frame size to the properties of the first received frame */
+  PlusStatus InitializeVideoBuffer(vtkPlusDataSource* aSource, const FrameSizeType& frameSize, igsioCommon::VTKScalarPixelType pixelType,
+                                   unsigned int numberOfScalarComponents, US_IMAGE_TYPE imageType);
+
+  /*! Decoder state of received compressed images (CIMAGE) */
+  vtkSmartPointer<vtkPlusIgtlImageCompressor> ImageDecompressor;
+
+  /*! Decoder state of received video messages (VIDEO) */
+  vtkSmartPointer<vtkIGSIOFrameConverter> VideoDecoder;
+
+  /*! Receive and decode the messages in dedicated threads */
+  bool UseReceiverThread;
+
+  /*! Maximum number of messages that are received but not yet added to the buffer */
+  int ReceiveQueueLength;
+
+  /*! Received messages in the order of reception, waiting for decoding */
+  std::deque<ReceivedMessage> ReceivedMessages;
+
+  /*! Messages that can be reused for receiving */
+  std::vector<ReceivedMessage> FreeReceiveMessages;
+
+  /*! Number of messages that are received into, queued, decoded or free */
+  int NumberOfReceiveMessages;
+
+  /*! Protects ReceivedMessages, FreeReceiveMessages and NumberOfReceiveMessages */
+  std::mutex ReceiveQueueMutex;
+
+  /*! Signaled when a message is queued or released */
+  std::condition_variable ReceiveQueueChanged;
+
+  /*! Receiver thread: first is the request to run, second is true while the thread is running */
+  std::pair<bool, bool> ReceiverThreadActive;
+  int ReceiverThreadId;
+
+  /*! Decoder thread: first is the request to run, second is true while the thread is running */
+  std::pair<bool, bool> DecoderThreadActive;
+  int DecoderThreadId;
+
 private:
   vtkPlusOpenIGTLinkVideoSource(const vtkPlusOpenIGTLinkVideoSource&);   // Not implemented.
   void operator=(const vtkPlusOpenIGTLinkVideoSource&);   // Not implemented.
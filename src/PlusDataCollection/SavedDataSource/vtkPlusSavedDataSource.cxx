@@ -13,11 +13,28 @@ See License.txt for details.
 #include "vtkPlusChannel.h"
 #include "vtkPlusDataSource.h"
 #include "vtkPlusSavedDataSource.h"
+#include "vtkPlusSequenceStreamReader.h"
 #include "vtkIGSIOTrackedFrameList.h"
+#include "vtkWeakPointer.h"
 #include "vtksys/SystemTools.hxx"
 
 vtkStandardNewMacro(vtkPlusSavedDataSource);
 
+//----------------------------------------------------------------------------
+namespace
+{
+  /*! Field of the local buffer items in streaming mode, stores the index of the frame in the sequence file */
+  const char* STREAMED_FRAME_INDEX_FIELD_NAME = "SavedDataSourceFrameIndex";
+  const int DEFAULT_STREAMING_WINDOW_SIZE = 30;
+
+  /*! Sequence file content shared between saved data sources. The cache does not keep the content alive, devices do. */
+  struct SharedSequenceEntry
+  {
+    long ModifiedTime;
+    vtkWeakPointer<vtkIGSIOTrackedFrameList> TrackedFrames;
+  };
+}
+
 //----------------------------------------------------------------------------
 vtkPlusSavedDataSource::vtkPlusSavedDataSource()
   : FrameBufferRowAlignment(1)
@@ -31,6 +48,8 @@ vtkPlusSavedDataSource::vtkPlusSavedDataSource()
   , LastAddedFrameUid(0)
   , LastAddedLoopIndex(0)
   , SimulatedStream(VIDEO_STREAM)
+  , StreamingEnabled(false)
+  , StreamingWindowSize(DEFAULT_STREAMING_WINDOW_SIZE)
 {
   // No callback function provided by the device, so the data capture thread will be used to poll the hardware and add new items to the buffer
   this->StartThreadForInternalUpdates = true;
@@ -47,6 +66,34 @@ vtkPlusSavedDataSource::~vtkPlusSavedDataSource()
   DeleteLocalBuffers();
 }
 
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkIGSIOTrackedFrameList> vtkPlusSavedDataSource::GetSharedSequence(const std::string& absoluteFilePath)
+{
+  static std::map<std::string, SharedSequenceEntry> sharedSequences;
+  static vtkSmartPointer<vtkIGSIORecursiveCriticalSection> sharedSequencesMutex = vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New();
+
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> lock(sharedSequencesMutex);
+
+  long modifiedTime = vtksys::SystemTools::ModifiedTime(absoluteFilePath);
+  std::map<std::string, SharedSequenceEntry>::iterator entryIt = sharedSequences.find(absoluteFilePath);
+  if (entryIt != sharedSequences.end() && entryIt->second.ModifiedTime == modifiedTime && entryIt->second.TrackedFrames != NULL)
+  {
+    LOG_DEBUG("Reuse already loaded sequence file: " << absoluteFilePath);
+    return vtkSmartPointer<vtkIGSIOTrackedFrameList>(entryIt->second.TrackedFrames.GetPointer());
+  }
+
+  // Read sequence file into tracked frame list
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  vtkIGSIOSequenceIO::Read(absoluteFilePath, trackedFrames);
+
+  SharedSequenceEntry entry;
+  entry.ModifiedTime = modifiedTime;
+  entry.TrackedFrames = trackedFrames;
+  sharedSequences[absoluteFilePath] = entry;
+
+  return trackedFrames;
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusSavedDataSource::PrintSelf(ostream& os, vtkIndent indent)
 {
@@ -173,12 +220,7 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateOriginalTimestamp(BufferItemUid
     {
       case VIDEO_STREAM:
       {
-        StreamBufferItem::FieldMapType fieldMap;
-        if (this->UseAllFrameFields)
-        {
-          fieldMap = dataBufferItemToBeAdded.GetFrameFieldMap();
-        }
-        if (this->AddVideoItemToVideoSources(this->GetVideoSources(), dataBufferItemToBeAdded.GetFrame(), this->FrameNumber, unfilteredTimestamp, filteredTimestamp, &fieldMap) != PLUS_SUCCESS)
+        if (this->AddVideoItem(dataBufferItemToBeAdded, unfilteredTimestamp, filteredTimestamp) != PLUS_SUCCESS)
         {
           status = PLUS_FAIL;
         }
@@ -274,12 +316,7 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateCurrentTimestamp(BufferItemUidT
   {
     case VIDEO_STREAM:
     {
-      StreamBufferItem::FieldMapType fieldMap;
-      if (this->UseAllFrameFields)
-      {
-        fieldMap = dataBufferItemToBeAdded.GetFrameFieldMap();
-      }
-      if (this->AddVideoItemToVideoSources(this->GetVideoSources(), dataBufferItemToBeAdded.GetFrame(), this->FrameNumber, UNDEFINED_TIMESTAMP, UNDEFINED_TIMESTAMP, &fieldMap) != PLUS_SUCCESS)
+      if (this->AddVideoItem(dataBufferItemToBeAdded, UNDEFINED_TIMESTAMP, UNDEFINED_TIMESTAMP) != PLUS_SUCCESS)
       {
         // UNDEFINED_TIMESTAMP => use current timestamp
         status = PLUS_FAIL;
@@ -349,6 +386,74 @@ PlusStatus vtkPlusSavedDataSource::InternalUpdateCurrentTimestamp(BufferItemUidT
   return status;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSavedDataSource::AddVideoItem(StreamBufferItem& dataBufferItem, double unfilteredTimestamp, double filteredTimestamp)
+{
+  StreamBufferItem::FieldMapType fieldMap;
+  if (this->UseAllFrameFields)
+  {
+    fieldMap = dataBufferItem.GetFrameFieldMap();
+  }
+
+  if (this->StreamReader.GetPointer() == NULL)
+  {
+    return this->AddVideoItemToVideoSources(this->GetVideoSources(), dataBufferItem.GetFrame(), this->FrameNumber, unfilteredTimestamp, filteredTimestamp, &fieldMap);
+  }
+
+  // Streaming: the local buffer item only contains the fields, the image is read from the file
+  fieldMap.erase(STREAMED_FRAME_INDEX_FIELD_NAME);
+  unsigned int frameIndex = 0;
+  if (this->GetStreamedFrameIndex(dataBufferItem, frameIndex) != PLUS_SUCCESS
+      || this->StreamReader->GetFramePixels(frameIndex, this->StreamedFramePixels) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("vtkPlusSavedDataSource: Failed to read image from the sequence file, UID=" << dataBufferItem.GetUid());
+    return PLUS_FAIL;
+  }
+  return this->AddVideoItemToVideoSources(this->GetVideoSources(), this->StreamedFramePixels.data(), this->StreamReader->GetImageOrientation(),
+                                          this->StreamReader->GetFrameSize(), this->StreamReader->GetPixelType(), this->StreamReader->GetNumberOfScalarComponents(),
+                                          this->StreamReader->GetImageType(), 0, this->FrameNumber, unfilteredTimestamp, filteredTimestamp, &fieldMap);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSavedDataSource::GetStreamedFrameIndex(BufferItemUidType uid, unsigned int& frameIndex)
+{
+  StreamBufferItem dataBufferItem;
+  if (this->LocalVideoBuffer == NULL || this->LocalVideoBuffer->GetStreamBufferItem(uid, &dataBufferItem) != ITEM_OK)
+  {
+    return PLUS_FAIL;
+  }
+  return this->GetStreamedFrameIndex(dataBufferItem, frameIndex);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSavedDataSource::GetStreamedFrameIndex(StreamBufferItem& dataBufferItem, unsigned int& frameIndex)
+{
+  const char* frameIndexStr = dataBufferItem.GetFrameField(STREAMED_FRAME_INDEX_FIELD_NAME);
+  if (frameIndexStr == NULL)
+  {
+    return PLUS_FAIL;
+  }
+  return igsioCommon::StringToUInt(frameIndexStr, frameIndex);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusSavedDataSource::UpdateStreamingLoopRange()
+{
+  if (this->StreamReader.GetPointer() == NULL)
+  {
+    return;
+  }
+  unsigned int firstFrameIndex = 0;
+  unsigned int lastFrameIndex = 0;
+  if (this->GetStreamedFrameIndex(this->LoopFirstFrameUid, firstFrameIndex) != PLUS_SUCCESS
+      || this->GetStreamedFrameIndex(this->LoopLastFrameUid, lastFrameIndex) != PLUS_SUCCESS)
+  {
+    LOG_WARNING("Unable to determine the loop range in the sequence file, frames will not be prefetched accurately");
+    return;
+  }
+  this->StreamReader->SetLoopRange(firstFrameIndex, lastFrameIndex);
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusSavedDataSource::Probe()
 {
@@ -379,10 +484,30 @@ PlusStatus vtkPlusSavedDataSource::InternalConnect()
     return PLUS_FAIL;
   }
 
-  vtkSmartPointer<vtkIGSIOTrackedFrameList> savedDataBuffer = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
-
-  // Read sequence file into tracked frame list
-  vtkIGSIOSequenceIO::Read(foundAbsoluteImagePath, savedDataBuffer);
+  vtkIGSIOTrackedFrameList* savedDataBuffer = NULL;
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> streamedFrameFields;
+  this->StreamReader = NULL;
+  if (this->StreamingEnabled)
+  {
+    // Only read the frame fields now, images are read during replay
+    vtkSmartPointer<vtkPlusSequenceStreamReader> streamReader = vtkSmartPointer<vtkPlusSequenceStreamReader>::New();
+    streamedFrameFields = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    if (streamReader->Open(foundAbsoluteImagePath, streamedFrameFields) == PLUS_SUCCESS)
+    {
+      this->StreamReader = streamReader;
+      savedDataBuffer = streamedFrameFields;
+    }
+    else
+    {
+      LOG_WARNING("Streaming is enabled but the sequence file cannot be streamed (only uncompressed MetaImage files are supported). The whole file is loaded into memory: " << this->SequenceFile);
+    }
+  }
+  if (savedDataBuffer == NULL)
+  {
+    // Other saved data sources may have already read the same file
+    this->SharedSequence = GetSharedSequence(foundAbsoluteImagePath);
+    savedDataBuffer = this->SharedSequence;
+  }
 
   if (savedDataBuffer->GetNumberOfTrackedFrames() < 1)
   {
@@ -394,10 +519,19 @@ PlusStatus vtkPlusSavedDataSource::InternalConnect()
   switch (this->SimulatedStream)
   {
     case VIDEO_STREAM:
-      status = InternalConnectVideo(savedDataBuffer);
+      if (this->StreamReader.GetPointer() != NULL)
+      {
+        status = InternalConnectVideoStreaming(savedDataBuffer);
+      }
+      else
+      {
+        status = InternalConnectVideo(savedDataBuffer);
+      }
       break;
     case TRACKER_STREAM:
       status = InternalConnectTracker(savedDataBuffer);
+      // The tracker buffers are filled from the frame fields, no image data is needed during replay
+      this->StreamReader = NULL;
       break;
     default:
       LOG_ERROR("Unknown stream type: " << this->SimulatedStream);
@@ -453,9 +587,61 @@ PlusStatus vtkPlusSavedDataSource::InternalConnect()
   this->LastAddedFrameUid = this->LoopFirstFrameUid - 1;
   this->LastAddedLoopIndex = 0;
 
+  if (this->StreamReader.GetPointer() != NULL)
+  {
+    this->StreamReader->SetWindowSize(this->StreamingWindowSize);
+    this->UpdateStreamingLoopRange();
+    this->StreamReader->StartPrefetch();
+  }
+
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSavedDataSource::InternalConnectVideoStreaming(vtkIGSIOTrackedFrameList* frameFields)
+{
+  vtkPlusDataSource* outputDataSource = this->GetOutputDataSource();
+  if (outputDataSource == NULL)
+  {
+    return PLUS_FAIL;
+  }
+  if (outputDataSource->SetImageType(this->StreamReader->GetImageType()) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to set video buffer image type");
+    return PLUS_FAIL;
+  }
+
+  // The local buffer only stores the timestamps and fields of the frames, images are read from the file during replay
+  DeleteLocalBuffers();
+  this->LocalVideoBuffer = vtkPlusBuffer::New();
+  this->LocalVideoBuffer->SetImageOrientation(this->StreamReader->GetImageOrientation());
+  this->LocalVideoBuffer->SetImageType(this->StreamReader->GetImageType());
+  this->LocalVideoBuffer->SetBufferSize(frameFields->GetNumberOfTrackedFrames());
+  this->LocalVideoBuffer->SetLocalTimeOffsetSec(0.0);   // the time offset is copied from the output, so reset it to 0
+  for (unsigned int frameIndex = 0; frameIndex < frameFields->GetNumberOfTrackedFrames(); ++frameIndex)
+  {
+    igsioTrackedFrame* frame = frameFields->GetTrackedFrame(frameIndex);
+    StreamBufferItem::FieldMapType fields;
+    if (this->UseAllFrameFields)
+    {
+      fields = frame->GetCustomFields();
+      // skip special fields
+      fields.erase("Timestamp");
+      fields.erase("UnfilteredTimestamp");
+      fields.erase("FrameNumber");
+    }
+    fields[STREAMED_FRAME_INDEX_FIELD_NAME] = std::to_string(frameIndex);
+    double timestamp = frame->GetTimestamp();
+    if (this->LocalVideoBuffer->AddItem(fields, frameIndex, timestamp, timestamp) != PLUS_SUCCESS)
+    {
+      LOG_WARNING("Frame " << frameIndex << " of the sequence file is not replayed, its timestamp (" << timestamp << ") is invalid");
+    }
+  }
+
+  return this->SetupVideoSources(this->StreamReader->GetImageOrientation(), this->StreamReader->GetFrameSize(),
+                                 this->StreamReader->GetNumberOfScalarComponents(), this->StreamReader->GetPixelType());
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusSavedDataSource::InternalConnectVideo(vtkIGSIOTrackedFrameList* savedDataBuffer)
 {
@@ -500,28 +686,34 @@ PlusStatus vtkPlusSavedDataSource::InternalConnectVideo(vtkIGSIOTrackedFrameList
   this->LocalVideoBuffer->SetBufferSize(savedDataBuffer->GetNumberOfTrackedFrames());
   this->LocalVideoBuffer->SetLocalTimeOffsetSec(0.0);   // the time offset is copied from the output, so reset it to 0
   this->LocalVideoBuffer->CopyImagesFromTrackedFrameList(savedDataBuffer, vtkPlusBuffer::READ_FILTERED_IGNORE_UNFILTERED_TIMESTAMPS, this->UseAllFrameFields);
-  savedDataBuffer->Clear();
 
+  return this->SetupVideoSources(this->LocalVideoBuffer->GetImageOrientation(), this->LocalVideoBuffer->GetFrameSize(),
+                                 this->LocalVideoBuffer->GetNumberOfScalarComponents(), this->LocalVideoBuffer->GetPixelType());
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSavedDataSource::SetupVideoSources(US_IMAGE_ORIENTATION imageOrientation, const FrameSizeType& frameSize, unsigned int numberOfScalarComponents, igsioCommon::VTKScalarPixelType pixelType)
+{
   PlusStatus result(PLUS_SUCCESS);
   for (DataSourceContainerIterator it = this->VideoSources.begin(); it != this->VideoSources.end(); ++it)
   {
     vtkPlusDataSource* source(it->second);
 
-    if (source->SetInputImageOrientation(this->LocalVideoBuffer->GetImageOrientation()) != PLUS_SUCCESS)
+    if (source->SetInputImageOrientation(imageOrientation) != PLUS_SUCCESS)
     {
       LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
       result = PLUS_FAIL;
       continue;
     }
 
-    if (source->SetInputFrameSize(this->LocalVideoBuffer->GetFrameSize()) != PLUS_SUCCESS)
+    if (source->SetInputFrameSize(frameSize) != PLUS_SUCCESS)
     {
       LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
       result = PLUS_FAIL;
       continue;
     }
 
-    if (source->SetNumberOfScalarComponents(this->LocalVideoBuffer->GetNumberOfScalarComponents()) != PLUS_SUCCESS)
+    if (source->SetNumberOfScalarComponents(numberOfScalarComponents) != PLUS_SUCCESS)
     {
       LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
       result = PLUS_FAIL;
@@ -530,14 +722,14 @@ PlusStatus vtkPlusSavedDataSource::InternalConnectVideo(vtkIGSIOTrackedFrameList
 
     source->Clear();
 
-    if (source->SetInputFrameSize(this->LocalVideoBuffer->GetFrameSize()) != PLUS_SUCCESS)
+    if (source->SetInputFrameSize(frameSize) != PLUS_SUCCESS)
     {
       LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
       result = PLUS_FAIL;
       continue;
     }
 
-    if (source->SetPixelType(this->LocalVideoBuffer->GetPixelType()) != PLUS_SUCCESS)
+    if (source->SetPixelType(pixelType) != PLUS_SUCCESS)
     {
       LOG_ERROR(source->GetId() << ": Failed to set video image orientation");
       result = PLUS_FAIL;
@@ -603,8 +795,6 @@ PlusStatus vtkPlusSavedDataSource::InternalConnectTracker(vtkIGSIOTrackedFrameLi
     this->LocalTrackerBuffers[tool->GetId()] = buffer;
   }
 
-  savedDataBuffer->Clear();
-
   ClearAllBuffers();
 
   return PLUS_SUCCESS;
@@ -613,10 +803,24 @@ PlusStatus vtkPlusSavedDataSource::InternalConnectTracker(vtkIGSIOTrackedFrameLi
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusSavedDataSource::InternalDisconnect()
 {
+  if (this->StreamReader.GetPointer() != NULL)
+  {
+    this->StreamReader->Close();
+    this->StreamReader = NULL;
+  }
+  this->SharedSequence = NULL;
   DeleteLocalBuffers();
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSavedDataSource::InternalStartRecording()
+{
+  // All devices are connected by now, so the file content is not needed anymore for sharing
+  this->SharedSequence = NULL;
+  return PLUS_SUCCESS;
+}
+
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusSavedDataSource::ReadConfiguration(vtkXMLDataElement* rootConfigElement)
 {
@@ -670,6 +874,13 @@ PlusStatus vtkPlusSavedDataSource::ReadConfiguration(vtkXMLDataElement* rootConf
 
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(RepeatEnabled, deviceConfig);
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(UseOriginalTimestamps, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(StreamingEnabled, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, StreamingWindowSize, deviceConfig);
+  if (this->StreamingWindowSize < 1)
+  {
+    LOG_WARNING("StreamingWindowSize must be at least 1. Using " << DEFAULT_STREAMING_WINDOW_SIZE << ".");
+    this->StreamingWindowSize = DEFAULT_STREAMING_WINDOW_SIZE;
+  }
 
   const char* useData = deviceConfig->GetAttribute("UseData");
   if (useData != NULL)
@@ -707,6 +918,11 @@ PlusStatus vtkPlusSavedDataSource::WriteConfiguration(vtkXMLDataElement* rootCon
   XML_WRITE_CSTRING_ATTRIBUTE_IF_NOT_NULL(SequenceFile, imageAcquisitionConfig);
   XML_WRITE_BOOL_ATTRIBUTE(RepeatEnabled, imageAcquisitionConfig);
   XML_WRITE_BOOL_ATTRIBUTE(UseOriginalTimestamps, imageAcquisitionConfig);
+  if (this->StreamingEnabled)
+  {
+    XML_WRITE_BOOL_ATTRIBUTE(StreamingEnabled, imageAcquisitionConfig);
+    imageAcquisitionConfig->SetIntAttribute("StreamingWindowSize", this->StreamingWindowSize);
+  }
 
   if (this->UseAllFrameFields)
   {
@@ -776,6 +992,8 @@ void vtkPlusSavedDataSource::SetLoopTimeRange(double loopStartTime, double loopS
 
   this->LastAddedFrameUid = this->LoopFirstFrameUid - 1;
   this->LastAddedLoopIndex = 0;
+
+  this->UpdateStreamingLoopRange();
 }
 
 //----------------------------------------------------------------------------
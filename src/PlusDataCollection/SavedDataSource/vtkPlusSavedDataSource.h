@@ -11,7 +11,9 @@ See License.txt for details.
 
 #include "vtkPlusDevice.h"
 
+class vtkIGSIOTrackedFrameList;
 class vtkPlusBuffer;
+class vtkPlusSequenceStreamReader;
 
 class vtkPlusDataCollectionExport vtkPlusSavedDataSource;
 
@@ -27,6 +29,9 @@ Attributes:
 \li UseOriginalTimestamps: if true then the original timestamps (recorded originally in the source file)
   will be replayed exactly, otherwise only the timestamp difference will be replayed exactly,
   starting from the current time (TRUE|FALSE)
+\li StreamingEnabled: if true then image data is read from the file during replay instead of loading
+  the whole file into memory at connect (TRUE|FALSE)
+\li StreamingWindowSize: number of frames that are read ahead of the replay position in streaming mode
 
 */
 class vtkPlusDataCollectionExport vtkPlusSavedDataSource : public vtkPlusDevice
@@ -73,6 +78,18 @@ public:
   /*! Read the timestamps from the file and use provide them in the output (instead of the current time) */
   vtkBooleanMacro( UseOriginalTimestamps, bool );
 
+  /*! Read image data from the file during replay instead of loading all frames at connect. Only uncompressed MetaImage files can be streamed. */
+  vtkGetMacro( StreamingEnabled, bool );
+  /*! Read image data from the file during replay instead of loading all frames at connect. Only uncompressed MetaImage files can be streamed. */
+  vtkSetMacro( StreamingEnabled, bool );
+  /*! Read image data from the file during replay instead of loading all frames at connect. Only uncompressed MetaImage files can be streamed. */
+  vtkBooleanMacro( StreamingEnabled, bool );
+
+  /*! Number of frames that are read ahead of the replay position in streaming mode */
+  vtkGetMacro( StreamingWindowSize, int );
+  /*! Number of frames that are read ahead of the replay position in streaming mode */
+  vtkSetMacro( StreamingWindowSize, int );
+
   /*! Get local video buffer */
   vtkGetObjectMacro( LocalVideoBuffer, vtkPlusBuffer );
 
@@ -98,12 +115,28 @@ protected:
   /*! Connect to device, in case the output is a video stream */
   virtual PlusStatus InternalConnectVideo( vtkIGSIOTrackedFrameList* savedDataBuffer );
 
+  /*! Connect to device, in case the output is a video stream that is read from the file during replay */
+  virtual PlusStatus InternalConnectVideoStreaming( vtkIGSIOTrackedFrameList* frameFields );
+
+  /*! Set the image properties of the output video sources */
+  PlusStatus SetupVideoSources( US_IMAGE_ORIENTATION imageOrientation, const FrameSizeType& frameSize, unsigned int numberOfScalarComponents, igsioCommon::VTKScalarPixelType pixelType );
+
   /*! Connect to device, in case the output is a tracker stream */
   virtual PlusStatus InternalConnectTracker( vtkIGSIOTrackedFrameList* savedDataBuffer );
 
   /*! Disconnect from device */
   virtual PlusStatus InternalDisconnect();
 
+  /*! Release the shared sequence file content, it is not needed once the local buffers are filled */
+  virtual PlusStatus InternalStartRecording();
+
+  /*!
+    Get the content of a sequence file. Sequence files are read only once and shared between all saved data sources
+    (for example a video source and several tool sources replaying the same file) as long as any of them holds a reference to it.
+    The file is read again if its modification time changes. The returned frame list must not be modified.
+  */
+  static vtkSmartPointer<vtkIGSIOTrackedFrameList> GetSharedSequence(const std::string& absoluteFilePath);
+
   /*! The internal function which actually does the grab.  */
   PlusStatus InternalUpdate();
 
@@ -113,6 +146,17 @@ protected:
   /*! Internal update, called when the original timestamps are used */
   PlusStatus InternalUpdateOriginalTimestamp( BufferItemUidType frameToBeAddedUid, int frameToBeAddedLoopIndex );
 
+  /*! Add the image of a local buffer item to the video sources. In streaming mode the image is read from the file. */
+  PlusStatus AddVideoItem( StreamBufferItem& dataBufferItem, double unfilteredTimestamp, double filteredTimestamp );
+
+  /*! Set the frames to be prefetched by the stream reader to the current loop range */
+  void UpdateStreamingLoopRange();
+
+  /*! Get the index of the frame in the sequence file that a local buffer item refers to (streaming mode only) */
+  PlusStatus GetStreamedFrameIndex( StreamBufferItem& dataBufferItem, unsigned int& frameIndex );
+  /*! Get the index of the frame in the sequence file that a local buffer item refers to (streaming mode only) */
+  PlusStatus GetStreamedFrameIndex( BufferItemUidType uid, unsigned int& frameIndex );
+
   BufferItemUidType GetClosestFrameUidWithinTimeRange( double time_Local, double startTime_Local, double stopTime_Local );
 
   /*! Get local tracker buffer */
@@ -181,6 +225,21 @@ protected:
 
   SimulatedStreamType SimulatedStream;
 
+  /*! Read image data from the file during replay instead of loading all frames at connect */
+  bool StreamingEnabled;
+
+  /*! Number of frames that are read ahead of the replay position in streaming mode */
+  int StreamingWindowSize;
+
+  /*! Reads image data from the file during replay. NULL if the whole file is loaded at connect. */
+  vtkSmartPointer<vtkPlusSequenceStreamReader> StreamReader;
+
+  /*! Image data of the frame that is being added in streaming mode */
+  std::vector<unsigned char> StreamedFramePixels;
+
+  /*! Content of the sequence file, shared with other saved data sources. Only kept between connect and start of recording. */
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> SharedSequence;
+
 private:
   static vtkPlusSavedDataSource* Instance;
   vtkPlusSavedDataSource( const vtkPlusSavedDataSource& ); // Not implemented.
@@ -0,0 +1,434 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "igsioTrackedFrame.h"
+#include "vtkIGSIOTrackedFrameList.h"
+#include "vtkObjectFactory.h"
+#include "vtkPlusSequenceStreamReader.h"
+#include "vtksys/SystemTools.hxx"
+
+#include <algorithm>
+#include <sstream>
+
+//----------------------------------------------------------------------------
+
+vtkStandardNewMacro(vtkPlusSequenceStreamReader);
+
+//----------------------------------------------------------------------------
+
+namespace
+{
+  const unsigned int DEFAULT_WINDOW_SIZE = 30;
+  const double DELAY_ON_FULL_WINDOW_SEC = 0.005; // wait time of the prefetch thread if all frames in the window are already read
+  const char* SEQUENCE_FIELD_PREFIX = "Seq_Frame";
+
+  //----------------------------------------------------------------------------
+  bool GetPixelTypeFromMetaElementType(const std::string& elementType, igsioCommon::VTKScalarPixelType& pixelType, unsigned int& pixelSizeInBytes)
+  {
+    struct MetaElementTypeInfo
+    {
+      const char* Name;
+      igsioCommon::VTKScalarPixelType PixelType;
+      unsigned int SizeInBytes;
+    };
+    static const MetaElementTypeInfo elementTypes[] =
+    {
+      { "MET_CHAR", VTK_CHAR, 1 },
+      { "MET_UCHAR", VTK_UNSIGNED_CHAR, 1 },
+      { "MET_SHORT", VTK_SHORT, 2 },
+      { "MET_USHORT", VTK_UNSIGNED_SHORT, 2 },
+      { "MET_INT", VTK_INT, 4 },
+      { "MET_UINT", VTK_UNSIGNED_INT, 4 },
+      { "MET_FLOAT", VTK_FLOAT, 4 },
+      { "MET_DOUBLE", VTK_DOUBLE, 8 }
+    };
+    for (unsigned int i = 0; i < sizeof(elementTypes) / sizeof(elementTypes[0]); ++i)
+    {
+      if (elementType == elementTypes[i].Name)
+      {
+        pixelType = elementTypes[i].PixelType;
+        pixelSizeInBytes = elementTypes[i].SizeInBytes;
+        return true;
+      }
+    }
+    return false;
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkPlusSequenceStreamReader::vtkPlusSequenceStreamReader()
+  : DataOffset(0)
+  , DataFileMutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
+  , NumberOfFrames(0)
+  , PixelType(VTK_UNSIGNED_CHAR)
+  , NumberOfScalarComponents(1)
+  , ImageType(US_IMG_BRIGHTNESS)
+  , ImageOrientation(US_IMG_ORIENT_MF)
+  , FrameSizeInBytes(0)
+  , WindowSize(DEFAULT_WINDOW_SIZE)
+  , LoopFirstFrameIndex(0)
+  , LoopLastFrameIndex(0)
+  , PlaybackPosition(0)
+  , PrefetchedFramesMutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
+  , Threader(vtkSmartPointer<vtkMultiThreader>::New())
+  , PrefetchThreadActive(std::make_pair(false, false))
+  , PrefetchThreadId(-1)
+{
+  this->FrameSize[0] = 0;
+  this->FrameSize[1] = 0;
+  this->FrameSize[2] = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusSequenceStreamReader::~vtkPlusSequenceStreamReader()
+{
+  this->Close();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusSequenceStreamReader::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "NumberOfFrames: " << this->NumberOfFrames << std::endl;
+  os << indent << "FrameSize: " << this->FrameSize[0] << " " << this->FrameSize[1] << " " << this->FrameSize[2] << std::endl;
+  os << indent << "WindowSize: " << this->WindowSize << std::endl;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceStreamReader::Open(const std::string& fileName, vtkIGSIOTrackedFrameList* frameFields)
+{
+  this->Close();
+
+  std::ifstream headerFile(fileName.c_str(), std::ios::in | std::ios::binary);
+  if (!headerFile.is_open())
+  {
+    LOG_ERROR("Unable to open sequence file: " << fileName);
+    return PLUS_FAIL;
+  }
+
+  int numberOfDimensions = 0;
+  std::vector<unsigned int> dimSize;
+  std::string elementType;
+  std::string elementDataFile;
+  bool compressed = false;
+  bool byteOrderMsb = false;
+  std::map<unsigned int, igsioTrackedFrame::FieldMapType> fieldsOfFrames;
+
+  // Header lines are "Key = Value", the last one is ElementDataFile
+  std::string line;
+  while (elementDataFile.empty() && std::getline(headerFile, line))
+  {
+    std::size_t separatorPos = line.find('=');
+    if (separatorPos == std::string::npos)
+    {
+      continue;
+    }
+    std::string key = igsioCommon::Trim(line.substr(0, separatorPos));
+    std::string value = igsioCommon::Trim(line.substr(separatorPos + 1));
+
+    if (key.compare(0, strlen(SEQUENCE_FIELD_PREFIX), SEQUENCE_FIELD_PREFIX) == 0)
+    {
+      // Seq_Frame0000_FieldName = value
+      std::size_t fieldNamePos = key.find('_', strlen(SEQUENCE_FIELD_PREFIX));
+      unsigned int frameIndex = 0;
+      if (fieldNamePos == std::string::npos || igsioCommon::StringToUInt(key.substr(strlen(SEQUENCE_FIELD_PREFIX), fieldNamePos - strlen(SEQUENCE_FIELD_PREFIX)).c_str(), frameIndex) != PLUS_SUCCESS)
+      {
+        LOG_WARNING("Unable to parse frame field name: " << key);
+        continue;
+      }
+      fieldsOfFrames[frameIndex][key.substr(fieldNamePos + 1)] = value;
+    }
+    else if (key == "NDims")
+    {
+      igsioCommon::StringToInt(value.c_str(), numberOfDimensions);
+    }
+    else if (key == "DimSize")
+    {
+      std::istringstream dimSizeStream(value);
+      unsigned int size = 0;
+      while (dimSizeStream >> size)
+      {
+        dimSize.push_back(size);
+      }
+    }
+    else if (key == "ElementType")
+    {
+      elementType = value;
+    }
+    else if (key == "ElementNumberOfChannels")
+    {
+      igsioCommon::StringToUInt(value.c_str(), this->NumberOfScalarComponents);
+    }
+    else if (key == "CompressedData")
+    {
+      compressed = igsioCommon::IsEqualInsensitive(value, "True");
+    }
+    else if (key == "BinaryDataByteOrderMSB" || key == "ElementByteOrderMSB")
+    {
+      byteOrderMsb = igsioCommon::IsEqualInsensitive(value, "True");
+    }
+    else if (key == "UltrasoundImageOrientation")
+    {
+      this->ImageOrientation = igsioVideoFrame::GetUsImageOrientationFromString(value.c_str());
+    }
+    else if (key == "UltrasoundImageType")
+    {
+      this->ImageType = igsioVideoFrame::GetUsImageTypeFromString(value.c_str());
+    }
+    else if (key == "ElementDataFile")
+    {
+      elementDataFile = value;
+    }
+  }
+
+  unsigned int pixelSizeInBytes = 0;
+  if (elementDataFile.empty() || (numberOfDimensions != 3 && numberOfDimensions != 4) || static_cast<int>(dimSize.size()) != numberOfDimensions)
+  {
+    LOG_DEBUG("Sequence file cannot be streamed, it is not a valid MetaImage sequence file: " << fileName);
+    return PLUS_FAIL;
+  }
+  if (compressed)
+  {
+    LOG_DEBUG("Sequence file cannot be streamed, it contains compressed pixel data: " << fileName);
+    return PLUS_FAIL;
+  }
+  if (!GetPixelTypeFromMetaElementType(elementType, this->PixelType, pixelSizeInBytes) || (byteOrderMsb && pixelSizeInBytes > 1))
+  {
+    LOG_DEBUG("Sequence file cannot be streamed, unsupported element type: " << elementType);
+    return PLUS_FAIL;
+  }
+
+  // The last dimension is the frame index
+  this->FrameSize[0] = dimSize[0];
+  this->FrameSize[1] = dimSize[1];
+  this->FrameSize[2] = (numberOfDimensions == 4 ? dimSize[2] : 1);
+  this->NumberOfFrames = dimSize[numberOfDimensions - 1];
+  this->FrameSizeInBytes = this->FrameSize[0] * this->FrameSize[1] * this->FrameSize[2] * this->NumberOfScalarComponents * pixelSizeInBytes;
+
+  std::string dataFileName = fileName;
+  if (elementDataFile == "LOCAL")
+  {
+    this->DataOffset = headerFile.tellg();
+  }
+  else
+  {
+    // Pixel data file path is relative to the header file
+    std::vector<std::string> dataFilePathComponents;
+    dataFilePathComponents.push_back(vtksys::SystemTools::GetFilenamePath(fileName) + "/");
+    dataFilePathComponents.push_back(elementDataFile);
+    dataFileName = vtksys::SystemTools::JoinPath(dataFilePathComponents);
+    this->DataOffset = 0;
+  }
+  headerFile.close();
+
+  this->DataFile.open(dataFileName.c_str(), std::ios::in | std::ios::binary);
+  if (!this->DataFile.is_open())
+  {
+    LOG_ERROR("Unable to open sequence pixel data file: " << dataFileName);
+    return PLUS_FAIL;
+  }
+
+  // Frames without image data, only with the fields
+  frameFields->Clear();
+  for (unsigned int frameIndex = 0; frameIndex < this->NumberOfFrames; ++frameIndex)
+  {
+    igsioTrackedFrame frame;
+    igsioTrackedFrame::FieldMapType& fields = fieldsOfFrames[frameIndex];
+    for (igsioTrackedFrame::FieldMapType::iterator fieldIt = fields.begin(); fieldIt != fields.end(); ++fieldIt)
+    {
+      frame.SetFrameField(fieldIt->first, fieldIt->second);
+      if (igsioCommon::IsEqualInsensitive(fieldIt->first, "Timestamp"))
+      {
+        double timestamp = 0;
+        if (igsioCommon::StringToDouble(fieldIt->second.c_str(), timestamp) == PLUS_SUCCESS)
+        {
+          frame.SetTimestamp(timestamp);
+        }
+      }
+    }
+    frameFields->AddTrackedFrame(&frame);
+  }
+
+  this->SetLoopRange(0, this->NumberOfFrames > 0 ? this->NumberOfFrames - 1 : 0);
+
+  LOG_DEBUG("Opened sequence file for streaming: " << fileName << " (" << this->NumberOfFrames << " frames)");
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusSequenceStreamReader::Close()
+{
+  this->StopPrefetch();
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> fileLock(this->DataFileMutex);
+  if (this->DataFile.is_open())
+  {
+    this->DataFile.close();
+  }
+  this->NumberOfFrames = 0;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceStreamReader::StartPrefetch()
+{
+  if (this->PrefetchThreadId >= 0)
+  {
+    return PLUS_SUCCESS;
+  }
+  this->PrefetchThreadActive.first = true;
+  this->PrefetchThreadId = this->Threader->SpawnThread((vtkThreadFunctionType)&PrefetchThread, this);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusSequenceStreamReader::StopPrefetch()
+{
+  if (this->PrefetchThreadId >= 0)
+  {
+    this->PrefetchThreadActive.first = false;
+    while (this->PrefetchThreadActive.second)
+    {
+      // Wait until the thread stops
+      vtkIGSIOAccurateTimer::Delay(0.1);
+    }
+    this->PrefetchThreadId = -1;
+  }
+
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> prefetchLock(this->PrefetchedFramesMutex);
+  this->PrefetchedFrames.clear();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusSequenceStreamReader::SetLoopRange(unsigned int firstFrameIndex, unsigned int lastFrameIndex)
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> prefetchLock(this->PrefetchedFramesMutex);
+  this->LoopFirstFrameIndex = firstFrameIndex;
+  this->LoopLastFrameIndex = std::max(firstFrameIndex, lastFrameIndex);
+  this->PlaybackPosition = firstFrameIndex;
+}
+
+//----------------------------------------------------------------------------
+unsigned int vtkPlusSequenceStreamReader::GetWindowFrameIndex(unsigned int windowPosition) const
+{
+  unsigned int numberOfFramesInLoop = this->LoopLastFrameIndex - this->LoopFirstFrameIndex + 1;
+  unsigned int playbackOffset = 0;
+  if (this->PlaybackPosition >= this->LoopFirstFrameIndex && this->PlaybackPosition <= this->LoopLastFrameIndex)
+  {
+    playbackOffset = this->PlaybackPosition - this->LoopFirstFrameIndex;
+  }
+  return this->LoopFirstFrameIndex + (playbackOffset + windowPosition) % numberOfFramesInLoop;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusSequenceStreamReader::IsFrameInWindow(unsigned int frameIndex) const
+{
+  unsigned int windowSize = std::min(this->WindowSize, this->LoopLastFrameIndex - this->LoopFirstFrameIndex + 1);
+  for (unsigned int windowPosition = 0; windowPosition < windowSize; ++windowPosition)
+  {
+    if (this->GetWindowFrameIndex(windowPosition) == frameIndex)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceStreamReader::GetFramePixels(unsigned int frameIndex, std::vector<unsigned char>& pixels)
+{
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> prefetchLock(this->PrefetchedFramesMutex);
+    this->PlaybackPosition = (frameIndex >= this->LoopLastFrameIndex ? this->LoopFirstFrameIndex : frameIndex + 1);
+    std::map<unsigned int, std::vector<unsigned char> >::iterator frameIt = this->PrefetchedFrames.find(frameIndex);
+    if (frameIt != this->PrefetchedFrames.end())
+    {
+      pixels.swap(frameIt->second);
+      this->PrefetchedFrames.erase(frameIt);
+      return PLUS_SUCCESS;
+    }
+  }
+
+  LOG_TRACE("Frame " << frameIndex << " is not prefetched, read it now");
+  return this->ReadFramePixels(frameIndex, pixels);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusSequenceStreamReader::ReadFramePixels(unsigned int frameIndex, std::vector<unsigned char>& pixels)
+{
+  if (frameIndex >= this->NumberOfFrames)
+  {
+    LOG_ERROR("Frame index " << frameIndex << " is out of range, the sequence contains " << this->NumberOfFrames << " frames");
+    return PLUS_FAIL;
+  }
+
+  pixels.resize(this->FrameSizeInBytes);
+
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> fileLock(this->DataFileMutex);
+  this->DataFile.clear();
+  this->DataFile.seekg(this->DataOffset + static_cast<std::streamoff>(frameIndex) * this->FrameSizeInBytes, std::ios::beg);
+  this->DataFile.read(reinterpret_cast<char*>(pixels.data()), this->FrameSizeInBytes);
+  if (static_cast<unsigned int>(this->DataFile.gcount()) != this->FrameSizeInBytes)
+  {
+    LOG_ERROR("Unable to read pixel data of frame " << frameIndex << " from the sequence file");
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void* vtkPlusSequenceStreamReader::PrefetchThread(vtkMultiThreader::ThreadInfo* data)
+{
+  vtkPlusSequenceStreamReader* self = (vtkPlusSequenceStreamReader*)(data->UserData);
+  self->PrefetchThreadActive.second = true;
+
+  std::vector<unsigned char> pixels;
+  while (self->PrefetchThreadActive.first)
+  {
+    // Drop frames that fell out of the window and find the first missing one
+    bool frameToReadFound = false;
+    unsigned int frameToRead = 0;
+    {
+      igsioLockGuard<vtkIGSIORecursiveCriticalSection> prefetchLock(self->PrefetchedFramesMutex);
+      for (std::map<unsigned int, std::vector<unsigned char> >::iterator frameIt = self->PrefetchedFrames.begin(); frameIt != self->PrefetchedFrames.end();)
+      {
+        if (self->IsFrameInWindow(frameIt->first))
+        {
+          ++frameIt;
+        }
+        else
+        {
+          self->PrefetchedFrames.erase(frameIt++);
+        }
+      }
+      unsigned int windowSize = std::min(self->WindowSize, self->LoopLastFrameIndex - self->LoopFirstFrameIndex + 1);
+      for (unsigned int windowPosition = 0; windowPosition < windowSize; ++windowPosition)
+      {
+        unsigned int frameIndex = self->GetWindowFrameIndex(windowPosition);
+        if (self->PrefetchedFrames.find(frameIndex) == self->PrefetchedFrames.end())
+        {
+          frameToRead = frameIndex;
+          frameToReadFound = true;
+          break;
+        }
+      }
+    }
+
+    if (!frameToReadFound || self->ReadFramePixels(frameToRead, pixels) != PLUS_SUCCESS)
+    {
+      vtkIGSIOAccurateTimer::Delay(DELAY_ON_FULL_WINDOW_SEC);
+      continue;
+    }
+
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> prefetchLock(self->PrefetchedFramesMutex);
+    if (self->IsFrameInWindow(frameToRead))
+    {
+      self->PrefetchedFrames[frameToRead].swap(pixels);
+    }
+  }
+
+  self->PrefetchThreadActive.second = false;
+  return NULL;
+}
@@ -0,0 +1,128 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusSequenceStreamReader_h
+#define __vtkPlusSequenceStreamReader_h
+
+#include "PlusConfigure.h"
+#include "vtkPlusDataCollectionExport.h"
+
+#include "igsioCommon.h"
+#include "igsioVideoFrame.h"
+#include <vtkMultiThreader.h>
+#include <vtkObject.h>
+
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+class vtkIGSIOTrackedFrameList;
+
+/*!
+\class vtkPlusSequenceStreamReader
+\brief Reads the frames of an uncompressed MetaImage sequence file on demand
+
+Only the header (image geometry and frame fields) is read when the file is opened. Pixel data of a frame is read from the file
+when it is requested. A prefetch thread keeps a window of frames following the current playback position in memory,
+wrapping around at the end of the loop range, so memory usage does not depend on the length of the sequence.
+
+\ingroup PlusLibDataCollection
+*/
+class vtkPlusDataCollectionExport vtkPlusSequenceStreamReader : public vtkObject
+{
+public:
+  static vtkPlusSequenceStreamReader* New();
+  vtkTypeMacro(vtkPlusSequenceStreamReader, vtkObject);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  /*!
+    Read the header of the sequence file. The frame fields (including timestamps and transforms) are stored in frameFields,
+    the tracked frames contain no image data. Fails if the file is not an uncompressed MetaImage sequence.
+  */
+  PlusStatus Open(const std::string& fileName, vtkIGSIOTrackedFrameList* frameFields);
+
+  /*! Stop prefetching and close the file */
+  void Close();
+
+  /*! Start the prefetch thread */
+  PlusStatus StartPrefetch();
+
+  /*! Stop the prefetch thread and release the prefetched frames */
+  void StopPrefetch();
+
+  /*! Set the range of frames that are replayed. Prefetching wraps around from the last to the first frame. */
+  void SetLoopRange(unsigned int firstFrameIndex, unsigned int lastFrameIndex);
+
+  /*!
+    Get the pixel data of a frame. The frame is taken from the prefetched frames if available, otherwise it is read synchronously.
+    The playback position is moved to the frame following the requested one.
+  */
+  PlusStatus GetFramePixels(unsigned int frameIndex, std::vector<unsigned char>& pixels);
+
+  /*! Maximum number of frames that are prefetched */
+  vtkSetMacro(WindowSize, unsigned int);
+  vtkGetMacro(WindowSize, unsigned int);
+
+  unsigned int GetNumberOfFrames() const { return this->NumberOfFrames; }
+  const FrameSizeType& GetFrameSize() const { return this->FrameSize; }
+  igsioCommon::VTKScalarPixelType GetPixelType() const { return this->PixelType; }
+  unsigned int GetNumberOfScalarComponents() const { return this->NumberOfScalarComponents; }
+  US_IMAGE_TYPE GetImageType() const { return this->ImageType; }
+  US_IMAGE_ORIENTATION GetImageOrientation() const { return this->ImageOrientation; }
+
+protected:
+  vtkPlusSequenceStreamReader();
+  virtual ~vtkPlusSequenceStreamReader();
+
+  /*! Read the pixel data of a frame from the file */
+  PlusStatus ReadFramePixels(unsigned int frameIndex, std::vector<unsigned char>& pixels);
+
+  /*! Index of the frame at the given position in the prefetch window */
+  unsigned int GetWindowFrameIndex(unsigned int windowPosition) const;
+
+  /*! True if the frame is in the current prefetch window */
+  bool IsFrameInWindow(unsigned int frameIndex) const;
+
+  static void* PrefetchThread(vtkMultiThreader::ThreadInfo* data);
+
+protected:
+  /*! File containing the pixel data */
+  std::ifstream DataFile;
+  /*! Position of the first frame in the data file */
+  std::streamoff DataOffset;
+  /*! Protects the data file, as frames are read by the prefetch and the playback thread */
+  vtkSmartPointer<vtkIGSIORecursiveCriticalSection> DataFileMutex;
+
+  unsigned int NumberOfFrames;
+  FrameSizeType FrameSize;
+  igsioCommon::VTKScalarPixelType PixelType;
+  unsigned int NumberOfScalarComponents;
+  US_IMAGE_TYPE ImageType;
+  US_IMAGE_ORIENTATION ImageOrientation;
+  unsigned int FrameSizeInBytes;
+
+  unsigned int WindowSize;
+  unsigned int LoopFirstFrameIndex;
+  unsigned int LoopLastFrameIndex;
+  /*! Index of the frame that is expected to be requested next */
+  unsigned int PlaybackPosition;
+  /*! Prefetched frames, keyed by frame index */
+  std::map<unsigned int, std::vector<unsigned char> > PrefetchedFrames;
+  /*! Protects the prefetched frames and the playback position */
+  vtkSmartPointer<vtkIGSIORecursiveCriticalSection> PrefetchedFramesMutex;
+
+  vtkSmartPointer<vtkMultiThreader> Threader;
+  /*! First: thread is requested to run, second: thread is running */
+  std::pair<bool, bool> PrefetchThreadActive;
+  int PrefetchThreadId;
+
+private:
+  vtkPlusSequenceStreamReader(const vtkPlusSequenceStreamReader&);  // Not implemented.
+  void operator=(const vtkPlusSequenceStreamReader&);  // Not implemented.
+};
+
+#endif
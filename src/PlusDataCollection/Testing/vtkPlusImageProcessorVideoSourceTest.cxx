@@ -0,0 +1,256 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusImageProcessorVideoSourceTest.cxx
+  \brief This program tests parallel processing of vtkPlusImageProcessorVideoSource.
+  Frames are added to the input buffer in batches while a pool of processors with different
+  processing times is running, so frames are processed out of order. Every input frame must
+  be added to the output buffer, in timestamp order.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataSource.h"
+#include "vtkPlusImageProcessorVideoSource.h"
+#include "vtkPlusTrackedFrameProcessor.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <algorithm>
+#include <vector>
+
+namespace
+{
+  const int NUMBER_OF_FRAMES = 50;
+  const int NUMBER_OF_FRAMES_PER_UPDATE = 7;
+  const double FRAME_PERIOD_SEC = 0.1;
+  const double PROCESSING_TIME_STEP_SEC = 0.002;
+}
+
+//----------------------------------------------------------------------------
+/*! Processor that keeps the input frame unchanged and takes a fixed time to process a frame */
+class vtkPlusImageProcessorTestProcessor : public vtkPlusTrackedFrameProcessor
+{
+public:
+  static vtkPlusImageProcessorTestProcessor* New();
+  vtkTypeMacro(vtkPlusImageProcessorTestProcessor, vtkPlusTrackedFrameProcessor);
+
+  virtual const char* GetProcessorTypeName() { return "vtkPlusImageProcessorTestProcessor"; }
+
+  vtkSetMacro(ProcessingTimeSec, double);
+
+protected:
+  vtkPlusImageProcessorTestProcessor() : ProcessingTimeSec(0.0) {}
+  virtual ~vtkPlusImageProcessorTestProcessor() {}
+
+  virtual PlusStatus ProcessFrame(igsioTrackedFrame* inputFrame, igsioTrackedFrame* outputFrame)
+  {
+    // The output frame is already a copy of the input frame
+    vtkIGSIOAccurateTimer::Delay(this->ProcessingTimeSec);
+    return PLUS_SUCCESS;
+  }
+
+  double ProcessingTimeSec;
+};
+
+vtkStandardNewMacro(vtkPlusImageProcessorTestProcessor);
+
+//----------------------------------------------------------------------------
+/*! Gives access to the processor pool and the processing threads of the image processor device */
+class vtkPlusImageProcessorVideoSourceTester : public vtkPlusImageProcessorVideoSource
+{
+public:
+  static vtkPlusImageProcessorVideoSourceTester* New();
+  vtkTypeMacro(vtkPlusImageProcessorVideoSourceTester, vtkPlusImageProcessorVideoSource);
+
+  /*! Create the processors. The first processor is the slowest, so later frames are often processed before earlier ones. */
+  void SetUpProcessorPool(int numberOfProcessors)
+  {
+    this->NumberOfProcessingThreads = numberOfProcessors;
+    for (int i = 0; i < numberOfProcessors; ++i)
+    {
+      vtkPlusImageProcessorTestProcessor* processor = vtkPlusImageProcessorTestProcessor::New();
+      processor->SetProcessingTimeSec(PROCESSING_TIME_STEP_SEC * (numberOfProcessors - i));
+      if (i == 0)
+      {
+        this->ProcessorAlgorithm = processor;
+      }
+      else
+      {
+        this->ProcessorPool.push_back(processor);
+      }
+    }
+  }
+
+  PlusStatus StartProcessingThreads() { return this->InternalStartRecording(); }
+  PlusStatus StopProcessingThreads() { return this->InternalStopRecording(); }
+  PlusStatus QueueNewFrames() { return this->InternalUpdate(); }
+
+protected:
+  vtkPlusImageProcessorVideoSourceTester() {}
+  virtual ~vtkPlusImageProcessorVideoSourceTester() {}
+};
+
+vtkStandardNewMacro(vtkPlusImageProcessorVideoSourceTester);
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  vtkSmartPointer<vtkPlusChannel> CreateVideoChannel(const char* channelId, const char* sourceId, const FrameSizeType& frameSize)
+  {
+    vtkSmartPointer<vtkPlusDataSource> videoSource = vtkSmartPointer<vtkPlusDataSource>::New();
+    videoSource->SetSourceId(sourceId);
+    videoSource->SetInputImageOrientation(US_IMG_ORIENT_MF);
+    videoSource->SetImageType(US_IMG_BRIGHTNESS);
+    videoSource->SetPixelType(VTK_UNSIGNED_CHAR);
+    videoSource->SetNumberOfScalarComponents(1);
+    videoSource->SetInputFrameSize(frameSize);
+    videoSource->SetBufferSize(NUMBER_OF_FRAMES);
+
+    vtkSmartPointer<vtkPlusChannel> channel = vtkSmartPointer<vtkPlusChannel>::New();
+    channel->SetChannelId(channelId);
+    channel->SetVideoSource(videoSource);
+    return channel;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int numberOfProcessingThreads(4);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--processing-threads", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfProcessingThreads, "Number of processing threads (Default: 4).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (numberOfProcessingThreads < 2)
+  {
+    std::cerr << "--processing-threads must be at least 2, as frames are only processed in parallel by multiple threads" << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  FrameSizeType frameSize = {16, 16, 1};
+  vtkSmartPointer<vtkPlusChannel> inputChannel = CreateVideoChannel("InputChannel", "InputVideo", frameSize);
+  vtkSmartPointer<vtkPlusChannel> outputChannel = CreateVideoChannel("OutputChannel", "OutputVideo", frameSize);
+
+  vtkSmartPointer<vtkPlusImageProcessorVideoSourceTester> imageProcessor = vtkSmartPointer<vtkPlusImageProcessorVideoSourceTester>::New();
+  imageProcessor->SetDeviceId("ImageProcessor");
+  imageProcessor->SetUpProcessorPool(numberOfProcessingThreads);
+  imageProcessor->AddInputChannel(inputChannel);
+  imageProcessor->AddOutputChannel(outputChannel);
+
+  if (imageProcessor->StartProcessingThreads() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to start the processing threads");
+    return EXIT_FAILURE;
+  }
+
+  // Each frame is filled with its index, so that frames can be told apart in the output
+  vtkPlusDataSource* inputSource(NULL);
+  inputChannel->GetVideoSource(inputSource);
+  std::vector<unsigned char> pixels(frameSize[0] * frameSize[1] * frameSize[2]);
+  std::vector<double> inputTimestamps;
+  for (int frameIndex = 0; frameIndex < NUMBER_OF_FRAMES; ++frameIndex)
+  {
+    std::fill(pixels.begin(), pixels.end(), static_cast<unsigned char>(frameIndex));
+    double timestamp = 1.0 + frameIndex * FRAME_PERIOD_SEC;
+    if (inputSource->AddItem(&pixels[0], US_IMG_ORIENT_MF, frameSize, VTK_UNSIGNED_CHAR, 1, US_IMG_BRIGHTNESS, 0, frameIndex, timestamp, timestamp) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to add frame " << frameIndex << " to the input buffer");
+      return EXIT_FAILURE;
+    }
+    inputTimestamps.push_back(timestamp);
+
+    if ((frameIndex + 1) % NUMBER_OF_FRAMES_PER_UPDATE == 0 && imageProcessor->QueueNewFrames() != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to queue input frames for processing");
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Frames are only queued up to a limit in an update, keep updating until all of them are queued
+  vtkPlusDataSource* outputSource(NULL);
+  outputChannel->GetVideoSource(outputSource);
+  const double timeoutSec = 10.0;
+  double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  while (outputSource->GetNumberOfItems() < NUMBER_OF_FRAMES && vtkIGSIOAccurateTimer::GetSystemTime() - startTime < timeoutSec)
+  {
+    if (imageProcessor->QueueNewFrames() != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to queue input frames for processing");
+      return EXIT_FAILURE;
+    }
+    vtkIGSIOAccurateTimer::Delay(0.01);
+  }
+
+  if (imageProcessor->StopProcessingThreads() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to stop the processing threads");
+    return EXIT_FAILURE;
+  }
+
+  if (outputSource->GetNumberOfItems() != NUMBER_OF_FRAMES)
+  {
+    LOG_ERROR("Number of output frames is " << outputSource->GetNumberOfItems() << ", expected " << NUMBER_OF_FRAMES);
+    return EXIT_FAILURE;
+  }
+
+  int numberOfErrors(0);
+  BufferItemUidType outputUid = outputSource->GetOldestItemUidInBuffer();
+  for (int frameIndex = 0; frameIndex < NUMBER_OF_FRAMES; ++frameIndex, ++outputUid)
+  {
+    StreamBufferItem outputItem;
+    if (outputSource->GetStreamBufferItem(outputUid, &outputItem) != ITEM_OK)
+    {
+      LOG_ERROR("Failed to get output frame " << frameIndex);
+      return EXIT_FAILURE;
+    }
+    if (outputItem.GetFilteredTimestamp(0) != inputTimestamps[frameIndex])
+    {
+      LOG_ERROR("Output frame " << frameIndex << " timestamp is " << std::fixed << outputItem.GetFilteredTimestamp(0) << ", expected " << inputTimestamps[frameIndex]);
+      ++numberOfErrors;
+    }
+    const unsigned char* outputPixels = static_cast<const unsigned char*>(outputItem.GetFrame().GetScalarPointer());
+    if (outputPixels == NULL || outputPixels[0] != static_cast<unsigned char>(frameIndex))
+    {
+      LOG_ERROR("Output frame " << frameIndex << " does not contain input frame " << frameIndex);
+      ++numberOfErrors;
+    }
+  }
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Output frames are not in input order. Number of errors: " << numberOfErrors);
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully!");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,230 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusSequenceStreamReaderTest.cxx
+  \brief Writes an uncompressed sequence file, reads it back with vtkPlusSequenceStreamReader and verifies
+  the frame fields and the pixel data of the frames, with and without prefetching. Also checks that a
+  compressed sequence file is rejected.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "igsioTrackedFrame.h"
+#include "igsioVideoFrame.h"
+#include "vtkIGSIOTrackedFrameList.h"
+#include "vtkPlusSequenceIO.h"
+#include "vtkPlusSequenceStreamReader.h"
+
+// VTK includes
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <sstream>
+
+namespace
+{
+  const unsigned int NUMBER_OF_FRAMES = 20;
+  const unsigned int LOOP_FIRST_FRAME_INDEX = 5;
+  const unsigned int LOOP_LAST_FRAME_INDEX = 14;
+  const unsigned int PREFETCH_WINDOW_SIZE = 4;
+  const unsigned int NUMBER_OF_REPLAYED_LOOPS = 3;
+  const char* TEST_FIELD_NAME = "TestFrameIndex";
+
+  //----------------------------------------------------------------------------
+  unsigned char GetExpectedPixelValue(unsigned int frameIndex, unsigned int pixelIndex)
+  {
+    return static_cast<unsigned char>(frameIndex * 31 + pixelIndex * 7 + (pixelIndex >> 8));
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus CreateFrameList(vtkIGSIOTrackedFrameList* frameList)
+  {
+    FrameSizeType frameSize = { 64, 48, 1 };
+    for (unsigned int frameIndex = 0; frameIndex < NUMBER_OF_FRAMES; ++frameIndex)
+    {
+      igsioTrackedFrame trackedFrame;
+      if (trackedFrame.GetImageData()->AllocateFrame(frameSize, VTK_UNSIGNED_CHAR, 1) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to allocate frame");
+        return PLUS_FAIL;
+      }
+      unsigned char* pixels = static_cast<unsigned char*>(trackedFrame.GetImageData()->GetScalarPointer());
+      unsigned long frameSizeBytes = trackedFrame.GetImageData()->GetFrameSizeInBytes();
+      for (unsigned long i = 0; i < frameSizeBytes; ++i)
+      {
+        pixels[i] = GetExpectedPixelValue(frameIndex, i);
+      }
+      trackedFrame.SetTimestamp(10.0 + 0.1 * frameIndex);
+      std::ostringstream frameIndexStr;
+      frameIndexStr << frameIndex;
+      trackedFrame.SetFrameField(TEST_FIELD_NAME, frameIndexStr.str());
+      frameList->AddTrackedFrame(&trackedFrame);
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus CheckFramePixels(vtkPlusSequenceStreamReader* reader, unsigned int frameIndex)
+  {
+    std::vector<unsigned char> pixels;
+    if (reader->GetFramePixels(frameIndex, pixels) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to get pixels of frame " << frameIndex);
+      return PLUS_FAIL;
+    }
+    const FrameSizeType& frameSize = reader->GetFrameSize();
+    if (pixels.size() != frameSize[0] * frameSize[1] * frameSize[2])
+    {
+      LOG_ERROR("Pixel data size mismatch in frame " << frameIndex << ": " << pixels.size());
+      return PLUS_FAIL;
+    }
+    for (unsigned int i = 0; i < pixels.size(); ++i)
+    {
+      if (pixels[i] != GetExpectedPixelValue(frameIndex, i))
+      {
+        LOG_ERROR("Pixel value mismatch in frame " << frameIndex << " at position " << i << ": expected " << static_cast<int>(GetExpectedPixelValue(frameIndex, i)) << ", got " << static_cast<int>(pixels[i]));
+        return PLUS_FAIL;
+      }
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus CheckFrameFields(vtkPlusSequenceStreamReader* reader, vtkIGSIOTrackedFrameList* frameFields)
+  {
+    if (reader->GetNumberOfFrames() != NUMBER_OF_FRAMES || frameFields->GetNumberOfTrackedFrames() != NUMBER_OF_FRAMES)
+    {
+      LOG_ERROR("Number of frames mismatch: expected " << NUMBER_OF_FRAMES << ", got " << reader->GetNumberOfFrames() << " (" << frameFields->GetNumberOfTrackedFrames() << " frame fields)");
+      return PLUS_FAIL;
+    }
+    if (reader->GetFrameSize()[0] != 64 || reader->GetFrameSize()[1] != 48 || reader->GetFrameSize()[2] != 1
+        || reader->GetPixelType() != VTK_UNSIGNED_CHAR || reader->GetNumberOfScalarComponents() != 1)
+    {
+      LOG_ERROR("Image geometry mismatch");
+      return PLUS_FAIL;
+    }
+    for (unsigned int frameIndex = 0; frameIndex < NUMBER_OF_FRAMES; ++frameIndex)
+    {
+      igsioTrackedFrame* frame = frameFields->GetTrackedFrame(frameIndex);
+      if (fabs(frame->GetTimestamp() - (10.0 + 0.1 * frameIndex)) > 1e-6)
+      {
+        LOG_ERROR("Timestamp mismatch in frame " << frameIndex << ": " << frame->GetTimestamp());
+        return PLUS_FAIL;
+      }
+      std::ostringstream frameIndexStr;
+      frameIndexStr << frameIndex;
+      if (!frame->IsFrameFieldDefined(TEST_FIELD_NAME) || frameIndexStr.str() != std::string(frame->GetFrameField(TEST_FIELD_NAME)))
+      {
+        LOG_ERROR("Frame field " << TEST_FIELD_NAME << " mismatch in frame " << frameIndex);
+        return PLUS_FAIL;
+      }
+    }
+    return PLUS_SUCCESS;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> frameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  if (CreateFrameList(frameList) != PLUS_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+  std::string uncompressedFileName = vtkPlusConfig::GetInstance()->GetOutputPath("vtkPlusSequenceStreamReaderTest.igs.mha");
+  std::string compressedFileName = vtkPlusConfig::GetInstance()->GetOutputPath("vtkPlusSequenceStreamReaderTestCompressed.igs.mha");
+  if (vtkPlusSequenceIO::Write(uncompressedFileName, frameList, US_IMG_ORIENT_MF, false) != PLUS_SUCCESS
+      || vtkPlusSequenceIO::Write(compressedFileName, frameList, US_IMG_ORIENT_MF, true) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to write the test sequence files");
+    return EXIT_FAILURE;
+  }
+
+  // Compressed files cannot be streamed
+  vtkSmartPointer<vtkPlusSequenceStreamReader> reader = vtkSmartPointer<vtkPlusSequenceStreamReader>::New();
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> frameFields = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  if (reader->Open(compressedFileName, frameFields) == PLUS_SUCCESS)
+  {
+    LOG_ERROR("Opening a compressed sequence file for streaming is expected to fail");
+    return EXIT_FAILURE;
+  }
+
+  if (reader->Open(uncompressedFileName, frameFields) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to open sequence file for streaming: " << uncompressedFileName);
+    return EXIT_FAILURE;
+  }
+  if (CheckFrameFields(reader, frameFields) != PLUS_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+
+  // Frames are read synchronously in arbitrary order if prefetching is not running
+  for (unsigned int i = 0; i < NUMBER_OF_FRAMES; ++i)
+  {
+    if (CheckFramePixels(reader, (i * 7) % NUMBER_OF_FRAMES) != PLUS_SUCCESS)
+    {
+      return EXIT_FAILURE;
+    }
+  }
+
+  // Replay the loop range a few times with prefetching, wrapping around at the end of the range
+  reader->SetWindowSize(PREFETCH_WINDOW_SIZE);
+  reader->SetLoopRange(LOOP_FIRST_FRAME_INDEX, LOOP_LAST_FRAME_INDEX);
+  if (reader->StartPrefetch() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to start prefetching");
+    return EXIT_FAILURE;
+  }
+  for (unsigned int loopIndex = 0; loopIndex < NUMBER_OF_REPLAYED_LOOPS; ++loopIndex)
+  {
+    for (unsigned int frameIndex = LOOP_FIRST_FRAME_INDEX; frameIndex <= LOOP_LAST_FRAME_INDEX; ++frameIndex)
+    {
+      if (CheckFramePixels(reader, frameIndex) != PLUS_SUCCESS)
+      {
+        reader->StopPrefetch();
+        return EXIT_FAILURE;
+      }
+      vtkIGSIOAccurateTimer::Delay(0.01);
+    }
+  }
+  reader->StopPrefetch();
+
+  // Frames outside the loop range are still available after prefetching is stopped
+  if (CheckFramePixels(reader, 0) != PLUS_SUCCESS || CheckFramePixels(reader, NUMBER_OF_FRAMES - 1) != PLUS_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+
+  reader->Close();
+  LOG_INFO("Test completed successfully!");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,257 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusVirtualVolumeReconstructorTest.cxx
+  \brief This program tests background reconstruction of vtkPlusVirtualVolumeReconstructor.
+  Frames are queued for the reconstruction thread and the thread is stopped right away.
+  The volume must contain all the queued frames, i.e., it must be identical to a volume
+  that is reconstructed by inserting the same frames directly.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkIGSIOSequenceIO.h"
+#include "vtkIGSIOTrackedFrameList.h"
+#include "vtkIGSIOTransformRepository.h"
+#include "vtkPlusVirtualVolumeReconstructor.h"
+#include "vtkPlusVolumeReconstructor.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkObjectFactory.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+namespace
+{
+  const int NUMBER_OF_FRAMES_PER_LIST = 5;
+}
+
+//----------------------------------------------------------------------------
+/*! Gives access to the reconstruction thread and frame queue of the virtual volume reconstructor */
+class vtkPlusVirtualVolumeReconstructorTester : public vtkPlusVirtualVolumeReconstructor
+{
+public:
+  static vtkPlusVirtualVolumeReconstructorTester* New();
+  vtkTypeMacro(vtkPlusVirtualVolumeReconstructorTester, vtkPlusVirtualVolumeReconstructor);
+
+  PlusStatus Configure(vtkXMLDataElement* configRootElement, const igsioTransformName& imageToReferenceTransformName, vtkIGSIOTrackedFrameList* frames, vtkIGSIOTransformRepository* transformRepository)
+  {
+    if (this->VolumeReconstructor->ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to read volume reconstruction configuration");
+      return PLUS_FAIL;
+    }
+    this->VolumeReconstructor->SetImageCoordinateFrame(imageToReferenceTransformName.From().c_str());
+    this->VolumeReconstructor->SetReferenceCoordinateFrame(imageToReferenceTransformName.To().c_str());
+    std::string errorDetail;
+    if (this->VolumeReconstructor->SetOutputExtentFromFrameList(frames, transformRepository, errorDetail) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to set output extent of volume: " << errorDetail);
+      return PLUS_FAIL;
+    }
+    return this->UpdateTransformRepository(transformRepository);
+  }
+
+  PlusStatus InsertFrames(vtkIGSIOTrackedFrameList* frames)
+  {
+    return this->AddFrames(frames);
+  }
+
+  void QueueFrames(vtkIGSIOTrackedFrameList* frames)
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> pendingLock(this->PendingFrameListsMutex);
+    this->PendingFrameLists.push_back(frames);
+  }
+
+  PlusStatus StartReconstructionThread() { return this->InternalStartRecording(); }
+  PlusStatus StopReconstructionThread() { return this->InternalStopRecording(); }
+  bool IsReconstructionThreadRunning() const { return this->ReconstructionThreadActive.second; }
+  int GetNumberOfQueuedFrameLists() { return this->GetNumberOfPendingFrameLists(); }
+
+protected:
+  vtkPlusVirtualVolumeReconstructorTester() {}
+  virtual ~vtkPlusVirtualVolumeReconstructorTester() {}
+};
+
+vtkStandardNewMacro(vtkPlusVirtualVolumeReconstructorTester);
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  bool AreVolumesEqual(vtkImageData* volume1, vtkImageData* volume2)
+  {
+    int* extent1 = volume1->GetExtent();
+    int* extent2 = volume2->GetExtent();
+    for (int i = 0; i < 6; ++i)
+    {
+      if (extent1[i] != extent2[i])
+      {
+        LOG_ERROR("Volume extent mismatch at index " << i << ": " << extent1[i] << " != " << extent2[i]);
+        return false;
+      }
+    }
+    if (volume1->GetScalarType() != volume2->GetScalarType()
+        || volume1->GetNumberOfScalarComponents() != volume2->GetNumberOfScalarComponents())
+    {
+      LOG_ERROR("Volume pixel type mismatch");
+      return false;
+    }
+    size_t volumeSizeBytes = static_cast<size_t>(volume1->GetNumberOfPoints()) * volume1->GetNumberOfScalarComponents() * volume1->GetScalarSize();
+    if (memcmp(volume1->GetScalarPointer(), volume2->GetScalarPointer(), volumeSizeBytes) != 0)
+    {
+      LOG_ERROR("Volume contents mismatch");
+      return false;
+    }
+    return true;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  std::string inputConfigFileName;
+  std::string inputSeqFileName;
+  std::string inputImageToReferenceTransformName("ImageToReference");
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--config-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputConfigFileName, "Configuration file name containing the volume reconstruction parameters.");
+  args.AddArgument("--source-seq-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputSeqFileName, "Input sequence file name of the tracked frames to reconstruct.");
+  args.AddArgument("--image-to-reference-transform", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &inputImageToReferenceTransformName, "Image to reference transform name used for the reconstruction (Default: ImageToReference).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (inputConfigFileName.empty() || inputSeqFileName.empty())
+  {
+    std::cerr << "--config-file and --source-seq-file arguments are required!" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  vtkSmartPointer<vtkXMLDataElement> configRootElement = vtkSmartPointer<vtkXMLDataElement>::New();
+  if (PlusXmlUtils::ReadDeviceSetConfigurationFromFile(configRootElement, inputConfigFileName.c_str()) == PLUS_FAIL)
+  {
+    LOG_ERROR("Unable to read configuration from file " << inputConfigFileName);
+    return EXIT_FAILURE;
+  }
+
+  igsioTransformName imageToReferenceTransformName;
+  if (imageToReferenceTransformName.SetTransformName(inputImageToReferenceTransformName.c_str()) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Invalid image to reference transform name: " << inputImageToReferenceTransformName);
+    return EXIT_FAILURE;
+  }
+
+  vtkSmartPointer<vtkIGSIOTransformRepository> transformRepository = vtkSmartPointer<vtkIGSIOTransformRepository>::New();
+  if (configRootElement->FindNestedElementWithName("CoordinateDefinitions") != NULL
+      && transformRepository->ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to read transforms from CoordinateDefinitions");
+    return EXIT_FAILURE;
+  }
+
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+  if (vtkIGSIOSequenceIO::Read(inputSeqFileName, trackedFrameList) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to read sequence file: " << inputSeqFileName);
+    return EXIT_FAILURE;
+  }
+  const int numberOfFrames = trackedFrameList->GetNumberOfTrackedFrames();
+  if (numberOfFrames < 2 * NUMBER_OF_FRAMES_PER_LIST)
+  {
+    LOG_ERROR("Not enough frames in the input sequence: " << numberOfFrames);
+    return EXIT_FAILURE;
+  }
+
+  // Reference volume: all the frames are inserted directly
+  vtkSmartPointer<vtkPlusVirtualVolumeReconstructorTester> referenceReconstructor = vtkSmartPointer<vtkPlusVirtualVolumeReconstructorTester>::New();
+  if (referenceReconstructor->Configure(configRootElement, imageToReferenceTransformName, trackedFrameList, transformRepository) != PLUS_SUCCESS
+      || referenceReconstructor->InsertFrames(trackedFrameList) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to reconstruct the reference volume");
+    return EXIT_FAILURE;
+  }
+  std::string errorMessage;
+  vtkSmartPointer<vtkImageData> referenceVolume = vtkSmartPointer<vtkImageData>::New();
+  if (referenceReconstructor->GetReconstructedVolume(referenceVolume, errorMessage, false) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to get the reference volume: " << errorMessage);
+    return EXIT_FAILURE;
+  }
+
+  // Background reconstruction: all the frames are queued and the thread is stopped immediately
+  vtkSmartPointer<vtkPlusVirtualVolumeReconstructorTester> backgroundReconstructor = vtkSmartPointer<vtkPlusVirtualVolumeReconstructorTester>::New();
+  backgroundReconstructor->SetBackgroundReconstruction(true);
+  if (backgroundReconstructor->Configure(configRootElement, imageToReferenceTransformName, trackedFrameList, transformRepository) != PLUS_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+  if (backgroundReconstructor->StartReconstructionThread() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to start the reconstruction thread");
+    return EXIT_FAILURE;
+  }
+  if (!backgroundReconstructor->IsReconstructionThreadRunning())
+  {
+    LOG_ERROR("Reconstruction thread is expected to be reported as running as soon as recording is started");
+    return EXIT_FAILURE;
+  }
+
+  for (int firstFrameIndex = 0; firstFrameIndex < numberOfFrames; firstFrameIndex += NUMBER_OF_FRAMES_PER_LIST)
+  {
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> frames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    for (int frameIndex = firstFrameIndex; frameIndex < numberOfFrames && frameIndex < firstFrameIndex + NUMBER_OF_FRAMES_PER_LIST; ++frameIndex)
+    {
+      frames->AddTrackedFrame(trackedFrameList->GetTrackedFrame(frameIndex), vtkIGSIOTrackedFrameList::ADD_INVALID_FRAME);
+    }
+    backgroundReconstructor->QueueFrames(frames);
+  }
+
+  if (backgroundReconstructor->StopReconstructionThread() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to stop the reconstruction thread");
+    return EXIT_FAILURE;
+  }
+  if (backgroundReconstructor->GetNumberOfQueuedFrameLists() != 0)
+  {
+    LOG_ERROR("Frames are left in the queue after the reconstruction thread is stopped: " << backgroundReconstructor->GetNumberOfQueuedFrameLists() << " frame lists");
+    return EXIT_FAILURE;
+  }
+
+  vtkSmartPointer<vtkImageData> backgroundVolume = vtkSmartPointer<vtkImageData>::New();
+  if (backgroundReconstructor->GetReconstructedVolume(backgroundVolume, errorMessage, false) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to get the background reconstructed volume: " << errorMessage);
+    return EXIT_FAILURE;
+  }
+  if (!AreVolumesEqual(referenceVolume, backgroundVolume))
+  {
+    LOG_ERROR("Volume reconstructed in the background differs from the reference volume");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully!");
+  return EXIT_SUCCESS;
+}
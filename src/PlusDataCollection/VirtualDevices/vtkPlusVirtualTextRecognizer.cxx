@@ -22,6 +22,10 @@ See License.txt for details.
 // Configuration includes
 #include "tesseractDataDir.h"
 
+// STL includes
+#include <algorithm>
+#include <future>
+
 //----------------------------------------------------------------------------
 
 vtkStandardNewMacro(vtkPlusVirtualTextRecognizer);
@@ -39,12 +43,18 @@ namespace
   static const int PARAMETER_DEPTH_BITS = 8;
   static const char* DEFAULT_LANGUAGE = "eng";
   static const int TEXT_RECOGNIZER_MISSING_INPUT_DEFAULT = 1;
+  static const int DEFAULT_NUMBER_OF_RECOGNITION_THREADS = 1;
+
+  // FNV-1a 64-bit parameters
+  static const vtkTypeUInt64 FNV_OFFSET_BASIS = 14695981039346656037ULL;
+  static const vtkTypeUInt64 FNV_PRIME = 1099511628211ULL;
 }
 
 //----------------------------------------------------------------------------
 vtkPlusVirtualTextRecognizer::vtkPlusVirtualTextRecognizer()
   : vtkPlusDevice()
   , Language()
+  , NumberOfRecognitionThreads(DEFAULT_NUMBER_OF_RECOGNITION_THREADS)
   , TrackedFrames(vtkIGSIOTrackedFrameList::New())
   , OutputChannel(NULL)
 {
@@ -79,6 +89,8 @@ vtkPlusVirtualTextRecognizer::~vtkPlusVirtualTextRecognizer()
 void vtkPlusVirtualTextRecognizer::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "Language: " << this->Language << std::endl;
+  os << indent << "NumberOfRecognitionThreads: " << this->NumberOfRecognitionThreads << std::endl;
 }
 
 #ifdef PLUS_TEST_TextRecognizer
@@ -100,6 +112,8 @@ PlusStatus vtkPlusVirtualTextRecognizer::InternalUpdate()
     return PLUS_SUCCESS;
   }
 
+  // Clip the regions serially (frame queries share TrackedFrames) and collect the fields whose pixels changed
+  FieldList changedFields;
   for (ChannelFieldListMapIterator it = this->RecognitionFields.begin(); it != this->RecognitionFields.end(); ++it)
   {
     for (FieldListIterator fieldIt = it->second.begin(); fieldIt != it->second.end(); ++fieldIt)
@@ -118,13 +132,45 @@ PlusStatus vtkPlusVirtualTextRecognizer::InternalUpdate()
       // We have a frame, let's parse it
       vtkImageDataToPix(frame, parameter);
 
-      this->TesseractAPI->SetImage(parameter->ReceivedFrame);
-      char* text_out = this->TesseractAPI->GetUTF8Text();
-      std::string textStr(text_out);
-      parameter->LatestParameterValue = igsioCommon::Trim(textStr);
-      delete [] text_out;
+      // Identical pixels give identical text, so only run OCR on regions that changed since the last recognition
+      vtkTypeUInt64 regionHash = ComputeRegionHash(parameter->ScreenRegion);
+      if (parameter->RegionHashValid && parameter->LastRegionHash == regionHash)
+      {
+        continue;
+      }
+      parameter->LastRegionHash = regionHash;
+      parameter->RegionHashValid = true;
+      changedFields.push_back(parameter);
+    }
+  }
 
-      frame.SetFrameField(parameter->ParameterName, parameter->LatestParameterValue);
+  unsigned int numberOfWorkers = std::min<unsigned int>(this->TesseractAPIs.size(), changedFields.size());
+  if (numberOfWorkers <= 1)
+  {
+    if (!changedFields.empty())
+    {
+      RecognizeFields(changedFields, 0);
+    }
+  }
+  else
+  {
+    // Distribute the changed fields round-robin, each worker owns one tesseract instance
+    std::vector<FieldList> workerFields(numberOfWorkers);
+    for (unsigned int i = 0; i < changedFields.size(); ++i)
+    {
+      workerFields[i % numberOfWorkers].push_back(changedFields[i]);
+    }
+    std::vector<std::future<void> > results;
+    for (unsigned int i = 0; i < numberOfWorkers; ++i)
+    {
+      results.push_back(std::async(std::launch::async, [this, &workerFields, i]()
+      {
+        this->RecognizeFields(workerFields[i], i);
+      }));
+    }
+    for (std::vector<std::future<void> >::iterator resultIt = results.begin(); resultIt != results.end(); ++resultIt)
+    {
+      resultIt->wait();
     }
   }
 
@@ -147,6 +193,39 @@ PlusStatus vtkPlusVirtualTextRecognizer::InternalUpdate()
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusVirtualTextRecognizer::RecognizeFields(const FieldList& fields, unsigned int apiIndex)
+{
+  tesseract::TessBaseAPI* api = this->TesseractAPIs[apiIndex];
+  for (FieldList::const_iterator fieldIt = fields.begin(); fieldIt != fields.end(); ++fieldIt)
+  {
+    TextFieldParameter* parameter = *fieldIt;
+    api->SetImage(parameter->ReceivedFrame);
+    char* text_out = api->GetUTF8Text();
+    std::string textStr(text_out);
+    parameter->LatestParameterValue = igsioCommon::Trim(textStr);
+    delete [] text_out;
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkTypeUInt64 vtkPlusVirtualTextRecognizer::ComputeRegionHash(vtkImageData* region)
+{
+  vtkTypeUInt64 hash = FNV_OFFSET_BASIS;
+  const unsigned char* data = static_cast<const unsigned char*>(region->GetScalarPointer());
+  if (data == NULL)
+  {
+    return hash;
+  }
+  vtkIdType numberOfBytes = region->GetNumberOfPoints() * region->GetNumberOfScalarComponents() * region->GetScalarSize();
+  for (vtkIdType i = 0; i < numberOfBytes; ++i)
+  {
+    hash ^= data[i];
+    hash *= FNV_PRIME;
+  }
+  return hash;
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusVirtualTextRecognizer::vtkImageDataToPix(igsioTrackedFrame& frame, TextFieldParameter* parameter)
 {
@@ -235,13 +314,17 @@ PlusStatus vtkPlusVirtualTextRecognizer::InternalConnect()
   ss << "TESSDATA_PREFIX=" << tesseract_data_dir;
   vtksys::SystemTools::PutEnv(ss.str());
 
-  this->TesseractAPI = new tesseract::TessBaseAPI();
-  if (this->TesseractAPI->Init(NULL, Language.c_str(), tesseract::OEM_TESSERACT_CUBE_COMBINED) != 0)
+  for (int i = 0; i < this->NumberOfRecognitionThreads; ++i)
   {
-    LOG_ERROR("Unable to init tesseract library. Cannot perform text recognition.");
-    return PLUS_FAIL;
+    tesseract::TessBaseAPI* api = new tesseract::TessBaseAPI();
+    this->TesseractAPIs.push_back(api);
+    if (api->Init(NULL, Language.c_str(), tesseract::OEM_TESSERACT_CUBE_COMBINED) != 0)
+    {
+      LOG_ERROR("Unable to init tesseract library. Cannot perform text recognition.");
+      return PLUS_FAIL;
+    }
+    api->SetPageSegMode(tesseract::PSM_SINGLE_LINE);
   }
-  this->TesseractAPI->SetPageSegMode(tesseract::PSM_SINGLE_LINE);
 
   return PLUS_SUCCESS;
 }
@@ -249,8 +332,11 @@ PlusStatus vtkPlusVirtualTextRecognizer::InternalConnect()
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusVirtualTextRecognizer::InternalDisconnect()
 {
-  delete this->TesseractAPI;
-  this->TesseractAPI = NULL;
+  for (std::vector<tesseract::TessBaseAPI*>::iterator it = this->TesseractAPIs.begin(); it != this->TesseractAPIs.end(); ++it)
+  {
+    delete *it;
+  }
+  this->TesseractAPIs.clear();
 
   ClearConfiguration();
 
@@ -280,6 +366,14 @@ PlusStatus vtkPlusVirtualTextRecognizer::ReadConfiguration(vtkXMLDataElement* ro
   this->SetLanguage(DEFAULT_LANGUAGE);
   XML_READ_CSTRING_ATTRIBUTE_OPTIONAL(Language, deviceConfig);
 
+  this->NumberOfRecognitionThreads = DEFAULT_NUMBER_OF_RECOGNITION_THREADS;
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfRecognitionThreads, deviceConfig);
+  if (this->NumberOfRecognitionThreads < 1)
+  {
+    LOG_WARNING("NumberOfRecognitionThreads must be at least 1. Using " << DEFAULT_NUMBER_OF_RECOGNITION_THREADS << ".");
+    this->NumberOfRecognitionThreads = DEFAULT_NUMBER_OF_RECOGNITION_THREADS;
+  }
+
   XML_FIND_NESTED_ELEMENT_OPTIONAL(screenFields, deviceConfig, PARAMETER_LIST_TAG_NAME);
 
   for (int i = 0; i < screenFields->GetNumberOfNestedElements(); ++i)
@@ -343,6 +437,11 @@ PlusStatus vtkPlusVirtualTextRecognizer::WriteConfiguration(vtkXMLDataElement* r
     XML_WRITE_STRING_ATTRIBUTE_IF_NOT_EMPTY(Language, deviceConfig);
   }
 
+  if (this->NumberOfRecognitionThreads != DEFAULT_NUMBER_OF_RECOGNITION_THREADS)
+  {
+    deviceConfig->SetIntAttribute("NumberOfRecognitionThreads", this->NumberOfRecognitionThreads);
+  }
+
   XML_FIND_NESTED_ELEMENT_CREATE_IF_MISSING(screenFields, deviceConfig, PARAMETER_LIST_TAG_NAME);
 
   for (ChannelFieldListMapIterator it = this->RecognitionFields.begin(); it != this->RecognitionFields.end(); ++it)
@@ -34,6 +34,10 @@ public:
   {
   public:
     TextFieldParameter()
+      : ReceivedFrame(NULL)
+      , SourceChannel(NULL)
+      , LastRegionHash(0)
+      , RegionHashValid(false)
     {
       this->Origin[0] = 0;
       this->Origin[1] = 0;
@@ -53,6 +57,10 @@ public:
     std::array<int, 3> Origin;
     /// This is only 3d for simplicity in passing to clipping function, OCR is 2d only
     std::array<int, 3> Size;
+    /// Hash of the screen region pixels that produced LatestParameterValue, used to skip OCR of unchanged regions
+    vtkTypeUInt64 LastRegionHash;
+    /// True if LastRegionHash has been computed from a recognized region
+    bool RegionHashValid;
   };
 
 public:
@@ -87,6 +95,10 @@ public:
   vtkSetStdStringMacro(Language);
   vtkGetStdStringMacro(Language);
 
+  /*! Number of tesseract instances used to recognize changed fields in parallel */
+  vtkSetMacro(NumberOfRecognitionThreads, int);
+  vtkGetMacro(NumberOfRecognitionThreads, int);
+
   vtkSetObjectMacro(OutputChannel, vtkPlusChannel);
   vtkGetObjectMacro(OutputChannel, vtkPlusChannel);
 
@@ -103,6 +115,12 @@ protected:
   /// Convert a vtkImage data to leptonica pix format
   void vtkImageDataToPix(igsioTrackedFrame& frame, TextFieldParameter* parameter);
 
+  /// Compute a hash of the clipped screen region pixels
+  static vtkTypeUInt64 ComputeRegionHash(vtkImageData* region);
+
+  /// Run OCR on the given fields using the tesseract instance at apiIndex
+  void RecognizeFields(const FieldList& fields, unsigned int apiIndex);
+
   /// If a frame has been queried for this input channel, reuse it instead of getting a new one
   PlusStatus FindOrQueryFrame(igsioTrackedFrame& frame, std::map<double, int>& queriedFramesIndexes, TextFieldParameter* parameter,
                               std::vector<igsioTrackedFrame*>& queriedFrames);
@@ -110,8 +128,11 @@ protected:
   /// Language used for detection
   std::string                 Language;
 
-  /// Main entry point for the tesseract API
-  tesseract::TessBaseAPI*     TesseractAPI;
+  /// Tesseract instances, one per recognition thread. An instance is not thread safe, so each is used by a single thread at a time.
+  std::vector<tesseract::TessBaseAPI*> TesseractAPIs;
+
+  /// Number of tesseract instances (and threads) used to recognize changed fields
+  int                         NumberOfRecognitionThreads;
 
   vtkIGSIOTrackedFrameList*    TrackedFrames;
 
@@ -15,12 +15,15 @@ See License.txt for details.
 #include "vtkPlusVirtualVolumeReconstructor.h"
 #include "vtkPlusVolumeReconstructor.h"
 #include "vtksys/SystemTools.hxx"
+#include <vtkImageData.h>
 
 //----------------------------------------------------------------------------
 
 vtkStandardNewMacro(vtkPlusVirtualVolumeReconstructor);
 
 static const int MAX_ALLOWED_RECONSTRUCTION_LAG_SEC = 3.0; // if the reconstruction lags more than this then it'll skip frames to catch up
+static const double DELAY_ON_NO_PENDING_FRAMES_SEC = 0.01; // wait time of the reconstruction thread if there are no frames to insert
+static const int MAX_PENDING_FRAME_LISTS = 24; // if more sampled frame lists are waiting for insertion then the oldest ones are dropped to catch up
 
 //----------------------------------------------------------------------------
 vtkPlusVirtualVolumeReconstructor::vtkPlusVirtualVolumeReconstructor()
@@ -34,6 +37,16 @@ vtkPlusVirtualVolumeReconstructor::vtkPlusVirtualVolumeReconstructor()
   , TotalFramesRecorded(0)
   , EnableReconstruction(false)
   , VolumeReconstructorAccessMutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
+  , BackgroundReconstruction(false)
+  , SnapshotPublishIntervalSec(1.0)
+  , PendingFrameListsMutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
+  , PublishedVolumeHoleFilled(false)
+  , PublishedVolumeMutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
+  , PublishedVolumeOutdated(false)
+  , LastPublishTime(0.0)
+  , ReconstructionThreadBusy(false)
+  , ReconstructionThreadActive(std::make_pair(false, false))
+  , ReconstructionThreadId(-1)
 {
   // The data capture thread will be used to regularly read the frames and write to disk
   this->StartThreadForInternalUpdates = true;
@@ -61,6 +74,8 @@ PlusStatus vtkPlusVirtualVolumeReconstructor::ReadConfiguration(vtkXMLDataElemen
   XML_READ_BOOL_ATTRIBUTE_OPTIONAL(EnableReconstruction, deviceConfig);
   XML_READ_CSTRING_ATTRIBUTE_OPTIONAL(OutputVolFilename, deviceConfig);
   XML_READ_CSTRING_ATTRIBUTE_OPTIONAL(OutputVolDeviceName, deviceConfig);
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(BackgroundReconstruction, deviceConfig);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, SnapshotPublishIntervalSec, deviceConfig);
 
   igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->VolumeReconstructorAccessMutex);
   this->VolumeReconstructor->ReadConfiguration(deviceConfig);
@@ -77,6 +92,8 @@ PlusStatus vtkPlusVirtualVolumeReconstructor::WriteConfiguration(vtkXMLDataEleme
 
   deviceElement->SetAttribute("OutputVolFilename", this->OutputVolFilename.c_str());
   deviceElement->SetAttribute("OutputVolDeviceName", this->OutputVolDeviceName.c_str());
+  XML_WRITE_BOOL_ATTRIBUTE(BackgroundReconstruction, deviceElement);
+  deviceElement->SetDoubleAttribute("SnapshotPublishIntervalSec", this->SnapshotPublishIntervalSec);
 
   igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->VolumeReconstructorAccessMutex);
   this->VolumeReconstructor->WriteConfiguration(deviceElement);
@@ -119,6 +136,128 @@ PlusStatus vtkPlusVirtualVolumeReconstructor::InternalDisconnect()
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualVolumeReconstructor::InternalStartRecording()
+{
+  if (!this->BackgroundReconstruction || this->ReconstructionThreadId >= 0)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  // Mark the thread as running before it is spawned, so that frames sampled by the next update are queued
+  this->ReconstructionThreadActive = std::make_pair(true, true);
+  this->ReconstructionThreadId = this->Threader->SpawnThread((vtkThreadFunctionType)&ReconstructionThread, this);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualVolumeReconstructor::InternalStopRecording()
+{
+  if (this->ReconstructionThreadId < 0)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  this->ReconstructionThreadActive.first = false;
+  while (this->ReconstructionThreadActive.second)
+  {
+    // Wait until the thread stops
+    vtkIGSIOAccurateTimer::Delay(0.1);
+  }
+  this->ReconstructionThreadId = -1;
+  LOG_DEBUG("Volume reconstruction thread stopped");
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void* vtkPlusVirtualVolumeReconstructor::ReconstructionThread(vtkMultiThreader::ThreadInfo* data)
+{
+  vtkPlusVirtualVolumeReconstructor* self = (vtkPlusVirtualVolumeReconstructor*)(data->UserData);
+
+  // Keep running after stop is requested until all the queued frames are inserted into the volume
+  while (self->ReconstructionThreadActive.first || self->GetNumberOfPendingFrameLists() > 0)
+  {
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> frames;
+    {
+      igsioLockGuard<vtkIGSIORecursiveCriticalSection> pendingLock(self->PendingFrameListsMutex);
+      if (!self->PendingFrameLists.empty())
+      {
+        frames = self->PendingFrameLists.front();
+        self->PendingFrameLists.pop_front();
+        self->ReconstructionThreadBusy = true;
+      }
+    }
+
+    if (frames.GetPointer() != NULL)
+    {
+      int numberOfFrames = frames->GetNumberOfTrackedFrames();
+      if (self->AddFrames(frames) != PLUS_SUCCESS)
+      {
+        LOG_ERROR(self->GetDeviceId() << ": Unable to add " << numberOfFrames << " frames for volume reconstruction");
+      }
+      self->PublishedVolumeOutdated = true;
+      {
+        igsioLockGuard<vtkIGSIORecursiveCriticalSection> pendingLock(self->PendingFrameListsMutex);
+        self->ReconstructionThreadBusy = false;
+      }
+    }
+
+    if (self->PublishedVolumeOutdated
+        && vtkIGSIOAccurateTimer::GetSystemTime() - self->LastPublishTime >= self->SnapshotPublishIntervalSec)
+    {
+      self->PublishReconstructedVolume();
+    }
+
+    if (frames.GetPointer() == NULL)
+    {
+      vtkIGSIOAccurateTimer::Delay(DELAY_ON_NO_PENDING_FRAMES_SEC);
+    }
+  }
+
+  self->ReconstructionThreadActive.second = false;
+  return NULL;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusVirtualVolumeReconstructor::PublishReconstructedVolume()
+{
+  vtkSmartPointer<vtkImageData> volume = vtkSmartPointer<vtkImageData>::New();
+  bool holeFilled = false;
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->VolumeReconstructorAccessMutex);
+    this->PublishedVolumeOutdated = false;
+    holeFilled = this->VolumeReconstructor->GetFillHoles();
+    if (this->VolumeReconstructor->ExtractGrayLevels(volume) != PLUS_SUCCESS)
+    {
+      LOG_ERROR(this->GetDeviceId() << ": Failed to extract gray levels for publishing the reconstructed volume");
+      return PLUS_FAIL;
+    }
+  }
+
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> publishedLock(this->PublishedVolumeMutex);
+  this->PublishedVolume = volume;
+  this->PublishedVolumeHoleFilled = holeFilled;
+  this->LastPublishTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusVirtualVolumeReconstructor::GetNumberOfPendingFrameLists()
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> pendingLock(this->PendingFrameListsMutex);
+  return static_cast<int>(this->PendingFrameLists.size()) + (this->ReconstructionThreadBusy ? 1 : 0);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusVirtualVolumeReconstructor::WaitForPendingFrames()
+{
+  while (this->ReconstructionThreadActive.second && this->GetNumberOfPendingFrameLists() > 0)
+  {
+    vtkIGSIOAccurateTimer::Delay(DELAY_ON_NO_PENDING_FRAMES_SEC);
+  }
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusVirtualVolumeReconstructor::InternalUpdate()
 {
@@ -165,13 +304,6 @@ PlusStatus vtkPlusVirtualVolumeReconstructor::InternalUpdate()
     LOG_WARNING("RequestedFrameRate is invalid, use default: " << 1 / requestedFramePeriodSec);
   }
 
-  igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->VolumeReconstructorAccessMutex);
-  if (!this->EnableReconstruction)
-  {
-    // While this thread was waiting for the unlock, capturing was disabled, so cancel the update now
-    return PLUS_SUCCESS;
-  }
-
   if (this->OutputChannels.empty())
   {
     LOG_ERROR("No output channels defined");
@@ -179,20 +311,58 @@ PlusStatus vtkPlusVirtualVolumeReconstructor::InternalUpdate()
   }
   vtkPlusChannel* outputChannel = this->OutputChannels[0];
 
-  vtkSmartPointer<vtkIGSIOTrackedFrameList> recordedFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
-  if (outputChannel->GetTrackedFrameListSampled(m_LastAlreadyRecordedFrameTimestamp, m_NextFrameToBeRecordedTimestamp, recordedFrames, requestedFramePeriodSec, maxProcessingTimeSec) != PLUS_SUCCESS)
+  int nbFramesRecorded = 0;
+  if (this->BackgroundReconstruction && this->ReconstructionThreadActive.second)
   {
-    LOG_ERROR("Error while getting tracked frame list from data collector during volume reconstruction. Last recorded timestamp: " << std::fixed << m_NextFrameToBeRecordedTimestamp);
+    // Only sample the frames here, insertion is done by the reconstruction thread,
+    // so the volume reconstructor is not locked while waiting for new frames
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> recordedFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    if (outputChannel->GetTrackedFrameListSampled(m_LastAlreadyRecordedFrameTimestamp, m_NextFrameToBeRecordedTimestamp, recordedFrames, requestedFramePeriodSec, maxProcessingTimeSec) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Error while getting tracked frame list from data collector during volume reconstruction. Last recorded timestamp: " << std::fixed << m_NextFrameToBeRecordedTimestamp);
+    }
+    nbFramesRecorded = recordedFrames->GetNumberOfTrackedFrames();
+    if (nbFramesRecorded > 0)
+    {
+      igsioLockGuard<vtkIGSIORecursiveCriticalSection> pendingLock(this->PendingFrameListsMutex);
+      if (!this->EnableReconstruction)
+      {
+        // Capturing was disabled while sampling, so cancel the update now
+        return PLUS_SUCCESS;
+      }
+      this->PendingFrameLists.push_back(recordedFrames);
+      if (static_cast<int>(this->PendingFrameLists.size()) > MAX_PENDING_FRAME_LISTS)
+      {
+        LOG_ERROR("Volume reconstruction cannot keep up with the acquisition. Drop " << this->PendingFrameLists.front()->GetNumberOfTrackedFrames() << " queued frames to catch up.");
+        this->PendingFrameLists.pop_front();
+      }
+    }
+    this->TotalFramesRecorded += nbFramesRecorded;
   }
-  int nbFramesRecorded = recordedFrames->GetNumberOfTrackedFrames();
-
-  if (this->AddFrames(recordedFrames) != PLUS_SUCCESS)
+  else
   {
-    LOG_ERROR(this->GetDeviceId() << ": Unable to add " << nbFramesRecorded << " frames for volume reconstruction");
-    return PLUS_FAIL;
-  }
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->VolumeReconstructorAccessMutex);
+    if (!this->EnableReconstruction)
+    {
+      // While this thread was waiting for the unlock, capturing was disabled, so cancel the update now
+      return PLUS_SUCCESS;
+    }
+
+    vtkSmartPointer<vtkIGSIOTrackedFrameList> recordedFrames = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+    if (outputChannel->GetTrackedFrameListSampled(m_LastAlreadyRecordedFrameTimestamp, m_NextFrameToBeRecordedTimestamp, recordedFrames, requestedFramePeriodSec, maxProcessingTimeSec) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Error while getting tracked frame list from data collector during volume reconstruction. Last recorded timestamp: " << std::fixed << m_NextFrameToBeRecordedTimestamp);
+    }
+    nbFramesRecorded = recordedFrames->GetNumberOfTrackedFrames();
+
+    if (this->AddFrames(recordedFrames) != PLUS_SUCCESS)
+    {
+      LOG_ERROR(this->GetDeviceId() << ": Unable to add " << nbFramesRecorded << " frames for volume reconstruction");
+      return PLUS_FAIL;
+    }
 
-  this->TotalFramesRecorded += nbFramesRecorded;
+    this->TotalFramesRecorded += nbFramesRecorded;
+  }
 
   // Check whether the reconstruction needed more time than the sampling interval
   double recordingTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
@@ -267,8 +437,22 @@ void vtkPlusVirtualVolumeReconstructor::SetEnableReconstruction(bool aValue)
 //-----------------------------------------------------------------------------
 PlusStatus vtkPlusVirtualVolumeReconstructor::Reset()
 {
-  igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->VolumeReconstructorAccessMutex);
-  this->VolumeReconstructor->Reset();
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> pendingLock(this->PendingFrameListsMutex);
+    this->PendingFrameLists.clear();
+  }
+  // Let the reconstruction thread finish the frame list it is currently inserting
+  this->WaitForPendingFrames();
+
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->VolumeReconstructorAccessMutex);
+    this->VolumeReconstructor->Reset();
+    this->PublishedVolumeOutdated = false;
+  }
+
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> publishedLock(this->PublishedVolumeMutex);
+  this->PublishedVolume = NULL;
+  this->PublishedVolumeHoleFilled = false;
   return PLUS_SUCCESS;
 }
 
@@ -347,6 +531,27 @@ PlusStatus vtkPlusVirtualVolumeReconstructor::GetReconstructedVolumeFromFile(con
 PlusStatus vtkPlusVirtualVolumeReconstructor::GetReconstructedVolume(vtkImageData* reconstructedVolume, std::string& outErrorMessage, bool applyHoleFilling/*=true*/)
 {
   outErrorMessage.clear();
+
+  if (this->BackgroundReconstruction && this->ReconstructionThreadActive.second)
+  {
+    if (this->EnableReconstruction)
+    {
+      // Live reconstruction is in progress: serve the request from the published volume
+      // so that frame insertion is not blocked by the volume extraction
+      igsioLockGuard<vtkIGSIORecursiveCriticalSection> publishedLock(this->PublishedVolumeMutex);
+      if (this->PublishedVolume.GetPointer() != NULL && (applyHoleFilling || !this->PublishedVolumeHoleFilled))
+      {
+        reconstructedVolume->DeepCopy(this->PublishedVolume);
+        return PLUS_SUCCESS;
+      }
+    }
+    else
+    {
+      // Reconstruction is stopped, make sure all the sampled frames are in the volume
+      this->WaitForPendingFrames();
+    }
+  }
+
   igsioLockGuard<vtkIGSIORecursiveCriticalSection> writerLock(this->VolumeReconstructorAccessMutex);
   bool oldFillHoles = this->VolumeReconstructor->GetFillHoles();
   if (!applyHoleFilling)
@@ -10,6 +10,7 @@ See License.txt for details.
 #include "vtkPlusDataCollectionExport.h"
 
 #include "vtkPlusDevice.h"
+#include <deque>
 #include <string>
 
 //class vtkIGSIOTrackedFrameList;
@@ -83,6 +84,17 @@ public:
 
   vtkGetMacro(TotalFramesRecorded, long int);
 
+  /*!
+    If enabled then sampled frames are queued and inserted into the volume by a dedicated worker thread,
+    and live snapshots are served from a periodically published copy of the volume.
+  */
+  vtkGetMacro(BackgroundReconstruction, bool);
+  vtkSetMacro(BackgroundReconstruction, bool);
+
+  /*! Minimum time between two published volume snapshots in background reconstruction mode (in seconds) */
+  vtkGetMacro(SnapshotPublishIntervalSec, double);
+  vtkSetMacro(SnapshotPublishIntervalSec, double);
+
 protected:
 
   /*! Read main configuration from xml data */
@@ -115,8 +127,23 @@ protected:
   virtual PlusStatus InternalConnect();
   virtual PlusStatus InternalDisconnect();
 
+  virtual PlusStatus InternalStartRecording();
+  virtual PlusStatus InternalStopRecording();
+
   PlusStatus AddFrames(vtkIGSIOTrackedFrameList* trackedFrameList);
 
+  /*! Thread that inserts the queued frames into the volume in background reconstruction mode */
+  static void* ReconstructionThread(vtkMultiThreader::ThreadInfo* data);
+
+  /*! Extract the current volume and make it available for snapshot requests */
+  PlusStatus PublishReconstructedVolume();
+
+  /*! Wait until all the queued frames are inserted into the volume */
+  void WaitForPendingFrames();
+
+  /*! Get the number of frame lists waiting to be inserted into the volume */
+  int GetNumberOfPendingFrameLists();
+
   /*! Get the sampling period length (in seconds). Frames are copied from the devices to the data collection buffer once in every sampling period. */
   double GetSamplingPeriodSec();
 
@@ -157,6 +184,33 @@ protected:
   /*! Mutex instance simultaneous access of writer (writer may be accessed from command processing thread and also the internal update thread) */
   vtkSmartPointer<vtkIGSIORecursiveCriticalSection> VolumeReconstructorAccessMutex;
 
+  /*! Insert frames on a dedicated thread and serve snapshots from the published volume */
+  bool BackgroundReconstruction;
+
+  /*! Minimum time between two published volume snapshots (in seconds) */
+  double SnapshotPublishIntervalSec;
+
+  /*! Sampled frames waiting to be inserted into the volume by the reconstruction thread */
+  std::deque<vtkSmartPointer<vtkIGSIOTrackedFrameList> > PendingFrameLists;
+  vtkSmartPointer<vtkIGSIORecursiveCriticalSection> PendingFrameListsMutex;
+
+  /*! Most recently published copy of the reconstructed volume */
+  vtkSmartPointer<vtkImageData> PublishedVolume;
+  /*! True if hole filling was applied on the published volume */
+  bool PublishedVolumeHoleFilled;
+  vtkSmartPointer<vtkIGSIORecursiveCriticalSection> PublishedVolumeMutex;
+
+  /*! Set when frames have been inserted since the last publishing */
+  bool PublishedVolumeOutdated;
+  double LastPublishTime;
+
+  /*! Set while the reconstruction thread is inserting a frame list that is no longer in the queue */
+  bool ReconstructionThreadBusy;
+
+  /*! Active flag for the reconstruction thread (first: request, second: respond) */
+  std::pair<bool, bool> ReconstructionThreadActive;
+  int ReconstructionThreadId;
+
 private:
   vtkPlusVirtualVolumeReconstructor(const vtkPlusVirtualVolumeReconstructor&);   // Not implemented.
   void operator=(const vtkPlusVirtualVolumeReconstructor&);   // Not implemented.
@@ -230,6 +230,12 @@ public:
     return this->StreamBuffer->GetFrameRate(ideal, framePeriodStdevSecPtr);
   }
 
+  /*! Get the number of measured locks and the total and maximum time spent waiting for the buffer lock (in seconds), see PlusCommon::SetPerformanceStatisticsEnabled */
+  virtual void GetLockWaitTimeStatistics(unsigned long long& numberOfLocks, double& totalWaitTimeSec, double& maxWaitTimeSec) const
+  {
+    this->StreamBuffer->GetLockWaitTimeStatistics(numberOfLocks, totalWaitTimeSec, maxWaitTimeSec);
+  }
+
   /*! Set maximum allowed time difference in seconds between the desired and the closest valid timestamp */
   vtkSetMacro(MaxAllowedTimeDifference, double);
   /*! Get maximum allowed time difference in seconds between the desired and the closest valid timestamp */
@@ -12,6 +12,8 @@ See License.txt for details.
 #include "vtkTable.h"
 #include "vtkVariantArray.h"
 
+#include <chrono>
+
 vtkStandardNewMacro(vtkPlusTimestampedCircularBuffer);
 
 //----------------------------------------------------------------------------
@@ -29,6 +31,9 @@ vtkPlusTimestampedCircularBuffer::vtkPlusTimestampedCircularBuffer()
   , TimeStampLogging(false)
   , StartTime(0)
   , NegligibleTimeDifferenceSec(1e-5)
+  , NumberOfMeasuredLocks(0)
+  , TotalLockWaitTimeNs(0)
+  , MaxLockWaitTimeNs(0)
 {
   this->BufferItemContainer.resize(0);
   this->FilterContainerIndexVector.set_size(0);
@@ -69,6 +74,41 @@ void vtkPlusTimestampedCircularBuffer::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "Latest Item Uid: " << this->LatestItemUid << "\n";
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::Lock()
+{
+  if (!PlusCommon::GetPerformanceStatisticsEnabled())
+  {
+    this->Mutex->Lock();
+    return;
+  }
+
+  std::chrono::steady_clock::time_point waitStartTime = std::chrono::steady_clock::now();
+  this->Mutex->Lock();
+  unsigned long long waitTimeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - waitStartTime).count();
+
+  this->NumberOfMeasuredLocks.fetch_add(1, std::memory_order_relaxed);
+  this->TotalLockWaitTimeNs.fetch_add(waitTimeNs, std::memory_order_relaxed);
+  unsigned long long maxWaitTimeNs = this->MaxLockWaitTimeNs.load(std::memory_order_relaxed);
+  while (waitTimeNs > maxWaitTimeNs && !this->MaxLockWaitTimeNs.compare_exchange_weak(maxWaitTimeNs, waitTimeNs, std::memory_order_relaxed))
+  {
+  }
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::Unlock()
+{
+  this->Mutex->Unlock();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusTimestampedCircularBuffer::GetLockWaitTimeStatistics(unsigned long long& numberOfLocks, double& totalWaitTimeSec, double& maxWaitTimeSec) const
+{
+  numberOfLocks = this->NumberOfMeasuredLocks.load(std::memory_order_relaxed);
+  totalWaitTimeSec = this->TotalLockWaitTimeNs.load(std::memory_order_relaxed) * 1e-9;
+  maxWaitTimeSec = this->MaxLockWaitTimeNs.load(std::memory_order_relaxed) * 1e-9;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusTimestampedCircularBuffer::PrepareForNewItem(const double timestamp, BufferItemUidType& newFrameUid, int& bufferIndex)
 {
@@ -10,6 +10,7 @@
 #include "PlusConfigure.h"
 #include "PlusStreamBufferItem.h"
 #include "vtkObject.h"
+#include <atomic>
 #include <deque>
 
 #include "vnl/vnl_matrix.h"
@@ -146,13 +147,19 @@ public:
     the data in the buffer if the buffer is being used from multiple
     threads.
   */
-  inline void Lock() { this->Mutex->Lock(); };
+  void Lock();
   /*!
     Unlock the buffer: this should be done before changing or accessing
     the data in the buffer if the buffer is being used from multiple
     threads.
   */
-  inline void Unlock() { this->Mutex->Unlock(); };
+  void Unlock();
+
+  /*!
+    Get the number of measured locks and the total and maximum time spent waiting for the lock (in seconds).
+    Lock wait time is only measured while PlusCommon::GetPerformanceStatisticsEnabled() is true.
+  */
+  void GetLockWaitTimeStatistics( unsigned long long& numberOfLocks, double& totalWaitTimeSec, double& maxWaitTimeSec ) const;
 
   /*!
     Get next writable buffer object
@@ -276,6 +283,11 @@ protected:
   */
   double NegligibleTimeDifferenceSec;
 
+  /*! Lock wait time counters, only updated while performance statistics are enabled */
+  std::atomic<unsigned long long> NumberOfMeasuredLocks;
+  std::atomic<unsigned long long> TotalLockWaitTimeNs;
+  std::atomic<unsigned long long> MaxLockWaitTimeNs;
+
 private:
   vtkPlusTimestampedCircularBuffer( const vtkPlusTimestampedCircularBuffer& );
   void operator=( const vtkPlusTimestampedCircularBuffer& );
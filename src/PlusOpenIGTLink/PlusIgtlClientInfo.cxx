@@ -10,12 +10,97 @@ See License.txt for details.
 // IGTL includes
 #include <igtl_header.h>
 
+// STL includes
+#include <algorithm>
+#include <iterator>
+
+namespace
+{
+  struct ScalarTypeName
+  {
+    int ScalarType;
+    const char* Name;
+  };
+
+  // Pixel types that image streams can be converted to
+  const ScalarTypeName IMAGE_STREAM_SCALAR_TYPES[] =
+  {
+    { VTK_UNSIGNED_CHAR, "UNSIGNED_CHAR" },
+    { VTK_UNSIGNED_SHORT, "UNSIGNED_SHORT" },
+    { VTK_SHORT, "SHORT" },
+    { VTK_FLOAT, "FLOAT" }
+  };
+
+  //----------------------------------------------------------------------------
+  bool GetImageStreamScalarTypeFromString(const std::string& name, int& scalarType)
+  {
+    for (size_t i = 0; i < sizeof(IMAGE_STREAM_SCALAR_TYPES) / sizeof(IMAGE_STREAM_SCALAR_TYPES[0]); ++i)
+    {
+      if (STRCASECMP(name.c_str(), IMAGE_STREAM_SCALAR_TYPES[i].Name) == 0)
+      {
+        scalarType = IMAGE_STREAM_SCALAR_TYPES[i].ScalarType;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  //----------------------------------------------------------------------------
+  std::string GetImageStreamScalarTypeAsString(int scalarType)
+  {
+    for (size_t i = 0; i < sizeof(IMAGE_STREAM_SCALAR_TYPES) / sizeof(IMAGE_STREAM_SCALAR_TYPES[0]); ++i)
+    {
+      if (IMAGE_STREAM_SCALAR_TYPES[i].ScalarType == scalarType)
+      {
+        return IMAGE_STREAM_SCALAR_TYPES[i].Name;
+      }
+    }
+    return "";
+  }
+
+  //----------------------------------------------------------------------------
+  void ReadFrameRateLimit(vtkXMLDataElement* elem, const std::string& elemName, PlusIgtlClientInfo::FrameRateLimit& rateLimit)
+  {
+    XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(double, MaxFrameRate, rateLimit.MaxFrameRate, elem);
+    if (rateLimit.MaxFrameRate < 0.0)
+    {
+      LOG_WARNING("MaxFrameRate attribute of " << elemName << " element is invalid: " << rateLimit.MaxFrameRate << ". The frame rate will not be limited.");
+      rateLimit.MaxFrameRate = 0.0;
+    }
+    XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, FrameDecimation, rateLimit.FrameDecimation, elem);
+    if (rateLimit.FrameDecimation < 1)
+    {
+      LOG_WARNING("FrameDecimation attribute of " << elemName << " element is invalid: " << rateLimit.FrameDecimation << ". Every frame will be sent.");
+      rateLimit.FrameDecimation = 1;
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  void WriteFrameRateLimit(vtkXMLDataElement* elem, const PlusIgtlClientInfo::FrameRateLimit& rateLimit)
+  {
+    if (rateLimit.MaxFrameRate > 0.0)
+    {
+      elem->SetDoubleAttribute("MaxFrameRate", rateLimit.MaxFrameRate);
+    }
+    if (rateLimit.FrameDecimation > 1)
+    {
+      elem->SetIntAttribute("FrameDecimation", rateLimit.FrameDecimation);
+    }
+  }
+}
+
 //----------------------------------------------------------------------------
 PlusIgtlClientInfo::PlusIgtlClientInfo()
   : ClientHeaderVersion(IGTL_HEADER_VERSION_1)
   , TDATAResolution(0)
   , TDATARequested(false)
   , LastTDATASentTimeStamp(-1)
+  , SendChangedTransformsOnly(false)
+  , TransformChangeThresholdMm(0.0)
+  , TransformChangeThresholdDeg(0.0)
+  , TransformRefreshIntervalSec(1.0)
+  , SharedMemoryTransport(false)
+  , TrackedFrameFieldsVersion(0)
 {
 
 }
@@ -64,6 +149,42 @@ PlusStatus PlusIgtlClientInfo::SetClientInfoFromXmlData(vtkXMLDataElement* xmlda
     xmldata->RemoveAttribute("Resolution");
     xmldata->SetIntAttribute("TDATAResolution", resolution);
   }
+  if (xmldata->GetAttribute("SendQueueDropPolicy") != NULL)
+  {
+    clientInfo.SetSendQueueDropPolicy(xmldata->GetAttribute("SendQueueDropPolicy"));
+  }
+  if (xmldata->GetAttribute("SendChangedTransformsOnly") != NULL)
+  {
+    clientInfo.SetSendChangedTransformsOnly(STRCASECMP(xmldata->GetAttribute("SendChangedTransformsOnly"), "TRUE") == 0);
+  }
+  double transformChangeThreshold(0.0);
+  if (xmldata->GetScalarAttribute("TransformChangeThresholdMm", transformChangeThreshold))
+  {
+    clientInfo.SetTransformChangeThresholdMm(transformChangeThreshold);
+  }
+  if (xmldata->GetScalarAttribute("TransformChangeThresholdDeg", transformChangeThreshold))
+  {
+    clientInfo.SetTransformChangeThresholdDeg(transformChangeThreshold);
+  }
+  double transformRefreshIntervalSec(0.0);
+  if (xmldata->GetScalarAttribute("TransformRefreshIntervalSec", transformRefreshIntervalSec))
+  {
+    clientInfo.SetTransformRefreshIntervalSec(transformRefreshIntervalSec);
+  }
+  if (xmldata->GetAttribute("SharedMemoryTransport") != NULL)
+  {
+    clientInfo.SetSharedMemoryTransport(STRCASECMP(xmldata->GetAttribute("SharedMemoryTransport"), "TRUE") == 0);
+  }
+  int trackedFrameFieldsVersion(0);
+  if (xmldata->GetScalarAttribute("TrackedFrameFieldsVersion", trackedFrameFieldsVersion))
+  {
+    clientInfo.SetTrackedFrameFieldsVersion(trackedFrameFieldsVersion);
+  }
+  if (xmldata->GetAttribute("OutputChannelId") != NULL)
+  {
+    clientInfo.SetOutputChannelId(xmldata->GetAttribute("OutputChannelId"));
+  }
+  ReadFrameRateLimit(xmldata, "ClientInfo", clientInfo.RateLimit);
 
   // Get message types
   vtkXMLDataElement* messageTypes = xmldata->FindNestedElementWithName("MessageTypes");
@@ -145,6 +266,52 @@ PlusStatus PlusIgtlClientInfo::SetClientInfoFromXmlData(vtkXMLDataElement* xmlda
       stream.EmbeddedTransformToFrame = embeddedTransformToFrame;
       stream.Name = name;
 
+      int clipRectangleOrigin[2] = { 0, 0 };
+      int clipRectangleSize[2] = { 0, 0 };
+      XML_READ_VECTOR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, 2, ClipRectangleOrigin, clipRectangleOrigin, imageElem);
+      XML_READ_VECTOR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, 2, ClipRectangleSize, clipRectangleSize, imageElem);
+      std::copy(std::begin(clipRectangleOrigin), std::end(clipRectangleOrigin), stream.ClipRectangleOrigin.begin());
+      std::copy(std::begin(clipRectangleSize), std::end(clipRectangleSize), stream.ClipRectangleSize.begin());
+      if (stream.ClipRectangleOrigin[0] < 0 || stream.ClipRectangleOrigin[1] < 0)
+      {
+        LOG_WARNING("ClipRectangleOrigin attribute of ImageNames/Image element #" << i << " is negative. The full image will be sent.");
+        stream.ClipRectangleOrigin.fill(0);
+        stream.ClipRectangleSize.fill(0);
+      }
+
+      XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, DownsamplingFactor, stream.DownsamplingFactor, imageElem);
+      if (stream.DownsamplingFactor < 1)
+      {
+        LOG_WARNING("DownsamplingFactor attribute of ImageNames/Image element #" << i << " must be at least 1. The image will be sent at full resolution.");
+        stream.DownsamplingFactor = 1;
+      }
+
+      std::string scalarType;
+      XML_READ_STRING_ATTRIBUTE_NONMEMBER_OPTIONAL(ScalarType, scalarType, imageElem);
+      if (!scalarType.empty() && !GetImageStreamScalarTypeFromString(scalarType, stream.ScalarType))
+      {
+        LOG_WARNING("ScalarType attribute of ImageNames/Image element #" << i << " is invalid: " << scalarType << ". The pixel type of the frame will be used.");
+      }
+
+      int codec = 0;
+      int predictor = 0;
+      XML_READ_STRING_ATTRIBUTE_NONMEMBER_OPTIONAL(Compression, stream.Compression, imageElem);
+      XML_READ_STRING_ATTRIBUTE_NONMEMBER_OPTIONAL(CompressionPredictor, stream.CompressionPredictor, imageElem);
+      XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, CompressionKeyFrameInterval, stream.CompressionKeyFrameInterval, imageElem);
+      if (!stream.Compression.empty() && !vtkPlusIgtlImageCompressor::GetCodecFromString(stream.Compression, codec))
+      {
+        LOG_WARNING("Compression attribute of ImageNames/Image element #" << i << " is invalid: " << stream.Compression << ". The image will be sent uncompressed.");
+        stream.Compression.clear();
+      }
+      if (!vtkPlusIgtlImageCompressor::GetPredictorFromString(stream.CompressionPredictor, predictor))
+      {
+        LOG_WARNING("CompressionPredictor attribute of ImageNames/Image element #" << i << " is invalid: " << stream.CompressionPredictor << ". No predictor will be used.");
+        stream.CompressionPredictor.clear();
+      }
+
+      XML_READ_STRING_ATTRIBUTE_NONMEMBER_OPTIONAL(OutputChannelId, stream.OutputChannelId, imageElem);
+      ReadFrameRateLimit(imageElem, "ImageNames/Image", stream.RateLimit);
+
       clientInfo.ImageStreams.push_back(stream);
     }
   }
@@ -193,6 +360,8 @@ PlusStatus PlusIgtlClientInfo::SetClientInfoFromXmlData(vtkXMLDataElement* xmlda
         XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, Speed, stream.EncodeVideoParameters.Speed, encodingElem);
         XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, TargetBitrate, stream.EncodeVideoParameters.TargetBitrate, encodingElem);
       }
+      XML_READ_STRING_ATTRIBUTE_NONMEMBER_OPTIONAL(OutputChannelId, stream.OutputChannelId, videoElem);
+      ReadFrameRateLimit(videoElem, "VideoNames/Video", stream.RateLimit);
 
       clientInfo.VideoStreams.push_back(stream);
     }
@@ -235,6 +404,30 @@ void PlusIgtlClientInfo::GetClientInfoInXmlData(std::string& strXmlData)
   xmldata->SetName("ClientInfo");
   xmldata->SetAttribute("TDATARequested", (this->GetTDATARequested() ? "TRUE" : "FALSE"));
   xmldata->SetIntAttribute("TDATAResolution", this->GetTDATAResolution());
+  if (!this->SendQueueDropPolicy.empty())
+  {
+    xmldata->SetAttribute("SendQueueDropPolicy", this->SendQueueDropPolicy.c_str());
+  }
+  if (this->SendChangedTransformsOnly)
+  {
+    xmldata->SetAttribute("SendChangedTransformsOnly", "TRUE");
+    xmldata->SetDoubleAttribute("TransformChangeThresholdMm", this->TransformChangeThresholdMm);
+    xmldata->SetDoubleAttribute("TransformChangeThresholdDeg", this->TransformChangeThresholdDeg);
+    xmldata->SetDoubleAttribute("TransformRefreshIntervalSec", this->TransformRefreshIntervalSec);
+  }
+  if (this->SharedMemoryTransport)
+  {
+    xmldata->SetAttribute("SharedMemoryTransport", "TRUE");
+  }
+  if (this->TrackedFrameFieldsVersion > 0)
+  {
+    xmldata->SetIntAttribute("TrackedFrameFieldsVersion", this->TrackedFrameFieldsVersion);
+  }
+  if (!this->OutputChannelId.empty())
+  {
+    xmldata->SetAttribute("OutputChannelId", this->OutputChannelId.c_str());
+  }
+  WriteFrameRateLimit(xmldata, this->RateLimit);
 
   vtkSmartPointer<vtkXMLDataElement> messageTypes = vtkSmartPointer<vtkXMLDataElement>::New();
   messageTypes->SetName("MessageTypes");
@@ -291,6 +484,33 @@ void PlusIgtlClientInfo::GetClientInfoInXmlData(std::string& strXmlData)
     image->SetName("Image");
     image->SetAttribute("Name", ImageStreams[i].Name.c_str());
     image->SetAttribute("EmbeddedTransformToFrame", ImageStreams[i].EmbeddedTransformToFrame.c_str());
+    if (ImageStreams[i].ClipRectangleSize[0] > 0 && ImageStreams[i].ClipRectangleSize[1] > 0)
+    {
+      image->SetVectorAttribute("ClipRectangleOrigin", 2, ImageStreams[i].ClipRectangleOrigin.data());
+      image->SetVectorAttribute("ClipRectangleSize", 2, ImageStreams[i].ClipRectangleSize.data());
+    }
+    if (ImageStreams[i].DownsamplingFactor > 1)
+    {
+      image->SetIntAttribute("DownsamplingFactor", ImageStreams[i].DownsamplingFactor);
+    }
+    if (ImageStreams[i].ScalarType != VTK_VOID)
+    {
+      image->SetAttribute("ScalarType", GetImageStreamScalarTypeAsString(ImageStreams[i].ScalarType).c_str());
+    }
+    if (ImageStreams[i].IsCompressionRequested())
+    {
+      image->SetAttribute("Compression", ImageStreams[i].Compression.c_str());
+      if (!ImageStreams[i].CompressionPredictor.empty())
+      {
+        image->SetAttribute("CompressionPredictor", ImageStreams[i].CompressionPredictor.c_str());
+        image->SetIntAttribute("CompressionKeyFrameInterval", ImageStreams[i].CompressionKeyFrameInterval);
+      }
+    }
+    if (!ImageStreams[i].OutputChannelId.empty())
+    {
+      image->SetAttribute("OutputChannelId", ImageStreams[i].OutputChannelId.c_str());
+    }
+    WriteFrameRateLimit(image, ImageStreams[i].RateLimit);
     imageNames->AddNestedElement(image);
   }
   xmldata->AddNestedElement(imageNames);
@@ -325,6 +545,24 @@ void PlusIgtlClientInfo::PrintSelf(ostream& os, vtkIndent indent)
   os << indent << "TDATARequested: " << (this->GetTDATARequested() ? "TRUE" : "FALSE") << ". ";
   os << indent << "LastTDATASentTimeStamp: " << this->GetLastTDATASentTimeStamp() << ". ";
   os << indent << "TDATAResolution: " << this->GetTDATAResolution() << ". ";
+  os << indent << "SendChangedTransformsOnly: " << (this->SendChangedTransformsOnly ? "TRUE" : "FALSE") << ". ";
+  if (this->SendChangedTransformsOnly)
+  {
+    os << indent << "TransformChangeThresholdMm: " << this->TransformChangeThresholdMm << ". ";
+    os << indent << "TransformChangeThresholdDeg: " << this->TransformChangeThresholdDeg << ". ";
+    os << indent << "TransformRefreshIntervalSec: " << this->TransformRefreshIntervalSec << ". ";
+  }
+  os << indent << "SharedMemoryTransport: " << (this->SharedMemoryTransport ? "TRUE" : "FALSE") << ". ";
+  os << indent << "TrackedFrameFieldsVersion: " << this->TrackedFrameFieldsVersion << ". ";
+  if (!this->OutputChannelId.empty())
+  {
+    os << indent << "OutputChannelId: " << this->OutputChannelId << ". ";
+  }
+  if (this->RateLimit.IsLimited())
+  {
+    os << indent << "MaxFrameRate: " << this->RateLimit.MaxFrameRate << ". ";
+    os << indent << "FrameDecimation: " << this->RateLimit.FrameDecimation << ". ";
+  }
 
   os << ". Transforms: ";
   if (!this->TransformNames.empty())
@@ -373,7 +611,30 @@ void PlusIgtlClientInfo::PrintSelf(ostream& os, vtkIndent indent)
       {
         os << ", ";
       }
-      os << this->ImageStreams[i].Name << " (EmbeddedTransformToFrame: " << this->ImageStreams[i].EmbeddedTransformToFrame << ")";
+      os << this->ImageStreams[i].Name << " (EmbeddedTransformToFrame: " << this->ImageStreams[i].EmbeddedTransformToFrame;
+      if (this->ImageStreams[i].IsImageProcessingRequested())
+      {
+        os << ", ClipRectangleOrigin: " << this->ImageStreams[i].ClipRectangleOrigin[0] << " " << this->ImageStreams[i].ClipRectangleOrigin[1]
+           << ", ClipRectangleSize: " << this->ImageStreams[i].ClipRectangleSize[0] << " " << this->ImageStreams[i].ClipRectangleSize[1]
+           << ", DownsamplingFactor: " << this->ImageStreams[i].DownsamplingFactor
+           << ", ScalarType: " << (this->ImageStreams[i].ScalarType == VTK_VOID ? "(unchanged)" : GetImageStreamScalarTypeAsString(this->ImageStreams[i].ScalarType));
+      }
+      if (this->ImageStreams[i].IsCompressionRequested())
+      {
+        os << ", Compression: " << this->ImageStreams[i].Compression
+           << ", CompressionPredictor: " << (this->ImageStreams[i].CompressionPredictor.empty() ? "NONE" : this->ImageStreams[i].CompressionPredictor)
+           << ", CompressionKeyFrameInterval: " << this->ImageStreams[i].CompressionKeyFrameInterval;
+      }
+      if (!this->ImageStreams[i].OutputChannelId.empty())
+      {
+        os << ", OutputChannelId: " << this->ImageStreams[i].OutputChannelId;
+      }
+      if (this->ImageStreams[i].RateLimit.IsLimited())
+      {
+        os << ", MaxFrameRate: " << this->ImageStreams[i].RateLimit.MaxFrameRate
+           << ", FrameDecimation: " << this->ImageStreams[i].RateLimit.FrameDecimation;
+      }
+      os << ")";
     }
   }
   else
@@ -429,3 +690,267 @@ void PlusIgtlClientInfo::SetLastTDATASentTimeStamp(double val)
 {
   this->LastTDATASentTimeStamp = val;
 }
+
+//----------------------------------------------------------------------------
+std::string PlusIgtlClientInfo::GetSendQueueDropPolicy() const
+{
+  return this->SendQueueDropPolicy;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::SetSendQueueDropPolicy(const std::string& val)
+{
+  this->SendQueueDropPolicy = val;
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlClientInfo::GetSendChangedTransformsOnly() const
+{
+  return this->SendChangedTransformsOnly;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::SetSendChangedTransformsOnly(bool val)
+{
+  this->SendChangedTransformsOnly = val;
+}
+
+//----------------------------------------------------------------------------
+double PlusIgtlClientInfo::GetTransformChangeThresholdMm() const
+{
+  return this->TransformChangeThresholdMm;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::SetTransformChangeThresholdMm(double val)
+{
+  this->TransformChangeThresholdMm = val;
+}
+
+//----------------------------------------------------------------------------
+double PlusIgtlClientInfo::GetTransformChangeThresholdDeg() const
+{
+  return this->TransformChangeThresholdDeg;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::SetTransformChangeThresholdDeg(double val)
+{
+  this->TransformChangeThresholdDeg = val;
+}
+
+//----------------------------------------------------------------------------
+double PlusIgtlClientInfo::GetTransformRefreshIntervalSec() const
+{
+  return this->TransformRefreshIntervalSec;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::SetTransformRefreshIntervalSec(double val)
+{
+  this->TransformRefreshIntervalSec = val;
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlClientInfo::GetSharedMemoryTransport() const
+{
+  return this->SharedMemoryTransport;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::SetSharedMemoryTransport(bool val)
+{
+  this->SharedMemoryTransport = val;
+}
+
+//----------------------------------------------------------------------------
+int PlusIgtlClientInfo::GetTrackedFrameFieldsVersion() const
+{
+  return this->TrackedFrameFieldsVersion;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::SetTrackedFrameFieldsVersion(int val)
+{
+  this->TrackedFrameFieldsVersion = val;
+}
+
+//----------------------------------------------------------------------------
+std::string PlusIgtlClientInfo::GetOutputChannelId() const
+{
+  return this->OutputChannelId;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::SetOutputChannelId(const std::string& val)
+{
+  this->OutputChannelId = val;
+}
+
+//----------------------------------------------------------------------------
+const PlusIgtlClientInfo::FrameRateLimit& PlusIgtlClientInfo::GetRateLimit() const
+{
+  return this->RateLimit;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::SetRateLimit(double maxFrameRate, int frameDecimation)
+{
+  this->RateLimit.MaxFrameRate = maxFrameRate;
+  this->RateLimit.FrameDecimation = frameDecimation;
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlClientInfo::IsFrameRateLimited() const
+{
+  if (this->RateLimit.IsLimited())
+  {
+    return true;
+  }
+  for (std::vector<ImageStream>::const_iterator it = this->ImageStreams.begin(); it != this->ImageStreams.end(); ++it)
+  {
+    if (it->RateLimit.IsLimited())
+    {
+      return true;
+    }
+  }
+  for (std::vector<VideoStream>::const_iterator it = this->VideoStreams.begin(); it != this->VideoStreams.end(); ++it)
+  {
+    if (it->RateLimit.IsLimited())
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::ResetFrameRateLimitState()
+{
+  this->RateLimit.ResetState();
+  for (std::vector<ImageStream>::iterator it = this->ImageStreams.begin(); it != this->ImageStreams.end(); ++it)
+  {
+    it->RateLimit.ResetState();
+  }
+  for (std::vector<VideoStream>::iterator it = this->VideoStreams.begin(); it != this->VideoStreams.end(); ++it)
+  {
+    it->RateLimit.ResetState();
+  }
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlClientInfo::ResetStreamEncoders()
+{
+  for (std::vector<ImageStream>::iterator it = this->ImageStreams.begin(); it != this->ImageStreams.end(); ++it)
+  {
+    it->FrameConverter = vtkSmartPointer<vtkIGSIOFrameConverter>::New();
+    it->Compressor = vtkSmartPointer<vtkPlusIgtlImageCompressor>::New();
+  }
+  for (std::vector<VideoStream>::iterator it = this->VideoStreams.begin(); it != this->VideoStreams.end(); ++it)
+  {
+    it->FrameConverter = vtkSmartPointer<vtkIGSIOFrameConverter>::New();
+  }
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlClientInfo::FrameRateLimit::AcceptFrame(double timestamp) const
+{
+  if (!this->IsLimited())
+  {
+    return true;
+  }
+
+  this->State->NumberOfOfferedFrames++;
+  if (this->State->Started)
+  {
+    if (this->FrameDecimation > 1 && this->State->NumberOfOfferedFrames < this->FrameDecimation)
+    {
+      return false;
+    }
+    if (this->MaxFrameRate > 0.0 && timestamp < this->State->NextFrameTimestamp)
+    {
+      return false;
+    }
+  }
+
+  if (this->MaxFrameRate > 0.0)
+  {
+    // Keep a steady cadence, unless the frames stopped for longer than a period
+    double framePeriodSec = 1.0 / this->MaxFrameRate;
+    this->State->NextFrameTimestamp = (this->State->Started && this->State->NextFrameTimestamp + framePeriodSec > timestamp)
+                                      ? this->State->NextFrameTimestamp + framePeriodSec : timestamp + framePeriodSec;
+  }
+  this->State->NumberOfOfferedFrames = 0;
+  this->State->Started = true;
+  return true;
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlClientInfo::GetFrameClientInfo(const std::string& channelId, const std::string& defaultChannelId, double timestamp, PlusIgtlClientInfo& frameClientInfo) const
+{
+  const std::string clientChannelId = (this->OutputChannelId.empty() ? defaultChannelId : this->OutputChannelId);
+  bool clientChannelFrame = (channelId.empty() || clientChannelId == channelId);
+  if (clientChannelFrame && !this->RateLimit.AcceptFrame(timestamp))
+  {
+    return false;
+  }
+
+  frameClientInfo = *this;
+  frameClientInfo.ImageStreams.clear();
+  for (std::vector<ImageStream>::const_iterator it = this->ImageStreams.begin(); it != this->ImageStreams.end(); ++it)
+  {
+    if (!channelId.empty() && (it->OutputChannelId.empty() ? clientChannelId : it->OutputChannelId) != channelId)
+    {
+      continue;
+    }
+    if (it->RateLimit.AcceptFrame(timestamp))
+    {
+      frameClientInfo.ImageStreams.push_back(*it);
+    }
+  }
+  frameClientInfo.VideoStreams.clear();
+  for (std::vector<VideoStream>::const_iterator it = this->VideoStreams.begin(); it != this->VideoStreams.end(); ++it)
+  {
+    if (!channelId.empty() && (it->OutputChannelId.empty() ? clientChannelId : it->OutputChannelId) != channelId)
+    {
+      continue;
+    }
+    if (it->RateLimit.AcceptFrame(timestamp))
+    {
+      frameClientInfo.VideoStreams.push_back(*it);
+    }
+  }
+
+  if (!clientChannelFrame)
+  {
+    // Only image and video streams are served from other channels
+    frameClientInfo.TransformNames.clear();
+    frameClientInfo.StringNames.clear();
+    frameClientInfo.SetTDATARequested(false);
+  }
+
+  // Image and video messages are only packed if a stream remained
+  frameClientInfo.IgtlMessageTypes.clear();
+  for (std::vector<std::string>::const_iterator it = this->IgtlMessageTypes.begin(); it != this->IgtlMessageTypes.end(); ++it)
+  {
+    if (*it == "IMAGE")
+    {
+      if (!frameClientInfo.ImageStreams.empty())
+      {
+        frameClientInfo.IgtlMessageTypes.push_back(*it);
+      }
+    }
+    else if (*it == "VIDEO")
+    {
+      if (!frameClientInfo.VideoStreams.empty())
+      {
+        frameClientInfo.IgtlMessageTypes.push_back(*it);
+      }
+    }
+    else if (clientChannelFrame)
+    {
+      frameClientInfo.IgtlMessageTypes.push_back(*it);
+    }
+  }
+  return !frameClientInfo.IgtlMessageTypes.empty();
+}
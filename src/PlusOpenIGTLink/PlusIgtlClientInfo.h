@@ -9,6 +9,7 @@
 
 // Local includes
 #include "PlusConfigure.h"
+#include "vtkPlusIgtlImageCompressor.h"
 #include "vtkPlusOpenIGTLinkExport.h"
 
 // IGSIO includes
@@ -18,6 +19,8 @@
 #include <igtlClientSocket.h>
 
 // STL includes
+#include <array>
+#include <memory>
 #include <string>
 #include <vector>
 
@@ -58,8 +61,56 @@ public:
     }
   };
 
+  /*!
+  Maximum rate of the frames sent to a client or in a stream. A frame is accepted if at least 1/MaxFrameRate seconds
+  elapsed since the previously accepted frame and it is not skipped by the FrameDecimation.
+  Copies of the limit share the state, so the limit applies to all copies of a client info.
+  */
+  struct FrameRateLimit
+  {
+    /*! Maximum number of frames per second. 0 means no limit. */
+    double MaxFrameRate;
+    /*! Only every FrameDecimation-th frame is accepted. 1 means every frame. */
+    int FrameDecimation;
+    FrameRateLimit()
+      : MaxFrameRate(0.0)
+      , FrameDecimation(1)
+      , State(std::make_shared<LimitState>())
+    {
+    }
+    /*! True if not all frames are accepted */
+    bool IsLimited() const
+    {
+      return MaxFrameRate > 0.0 || FrameDecimation > 1;
+    }
+    /*! Returns true if the frame has to be sent and then records it as sent */
+    bool AcceptFrame(double timestamp) const;
+    /*! Forget the previously accepted frames, and stop sharing the state with the copies of the limit */
+    void ResetState()
+    {
+      State = std::make_shared<LimitState>();
+    }
+  protected:
+    struct LimitState
+    {
+      LimitState()
+        : NextFrameTimestamp(0.0)
+        , NumberOfOfferedFrames(0)
+        , Started(false)
+      {
+      }
+      double NextFrameTimestamp;
+      int NumberOfOfferedFrames;
+      bool Started;
+    };
+    std::shared_ptr<LimitState> State;
+  };
+
   /*! Helper struct for storing image stream and embedded transform frame names
   IGTL image message device name: [Name]_[EmbeddedTransformToFrame]
+  The image can be cropped, downsampled and converted to another pixel type before it is sent, which reduces
+  the bandwidth and decoding cost for clients that do not need the full image (e.g., previews).
+  If Compression is set then the image is sent losslessly compressed in a CIMAGE (igtl::PlusCompressedImageMessage) message instead of IMAGE.
   */
   struct ImageStream
   {
@@ -67,12 +118,48 @@ public:
     std::string Name;
     /*! Name of the IGTL image message embedded transform "To" frame */
     std::string EmbeddedTransformToFrame;
+    /*! Origin of the sent region of interest in pixels. Ignored if ClipRectangleSize is not set. */
+    std::array<int, 2> ClipRectangleOrigin;
+    /*! Size of the sent region of interest in pixels. Non-positive values mean the full image. */
+    std::array<int, 2> ClipRectangleSize;
+    /*! Each sent pixel is the average of DownsamplingFactor x DownsamplingFactor image pixels. 1 means full resolution. */
+    int DownsamplingFactor;
+    /*! VTK scalar type of the sent pixels (VTK_UNSIGNED_CHAR, VTK_UNSIGNED_SHORT, VTK_SHORT or VTK_FLOAT). VTK_VOID means the pixel type of the frame. */
+    int ScalarType;
+    /*! Lossless compression method of the sent pixels (ZLIB). Empty means that images are sent uncompressed. */
+    std::string Compression;
+    /*! Prediction applied before compression (NONE or DELTA). DELTA compresses the difference to the previous frame. */
+    std::string CompressionPredictor;
+    /*! Maximum number of frames between two key frames if a predictor is used */
+    int CompressionKeyFrameInterval;
+    /*! Output channel that the images are taken from. Empty means the channel of the client (see GetOutputChannelId). */
+    std::string OutputChannelId;
+    /*! Maximum rate of the images (MaxFrameRate and FrameDecimation attributes). Skipped images are not packed. */
+    FrameRateLimit RateLimit;
     /*! Class for decoding and encoding frames */
     vtkSmartPointer<vtkIGSIOFrameConverter> FrameConverter;
+    /*! Compression state of the stream (previous frame for prediction) */
+    vtkSmartPointer<vtkPlusIgtlImageCompressor> Compressor;
     ImageStream()
-      : FrameConverter(vtkSmartPointer<vtkIGSIOFrameConverter>::New())
+      : DownsamplingFactor(1)
+      , ScalarType(VTK_VOID)
+      , CompressionKeyFrameInterval(30)
+      , FrameConverter(vtkSmartPointer<vtkIGSIOFrameConverter>::New())
+      , Compressor(vtkSmartPointer<vtkPlusIgtlImageCompressor>::New())
     {
+      ClipRectangleOrigin.fill(0);
+      ClipRectangleSize.fill(0);
     };
+    /*! True if the image is cropped, downsampled or converted before sending */
+    bool IsImageProcessingRequested() const
+    {
+      return (ClipRectangleSize[0] > 0 && ClipRectangleSize[1] > 0) || DownsamplingFactor > 1 || ScalarType != VTK_VOID;
+    }
+    /*! True if the image is sent in a compressed image message */
+    bool IsCompressionRequested() const
+    {
+      return !Compression.empty();
+    }
   };
 
   /*! Helper struct for storing video stream and embedded transform frame names
@@ -86,6 +173,10 @@ public:
     std::string EmbeddedTransformToFrame;
     /*! Parameters for how to encode video for compressed streams*/
     EncodingParameters EncodeVideoParameters;
+    /*! Output channel that the frames are taken from. Empty means the channel of the client (see GetOutputChannelId). */
+    std::string OutputChannelId;
+    /*! Maximum rate of the frames given to the encoder (MaxFrameRate and FrameDecimation attributes) */
+    FrameRateLimit RateLimit;
     /*! Class for decoding and encoding frames */
     vtkSmartPointer<vtkIGSIOFrameConverter> FrameConverter;
     VideoStream()
@@ -129,6 +220,78 @@ public:
   /*! timestamp of the last sent TDATA message. */
   void SetLastTDATASentTimeStamp(double val);
 
+  /*! Requested action when the server's send queue for this client is full (DROP_OLDEST, DROP_NEWEST or DISCONNECT). Empty means the server default. */
+  std::string GetSendQueueDropPolicy() const;
+  /*! Requested action when the server's send queue for this client is full (DROP_OLDEST, DROP_NEWEST or DISCONNECT). Empty means the server default. */
+  void SetSendQueueDropPolicy(const std::string& val);
+
+  /*!
+  If enabled then TRANSFORM, POSITION and TDATA data of a transform is only sent if the transform or its status changed
+  since it was last sent to the client. Unchanged transforms are still sent every TransformRefreshIntervalSec, so that
+  clients that start receiving a shared stream later also get them.
+  */
+  bool GetSendChangedTransformsOnly() const;
+  void SetSendChangedTransformsOnly(bool val);
+
+  /*! Translation change (in mm) below which a transform is considered unchanged. 0 means that any change is sent. */
+  double GetTransformChangeThresholdMm() const;
+  void SetTransformChangeThresholdMm(double val);
+
+  /*! Rotation change (in degrees) below which a transform is considered unchanged. 0 means that any change is sent. */
+  double GetTransformChangeThresholdDeg() const;
+  void SetTransformChangeThresholdDeg(double val);
+
+  /*! Maximum time between two sends of an unchanged transform if SendChangedTransformsOnly is enabled */
+  double GetTransformRefreshIntervalSec() const;
+  void SetTransformRefreshIntervalSec(double val);
+
+  /*!
+  If enabled then the client requests the shared memory transport: the server writes the messages into a shared memory
+  ring and sends only SHMNOTIFY notifications on the socket (see vtkPlusIgtlSharedMemoryReceiver).
+  The server ignores the request if the client is not on the same host or the transport is not allowed.
+  */
+  bool GetSharedMemoryTransport() const;
+  void SetSharedMemoryTransport(bool val);
+
+  /*!
+  Latest encoding of the frame fields in TRACKEDFRAME messages that the client can decode
+  (see igtl::PlusTrackedFrameMessage::FieldsVersion). 0 means XML, which all clients support.
+  */
+  int GetTrackedFrameFieldsVersion() const;
+  void SetTrackedFrameFieldsVersion(int val);
+
+  /*!
+  Output channel that transforms, strings and all other non-stream data (and image and video streams without their own
+  OutputChannelId) are taken from, if the server broadcasts multiple channels. Empty means the server's OutputChannelId.
+  */
+  std::string GetOutputChannelId() const;
+  void SetOutputChannelId(const std::string& val);
+
+  /*!
+  Maximum rate of all data that is sent to the client from its channel (MaxFrameRate and FrameDecimation attributes).
+  Frames skipped for the client are not packed for it. Streams can have their own, additional limits.
+  */
+  const FrameRateLimit& GetRateLimit() const;
+  void SetRateLimit(double maxFrameRate, int frameDecimation);
+
+  /*! True if the rate of the client or any of its streams is limited */
+  bool IsFrameRateLimited() const;
+
+  /*! Start the rate limits of the client and its streams from scratch, not shared with the client info that this was copied from */
+  void ResetFrameRateLimitState();
+
+  /*! Create new encoders (frame converters and compressors) for the streams, not shared with the client info that this was copied from */
+  void ResetStreamEncoders();
+
+  /*!
+  Get the part of the client info that has to be sent from a tracked frame of an output channel: the image and video
+  streams of the channel and, if it is the channel of the client, all other requested data. Data whose rate limit skips
+  the frame is left out, and the frame is recorded as sent for the remaining data.
+  If channelId is empty then the channels of the streams are ignored. Empty channel IDs of the client info refer to defaultChannelId.
+  Returns false if nothing has to be sent.
+  */
+  bool GetFrameClientInfo(const std::string& channelId, const std::string& defaultChannelId, double timestamp, PlusIgtlClientInfo& frameClientInfo) const;
+
   /*! Message types that client expects from the server */
   std::vector<std::string> IgtlMessageTypes;
 
@@ -149,6 +312,15 @@ protected:
   bool    TDATARequested;
   double  LastTDATASentTimeStamp;
   int     TDATAResolution;
+  std::string SendQueueDropPolicy;
+  bool    SendChangedTransformsOnly;
+  double  TransformChangeThresholdMm;
+  double  TransformChangeThresholdDeg;
+  double  TransformRefreshIntervalSec;
+  bool    SharedMemoryTransport;
+  int     TrackedFrameFieldsVersion;
+  std::string OutputChannelId;
+  FrameRateLimit RateLimit;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,354 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusIgtlSharedMemoryRing.h"
+#include "vtkPlusIgtlMessageCommon.h"
+
+// STL includes
+#include <atomic>
+#include <cstring>
+#include <new>
+#include <sstream>
+
+// OS includes
+#ifndef _WIN32
+  #include <errno.h>
+  #include <fcntl.h>
+  #include <sys/mman.h>
+  #include <sys/stat.h>
+  #include <unistd.h>
+#endif
+
+namespace
+{
+  const uint32_t SHARED_MEMORY_RING_MAGIC = 0x504c534d; // "PLSM"
+  const uint32_t SHARED_MEMORY_RING_VERSION = 1;
+  // Headers are placed on separate cache lines so that the writer and the readers do not share them unnecessarily
+  const size_t SHARED_MEMORY_ALIGNMENT = 64;
+
+  size_t AlignSize(size_t size)
+  {
+    return (size + SHARED_MEMORY_ALIGNMENT - 1) / SHARED_MEMORY_ALIGNMENT * SHARED_MEMORY_ALIGNMENT;
+  }
+}
+
+//----------------------------------------------------------------------------
+struct PlusIgtlSharedMemoryRing::RingHeader
+{
+  uint32_t Magic;
+  uint32_t Version;
+  uint32_t NumberOfSlots;
+  uint32_t SlotSize;
+  std::atomic<uint64_t> WriteSequence;
+};
+
+//----------------------------------------------------------------------------
+struct PlusIgtlSharedMemoryRing::SlotHeader
+{
+  /*! Sequence number of the item in the slot, 0 while the slot is being written */
+  std::atomic<uint64_t> Sequence;
+  uint64_t DataSize;
+};
+
+//----------------------------------------------------------------------------
+PlusIgtlSharedMemoryRing::PlusIgtlSharedMemoryRing()
+  : Memory(NULL)
+  , MemorySize(0)
+  , Owner(false)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusIgtlSharedMemoryRing::~PlusIgtlSharedMemoryRing()
+{
+  this->Close();
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlSharedMemoryRing::IsSupported()
+{
+#ifndef _WIN32
+  // The sequence numbers are accessed from multiple processes, which requires address-free atomics
+  return ATOMIC_LLONG_LOCK_FREE == 2;
+#else
+  return false;
+#endif
+}
+
+//----------------------------------------------------------------------------
+std::string PlusIgtlSharedMemoryRing::GetUniqueName(const std::string& prefix)
+{
+  // A replaced ring may still exist while the new one is created, so names are not reused within the process
+  static std::atomic<unsigned int> nameCounter(0);
+  std::ostringstream name;
+  name << "/" << prefix;
+#ifndef _WIN32
+  name << "_" << getpid();
+#endif
+  name << "_" << nameCounter++;
+  return name.str();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIgtlSharedMemoryRing::Create(const std::string& name, unsigned int numberOfSlots, unsigned int slotSize)
+{
+  this->Close();
+  if (!IsSupported())
+  {
+    LOG_ERROR("Shared memory rings are not supported on this platform");
+    return PLUS_FAIL;
+  }
+  if (numberOfSlots == 0 || slotSize == 0)
+  {
+    LOG_ERROR("Failed to create shared memory ring " << name << ": invalid size (" << numberOfSlots << " slots of " << slotSize << " bytes)");
+    return PLUS_FAIL;
+  }
+#ifndef _WIN32
+  size_t size = AlignSize(sizeof(RingHeader)) + numberOfSlots * (AlignSize(sizeof(SlotHeader)) + AlignSize(slotSize));
+  int fileDescriptor = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR);
+  if (fileDescriptor < 0)
+  {
+    LOG_ERROR("Failed to create shared memory ring " << name << ": " << strerror(errno));
+    return PLUS_FAIL;
+  }
+  this->Name = name;
+  this->Owner = true;
+  if (ftruncate(fileDescriptor, size) != 0)
+  {
+    LOG_ERROR("Failed to allocate " << size << " bytes for shared memory ring " << name << ": " << strerror(errno));
+    close(fileDescriptor);
+    this->Close();
+    return PLUS_FAIL;
+  }
+  if (this->Map(fileDescriptor, size, true) != PLUS_SUCCESS)
+  {
+    this->Close();
+    return PLUS_FAIL;
+  }
+
+  RingHeader* ringHeader = new (this->Memory) RingHeader;
+  ringHeader->Magic = SHARED_MEMORY_RING_MAGIC;
+  ringHeader->Version = SHARED_MEMORY_RING_VERSION;
+  ringHeader->NumberOfSlots = numberOfSlots;
+  ringHeader->SlotSize = slotSize;
+  for (unsigned int i = 0; i < numberOfSlots; ++i)
+  {
+    SlotHeader* slotHeader = new (this->Memory + AlignSize(sizeof(RingHeader)) + i * (AlignSize(sizeof(SlotHeader)) + AlignSize(slotSize))) SlotHeader;
+    slotHeader->Sequence.store(0, std::memory_order_relaxed);
+    slotHeader->DataSize = 0;
+  }
+  ringHeader->WriteSequence.store(0, std::memory_order_release);
+  return PLUS_SUCCESS;
+#else
+  return PLUS_FAIL;
+#endif
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIgtlSharedMemoryRing::Open(const std::string& name)
+{
+  this->Close();
+  if (!IsSupported())
+  {
+    LOG_ERROR("Shared memory rings are not supported on this platform");
+    return PLUS_FAIL;
+  }
+#ifndef _WIN32
+  int fileDescriptor = shm_open(name.c_str(), O_RDONLY, 0);
+  if (fileDescriptor < 0)
+  {
+    LOG_ERROR("Failed to open shared memory ring " << name << ": " << strerror(errno));
+    return PLUS_FAIL;
+  }
+  struct stat fileStatus;
+  if (fstat(fileDescriptor, &fileStatus) != 0 || static_cast<size_t>(fileStatus.st_size) < AlignSize(sizeof(RingHeader)))
+  {
+    LOG_ERROR("Failed to open shared memory ring " << name << ": invalid size");
+    close(fileDescriptor);
+    return PLUS_FAIL;
+  }
+  this->Name = name;
+  if (this->Map(fileDescriptor, fileStatus.st_size, false) != PLUS_SUCCESS)
+  {
+    this->Close();
+    return PLUS_FAIL;
+  }
+
+  const RingHeader* ringHeader = reinterpret_cast<const RingHeader*>(this->Memory);
+  size_t expectedSize = AlignSize(sizeof(RingHeader)) + ringHeader->NumberOfSlots * (AlignSize(sizeof(SlotHeader)) + AlignSize(ringHeader->SlotSize));
+  if (ringHeader->Magic != SHARED_MEMORY_RING_MAGIC || ringHeader->Version > SHARED_MEMORY_RING_VERSION || ringHeader->NumberOfSlots == 0 || expectedSize > this->MemorySize)
+  {
+    LOG_ERROR("Failed to open shared memory ring " << name << ": invalid or unsupported ring header");
+    this->Close();
+    return PLUS_FAIL;
+  }
+  return PLUS_SUCCESS;
+#else
+  return PLUS_FAIL;
+#endif
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIgtlSharedMemoryRing::Map(int fileDescriptor, size_t size, bool writable)
+{
+#ifndef _WIN32
+  void* memory = mmap(NULL, size, writable ? (PROT_READ | PROT_WRITE) : PROT_READ, MAP_SHARED, fileDescriptor, 0);
+  // The mapping remains valid after the descriptor is closed
+  close(fileDescriptor);
+  if (memory == MAP_FAILED)
+  {
+    LOG_ERROR("Failed to map shared memory ring " << this->Name << ": " << strerror(errno));
+    return PLUS_FAIL;
+  }
+  this->Memory = static_cast<unsigned char*>(memory);
+  this->MemorySize = size;
+  return PLUS_SUCCESS;
+#else
+  return PLUS_FAIL;
+#endif
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlSharedMemoryRing::Close()
+{
+#ifndef _WIN32
+  if (this->Memory != NULL)
+  {
+    munmap(this->Memory, this->MemorySize);
+  }
+  if (this->Owner && !this->Name.empty())
+  {
+    shm_unlink(this->Name.c_str());
+  }
+#endif
+  this->Memory = NULL;
+  this->MemorySize = 0;
+  this->Owner = false;
+  this->Name.clear();
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlSharedMemoryRing::IsOpen() const
+{
+  return this->Memory != NULL;
+}
+
+//----------------------------------------------------------------------------
+std::string PlusIgtlSharedMemoryRing::GetName() const
+{
+  return this->Name;
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusIgtlSharedMemoryRing::GetNumberOfSlots() const
+{
+  return this->Memory != NULL ? reinterpret_cast<const RingHeader*>(this->Memory)->NumberOfSlots : 0;
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusIgtlSharedMemoryRing::GetSlotSize() const
+{
+  return this->Memory != NULL ? reinterpret_cast<const RingHeader*>(this->Memory)->SlotSize : 0;
+}
+
+//----------------------------------------------------------------------------
+PlusIgtlSharedMemoryRing::SlotHeader* PlusIgtlSharedMemoryRing::GetSlotHeader(uint64_t sequence) const
+{
+  const RingHeader* ringHeader = reinterpret_cast<const RingHeader*>(this->Memory);
+  size_t slotIndex = static_cast<size_t>((sequence - 1) % ringHeader->NumberOfSlots);
+  return reinterpret_cast<SlotHeader*>(this->Memory + AlignSize(sizeof(RingHeader)) + slotIndex * (AlignSize(sizeof(SlotHeader)) + AlignSize(ringHeader->SlotSize)));
+}
+
+//----------------------------------------------------------------------------
+uint64_t PlusIgtlSharedMemoryRing::WriteItem(const std::vector<igtl::MessageBase::Pointer>& messages)
+{
+  if (this->Memory == NULL || !this->Owner)
+  {
+    LOG_ERROR("Cannot write shared memory ring: the ring is not created by this process");
+    return 0;
+  }
+  RingHeader* ringHeader = reinterpret_cast<RingHeader*>(this->Memory);
+
+  std::vector<igtl::PlusScatterGatherImageMessage::Segment> segments;
+  std::vector<igtl::PlusScatterGatherImageMessage::Segment> messageSegments;
+  size_t dataSize = 0;
+  for (std::vector<igtl::MessageBase::Pointer>::const_iterator messageIt = messages.begin(); messageIt != messages.end(); ++messageIt)
+  {
+    vtkPlusIgtlMessageCommon::GetPackedMessageSegments(*messageIt, messageSegments);
+    for (std::vector<igtl::PlusScatterGatherImageMessage::Segment>::const_iterator segmentIt = messageSegments.begin(); segmentIt != messageSegments.end(); ++segmentIt)
+    {
+      dataSize += segmentIt->Size;
+      segments.push_back(*segmentIt);
+    }
+  }
+  if (dataSize > ringHeader->SlotSize)
+  {
+    return 0;
+  }
+
+  uint64_t sequence = ringHeader->WriteSequence.load(std::memory_order_relaxed) + 1;
+  SlotHeader* slotHeader = this->GetSlotHeader(sequence);
+  unsigned char* slotData = reinterpret_cast<unsigned char*>(slotHeader) + AlignSize(sizeof(SlotHeader));
+
+  // Invalidate the slot before its contents are changed
+  slotHeader->Sequence.store(0, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  for (std::vector<igtl::PlusScatterGatherImageMessage::Segment>::const_iterator segmentIt = segments.begin(); segmentIt != segments.end(); ++segmentIt)
+  {
+    memcpy(slotData, segmentIt->Data, segmentIt->Size);
+    slotData += segmentIt->Size;
+  }
+  slotHeader->DataSize = dataSize;
+  slotHeader->Sequence.store(sequence, std::memory_order_release);
+  ringHeader->WriteSequence.store(sequence, std::memory_order_release);
+  return sequence;
+}
+
+//----------------------------------------------------------------------------
+uint64_t PlusIgtlSharedMemoryRing::GetWriteSequence() const
+{
+  if (this->Memory == NULL)
+  {
+    return 0;
+  }
+  return reinterpret_cast<const RingHeader*>(this->Memory)->WriteSequence.load(std::memory_order_acquire);
+}
+
+//----------------------------------------------------------------------------
+const unsigned char* PlusIgtlSharedMemoryRing::GetItemData(uint64_t sequence, size_t& size) const
+{
+  size = 0;
+  if (this->Memory == NULL || sequence == 0)
+  {
+    return NULL;
+  }
+  const SlotHeader* slotHeader = this->GetSlotHeader(sequence);
+  if (slotHeader->Sequence.load(std::memory_order_acquire) != sequence)
+  {
+    return NULL;
+  }
+  size = static_cast<size_t>(slotHeader->DataSize);
+  if (size > this->GetSlotSize())
+  {
+    // Torn read, the slot is being rewritten
+    size = 0;
+    return NULL;
+  }
+  return reinterpret_cast<const unsigned char*>(slotHeader) + AlignSize(sizeof(SlotHeader));
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlSharedMemoryRing::IsItemValid(uint64_t sequence) const
+{
+  if (this->Memory == NULL || sequence == 0)
+  {
+    return false;
+  }
+  std::atomic_thread_fence(std::memory_order_acquire);
+  return this->GetSlotHeader(sequence)->Sequence.load(std::memory_order_relaxed) == sequence;
+}
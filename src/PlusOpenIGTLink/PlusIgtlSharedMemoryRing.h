@@ -0,0 +1,100 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusIgtlSharedMemoryRing_h
+#define __PlusIgtlSharedMemoryRing_h
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusOpenIGTLinkExport.h"
+
+// IGTL includes
+#include <igtlMessageBase.h>
+
+// STL includes
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*!
+  \class PlusIgtlSharedMemoryRing
+  \brief Ring of frame slots in POSIX shared memory, for sending packed OpenIGTLink messages to a client on the same host
+
+  The ring is created by the server (single writer) and opened read-only by one or more readers. Each item contains
+  all the packed messages of one tracked frame, written back to back in wire format (header followed by body), so
+  the reader can unpack them the same way as from a socket, without any socket copy.
+
+  Items are numbered from 1. Item n is stored in slot (n-1) % NumberOfSlots, so a slow reader loses the oldest items.
+  Each slot is guarded by its sequence number (seqlock): the writer invalidates the slot before writing and publishes
+  the item's sequence number afterwards, the reader checks the sequence number before and after reading.
+
+  Available on POSIX systems only (see IsSupported()).
+
+  \ingroup PlusLibOpenIGTLink
+*/
+class vtkPlusOpenIGTLinkExport PlusIgtlSharedMemoryRing
+{
+public:
+  PlusIgtlSharedMemoryRing();
+  ~PlusIgtlSharedMemoryRing();
+
+  /*! Returns true if shared memory rings can be used on this platform */
+  static bool IsSupported();
+
+  /*! Returns a shared memory object name that is unique on the host, starting with the prefix */
+  static std::string GetUniqueName(const std::string& prefix);
+
+  /*! Create a new ring. The shared memory object is removed when the ring is closed. */
+  PlusStatus Create(const std::string& name, unsigned int numberOfSlots, unsigned int slotSize);
+
+  /*! Open an existing ring for reading */
+  PlusStatus Open(const std::string& name);
+
+  /*! Unmap the ring (and remove it, if it was created by this object) */
+  void Close();
+
+  bool IsOpen() const;
+
+  std::string GetName() const;
+  unsigned int GetNumberOfSlots() const;
+  unsigned int GetSlotSize() const;
+
+  /*!
+    Write the packed messages as the next item.
+    \return Sequence number of the written item, 0 if the messages do not fit in a slot
+  */
+  uint64_t WriteItem(const std::vector<igtl::MessageBase::Pointer>& messages);
+
+  /*! Sequence number of the most recently written item, 0 if nothing has been written yet */
+  uint64_t GetWriteSequence() const;
+
+  /*!
+    Get the data of an item. Returns NULL if the item is not in the ring (not written yet or already overwritten).
+    The data may be overwritten while it is read, therefore IsItemValid() must be checked after the data is read.
+  */
+  const unsigned char* GetItemData(uint64_t sequence, size_t& size) const;
+
+  /*! Returns true if the item is still in its slot */
+  bool IsItemValid(uint64_t sequence) const;
+
+protected:
+  struct RingHeader;
+  struct SlotHeader;
+
+  SlotHeader* GetSlotHeader(uint64_t sequence) const;
+  PlusStatus Map(int fileDescriptor, size_t size, bool writable);
+
+  std::string Name;
+  unsigned char* Memory;
+  size_t MemorySize;
+  bool Owner;
+
+private:
+  PlusIgtlSharedMemoryRing(const PlusIgtlSharedMemoryRing&);
+  void operator=(const PlusIgtlSharedMemoryRing&);
+};
+
+#endif
@@ -0,0 +1,228 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusIgtlClientInfoTest.cxx
+  \brief Verifies that PlusIgtlClientInfo::FrameRateLimit accepts the expected frames and that
+  PlusIgtlClientInfo::GetFrameClientInfo selects the streams and message types of a frame by
+  the frame rate limits and output channels of the client.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusIgtlClientInfo.h"
+
+// VTK includes
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <algorithm>
+
+namespace
+{
+  // Frame periods are powers of two, so that the timestamps are exact
+  const double FRAME_PERIOD_SEC = 1.0 / 32.0;
+  const double LIMITED_FRAME_RATE = 8.0;
+  const int NUMBER_OF_FRAMES = 64;
+
+  //----------------------------------------------------------------------------
+  bool HasMessageType(const PlusIgtlClientInfo& clientInfo, const std::string& messageType)
+  {
+    return std::find(clientInfo.IgtlMessageTypes.begin(), clientInfo.IgtlMessageTypes.end(), messageType) != clientInfo.IgtlMessageTypes.end();
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestFrameRateLimit()
+  {
+    PlusIgtlClientInfo::FrameRateLimit noLimit;
+    PlusIgtlClientInfo::FrameRateLimit rateLimit;
+    rateLimit.MaxFrameRate = LIMITED_FRAME_RATE;
+    PlusIgtlClientInfo::FrameRateLimit decimation;
+    decimation.FrameDecimation = 3;
+    if (noLimit.IsLimited() || !rateLimit.IsLimited() || !decimation.IsLimited())
+    {
+      LOG_ERROR("Unexpected IsLimited result");
+      return PLUS_FAIL;
+    }
+
+    for (int i = 0; i < NUMBER_OF_FRAMES; ++i)
+    {
+      double timestamp = 10.0 + i * FRAME_PERIOD_SEC;
+      bool expectedRateLimitAccept = (i % 4 == 0);
+      bool expectedDecimationAccept = (i % 3 == 0);
+      if (!noLimit.AcceptFrame(timestamp) || rateLimit.AcceptFrame(timestamp) != expectedRateLimitAccept || decimation.AcceptFrame(timestamp) != expectedDecimationAccept)
+      {
+        LOG_ERROR("Unexpected accepted frames at frame " << i);
+        return PLUS_FAIL;
+      }
+    }
+
+    // After a pause the cadence restarts at the next frame
+    if (!rateLimit.AcceptFrame(100.0) || rateLimit.AcceptFrame(100.0 + FRAME_PERIOD_SEC) || !rateLimit.AcceptFrame(100.0 + 1.0 / LIMITED_FRAME_RATE))
+    {
+      LOG_ERROR("Unexpected accepted frames after a pause");
+      return PLUS_FAIL;
+    }
+
+    // Copies share the state, until it is reset
+    PlusIgtlClientInfo::FrameRateLimit decimationCopy = decimation;
+    if (decimationCopy.AcceptFrame(0.0) || decimation.AcceptFrame(0.0) || !decimationCopy.AcceptFrame(0.0) || decimation.AcceptFrame(0.0))
+    {
+      LOG_ERROR("Copies of a frame rate limit are expected to share the accepted frames");
+      return PLUS_FAIL;
+    }
+    decimationCopy.ResetState();
+    if (!decimationCopy.AcceptFrame(0.0) || decimation.AcceptFrame(0.0) || !decimation.AcceptFrame(0.0))
+    {
+      LOG_ERROR("Frame rate limit with reset state is expected to accept the next frame independently of its original");
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusIgtlClientInfo CreateClientInfo()
+  {
+    PlusIgtlClientInfo clientInfo;
+    clientInfo.IgtlMessageTypes.push_back("TRANSFORM");
+    clientInfo.IgtlMessageTypes.push_back("IMAGE");
+    clientInfo.IgtlMessageTypes.push_back("VIDEO");
+    clientInfo.TransformNames.push_back(igsioTransformName("Probe", "Reference"));
+    PlusIgtlClientInfo::ImageStream imageStream;
+    imageStream.Name = "Image";
+    imageStream.EmbeddedTransformToFrame = "Reference";
+    imageStream.RateLimit.MaxFrameRate = LIMITED_FRAME_RATE;
+    clientInfo.ImageStreams.push_back(imageStream);
+    PlusIgtlClientInfo::VideoStream videoStream;
+    videoStream.Name = "Video";
+    videoStream.EmbeddedTransformToFrame = "Reference";
+    clientInfo.VideoStreams.push_back(videoStream);
+    return clientInfo;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestStreamRateLimit()
+  {
+    // Only the image stream is limited, the other messages are sent with each frame
+    PlusIgtlClientInfo clientInfo = CreateClientInfo();
+    if (!clientInfo.IsFrameRateLimited())
+    {
+      LOG_ERROR("Client info with a limited image stream is expected to be frame rate limited");
+      return PLUS_FAIL;
+    }
+    int numberOfImageFrames = 0;
+    for (int i = 0; i < NUMBER_OF_FRAMES; ++i)
+    {
+      PlusIgtlClientInfo frameClientInfo;
+      if (!clientInfo.GetFrameClientInfo("", "Channel", i * FRAME_PERIOD_SEC, frameClientInfo))
+      {
+        LOG_ERROR("Frame " << i << " is expected to be sent");
+        return PLUS_FAIL;
+      }
+      bool imageFrame = (i % 4 == 0);
+      if (HasMessageType(frameClientInfo, "IMAGE") != imageFrame || frameClientInfo.ImageStreams.size() != (imageFrame ? 1u : 0u)
+          || !HasMessageType(frameClientInfo, "TRANSFORM") || !HasMessageType(frameClientInfo, "VIDEO")
+          || frameClientInfo.TransformNames.size() != 1 || frameClientInfo.VideoStreams.size() != 1)
+      {
+        LOG_ERROR("Unexpected messages in frame " << i);
+        return PLUS_FAIL;
+      }
+      numberOfImageFrames += (imageFrame ? 1 : 0);
+    }
+    if (numberOfImageFrames != NUMBER_OF_FRAMES / 4)
+    {
+      LOG_ERROR("Expected " << NUMBER_OF_FRAMES / 4 << " image frames, got " << numberOfImageFrames);
+      return PLUS_FAIL;
+    }
+
+    // The limit of the whole client skips frames
+    clientInfo.SetRateLimit(0.0, 2);
+    int numberOfSentFrames = 0;
+    for (int i = 0; i < NUMBER_OF_FRAMES; ++i)
+    {
+      PlusIgtlClientInfo frameClientInfo;
+      if (clientInfo.GetFrameClientInfo("", "Channel", 100.0 + i * FRAME_PERIOD_SEC, frameClientInfo))
+      {
+        numberOfSentFrames++;
+      }
+    }
+    if (numberOfSentFrames != NUMBER_OF_FRAMES / 2)
+    {
+      LOG_ERROR("Expected " << NUMBER_OF_FRAMES / 2 << " sent frames with frame decimation 2, got " << numberOfSentFrames);
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestChannels()
+  {
+    // The image stream is taken from another channel than the rest of the client's data
+    PlusIgtlClientInfo clientInfo = CreateClientInfo();
+    clientInfo.ImageStreams[0].RateLimit = PlusIgtlClientInfo::FrameRateLimit();
+    clientInfo.ImageStreams[0].OutputChannelId = "ImageChannel";
+
+    PlusIgtlClientInfo frameClientInfo;
+    if (!clientInfo.GetFrameClientInfo("DefaultChannel", "DefaultChannel", 0.0, frameClientInfo)
+        || HasMessageType(frameClientInfo, "IMAGE") || !HasMessageType(frameClientInfo, "TRANSFORM") || !HasMessageType(frameClientInfo, "VIDEO")
+        || !frameClientInfo.ImageStreams.empty() || frameClientInfo.TransformNames.size() != 1)
+    {
+      LOG_ERROR("Unexpected messages in a frame of the client's channel");
+      return PLUS_FAIL;
+    }
+
+    if (!clientInfo.GetFrameClientInfo("ImageChannel", "DefaultChannel", 0.0, frameClientInfo)
+        || !HasMessageType(frameClientInfo, "IMAGE") || HasMessageType(frameClientInfo, "TRANSFORM") || HasMessageType(frameClientInfo, "VIDEO")
+        || frameClientInfo.ImageStreams.size() != 1 || !frameClientInfo.TransformNames.empty() || frameClientInfo.GetTDATARequested())
+    {
+      LOG_ERROR("Only the image stream is expected to be sent from the image channel");
+      return PLUS_FAIL;
+    }
+
+    if (clientInfo.GetFrameClientInfo("OtherChannel", "DefaultChannel", 0.0, frameClientInfo))
+    {
+      LOG_ERROR("No messages are expected to be sent from a channel that the client did not request");
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (TestFrameRateLimit() != PLUS_SUCCESS || TestStreamRateLimit() != PLUS_SUCCESS || TestChannels() != PLUS_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully!");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,189 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file igtlPlusScatterGatherImageMessageTest.cxx
+  \brief Verifies that scatter-gather IMAGE messages are identical on the wire to regular IMAGE messages
+  and compares the packing time of the two for 1080p and 4K frames.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "igsioTrackedFrame.h"
+#include "igsioVideoFrame.h"
+#include "igtlPlusScatterGatherImageMessage.h"
+#include "vtkIGSIOAccurateTimer.h"
+#include "vtkPlusIgtlMessageCommon.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// OpenIGTLink includes
+#include <igtl_header.h>
+
+namespace
+{
+  struct BenchmarkCase
+  {
+    const char* Name;
+    unsigned int Width;
+    unsigned int Height;
+  };
+
+  //----------------------------------------------------------------------------
+  void PrepareImageMessage(igtl::ImageMessage::Pointer imageMessage)
+  {
+    imageMessage->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+    imageMessage->SetDeviceName("Image_Reference");
+    imageMessage->SetMetaDataElement("ImageStatus", IANA_TYPE_US_ASCII, "OK");
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus CompareMessages(igtl::ImageMessage::Pointer regularMessage, igtl::PlusScatterGatherImageMessage::Pointer scatterGatherMessage)
+  {
+    std::vector<igtl::PlusScatterGatherImageMessage::Segment> segments;
+    vtkPlusIgtlMessageCommon::GetPackedMessageSegments(scatterGatherMessage, segments);
+    size_t regularMessageSize = static_cast<size_t>(regularMessage->GetPackSize());
+    if (scatterGatherMessage->GetSegmentsSize() != regularMessageSize)
+    {
+      LOG_ERROR("Packed message size mismatch: regular message is " << regularMessageSize << " bytes, scatter-gather message is " << scatterGatherMessage->GetSegmentsSize() << " bytes");
+      return PLUS_FAIL;
+    }
+    const unsigned char* regularMessageData = static_cast<const unsigned char*>(regularMessage->GetPackPointer());
+    size_t offset = 0;
+    for (std::vector<igtl::PlusScatterGatherImageMessage::Segment>::const_iterator segmentIt = segments.begin(); segmentIt != segments.end(); ++segmentIt)
+    {
+      if (memcmp(regularMessageData + offset, segmentIt->Data, segmentIt->Size) != 0)
+      {
+        LOG_ERROR("Packed message content mismatch in the block starting at byte " << offset);
+        return PLUS_FAIL;
+      }
+      offset += segmentIt->Size;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus RunBenchmark(const BenchmarkCase& benchmarkCase, int numberOfIterations)
+  {
+    igsioTrackedFrame trackedFrame;
+    FrameSizeType frameSize = { benchmarkCase.Width, benchmarkCase.Height, 1 };
+    if (trackedFrame.GetImageData()->AllocateFrame(frameSize, VTK_UNSIGNED_CHAR, 3) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to allocate " << benchmarkCase.Name << " frame");
+      return PLUS_FAIL;
+    }
+    unsigned char* pixels = static_cast<unsigned char*>(trackedFrame.GetImageData()->GetScalarPointer());
+    unsigned long frameSizeBytes = trackedFrame.GetImageData()->GetFrameSizeInBytes();
+    for (unsigned long i = 0; i < frameSizeBytes; ++i)
+    {
+      pixels[i] = static_cast<unsigned char>(i * 7 + (i >> 11));
+    }
+    trackedFrame.SetTimestamp(1.5);
+    vtkNew<vtkMatrix4x4> imageToReference;
+
+    igtl::ImageMessage::Pointer regularMessage;
+    igtl::PlusScatterGatherImageMessage::Pointer scatterGatherMessage;
+    double regularPackTimeSec = 0.0;
+    double scatterGatherPackTimeSec = 0.0;
+    for (int iteration = 0; iteration < numberOfIterations; ++iteration)
+    {
+      regularMessage = igtl::ImageMessage::New();
+      PrepareImageMessage(regularMessage);
+      double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+      if (vtkPlusIgtlMessageCommon::PackImageMessage(regularMessage, trackedFrame, *imageToReference.GetPointer()) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to pack regular " << benchmarkCase.Name << " image message");
+        return PLUS_FAIL;
+      }
+      regularPackTimeSec += vtkIGSIOAccurateTimer::GetSystemTime() - startTime;
+
+      scatterGatherMessage = igtl::PlusScatterGatherImageMessage::New();
+      PrepareImageMessage(scatterGatherMessage.GetPointer());
+      startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+      if (vtkPlusIgtlMessageCommon::PackImageMessage(scatterGatherMessage.GetPointer(), trackedFrame, *imageToReference.GetPointer()) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to pack scatter-gather " << benchmarkCase.Name << " image message");
+        return PLUS_FAIL;
+      }
+      scatterGatherPackTimeSec += vtkIGSIOAccurateTimer::GetSystemTime() - startTime;
+    }
+
+    if (CompareMessages(regularMessage, scatterGatherMessage) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Scatter-gather " << benchmarkCase.Name << " image message differs from the regular image message");
+      return PLUS_FAIL;
+    }
+
+    LOG_INFO(benchmarkCase.Name << " (" << benchmarkCase.Width << "x" << benchmarkCase.Height << " RGB, " << frameSizeBytes << " bytes): "
+             << "regular pack " << 1000.0 * regularPackTimeSec / numberOfIterations << " ms, "
+             << "scatter-gather pack " << 1000.0 * scatterGatherPackTimeSec / numberOfIterations << " ms");
+    return PLUS_SUCCESS;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int numberOfIterations(10);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--iterations", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfIterations, "Number of times each image is packed (Default: 10).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (numberOfIterations < 1)
+  {
+    LOG_ERROR("Number of iterations must be positive");
+    return EXIT_FAILURE;
+  }
+
+  const BenchmarkCase benchmarkCases[] =
+  {
+    { "1080p", 1920, 1080 },
+    { "4K", 3840, 2160 }
+  };
+
+  int numberOfErrors(0);
+  for (size_t i = 0; i < sizeof(benchmarkCases) / sizeof(benchmarkCases[0]); ++i)
+  {
+    if (RunBenchmark(benchmarkCases[i], numberOfIterations) != PLUS_SUCCESS)
+    {
+      numberOfErrors++;
+    }
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test successful");
+  return EXIT_SUCCESS;
+}
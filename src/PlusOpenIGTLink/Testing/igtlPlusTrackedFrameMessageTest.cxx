@@ -0,0 +1,314 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file igtlPlusTrackedFrameMessageTest.cxx
+  \brief Sends a tracked frame through TRACKEDFRAME messages with XML and binary field encoding and verifies
+  that the received frame fields, transforms and pixels match. Prints the field section size and packing time of both encodings.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "igsioTrackedFrame.h"
+#include "igsioVideoFrame.h"
+#include "igtlPlusTrackedFrameMessage.h"
+#include "vtkIGSIOAccurateTimer.h"
+#include "vtkPlusIgtlMessageCommon.h"
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkNew.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <sstream>
+
+// OpenIGTLink includes
+#include <igtlMessageHeader.h>
+#include <igtl_header.h>
+
+namespace
+{
+  const int NUMBER_OF_TRANSFORMS = 8;
+  // The last transform is not requested by the client
+  const int NUMBER_OF_REQUESTED_TRANSFORMS = NUMBER_OF_TRANSFORMS - 1;
+
+  //----------------------------------------------------------------------------
+  igsioTransformName GetTestTransformName(int index)
+  {
+    std::ostringstream from;
+    from << "Tool" << index;
+    return igsioTransformName(from.str(), "Tracker");
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus CreateTrackedFrame(igsioTrackedFrame& trackedFrame)
+  {
+    FrameSizeType frameSize = { 640, 480, 1 };
+    if (trackedFrame.GetImageData()->AllocateFrame(frameSize, VTK_UNSIGNED_CHAR, 1) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to allocate frame");
+      return PLUS_FAIL;
+    }
+    unsigned char* pixels = static_cast<unsigned char*>(trackedFrame.GetImageData()->GetScalarPointer());
+    unsigned long frameSizeBytes = trackedFrame.GetImageData()->GetFrameSizeInBytes();
+    for (unsigned long i = 0; i < frameSizeBytes; ++i)
+    {
+      pixels[i] = static_cast<unsigned char>(i * 13 + (i >> 9));
+    }
+    trackedFrame.SetTimestamp(12.25);
+    trackedFrame.SetFrameField("FrameNumber", "1234");
+    trackedFrame.SetFrameField("DeviceStatus", "Scanning <depth=\"50\">");
+    // Not a transform, even though the name ends with Transform
+    trackedFrame.SetFrameField("CalibrationTransform", "Pending");
+
+    for (int i = 0; i < NUMBER_OF_TRANSFORMS; ++i)
+    {
+      vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+      matrix->SetElement(0, 3, 10.5 * i);
+      matrix->SetElement(1, 3, -2.25 * i);
+      matrix->SetElement(0, 1, 0.5);
+      matrix->SetElement(1, 0, -0.5);
+      trackedFrame.SetFrameTransform(GetTestTransformName(i), matrix);
+      trackedFrame.SetFrameTransformStatus(GetTestTransformName(i), (i % 2 == 0) ? TOOL_OK : TOOL_OUT_OF_VIEW);
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  // Receive the message the same way as a client: concatenate the sent segments and unpack them into a new message
+  PlusStatus ReceiveMessage(igtl::PlusTrackedFrameMessage::Pointer sentMessage, igsioTrackedFrame& receivedFrame)
+  {
+    std::vector<igtl::PlusScatterGatherImageMessage::Segment> segments;
+    vtkPlusIgtlMessageCommon::GetPackedMessageSegments(sentMessage.GetPointer(), segments);
+    std::vector<unsigned char> wireData;
+    for (std::vector<igtl::PlusScatterGatherImageMessage::Segment>::const_iterator segmentIt = segments.begin(); segmentIt != segments.end(); ++segmentIt)
+    {
+      wireData.insert(wireData.end(), segmentIt->Data, segmentIt->Data + segmentIt->Size);
+    }
+    if (wireData.size() < IGTL_HEADER_SIZE)
+    {
+      LOG_ERROR("Packed message is too short: " << wireData.size() << " bytes");
+      return PLUS_FAIL;
+    }
+
+    igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+    headerMsg->InitBuffer();
+    memcpy(headerMsg->GetBufferPointer(), &wireData[0], IGTL_HEADER_SIZE);
+    headerMsg->Unpack();
+    if (static_cast<size_t>(headerMsg->GetBodySizeToRead()) != wireData.size() - IGTL_HEADER_SIZE)
+    {
+      LOG_ERROR("Body size in the header (" << headerMsg->GetBodySizeToRead() << ") does not match the sent body size (" << wireData.size() - IGTL_HEADER_SIZE << ")");
+      return PLUS_FAIL;
+    }
+
+    igtl::PlusTrackedFrameMessage::Pointer receivedMessage = igtl::PlusTrackedFrameMessage::New();
+    receivedMessage->SetMessageHeader(headerMsg);
+    receivedMessage->AllocateBuffer();
+    memcpy(receivedMessage->GetBufferBodyPointer(), &wireData[IGTL_HEADER_SIZE], receivedMessage->GetBufferBodySize());
+    if (!(receivedMessage->Unpack(1) & igtl::MessageHeader::UNPACK_BODY))
+    {
+      LOG_ERROR("Failed to unpack the received message (CRC mismatch or invalid content)");
+      return PLUS_FAIL;
+    }
+    receivedFrame = receivedMessage->GetTrackedFrame();
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus CompareFrames(igsioTrackedFrame& sentFrame, igsioTrackedFrame& receivedFrame)
+  {
+    int numberOfErrors(0);
+    const char* fieldNames[] = { "FrameNumber", "DeviceStatus" };
+    for (size_t i = 0; i < sizeof(fieldNames) / sizeof(fieldNames[0]); ++i)
+    {
+      std::string sentValue = sentFrame.GetFrameField(fieldNames[i]);
+      std::string receivedValue = receivedFrame.IsFrameFieldDefined(fieldNames[i]) ? receivedFrame.GetFrameField(fieldNames[i]) : "";
+      if (sentValue != receivedValue)
+      {
+        LOG_ERROR("Frame field " << fieldNames[i] << " mismatch: sent '" << sentValue << "', received '" << receivedValue << "'");
+        numberOfErrors++;
+      }
+    }
+
+    for (int i = 0; i < NUMBER_OF_REQUESTED_TRANSFORMS; ++i)
+    {
+      vtkNew<vtkMatrix4x4> sentMatrix;
+      vtkNew<vtkMatrix4x4> receivedMatrix;
+      ToolStatus sentStatus(TOOL_INVALID);
+      ToolStatus receivedStatus(TOOL_INVALID);
+      sentFrame.GetFrameTransform(GetTestTransformName(i), sentMatrix.GetPointer());
+      sentFrame.GetFrameTransformStatus(GetTestTransformName(i), sentStatus);
+      if (receivedFrame.GetFrameTransform(GetTestTransformName(i), receivedMatrix.GetPointer()) != PLUS_SUCCESS
+          || receivedFrame.GetFrameTransformStatus(GetTestTransformName(i), receivedStatus) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Transform " << GetTestTransformName(i).GetTransformName() << " is missing from the received frame");
+        numberOfErrors++;
+        continue;
+      }
+      if (sentStatus != receivedStatus)
+      {
+        LOG_ERROR("Transform " << GetTestTransformName(i).GetTransformName() << " status mismatch");
+        numberOfErrors++;
+      }
+      for (int row = 0; row < 4; ++row)
+      {
+        for (int column = 0; column < 4; ++column)
+        {
+          if (fabs(sentMatrix->GetElement(row, column) - receivedMatrix->GetElement(row, column)) > 1e-4)
+          {
+            LOG_ERROR("Transform " << GetTestTransformName(i).GetTransformName() << " element (" << row << "," << column << ") mismatch");
+            numberOfErrors++;
+          }
+        }
+      }
+    }
+
+    unsigned long frameSizeBytes = sentFrame.GetImageData()->GetFrameSizeInBytes();
+    if (receivedFrame.GetImageData()->GetFrameSizeInBytes() != frameSizeBytes
+        || memcmp(sentFrame.GetImageData()->GetScalarPointer(), receivedFrame.GetImageData()->GetScalarPointer(), frameSizeBytes) != 0)
+    {
+      LOG_ERROR("Received pixels differ from the sent pixels");
+      numberOfErrors++;
+    }
+    if (fabs(sentFrame.GetTimestamp() - receivedFrame.GetTimestamp()) > 1e-6)
+    {
+      LOG_ERROR("Timestamp mismatch: sent " << sentFrame.GetTimestamp() << ", received " << receivedFrame.GetTimestamp());
+      numberOfErrors++;
+    }
+    return (numberOfErrors == 0) ? PLUS_SUCCESS : PLUS_FAIL;
+  }
+
+  //----------------------------------------------------------------------------
+  // The binary field section sends the fields that are not sent as transform entries as strings
+  PlusStatus CompareUnrequestedFields(igsioTrackedFrame& sentFrame, igsioTrackedFrame& receivedFrame)
+  {
+    int numberOfErrors(0);
+    std::string receivedValue = receivedFrame.IsFrameFieldDefined("CalibrationTransform") ? receivedFrame.GetFrameField("CalibrationTransform") : "";
+    if (receivedValue != sentFrame.GetFrameField("CalibrationTransform"))
+    {
+      LOG_ERROR("Frame field CalibrationTransform mismatch: sent '" << sentFrame.GetFrameField("CalibrationTransform") << "', received '" << receivedValue << "'");
+      numberOfErrors++;
+    }
+    igsioTransformName unrequestedTransformName = GetTestTransformName(NUMBER_OF_TRANSFORMS - 1);
+    vtkNew<vtkMatrix4x4> sentMatrix;
+    vtkNew<vtkMatrix4x4> receivedMatrix;
+    sentFrame.GetFrameTransform(unrequestedTransformName, sentMatrix.GetPointer());
+    if (receivedFrame.GetFrameTransform(unrequestedTransformName, receivedMatrix.GetPointer()) != PLUS_SUCCESS
+        || fabs(sentMatrix->GetElement(0, 3) - receivedMatrix->GetElement(0, 3)) > 1e-4)
+    {
+      LOG_ERROR("Unrequested transform " << unrequestedTransformName.GetTransformName() << " is not received as a frame field");
+      numberOfErrors++;
+    }
+    return (numberOfErrors == 0) ? PLUS_SUCCESS : PLUS_FAIL;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus RunTest(igsioTrackedFrame& trackedFrame, int fieldsVersion, int headerVersion, int numberOfIterations)
+  {
+    std::vector<igsioTransformName> requestedTransforms;
+    for (int i = 0; i < NUMBER_OF_REQUESTED_TRANSFORMS; ++i)
+    {
+      requestedTransforms.push_back(GetTestTransformName(i));
+    }
+    vtkNew<vtkMatrix4x4> embeddedImageTransform;
+
+    igtl::PlusTrackedFrameMessage::Pointer message;
+    double packTimeSec = 0.0;
+    for (int iteration = 0; iteration < numberOfIterations; ++iteration)
+    {
+      message = igtl::PlusTrackedFrameMessage::New();
+      message->SetHeaderVersion(headerVersion);
+      message->SetDeviceName("TrackedFrame");
+      message->SetFieldsVersion(fieldsVersion);
+      double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+      if (vtkPlusIgtlMessageCommon::PackTrackedFrameMessage(message, trackedFrame, embeddedImageTransform.GetPointer(), requestedTransforms) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to pack tracked frame message with fields version " << fieldsVersion);
+        return PLUS_FAIL;
+      }
+      packTimeSec += vtkIGSIOAccurateTimer::GetSystemTime() - startTime;
+    }
+
+    igsioTrackedFrame receivedFrame;
+    if (ReceiveMessage(message, receivedFrame) != PLUS_SUCCESS || CompareFrames(trackedFrame, receivedFrame) != PLUS_SUCCESS
+        || (fieldsVersion >= igtl::PlusTrackedFrameMessage::FIELDS_VERSION_BINARY && CompareUnrequestedFields(trackedFrame, receivedFrame) != PLUS_SUCCESS))
+    {
+      LOG_ERROR("Tracked frame round trip failed with fields version " << fieldsVersion << " and header version " << headerVersion);
+      return PLUS_FAIL;
+    }
+
+    LOG_INFO("Fields version " << fieldsVersion << ", header version " << headerVersion << ": message size " << vtkPlusIgtlMessageCommon::GetPackedMessageSize(message.GetPointer())
+             << " bytes, pack " << 1000.0 * packTimeSec / numberOfIterations << " ms");
+    return PLUS_SUCCESS;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int numberOfIterations(10);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--iterations", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfIterations, "Number of times each message is packed (Default: 10).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (numberOfIterations < 1)
+  {
+    LOG_ERROR("Number of iterations must be positive");
+    return EXIT_FAILURE;
+  }
+
+  igsioTrackedFrame trackedFrame;
+  if (CreateTrackedFrame(trackedFrame) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Test failed");
+    return EXIT_FAILURE;
+  }
+
+  int numberOfErrors(0);
+  const int fieldsVersions[] = { igtl::PlusTrackedFrameMessage::FIELDS_VERSION_XML, igtl::PlusTrackedFrameMessage::FIELDS_VERSION_BINARY };
+  const int headerVersions[] = { IGTL_HEADER_VERSION_1, IGTL_HEADER_VERSION_2 };
+  for (size_t i = 0; i < sizeof(fieldsVersions) / sizeof(fieldsVersions[0]); ++i)
+  {
+    for (size_t j = 0; j < sizeof(headerVersions) / sizeof(headerVersions[0]); ++j)
+    {
+      if (RunTest(trackedFrame, fieldsVersions[i], headerVersions[j], numberOfIterations) != PLUS_SUCCESS)
+      {
+        numberOfErrors++;
+      }
+    }
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test successful");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,215 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusIgtlImageCompressorTest.cxx
+  \brief Sends a synthetic ultrasound-like image sequence through CIMAGE messages with each predictor and verifies
+  that the received images are identical to the sent ones. Prints the compression ratio and the compression and
+  decompression time.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "igtlPlusCompressedImageMessage.h"
+#include "vtkIGSIOAccurateTimer.h"
+#include "vtkPlusIgtlImageCompressor.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkSmartPointer.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// OpenIGTLink includes
+#include <igtl_header.h>
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  // Static background with speckle and a bright region that moves by a few pixels in each frame
+  void GenerateFrame(vtkImageData* image, int frameIndex)
+  {
+    int dimensions[3] = { 0, 0, 0 };
+    image->GetDimensions(dimensions);
+    unsigned char* pixels = static_cast<unsigned char*>(image->GetScalarPointer());
+    int regionStart = (frameIndex * 5) % (dimensions[0] / 2);
+    for (int y = 0; y < dimensions[1]; ++y)
+    {
+      for (int x = 0; x < dimensions[0]; ++x)
+      {
+        unsigned char value = static_cast<unsigned char>(((x * 31) ^ (y * 17)) & 0x3F);
+        if (x >= regionStart && x < regionStart + dimensions[0] / 4 && y > dimensions[1] / 3 && y < dimensions[1] / 2)
+        {
+          value = static_cast<unsigned char>(value + 150);
+        }
+        pixels[y * dimensions[0] + x] = value;
+      }
+    }
+    image->Modified();
+  }
+
+  //----------------------------------------------------------------------------
+  // Copy the packed message into a new message as if it was received from a socket
+  igtl::PlusCompressedImageMessage::Pointer TransferMessage(igtl::PlusCompressedImageMessage::Pointer sentMessage)
+  {
+    igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+    headerMsg->InitBuffer();
+    memcpy(headerMsg->GetBufferPointer(), sentMessage->GetBufferPointer(), IGTL_HEADER_SIZE);
+    headerMsg->Unpack();
+
+    igtl::PlusCompressedImageMessage::Pointer receivedMessage = igtl::PlusCompressedImageMessage::New();
+    receivedMessage->SetMessageHeader(headerMsg);
+    receivedMessage->AllocateBuffer();
+    memcpy(receivedMessage->GetBufferBodyPointer(), static_cast<unsigned char*>(sentMessage->GetBufferPointer()) + IGTL_HEADER_SIZE, receivedMessage->GetBufferBodySize());
+    if (!(receivedMessage->Unpack(1) & igtl::MessageHeader::UNPACK_BODY))
+    {
+      return NULL;
+    }
+    return receivedMessage;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus RunTest(const std::string& predictorName, int numberOfThreads, int numberOfFrames)
+  {
+    int predictor = igtl::PlusCompressedImageMessage::PREDICTOR_NONE;
+    vtkPlusIgtlImageCompressor::GetPredictorFromString(predictorName, predictor);
+
+    vtkSmartPointer<vtkPlusIgtlImageCompressor> compressor = vtkSmartPointer<vtkPlusIgtlImageCompressor>::New();
+    compressor->SetPredictor(predictor);
+    compressor->SetNumberOfThreads(numberOfThreads);
+    compressor->SetKeyFrameInterval(10);
+    vtkSmartPointer<vtkPlusIgtlImageCompressor> decompressor = vtkSmartPointer<vtkPlusIgtlImageCompressor>::New();
+    decompressor->SetNumberOfThreads(numberOfThreads);
+
+    vtkSmartPointer<vtkImageData> image = vtkSmartPointer<vtkImageData>::New();
+    image->SetDimensions(1920, 1080, 1);
+    image->AllocateScalars(VTK_UNSIGNED_CHAR, 1);
+    size_t frameSizeBytes = 1920 * 1080;
+    std::vector<unsigned char> decompressedPixels(frameSizeBytes);
+
+    double compressionTimeSec = 0.0;
+    double decompressionTimeSec = 0.0;
+    size_t compressedSizeBytes = 0;
+    for (int frameIndex = 0; frameIndex < numberOfFrames; ++frameIndex)
+    {
+      GenerateFrame(image, frameIndex);
+
+      igtl::PlusCompressedImageMessage::Pointer sentMessage = igtl::PlusCompressedImageMessage::New();
+      sentMessage->SetDeviceName("Image_Reference");
+      double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+      if (compressor->Compress(image, sentMessage) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to compress frame " << frameIndex);
+        return PLUS_FAIL;
+      }
+      sentMessage->Pack();
+      compressionTimeSec += vtkIGSIOAccurateTimer::GetSystemTime() - startTime;
+      compressedSizeBytes += sentMessage->GetBufferBodySize();
+
+      // Skipping the first frame must stall decoding of predicted frames until the next key frame
+      if (frameIndex == 0)
+      {
+        continue;
+      }
+
+      igtl::PlusCompressedImageMessage::Pointer receivedMessage = TransferMessage(sentMessage);
+      if (receivedMessage.IsNull())
+      {
+        LOG_ERROR("Failed to unpack frame " << frameIndex);
+        return PLUS_FAIL;
+      }
+      startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+      PlusStatus decompressionStatus = decompressor->Decompress(receivedMessage, &decompressedPixels[0], decompressedPixels.size());
+      decompressionTimeSec += vtkIGSIOAccurateTimer::GetSystemTime() - startTime;
+
+      bool keyFrame = receivedMessage->GetCompressedImageHeader().m_KeyFrame != 0;
+      bool decodable = predictor == igtl::PlusCompressedImageMessage::PREDICTOR_NONE || frameIndex >= 10;
+      if (decompressionStatus != PLUS_SUCCESS)
+      {
+        if (!decodable && decompressor->GetWaitingForKeyFrame())
+        {
+          continue;
+        }
+        LOG_ERROR("Failed to decompress frame " << frameIndex << (keyFrame ? " (key frame)" : ""));
+        return PLUS_FAIL;
+      }
+      if (!decodable)
+      {
+        LOG_ERROR("Frame " << frameIndex << " was decoded without its reference frame");
+        return PLUS_FAIL;
+      }
+      if (memcmp(&decompressedPixels[0], image->GetScalarPointer(), frameSizeBytes) != 0)
+      {
+        LOG_ERROR("Decompressed frame " << frameIndex << " differs from the original frame");
+        return PLUS_FAIL;
+      }
+    }
+
+    LOG_INFO("Predictor " << predictorName << ", " << numberOfThreads << " thread(s): compression ratio "
+             << static_cast<double>(frameSizeBytes) * numberOfFrames / compressedSizeBytes << ", "
+             << "compression " << 1000.0 * compressionTimeSec / numberOfFrames << " ms/frame, "
+             << "decompression " << 1000.0 * decompressionTimeSec / (numberOfFrames - 1) << " ms/frame");
+    return PLUS_SUCCESS;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int numberOfFrames(30);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--frames", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &numberOfFrames, "Number of frames sent with each setting (Default: 30).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (numberOfFrames < 12)
+  {
+    LOG_ERROR("At least 12 frames are needed to test key frames");
+    return EXIT_FAILURE;
+  }
+
+  int numberOfErrors(0);
+  const char* predictors[] = { "NONE", "DELTA" };
+  const int threadCounts[] = { 1, 4 };
+  for (size_t i = 0; i < sizeof(predictors) / sizeof(predictors[0]); ++i)
+  {
+    for (size_t j = 0; j < sizeof(threadCounts) / sizeof(threadCounts[0]); ++j)
+    {
+      if (RunTest(predictors[i], threadCounts[j], numberOfFrames) != PLUS_SUCCESS)
+      {
+        numberOfErrors++;
+      }
+    }
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test successful");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,396 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusIgtlMessageCommonTest.cxx
+  \brief Packs IMAGE, CIMAGE and TRACKEDFRAME messages and unpacks them with the overloads that take an already received
+  message body, as the receiver thread of the OpenIGTLink video source does. The socket-based IMAGE unpack is tested through
+  a loopback connection and must give the same frame.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "igsioTrackedFrame.h"
+#include "igsioVideoFrame.h"
+#include "vtkPlusIgtlImageCompressor.h"
+#include "vtkPlusIgtlMessageCommon.h"
+
+// VTK includes
+#include <vtkMatrix4x4.h>
+#include <vtkSmartPointer.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <cmath>
+
+// OpenIGTLink includes
+#include <igtlClientSocket.h>
+#include <igtlServerSocket.h>
+#include <igtl_header.h>
+
+namespace
+{
+  const double FRAME_TIMESTAMP = 12.25;
+
+  //----------------------------------------------------------------------------
+  PlusStatus CreateTrackedFrame(igsioTrackedFrame& trackedFrame)
+  {
+    FrameSizeType frameSize = { 64, 48, 1 };
+    if (trackedFrame.GetImageData()->AllocateFrame(frameSize, VTK_UNSIGNED_CHAR, 1) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to allocate frame");
+      return PLUS_FAIL;
+    }
+    unsigned char* pixels = static_cast<unsigned char*>(trackedFrame.GetImageData()->GetScalarPointer());
+    unsigned long frameSizeBytes = trackedFrame.GetImageData()->GetFrameSizeInBytes();
+    for (unsigned long i = 0; i < frameSizeBytes; ++i)
+    {
+      pixels[i] = static_cast<unsigned char>(i * 13 + (i >> 9));
+    }
+    trackedFrame.SetTimestamp(FRAME_TIMESTAMP);
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  // Rotation by 90 degrees around the Z axis and a translation, exactly representable in the float matrix of the messages
+  void GetImageToReferenceTransform(vtkMatrix4x4* matrix)
+  {
+    matrix->Identity();
+    matrix->SetElement(0, 0, 0.0);
+    matrix->SetElement(0, 1, -1.0);
+    matrix->SetElement(1, 0, 1.0);
+    matrix->SetElement(1, 1, 0.0);
+    matrix->SetElement(0, 3, 10.5);
+    matrix->SetElement(1, 3, -2.25);
+    matrix->SetElement(2, 3, 30.0);
+  }
+
+  //----------------------------------------------------------------------------
+  // Copy the packed message into a new message as if its body was received from a socket. The body is not unpacked.
+  template<class MessageType>
+  typename MessageType::Pointer TransferMessage(igtl::MessageBase* sentMessage)
+  {
+    std::vector<igtl::PlusScatterGatherImageMessage::Segment> segments;
+    vtkPlusIgtlMessageCommon::GetPackedMessageSegments(sentMessage, segments);
+    std::vector<unsigned char> wireData;
+    for (std::vector<igtl::PlusScatterGatherImageMessage::Segment>::const_iterator segmentIt = segments.begin(); segmentIt != segments.end(); ++segmentIt)
+    {
+      wireData.insert(wireData.end(), segmentIt->Data, segmentIt->Data + segmentIt->Size);
+    }
+    if (wireData.size() < IGTL_HEADER_SIZE)
+    {
+      LOG_ERROR("Packed message is too short: " << wireData.size() << " bytes");
+      return NULL;
+    }
+
+    igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+    headerMsg->InitBuffer();
+    memcpy(headerMsg->GetBufferPointer(), &wireData[0], IGTL_HEADER_SIZE);
+    headerMsg->Unpack();
+
+    typename MessageType::Pointer receivedMessage = MessageType::New();
+    receivedMessage->SetMessageHeader(headerMsg);
+    receivedMessage->AllocateBuffer();
+    if (static_cast<size_t>(receivedMessage->GetBufferBodySize()) != wireData.size() - IGTL_HEADER_SIZE)
+    {
+      LOG_ERROR("Body size in the header (" << receivedMessage->GetBufferBodySize() << ") does not match the sent body size (" << wireData.size() - IGTL_HEADER_SIZE << ")");
+      return NULL;
+    }
+    memcpy(receivedMessage->GetBufferBodyPointer(), &wireData[IGTL_HEADER_SIZE], receivedMessage->GetBufferBodySize());
+    return receivedMessage;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus CompareTransforms(const std::string& messageName, vtkMatrix4x4* sentMatrix, vtkMatrix4x4* receivedMatrix)
+  {
+    for (int row = 0; row < 4; ++row)
+    {
+      for (int column = 0; column < 4; ++column)
+      {
+        if (fabs(sentMatrix->GetElement(row, column) - receivedMatrix->GetElement(row, column)) > 1e-4)
+        {
+          LOG_ERROR(messageName << ": embedded transform element (" << row << "," << column << ") differs: sent " << sentMatrix->GetElement(row, column)
+                    << ", received " << receivedMatrix->GetElement(row, column));
+          return PLUS_FAIL;
+        }
+      }
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus CompareFrames(const std::string& messageName, igsioTrackedFrame& sentFrame, igsioTrackedFrame& receivedFrame,
+                           const igsioTransformName& embeddedTransformName, vtkMatrix4x4* sentMatrix)
+  {
+    if (receivedFrame.GetImageData()->GetFrameSizeInBytes() != sentFrame.GetImageData()->GetFrameSizeInBytes()
+        || memcmp(receivedFrame.GetImageData()->GetScalarPointer(), sentFrame.GetImageData()->GetScalarPointer(), sentFrame.GetImageData()->GetFrameSizeInBytes()) != 0)
+    {
+      LOG_ERROR(messageName << ": received image differs from the sent image");
+      return PLUS_FAIL;
+    }
+    if (fabs(receivedFrame.GetTimestamp() - sentFrame.GetTimestamp()) > 1e-6)
+    {
+      LOG_ERROR(messageName << ": timestamp mismatch: sent " << sentFrame.GetTimestamp() << ", received " << receivedFrame.GetTimestamp());
+      return PLUS_FAIL;
+    }
+    vtkSmartPointer<vtkMatrix4x4> receivedMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    if (receivedFrame.GetFrameTransform(embeddedTransformName, receivedMatrix) != PLUS_SUCCESS)
+    {
+      LOG_ERROR(messageName << ": embedded transform " << embeddedTransformName.GetTransformName() << " is missing from the received frame");
+      return PLUS_FAIL;
+    }
+    return CompareTransforms(messageName, sentMatrix, receivedMatrix);
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestImageMessage(igsioTrackedFrame& sentFrame, const igsioTransformName& embeddedTransformName, vtkMatrix4x4* sentMatrix)
+  {
+    igtl::ImageMessage::Pointer sentMessage = igtl::ImageMessage::New();
+    sentMessage->SetDeviceName("Image_Reference");
+    if (vtkPlusIgtlMessageCommon::PackImageMessage(sentMessage, sentFrame, *sentMatrix) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("IMAGE: failed to pack message");
+      return PLUS_FAIL;
+    }
+    igtl::ImageMessage::Pointer receivedMessage = TransferMessage<igtl::ImageMessage>(sentMessage);
+    if (receivedMessage.IsNull())
+    {
+      return PLUS_FAIL;
+    }
+
+    igsioTrackedFrame::FieldMapType customFields;
+    if (vtkPlusIgtlMessageCommon::UnpackImageMessage(receivedMessage, embeddedTransformName, customFields, 1) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("IMAGE: failed to unpack message");
+      return PLUS_FAIL;
+    }
+
+    // The pixels are not copied, they are read from the message
+    int dimensions[3] = { 0, 0, 0 };
+    receivedMessage->GetDimensions(dimensions);
+    FrameSizeType sentSize = sentFrame.GetImageData()->GetFrameSize();
+    if (dimensions[0] != static_cast<int>(sentSize[0]) || dimensions[1] != static_cast<int>(sentSize[1]) || dimensions[2] != static_cast<int>(sentSize[2]))
+    {
+      LOG_ERROR("IMAGE: received dimensions " << dimensions[0] << "x" << dimensions[1] << "x" << dimensions[2] << " differ from the sent frame size");
+      return PLUS_FAIL;
+    }
+    if (memcmp(receivedMessage->GetScalarPointer(), sentFrame.GetImageData()->GetScalarPointer(), sentFrame.GetImageData()->GetFrameSizeInBytes()) != 0)
+    {
+      LOG_ERROR("IMAGE: received image differs from the sent image");
+      return PLUS_FAIL;
+    }
+
+    // The embedded transform is returned as the fields of a tracked frame
+    igsioTrackedFrame fieldsFrame;
+    for (igsioTrackedFrame::FieldMapType::const_iterator it = customFields.begin(); it != customFields.end(); ++it)
+    {
+      fieldsFrame.SetFrameField(it->first, it->second);
+    }
+    vtkSmartPointer<vtkMatrix4x4> receivedMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    if (fieldsFrame.GetFrameTransform(embeddedTransformName, receivedMatrix) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("IMAGE: embedded transform " << embeddedTransformName.GetTransformName() << " is missing from the custom fields");
+      return PLUS_FAIL;
+    }
+    if (CompareTransforms("IMAGE", sentMatrix, receivedMatrix) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+
+    // Without an embedded transform name no fields are returned
+    if (vtkPlusIgtlMessageCommon::UnpackImageMessage(TransferMessage<igtl::ImageMessage>(sentMessage), igsioTransformName(), customFields, 1) != PLUS_SUCCESS
+        || !customFields.empty())
+    {
+      LOG_ERROR("IMAGE: unexpected result without embedded transform name");
+      return PLUS_FAIL;
+    }
+
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestImageMessageFromSocket(igsioTrackedFrame& sentFrame, const igsioTransformName& embeddedTransformName, vtkMatrix4x4* sentMatrix, int port)
+  {
+    igtl::ServerSocket::Pointer serverSocket = igtl::ServerSocket::New();
+    if (serverSocket->CreateServer(port) < 0)
+    {
+      LOG_ERROR("Unable to create a server on port " << port);
+      return PLUS_FAIL;
+    }
+    igtl::ClientSocket::Pointer clientSocket = igtl::ClientSocket::New();
+    if (clientSocket->ConnectToServer("127.0.0.1", port) != 0)
+    {
+      LOG_ERROR("Unable to connect to the server on port " << port);
+      serverSocket->CloseSocket();
+      return PLUS_FAIL;
+    }
+    igtl::ClientSocket::Pointer receiverSocket = serverSocket->WaitForConnection(1000);
+    if (receiverSocket.IsNull())
+    {
+      LOG_ERROR("The server did not accept the connection on port " << port);
+      clientSocket->CloseSocket();
+      serverSocket->CloseSocket();
+      return PLUS_FAIL;
+    }
+    receiverSocket->SetReceiveTimeout(1000);
+
+    PlusStatus status = PLUS_FAIL;
+    igtl::ImageMessage::Pointer sentMessage = igtl::ImageMessage::New();
+    sentMessage->SetDeviceName("Image_Reference");
+    igtl::MessageHeader::Pointer headerMsg = igtl::MessageHeader::New();
+    headerMsg->InitBuffer();
+    igsioTrackedFrame receivedFrame;
+    if (vtkPlusIgtlMessageCommon::PackImageMessage(sentMessage, sentFrame, *sentMatrix) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("IMAGE from socket: failed to pack message");
+    }
+    else if (vtkPlusIgtlMessageCommon::SendPackedMessage(clientSocket, sentMessage) == 0)
+    {
+      LOG_ERROR("IMAGE from socket: failed to send message");
+    }
+    else if (receiverSocket->Receive(headerMsg->GetBufferPointer(), headerMsg->GetBufferSize()) != headerMsg->GetBufferSize())
+    {
+      LOG_ERROR("IMAGE from socket: failed to receive message header");
+    }
+    else
+    {
+      headerMsg->Unpack();
+      if (vtkPlusIgtlMessageCommon::UnpackImageMessage(headerMsg, receiverSocket, receivedFrame, embeddedTransformName, 1) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("IMAGE from socket: failed to unpack message");
+      }
+      else
+      {
+        status = CompareFrames("IMAGE from socket", sentFrame, receivedFrame, embeddedTransformName, sentMatrix);
+      }
+    }
+
+    receiverSocket->CloseSocket();
+    clientSocket->CloseSocket();
+    serverSocket->CloseSocket();
+    return status;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestCompressedImageMessage(igsioTrackedFrame& sentFrame, const igsioTransformName& embeddedTransformName, vtkMatrix4x4* sentMatrix)
+  {
+    vtkSmartPointer<vtkPlusIgtlImageCompressor> compressor = vtkSmartPointer<vtkPlusIgtlImageCompressor>::New();
+    vtkSmartPointer<vtkPlusIgtlImageCompressor> decompressor = vtkSmartPointer<vtkPlusIgtlImageCompressor>::New();
+
+    igtl::PlusCompressedImageMessage::Pointer sentMessage = igtl::PlusCompressedImageMessage::New();
+    sentMessage->SetDeviceName("Image_Reference");
+    if (vtkPlusIgtlMessageCommon::PackCompressedImageMessage(sentMessage, sentFrame, sentFrame.GetImageData()->GetImage(), *sentMatrix, compressor) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("CIMAGE: failed to pack message");
+      return PLUS_FAIL;
+    }
+    igtl::PlusCompressedImageMessage::Pointer receivedMessage = TransferMessage<igtl::PlusCompressedImageMessage>(sentMessage);
+    if (receivedMessage.IsNull())
+    {
+      return PLUS_FAIL;
+    }
+
+    igsioTrackedFrame receivedFrame;
+    if (vtkPlusIgtlMessageCommon::UnpackCompressedImageMessage(receivedMessage, receivedFrame, embeddedTransformName, decompressor, 1) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("CIMAGE: failed to unpack message");
+      return PLUS_FAIL;
+    }
+    return CompareFrames("CIMAGE", sentFrame, receivedFrame, embeddedTransformName, sentMatrix);
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestTrackedFrameMessage(igsioTrackedFrame& sentFrame, const igsioTransformName& embeddedTransformName, vtkMatrix4x4* sentMatrix)
+  {
+    igtl::PlusTrackedFrameMessage::Pointer sentMessage = igtl::PlusTrackedFrameMessage::New();
+    sentMessage->SetDeviceName("Image_Reference");
+    std::vector<igsioTransformName> requestedTransforms;
+    if (vtkPlusIgtlMessageCommon::PackTrackedFrameMessage(sentMessage, sentFrame, sentMatrix, requestedTransforms) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("TRACKEDFRAME: failed to pack message");
+      return PLUS_FAIL;
+    }
+    igtl::PlusTrackedFrameMessage::Pointer receivedMessage = TransferMessage<igtl::PlusTrackedFrameMessage>(sentMessage);
+    if (receivedMessage.IsNull())
+    {
+      return PLUS_FAIL;
+    }
+
+    igsioTrackedFrame receivedFrame;
+    if (vtkPlusIgtlMessageCommon::UnpackTrackedFrameMessage(receivedMessage, receivedFrame, embeddedTransformName, 1) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("TRACKEDFRAME: failed to unpack message");
+      return PLUS_FAIL;
+    }
+    return CompareFrames("TRACKEDFRAME", sentFrame, receivedFrame, embeddedTransformName, sentMatrix);
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int port(18955);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--port", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &port, "Local port used for the loopback connection (Default: 18955).");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  igsioTrackedFrame sentFrame;
+  if (CreateTrackedFrame(sentFrame) != PLUS_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+  igsioTransformName embeddedTransformName("Image", "Reference");
+  vtkSmartPointer<vtkMatrix4x4> sentMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+  GetImageToReferenceTransform(sentMatrix);
+
+  int numberOfErrors(0);
+  if (TestImageMessage(sentFrame, embeddedTransformName, sentMatrix) != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+  if (TestImageMessageFromSocket(sentFrame, embeddedTransformName, sentMatrix, port) != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+  if (TestCompressedImageMessage(sentFrame, embeddedTransformName, sentMatrix) != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+  if (TestTrackedFrameMessage(sentFrame, embeddedTransformName, sentMatrix) != PLUS_SUCCESS)
+  {
+    numberOfErrors++;
+  }
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test successful");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,198 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusIgtlSharedMemoryReceiverTest.cxx
+  \brief Writes packed messages into a shared memory ring and verifies that vtkPlusIgtlSharedMemoryReceiver
+  reads them back unchanged and detects the items that were overwritten before they could be read.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusIgtlSharedMemoryRing.h"
+#include "igtlPlusSharedMemoryNotificationMessage.h"
+#include "vtkPlusIgtlSharedMemoryReceiver.h"
+
+// VTK includes
+#include <vtkSmartPointer.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// OpenIGTLink includes
+#include <igtlStringMessage.h>
+
+// STL includes
+#include <sstream>
+
+namespace
+{
+  const int NUMBER_OF_SLOTS = 4;
+  const unsigned int SLOT_SIZE = 4096;
+
+  //----------------------------------------------------------------------------
+  std::vector<igtl::MessageBase::Pointer> CreateItemMessages(int itemIndex)
+  {
+    std::vector<igtl::MessageBase::Pointer> messages;
+    for (int i = 0; i < 2; ++i)
+    {
+      std::ostringstream text;
+      text << "Item " << itemIndex << " message " << i;
+      igtl::StringMessage::Pointer stringMessage = igtl::StringMessage::New();
+      stringMessage->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+      stringMessage->SetDeviceName("SharedMemoryTest");
+      stringMessage->SetString(text.str());
+      stringMessage->Pack();
+      messages.push_back(stringMessage.GetPointer());
+    }
+    return messages;
+  }
+
+  //----------------------------------------------------------------------------
+  igtl::PlusSharedMemoryNotificationMessage::Pointer CreateNotification(const PlusIgtlSharedMemoryRing& ring, uint64_t sequence)
+  {
+    igtl::PlusSharedMemoryNotificationMessage::Pointer notification = igtl::PlusSharedMemoryNotificationMessage::New();
+    notification->SetSequence(sequence);
+    notification->SetRingName(ring.GetName());
+    notification->SetNumberOfSlots(ring.GetNumberOfSlots());
+    notification->SetSlotSize(ring.GetSlotSize());
+
+    // Round trip through the wire format
+    notification->Pack();
+    igtl::PlusSharedMemoryNotificationMessage::Pointer receivedNotification = igtl::PlusSharedMemoryNotificationMessage::New();
+    receivedNotification->SetMessageHeader(notification);
+    receivedNotification->AllocateBuffer();
+    memcpy(receivedNotification->GetBufferBodyPointer(), static_cast<unsigned char*>(notification->GetPackPointer()) + IGTL_HEADER_SIZE, notification->GetPackBodySize());
+    receivedNotification->Unpack(1);
+    return receivedNotification;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus CheckMessages(const std::vector<igtl::MessageBase::Pointer>& messages, int firstItemIndex, int numberOfItems)
+  {
+    if (messages.size() != static_cast<size_t>(2 * numberOfItems))
+    {
+      LOG_ERROR("Expected " << 2 * numberOfItems << " messages, received " << messages.size());
+      return PLUS_FAIL;
+    }
+    for (int itemIndex = firstItemIndex; itemIndex < firstItemIndex + numberOfItems; ++itemIndex)
+    {
+      std::vector<igtl::MessageBase::Pointer> expectedMessages = CreateItemMessages(itemIndex);
+      for (int i = 0; i < 2; ++i)
+      {
+        igtl::StringMessage* stringMessage = dynamic_cast<igtl::StringMessage*>(messages[2 * (itemIndex - firstItemIndex) + i].GetPointer());
+        igtl::StringMessage* expectedMessage = dynamic_cast<igtl::StringMessage*>(expectedMessages[i].GetPointer());
+        if (stringMessage == NULL || std::string(stringMessage->GetString()) != expectedMessage->GetString())
+        {
+          LOG_ERROR("Message " << i << " of item " << itemIndex << " does not match");
+          return PLUS_FAIL;
+        }
+      }
+    }
+    return PLUS_SUCCESS;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (!PlusIgtlSharedMemoryRing::IsSupported())
+  {
+    LOG_INFO("Shared memory rings are not supported on this platform, test skipped");
+    return EXIT_SUCCESS;
+  }
+
+  PlusIgtlSharedMemoryRing ring;
+  if (ring.Create(PlusIgtlSharedMemoryRing::GetUniqueName("vtkPlusIgtlSharedMemoryReceiverTest"), NUMBER_OF_SLOTS, SLOT_SIZE) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to create shared memory ring");
+    return EXIT_FAILURE;
+  }
+
+  vtkSmartPointer<vtkPlusIgtlSharedMemoryReceiver> receiver = vtkSmartPointer<vtkPlusIgtlSharedMemoryReceiver>::New();
+  std::vector<igtl::MessageBase::Pointer> messages;
+  if (receiver->ProcessNotification(CreateNotification(ring, 0), messages) != PLUS_SUCCESS || !receiver->IsOpen() || !messages.empty())
+  {
+    LOG_ERROR("Failed to process the ring announcement");
+    return EXIT_FAILURE;
+  }
+
+  int numberOfErrors(0);
+
+  // Items that are read before they are overwritten
+  uint64_t sequence = 0;
+  for (int itemIndex = 0; itemIndex < 3; ++itemIndex)
+  {
+    sequence = ring.WriteItem(CreateItemMessages(itemIndex));
+  }
+  messages.clear();
+  // Only the last notification is processed, as if the others were dropped
+  receiver->ProcessNotification(CreateNotification(ring, sequence), messages);
+  if (CheckMessages(messages, 0, 3) != PLUS_SUCCESS || receiver->GetNumberOfMissedItems() != 0)
+  {
+    LOG_ERROR("Reading items from the ring failed");
+    numberOfErrors++;
+  }
+
+  // Items that are overwritten before they are read
+  for (int itemIndex = 3; itemIndex < 3 + NUMBER_OF_SLOTS + 2; ++itemIndex)
+  {
+    sequence = ring.WriteItem(CreateItemMessages(itemIndex));
+  }
+  messages.clear();
+  receiver->ProcessNotification(CreateNotification(ring, sequence), messages);
+  if (CheckMessages(messages, 5, NUMBER_OF_SLOTS) != PLUS_SUCCESS || receiver->GetNumberOfMissedItems() != 2)
+  {
+    LOG_ERROR("Reading items from an overwritten ring failed (missed items: " << receiver->GetNumberOfMissedItems() << ")");
+    numberOfErrors++;
+  }
+
+  // Items that do not fit in a slot are not written
+  std::vector<igtl::MessageBase::Pointer> largeMessages;
+  igtl::StringMessage::Pointer largeMessage = igtl::StringMessage::New();
+  largeMessage->SetString(std::string(SLOT_SIZE, 'x'));
+  largeMessage->Pack();
+  largeMessages.push_back(largeMessage.GetPointer());
+  if (ring.WriteItem(largeMessages) != 0)
+  {
+    LOG_ERROR("An item larger than the slot size was written into the ring");
+    numberOfErrors++;
+  }
+
+  receiver->Close();
+  ring.Close();
+
+  if (numberOfErrors > 0)
+  {
+    LOG_ERROR("Test failed");
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test successful");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,146 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "igtlPlusCompressedImageMessage.h"
+#include "vtkPlusIgtlMessageFactory.h"
+
+namespace igtl
+{
+  //----------------------------------------------------------------------------
+  PlusCompressedImageMessage::PlusCompressedImageMessage()
+    : MessageBase()
+  {
+    this->m_SendMessageType = "CIMAGE";
+  }
+
+  //----------------------------------------------------------------------------
+  PlusCompressedImageMessage::~PlusCompressedImageMessage()
+  {
+  }
+
+  //----------------------------------------------------------------------------
+  igtl::MessageBase::Pointer PlusCompressedImageMessage::Clone()
+  {
+    igtl::MessageBase::Pointer clone;
+    {
+      vtkSmartPointer<vtkPlusIgtlMessageFactory> factory = vtkSmartPointer<vtkPlusIgtlMessageFactory>::New();
+      clone = dynamic_cast<igtl::MessageBase*>(factory->CreateSendMessage(this->GetMessageType(), this->GetHeaderVersion()).GetPointer());
+    }
+
+    igtl::PlusCompressedImageMessage::Pointer msg = dynamic_cast<igtl::PlusCompressedImageMessage*>(clone.GetPointer());
+
+    int bodySize = this->m_MessageSize - IGTL_HEADER_SIZE;
+    msg->InitBuffer();
+    msg->CopyHeader(this);
+    msg->AllocateBuffer(bodySize);
+    if (bodySize > 0)
+    {
+      msg->CopyBody(this);
+    }
+
+    return clone;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusCompressedImageMessage::CompressedImageHeader& PlusCompressedImageMessage::GetCompressedImageHeader()
+  {
+    return this->m_MessageHeader;
+  }
+
+  //----------------------------------------------------------------------------
+  std::vector<std::vector<unsigned char> >& PlusCompressedImageMessage::GetChunks()
+  {
+    return this->m_Chunks;
+  }
+
+  //----------------------------------------------------------------------------
+  int PlusCompressedImageMessage::CalculateContentBufferSize()
+  {
+    size_t contentSize = this->m_MessageHeader.GetMessageHeaderSize() + this->m_Chunks.size() * sizeof(igtl_uint32);
+    for (std::vector<std::vector<unsigned char> >::const_iterator chunkIt = this->m_Chunks.begin(); chunkIt != this->m_Chunks.end(); ++chunkIt)
+    {
+      contentSize += chunkIt->size();
+    }
+    return static_cast<int>(contentSize);
+  }
+
+  //----------------------------------------------------------------------------
+  int PlusCompressedImageMessage::PackContent()
+  {
+    AllocateBuffer();
+
+    // Copy header
+    this->m_MessageHeader.m_NumberOfChunks = static_cast<igtl_uint32>(this->m_Chunks.size());
+    CompressedImageHeader header = this->m_MessageHeader;
+    header.ConvertEndianness();
+    memcpy(this->m_Content, &header, header.GetMessageHeaderSize());
+
+    // Copy chunk size table and chunks
+    igtl_uint32* chunkSizes = (igtl_uint32*)(this->m_Content + header.GetMessageHeaderSize());
+    unsigned char* chunkData = this->m_Content + header.GetMessageHeaderSize() + this->m_Chunks.size() * sizeof(igtl_uint32);
+    for (size_t i = 0; i < this->m_Chunks.size(); ++i)
+    {
+      igtl_uint32 chunkSize = static_cast<igtl_uint32>(this->m_Chunks[i].size());
+      chunkSizes[i] = igtl_is_little_endian() ? BYTE_SWAP_INT32(chunkSize) : chunkSize;
+      if (chunkSize > 0)
+      {
+        memcpy(chunkData, &this->m_Chunks[i][0], chunkSize);
+      }
+      chunkData += chunkSize;
+    }
+
+    return 1;
+  }
+
+  //----------------------------------------------------------------------------
+  int PlusCompressedImageMessage::UnpackContent()
+  {
+    // The content may be followed by meta data, but it cannot extend beyond the body
+    size_t availableSize = this->GetBufferBodySize() - (this->m_Content - this->m_Body);
+
+    CompressedImageHeader header;
+    if (availableSize < header.GetMessageHeaderSize())
+    {
+      LOG_ERROR("Failed to unpack compressed image message - message is too short");
+      return 0;
+    }
+    memcpy(&header, this->m_Content, header.GetMessageHeaderSize());
+    header.ConvertEndianness();
+
+    if (header.m_Version > CompressedImageMessageVersion)
+    {
+      LOG_ERROR("Failed to unpack compressed image message - unsupported message version: " << header.m_Version);
+      return 0;
+    }
+
+    size_t offset = header.GetMessageHeaderSize();
+    if ((availableSize - offset) / sizeof(igtl_uint32) < header.m_NumberOfChunks)
+    {
+      LOG_ERROR("Failed to unpack compressed image message - chunk table is truncated");
+      return 0;
+    }
+    const igtl_uint32* chunkSizes = (const igtl_uint32*)(this->m_Content + offset);
+    offset += header.m_NumberOfChunks * sizeof(igtl_uint32);
+
+    this->m_Chunks.resize(header.m_NumberOfChunks);
+    for (igtl_uint32 i = 0; i < header.m_NumberOfChunks; ++i)
+    {
+      igtl_uint32 chunkSize = igtl_is_little_endian() ? BYTE_SWAP_INT32(chunkSizes[i]) : chunkSizes[i];
+      if (chunkSize > availableSize - offset)
+      {
+        LOG_ERROR("Failed to unpack compressed image message - chunk " << i << " is truncated");
+        this->m_Chunks.clear();
+        return 0;
+      }
+      this->m_Chunks[i].assign(this->m_Content + offset, this->m_Content + offset + chunkSize);
+      offset += chunkSize;
+    }
+
+    this->m_MessageHeader = header;
+    return 1;
+  }
+}
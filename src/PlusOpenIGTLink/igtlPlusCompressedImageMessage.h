@@ -0,0 +1,194 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __igtlPlusCompressedImageMessage_h
+#define __igtlPlusCompressedImageMessage_h
+
+#include "vtkPlusOpenIGTLinkExport.h"
+
+#include "igtl_types.h"
+#include "igtl_win32header.h"
+#include "igtlMessageBase.h"
+#include "igtlObject.h"
+#include "igtl_header.h"
+#include "igtl_util.h"
+#include <cstring>
+#include <vector>
+
+namespace igtl
+{
+  // This command prevents 4-byte alignment in the struct (which enables m_FrameSize[3])
+#pragma pack(1)     /* For 1-byte boundary in memory */
+
+  /*!
+    \class PlusCompressedImageMessage
+    \brief IGTL message helper class for losslessly compressed images (CIMAGE)
+
+    The message body consists of a fixed size header, a table of compressed chunk sizes and the compressed chunks.
+    The uncompressed pixel data is split into chunks so that the chunks can be compressed and decompressed in parallel.
+    Chunk i of n contains bytes [i*size/n, (i+1)*size/n) of the pixel data.
+    If a predictor is used then the chunks contain the difference to the reference frame (the previous frame of the stream),
+    key frames contain the difference to a zero image, i.e., the pixel data itself.
+    Compression and decompression is implemented in vtkPlusIgtlImageCompressor.
+
+    \ingroup PlusLibOpenIGTLink
+  */
+  class vtkPlusOpenIGTLinkExport PlusCompressedImageMessage: public MessageBase
+  {
+  public:
+    igtlTypeMacro(igtl::PlusCompressedImageMessage, igtl::MessageBase);
+    igtlNewMacro(igtl::PlusCompressedImageMessage);
+
+    enum CodecType
+    {
+      CODEC_ZLIB = 1
+    };
+
+    enum PredictorType
+    {
+      PREDICTOR_NONE = 0,
+      PREDICTOR_DELTA = 1 /* difference of each byte to the same byte of the reference frame (modulo 256) */
+    };
+
+    /*! Version of the message body layout. Unpacking fails for messages with a newer version. */
+    static const igtl_uint16 CompressedImageMessageVersion = 1;
+
+    class CompressedImageHeader
+    {
+    public:
+      CompressedImageHeader()
+        : m_Version(CompressedImageMessageVersion)
+        , m_ScalarType(0)
+        , m_NumberOfComponents(0)
+        , m_ImageType(0)
+        , m_Codec(CODEC_ZLIB)
+        , m_Predictor(PREDICTOR_NONE)
+        , m_KeyFrame(1)
+        , m_StreamId(0)
+        , m_FrameIndex(0)
+        , m_ReferenceFrameIndex(0)
+        , m_UncompressedSizeInBytes(0)
+        , m_NumberOfChunks(0)
+      {
+        m_FrameSize[0] = m_FrameSize[1] = m_FrameSize[2] = 0;
+        m_Spacing[0] = m_Spacing[1] = m_Spacing[2] = 1.f;
+        for (int i = 0; i < 4; ++i)
+        {
+          for (int j = 0; j < 4; ++j)
+          {
+            m_IjkToRasMatrix[i][j] = (i == j) ? 1.f : 0.f;
+          }
+        }
+      }
+
+      size_t GetMessageHeaderSize() const
+      {
+        size_t headersize = 0;
+        headersize += sizeof(igtl_uint16);        // m_Version
+        headersize += sizeof(igtl_uint16);        // m_ScalarType
+        headersize += sizeof(igtl_uint16);        // m_NumberOfComponents
+        headersize += sizeof(igtl_uint16);        // m_ImageType
+        headersize += sizeof(igtl_uint16) * 3;    // m_FrameSize[3]
+        headersize += sizeof(igtl_uint16);        // m_Codec
+        headersize += sizeof(igtl_uint16);        // m_Predictor
+        headersize += sizeof(igtl_uint16);        // m_KeyFrame
+        headersize += sizeof(igtl_uint32);        // m_StreamId
+        headersize += sizeof(igtl_uint32);        // m_FrameIndex
+        headersize += sizeof(igtl_uint32);        // m_ReferenceFrameIndex
+        headersize += sizeof(igtl_uint32);        // m_UncompressedSizeInBytes
+        headersize += sizeof(igtl_uint32);        // m_NumberOfChunks
+        headersize += sizeof(igtl_float32) * 3;   // m_Spacing[3]
+        headersize += sizeof(igtl::Matrix4x4);    // m_IjkToRasMatrix[4][4]
+
+        return headersize;
+      }
+
+      void ConvertEndianness()
+      {
+        if (igtl_is_little_endian())
+        {
+          m_Version = BYTE_SWAP_INT16(m_Version);
+          m_ScalarType = BYTE_SWAP_INT16(m_ScalarType);
+          m_NumberOfComponents = BYTE_SWAP_INT16(m_NumberOfComponents);
+          m_ImageType = BYTE_SWAP_INT16(m_ImageType);
+          m_FrameSize[0] = BYTE_SWAP_INT16(m_FrameSize[0]);
+          m_FrameSize[1] = BYTE_SWAP_INT16(m_FrameSize[1]);
+          m_FrameSize[2] = BYTE_SWAP_INT16(m_FrameSize[2]);
+          m_Codec = BYTE_SWAP_INT16(m_Codec);
+          m_Predictor = BYTE_SWAP_INT16(m_Predictor);
+          m_KeyFrame = BYTE_SWAP_INT16(m_KeyFrame);
+          m_StreamId = BYTE_SWAP_INT32(m_StreamId);
+          m_FrameIndex = BYTE_SWAP_INT32(m_FrameIndex);
+          m_ReferenceFrameIndex = BYTE_SWAP_INT32(m_ReferenceFrameIndex);
+          m_UncompressedSizeInBytes = BYTE_SWAP_INT32(m_UncompressedSizeInBytes);
+          m_NumberOfChunks = BYTE_SWAP_INT32(m_NumberOfChunks);
+          for (int i = 0; i < 3; ++i)
+          {
+            SwapFloat(m_Spacing[i]);
+          }
+          for (int i = 0; i < 4; ++i)
+          {
+            for (int j = 0; j < 4; ++j)
+            {
+              SwapFloat(m_IjkToRasMatrix[i][j]);
+            }
+          }
+        }
+      }
+
+      igtl_uint16     m_Version;                 /* version of the message body layout */
+      igtl_uint16     m_ScalarType;              /* scalar type (IGTL) */
+      igtl_uint16     m_NumberOfComponents;      /* number of scalar components */
+      igtl_uint16     m_ImageType;               /* image type */
+      igtl_uint16     m_FrameSize[3];            /* entire image volume size */
+      igtl_uint16     m_Codec;                   /* compression method of the chunks, CodecType */
+      igtl_uint16     m_Predictor;               /* prediction applied before compression, PredictorType */
+      igtl_uint16     m_KeyFrame;                /* nonzero if the frame does not depend on any previous frame */
+      igtl_uint32     m_StreamId;                /* identifies the sequence of frames that predicted frames refer to */
+      igtl_uint32     m_FrameIndex;              /* index of the frame in the stream */
+      igtl_uint32     m_ReferenceFrameIndex;     /* index of the frame that this frame is predicted from (ignored for key frames) */
+      igtl_uint32     m_UncompressedSizeInBytes; /* size of the pixel data, in bytes */
+      igtl_uint32     m_NumberOfChunks;          /* number of compressed chunks */
+      igtl_float32    m_Spacing[3];              /* pixel spacing */
+      igtl::Matrix4x4 m_IjkToRasMatrix;          /* image orientation and origin, same as in IMAGE messages */
+
+    protected:
+      static void SwapFloat(igtl_float32& value)
+      {
+        igtl_uint32 tmp;
+        memcpy(&tmp, &value, sizeof(tmp));
+        tmp = BYTE_SWAP_INT32(tmp);
+        memcpy(&value, &tmp, sizeof(tmp));
+      }
+    };
+
+  public:
+    /*! Override clone so that we use the plus igtl factory */
+    virtual igtl::MessageBase::Pointer Clone();
+
+    /*! Image properties and compression parameters. Set before packing, valid after unpacking. */
+    CompressedImageHeader& GetCompressedImageHeader();
+
+    /*! Compressed chunks of the pixel data. Set before packing, valid after unpacking. */
+    std::vector<std::vector<unsigned char> >& GetChunks();
+
+  protected:
+    virtual int  CalculateContentBufferSize();
+    virtual int  PackContent();
+    virtual int  UnpackContent();
+
+    PlusCompressedImageMessage();
+    ~PlusCompressedImageMessage();
+
+    CompressedImageHeader m_MessageHeader;
+    std::vector<std::vector<unsigned char> > m_Chunks;
+  };
+
+#pragma pack()
+
+} // namespace igtl
+
+#endif
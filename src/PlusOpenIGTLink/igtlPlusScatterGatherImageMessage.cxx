@@ -0,0 +1,179 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "igtlPlusScatterGatherImageMessage.h"
+#include "igtl_header.h"
+#include "igtl_image.h"
+#include "igtl_util.h"
+
+namespace
+{
+  // Byte offsets of the fields that are updated after the placeholder message is packed
+  const size_t HEADER_BODY_SIZE_OFFSET = 42;
+  const size_t HEADER_CRC_OFFSET = 50;
+  // The sub-volume size is the last field of the image header (3 x uint16)
+  const size_t IMAGE_HEADER_SUBVOLUME_SIZE_OFFSET = IGTL_IMAGE_HEADER_SIZE - 3 * sizeof(igtl_uint16);
+
+  //----------------------------------------------------------------------------
+  igtl_uint64 ReadBigEndian(const unsigned char* data, size_t numberOfBytes)
+  {
+    igtl_uint64 value = 0;
+    for (size_t i = 0; i < numberOfBytes; ++i)
+    {
+      value = (value << 8) | data[i];
+    }
+    return value;
+  }
+
+  //----------------------------------------------------------------------------
+  void WriteBigEndian(unsigned char* data, size_t numberOfBytes, igtl_uint64 value)
+  {
+    for (size_t i = 0; i < numberOfBytes; ++i)
+    {
+      data[numberOfBytes - 1 - i] = static_cast<unsigned char>(value & 0xFF);
+      value >>= 8;
+    }
+  }
+}
+
+namespace igtl
+{
+  //----------------------------------------------------------------------------
+  PlusScatterGatherImageMessage::PlusScatterGatherImageMessage()
+    : ImageMessage()
+    , m_PixelDataSize(0)
+  {
+  }
+
+  //----------------------------------------------------------------------------
+  PlusScatterGatherImageMessage::~PlusScatterGatherImageMessage()
+  {
+  }
+
+  //----------------------------------------------------------------------------
+  void PlusScatterGatherImageMessage::SetPixelData(vtkImageData* pixelData)
+  {
+    m_PixelData = pixelData;
+  }
+
+  //----------------------------------------------------------------------------
+  vtkImageData* PlusScatterGatherImageMessage::GetPixelData() const
+  {
+    return m_PixelData;
+  }
+
+  //----------------------------------------------------------------------------
+  int PlusScatterGatherImageMessage::PackSegments()
+  {
+    m_PackedPrefix.clear();
+    m_PackedSuffix.clear();
+    m_PixelDataSize = 0;
+
+    if (m_PixelData == NULL || m_PixelData->GetScalarPointer() == NULL)
+    {
+      LOG_ERROR("Failed to pack scatter-gather image message: pixel data is not set");
+      return 0;
+    }
+
+    int subVolumeSize[3] = { 0 };
+    int subVolumeOffset[3] = { 0 };
+    this->GetSubVolume(subVolumeSize, subVolumeOffset);
+    size_t pixelDataSize = static_cast<size_t>(this->GetSubVolumeImageSize());
+    size_t availablePixelDataSize = static_cast<size_t>(m_PixelData->GetScalarSize()) * m_PixelData->GetNumberOfScalarComponents() * m_PixelData->GetNumberOfPoints();
+    if (pixelDataSize != availablePixelDataSize)
+    {
+      LOG_ERROR("Failed to pack scatter-gather image message: message requires " << pixelDataSize << " bytes of pixel data but the image contains " << availablePixelDataSize << " bytes");
+      return 0;
+    }
+
+    // Pack the message with a single-voxel sub-volume. This produces all header and meta data fields
+    // with the standard OpenIGTLink packing code, without allocating and copying the full image.
+    int placeholderSize[3] = { 1, 1, 1 };
+    int placeholderOffset[3] = { 0, 0, 0 };
+    this->SetSubVolume(placeholderSize, placeholderOffset);
+    this->AllocateScalars();
+    size_t placeholderPixelDataSize = static_cast<size_t>(this->GetSubVolumeImageSize());
+    memset(this->GetScalarPointer(), 0, placeholderPixelDataSize);
+    int packResult = this->Pack();
+    this->SetSubVolume(subVolumeSize, subVolumeOffset);
+    if (packResult == 0)
+    {
+      LOG_ERROR("Failed to pack scatter-gather image message");
+      return 0;
+    }
+
+    const unsigned char* packed = static_cast<const unsigned char*>(this->GetPackPointer());
+    size_t packedSize = static_cast<size_t>(this->GetPackSize());
+    size_t contentOffset = IGTL_HEADER_SIZE;
+    if (ReadBigEndian(packed, sizeof(igtl_uint16)) >= IGTL_HEADER_VERSION_2)
+    {
+      // The extended header starts with its own size
+      contentOffset += static_cast<size_t>(ReadBigEndian(packed + IGTL_HEADER_SIZE, sizeof(igtl_uint16)));
+    }
+    size_t pixelDataOffset = contentOffset + IGTL_IMAGE_HEADER_SIZE;
+    size_t suffixOffset = pixelDataOffset + placeholderPixelDataSize;
+    if (suffixOffset > packedSize)
+    {
+      LOG_ERROR("Failed to pack scatter-gather image message: unexpected packed message size");
+      return 0;
+    }
+
+    m_PackedPrefix.assign(packed, packed + pixelDataOffset);
+    m_PackedSuffix.assign(packed + suffixOffset, packed + packedSize);
+    m_PixelDataSize = pixelDataSize;
+
+    unsigned char* imageHeader = &m_PackedPrefix[contentOffset];
+    for (int i = 0; i < 3; ++i)
+    {
+      WriteBigEndian(imageHeader + IMAGE_HEADER_SUBVOLUME_SIZE_OFFSET + i * sizeof(igtl_uint16), sizeof(igtl_uint16), subVolumeSize[i]);
+    }
+
+    // CRC of the body is computed block by block, the pixels are read in place
+    igtl_uint64 crc = crc64(0, 0, 0LL);
+    crc = crc64(&m_PackedPrefix[IGTL_HEADER_SIZE], m_PackedPrefix.size() - IGTL_HEADER_SIZE, crc);
+    crc = crc64(static_cast<unsigned char*>(m_PixelData->GetScalarPointer()), m_PixelDataSize, crc);
+    if (!m_PackedSuffix.empty())
+    {
+      crc = crc64(&m_PackedSuffix[0], m_PackedSuffix.size(), crc);
+    }
+
+    igtl_uint64 bodySize = m_PackedPrefix.size() - IGTL_HEADER_SIZE + m_PixelDataSize + m_PackedSuffix.size();
+    WriteBigEndian(&m_PackedPrefix[HEADER_BODY_SIZE_OFFSET], sizeof(igtl_uint64), bodySize);
+    WriteBigEndian(&m_PackedPrefix[HEADER_CRC_OFFSET], sizeof(igtl_uint64), crc);
+
+    return 1;
+  }
+
+  //----------------------------------------------------------------------------
+  void PlusScatterGatherImageMessage::GetSegments(std::vector<Segment>& segments) const
+  {
+    segments.clear();
+    if (m_PackedPrefix.empty())
+    {
+      return;
+    }
+    Segment prefix = { &m_PackedPrefix[0], m_PackedPrefix.size() };
+    segments.push_back(prefix);
+    Segment pixels = { static_cast<const unsigned char*>(m_PixelData->GetScalarPointer()), m_PixelDataSize };
+    segments.push_back(pixels);
+    if (!m_PackedSuffix.empty())
+    {
+      Segment suffix = { &m_PackedSuffix[0], m_PackedSuffix.size() };
+      segments.push_back(suffix);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  size_t PlusScatterGatherImageMessage::GetSegmentsSize() const
+  {
+    if (m_PackedPrefix.empty())
+    {
+      return 0;
+    }
+    return m_PackedPrefix.size() + m_PixelDataSize + m_PackedSuffix.size();
+  }
+}
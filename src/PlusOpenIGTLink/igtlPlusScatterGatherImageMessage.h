@@ -0,0 +1,83 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __igtlPlusScatterGatherImageMessage_h
+#define __igtlPlusScatterGatherImageMessage_h
+
+#include "vtkPlusOpenIGTLinkExport.h"
+
+#include "igtlImageMessage.h"
+
+#include <vtkImageData.h>
+#include <vtkSmartPointer.h>
+
+#include <vector>
+
+namespace igtl
+{
+  /*!
+  \class PlusScatterGatherImageMessage
+  \brief IMAGE message that is sent without copying the pixels into the message buffer
+
+  The message is configured the same way as igtl::ImageMessage (dimensions, spacing, matrix, meta data, etc.)
+  but instead of AllocateScalars() and Pack() the caller sets the pixel data with SetPixelData() and calls PackSegments().
+  PackSegments() packs the header, extended header, image header and meta data into small buffers and computes
+  the CRC incrementally over the body parts, including the pixels of the referenced image.
+  The packed message is then available as a list of memory blocks (GetSegments()) that can be sent with a
+  single gather write (writev/sendmsg). The referenced image is kept alive until the message is destroyed,
+  so the image must not be modified after packing.
+
+  GetPackPointer()/GetPackSize() do not contain the full message, use vtkPlusIgtlMessageCommon::SendPackedMessage()
+  or vtkPlusIgtlMessageCommon::GetPackedMessageSegments() to send it.
+
+  The wire format is identical to a regular IMAGE message, so receivers do not need any change.
+  \ingroup PlusLibOpenIGTLink
+  */
+  class vtkPlusOpenIGTLinkExport PlusScatterGatherImageMessage: public igtl::ImageMessage
+  {
+  public:
+    igtlTypeMacro(igtl::PlusScatterGatherImageMessage, igtl::ImageMessage);
+    igtlNewMacro(igtl::PlusScatterGatherImageMessage);
+
+    /*! Contiguous block of a packed message */
+    struct Segment
+    {
+      const unsigned char* Data;
+      size_t Size;
+    };
+
+  public:
+    /*! Set the image that contains the pixels of the message. The number of pixels, components and the scalar size must match the message. */
+    void SetPixelData(vtkImageData* pixelData);
+    vtkImageData* GetPixelData() const;
+
+    /*!
+    Pack all parts of the message except the pixels and compute the header fields (body size, CRC) of the full message.
+    Returns 1 on success, 0 on failure (same convention as Pack()).
+    */
+    int PackSegments();
+
+    /*! Get the memory blocks of the packed message in wire order. Empty if the message is not packed. */
+    void GetSegments(std::vector<Segment>& segments) const;
+
+    /*! Get the total size of the packed message in bytes */
+    size_t GetSegmentsSize() const;
+
+  protected:
+    PlusScatterGatherImageMessage();
+    ~PlusScatterGatherImageMessage();
+
+    /*! Packed header, extended header and image header, with the body size and CRC of the full message */
+    std::vector<unsigned char> m_PackedPrefix;
+    /*! Packed meta data header and meta data that follows the pixels */
+    std::vector<unsigned char> m_PackedSuffix;
+    /*! Number of pixel bytes sent from m_PixelData */
+    size_t m_PixelDataSize;
+    vtkSmartPointer<vtkImageData> m_PixelData;
+  };
+}
+
+#endif
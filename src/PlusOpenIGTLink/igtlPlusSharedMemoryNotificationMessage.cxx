@@ -0,0 +1,164 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "igtlPlusSharedMemoryNotificationMessage.h"
+#include "vtkPlusIgtlMessageFactory.h"
+
+// STL includes
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+  const size_t SHARED_MEMORY_NOTIFICATION_CONTENT_SIZE = sizeof(igtl_uint64) + 2 * sizeof(igtl_uint32) + igtl::PlusSharedMemoryNotificationMessage::RingNameLength;
+}
+
+namespace igtl
+{
+  //----------------------------------------------------------------------------
+  PlusSharedMemoryNotificationMessage::PlusSharedMemoryNotificationMessage()
+    : MessageBase()
+    , m_Sequence(0)
+    , m_NumberOfSlots(0)
+    , m_SlotSize(0)
+  {
+    this->m_SendMessageType = "SHMNOTIFY";
+  }
+
+  //----------------------------------------------------------------------------
+  PlusSharedMemoryNotificationMessage::~PlusSharedMemoryNotificationMessage()
+  {
+  }
+
+  //----------------------------------------------------------------------------
+  igtl::MessageBase::Pointer PlusSharedMemoryNotificationMessage::Clone()
+  {
+    igtl::MessageBase::Pointer clone;
+    {
+      vtkSmartPointer<vtkPlusIgtlMessageFactory> factory = vtkSmartPointer<vtkPlusIgtlMessageFactory>::New();
+      clone = dynamic_cast<igtl::MessageBase*>(factory->CreateSendMessage(this->GetMessageType(), this->GetHeaderVersion()).GetPointer());
+    }
+
+    igtl::PlusSharedMemoryNotificationMessage::Pointer msg = dynamic_cast<igtl::PlusSharedMemoryNotificationMessage*>(clone.GetPointer());
+
+    int bodySize = this->m_MessageSize - IGTL_HEADER_SIZE;
+    msg->InitBuffer();
+    msg->CopyHeader(this);
+    msg->AllocateBuffer(bodySize);
+    if (bodySize > 0)
+    {
+      msg->CopyBody(this);
+    }
+
+    return clone;
+  }
+
+  //----------------------------------------------------------------------------
+  void PlusSharedMemoryNotificationMessage::SetSequence(igtl_uint64 sequence)
+  {
+    this->m_Sequence = sequence;
+  }
+
+  //----------------------------------------------------------------------------
+  igtl_uint64 PlusSharedMemoryNotificationMessage::GetSequence() const
+  {
+    return this->m_Sequence;
+  }
+
+  //----------------------------------------------------------------------------
+  void PlusSharedMemoryNotificationMessage::SetNumberOfSlots(igtl_uint32 numberOfSlots)
+  {
+    this->m_NumberOfSlots = numberOfSlots;
+  }
+
+  //----------------------------------------------------------------------------
+  igtl_uint32 PlusSharedMemoryNotificationMessage::GetNumberOfSlots() const
+  {
+    return this->m_NumberOfSlots;
+  }
+
+  //----------------------------------------------------------------------------
+  void PlusSharedMemoryNotificationMessage::SetSlotSize(igtl_uint32 slotSize)
+  {
+    this->m_SlotSize = slotSize;
+  }
+
+  //----------------------------------------------------------------------------
+  igtl_uint32 PlusSharedMemoryNotificationMessage::GetSlotSize() const
+  {
+    return this->m_SlotSize;
+  }
+
+  //----------------------------------------------------------------------------
+  void PlusSharedMemoryNotificationMessage::SetRingName(const std::string& ringName)
+  {
+    this->m_RingName = ringName.substr(0, RingNameLength - 1);
+  }
+
+  //----------------------------------------------------------------------------
+  std::string PlusSharedMemoryNotificationMessage::GetRingName() const
+  {
+    return this->m_RingName;
+  }
+
+  //----------------------------------------------------------------------------
+  int PlusSharedMemoryNotificationMessage::CalculateContentBufferSize()
+  {
+    return static_cast<int>(SHARED_MEMORY_NOTIFICATION_CONTENT_SIZE);
+  }
+
+  //----------------------------------------------------------------------------
+  int PlusSharedMemoryNotificationMessage::PackContent()
+  {
+    AllocateBuffer();
+
+    unsigned char* content = this->m_Content;
+    igtl_uint64 sequence = igtl_is_little_endian() ? BYTE_SWAP_INT64(this->m_Sequence) : this->m_Sequence;
+    memcpy(content, &sequence, sizeof(sequence));
+    content += sizeof(sequence);
+    igtl_uint32 numberOfSlots = igtl_is_little_endian() ? BYTE_SWAP_INT32(this->m_NumberOfSlots) : this->m_NumberOfSlots;
+    memcpy(content, &numberOfSlots, sizeof(numberOfSlots));
+    content += sizeof(numberOfSlots);
+    igtl_uint32 slotSize = igtl_is_little_endian() ? BYTE_SWAP_INT32(this->m_SlotSize) : this->m_SlotSize;
+    memcpy(content, &slotSize, sizeof(slotSize));
+    content += sizeof(slotSize);
+    memset(content, 0, RingNameLength);
+    memcpy(content, this->m_RingName.c_str(), this->m_RingName.size());
+
+    return 1;
+  }
+
+  //----------------------------------------------------------------------------
+  int PlusSharedMemoryNotificationMessage::UnpackContent()
+  {
+    // The content may be followed by meta data, but it cannot extend beyond the body
+    size_t availableSize = this->GetBufferBodySize() - (this->m_Content - this->m_Body);
+    if (availableSize < SHARED_MEMORY_NOTIFICATION_CONTENT_SIZE)
+    {
+      LOG_ERROR("Failed to unpack shared memory notification message - message is too short");
+      return 0;
+    }
+
+    const unsigned char* content = this->m_Content;
+    igtl_uint64 sequence = 0;
+    memcpy(&sequence, content, sizeof(sequence));
+    this->m_Sequence = igtl_is_little_endian() ? BYTE_SWAP_INT64(sequence) : sequence;
+    content += sizeof(sequence);
+    igtl_uint32 numberOfSlots = 0;
+    memcpy(&numberOfSlots, content, sizeof(numberOfSlots));
+    this->m_NumberOfSlots = igtl_is_little_endian() ? BYTE_SWAP_INT32(numberOfSlots) : numberOfSlots;
+    content += sizeof(numberOfSlots);
+    igtl_uint32 slotSize = 0;
+    memcpy(&slotSize, content, sizeof(slotSize));
+    this->m_SlotSize = igtl_is_little_endian() ? BYTE_SWAP_INT32(slotSize) : slotSize;
+    content += sizeof(slotSize);
+    const char* ringName = reinterpret_cast<const char*>(content);
+    this->m_RingName.assign(ringName, std::find(ringName, ringName + RingNameLength, '\0'));
+
+    return 1;
+  }
+}
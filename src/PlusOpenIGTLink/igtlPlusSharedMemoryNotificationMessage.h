@@ -0,0 +1,76 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __igtlPlusSharedMemoryNotificationMessage_h
+#define __igtlPlusSharedMemoryNotificationMessage_h
+
+#include "vtkPlusOpenIGTLinkExport.h"
+
+#include "igtl_types.h"
+#include "igtl_win32header.h"
+#include "igtlMessageBase.h"
+#include "igtlObject.h"
+#include "igtl_header.h"
+#include "igtl_util.h"
+#include <string>
+
+namespace igtl
+{
+  /*!
+    \class PlusSharedMemoryNotificationMessage
+    \brief IGTL message helper class for shared memory transport notifications (SHMNOTIFY)
+
+    Sent by the server on the client's socket when the messages of a tracked frame are written to the
+    client's shared memory ring (see PlusIgtlSharedMemoryRing) instead of the socket.
+    A notification with zero sequence number announces the ring (sent once, after the client requested
+    the shared memory transport in its CLIENTINFO message).
+
+    \ingroup PlusLibOpenIGTLink
+  */
+  class vtkPlusOpenIGTLinkExport PlusSharedMemoryNotificationMessage: public MessageBase
+  {
+  public:
+    igtlTypeMacro(igtl::PlusSharedMemoryNotificationMessage, igtl::MessageBase);
+    igtlNewMacro(igtl::PlusSharedMemoryNotificationMessage);
+
+    /*! Maximum length of the ring name, including the terminating zero */
+    static const int RingNameLength = 64;
+
+  public:
+    /*! Override clone so that we use the plus igtl factory */
+    virtual igtl::MessageBase::Pointer Clone();
+
+    /*! Sequence number of the item that has been written to the ring, 0 for the announcement of the ring */
+    void SetSequence(igtl_uint64 sequence);
+    igtl_uint64 GetSequence() const;
+
+    void SetNumberOfSlots(igtl_uint32 numberOfSlots);
+    igtl_uint32 GetNumberOfSlots() const;
+
+    void SetSlotSize(igtl_uint32 slotSize);
+    igtl_uint32 GetSlotSize() const;
+
+    /*! Name of the shared memory object of the ring */
+    void SetRingName(const std::string& ringName);
+    std::string GetRingName() const;
+
+  protected:
+    virtual int  CalculateContentBufferSize();
+    virtual int  PackContent();
+    virtual int  UnpackContent();
+
+    PlusSharedMemoryNotificationMessage();
+    ~PlusSharedMemoryNotificationMessage();
+
+    igtl_uint64 m_Sequence;
+    igtl_uint32 m_NumberOfSlots;
+    igtl_uint32 m_SlotSize;
+    std::string m_RingName;
+  };
+
+} // namespace igtl
+
+#endif
@@ -10,11 +10,78 @@ See License.txt for details.
 #include "vtkMatrix4x4.h"
 #include "vtkPlusIgtlMessageFactory.h"
 
+// STL includes
+#include <set>
+
+namespace
+{
+  // The binary field section starts with a magic string, an XML field section always starts with '<'
+  const char BINARY_FIELDS_MAGIC[4] = { 'P', 'T', 'F', 'B' };
+  const size_t BINARY_FIELDS_PREAMBLE_SIZE = sizeof(BINARY_FIELDS_MAGIC) + sizeof(igtl_uint16);
+
+  // Type of the entries in the binary field section
+  const igtl_uint8 BINARY_FIELD_STRING = 1;
+  const igtl_uint8 BINARY_FIELD_TRANSFORM = 2;
+
+  // Byte offsets of the fields that are updated after the message is packed without the image
+  const size_t HEADER_BODY_SIZE_OFFSET = 42;
+  const size_t HEADER_CRC_OFFSET = 50;
+
+  //----------------------------------------------------------------------------
+  void AppendBigEndian(std::string& data, size_t numberOfBytes, igtl_uint64 value)
+  {
+    for (size_t i = 0; i < numberOfBytes; ++i)
+    {
+      data.push_back(static_cast<char>((value >> (8 * (numberOfBytes - 1 - i))) & 0xFF));
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  bool ReadBigEndian(const unsigned char*& data, const unsigned char* dataEnd, size_t numberOfBytes, igtl_uint64& value)
+  {
+    if (static_cast<size_t>(dataEnd - data) < numberOfBytes)
+    {
+      return false;
+    }
+    value = 0;
+    for (size_t i = 0; i < numberOfBytes; ++i)
+    {
+      value = (value << 8) | data[i];
+    }
+    data += numberOfBytes;
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  bool ReadString(const unsigned char*& data, const unsigned char* dataEnd, size_t length, std::string& value)
+  {
+    if (static_cast<size_t>(dataEnd - data) < length)
+    {
+      return false;
+    }
+    value.assign(reinterpret_cast<const char*>(data), length);
+    data += length;
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  void WriteBigEndian(unsigned char* data, size_t numberOfBytes, igtl_uint64 value)
+  {
+    for (size_t i = 0; i < numberOfBytes; ++i)
+    {
+      data[numberOfBytes - 1 - i] = static_cast<unsigned char>(value & 0xFF);
+      value >>= 8;
+    }
+  }
+}
+
 namespace igtl
 {
   //----------------------------------------------------------------------------
   PlusTrackedFrameMessage::PlusTrackedFrameMessage()
     : MessageBase()
+    , m_FieldsVersion(FIELDS_VERSION_XML)
+    , m_PackImageInContent(true)
   {
     this->m_SendMessageType = "TRACKEDFRAME";
   }
@@ -52,7 +119,15 @@ namespace igtl
   {
     this->m_TrackedFrame = trackedFrame;
 
-    if (this->m_TrackedFrame.GetTrackedFrameInXmlData(this->m_TrackedFrameXmlData, requestedTransforms) != PLUS_SUCCESS)
+    if (this->m_FieldsVersion >= FIELDS_VERSION_BINARY)
+    {
+      if (this->EncodeBinaryFields(requestedTransforms) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to pack Plus TrackedFrame message - unable to encode tracked frame fields.");
+        return PLUS_FAIL;
+      }
+    }
+    else if (this->m_TrackedFrame.GetTrackedFrameInXmlData(this->m_TrackedFrameFieldData, requestedTransforms) != PLUS_SUCCESS)
     {
       LOG_ERROR("Failed to pack Plus TrackedFrame message - unable to get tracked frame in xml data.");
       return PLUS_FAIL;
@@ -70,7 +145,7 @@ namespace igtl
     this->m_MessageHeader.m_FrameSize[0] = frameSize[0];
     this->m_MessageHeader.m_FrameSize[1] = frameSize[1];
     this->m_MessageHeader.m_FrameSize[2] = frameSize[2];
-    this->m_MessageHeader.m_XmlDataSizeInBytes = this->m_TrackedFrameXmlData.size();
+    this->m_MessageHeader.m_XmlDataSizeInBytes = this->m_TrackedFrameFieldData.size();
     this->m_MessageHeader.m_ScalarType = PlusCommon::GetIGTLScalarPixelTypeFromVTK(this->m_TrackedFrame.GetImageData()->GetVTKScalarPixelType());
 
     unsigned int numberOfScalarComponents(1);
@@ -121,11 +196,275 @@ namespace igtl
     return mat;
   }
 
+  //----------------------------------------------------------------------------
+  void PlusTrackedFrameMessage::SetFieldsVersion(int version)
+  {
+    this->m_FieldsVersion = version;
+  }
+
+  //----------------------------------------------------------------------------
+  int PlusTrackedFrameMessage::GetFieldsVersion() const
+  {
+    return this->m_FieldsVersion;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus PlusTrackedFrameMessage::EncodeBinaryFields(const std::vector<igsioTransformName>& requestedTransforms)
+  {
+    // Transforms are stored as frame fields (e.g., ProbeToTrackerTransform, ProbeToTrackerTransformStatus).
+    // The fields of the transforms that are sent as transform entries are not sent as strings.
+    std::string transformData;
+    std::set<std::string> transformFieldNames;
+    std::vector<igsioTransformName> transformNames = requestedTransforms;
+    if (transformNames.empty())
+    {
+      this->m_TrackedFrame.GetFrameTransformNameList(transformNames);
+    }
+    vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    for (std::vector<igsioTransformName>::const_iterator nameIt = transformNames.begin(); nameIt != transformNames.end(); ++nameIt)
+    {
+      std::string transformName;
+      if (nameIt->GetTransformName(transformName) != PLUS_SUCCESS || this->m_TrackedFrame.GetFrameTransform(*nameIt, matrix) != PLUS_SUCCESS)
+      {
+        // Transforms that are not available in the frame are not sent, the same way as in the XML encoding
+        continue;
+      }
+      transformFieldNames.insert(transformName + "Transform");
+      transformFieldNames.insert(transformName + "TransformStatus");
+      ToolStatus status(TOOL_INVALID);
+      this->m_TrackedFrame.GetFrameTransformStatus(*nameIt, status);
+
+      AppendBigEndian(transformData, sizeof(igtl_uint8), BINARY_FIELD_TRANSFORM);
+      AppendBigEndian(transformData, sizeof(igtl_uint16), transformName.size());
+      transformData.append(transformName);
+      AppendBigEndian(transformData, sizeof(igtl_uint8), static_cast<igtl_uint8>(status));
+      for (int i = 0; i < 4; ++i)
+      {
+        for (int j = 0; j < 4; ++j)
+        {
+          float element = static_cast<float>(matrix->GetElement(i, j));
+          igtl_uint32 elementBits = 0;
+          memcpy(&elementBits, &element, sizeof(elementBits));
+          AppendBigEndian(transformData, sizeof(igtl_uint32), elementBits);
+        }
+      }
+    }
+
+    std::string& data = this->m_TrackedFrameFieldData;
+    data.clear();
+    data.append(BINARY_FIELDS_MAGIC, sizeof(BINARY_FIELDS_MAGIC));
+    AppendBigEndian(data, sizeof(igtl_uint16), FIELDS_VERSION_BINARY);
+
+    std::vector<std::string> fieldNames;
+    this->m_TrackedFrame.GetFrameFieldNameList(fieldNames);
+    for (std::vector<std::string>::const_iterator fieldIt = fieldNames.begin(); fieldIt != fieldNames.end(); ++fieldIt)
+    {
+      if (transformFieldNames.find(*fieldIt) != transformFieldNames.end())
+      {
+        continue;
+      }
+      std::string value = this->m_TrackedFrame.GetFrameField(*fieldIt);
+      if (fieldIt->size() > std::numeric_limits<igtl_uint16>::max() || value.size() > std::numeric_limits<igtl_uint32>::max())
+      {
+        LOG_ERROR("Frame field " << *fieldIt << " is too large to be sent in a binary field section");
+        return PLUS_FAIL;
+      }
+      AppendBigEndian(data, sizeof(igtl_uint8), BINARY_FIELD_STRING);
+      AppendBigEndian(data, sizeof(igtl_uint16), fieldIt->size());
+      data.append(*fieldIt);
+      AppendBigEndian(data, sizeof(igtl_uint32), value.size());
+      data.append(value);
+    }
+    data.append(transformData);
+
+    if (data.size() > std::numeric_limits<igtl_uint32>::max())
+    {
+      LOG_ERROR("Binary field section is too large to be sent over OpenIGTLink");
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus PlusTrackedFrameMessage::DecodeBinaryFields(const unsigned char* data, size_t size)
+  {
+    const unsigned char* dataEnd = data + size;
+    igtl_uint64 version = 0;
+    if (size < BINARY_FIELDS_PREAMBLE_SIZE || memcmp(data, BINARY_FIELDS_MAGIC, sizeof(BINARY_FIELDS_MAGIC)) != 0)
+    {
+      LOG_ERROR("Invalid binary field section in Plus TrackedFrame message");
+      return PLUS_FAIL;
+    }
+    data += sizeof(BINARY_FIELDS_MAGIC);
+    ReadBigEndian(data, dataEnd, sizeof(igtl_uint16), version);
+    if (version < FIELDS_VERSION_BINARY)
+    {
+      LOG_ERROR("Invalid binary field section version in Plus TrackedFrame message: " << version);
+      return PLUS_FAIL;
+    }
+
+    // Later versions may only append new entry types, unknown entries cannot be skipped so they stop decoding
+    while (data < dataEnd)
+    {
+      igtl_uint64 entryType = 0;
+      igtl_uint64 nameLength = 0;
+      std::string name;
+      if (!ReadBigEndian(data, dataEnd, sizeof(igtl_uint8), entryType)
+          || !ReadBigEndian(data, dataEnd, sizeof(igtl_uint16), nameLength)
+          || !ReadString(data, dataEnd, static_cast<size_t>(nameLength), name))
+      {
+        LOG_ERROR("Truncated entry in the binary field section of Plus TrackedFrame message");
+        return PLUS_FAIL;
+      }
+
+      if (entryType == BINARY_FIELD_STRING)
+      {
+        igtl_uint64 valueLength = 0;
+        std::string value;
+        if (!ReadBigEndian(data, dataEnd, sizeof(igtl_uint32), valueLength) || !ReadString(data, dataEnd, static_cast<size_t>(valueLength), value))
+        {
+          LOG_ERROR("Truncated value of frame field " << name << " in Plus TrackedFrame message");
+          return PLUS_FAIL;
+        }
+        this->m_TrackedFrame.SetFrameField(name, value);
+      }
+      else if (entryType == BINARY_FIELD_TRANSFORM)
+      {
+        igtl_uint64 status = 0;
+        if (!ReadBigEndian(data, dataEnd, sizeof(igtl_uint8), status))
+        {
+          LOG_ERROR("Truncated status of transform " << name << " in Plus TrackedFrame message");
+          return PLUS_FAIL;
+        }
+        vtkSmartPointer<vtkMatrix4x4> matrix = vtkSmartPointer<vtkMatrix4x4>::New();
+        for (int i = 0; i < 4; ++i)
+        {
+          for (int j = 0; j < 4; ++j)
+          {
+            igtl_uint64 elementBits = 0;
+            if (!ReadBigEndian(data, dataEnd, sizeof(igtl_uint32), elementBits))
+            {
+              LOG_ERROR("Truncated matrix of transform " << name << " in Plus TrackedFrame message");
+              return PLUS_FAIL;
+            }
+            igtl_uint32 elementBits32 = static_cast<igtl_uint32>(elementBits);
+            float element = 0;
+            memcpy(&element, &elementBits32, sizeof(element));
+            matrix->SetElement(i, j, element);
+          }
+        }
+        igsioTransformName transformName;
+        if (transformName.SetTransformName(name) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Invalid transform name in Plus TrackedFrame message: " << name);
+          return PLUS_FAIL;
+        }
+        this->m_TrackedFrame.SetFrameTransform(transformName, matrix);
+        this->m_TrackedFrame.SetFrameTransformStatus(transformName, static_cast<ToolStatus>(status));
+      }
+      else
+      {
+        LOG_WARNING("Unknown entry type " << entryType << " in the binary field section of Plus TrackedFrame message, remaining fields are ignored");
+        break;
+      }
+    }
+
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  int PlusTrackedFrameMessage::PackSegments()
+  {
+    m_PackedPrefix.clear();
+    m_PackedSuffix.clear();
+
+    vtkImageData* image = this->m_TrackedFrame.GetImageData()->GetImage();
+    if (this->m_MessageHeader.m_ImageDataSizeInBytes > 0 && (image == NULL || image->GetScalarPointer() == NULL))
+    {
+      LOG_ERROR("Failed to pack Plus TrackedFrame message: image data is not set");
+      return 0;
+    }
+
+    // Pack everything except the image with the standard OpenIGTLink packing code
+    this->m_PackImageInContent = false;
+    int packResult = this->Pack();
+    this->m_PackImageInContent = true;
+    if (packResult == 0)
+    {
+      LOG_ERROR("Failed to pack Plus TrackedFrame message");
+      return 0;
+    }
+
+    const unsigned char* packed = static_cast<const unsigned char*>(this->GetPackPointer());
+    size_t packedSize = static_cast<size_t>(this->GetPackSize());
+    size_t contentOffset = IGTL_HEADER_SIZE;
+    if (this->GetHeaderVersion() >= IGTL_HEADER_VERSION_2)
+    {
+      // The extended header starts with its own size
+      contentOffset += static_cast<size_t>((packed[IGTL_HEADER_SIZE] << 8) | packed[IGTL_HEADER_SIZE + 1]);
+    }
+    size_t imageOffset = contentOffset + this->m_MessageHeader.GetMessageHeaderSize() + this->m_MessageHeader.m_XmlDataSizeInBytes;
+    if (imageOffset > packedSize)
+    {
+      LOG_ERROR("Failed to pack Plus TrackedFrame message: unexpected packed message size");
+      return 0;
+    }
+
+    m_PackedPrefix.assign(packed, packed + imageOffset);
+    m_PackedSuffix.assign(packed + imageOffset, packed + packedSize);
+    size_t imageDataSize = this->m_MessageHeader.m_ImageDataSizeInBytes;
+
+    // CRC of the body is computed block by block, the image is read in place
+    igtl_uint64 crc = crc64(0, 0, 0LL);
+    crc = crc64(&m_PackedPrefix[IGTL_HEADER_SIZE], m_PackedPrefix.size() - IGTL_HEADER_SIZE, crc);
+    if (imageDataSize > 0)
+    {
+      crc = crc64(static_cast<unsigned char*>(image->GetScalarPointer()), imageDataSize, crc);
+    }
+    if (!m_PackedSuffix.empty())
+    {
+      crc = crc64(&m_PackedSuffix[0], m_PackedSuffix.size(), crc);
+    }
+
+    igtl_uint64 bodySize = m_PackedPrefix.size() - IGTL_HEADER_SIZE + imageDataSize + m_PackedSuffix.size();
+    WriteBigEndian(&m_PackedPrefix[HEADER_BODY_SIZE_OFFSET], sizeof(igtl_uint64), bodySize);
+    WriteBigEndian(&m_PackedPrefix[HEADER_CRC_OFFSET], sizeof(igtl_uint64), crc);
+
+    return 1;
+  }
+
+  //----------------------------------------------------------------------------
+  void PlusTrackedFrameMessage::GetSegments(std::vector<PlusScatterGatherImageMessage::Segment>& segments)
+  {
+    segments.clear();
+    if (m_PackedPrefix.empty())
+    {
+      if (this->GetPackSize() > 0)
+      {
+        PlusScatterGatherImageMessage::Segment packedMessage = { static_cast<const unsigned char*>(this->GetPackPointer()), static_cast<size_t>(this->GetPackSize()) };
+        segments.push_back(packedMessage);
+      }
+      return;
+    }
+    PlusScatterGatherImageMessage::Segment prefix = { &m_PackedPrefix[0], m_PackedPrefix.size() };
+    segments.push_back(prefix);
+    if (this->m_MessageHeader.m_ImageDataSizeInBytes > 0)
+    {
+      PlusScatterGatherImageMessage::Segment image = { static_cast<const unsigned char*>(this->m_TrackedFrame.GetImageData()->GetScalarPointer()), this->m_MessageHeader.m_ImageDataSizeInBytes };
+      segments.push_back(image);
+    }
+    if (!m_PackedSuffix.empty())
+    {
+      PlusScatterGatherImageMessage::Segment suffix = { &m_PackedSuffix[0], m_PackedSuffix.size() };
+      segments.push_back(suffix);
+    }
+  }
+
   //----------------------------------------------------------------------------
   int PlusTrackedFrameMessage::CalculateContentBufferSize()
   {
     return this->m_MessageHeader.GetMessageHeaderSize()
-           + this->m_MessageHeader.m_ImageDataSizeInBytes
+           + (this->m_PackImageInContent ? this->m_MessageHeader.m_ImageDataSizeInBytes : 0)
            + this->m_MessageHeader.m_XmlDataSizeInBytes;
   }
 
@@ -133,6 +472,12 @@ namespace igtl
   int PlusTrackedFrameMessage::PackContent()
   {
     AllocateBuffer();
+    if (this->m_PackImageInContent)
+    {
+      // The message is packed into a single buffer, segments of a previous PackSegments() are no longer valid
+      m_PackedPrefix.clear();
+      m_PackedSuffix.clear();
+    }
 
     // Copy header
     TrackedFrameHeader* header = (TrackedFrameHeader*)(this->m_Content);
@@ -147,14 +492,17 @@ namespace igtl
     header->m_ImageOrientation = this->m_MessageHeader.m_ImageOrientation;
     memcpy(header->m_EmbeddedImageTransform, this->m_MessageHeader.m_EmbeddedImageTransform, sizeof(igtl::Matrix4x4));
 
-    // Copy xml data
-    char* xmlData = (char*)(this->m_Content + header->GetMessageHeaderSize());
-    strncpy(xmlData, this->m_TrackedFrameXmlData.c_str(), this->m_TrackedFrameXmlData.size());
+    // Copy field data
+    char* fieldData = (char*)(this->m_Content + header->GetMessageHeaderSize());
+    memcpy(fieldData, this->m_TrackedFrameFieldData.c_str(), this->m_TrackedFrameFieldData.size());
     header->m_XmlDataSizeInBytes = this->m_MessageHeader.m_XmlDataSizeInBytes;
 
-    // Copy image data
-    void* imageData = (void*)(this->m_Content + header->GetMessageHeaderSize() + header->m_XmlDataSizeInBytes);
-    memcpy(imageData, this->m_TrackedFrame.GetImageData()->GetScalarPointer(), this->m_TrackedFrame.GetImageData()->GetFrameSizeInBytes());
+    // Copy image data, unless it is sent as a separate segment
+    if (this->m_PackImageInContent)
+    {
+      void* imageData = (void*)(this->m_Content + header->GetMessageHeaderSize() + header->m_XmlDataSizeInBytes);
+      memcpy(imageData, this->m_TrackedFrame.GetImageData()->GetScalarPointer(), this->m_TrackedFrame.GetImageData()->GetFrameSizeInBytes());
+    }
 
     // Set timestamp
     igtl::TimeStamp::Pointer timestamp = igtl::TimeStamp::New();
@@ -187,13 +535,26 @@ namespace igtl
     this->m_MessageHeader.m_ImageOrientation = header->m_ImageOrientation;
     memcpy(this->m_MessageHeader.m_EmbeddedImageTransform, header->m_EmbeddedImageTransform, sizeof(igtl::Matrix4x4));
 
-    // Copy xml data
-    char* xmlData = (char*)(this->m_Content + header->GetMessageHeaderSize());
-    this->m_TrackedFrameXmlData.assign(xmlData, header->m_XmlDataSizeInBytes);
-    if (this->m_TrackedFrame.SetTrackedFrameFromXmlData(this->m_TrackedFrameXmlData) != PLUS_SUCCESS)
+    // Copy field data, the encoding is detected from the content
+    const unsigned char* fieldData = this->m_Content + header->GetMessageHeaderSize();
+    if (header->m_XmlDataSizeInBytes >= BINARY_FIELDS_PREAMBLE_SIZE && memcmp(fieldData, BINARY_FIELDS_MAGIC, sizeof(BINARY_FIELDS_MAGIC)) == 0)
     {
-      LOG_ERROR("Failed to set tracked frame data from xml received in Plus TrackedFrame message");
-      return 0;
+      this->m_TrackedFrame = igsioTrackedFrame();
+      this->m_TrackedFrameFieldData.clear();
+      if (this->DecodeBinaryFields(fieldData, header->m_XmlDataSizeInBytes) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to set tracked frame data from binary fields received in Plus TrackedFrame message");
+        return 0;
+      }
+    }
+    else
+    {
+      this->m_TrackedFrameFieldData.assign(reinterpret_cast<const char*>(fieldData), header->m_XmlDataSizeInBytes);
+      if (this->m_TrackedFrame.SetTrackedFrameFromXmlData(this->m_TrackedFrameFieldData) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to set tracked frame data from xml received in Plus TrackedFrame message");
+        return 0;
+      }
     }
 
     // Copy image data
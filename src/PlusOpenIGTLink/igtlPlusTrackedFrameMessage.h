@@ -14,11 +14,13 @@
 #include "igtl_win32header.h"
 #include "igtlMessageBase.h"
 #include "igtlObject.h"
+#include "igtlPlusScatterGatherImageMessage.h"
 #include "igtl_header.h"
 #include "igtl_util.h"
 #include "vtkMatrix4x4.h"
 #include "vtkSmartPointer.h"
 #include <string>
+#include <vector>
 
 namespace igtl
 {
@@ -28,6 +30,14 @@ namespace igtl
   /*!
     \class PlusTrackedFrameMessage
     \brief IGTL message helper class for tracked frame messages
+
+    The frame fields and transforms are sent either as XML (fields version 0, understood by all receivers)
+    or as a binary typed key/value table (fields version 1 and above), where transforms are sent as raw floats.
+    The binary section starts with a magic string that can never start an XML document, so the receiver
+    detects the encoding from the content and does not need to know which version the sender used.
+
+    PackSegments() packs the message without copying the image into the message buffer; the packed message
+    is then available as memory blocks, the same way as for igtl::PlusScatterGatherImageMessage.
     \ingroup PlusLibOpenIGTLink
   */
   class vtkPlusOpenIGTLinkExport PlusTrackedFrameMessage: public MessageBase
@@ -36,6 +46,14 @@ namespace igtl
     igtlTypeMacro(igtl::PlusTrackedFrameMessage, igtl::MessageBase);
     igtlNewMacro(igtl::PlusTrackedFrameMessage);
 
+    /*! Encoding of the frame fields and transforms */
+    enum FieldsVersion
+    {
+      FIELDS_VERSION_XML = 0,
+      FIELDS_VERSION_BINARY = 1,
+      FIELDS_VERSION_LATEST = FIELDS_VERSION_BINARY
+    };
+
   public:
     /*! Override clone so that we use the plus igtl factory */
     virtual igtl::MessageBase::Pointer Clone();
@@ -52,6 +70,20 @@ namespace igtl
     /*! Get the embedded transform of the underlying image */
     vtkSmartPointer<vtkMatrix4x4> GetEmbeddedImageTransform();
 
+    /*! Set the encoding of the frame fields (see FieldsVersion). Must be called before SetTrackedFrame. Default is FIELDS_VERSION_XML. */
+    void SetFieldsVersion(int version);
+    int GetFieldsVersion() const;
+
+    /*!
+    Pack the message without copying the image into the message buffer, and compute the header fields (body size, CRC)
+    of the full message. The image of the tracked frame that is stored in the message is referenced by the packed segments.
+    Returns 1 on success, 0 on failure (same convention as Pack()).
+    */
+    int PackSegments();
+
+    /*! Get the memory blocks of the packed message in wire order. If the message was packed with Pack() then it is a single block. */
+    void GetSegments(std::vector<PlusScatterGatherImageMessage::Segment>& segments);
+
   protected:
     class TrackedFrameHeader
     {
@@ -122,8 +154,23 @@ namespace igtl
     PlusTrackedFrameMessage();
     ~PlusTrackedFrameMessage();
 
+    /*! Encode the frame fields and the requested transforms into m_TrackedFrameFieldData as a binary field section */
+    PlusStatus EncodeBinaryFields(const std::vector<igsioTransformName>& requestedTransforms);
+
+    /*! Decode a binary field section into m_TrackedFrame */
+    PlusStatus DecodeBinaryFields(const unsigned char* data, size_t size);
+
     igsioTrackedFrame m_TrackedFrame;
-    std::string m_TrackedFrameXmlData;
+    /*! Frame fields and transforms in XML or binary encoding */
+    std::string m_TrackedFrameFieldData;
+    int m_FieldsVersion;
+
+    /*! If false then PackContent() leaves the image out of the content, it is sent as a separate segment */
+    bool m_PackImageInContent;
+    /*! Packed header, extended header, tracked frame header and fields, with the body size and CRC of the full message */
+    std::vector<unsigned char> m_PackedPrefix;
+    /*! Packed meta data header and meta data that follows the image */
+    std::vector<unsigned char> m_PackedSuffix;
 
     TrackedFrameHeader m_MessageHeader;
   };
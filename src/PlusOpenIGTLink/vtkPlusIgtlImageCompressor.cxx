@@ -0,0 +1,394 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusIgtlImageCompressor.h"
+
+// VTK includes
+#include <vtkImageData.h>
+#include <vtkObjectFactory.h>
+
+// zlib includes
+#ifdef PLUS_USE_SYSTEM_ZLIB
+  #include <zlib.h>
+#else
+  #include <vtk_zlib.h>
+#endif
+
+// STL includes
+#include <algorithm>
+#include <atomic>
+#include <ctime>
+#include <limits>
+
+namespace
+{
+  // Chunks smaller than this are not worth a separate thread
+  const size_t MIN_CHUNK_SIZE_BYTES = 256 * 1024;
+  // Upper limit for the number of chunks accepted in a received message
+  const unsigned int MAX_NUMBER_OF_CHUNKS = 256;
+
+  // Stream identifiers are unique within the process and unlikely to repeat after a restart
+  std::atomic<unsigned int> NextStreamId(static_cast<unsigned int>(time(NULL)));
+
+  //----------------------------------------------------------------------------
+  size_t GetChunkStart(size_t frameSizeInBytes, unsigned int numberOfChunks, unsigned int chunkIndex)
+  {
+    return static_cast<size_t>((static_cast<unsigned long long>(frameSizeInBytes) * chunkIndex) / numberOfChunks);
+  }
+}
+
+//----------------------------------------------------------------------------
+struct vtkPlusIgtlImageCompressor::ChunkJob
+{
+  ChunkJob()
+    : Compress(true)
+    , CompressionLevel(Z_BEST_SPEED)
+    , Data(NULL)
+    , Reference(NULL)
+    , Residual(NULL)
+    , Size(0)
+    , Chunk(NULL)
+    , Success(false)
+  {
+  }
+
+  bool Compress;
+  int CompressionLevel;
+  /*! Uncompressed pixels: input of compression, output of decompression */
+  unsigned char* Data;
+  /*! Same range of the reference frame if the delta predictor is used, NULL otherwise */
+  const unsigned char* Reference;
+  /*! Buffer for the prediction residual (compression with predictor only) */
+  unsigned char* Residual;
+  size_t Size;
+  /*! Compressed chunk: output of compression, input of decompression */
+  std::vector<unsigned char>* Chunk;
+  bool Success;
+};
+
+vtkStandardNewMacro(vtkPlusIgtlImageCompressor);
+
+//----------------------------------------------------------------------------
+vtkPlusIgtlImageCompressor::vtkPlusIgtlImageCompressor()
+  : Codec(igtl::PlusCompressedImageMessage::CODEC_ZLIB)
+  , Predictor(igtl::PlusCompressedImageMessage::PREDICTOR_NONE)
+  , KeyFrameInterval(30)
+  , CompressionLevel(Z_BEST_SPEED)
+  , NumberOfThreads(0)
+  , StreamId(NextStreamId++)
+  , FrameIndex(0)
+  , FramesSinceKeyFrame(0)
+  , KeyFrameRequested(true)
+  , WaitingForKeyFrame(false)
+  , PreviousFrameStreamId(0)
+  , PreviousFrameScalarType(VTK_VOID)
+  , PreviousFrameNumberOfComponents(0)
+  , Threader(vtkSmartPointer<vtkMultiThreader>::New())
+{
+  this->PreviousFrameDimensions[0] = this->PreviousFrameDimensions[1] = this->PreviousFrameDimensions[2] = 0;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusIgtlImageCompressor::~vtkPlusIgtlImageCompressor()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusIgtlImageCompressor::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Codec: " << this->Codec << std::endl;
+  os << indent << "Predictor: " << (this->Predictor == igtl::PlusCompressedImageMessage::PREDICTOR_DELTA ? "DELTA" : "NONE") << std::endl;
+  os << indent << "KeyFrameInterval: " << this->KeyFrameInterval << std::endl;
+  os << indent << "CompressionLevel: " << this->CompressionLevel << std::endl;
+  os << indent << "NumberOfThreads: " << this->NumberOfThreads << std::endl;
+  os << indent << "FrameIndex: " << this->FrameIndex << std::endl;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusIgtlImageCompressor::GetCodecFromString(const std::string& name, int& codec)
+{
+  if (STRCASECMP(name.c_str(), "ZLIB") == 0)
+  {
+    codec = igtl::PlusCompressedImageMessage::CODEC_ZLIB;
+    return true;
+  }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusIgtlImageCompressor::GetPredictorFromString(const std::string& name, int& predictor)
+{
+  if (name.empty() || STRCASECMP(name.c_str(), "NONE") == 0)
+  {
+    predictor = igtl::PlusCompressedImageMessage::PREDICTOR_NONE;
+    return true;
+  }
+  if (STRCASECMP(name.c_str(), "DELTA") == 0)
+  {
+    predictor = igtl::PlusCompressedImageMessage::PREDICTOR_DELTA;
+    return true;
+  }
+  return false;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusIgtlImageCompressor::RequestKeyFrame()
+{
+  this->KeyFrameRequested = true;
+}
+
+//----------------------------------------------------------------------------
+unsigned int vtkPlusIgtlImageCompressor::GetNumberOfChunks(size_t frameSizeInBytes) const
+{
+  int numberOfThreads = this->NumberOfThreads > 0 ? this->NumberOfThreads : vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+  size_t numberOfChunks = std::min<size_t>(std::max(numberOfThreads, 1), frameSizeInBytes / MIN_CHUNK_SIZE_BYTES);
+  return static_cast<unsigned int>(std::max<size_t>(std::min<size_t>(numberOfChunks, MAX_NUMBER_OF_CHUNKS), 1));
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlImageCompressor::Compress(vtkImageData* image, igtl::PlusCompressedImageMessage* message)
+{
+  if (image == NULL || image->GetScalarPointer() == NULL || message == NULL)
+  {
+    LOG_ERROR("Unable to compress image - image or message is invalid");
+    return PLUS_FAIL;
+  }
+  if (this->Codec != igtl::PlusCompressedImageMessage::CODEC_ZLIB)
+  {
+    LOG_ERROR("Unable to compress image - unsupported codec: " << this->Codec);
+    return PLUS_FAIL;
+  }
+
+  int dimensions[3] = { 0, 0, 0 };
+  image->GetDimensions(dimensions);
+  for (int i = 0; i < 3; ++i)
+  {
+    if (dimensions[i] > static_cast<int>(std::numeric_limits<igtl_uint16>::max()))
+    {
+      LOG_ERROR("Unable to compress image - frame size element is too large to be sent over OpenIGTLink");
+      return PLUS_FAIL;
+    }
+  }
+  size_t frameSizeInBytes = static_cast<size_t>(dimensions[0]) * dimensions[1] * dimensions[2] * image->GetNumberOfScalarComponents() * image->GetScalarSize();
+  if (frameSizeInBytes > std::numeric_limits<igtl_uint32>::max())
+  {
+    LOG_ERROR("Unable to compress image - image is too large");
+    return PLUS_FAIL;
+  }
+  unsigned char* framePixels = static_cast<unsigned char*>(image->GetScalarPointer());
+
+  bool predicted = this->Predictor == igtl::PlusCompressedImageMessage::PREDICTOR_DELTA
+                   && !this->KeyFrameRequested
+                   && this->FramesSinceKeyFrame + 1 < this->KeyFrameInterval
+                   && this->PreviousFrameStreamId == this->StreamId
+                   && this->PreviousFrame.size() == frameSizeInBytes
+                   && this->PreviousFrameScalarType == image->GetScalarType()
+                   && this->PreviousFrameNumberOfComponents == image->GetNumberOfScalarComponents()
+                   && std::equal(dimensions, dimensions + 3, this->PreviousFrameDimensions);
+
+  igtl::PlusCompressedImageMessage::CompressedImageHeader& header = message->GetCompressedImageHeader();
+  header.m_ScalarType = PlusCommon::GetIGTLScalarPixelTypeFromVTK(image->GetScalarType());
+  header.m_NumberOfComponents = image->GetNumberOfScalarComponents();
+  header.m_FrameSize[0] = dimensions[0];
+  header.m_FrameSize[1] = dimensions[1];
+  header.m_FrameSize[2] = dimensions[2];
+  header.m_Codec = this->Codec;
+  header.m_Predictor = this->Predictor;
+  header.m_KeyFrame = predicted ? 0 : 1;
+  header.m_StreamId = this->StreamId;
+  header.m_ReferenceFrameIndex = predicted ? this->FrameIndex : 0;
+  header.m_FrameIndex = ++this->FrameIndex;
+  header.m_UncompressedSizeInBytes = static_cast<igtl_uint32>(frameSizeInBytes);
+
+  unsigned int numberOfChunks = this->GetNumberOfChunks(frameSizeInBytes);
+  std::vector<std::vector<unsigned char> >& chunks = message->GetChunks();
+  chunks.resize(numberOfChunks);
+
+  std::vector<unsigned char> residual(predicted ? frameSizeInBytes : 0);
+  std::vector<ChunkJob> jobs(numberOfChunks);
+  for (unsigned int i = 0; i < numberOfChunks; ++i)
+  {
+    size_t chunkStart = GetChunkStart(frameSizeInBytes, numberOfChunks, i);
+    jobs[i].Compress = true;
+    jobs[i].CompressionLevel = this->CompressionLevel;
+    jobs[i].Data = framePixels + chunkStart;
+    jobs[i].Size = GetChunkStart(frameSizeInBytes, numberOfChunks, i + 1) - chunkStart;
+    jobs[i].Chunk = &chunks[i];
+    if (predicted)
+    {
+      jobs[i].Reference = &this->PreviousFrame[0] + chunkStart;
+      jobs[i].Residual = &residual[0] + chunkStart;
+    }
+  }
+  this->ExecuteChunkJobs(jobs);
+  for (unsigned int i = 0; i < numberOfChunks; ++i)
+  {
+    if (!jobs[i].Success)
+    {
+      LOG_ERROR("Unable to compress image - compression of chunk " << i << " failed");
+      // The reference frame of the client is unknown now
+      this->KeyFrameRequested = true;
+      return PLUS_FAIL;
+    }
+  }
+
+  this->FramesSinceKeyFrame = predicted ? this->FramesSinceKeyFrame + 1 : 0;
+  this->KeyFrameRequested = false;
+  if (this->Predictor == igtl::PlusCompressedImageMessage::PREDICTOR_DELTA)
+  {
+    this->PreviousFrame.assign(framePixels, framePixels + frameSizeInBytes);
+    this->PreviousFrameStreamId = this->StreamId;
+    this->PreviousFrameScalarType = image->GetScalarType();
+    this->PreviousFrameNumberOfComponents = image->GetNumberOfScalarComponents();
+    std::copy(dimensions, dimensions + 3, this->PreviousFrameDimensions);
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlImageCompressor::Decompress(igtl::PlusCompressedImageMessage* message, unsigned char* outputBuffer, size_t outputBufferSize)
+{
+  if (message == NULL || outputBuffer == NULL)
+  {
+    LOG_ERROR("Unable to decompress image - message or output buffer is invalid");
+    return PLUS_FAIL;
+  }
+
+  igtl::PlusCompressedImageMessage::CompressedImageHeader& header = message->GetCompressedImageHeader();
+  std::vector<std::vector<unsigned char> >& chunks = message->GetChunks();
+  size_t frameSizeInBytes = header.m_UncompressedSizeInBytes;
+  if (header.m_Codec != igtl::PlusCompressedImageMessage::CODEC_ZLIB)
+  {
+    LOG_ERROR("Unable to decompress image - unsupported codec: " << header.m_Codec);
+    return PLUS_FAIL;
+  }
+  if (header.m_Predictor != igtl::PlusCompressedImageMessage::PREDICTOR_NONE && header.m_Predictor != igtl::PlusCompressedImageMessage::PREDICTOR_DELTA)
+  {
+    LOG_ERROR("Unable to decompress image - unsupported predictor: " << header.m_Predictor);
+    return PLUS_FAIL;
+  }
+  if (frameSizeInBytes > outputBufferSize || chunks.empty() || chunks.size() > MAX_NUMBER_OF_CHUNKS || chunks.size() > std::max<size_t>(frameSizeInBytes, 1))
+  {
+    LOG_ERROR("Unable to decompress image - invalid frame size (" << frameSizeInBytes << " bytes) or number of chunks (" << chunks.size() << ")");
+    return PLUS_FAIL;
+  }
+
+  bool predicted = header.m_Predictor == igtl::PlusCompressedImageMessage::PREDICTOR_DELTA && header.m_KeyFrame == 0;
+  if (predicted)
+  {
+    if (this->PreviousFrameStreamId != header.m_StreamId || this->FrameIndex != header.m_ReferenceFrameIndex || this->PreviousFrame.size() != frameSizeInBytes)
+    {
+      if (!this->WaitingForKeyFrame)
+      {
+        LOG_DEBUG("Reference frame of compressed image is not available, skip frames until the next key frame");
+      }
+      this->WaitingForKeyFrame = true;
+      return PLUS_FAIL;
+    }
+  }
+
+  unsigned int numberOfChunks = static_cast<unsigned int>(chunks.size());
+  std::vector<ChunkJob> jobs(numberOfChunks);
+  for (unsigned int i = 0; i < numberOfChunks; ++i)
+  {
+    size_t chunkStart = GetChunkStart(frameSizeInBytes, numberOfChunks, i);
+    jobs[i].Compress = false;
+    jobs[i].Data = outputBuffer + chunkStart;
+    jobs[i].Size = GetChunkStart(frameSizeInBytes, numberOfChunks, i + 1) - chunkStart;
+    jobs[i].Chunk = &chunks[i];
+    if (predicted)
+    {
+      jobs[i].Reference = &this->PreviousFrame[0] + chunkStart;
+    }
+  }
+  this->ExecuteChunkJobs(jobs);
+  for (unsigned int i = 0; i < numberOfChunks; ++i)
+  {
+    if (!jobs[i].Success)
+    {
+      LOG_ERROR("Unable to decompress image - decompression of chunk " << i << " failed");
+      this->PreviousFrame.clear();
+      return PLUS_FAIL;
+    }
+  }
+
+  this->WaitingForKeyFrame = false;
+  this->FrameIndex = header.m_FrameIndex;
+  this->PreviousFrameStreamId = header.m_StreamId;
+  if (header.m_Predictor == igtl::PlusCompressedImageMessage::PREDICTOR_DELTA)
+  {
+    this->PreviousFrame.assign(outputBuffer, outputBuffer + frameSizeInBytes);
+  }
+  else
+  {
+    this->PreviousFrame.clear();
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusIgtlImageCompressor::ExecuteChunkJobs(std::vector<ChunkJob>& jobs)
+{
+  if (jobs.size() == 1)
+  {
+    vtkMultiThreader::ThreadInfo threadInfo = vtkMultiThreader::ThreadInfo();
+    threadInfo.ThreadID = 0;
+    threadInfo.NumberOfThreads = 1;
+    threadInfo.UserData = &jobs;
+    ChunkJobThread(&threadInfo);
+    return;
+  }
+
+  int numberOfThreads = this->NumberOfThreads > 0 ? this->NumberOfThreads : vtkMultiThreader::GetGlobalDefaultNumberOfThreads();
+  this->Threader->SetNumberOfThreads(std::max(1, std::min(numberOfThreads, static_cast<int>(jobs.size()))));
+  this->Threader->SetSingleMethod((vtkThreadFunctionType)&ChunkJobThread, &jobs);
+  this->Threader->SingleMethodExecute();
+}
+
+//----------------------------------------------------------------------------
+void* vtkPlusIgtlImageCompressor::ChunkJobThread(vtkMultiThreader::ThreadInfo* data)
+{
+  std::vector<ChunkJob>* jobs = static_cast<std::vector<ChunkJob>*>(data->UserData);
+  for (size_t jobIndex = data->ThreadID; jobIndex < jobs->size(); jobIndex += data->NumberOfThreads)
+  {
+    ChunkJob& job = (*jobs)[jobIndex];
+    if (job.Compress)
+    {
+      const unsigned char* source = job.Data;
+      if (job.Reference != NULL)
+      {
+        for (size_t i = 0; i < job.Size; ++i)
+        {
+          job.Residual[i] = static_cast<unsigned char>(job.Data[i] - job.Reference[i]);
+        }
+        source = job.Residual;
+      }
+      uLongf compressedSize = compressBound(static_cast<uLong>(job.Size));
+      job.Chunk->resize(compressedSize);
+      job.Success = compress2(&(*job.Chunk)[0], &compressedSize, source, static_cast<uLong>(job.Size), job.CompressionLevel) == Z_OK;
+      job.Chunk->resize(job.Success ? compressedSize : 0);
+    }
+    else
+    {
+      uLongf decompressedSize = static_cast<uLongf>(job.Size);
+      const unsigned char* source = job.Chunk->empty() ? NULL : &(*job.Chunk)[0];
+      job.Success = uncompress(job.Data, &decompressedSize, source, static_cast<uLong>(job.Chunk->size())) == Z_OK && decompressedSize == job.Size;
+      if (job.Success && job.Reference != NULL)
+      {
+        for (size_t i = 0; i < job.Size; ++i)
+        {
+          job.Data[i] = static_cast<unsigned char>(job.Data[i] + job.Reference[i]);
+        }
+      }
+    }
+  }
+  return NULL;
+}
@@ -0,0 +1,133 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusIgtlImageCompressor_h
+#define __vtkPlusIgtlImageCompressor_h
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusOpenIGTLinkExport.h"
+#include "igtlPlusCompressedImageMessage.h"
+
+// VTK includes
+#include <vtkMultiThreader.h>
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// STL includes
+#include <string>
+#include <vector>
+
+class vtkImageData;
+
+/*!
+\class vtkPlusIgtlImageCompressor
+\brief Lossless compression of image pixel data for igtl::PlusCompressedImageMessage
+
+The pixel data is optionally transformed by a predictor (difference to the previous frame of the stream, which
+turns the static parts of ultrasound and video images into long runs of zeros) and then split into chunks
+that are compressed in parallel. Decompression reverses the steps.
+
+One instance keeps the state of one stream: the server uses one per client image stream for compression,
+the client uses one per received stream for decompression. An instance must not be used from multiple threads at the same time.
+
+\ingroup PlusLibOpenIGTLink
+*/
+class vtkPlusOpenIGTLinkExport vtkPlusIgtlImageCompressor : public vtkObject
+{
+public:
+  static vtkPlusIgtlImageCompressor* New();
+  vtkTypeMacro(vtkPlusIgtlImageCompressor, vtkObject);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  /*! Get codec (igtl::PlusCompressedImageMessage::CodecType) from its name (ZLIB). Returns false if the name is not recognized. */
+  static bool GetCodecFromString(const std::string& name, int& codec);
+  /*! Get predictor (igtl::PlusCompressedImageMessage::PredictorType) from its name (NONE, DELTA). Returns false if the name is not recognized. */
+  static bool GetPredictorFromString(const std::string& name, int& predictor);
+
+  /*! Compression method, igtl::PlusCompressedImageMessage::CodecType */
+  vtkSetMacro(Codec, int);
+  vtkGetMacro(Codec, int);
+
+  /*! Prediction applied before compression, igtl::PlusCompressedImageMessage::PredictorType */
+  vtkSetMacro(Predictor, int);
+  vtkGetMacro(Predictor, int);
+
+  /*!
+  Maximum number of frames between two key frames when a predictor is used.
+  Key frames allow clients that connect late or miss a frame to resume decoding.
+  */
+  vtkSetMacro(KeyFrameInterval, int);
+  vtkGetMacro(KeyFrameInterval, int);
+
+  /*! zlib compression level (1: fastest, 9: smallest) */
+  vtkSetMacro(CompressionLevel, int);
+  vtkGetMacro(CompressionLevel, int);
+
+  /*! Maximum number of threads (and chunks) used for compressing a frame. 0 means the number of processor cores. */
+  vtkSetMacro(NumberOfThreads, int);
+  vtkGetMacro(NumberOfThreads, int);
+
+  /*! True if predicted frames are received but the reference frame is missing, decoding resumes at the next key frame */
+  vtkGetMacro(WaitingForKeyFrame, bool);
+
+  /*!
+  Compress the pixels of the image into the chunks of the message and set the pixel properties and compression fields
+  of the message header. Spacing and orientation are not set.
+  */
+  PlusStatus Compress(vtkImageData* image, igtl::PlusCompressedImageMessage* message);
+
+  /*!
+  Decompress the chunks of an unpacked message into outputBuffer, which must be at least as large as the uncompressed size in the message header.
+  Returns PLUS_FAIL if the message cannot be decoded. If the reference frame of a predicted frame is not available then WaitingForKeyFrame is set.
+  */
+  PlusStatus Decompress(igtl::PlusCompressedImageMessage* message, unsigned char* outputBuffer, size_t outputBufferSize);
+
+  /*! Make the next compressed frame a key frame */
+  void RequestKeyFrame();
+
+protected:
+  vtkPlusIgtlImageCompressor();
+  virtual ~vtkPlusIgtlImageCompressor();
+
+  /*! Number of chunks that a frame of the given size is split into */
+  unsigned int GetNumberOfChunks(size_t frameSizeInBytes) const;
+
+  /*! Run the job of each chunk, in parallel if there are multiple chunks */
+  struct ChunkJob;
+  void ExecuteChunkJobs(std::vector<ChunkJob>& jobs);
+  static void* ChunkJobThread(vtkMultiThreader::ThreadInfo* data);
+
+  int Codec;
+  int Predictor;
+  int KeyFrameInterval;
+  int CompressionLevel;
+  int NumberOfThreads;
+
+  /*! Identifies this stream in compressed frames, so that a decoder never uses a reference frame of another stream */
+  unsigned int StreamId;
+  /*! Index of the last compressed or decompressed frame */
+  unsigned int FrameIndex;
+  int FramesSinceKeyFrame;
+  bool KeyFrameRequested;
+  bool WaitingForKeyFrame;
+
+  /*! Last compressed or decompressed frame, the reference of the next predicted frame */
+  std::vector<unsigned char> PreviousFrame;
+  /*! Properties of PreviousFrame, a predicted frame can only be compressed if they did not change */
+  unsigned int PreviousFrameStreamId;
+  int PreviousFrameScalarType;
+  int PreviousFrameNumberOfComponents;
+  int PreviousFrameDimensions[3];
+
+  vtkSmartPointer<vtkMultiThreader> Threader;
+
+private:
+  vtkPlusIgtlImageCompressor(const vtkPlusIgtlImageCompressor&);
+  void operator=(const vtkPlusIgtlImageCompressor&);
+};
+
+#endif
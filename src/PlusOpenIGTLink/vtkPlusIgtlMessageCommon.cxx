@@ -14,15 +14,33 @@ See License.txt for details.
 #include <vtkIGSIOFrameConverter.h>
 
 // VTK includes
+#include <vtkDataArray.h>
+#include <vtkExtractVOI.h>
 #include <vtkImageData.h>
+#include <vtkImageShiftScale.h>
+#include <vtkImageShrink3D.h>
 #include <vtkMatrix4x4.h>
 #include <vtkObjectFactory.h>
 #include <vtkTransform.h>
 #include <vtkNew.h>
+#include <vtkUnsignedCharArray.h>
+
+// STL includes
+#include <algorithm>
+#include <iterator>
 
 // OpenIGTLink includes
 #include <igtl_tdata.h>
 
+// OS includes
+#ifndef _WIN32
+  #include <errno.h>
+  #include <limits.h>
+  #include <poll.h>
+  #include <sys/socket.h>
+  #include <sys/uio.h>
+#endif
+
 // OpenIGTLinkIO includes
 #include <igtlioImageConverter.h>
 #include <igtlioPolyDataConverter.h>
@@ -30,7 +48,35 @@ See License.txt for details.
 #include <igtlioConverterUtilities.h>
 #if defined(OpenIGTLink_ENABLE_VIDEOSTREAMING)
   #include <igtlioVideoConverter.h>
+  #include <vtkStreamingVolumeFrame.h>
+#endif
+
+//----------------------------------------------------------------------------
+
+namespace
+{
+#ifndef _WIN32
+  // igtl::Socket does not provide access to its descriptor, which is needed for gather writes.
+  // The member pointer is formed through a derived class, no instance of the derived class is ever created.
+  struct SocketDescriptorAccessor : public igtl::Socket
+  {
+    static int GetSocketDescriptor(igtl::Socket* socket)
+    {
+      return socket->*(&SocketDescriptorAccessor::m_SocketDescriptor);
+    }
+  };
+
+#ifdef MSG_NOSIGNAL
+  const int GATHER_WRITE_FLAGS = MSG_NOSIGNAL;
+#else
+  const int GATHER_WRITE_FLAGS = 0;
 #endif
+  const int NON_BLOCKING_WRITE_FLAGS = GATHER_WRITE_FLAGS | MSG_DONTWAIT;
+#endif
+
+  // Blocks are copied into one buffer for a single write only up to this size, larger data is sent block by block
+  const size_t MAX_JOINED_WRITE_SIZE = 64 * 1024;
+}
 
 //----------------------------------------------------------------------------
 
@@ -108,7 +154,12 @@ PlusStatus vtkPlusIgtlMessageCommon::PackTrackedFrameMessage(igtl::PlusTrackedFr
     return status;
   }
 
-  trackedFrameMessage->Pack();
+  // The image is not copied into the message, it is sent from the tracked frame that the message holds
+  if (trackedFrameMessage->PackSegments() == 0)
+  {
+    LOG_ERROR("Failed to pack tracked frame message");
+    return PLUS_FAIL;
+  }
 
   return status;
 }
@@ -142,6 +193,21 @@ PlusStatus vtkPlusIgtlMessageCommon::UnpackTrackedFrameMessage(igtl::MessageHead
 
   socket->Receive(trackedFrameMsg->GetBufferBodyPointer(), trackedFrameMsg->GetBufferBodySize());
 
+  return UnpackTrackedFrameMessage(trackedFrameMsg, trackedFrame, embeddedTransformName, crccheck);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlMessageCommon::UnpackTrackedFrameMessage(igtl::PlusTrackedFrameMessage::Pointer trackedFrameMsg,
+    igsioTrackedFrame& trackedFrame,
+    const igsioTransformName& embeddedTransformName,
+    int crccheck)
+{
+  if (trackedFrameMsg.IsNull())
+  {
+    LOG_ERROR("Unable to unpack tracked frame message - message is NULL!");
+    return PLUS_FAIL;
+  }
+
   int c = trackedFrameMsg->Unpack(crccheck);
   if (!(c & igtl::MessageHeader::UNPACK_BODY))
   {
@@ -237,8 +303,43 @@ PlusStatus vtkPlusIgtlMessageCommon::PackImageMessage(igtl::ImageMessage::Pointe
     converter = vtkSmartPointer<vtkIGSIOFrameConverter>::New();
   }
 
-  double timestamp = trackedFrame.GetTimestamp();
   vtkSmartPointer<vtkImageData> frameImage = converter->GetUncompressedImage(trackedFrame.GetImageData());
+  if (frameImage == NULL)
+  {
+    LOG_ERROR("Failed to pack image message - unable to get uncompressed image");
+    return PLUS_FAIL;
+  }
+
+  if (dynamic_cast<igtl::PlusScatterGatherImageMessage*>(imageMessage.GetPointer()) != NULL && frameImage.GetPointer() != trackedFrame.GetImageData()->GetImage())
+  {
+    // The image belongs to the converter and it is overwritten by the next frame, while the message may still be waiting to be sent
+    vtkSmartPointer<vtkImageData> frameImageCopy = vtkSmartPointer<vtkImageData>::New();
+    frameImageCopy->DeepCopy(frameImage);
+    frameImage = frameImageCopy;
+  }
+
+  return PackImageMessage(imageMessage, trackedFrame, frameImage, matrix);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlMessageCommon::PackImageMessage(igtl::ImageMessage::Pointer imageMessage,
+    igsioTrackedFrame& trackedFrame,
+    vtkImageData* frameImage,
+    const vtkMatrix4x4& matrix)
+{
+  if (imageMessage.IsNull())
+  {
+    LOG_ERROR("Failed to pack image message - input image message is NULL");
+    return PLUS_FAIL;
+  }
+
+  if (frameImage == NULL || frameImage->GetScalarPointer() == NULL)
+  {
+    LOG_WARNING("Unable to send image message - image is empty!");
+    return PLUS_FAIL;
+  }
+
+  double timestamp = trackedFrame.GetTimestamp();
 
   igtl::TimeStamp::Pointer igtlFrameTime = igtl::TimeStamp::New();
   igtlFrameTime->SetTime(timestamp);
@@ -248,13 +349,8 @@ PlusStatus vtkPlusIgtlMessageCommon::PackImageMessage(igtl::ImageMessage::Pointe
   int subOffset[3] = { 0 };
   double imageSpacingMm[3] = { 0 };
   double imageOriginMm[3] = { 0 };
-  int scalarType = PlusCommon::GetIGTLScalarPixelTypeFromVTK(trackedFrame.GetImageData()->GetVTKScalarPixelType());
-  unsigned int numScalarComponents(1);
-  if (trackedFrame.GetImageData()->GetNumberOfScalarComponents(numScalarComponents) == PLUS_FAIL)
-  {
-    LOG_ERROR("Unable to retrieve number of scalar components.");
-    return PLUS_FAIL;
-  }
+  int scalarType = PlusCommon::GetIGTLScalarPixelTypeFromVTK(frameImage->GetScalarType());
+  unsigned int numScalarComponents = static_cast<unsigned int>(frameImage->GetNumberOfScalarComponents());
 
   frameImage->GetDimensions(imageSizePixels);
   frameImage->GetSpacing(imageSpacingMm);
@@ -273,12 +369,21 @@ PlusStatus vtkPlusIgtlMessageCommon::PackImageMessage(igtl::ImageMessage::Pointe
   imageMessage->SetScalarType(scalarType);
   imageMessage->SetEndian(igtl_is_little_endian() ? igtl::ImageMessage::ENDIAN_LITTLE : igtl::ImageMessage::ENDIAN_BIG);
   imageMessage->SetSubVolume(subSizePixels, subOffset);
-  imageMessage->AllocateScalars();
 
-  unsigned char* igtlImagePointer = (unsigned char*)(imageMessage->GetScalarPointer());
-  unsigned char* vtkImagePointer = (unsigned char*)(frameImage->GetScalarPointer());
+  igtl::PlusScatterGatherImageMessage::Pointer scatterGatherMessage = dynamic_cast<igtl::PlusScatterGatherImageMessage*>(imageMessage.GetPointer());
+  if (scatterGatherMessage.IsNotNull())
+  {
+    scatterGatherMessage->SetPixelData(frameImage);
+  }
+  else
+  {
+    imageMessage->AllocateScalars();
 
-  memcpy(igtlImagePointer, vtkImagePointer, imageMessage->GetImageSize());
+    unsigned char* igtlImagePointer = (unsigned char*)(imageMessage->GetScalarPointer());
+    unsigned char* vtkImagePointer = (unsigned char*)(frameImage->GetScalarPointer());
+
+    memcpy(igtlImagePointer, vtkImagePointer, imageMessage->GetImageSize());
+  }
 
   // Convert VTK transform to IGTL transform.
   if (igtlioImageConverter::VTKTransformToIGTLImage(matrix, imageSizePixels, imageSpacingMm, imageOriginMm, imageMessage) != 1)
@@ -288,11 +393,386 @@ PlusStatus vtkPlusIgtlMessageCommon::PackImageMessage(igtl::ImageMessage::Pointe
   }
 
   imageMessage->SetTimeStamp(igtlFrameTime);
-  imageMessage->Pack();
+  if (scatterGatherMessage.IsNotNull())
+  {
+    if (scatterGatherMessage->PackSegments() == 0)
+    {
+      LOG_ERROR("Failed to pack image message - unable to pack scatter-gather message");
+      return PLUS_FAIL;
+    }
+  }
+  else
+  {
+    imageMessage->Pack();
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlMessageCommon::ProcessImageForStream(vtkImageData* inputImage, const PlusIgtlClientInfo::ImageStream& imageStream, vtkImageData* outputImage)
+{
+  if (inputImage == NULL || outputImage == NULL)
+  {
+    LOG_ERROR("Failed to process image for image stream " << imageStream.Name << " - input or output image is NULL");
+    return PLUS_FAIL;
+  }
+
+  vtkSmartPointer<vtkImageData> image = inputImage;
+
+  if (imageStream.ClipRectangleSize[0] > 0 && imageStream.ClipRectangleSize[1] > 0)
+  {
+    int inputExtent[6] = { 0 };
+    image->GetExtent(inputExtent);
+    int clipExtent[6] = { 0 };
+    std::copy(std::begin(inputExtent), std::end(inputExtent), std::begin(clipExtent));
+    for (int i = 0; i < 2; ++i)
+    {
+      clipExtent[2 * i] = inputExtent[2 * i] + imageStream.ClipRectangleOrigin[i];
+      clipExtent[2 * i + 1] = clipExtent[2 * i] + imageStream.ClipRectangleSize[i] - 1;
+      if (clipExtent[2 * i + 1] > inputExtent[2 * i + 1])
+      {
+        LOG_ERROR("Failed to process image for image stream " << imageStream.Name << " - clip rectangle is outside of the image");
+        return PLUS_FAIL;
+      }
+    }
+    vtkSmartPointer<vtkExtractVOI> extractVoi = vtkSmartPointer<vtkExtractVOI>::New();
+    extractVoi->SetInputData(image);
+    extractVoi->SetVOI(clipExtent);
+    extractVoi->Update();
+    image = extractVoi->GetOutput();
+  }
+
+  if (imageStream.DownsamplingFactor > 1)
+  {
+    vtkSmartPointer<vtkImageShrink3D> shrink = vtkSmartPointer<vtkImageShrink3D>::New();
+    shrink->SetInputData(image);
+    shrink->SetShrinkFactors(imageStream.DownsamplingFactor, imageStream.DownsamplingFactor, 1);
+    shrink->AveragingOn();
+    shrink->Update();
+    image = shrink->GetOutput();
+  }
+
+  if (imageStream.ScalarType != VTK_VOID && imageStream.ScalarType != image->GetScalarType())
+  {
+    // Integer pixels are scaled to fit a narrower integer type, all other conversions are clamped to the output range
+    double scale = 1.0;
+    bool integerConversion = (image->GetScalarType() != VTK_FLOAT && image->GetScalarType() != VTK_DOUBLE && imageStream.ScalarType != VTK_FLOAT);
+    if (integerConversion && vtkDataArray::GetDataTypeMax(imageStream.ScalarType) < image->GetScalarTypeMax())
+    {
+      scale = vtkDataArray::GetDataTypeMax(imageStream.ScalarType) / image->GetScalarTypeMax();
+    }
+    vtkSmartPointer<vtkImageShiftScale> shiftScale = vtkSmartPointer<vtkImageShiftScale>::New();
+    shiftScale->SetInputData(image);
+    shiftScale->SetOutputScalarType(imageStream.ScalarType);
+    shiftScale->SetScale(scale);
+    shiftScale->ClampOverflowOn();
+    shiftScale->Update();
+    image = shiftScale->GetOutput();
+  }
+
+  // The packed image starts at the origin of the extent, the offset of the region is moved into the image origin
+  int extent[6] = { 0 };
+  double spacing[3] = { 0 };
+  double origin[3] = { 0 };
+  image->GetExtent(extent);
+  image->GetSpacing(spacing);
+  image->GetOrigin(origin);
+  outputImage->ShallowCopy(image);
+  for (int i = 0; i < 3; ++i)
+  {
+    origin[i] += extent[2 * i] * spacing[i];
+  }
+  outputImage->SetExtent(0, extent[1] - extent[0], 0, extent[3] - extent[2], 0, extent[5] - extent[4]);
+  outputImage->SetOrigin(origin);
 
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusIgtlMessageCommon::GetPackedMessageSegments(igtl::MessageBase* message, std::vector<igtl::PlusScatterGatherImageMessage::Segment>& segments)
+{
+  segments.clear();
+  if (message == NULL)
+  {
+    return;
+  }
+  igtl::PlusScatterGatherImageMessage* scatterGatherMessage = dynamic_cast<igtl::PlusScatterGatherImageMessage*>(message);
+  if (scatterGatherMessage != NULL)
+  {
+    scatterGatherMessage->GetSegments(segments);
+    return;
+  }
+  igtl::PlusTrackedFrameMessage* trackedFrameMessage = dynamic_cast<igtl::PlusTrackedFrameMessage*>(message);
+  if (trackedFrameMessage != NULL)
+  {
+    trackedFrameMessage->GetSegments(segments);
+    return;
+  }
+  igtl::PlusScatterGatherImageMessage::Segment segment = { static_cast<const unsigned char*>(message->GetPackPointer()), static_cast<size_t>(message->GetPackSize()) };
+  segments.push_back(segment);
+}
+
+//----------------------------------------------------------------------------
+size_t vtkPlusIgtlMessageCommon::GetPackedMessageSize(igtl::MessageBase* message)
+{
+  std::vector<igtl::PlusScatterGatherImageMessage::Segment> segments;
+  GetPackedMessageSegments(message, segments);
+  size_t size = 0;
+  for (std::vector<igtl::PlusScatterGatherImageMessage::Segment>::const_iterator segmentIt = segments.begin(); segmentIt != segments.end(); ++segmentIt)
+  {
+    size += segmentIt->Size;
+  }
+  return size;
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusIgtlMessageCommon::SendPackedMessage(igtl::Socket* socket, igtl::MessageBase* message)
+{
+  if (socket == NULL || message == NULL)
+  {
+    return 0;
+  }
+  if (dynamic_cast<igtl::PlusScatterGatherImageMessage*>(message) == NULL && dynamic_cast<igtl::PlusTrackedFrameMessage*>(message) == NULL)
+  {
+    return socket->Send(message->GetPackPointer(), message->GetPackSize());
+  }
+
+  std::vector<igtl::PlusScatterGatherImageMessage::Segment> segments;
+  GetPackedMessageSegments(message, segments);
+  if (segments.empty())
+  {
+    LOG_ERROR("Cannot send " << message->GetMessageType() << " message: the message is not packed");
+    return 0;
+  }
+  return SendSegments(socket, segments);
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusIgtlMessageCommon::SendPackedMessages(igtl::Socket* socket, const std::vector<igtl::MessageBase::Pointer>& messages)
+{
+  if (socket == NULL)
+  {
+    return 0;
+  }
+  std::vector<igtl::PlusScatterGatherImageMessage::Segment> segments;
+  std::vector<igtl::PlusScatterGatherImageMessage::Segment> messageSegments;
+  for (std::vector<igtl::MessageBase::Pointer>::const_iterator messageIt = messages.begin(); messageIt != messages.end(); ++messageIt)
+  {
+    if (messageIt->IsNull())
+    {
+      continue;
+    }
+    GetPackedMessageSegments(*messageIt, messageSegments);
+    segments.insert(segments.end(), messageSegments.begin(), messageSegments.end());
+  }
+  if (segments.empty())
+  {
+    return 1;
+  }
+  return SendSegments(socket, segments);
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusIgtlMessageCommon::SendSegments(igtl::Socket* socket, const std::vector<igtl::PlusScatterGatherImageMessage::Segment>& segments)
+{
+#ifndef _WIN32
+  int socketDescriptor = GetSocketDescriptor(socket);
+  if (socketDescriptor >= 0)
+  {
+    std::vector<struct iovec> ioVectors(segments.size());
+    for (size_t i = 0; i < segments.size(); ++i)
+    {
+      ioVectors[i].iov_base = const_cast<unsigned char*>(segments[i].Data);
+      ioVectors[i].iov_len = segments[i].Size;
+    }
+    size_t firstIoVector = 0;
+    while (firstIoVector < ioVectors.size())
+    {
+      if (ioVectors[firstIoVector].iov_len == 0)
+      {
+        firstIoVector++;
+        continue;
+      }
+      struct msghdr messageHeader;
+      memset(&messageHeader, 0, sizeof(messageHeader));
+      messageHeader.msg_iov = &ioVectors[firstIoVector];
+      messageHeader.msg_iovlen = std::min<size_t>(ioVectors.size() - firstIoVector, IOV_MAX);
+      ssize_t bytesSent = sendmsg(socketDescriptor, &messageHeader, GATHER_WRITE_FLAGS);
+      if (bytesSent < 0)
+      {
+        if (errno == EINTR)
+        {
+          continue;
+        }
+        return 0;
+      }
+      // Skip the blocks that are completely sent and advance within the partially sent one
+      size_t remainingBytes = static_cast<size_t>(bytesSent);
+      while (remainingBytes > 0 && firstIoVector < ioVectors.size())
+      {
+        if (remainingBytes >= ioVectors[firstIoVector].iov_len)
+        {
+          remainingBytes -= ioVectors[firstIoVector].iov_len;
+          firstIoVector++;
+        }
+        else
+        {
+          ioVectors[firstIoVector].iov_base = static_cast<char*>(ioVectors[firstIoVector].iov_base) + remainingBytes;
+          ioVectors[firstIoVector].iov_len -= remainingBytes;
+          remainingBytes = 0;
+        }
+      }
+    }
+    return 1;
+  }
+#endif
+
+  // No gather write: small blocks are joined, so that they still go out in one write
+  size_t totalSize = 0;
+  for (std::vector<igtl::PlusScatterGatherImageMessage::Segment>::const_iterator segmentIt = segments.begin(); segmentIt != segments.end(); ++segmentIt)
+  {
+    totalSize += segmentIt->Size;
+  }
+  if (segments.size() > 1 && totalSize <= MAX_JOINED_WRITE_SIZE)
+  {
+    std::vector<unsigned char> joinedSegments;
+    joinedSegments.reserve(totalSize);
+    for (std::vector<igtl::PlusScatterGatherImageMessage::Segment>::const_iterator segmentIt = segments.begin(); segmentIt != segments.end(); ++segmentIt)
+    {
+      joinedSegments.insert(joinedSegments.end(), segmentIt->Data, segmentIt->Data + segmentIt->Size);
+    }
+    return socket->Send(&joinedSegments[0], joinedSegments.size());
+  }
+  for (std::vector<igtl::PlusScatterGatherImageMessage::Segment>::const_iterator segmentIt = segments.begin(); segmentIt != segments.end(); ++segmentIt)
+  {
+    if (socket->Send(segmentIt->Data, segmentIt->Size) == 0)
+    {
+      return 0;
+    }
+  }
+  return 1;
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusIgtlMessageCommon::SendPackedMessagesNonBlocking(int socketDescriptor, const std::vector<igtl::MessageBase::Pointer>& messages, bool coalesceMessages,
+    size_t& messageIndex, size_t& messageOffset)
+{
+#ifndef _WIN32
+  if (socketDescriptor < 0)
+  {
+    return -1;
+  }
+  std::vector<igtl::PlusScatterGatherImageMessage::Segment> segments;
+  std::vector<size_t> messageSizes;
+  std::vector<struct iovec> ioVectors;
+  while (messageIndex < messages.size())
+  {
+    // Collect the unsent part of the current message, and of all the following messages if messages are coalesced.
+    // Scatter-gather messages are sent without joining their blocks.
+    ioVectors.clear();
+    messageSizes.clear();
+    for (size_t collectedMessageIndex = messageIndex; collectedMessageIndex < messages.size(); ++collectedMessageIndex)
+    {
+      GetPackedMessageSegments(messages[collectedMessageIndex], segments);
+      size_t sentMessageBytes = (collectedMessageIndex == messageIndex ? messageOffset : 0);
+      size_t segmentStart = 0;
+      for (std::vector<igtl::PlusScatterGatherImageMessage::Segment>::const_iterator segmentIt = segments.begin(); segmentIt != segments.end(); ++segmentIt)
+      {
+        size_t segmentEnd = segmentStart + segmentIt->Size;
+        if (segmentEnd > sentMessageBytes && ioVectors.size() < IOV_MAX)
+        {
+          size_t segmentOffset = (sentMessageBytes > segmentStart ? sentMessageBytes - segmentStart : 0);
+          struct iovec ioVector;
+          ioVector.iov_base = const_cast<unsigned char*>(segmentIt->Data) + segmentOffset;
+          ioVector.iov_len = segmentIt->Size - segmentOffset;
+          ioVectors.push_back(ioVector);
+        }
+        segmentStart = segmentEnd;
+      }
+      messageSizes.push_back(segmentStart);
+      if (!coalesceMessages)
+      {
+        break;
+      }
+    }
+    if (ioVectors.empty())
+    {
+      messageIndex++;
+      messageOffset = 0;
+      continue;
+    }
+
+    struct msghdr messageHeader;
+    memset(&messageHeader, 0, sizeof(messageHeader));
+    messageHeader.msg_iov = &ioVectors[0];
+    messageHeader.msg_iovlen = ioVectors.size();
+    ssize_t bytesSent = sendmsg(socketDescriptor, &messageHeader, NON_BLOCKING_WRITE_FLAGS);
+    if (bytesSent > 0)
+    {
+      // Advance over the completely sent messages and within the partially sent one
+      size_t remainingBytes = static_cast<size_t>(bytesSent);
+      for (std::vector<size_t>::const_iterator messageSizeIt = messageSizes.begin(); remainingBytes > 0 && messageSizeIt != messageSizes.end(); ++messageSizeIt)
+      {
+        size_t unsentMessageBytes = *messageSizeIt - messageOffset;
+        if (remainingBytes < unsentMessageBytes)
+        {
+          messageOffset += remainingBytes;
+          break;
+        }
+        remainingBytes -= unsentMessageBytes;
+        messageIndex++;
+        messageOffset = 0;
+      }
+      continue;
+    }
+    if (bytesSent < 0 && errno == EINTR)
+    {
+      continue;
+    }
+    if (bytesSent < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+    {
+      return 0;
+    }
+    return -1;
+  }
+  return 1;
+#else
+  return -1;
+#endif
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusIgtlMessageCommon::WaitForSocketWritable(int socketDescriptor, int timeoutMsec)
+{
+#ifndef _WIN32
+  if (socketDescriptor < 0)
+  {
+    return false;
+  }
+  struct pollfd pollDescriptor;
+  pollDescriptor.fd = socketDescriptor;
+  pollDescriptor.events = POLLOUT;
+  pollDescriptor.revents = 0;
+  // Errors are reported as writable, so that the next write reports them
+  return poll(&pollDescriptor, 1, timeoutMsec) > 0;
+#else
+  return false;
+#endif
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusIgtlMessageCommon::GetSocketDescriptor(igtl::Socket* socket)
+{
+#ifndef _WIN32
+  if (socket != NULL)
+  {
+    return SocketDescriptorAccessor::GetSocketDescriptor(socket);
+  }
+#endif
+  return -1;
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusIgtlMessageCommon::PackImageMessage(igtl::ImageMessage::Pointer imageMessage,
     vtkImageData* image,
@@ -383,10 +863,9 @@ PlusStatus vtkPlusIgtlMessageCommon::UnpackImageMessage(igtl::MessageHeader::Poi
 
   socket->Receive(imgMsg->GetBufferBodyPointer(), imgMsg->GetBufferBodySize());
 
-  int c = imgMsg->Unpack(crccheck);
-  if (!(c & igtl::MessageHeader::UNPACK_BODY))
+  igsioTrackedFrame::FieldMapType customFields;
+  if (UnpackImageMessage(imgMsg, embeddedTransformName, customFields, crccheck) != PLUS_SUCCESS)
   {
-    LOG_ERROR("Couldn't receive image message from server!");
     return PLUS_FAIL;
   }
 
@@ -396,12 +875,6 @@ PlusStatus vtkPlusIgtlMessageCommon::UnpackImageMessage(igtl::MessageHeader::Poi
 
   int imgSize[3] = {0}; // image dimension in pixels
   imgMsg->GetDimensions(imgSize);
-
-  if (imgSize[0] < 0 || imgSize[1] < 0 || imgSize[2] < 0)
-  {
-    LOG_ERROR("Image with negative dimension. Aborting.");
-    return PLUS_FAIL;
-  }
   FrameSizeType imageSize = {static_cast<unsigned int>(imgSize[0]), static_cast<unsigned int>(imgSize[1]), static_cast<unsigned int>(imgSize[2]) };
 
   // Set scalar pixel type
@@ -425,6 +898,43 @@ PlusStatus vtkPlusIgtlMessageCommon::UnpackImageMessage(igtl::MessageHeader::Poi
   trackedFrame.SetImageData(frame);
   trackedFrame.SetTimestamp(igtlTimestamp->GetTimeStamp());
 
+  // The embedded transform, if requested
+  for (igsioTrackedFrame::FieldMapType::const_iterator it = customFields.begin(); it != customFields.end(); ++it)
+  {
+    trackedFrame.SetFrameField(it->first, it->second);
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlMessageCommon::UnpackImageMessage(igtl::ImageMessage::Pointer imgMsg,
+    const igsioTransformName& embeddedTransformName,
+    igsioTrackedFrame::FieldMapType& customFields,
+    int crccheck)
+{
+  if (imgMsg.IsNull())
+  {
+    LOG_ERROR("Unable to unpack image message - message is NULL!");
+    return PLUS_FAIL;
+  }
+
+  int c = imgMsg->Unpack(crccheck);
+  if (!(c & igtl::MessageHeader::UNPACK_BODY))
+  {
+    LOG_ERROR("Couldn't receive image message from server!");
+    return PLUS_FAIL;
+  }
+
+  int imgSize[3] = {0}; // image dimension in pixels
+  imgMsg->GetDimensions(imgSize);
+  if (imgSize[0] < 0 || imgSize[1] < 0 || imgSize[2] < 0)
+  {
+    LOG_ERROR("Image with negative dimension. Aborting.");
+    return PLUS_FAIL;
+  }
+
+  customFields.clear();
   if (embeddedTransformName.IsValid())
   {
     vtkSmartPointer<vtkMatrix4x4> vtkMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
@@ -433,6 +943,175 @@ PlusStatus vtkPlusIgtlMessageCommon::UnpackImageMessage(igtl::MessageHeader::Poi
       LOG_ERROR("Failed to unpack image message - unable to extract IJKToRAS transform");
       return PLUS_FAIL;
     }
+    // Only the fields are needed, the frame transform is stored as a custom field
+    igsioTrackedFrame transformFrame;
+    transformFrame.SetFrameTransform(embeddedTransformName, vtkMatrix);
+    customFields = transformFrame.GetCustomFields();
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlMessageCommon::PackCompressedImageMessage(igtl::PlusCompressedImageMessage::Pointer compressedImageMessage,
+    igsioTrackedFrame& trackedFrame,
+    vtkImageData* frameImage,
+    const vtkMatrix4x4& matrix,
+    vtkPlusIgtlImageCompressor* compressor)
+{
+  if (compressedImageMessage.IsNull() || compressor == NULL)
+  {
+    LOG_ERROR("Failed to pack compressed image message - input message or compressor is NULL");
+    return PLUS_FAIL;
+  }
+
+  if (frameImage == NULL || frameImage->GetScalarPointer() == NULL)
+  {
+    LOG_WARNING("Unable to send compressed image message - image is empty!");
+    return PLUS_FAIL;
+  }
+
+  if (compressor->Compress(frameImage, compressedImageMessage) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to pack compressed image message - unable to compress image");
+    return PLUS_FAIL;
+  }
+
+  // Compute the image geometry the same way as for IMAGE messages, so that the receiver gets the same IJKToRAS transform
+  int imageSizePixels[3] = { 0 };
+  double imageSpacingMm[3] = { 0 };
+  double imageOriginMm[3] = { 0 };
+  frameImage->GetDimensions(imageSizePixels);
+  frameImage->GetSpacing(imageSpacingMm);
+  frameImage->GetOrigin(imageOriginMm);
+
+  igtl::PlusCompressedImageMessage::CompressedImageHeader& header = compressedImageMessage->GetCompressedImageHeader();
+  igtl::ImageMessage::Pointer geometryMessage = igtl::ImageMessage::New();
+  geometryMessage->SetDimensions(imageSizePixels);
+  for (int i = 0; i < 3; ++i)
+  {
+    header.m_Spacing[i] = (float)imageSpacingMm[i];
+  }
+  geometryMessage->SetSpacing(header.m_Spacing);
+  if (igtlioImageConverter::VTKTransformToIGTLImage(matrix, imageSizePixels, imageSpacingMm, imageOriginMm, geometryMessage) != 1)
+  {
+    LOG_ERROR("Failed to pack compressed image message - unable to compute IJKToRAS transform");
+    return PLUS_FAIL;
+  }
+  geometryMessage->GetMatrix(header.m_IjkToRasMatrix);
+
+  if (trackedFrame.GetImageData() != NULL)
+  {
+    header.m_ImageType = trackedFrame.GetImageData()->GetImageType();
+  }
+
+  igtl::TimeStamp::Pointer igtlFrameTime = igtl::TimeStamp::New();
+  igtlFrameTime->SetTime(trackedFrame.GetTimestamp());
+  compressedImageMessage->SetTimeStamp(igtlFrameTime);
+  compressedImageMessage->Pack();
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlMessageCommon::UnpackCompressedImageMessage(igtl::MessageHeader::Pointer headerMsg,
+    igtl::Socket* socket,
+    igsioTrackedFrame& trackedFrame,
+    const igsioTransformName& embeddedTransformName,
+    vtkPlusIgtlImageCompressor* decompressor,
+    int crccheck)
+{
+  if (headerMsg.IsNull())
+  {
+    LOG_ERROR("Unable to unpack compressed image message - header message is NULL!");
+    return PLUS_FAIL;
+  }
+
+  if (socket == NULL || decompressor == NULL)
+  {
+    LOG_ERROR("Unable to unpack compressed image message - socket or decompressor is NULL!");
+    return PLUS_FAIL;
+  }
+
+  // Message body handler for CIMAGE
+  igtl::PlusCompressedImageMessage::Pointer compressedImageMsg = dynamic_cast<igtl::PlusCompressedImageMessage*>(headerMsg.GetPointer());
+  if (compressedImageMsg.IsNull())
+  {
+    compressedImageMsg = igtl::PlusCompressedImageMessage::New();
+  }
+  compressedImageMsg->SetMessageHeader(headerMsg);
+  compressedImageMsg->AllocateBuffer();
+
+  socket->Receive(compressedImageMsg->GetBufferBodyPointer(), compressedImageMsg->GetBufferBodySize());
+
+  return UnpackCompressedImageMessage(compressedImageMsg, trackedFrame, embeddedTransformName, decompressor, crccheck);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlMessageCommon::UnpackCompressedImageMessage(igtl::PlusCompressedImageMessage::Pointer compressedImageMsg,
+    igsioTrackedFrame& trackedFrame,
+    const igsioTransformName& embeddedTransformName,
+    vtkPlusIgtlImageCompressor* decompressor,
+    int crccheck)
+{
+  if (compressedImageMsg.IsNull() || decompressor == NULL)
+  {
+    LOG_ERROR("Unable to unpack compressed image message - message or decompressor is NULL!");
+    return PLUS_FAIL;
+  }
+
+  int c = compressedImageMsg->Unpack(crccheck);
+  if (!(c & igtl::MessageHeader::UNPACK_BODY))
+  {
+    LOG_ERROR("Couldn't receive compressed image message from server!");
+    return PLUS_FAIL;
+  }
+
+  igtl::PlusCompressedImageMessage::CompressedImageHeader& header = compressedImageMsg->GetCompressedImageHeader();
+  FrameSizeType imageSize = { header.m_FrameSize[0], header.m_FrameSize[1], header.m_FrameSize[2] };
+  igsioVideoFrame frame;
+  if (frame.AllocateFrame(imageSize, PlusCommon::GetVTKScalarPixelTypeFromIGTL(header.m_ScalarType), header.m_NumberOfComponents) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to allocate image data for tracked frame!");
+    return PLUS_FAIL;
+  }
+  frame.SetImageType((US_IMAGE_TYPE)header.m_ImageType);
+  if (frame.GetFrameSizeInBytes() != header.m_UncompressedSizeInBytes)
+  {
+    LOG_ERROR("Failed to unpack compressed image message - uncompressed size (" << header.m_UncompressedSizeInBytes << " bytes) does not match the frame size (" << frame.GetFrameSizeInBytes() << " bytes)");
+    return PLUS_FAIL;
+  }
+
+  // Decompress directly into the frame
+  if (decompressor->Decompress(compressedImageMsg, (unsigned char*)frame.GetScalarPointer(), frame.GetFrameSizeInBytes()) != PLUS_SUCCESS)
+  {
+    if (!decompressor->GetWaitingForKeyFrame())
+    {
+      LOG_ERROR("Failed to unpack compressed image message - unable to decompress image");
+    }
+    return PLUS_FAIL;
+  }
+
+  igtl::TimeStamp::Pointer igtlTimestamp = igtl::TimeStamp::New();
+  compressedImageMsg->GetTimeStamp(igtlTimestamp);
+
+  trackedFrame.SetImageData(frame);
+  trackedFrame.SetTimestamp(igtlTimestamp->GetTimeStamp());
+
+  if (embeddedTransformName.IsValid())
+  {
+    // The geometry is encoded the same way as in IMAGE messages
+    int imgSize[3] = { header.m_FrameSize[0], header.m_FrameSize[1], header.m_FrameSize[2] };
+    igtl::ImageMessage::Pointer geometryMessage = igtl::ImageMessage::New();
+    geometryMessage->SetDimensions(imgSize);
+    geometryMessage->SetSpacing(header.m_Spacing);
+    geometryMessage->SetMatrix(header.m_IjkToRasMatrix);
+    vtkSmartPointer<vtkMatrix4x4> vtkMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    if (igtlioImageConverter::IGTLImageToVTKTransform(geometryMessage, vtkMatrix) != 1)
+    {
+      LOG_ERROR("Failed to unpack compressed image message - unable to extract IJKToRAS transform");
+      return PLUS_FAIL;
+    }
     trackedFrame.SetFrameTransform(embeddedTransformName, vtkMatrix);
   }
 
@@ -566,6 +1245,85 @@ PlusStatus vtkPlusIgtlMessageCommon::PackVideoMessage(igtl::VideoMessage::Pointe
 
   return PLUS_SUCCESS;
 }
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlMessageCommon::UnpackVideoMessage(igtl::VideoMessage::Pointer videoMessage,
+    vtkIGSIOFrameConverter* decoder,
+    vtkSmartPointer<vtkImageData>& decodedImage,
+    const igsioTransformName& embeddedTransformName,
+    igsioTrackedFrame::FieldMapType& customFields,
+    int crccheck)
+{
+  if (videoMessage.IsNull() || decoder == NULL)
+  {
+    LOG_ERROR("Unable to unpack video message - message or decoder is NULL!");
+    return PLUS_FAIL;
+  }
+
+  int c = videoMessage->Unpack(crccheck);
+  if (!(c & igtl::MessageHeader::UNPACK_BODY))
+  {
+    LOG_ERROR("Couldn't receive video message from server!");
+    return PLUS_FAIL;
+  }
+
+  // The frame type is packed by PackVideoMessage: single component frames are shifted by 8 bits
+  int frameType = videoMessage->GetFrameType();
+  int numberOfComponents = 3;
+  if (frameType > 0xFF)
+  {
+    frameType = frameType >> 8;
+    numberOfComponents = 1;
+  }
+
+  unsigned int frameSize = videoMessage->GetBitStreamSize();
+  vtkSmartPointer<vtkUnsignedCharArray> frameData = vtkSmartPointer<vtkUnsignedCharArray>::New();
+  frameData->SetNumberOfTuples(frameSize);
+  memcpy(frameData->GetPointer(0), videoMessage->GetPackFragmentPointer(2), frameSize);
+
+  vtkSmartPointer<vtkStreamingVolumeFrame> encodedFrame = vtkSmartPointer<vtkStreamingVolumeFrame>::New();
+  encodedFrame->SetCodecFourCC(videoMessage->GetCodecType());
+  encodedFrame->SetDimensions(videoMessage->GetWidth(), videoMessage->GetHeight(), std::max<int>(videoMessage->GetAdditionalZDimension(), 1));
+  encodedFrame->SetNumberOfComponents(numberOfComponents);
+  encodedFrame->SetFrameType(frameType == FrameTypeKey ? vtkStreamingVolumeFrame::IFrame : vtkStreamingVolumeFrame::PFrame);
+  encodedFrame->SetFrameData(frameData);
+
+  // The decoder keeps the state of the stream, the frames must be decoded in the order they were received
+  igsioVideoFrame frame;
+  frame.SetEncodedFrame(encodedFrame);
+  decodedImage = decoder->GetUncompressedImage(&frame);
+  if (decodedImage == NULL)
+  {
+    LOG_ERROR("Failed to unpack video message - unable to decode " << videoMessage->GetCodecType() << " frame");
+    return PLUS_FAIL;
+  }
+
+  customFields.clear();
+  if (embeddedTransformName.IsValid())
+  {
+    // The geometry is encoded the same way as in IMAGE messages
+    int imgSize[3] = { videoMessage->GetWidth(), videoMessage->GetHeight(), std::max<int>(videoMessage->GetAdditionalZDimension(), 1) };
+    float spacing[3] = { 1.0, 1.0, 1.0 };
+    videoMessage->GetSpacing(spacing);
+    igtl::Matrix4x4 videoMatrix;
+    videoMessage->GetMatrix(videoMatrix);
+    igtl::ImageMessage::Pointer geometryMessage = igtl::ImageMessage::New();
+    geometryMessage->SetDimensions(imgSize);
+    geometryMessage->SetSpacing(spacing);
+    geometryMessage->SetMatrix(videoMatrix);
+    vtkSmartPointer<vtkMatrix4x4> vtkMatrix = vtkSmartPointer<vtkMatrix4x4>::New();
+    if (igtlioImageConverter::IGTLImageToVTKTransform(geometryMessage, vtkMatrix) != 1)
+    {
+      LOG_ERROR("Failed to unpack video message - unable to extract IJKToRAS transform");
+      return PLUS_FAIL;
+    }
+    igsioTrackedFrame transformFrame;
+    transformFrame.SetFrameTransform(embeddedTransformName, vtkMatrix);
+    customFields = transformFrame.GetCustomFields();
+  }
+
+  return PLUS_SUCCESS;
+}
 #endif
 
 //-------------------------------------------------------------------------------
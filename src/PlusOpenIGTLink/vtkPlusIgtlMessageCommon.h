@@ -9,6 +9,7 @@ See License.txt for details.
 
 // Local includes
 #include "PlusConfigure.h"
+#include "PlusIgtlClientInfo.h"
 #include "vtkPlusOpenIGTLinkExport.h"
 
 // VTK includes
@@ -18,6 +19,8 @@ See License.txt for details.
 #include <igtlImageMessage.h>
 #include <igtlImageMetaMessage.h>
 #include <igtlMessageBase.h>
+#include <igtlPlusCompressedImageMessage.h>
+#include <igtlPlusScatterGatherImageMessage.h>
 #include <igtlPlusTrackedFrameMessage.h>
 #include <igtlPlusUsMessage.h>
 #include <igtlPolyDataMessage.h>
@@ -52,33 +55,90 @@ public:
   vtkTypeMacro(vtkPlusIgtlMessageCommon, vtkObject);
   virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
 
-  /*! Pack tracked frame message from tracked frame */
+  /*!
+  Pack tracked frame message from tracked frame.
+  The message is packed in segments (see igtl::PlusTrackedFrameMessage::PackSegments), it must be sent with SendPackedMessage().
+  The field encoding is set on the message with igtl::PlusTrackedFrameMessage::SetFieldsVersion() before calling this method.
+  */
   static PlusStatus PackTrackedFrameMessage(igtl::PlusTrackedFrameMessage::Pointer trackedFrameMessage, igsioTrackedFrame& trackedFrame, vtkSmartPointer<vtkMatrix4x4> embeddedImageTransform, const std::vector<igsioTransformName>& requestedTransforms);
 
   /*! Unpack tracked frame message to tracked frame */
   static PlusStatus UnpackTrackedFrameMessage(igtl::MessageHeader::Pointer headerMsg, igtl::Socket* socket, igsioTrackedFrame& trackedFrame, const igsioTransformName& embeddedTransformName, int crccheck);
 
+  /*! Unpack a tracked frame message whose body has already been received to tracked frame */
+  static PlusStatus UnpackTrackedFrameMessage(igtl::PlusTrackedFrameMessage::Pointer trackedFrameMsg, igsioTrackedFrame& trackedFrame, const igsioTransformName& embeddedTransformName, int crccheck);
+
   /*! Pack US message from tracked frame */
   static PlusStatus PackUsMessage(igtl::PlusUsMessage::Pointer usMessage, igsioTrackedFrame& trackedFrame);
 
   /*! Unpack US message to tracked frame */
   static PlusStatus UnpackUsMessage(igtl::MessageHeader::Pointer headerMsg, igtl::Socket* socket, igsioTrackedFrame& trackedFrame, int crccheck);
 
-  /*! Pack image message from tracked frame */
+  /*!
+  Pack image message from tracked frame.
+  If the message is an igtl::PlusScatterGatherImageMessage then the pixels are not copied into the message,
+  the message references the frame image instead.
+  */
   static PlusStatus PackImageMessage(igtl::ImageMessage::Pointer imageMessage, igsioTrackedFrame& trackedFrame, const vtkMatrix4x4& imageToReferenceTransform, vtkIGSIOFrameConverter* frameConverter=NULL);
 
+  /*!
+  Pack image message from an uncompressed image of the tracked frame (e.g., a cropped or downsampled version of the frame image).
+  Timestamp is taken from the tracked frame. A scatter-gather message keeps a reference to the image, so it must not be modified afterwards.
+  */
+  static PlusStatus PackImageMessage(igtl::ImageMessage::Pointer imageMessage, igsioTrackedFrame& trackedFrame, vtkImageData* frameImage, const vtkMatrix4x4& imageToReferenceTransform);
+
+  /*!
+  Crop, downsample (by area averaging) and convert the pixel type of an image as requested by an image stream.
+  The output image extent starts at 0; origin and spacing are set so that the output pixels keep their position
+  in the input image coordinate system, therefore the image-to-reference transform does not change.
+  */
+  static PlusStatus ProcessImageForStream(vtkImageData* inputImage, const PlusIgtlClientInfo::ImageStream& imageStream, vtkImageData* outputImage);
+
   /*! Pack image message from vtkImageData volume */
   static PlusStatus PackImageMessage(igtl::ImageMessage::Pointer imageMessage, vtkImageData* image, const vtkMatrix4x4& imageToReferenceTransform, double timestamp);
 
   /*! Unpack image message to tracked frame */
   static PlusStatus UnpackImageMessage(igtl::MessageHeader::Pointer headerMsg, igtl::Socket* socket, igsioTrackedFrame& trackedFrame, const igsioTransformName& embeddedTransformName, int crccheck);
 
+  /*!
+  Unpack an image message whose body has already been received, without copying the pixels: they remain accessible with
+  imgMsg->GetScalarPointer(). The embedded transform is returned in customFields, as it would be stored in a tracked frame.
+  */
+  static PlusStatus UnpackImageMessage(igtl::ImageMessage::Pointer imgMsg, const igsioTransformName& embeddedTransformName, igsioTrackedFrame::FieldMapType& customFields, int crccheck);
+
+  /*!
+  Pack compressed image message (CIMAGE) from an uncompressed image of the tracked frame.
+  The compressor keeps the state of the stream, it must be the same object for all frames of a stream.
+  */
+  static PlusStatus PackCompressedImageMessage(igtl::PlusCompressedImageMessage::Pointer compressedImageMessage, igsioTrackedFrame& trackedFrame, vtkImageData* frameImage,
+      const vtkMatrix4x4& imageToReferenceTransform, vtkPlusIgtlImageCompressor* compressor);
+
+  /*!
+  Unpack compressed image message (CIMAGE) to tracked frame.
+  The decompressor keeps the state of the stream, it must be the same object for all messages of a stream.
+  If the decompressor is waiting for a key frame (see vtkPlusIgtlImageCompressor::GetWaitingForKeyFrame) then PLUS_FAIL is returned.
+  */
+  static PlusStatus UnpackCompressedImageMessage(igtl::MessageHeader::Pointer headerMsg, igtl::Socket* socket, igsioTrackedFrame& trackedFrame,
+      const igsioTransformName& embeddedTransformName, vtkPlusIgtlImageCompressor* decompressor, int crccheck);
+
+  /*! Unpack a compressed image message (CIMAGE) whose body has already been received to tracked frame */
+  static PlusStatus UnpackCompressedImageMessage(igtl::PlusCompressedImageMessage::Pointer compressedImageMsg, igsioTrackedFrame& trackedFrame,
+      const igsioTransformName& embeddedTransformName, vtkPlusIgtlImageCompressor* decompressor, int crccheck);
+
   /*! Pack image meta deta message from vtkPlusServer::ImageMetaDataList  */
   static PlusStatus PackImageMetaMessage(igtl::ImageMetaMessage::Pointer imageMetaMessage, igsioCommon::ImageMetaDataList& imageMetaDataList);
 
 #if defined(OpenIGTLink_ENABLE_VIDEOSTREAMING)
   /*! Pack video message from tracked frame */
   static PlusStatus PackVideoMessage(igtl::VideoMessage::Pointer imageMessage, igsioTrackedFrame& trackedFrame, vtkMatrix4x4& imageToReferenceTransform, vtkIGSIOFrameConverter* frameConverter = NULL, std::string codecFourCC = "", std::map<std::string, std::string> parameters= std::map<std::string, std::string>());
+
+  /*!
+  Unpack and decode a video message whose body has already been received.
+  The decoder keeps the state of the stream, it must be the same object for all messages of a stream.
+  The embedded transform is returned in customFields, as it would be stored in a tracked frame.
+  */
+  static PlusStatus UnpackVideoMessage(igtl::VideoMessage::Pointer videoMessage, vtkIGSIOFrameConverter* decoder, vtkSmartPointer<vtkImageData>& decodedImage,
+      const igsioTransformName& embeddedTransformName, igsioTrackedFrame::FieldMapType& customFields, int crccheck);
 #endif
 
   /*! Pack transform message from tracked frame */
@@ -111,6 +171,42 @@ public:
   static PlusStatus PackStringMessage(igtl::StringMessage::Pointer stringMessage, const char* stringName, const char* stringValue, double timestamp);
 
 
+  /*! Get the memory blocks of a packed message in wire order. Scatter-gather and tracked frame messages consist of multiple blocks, all other messages of one. */
+  static void GetPackedMessageSegments(igtl::MessageBase* message, std::vector<igtl::PlusScatterGatherImageMessage::Segment>& segments);
+
+  /*! Get the number of bytes that are written to the socket when a packed message is sent */
+  static size_t GetPackedMessageSize(igtl::MessageBase* message);
+
+  /*!
+  Send a packed message on the socket. Scatter-gather and tracked frame messages are written with a single gather write (sendmsg)
+  where the platform supports it. Returns nonzero on success, 0 on failure (same convention as igtl::Socket::Send).
+  */
+  static int SendPackedMessage(igtl::Socket* socket, igtl::MessageBase* message);
+
+  /*!
+  Send packed messages on the socket with a single gather write (sendmsg) where the platform supports it, so that
+  small messages of the same frame do not each cost a system call and a TCP segment. Where gather writes are not available
+  the messages are joined into one buffer if they are small, otherwise sent one by one.
+  Returns nonzero on success, 0 on failure (same convention as igtl::Socket::Send).
+  */
+  static int SendPackedMessages(igtl::Socket* socket, const std::vector<igtl::MessageBase::Pointer>& messages);
+
+  /*!
+  Write packed messages to a socket until all are written or the socket would block. The write never blocks, even if the socket is
+  in blocking mode. The first messageOffset bytes of message messageIndex are already sent, both are advanced by the written bytes.
+  If coalesceMessages is set then the rest of the messages is written with one gather write, otherwise one message per write.
+  Returns 1 if all messages are written, 0 if the socket would block, -1 if the connection failed or non-blocking writes are not
+  supported on this platform.
+  */
+  static int SendPackedMessagesNonBlocking(int socketDescriptor, const std::vector<igtl::MessageBase::Pointer>& messages, bool coalesceMessages,
+      size_t& messageIndex, size_t& messageOffset);
+
+  /*! Wait until data can be written to the socket without blocking. Returns false if the timeout elapsed. */
+  static bool WaitForSocketWritable(int socketDescriptor, int timeoutMsec);
+
+  /*! Get the operating system descriptor of an OpenIGTLink socket. Returns -1 if not available (not connected or not supported on this platform). */
+  static int GetSocketDescriptor(igtl::Socket* socket);
+
   /*! Generate igtl::Matrix4x4 with the selected transform name from the transform repository */
   static PlusStatus GetIgtlMatrix(igtl::Matrix4x4& igtlMatrix, vtkIGSIOTransformRepository* transformRepository, igsioTransformName& transformName);
 
@@ -118,6 +214,9 @@ protected:
   vtkPlusIgtlMessageCommon();
   virtual ~vtkPlusIgtlMessageCommon();
 
+  /*! Write the memory blocks to the socket in order. Returns nonzero on success, 0 on failure. */
+  static int SendSegments(igtl::Socket* socket, const std::vector<igtl::PlusScatterGatherImageMessage::Segment>& segments);
+
 private:
   vtkPlusIgtlMessageCommon(const vtkPlusIgtlMessageCommon&);
   void operator=(const vtkPlusIgtlMessageCommon&);
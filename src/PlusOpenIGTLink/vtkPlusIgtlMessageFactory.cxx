@@ -9,6 +9,7 @@ See License.txt for details.
 #include "igsioTrackedFrame.h"
 #include "igsioVideoFrame.h"
 #include "vtkImageData.h"
+#include "vtkMath.h"
 #include "vtkNew.h"
 #include "vtkMatrix4x4.h"
 #include "vtkObjectFactory.h"
@@ -17,6 +18,8 @@ See License.txt for details.
 #include "vtkIGSIOTrackedFrameList.h"
 #include "vtkIGSIOTransformRepository.h"
 #include "vtksys/SystemTools.hxx"
+#include <chrono>
+#include <sstream>
 #include <typeinfo>
 
 //----------------------------------------------------------------------------
@@ -24,6 +27,9 @@ See License.txt for details.
 #include "igtlCommandMessage.h"
 #include "igtlImageMessage.h"
 #include "igtlPlusClientInfoMessage.h"
+#include "igtlPlusCompressedImageMessage.h"
+#include "igtlPlusScatterGatherImageMessage.h"
+#include "igtlPlusSharedMemoryNotificationMessage.h"
 #include "igtlPlusTrackedFrameMessage.h"
 #include "igtlPlusUsMessage.h"
 #include "igtlPositionMessage.h"
@@ -47,13 +53,63 @@ See License.txt for details.
 
 vtkStandardNewMacro(vtkPlusIgtlMessageFactory);
 
+namespace
+{
+  // Names of the message types in the order of vtkPlusIgtlMessageFactory::PackedMessageType
+  const char* const PACKED_MESSAGE_TYPE_NAMES[] = { "IMAGE", "VIDEO", "TRANSFORM", "TDATA", "POSITION", "TRACKEDFRAME", "USMESSAGE", "STRING", "COMMAND" };
+
+  //----------------------------------------------------------------------------
+  // Returns true if the transform moved by more than the thresholds. With zero thresholds any difference counts as a change.
+  bool IsTransformChanged(const std::array<double, 16>& previousMatrix, vtkMatrix4x4* matrix, double thresholdMm, double thresholdDeg)
+  {
+    if (thresholdMm <= 0.0 && thresholdDeg <= 0.0)
+    {
+      for (int i = 0; i < 4; ++i)
+      {
+        for (int j = 0; j < 4; ++j)
+        {
+          if (previousMatrix[i * 4 + j] != matrix->GetElement(i, j))
+          {
+            return true;
+          }
+        }
+      }
+      return false;
+    }
+
+    double previousPosition[3] = { previousMatrix[3], previousMatrix[7], previousMatrix[11] };
+    double position[3] = { matrix->GetElement(0, 3), matrix->GetElement(1, 3), matrix->GetElement(2, 3) };
+    if (sqrt(vtkMath::Distance2BetweenPoints(previousPosition, position)) > thresholdMm)
+    {
+      return true;
+    }
+
+    // Angle of the relative rotation, computed from the normalized axes so that scaling (e.g., image pixel spacing) does not matter
+    double trace = 0.0;
+    for (int j = 0; j < 3; ++j)
+    {
+      double previousAxis[3] = { previousMatrix[j], previousMatrix[4 + j], previousMatrix[8 + j] };
+      double axis[3] = { matrix->GetElement(0, j), matrix->GetElement(1, j), matrix->GetElement(2, j) };
+      vtkMath::Normalize(previousAxis);
+      vtkMath::Normalize(axis);
+      trace += vtkMath::Dot(previousAxis, axis);
+    }
+    double cosAngle = std::max(-1.0, std::min(1.0, (trace - 1.0) / 2.0));
+    return vtkMath::DegreesFromRadians(acos(cosAngle)) > thresholdDeg;
+  }
+}
+
 //----------------------------------------------------------------------------
 vtkPlusIgtlMessageFactory::vtkPlusIgtlMessageFactory()
   : IgtlFactory(igtl::MessageFactory::New())
+  , ScatterGatherImageMessages(false)
+  , ProcessedStreamImagesSourceMTime(0)
 {
   this->IgtlFactory->AddMessageType("CLIENTINFO", (PointerToMessageBaseNew)&igtl::PlusClientInfoMessage::New);
   this->IgtlFactory->AddMessageType("TRACKEDFRAME", (PointerToMessageBaseNew)&igtl::PlusTrackedFrameMessage::New);
   this->IgtlFactory->AddMessageType("USMESSAGE", (PointerToMessageBaseNew)&igtl::PlusUsMessage::New);
+  this->IgtlFactory->AddMessageType("CIMAGE", (PointerToMessageBaseNew)&igtl::PlusCompressedImageMessage::New);
+  this->IgtlFactory->AddMessageType("SHMNOTIFY", (PointerToMessageBaseNew)&igtl::PlusSharedMemoryNotificationMessage::New);
 }
 
 //----------------------------------------------------------------------------
@@ -66,6 +122,7 @@ vtkPlusIgtlMessageFactory::~vtkPlusIgtlMessageFactory()
 void vtkPlusIgtlMessageFactory::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  os << indent << "ScatterGatherImageMessages: " << (this->ScatterGatherImageMessages ? "true" : "false") << std::endl;
   this->PrintAvailableMessageTypes(os, indent);
 }
 
@@ -150,6 +207,8 @@ PlusStatus vtkPlusIgtlMessageFactory::PackMessages(int clientId, const PlusIgtlC
     transformRepository->SetTransforms(trackedFrame);
   }
 
+  // Packing time is only measured if somebody asked for the statistics
+  const bool measurePackTime = PlusCommon::GetPerformanceStatisticsEnabled();
   for (std::vector<std::string>::const_iterator messageTypeIterator = clientInfo.IgtlMessageTypes.begin(); messageTypeIterator != clientInfo.IgtlMessageTypes.end(); ++ messageTypeIterator)
   {
     std::string messageType = (*messageTypeIterator);
@@ -171,53 +230,100 @@ PlusStatus vtkPlusIgtlMessageFactory::PackMessages(int clientId, const PlusIgtlC
       continue;
     }
 
+    std::chrono::steady_clock::time_point packStartTime;
+    if (measurePackTime)
+    {
+      packStartTime = std::chrono::steady_clock::now();
+    }
+    PackedMessageType packedMessageType = NUMBER_OF_PACKED_MESSAGE_TYPES;
     if (typeid(*igtlMessage) == typeid(igtl::ImageMessage))
     {
+      packedMessageType = PACKED_IMAGE;
       numberOfErrors += PackImageMessage(clientInfo, *transformRepository, messageType, igtlMessage, trackedFrame, igtlMessages, clientId);
     }
 #if defined(OpenIGTLink_ENABLE_VIDEOSTREAMING)
     else if (typeid(*igtlMessage) == typeid(igtl::VideoMessage))
     {
+      packedMessageType = PACKED_VIDEO;
       numberOfErrors += PackVideoMessage(clientInfo, *transformRepository, messageType, igtlMessage, trackedFrame, igtlMessages, clientId);
     }
 #endif
     else if (typeid(*igtlMessage) == typeid(igtl::TransformMessage))
     {
-      numberOfErrors += PackTransformMessage(clientInfo, *transformRepository, packValidTransformsOnly, igtlMessage, trackedFrame, igtlMessages);
+      packedMessageType = PACKED_TRANSFORM;
+      numberOfErrors += PackTransformMessage(clientInfo, *transformRepository, packValidTransformsOnly, igtlMessage, trackedFrame, igtlMessages, clientId);
     }
     else if (typeid(*igtlMessage) == typeid(igtl::TrackingDataMessage))
     {
-      numberOfErrors += PackTrackingDataMessage(clientInfo, trackedFrame, *transformRepository, packValidTransformsOnly, igtlMessage, igtlMessages);
+      packedMessageType = PACKED_TDATA;
+      numberOfErrors += PackTrackingDataMessage(clientInfo, trackedFrame, *transformRepository, packValidTransformsOnly, igtlMessage, igtlMessages, clientId);
     }
     else if (typeid(*igtlMessage) == typeid(igtl::PositionMessage))
     {
-      numberOfErrors += PackPositionMessage(clientInfo, *transformRepository, igtlMessage, trackedFrame, igtlMessages);
+      packedMessageType = PACKED_POSITION;
+      numberOfErrors += PackPositionMessage(clientInfo, *transformRepository, igtlMessage, trackedFrame, igtlMessages, clientId);
     }
     else if (typeid(*igtlMessage) == typeid(igtl::PlusTrackedFrameMessage))
     {
+      packedMessageType = PACKED_TRACKEDFRAME;
       numberOfErrors += PackTrackedFrameMessage(igtlMessage, clientInfo, *transformRepository, trackedFrame, igtlMessages);
     }
     else if (typeid(*igtlMessage) == typeid(igtl::PlusUsMessage))
     {
+      packedMessageType = PACKED_USMESSAGE;
       numberOfErrors += PackUsMessage(igtlMessage, trackedFrame, igtlMessages);
     }
     else if (typeid(*igtlMessage) == typeid(igtl::StringMessage))
     {
+      packedMessageType = PACKED_STRING;
       numberOfErrors += PackStringMessage(clientInfo, trackedFrame, igtlMessage, igtlMessages);
     }
     else if (typeid(*igtlMessage) == typeid(igtl::CommandMessage))
     {
+      packedMessageType = PACKED_COMMAND;
       numberOfErrors += PackCommandMessage(igtlMessage, igtlMessages);
     }
     else
     {
       LOG_WARNING("This message type (" << messageType << ") is not supported!");
+      continue;
+    }
+
+    if (measurePackTime)
+    {
+      unsigned long long packTimeNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - packStartTime).count();
+      MessagePackCounters& counters = this->MessagePackCountersByType[packedMessageType];
+      counters.NumberOfPackedMessages.fetch_add(1, std::memory_order_relaxed);
+      counters.TotalPackTimeNs.fetch_add(packTimeNs, std::memory_order_relaxed);
+      unsigned long long maxPackTimeNs = counters.MaxPackTimeNs.load(std::memory_order_relaxed);
+      while (packTimeNs > maxPackTimeNs && !counters.MaxPackTimeNs.compare_exchange_weak(maxPackTimeNs, packTimeNs, std::memory_order_relaxed))
+      {
+      }
     }
   }
 
   return (numberOfErrors == 0 ? PLUS_SUCCESS : PLUS_FAIL);
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusIgtlMessageFactory::GetMessagePackStatistics(std::map<std::string, MessagePackStatistics>& statistics) const
+{
+  statistics.clear();
+  for (int packedMessageType = 0; packedMessageType < NUMBER_OF_PACKED_MESSAGE_TYPES; ++packedMessageType)
+  {
+    const MessagePackCounters& counters = this->MessagePackCountersByType[packedMessageType];
+    unsigned long long numberOfPackedMessages = counters.NumberOfPackedMessages.load(std::memory_order_relaxed);
+    if (numberOfPackedMessages == 0)
+    {
+      continue;
+    }
+    MessagePackStatistics& typeStatistics = statistics[PACKED_MESSAGE_TYPE_NAMES[packedMessageType]];
+    typeStatistics.NumberOfPackedMessages = numberOfPackedMessages;
+    typeStatistics.AveragePackTimeSec = counters.TotalPackTimeNs.load(std::memory_order_relaxed) * 1e-9 / numberOfPackedMessages;
+    typeStatistics.MaxPackTimeSec = counters.MaxPackTimeNs.load(std::memory_order_relaxed) * 1e-9;
+  }
+}
+
 //----------------------------------------------------------------------------
 int vtkPlusIgtlMessageFactory::PackCommandMessage(igtl::MessageBase::Pointer igtlMessage, std::vector<igtl::MessageBase::Pointer>& igtlMessages)
 {
@@ -268,6 +374,8 @@ int vtkPlusIgtlMessageFactory::PackTrackedFrameMessage(igtl::MessageBase::Pointe
 {
   int numberOfErrors(0);
   igtl::PlusTrackedFrameMessage::Pointer trackedFrameMessage = dynamic_cast<igtl::PlusTrackedFrameMessage*>(igtlMessage->Clone().GetPointer());
+  // Use the latest field encoding that both the client and the server support
+  trackedFrameMessage->SetFieldsVersion(std::min<int>(clientInfo.GetTrackedFrameFieldsVersion(), igtl::PlusTrackedFrameMessage::FIELDS_VERSION_LATEST));
 
   for (auto nameIter = clientInfo.TransformNames.begin(); nameIter != clientInfo.TransformNames.end(); ++nameIter)
   {
@@ -301,7 +409,7 @@ int vtkPlusIgtlMessageFactory::PackTrackedFrameMessage(igtl::MessageBase::Pointe
 }
 
 //----------------------------------------------------------------------------
-int vtkPlusIgtlMessageFactory::PackPositionMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages)
+int vtkPlusIgtlMessageFactory::PackPositionMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages, int clientId)
 {
   for (std::vector<igsioTransformName>::const_iterator transformNameIterator = clientInfo.TransformNames.begin(); transformNameIterator != clientInfo.TransformNames.end(); ++transformNameIterator)
   {
@@ -318,6 +426,10 @@ int vtkPlusIgtlMessageFactory::PackPositionMessage(const PlusIgtlClientInfo& cli
     ToolStatus status;
     vtkNew<vtkMatrix4x4> temp;
     transformRepository.GetTransform(transformName, temp.GetPointer(), &status);
+    if (!this->IsTransformPublishRequired(clientId, clientInfo, "POSITION", transformName, temp.GetPointer(), status, trackedFrame.GetTimestamp()))
+    {
+      continue;
+    }
 
     float position[3] = { igtlMatrix[0][3], igtlMatrix[1][3], igtlMatrix[2][3] };
     float quaternion[4] = { 0, 0, 0, 1 };
@@ -332,7 +444,7 @@ int vtkPlusIgtlMessageFactory::PackPositionMessage(const PlusIgtlClientInfo& cli
 }
 
 //----------------------------------------------------------------------------
-int vtkPlusIgtlMessageFactory::PackTrackingDataMessage(const PlusIgtlClientInfo& clientInfo, igsioTrackedFrame& trackedFrame, vtkIGSIOTransformRepository& transformRepository, bool packValidTransformsOnly, igtl::MessageBase::Pointer igtlMessage, std::vector<igtl::MessageBase::Pointer>& igtlMessages)
+int vtkPlusIgtlMessageFactory::PackTrackingDataMessage(const PlusIgtlClientInfo& clientInfo, igsioTrackedFrame& trackedFrame, vtkIGSIOTransformRepository& transformRepository, bool packValidTransformsOnly, igtl::MessageBase::Pointer igtlMessage, std::vector<igtl::MessageBase::Pointer>& igtlMessages, int clientId)
 {
   if (clientInfo.GetTDATARequested() && clientInfo.GetLastTDATASentTimeStamp() + clientInfo.GetTDATAResolution() < trackedFrame.GetTimestamp())
   {
@@ -352,9 +464,18 @@ int vtkPlusIgtlMessageFactory::PackTrackingDataMessage(const PlusIgtlClientInfo&
         LOG_TRACE("Attempted to send invalid transform over IGT Link when server has prevented sending.");
         continue;
       }
+      if (!this->IsTransformPublishRequired(clientId, clientInfo, "TDATA", transformName, mat, status, trackedFrame.GetTimestamp()))
+      {
+        continue;
+      }
 
       names.push_back(transformName);
     }
+    if (names.empty() && clientInfo.GetSendChangedTransformsOnly())
+    {
+      // None of the tracking data elements changed
+      return 0;
+    }
 
     igtl::TrackingDataMessage::Pointer trackingDataMessage = dynamic_cast<igtl::TrackingDataMessage*>(igtlMessage->Clone().GetPointer());
     vtkPlusIgtlMessageCommon::PackTrackingDataMessage(trackingDataMessage, names, transformRepository, trackedFrame.GetTimestamp());
@@ -364,7 +485,7 @@ int vtkPlusIgtlMessageFactory::PackTrackingDataMessage(const PlusIgtlClientInfo&
 }
 
 //----------------------------------------------------------------------------
-int vtkPlusIgtlMessageFactory::PackTransformMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, bool packValidTransformsOnly, igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages)
+int vtkPlusIgtlMessageFactory::PackTransformMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, bool packValidTransformsOnly, igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages, int clientId)
 {
   for (std::vector<igsioTransformName>::const_iterator transformNameIterator = clientInfo.TransformNames.begin(); transformNameIterator != clientInfo.TransformNames.end(); ++transformNameIterator)
   {
@@ -378,6 +499,10 @@ int vtkPlusIgtlMessageFactory::PackTransformMessage(const PlusIgtlClientInfo& cl
       LOG_TRACE("Attempted to send invalid transform over IGT Link when server has prevented sending.");
       continue;
     }
+    if (!this->IsTransformPublishRequired(clientId, clientInfo, "TRANSFORM", transformName, temp.GetPointer(), status, trackedFrame.GetTimestamp()))
+    {
+      continue;
+    }
 
     igtl::Matrix4x4 igtlMatrix;
     vtkPlusIgtlMessageCommon::GetIgtlMatrix(igtlMatrix, &transformRepository, transformName);
@@ -390,6 +515,48 @@ int vtkPlusIgtlMessageFactory::PackTransformMessage(const PlusIgtlClientInfo& cl
   return 0; // no errors possible in this message type
 }
 
+//----------------------------------------------------------------------------
+void vtkPlusIgtlMessageFactory::ResetPublishedTransforms(int clientId)
+{
+  std::lock_guard<std::mutex> publishedTransformsLock(this->PublishedTransformsMutex);
+  this->PublishedTransforms.erase(clientId);
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusIgtlMessageFactory::IsTransformPublishRequired(int clientId, const PlusIgtlClientInfo& clientInfo, const std::string& messageType, const igsioTransformName& transformName,
+    vtkMatrix4x4* matrix, ToolStatus status, double timestamp)
+{
+  if (!clientInfo.GetSendChangedTransformsOnly())
+  {
+    return true;
+  }
+
+  std::lock_guard<std::mutex> publishedTransformsLock(this->PublishedTransformsMutex);
+  std::map<std::string, PublishedTransform>& publishedTransforms = this->PublishedTransforms[clientId];
+  std::map<std::string, PublishedTransform>::iterator publishedIt = publishedTransforms.find(messageType + ":" + transformName.GetTransformName());
+  bool publishRequired = (publishedIt == publishedTransforms.end()
+                          || publishedIt->second.Status != status
+                          || timestamp < publishedIt->second.Timestamp
+                          || timestamp - publishedIt->second.Timestamp >= clientInfo.GetTransformRefreshIntervalSec()
+                          || IsTransformChanged(publishedIt->second.Matrix, matrix, clientInfo.GetTransformChangeThresholdMm(), clientInfo.GetTransformChangeThresholdDeg()));
+  if (!publishRequired)
+  {
+    return false;
+  }
+
+  PublishedTransform& published = publishedTransforms[messageType + ":" + transformName.GetTransformName()];
+  for (int i = 0; i < 4; ++i)
+  {
+    for (int j = 0; j < 4; ++j)
+    {
+      published.Matrix[i * 4 + j] = matrix->GetElement(i, j);
+    }
+  }
+  published.Status = status;
+  published.Timestamp = timestamp;
+  return true;
+}
+
 //----------------------------------------------------------------------------
 int vtkPlusIgtlMessageFactory::PackImageMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, const std::string& messageType, igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages, int clientId)
 {
@@ -411,14 +578,32 @@ int vtkPlusIgtlMessageFactory::PackImageMessage(const PlusIgtlClientInfo& client
 
     std::string deviceName = imageTransformName.From() + std::string("_") + imageTransformName.To();
 
-    igtl::ImageMessage::Pointer imageMessage = dynamic_cast<igtl::ImageMessage*>(igtlMessage->Clone().GetPointer());
+    igtl::ImageMessage::Pointer imageMessage;
+    igtl::PlusCompressedImageMessage::Pointer compressedImageMessage;
+    if (imageStream.IsCompressionRequested())
+    {
+      // Clients that request compression understand CIMAGE messages, they are sent instead of IMAGE
+      compressedImageMessage = igtl::PlusCompressedImageMessage::New();
+      compressedImageMessage->SetHeaderVersion(igtlMessage->GetHeaderVersion());
+    }
+    else if (this->ScatterGatherImageMessages)
+    {
+      igtl::PlusScatterGatherImageMessage::Pointer scatterGatherMessage = igtl::PlusScatterGatherImageMessage::New();
+      scatterGatherMessage->SetHeaderVersion(igtlMessage->GetHeaderVersion());
+      imageMessage = scatterGatherMessage.GetPointer();
+    }
+    else
+    {
+      imageMessage = dynamic_cast<igtl::ImageMessage*>(igtlMessage->Clone().GetPointer());
+    }
+    igtl::MessageBase::Pointer streamMessage = compressedImageMessage.IsNotNull() ? static_cast<igtl::MessageBase*>(compressedImageMessage.GetPointer()) : static_cast<igtl::MessageBase*>(imageMessage.GetPointer());
     if (trackedFrame.IsFrameFieldDefined(igsioTrackedFrame::FIELD_FRIENDLY_DEVICE_NAME))
     {
       // Allow overriding of device name with something human readable
       // The transform name is passed in the metadata
       deviceName = trackedFrame.GetFrameField(igsioTrackedFrame::FIELD_FRIENDLY_DEVICE_NAME);
     }
-    imageMessage->SetDeviceName(deviceName.c_str());
+    streamMessage->SetDeviceName(deviceName.c_str());
 
     // Send igsioTrackedFrame::CustomFrameFields as meta data in the image message.
     std::vector<std::string> frameFields;
@@ -431,20 +616,91 @@ int vtkPlusIgtlMessageFactory::PackImageMessage(const PlusIgtlClientInfo& client
         LOG_WARNING("No metadata value for: " << *stringNameIterator)
         continue;
       }
-      imageMessage->SetMetaDataElement(*stringNameIterator, IANA_TYPE_US_ASCII, trackedFrame.GetFrameField(*stringNameIterator));
+      streamMessage->SetMetaDataElement(*stringNameIterator, IANA_TYPE_US_ASCII, trackedFrame.GetFrameField(*stringNameIterator));
     }
 
-    if (vtkPlusIgtlMessageCommon::PackImageMessage(imageMessage, trackedFrame, *matrix, imageStream.FrameConverter) != PLUS_SUCCESS)
+    if (compressedImageMessage.IsNotNull())
+    {
+      int codec = igtl::PlusCompressedImageMessage::CODEC_ZLIB;
+      int predictor = igtl::PlusCompressedImageMessage::PREDICTOR_NONE;
+      vtkPlusIgtlImageCompressor::GetCodecFromString(imageStream.Compression, codec);
+      vtkPlusIgtlImageCompressor::GetPredictorFromString(imageStream.CompressionPredictor, predictor);
+      imageStream.Compressor->SetCodec(codec);
+      imageStream.Compressor->SetPredictor(predictor);
+      imageStream.Compressor->SetKeyFrameInterval(imageStream.CompressionKeyFrameInterval);
+
+      vtkSmartPointer<vtkImageData> streamImage = imageStream.FrameConverter->GetUncompressedImage(trackedFrame.GetImageData());
+      if (imageStream.IsImageProcessingRequested())
+      {
+        streamImage = this->GetProcessedStreamImage(streamImage, imageStream);
+      }
+      if (streamImage == NULL || vtkPlusIgtlMessageCommon::PackCompressedImageMessage(compressedImageMessage, trackedFrame, streamImage, *matrix, imageStream.Compressor) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to create " << messageType << " message - unable to pack compressed image message");
+        numberOfErrors++;
+        continue;
+      }
+    }
+    else if (imageStream.IsImageProcessingRequested())
+    {
+      vtkSmartPointer<vtkImageData> frameImage = imageStream.FrameConverter->GetUncompressedImage(trackedFrame.GetImageData());
+      vtkSmartPointer<vtkImageData> streamImage = this->GetProcessedStreamImage(frameImage, imageStream);
+      if (streamImage == NULL || vtkPlusIgtlMessageCommon::PackImageMessage(imageMessage, trackedFrame, streamImage, *matrix) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to create " << messageType << " message - unable to pack processed image message");
+        numberOfErrors++;
+        continue;
+      }
+    }
+    else if (vtkPlusIgtlMessageCommon::PackImageMessage(imageMessage, trackedFrame, *matrix, imageStream.FrameConverter) != PLUS_SUCCESS)
     {
       LOG_ERROR("Failed to create " << messageType << " message - unable to pack image message");
       numberOfErrors++;
       continue;
     }
-    igtlMessages.push_back(imageMessage.GetPointer());
+    igtlMessages.push_back(streamMessage);
   }
   return numberOfErrors;
 }
 
+//----------------------------------------------------------------------------
+vtkSmartPointer<vtkImageData> vtkPlusIgtlMessageFactory::GetProcessedStreamImage(vtkImageData* frameImage, const PlusIgtlClientInfo::ImageStream& imageStream)
+{
+  if (frameImage == NULL)
+  {
+    LOG_ERROR("Unable to process image of image stream " << imageStream.Name << " - frame image is not available");
+    return NULL;
+  }
+
+  std::ostringstream processingKey;
+  processingKey << imageStream.ClipRectangleOrigin[0] << "," << imageStream.ClipRectangleOrigin[1] << ","
+                << imageStream.ClipRectangleSize[0] << "," << imageStream.ClipRectangleSize[1] << ","
+                << imageStream.DownsamplingFactor << "," << imageStream.ScalarType;
+
+  std::lock_guard<std::mutex> processedStreamImagesLock(this->ProcessedStreamImagesMutex);
+  if (this->ProcessedStreamImagesSource.GetPointer() != frameImage || this->ProcessedStreamImagesSourceMTime != frameImage->GetMTime())
+  {
+    // New frame, images of the previous frame may still be referenced by messages waiting to be sent, so they are released but not reused
+    this->ProcessedStreamImages.clear();
+    this->ProcessedStreamImagesSource = frameImage;
+    this->ProcessedStreamImagesSourceMTime = frameImage->GetMTime();
+  }
+
+  std::map<std::string, vtkSmartPointer<vtkImageData> >::iterator processedImageIt = this->ProcessedStreamImages.find(processingKey.str());
+  if (processedImageIt != this->ProcessedStreamImages.end())
+  {
+    return processedImageIt->second;
+  }
+
+  vtkSmartPointer<vtkImageData> processedImage = vtkSmartPointer<vtkImageData>::New();
+  if (vtkPlusIgtlMessageCommon::ProcessImageForStream(frameImage, imageStream, processedImage) != PLUS_SUCCESS)
+  {
+    return NULL;
+  }
+  this->ProcessedStreamImages[processingKey.str()] = processedImage;
+  return processedImage;
+}
+
 #if defined(OpenIGTLink_ENABLE_VIDEOSTREAMING)
 //----------------------------------------------------------------------------
 int vtkPlusIgtlMessageFactory::PackVideoMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, const std::string& messageType, igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages, int clientId)
@@ -496,10 +752,10 @@ int vtkPlusIgtlMessageFactory::PackVideoMessage(const PlusIgtlClientInfo& client
     if (!videoStream.EncodeVideoParameters.Lossless)
     {
       parameters["rateControl"] = videoStream.EncodeVideoParameters.RateControl;
-      parameters["minimumKeyFrameDistance"] = videoStream.EncodeVideoParameters.MinKeyframeDistance;
-      parameters["maximumKeyFrameDistance"] = videoStream.EncodeVideoParameters.MaxKeyframeDistance;
-      parameters["encodingSpeed"] = videoStream.EncodeVideoParameters.Speed;
-      parameters["bitRate"] = videoStream.EncodeVideoParameters.TargetBitrate;
+      parameters["minimumKeyFrameDistance"] = std::to_string(videoStream.EncodeVideoParameters.MinKeyframeDistance);
+      parameters["maximumKeyFrameDistance"] = std::to_string(videoStream.EncodeVideoParameters.MaxKeyframeDistance);
+      parameters["encodingSpeed"] = std::to_string(videoStream.EncodeVideoParameters.Speed);
+      parameters["bitRate"] = std::to_string(videoStream.EncodeVideoParameters.TargetBitrate);
       parameters["deadlineMode"] = videoStream.EncodeVideoParameters.DeadlineMode;
     }
 
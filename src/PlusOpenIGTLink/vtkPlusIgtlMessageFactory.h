@@ -11,7 +11,10 @@
 #include "vtkPlusOpenIGTLinkExport.h"
 
 // VTK includes
+#include "vtkImageData.h"
 #include "vtkObject.h"
+#include "vtkSmartPointer.h"
+#include "vtkWeakPointer.h"
 
 // OpenIGTLink includes
 #include "igtlMessageBase.h"
@@ -20,6 +23,13 @@
 // PlusLib includes
 #include "PlusIgtlClientInfo.h"
 
+// STL includes
+#include <array>
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+
 class vtkXMLDataElement;
 //class igsioTrackedFrame; 
 //class vtkIGSIOTransformRepository;
@@ -80,12 +90,115 @@ public:
   PlusStatus PackMessages(int clientId, const PlusIgtlClientInfo& clientInfo, std::vector<igtl::MessageBase::Pointer>& igtMessages, igsioTrackedFrame& trackedFrame,
                           bool packValidTransformsOnly, vtkIGSIOTransformRepository* transformRepository = NULL);
 
+  /*!
+  If enabled then IMAGE messages are packed as igtl::PlusScatterGatherImageMessage, which references the frame pixels
+  instead of copying them into the message. Such messages must be sent with vtkPlusIgtlMessageCommon::SendPackedMessage().
+  Disabled by default.
+  */
+  vtkSetMacro(ScatterGatherImageMessages, bool);
+  vtkGetMacro(ScatterGatherImageMessages, bool);
+  vtkBooleanMacro(ScatterGatherImageMessages, bool);
+
+  /*!
+  Forget which transforms were sent to a client, so that all its transforms are sent with the next frame.
+  Call when the client disconnects or changes its client info (see PlusIgtlClientInfo::GetSendChangedTransformsOnly).
+  */
+  void ResetPublishedTransforms(int clientId);
+
+  /*! Time spent in PackMessages for a message type, over all clients */
+  struct MessagePackStatistics
+  {
+    MessagePackStatistics()
+      : NumberOfPackedMessages(0)
+      , AveragePackTimeSec(0.0)
+      , MaxPackTimeSec(0.0)
+    {
+    }
+    unsigned long long NumberOfPackedMessages;
+    double AveragePackTimeSec;
+    double MaxPackTimeSec;
+  };
+
+  /*!
+  Get the packing time statistics by message type. Can be called from any thread.
+  Packing time is only measured while PlusCommon::GetPerformanceStatisticsEnabled() is true.
+  */
+  void GetMessagePackStatistics(std::map<std::string, MessagePackStatistics>& statistics) const;
+
 protected:
   vtkPlusIgtlMessageFactory();
   virtual ~vtkPlusIgtlMessageFactory();
 
   igtl::MessageFactory::Pointer IgtlFactory;
 
+  bool ScatterGatherImageMessages;
+
+  /*!
+  Get the image of an image stream that requests cropping, downsampling or pixel type conversion.
+  The processed image is computed once per frame for each unique set of processing parameters and shared
+  between all clients (and all image streams) that request the same parameters.
+  */
+  vtkSmartPointer<vtkImageData> GetProcessedStreamImage(vtkImageData* frameImage, const PlusIgtlClientInfo::ImageStream& imageStream);
+
+  /*! Processed images of the most recent frame image, by processing parameters */
+  std::map<std::string, vtkSmartPointer<vtkImageData> > ProcessedStreamImages;
+  /*! Frame image that ProcessedStreamImages were computed from */
+  vtkWeakPointer<vtkImageData> ProcessedStreamImagesSource;
+  vtkMTimeType ProcessedStreamImagesSourceMTime;
+  std::mutex ProcessedStreamImagesMutex;
+
+  /*! Last sent value of a transform, for suppressing unchanged transforms */
+  struct PublishedTransform
+  {
+    std::array<double, 16> Matrix;
+    ToolStatus Status;
+    double Timestamp;
+  };
+
+  /*!
+  Returns true if the transform has to be sent to the client: change-only publishing is disabled for the client,
+  the transform or its status changed beyond the client's thresholds, or the refresh interval elapsed.
+  If true is returned then the transform is recorded as sent.
+  */
+  bool IsTransformPublishRequired(int clientId, const PlusIgtlClientInfo& clientInfo, const std::string& messageType, const igsioTransformName& transformName,
+                                  vtkMatrix4x4* matrix, ToolStatus status, double timestamp);
+
+  /*! Last sent transforms by client ID, then by message type and transform name */
+  std::map<int, std::map<std::string, PublishedTransform> > PublishedTransforms;
+  std::mutex PublishedTransformsMutex;
+
+  /*! Message types that PackMessages can pack, used for indexing the packing time counters */
+  enum PackedMessageType
+  {
+    PACKED_IMAGE,
+    PACKED_VIDEO,
+    PACKED_TRANSFORM,
+    PACKED_TDATA,
+    PACKED_POSITION,
+    PACKED_TRACKEDFRAME,
+    PACKED_USMESSAGE,
+    PACKED_STRING,
+    PACKED_COMMAND,
+    NUMBER_OF_PACKED_MESSAGE_TYPES
+  };
+
+  /*! Packing time counters of a message type, updated without locking */
+  struct MessagePackCounters
+  {
+    MessagePackCounters()
+      : NumberOfPackedMessages(0)
+      , TotalPackTimeNs(0)
+      , MaxPackTimeNs(0)
+    {
+    }
+    std::atomic<unsigned long long> NumberOfPackedMessages;
+    std::atomic<unsigned long long> TotalPackTimeNs;
+    std::atomic<unsigned long long> MaxPackTimeNs;
+  };
+
+  /*! Packing time counters, indexed by PackedMessageType */
+  std::array<MessagePackCounters, NUMBER_OF_PACKED_MESSAGE_TYPES> MessagePackCountersByType;
+
 protected:
   int PackImageMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, const std::string& messageType,
                        igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages, int clientId);
@@ -94,11 +207,11 @@ protected:
                        igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages, int clientId);
 #endif
   int PackTransformMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, bool packValidTransformsOnly,
-                           igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages);
+                           igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages, int clientId);
   int PackTrackingDataMessage(const PlusIgtlClientInfo& clientInfo, igsioTrackedFrame& trackedFrame, vtkIGSIOTransformRepository& transformRepository, bool packValidTransformsOnly,
-                              igtl::MessageBase::Pointer igtlMessage, std::vector<igtl::MessageBase::Pointer>& igtlMessages);
+                              igtl::MessageBase::Pointer igtlMessage, std::vector<igtl::MessageBase::Pointer>& igtlMessages, int clientId);
   int PackPositionMessage(const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository, igtl::MessageBase::Pointer igtlMessage,
-                          igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages);
+                          igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages, int clientId);
   int PackTrackedFrameMessage(igtl::MessageBase::Pointer igtlMessage, const PlusIgtlClientInfo& clientInfo, vtkIGSIOTransformRepository& transformRepository,
                               igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages);
   int PackUsMessage(igtl::MessageBase::Pointer igtlMessage, igsioTrackedFrame& trackedFrame, std::vector<igtl::MessageBase::Pointer>& igtlMessages);
@@ -0,0 +1,182 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusIgtlSharedMemoryRing.h"
+#include "igtlPlusSharedMemoryNotificationMessage.h"
+#include "vtkPlusIgtlMessageFactory.h"
+#include "vtkPlusIgtlSharedMemoryReceiver.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+
+// IGTL includes
+#include <igtlMessageHeader.h>
+
+// STL includes
+#include <cstring>
+
+vtkStandardNewMacro(vtkPlusIgtlSharedMemoryReceiver);
+
+//----------------------------------------------------------------------------
+vtkPlusIgtlSharedMemoryReceiver::vtkPlusIgtlSharedMemoryReceiver()
+  : Ring(new PlusIgtlSharedMemoryRing)
+  , MessageFactory(vtkSmartPointer<vtkPlusIgtlMessageFactory>::New())
+  , CrcCheck(true)
+  , LastReadSequence(0)
+  , NumberOfMissedItems(0)
+{
+}
+
+//----------------------------------------------------------------------------
+vtkPlusIgtlSharedMemoryReceiver::~vtkPlusIgtlSharedMemoryReceiver()
+{
+  this->Close();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusIgtlSharedMemoryReceiver::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "Ring: " << (this->Ring->IsOpen() ? this->Ring->GetName() : std::string("(none)")) << std::endl;
+  os << indent << "CrcCheck: " << (this->CrcCheck ? "true" : "false") << std::endl;
+  os << indent << "LastReadSequence: " << this->LastReadSequence << std::endl;
+  os << indent << "NumberOfMissedItems: " << this->NumberOfMissedItems << std::endl;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlSharedMemoryReceiver::ProcessNotification(igtl::PlusSharedMemoryNotificationMessage* notification, std::vector<igtl::MessageBase::Pointer>& messages)
+{
+  if (notification == NULL)
+  {
+    LOG_ERROR("vtkPlusIgtlSharedMemoryReceiver::ProcessNotification failed: invalid notification message");
+    return PLUS_FAIL;
+  }
+  if (notification->GetRingName().empty())
+  {
+    // The server stopped using the shared memory transport
+    this->Close();
+    return PLUS_SUCCESS;
+  }
+  if (!this->Ring->IsOpen() || this->Ring->GetName() != notification->GetRingName())
+  {
+    this->Close();
+    if (this->Ring->Open(notification->GetRingName()) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to open shared memory ring announced by the server: " << notification->GetRingName());
+      return PLUS_FAIL;
+    }
+    // Only items that are written after the ring is opened (or announced by this notification) are read
+    this->LastReadSequence = this->Ring->GetWriteSequence();
+    if (notification->GetSequence() > 0 && notification->GetSequence() - 1 < this->LastReadSequence)
+    {
+      this->LastReadSequence = notification->GetSequence() - 1;
+    }
+    LOG_INFO("Shared memory transport is active (ring " << this->Ring->GetName() << ", " << this->Ring->GetNumberOfSlots() << " slots of " << this->Ring->GetSlotSize() << " bytes)");
+  }
+  return this->ReadNewMessages(messages);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlSharedMemoryReceiver::ReadNewMessages(std::vector<igtl::MessageBase::Pointer>& messages)
+{
+  if (!this->Ring->IsOpen())
+  {
+    return PLUS_SUCCESS;
+  }
+  uint64_t writeSequence = this->Ring->GetWriteSequence();
+  if (writeSequence <= this->LastReadSequence)
+  {
+    return PLUS_SUCCESS;
+  }
+  // Items older than the ring size are already overwritten
+  uint64_t firstSequence = this->LastReadSequence + 1;
+  if (writeSequence - this->LastReadSequence > this->Ring->GetNumberOfSlots())
+  {
+    firstSequence = writeSequence - this->Ring->GetNumberOfSlots() + 1;
+    this->NumberOfMissedItems += firstSequence - this->LastReadSequence - 1;
+  }
+
+  PlusStatus status = PLUS_SUCCESS;
+  for (uint64_t sequence = firstSequence; sequence <= writeSequence; ++sequence)
+  {
+    if (this->ReadItem(sequence, messages) != PLUS_SUCCESS)
+    {
+      this->NumberOfMissedItems++;
+      status = PLUS_FAIL;
+    }
+    this->LastReadSequence = sequence;
+  }
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusIgtlSharedMemoryReceiver::ReadItem(uint64_t sequence, std::vector<igtl::MessageBase::Pointer>& messages)
+{
+  size_t itemSize = 0;
+  const unsigned char* itemData = this->Ring->GetItemData(sequence, itemSize);
+  if (itemData == NULL)
+  {
+    return PLUS_FAIL;
+  }
+
+  // Copy all messages out of the ring first, the item is only known to be intact after it is completely read
+  std::vector<igtl::MessageBase::Pointer> itemMessages;
+  size_t offset = 0;
+  while (offset + IGTL_HEADER_SIZE <= itemSize)
+  {
+    igtl::MessageHeader::Pointer headerMsg = this->MessageFactory->CreateHeaderMessage(IGTL_HEADER_VERSION_1);
+    memcpy(headerMsg->GetBufferPointer(), itemData + offset, IGTL_HEADER_SIZE);
+    offset += IGTL_HEADER_SIZE;
+    int c = headerMsg->Unpack(this->CrcCheck ? 1 : 0);
+    if (!(c & igtl::MessageHeader::UNPACK_HEADER) || headerMsg->GetBodySizeToRead() > itemSize - offset)
+    {
+      // Either the item is overwritten or it is corrupt
+      return PLUS_FAIL;
+    }
+    igtl::MessageBase::Pointer bodyMsg = this->MessageFactory->CreateReceiveMessage(headerMsg);
+    if (bodyMsg.IsNull())
+    {
+      LOG_ERROR("Unable to create message of type: " << headerMsg->GetMessageType());
+      return PLUS_FAIL;
+    }
+    bodyMsg->SetMessageHeader(headerMsg);
+    bodyMsg->AllocateBuffer();
+    memcpy(bodyMsg->GetBufferBodyPointer(), itemData + offset, headerMsg->GetBodySizeToRead());
+    offset += headerMsg->GetBodySizeToRead();
+    itemMessages.push_back(bodyMsg);
+  }
+  if (!this->Ring->IsItemValid(sequence))
+  {
+    return PLUS_FAIL;
+  }
+
+  for (std::vector<igtl::MessageBase::Pointer>::iterator messageIt = itemMessages.begin(); messageIt != itemMessages.end(); ++messageIt)
+  {
+    int c = (*messageIt)->Unpack(this->CrcCheck ? 1 : 0);
+    if (!(c & igtl::MessageHeader::UNPACK_BODY))
+    {
+      LOG_ERROR("Failed to unpack " << (*messageIt)->GetMessageType() << " message from shared memory ring");
+      continue;
+    }
+    messages.push_back(*messageIt);
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusIgtlSharedMemoryReceiver::Close()
+{
+  this->Ring->Close();
+  this->LastReadSequence = 0;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusIgtlSharedMemoryReceiver::IsOpen() const
+{
+  return this->Ring->IsOpen();
+}
@@ -0,0 +1,100 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusIgtlSharedMemoryReceiver_h
+#define __vtkPlusIgtlSharedMemoryReceiver_h
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusOpenIGTLinkExport.h"
+
+// VTK includes
+#include <vtkObject.h>
+#include <vtkSmartPointer.h>
+
+// IGTL includes
+#include <igtlMessageBase.h>
+
+// STL includes
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+class PlusIgtlSharedMemoryRing;
+class vtkPlusIgtlMessageFactory;
+
+namespace igtl
+{
+  class PlusSharedMemoryNotificationMessage;
+}
+
+/*!
+  \class vtkPlusIgtlSharedMemoryReceiver
+  \brief Client side of the shared memory transport of the Plus OpenIGTLink server
+
+  A client on the same host as the server may request the shared memory transport by setting
+  SharedMemoryTransport in its CLIENTINFO message. If the server accepts it, the server announces a shared memory ring
+  (see PlusIgtlSharedMemoryRing) with a SHMNOTIFY message, then writes the messages of each tracked frame into the ring
+  and sends only a small SHMNOTIFY message on the socket. The client passes the received SHMNOTIFY messages to
+  ProcessNotification(), which returns the unpacked messages, as if they were received on the socket.
+
+  Notifications may be dropped by the server for slow clients, therefore all items written since the last read
+  are returned. Items that were overwritten in the ring before they could be read are counted in NumberOfMissedItems.
+
+  \ingroup PlusLibOpenIGTLink
+*/
+class vtkPlusOpenIGTLinkExport vtkPlusIgtlSharedMemoryReceiver : public vtkObject
+{
+public:
+  static vtkPlusIgtlSharedMemoryReceiver* New();
+  vtkTypeMacro(vtkPlusIgtlSharedMemoryReceiver, vtkObject);
+  virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
+
+  /*!
+    Process a SHMNOTIFY message received from the server. Opens the announced ring if needed
+    and appends the messages of all new items to the list.
+  */
+  PlusStatus ProcessNotification(igtl::PlusSharedMemoryNotificationMessage* notification, std::vector<igtl::MessageBase::Pointer>& messages);
+
+  /*! Append the unpacked messages of all items that were written since the last read to the list */
+  PlusStatus ReadNewMessages(std::vector<igtl::MessageBase::Pointer>& messages);
+
+  /*! Close the ring */
+  void Close();
+
+  /*! Returns true if a ring is open */
+  bool IsOpen() const;
+
+  /*! If enabled then the CRC of the messages is checked when they are unpacked */
+  vtkSetMacro(CrcCheck, bool);
+  vtkGetMacro(CrcCheck, bool);
+  vtkBooleanMacro(CrcCheck, bool);
+
+  /*! Sequence number of the most recently read item */
+  vtkGetMacro(LastReadSequence, uint64_t);
+
+  /*! Number of items that were overwritten by the server before they could be read */
+  vtkGetMacro(NumberOfMissedItems, uint64_t);
+
+protected:
+  vtkPlusIgtlSharedMemoryReceiver();
+  virtual ~vtkPlusIgtlSharedMemoryReceiver();
+
+  /*! Unpack the messages of one item. Returns PLUS_FAIL if the item was overwritten or it is invalid. */
+  PlusStatus ReadItem(uint64_t sequence, std::vector<igtl::MessageBase::Pointer>& messages);
+
+  std::unique_ptr<PlusIgtlSharedMemoryRing> Ring;
+  vtkSmartPointer<vtkPlusIgtlMessageFactory> MessageFactory;
+  bool CrcCheck;
+  uint64_t LastReadSequence;
+  uint64_t NumberOfMissedItems;
+
+private:
+  vtkPlusIgtlSharedMemoryReceiver(const vtkPlusIgtlSharedMemoryReceiver&);
+  void operator=(const vtkPlusIgtlSharedMemoryReceiver&);
+};
+
+#endif
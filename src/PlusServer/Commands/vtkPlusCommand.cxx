@@ -35,6 +35,18 @@ void vtkPlusCommand::PrintSelf(ostream& os, vtkIndent indent)
   this->Superclass::PrintSelf(os, indent);
 }
 
+//----------------------------------------------------------------------------
+vtkPlusCommand::ExecutionModeType vtkPlusCommand::GetExecutionMode() const
+{
+  return EXECUTION_MODE_EXCLUSIVE;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusCommand::GetExecutionDeviceId() const
+{
+  return std::string();
+}
+
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusCommand::ReadConfiguration(vtkXMLDataElement* aConfig)
 {
@@ -34,6 +34,18 @@ public:
   static const std::string DEVICE_NAME_COMMAND;
   static const std::string DEVICE_NAME_REPLY;
 
+  /*! Defines which commands the command processor may execute at the same time */
+  enum ExecutionModeType
+  {
+    /*!
+      The command does not change state that other commands use (transform repository, device set configuration, etc.).
+      It may only change the device returned by GetExecutionDeviceId().
+    */
+    EXECUTION_MODE_READ_ONLY,
+    /*! No other command may run while this command is executed */
+    EXECUTION_MODE_EXCLUSIVE
+  };
+
   virtual vtkPlusCommand* Clone() = 0;
 
   virtual void PrintSelf(ostream& os, vtkIndent indent);
@@ -67,6 +79,15 @@ public:
   /*! Returns the list of command names that this command can process */
   virtual void GetCommandNames(std::list<std::string>& cmdNames) = 0;
 
+  /*! Returns how the command has to be scheduled relative to other commands. Commands are exclusive by default. */
+  virtual ExecutionModeType GetExecutionMode() const;
+
+  /*!
+    Returns the id of the device that a read-only command operates on. Commands with the same device id are executed
+    one after the other, in the order they were received. Empty if the command does not need to be serialized.
+  */
+  virtual std::string GetExecutionDeviceId() const;
+
   void SetMetaData(const igtl::MessageBase::MetaDataMap& metaData);
 
   vtkGetMacro(RespondWithCommandMessage, bool);
@@ -39,6 +39,12 @@ void vtkPlusGetImageCommand::PrintSelf(ostream& os, vtkIndent indent)
   this->Superclass::PrintSelf(os, indent);
 }
 
+//----------------------------------------------------------------------------
+vtkPlusCommand::ExecutionModeType vtkPlusGetImageCommand::GetExecutionMode() const
+{
+  return EXECUTION_MODE_READ_ONLY;
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusGetImageCommand::GetCommandNames(std::list<std::string>& cmdNames)
 {
@@ -37,6 +37,9 @@ public:
   /*! Gets the description for the specified command name. */
   virtual std::string GetDescription(const std::string& commandName);
 
+  /*! Images are read from the buffers of the devices, which are thread-safe, so it can run concurrently with other commands */
+  virtual ExecutionModeType GetExecutionMode() const;
+
   void SetNameToGetImageMeta();
   void SetNameToGetImage();
 
@@ -75,6 +75,12 @@ PlusStatus vtkPlusGetPolydataCommand::WriteConfiguration(vtkXMLDataElement* aCon
   return Superclass::WriteConfiguration(aConfig);
 }
 
+//----------------------------------------------------------------------------
+vtkPlusCommand::ExecutionModeType vtkPlusGetPolydataCommand::GetExecutionMode() const
+{
+  return EXECUTION_MODE_READ_ONLY;
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusGetPolydataCommand::GetCommandNames(std::list<std::string>& cmdNames)
 {
@@ -39,6 +39,9 @@ public:
   /*! Gets the description for the specified command name. */
   virtual std::string GetDescription(const std::string& commandName);
 
+  /*! Only reads a file and sends its contents, so it can run concurrently with other commands */
+  virtual ExecutionModeType GetExecutionMode() const;
+
   void SetNameToGetPolydata();
 
   /*! Id of the device */
@@ -0,0 +1,268 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "vtkPlusBuffer.h"
+#include "vtkPlusCommandProcessor.h"
+#include "vtkPlusDataCollector.h"
+#include "vtkPlusDataSource.h"
+#include "vtkPlusDevice.h"
+#include "vtkPlusGetServerStatisticsCommand.h"
+#include "vtkPlusOpenIGTLinkServer.h"
+
+#include <vtkXMLDataElement.h>
+
+#include <sstream>
+
+vtkStandardNewMacro(vtkPlusGetServerStatisticsCommand);
+
+namespace
+{
+  static const std::string GET_SERVER_STATISTICS_CMD = "GetServerStatistics";
+
+  //----------------------------------------------------------------------------
+  void AddBufferStatistics(vtkXMLDataElement* statisticsElement, vtkPlusDevice* device, DataSourceContainerConstIterator sourceBegin, DataSourceContainerConstIterator sourceEnd)
+  {
+    for (DataSourceContainerConstIterator sourceIt = sourceBegin; sourceIt != sourceEnd; ++sourceIt)
+    {
+      vtkPlusBuffer* buffer = sourceIt->second->GetBuffer();
+      if (buffer == NULL)
+      {
+        continue;
+      }
+      unsigned long long numberOfLocks(0);
+      double totalLockWaitTimeSec(0.0);
+      double maxLockWaitTimeSec(0.0);
+      buffer->GetLockWaitTimeStatistics(numberOfLocks, totalLockWaitTimeSec, maxLockWaitTimeSec);
+      int bufferSize = buffer->GetBufferSize();
+
+      vtkSmartPointer<vtkXMLDataElement> bufferElement = vtkSmartPointer<vtkXMLDataElement>::New();
+      bufferElement->SetName("Buffer");
+      bufferElement->SetAttribute("DeviceId", device->GetDeviceId().c_str());
+      bufferElement->SetAttribute("SourceId", sourceIt->second->GetSourceId().c_str());
+      bufferElement->SetIntAttribute("NumberOfItems", buffer->GetNumberOfItems());
+      bufferElement->SetIntAttribute("BufferSize", bufferSize);
+      bufferElement->SetDoubleAttribute("FillRatio", bufferSize > 0 ? static_cast<double>(buffer->GetNumberOfItems()) / bufferSize : 0.0);
+      bufferElement->SetAttribute("NumberOfMeasuredLocks", std::to_string(numberOfLocks).c_str());
+      bufferElement->SetDoubleAttribute("AverageLockWaitTimeSec", numberOfLocks > 0 ? totalLockWaitTimeSec / numberOfLocks : 0.0);
+      bufferElement->SetDoubleAttribute("MaxLockWaitTimeSec", maxLockWaitTimeSec);
+      statisticsElement->AddNestedElement(bufferElement);
+    }
+  }
+
+  //----------------------------------------------------------------------------
+  // Measured acquisition rate of a device, computed from the buffer of its first data source
+  vtkPlusBuffer* GetFirstDataSourceBuffer(vtkPlusDevice* device)
+  {
+    if (device->GetVideoSourceIteratorBegin() != device->GetVideoSourceIteratorEnd())
+    {
+      return device->GetVideoSourceIteratorBegin()->second->GetBuffer();
+    }
+    if (device->GetToolIteratorBegin() != device->GetToolIteratorEnd())
+    {
+      return device->GetToolIteratorBegin()->second->GetBuffer();
+    }
+    if (device->GetFieldDataSourcessIteratorBegin() != device->GetFieldDataSourcessIteratorEnd())
+    {
+      return device->GetFieldDataSourcessIteratorBegin()->second->GetBuffer();
+    }
+    return NULL;
+  }
+}
+
+//----------------------------------------------------------------------------
+vtkPlusGetServerStatisticsCommand::vtkPlusGetServerStatisticsCommand()
+  : EnableMeasurement(true)
+{
+  // It handles only one command, set its name by default
+  this->SetName(GET_SERVER_STATISTICS_CMD);
+}
+
+//----------------------------------------------------------------------------
+vtkPlusGetServerStatisticsCommand::~vtkPlusGetServerStatisticsCommand()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusGetServerStatisticsCommand::SetNameToGetServerStatistics()
+{
+  this->SetName(GET_SERVER_STATISTICS_CMD);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusGetServerStatisticsCommand::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "EnableMeasurement: " << (this->EnableMeasurement ? "true" : "false") << std::endl;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusCommand::ExecutionModeType vtkPlusGetServerStatisticsCommand::GetExecutionMode() const
+{
+  return EXECUTION_MODE_READ_ONLY;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusGetServerStatisticsCommand::GetCommandNames(std::list<std::string>& cmdNames)
+{
+  cmdNames.clear();
+  cmdNames.push_back(GET_SERVER_STATISTICS_CMD);
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusGetServerStatisticsCommand::GetDescription(const std::string& commandName)
+{
+  std::string desc;
+  if (commandName.empty() || igsioCommon::IsEqualInsensitive(commandName, GET_SERVER_STATISTICS_CMD))
+  {
+    desc += GET_SERVER_STATISTICS_CMD;
+    desc += ": Get acquisition rates, buffer fill levels and lock wait times, client send rates and queue depths, message packing times and command round-trip times."
+            " Attributes: EnableMeasurement: set to FALSE to stop measuring lock wait and packing times (default: TRUE).";
+  }
+  return desc;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusGetServerStatisticsCommand::ReadConfiguration(vtkXMLDataElement* aConfig)
+{
+  if (vtkPlusCommand::ReadConfiguration(aConfig) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(EnableMeasurement, aConfig);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusGetServerStatisticsCommand::WriteConfiguration(vtkXMLDataElement* aConfig)
+{
+  if (vtkPlusCommand::WriteConfiguration(aConfig) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  XML_WRITE_BOOL_ATTRIBUTE(EnableMeasurement, aConfig);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusGetServerStatisticsCommand::Execute()
+{
+  vtkPlusOpenIGTLinkServer* server = this->CommandProcessor->GetPlusServer();
+  vtkPlusDataCollector* dataCollector = this->GetDataCollector();
+  if (server == NULL || dataCollector == NULL)
+  {
+    this->QueueCommandResponse(PLUS_FAIL, "Command failed. See error message.", "Server statistics are not available.");
+    return PLUS_FAIL;
+  }
+
+  // Lock wait and packing times are not measured until somebody asks for them, the first response reports no such statistics
+  if (this->EnableMeasurement && !PlusCommon::GetPerformanceStatisticsEnabled())
+  {
+    LOG_INFO("Performance statistics measurement enabled");
+    PlusCommon::SetPerformanceStatisticsEnabled(true);
+  }
+
+  vtkSmartPointer<vtkXMLDataElement> statisticsElement = vtkSmartPointer<vtkXMLDataElement>::New();
+  statisticsElement->SetName("ServerStatistics");
+  statisticsElement->SetDoubleAttribute("SystemTime", vtkIGSIOAccurateTimer::GetSystemTime());
+
+  // Devices and their buffers
+  DeviceCollection devices;
+  dataCollector->GetDevices(devices);
+  for (DeviceCollectionConstIterator deviceIt = devices.begin(); deviceIt != devices.end(); ++deviceIt)
+  {
+    vtkPlusDevice* device = *deviceIt;
+    vtkSmartPointer<vtkXMLDataElement> deviceElement = vtkSmartPointer<vtkXMLDataElement>::New();
+    deviceElement->SetName("Device");
+    deviceElement->SetAttribute("Id", device->GetDeviceId().c_str());
+    deviceElement->SetDoubleAttribute("AcquisitionRate", device->GetAcquisitionRate());
+    vtkPlusBuffer* buffer = GetFirstDataSourceBuffer(device);
+    if (buffer != NULL)
+    {
+      double framePeriodStdevSec(0.0);
+      deviceElement->SetDoubleAttribute("MeasuredAcquisitionRate", buffer->GetFrameRate(false, &framePeriodStdevSec));
+      deviceElement->SetDoubleAttribute("FramePeriodStdevSec", framePeriodStdevSec);
+    }
+    statisticsElement->AddNestedElement(deviceElement);
+
+    AddBufferStatistics(statisticsElement, device, device->GetVideoSourceIteratorBegin(), device->GetVideoSourceIteratorEnd());
+    AddBufferStatistics(statisticsElement, device, device->GetToolIteratorBegin(), device->GetToolIteratorEnd());
+    AddBufferStatistics(statisticsElement, device, device->GetFieldDataSourcessIteratorBegin(), device->GetFieldDataSourcessIteratorEnd());
+  }
+
+  // Clients
+  std::vector<unsigned int> clientIds;
+  server->GetConnectedClientIds(clientIds);
+  double totalSentBytesPerSec(0.0);
+  for (std::vector<unsigned int>::const_iterator clientIt = clientIds.begin(); clientIt != clientIds.end(); ++clientIt)
+  {
+    ClientSendStatistics sendStatistics;
+    if (server->GetClientSendStatistics(*clientIt, sendStatistics) != PLUS_SUCCESS)
+    {
+      // Disconnected since the list was retrieved
+      continue;
+    }
+    totalSentBytesPerSec += sendStatistics.SentBytesPerSec;
+    vtkSmartPointer<vtkXMLDataElement> clientElement = vtkSmartPointer<vtkXMLDataElement>::New();
+    clientElement->SetName("Client");
+    clientElement->SetIntAttribute("Id", *clientIt);
+    clientElement->SetIntAttribute("QueueLength", sendStatistics.QueueLength);
+    clientElement->SetIntAttribute("MaxQueueLength", sendStatistics.MaxQueueLength);
+    clientElement->SetAttribute("NumberOfSentItems", std::to_string(sendStatistics.NumberOfSentItems).c_str());
+    clientElement->SetAttribute("NumberOfDroppedItems", std::to_string(sendStatistics.NumberOfDroppedItems).c_str());
+    clientElement->SetAttribute("NumberOfSentBytes", std::to_string(sendStatistics.NumberOfSentBytes).c_str());
+    clientElement->SetDoubleAttribute("SentItemsPerSec", sendStatistics.SentItemsPerSec);
+    clientElement->SetDoubleAttribute("SentBytesPerSec", sendStatistics.SentBytesPerSec);
+    clientElement->SetDoubleAttribute("LastSendLagSec", sendStatistics.LastSendLagSec);
+    clientElement->SetDoubleAttribute("MaxSendLagSec", sendStatistics.MaxSendLagSec);
+    statisticsElement->AddNestedElement(clientElement);
+  }
+
+  // Message packing
+  std::map<std::string, vtkPlusIgtlMessageFactory::MessagePackStatistics> packStatistics;
+  server->GetMessagePackStatistics(packStatistics);
+  for (std::map<std::string, vtkPlusIgtlMessageFactory::MessagePackStatistics>::const_iterator it = packStatistics.begin(); it != packStatistics.end(); ++it)
+  {
+    vtkSmartPointer<vtkXMLDataElement> messageTypeElement = vtkSmartPointer<vtkXMLDataElement>::New();
+    messageTypeElement->SetName("MessageType");
+    messageTypeElement->SetAttribute("Type", it->first.c_str());
+    messageTypeElement->SetAttribute("NumberOfPackedMessages", std::to_string(it->second.NumberOfPackedMessages).c_str());
+    messageTypeElement->SetDoubleAttribute("AveragePackTimeSec", it->second.AveragePackTimeSec);
+    messageTypeElement->SetDoubleAttribute("MaxPackTimeSec", it->second.MaxPackTimeSec);
+    statisticsElement->AddNestedElement(messageTypeElement);
+  }
+
+  // Commands
+  std::map<std::string, CommandExecutionStatistics> commandStatistics;
+  this->CommandProcessor->GetCommandExecutionStatistics(commandStatistics);
+  for (std::map<std::string, CommandExecutionStatistics>::const_iterator it = commandStatistics.begin(); it != commandStatistics.end(); ++it)
+  {
+    vtkSmartPointer<vtkXMLDataElement> commandElement = vtkSmartPointer<vtkXMLDataElement>::New();
+    commandElement->SetName("Command");
+    commandElement->SetAttribute("Name", it->first.c_str());
+    commandElement->SetAttribute("NumberOfExecutedCommands", std::to_string(it->second.NumberOfExecutedCommands).c_str());
+    commandElement->SetDoubleAttribute("AverageRoundTripTimeSec", it->second.AverageRoundTripTimeSec);
+    commandElement->SetDoubleAttribute("MaxRoundTripTimeSec", it->second.MaxRoundTripTimeSec);
+    commandElement->SetDoubleAttribute("AverageQueueWaitTimeSec", it->second.AverageQueueWaitTimeSec);
+    statisticsElement->AddNestedElement(commandElement);
+  }
+
+  igtl::MessageBase::MetaDataMap metadata;
+  metadata["NumberOfDevices"] = std::pair<IANA_ENCODING_TYPE, std::string>(IANA_TYPE_US_ASCII, std::to_string(devices.size()));
+  metadata["NumberOfClients"] = std::pair<IANA_ENCODING_TYPE, std::string>(IANA_TYPE_US_ASCII, std::to_string(clientIds.size()));
+  metadata["SentBytesPerSec"] = std::pair<IANA_ENCODING_TYPE, std::string>(IANA_TYPE_US_ASCII, std::to_string(totalSentBytesPerSec));
+
+  if (!this->EnableMeasurement && PlusCommon::GetPerformanceStatisticsEnabled())
+  {
+    LOG_INFO("Performance statistics measurement disabled");
+    PlusCommon::SetPerformanceStatisticsEnabled(false);
+  }
+
+  std::ostringstream message;
+  statisticsElement->PrintXML(message, vtkIndent(0));
+  this->QueueCommandResponse(PLUS_SUCCESS, message.str(), "", &metadata);
+  return PLUS_SUCCESS;
+}
@@ -0,0 +1,69 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusGetServerStatisticsCommand_h
+#define __vtkPlusGetServerStatisticsCommand_h
+
+#include "vtkPlusServerExport.h"
+
+#include "vtkPlusCommand.h"
+
+/*!
+  \class vtkPlusGetServerStatisticsCommand
+  \brief This command returns a snapshot of the performance statistics of the server
+
+  The response message is a ServerStatistics XML element with one child element per device (acquisition rate and jitter),
+  data source buffer (fill level and lock wait time), client (send queue depth and send rates), packed message type
+  (packing time) and executed command (round-trip time).
+  Buffer lock wait times and message packing times are only measured after the command is executed the first time.
+  Executing the command with EnableMeasurement="FALSE" returns the statistics collected so far and stops measuring them.
+  \ingroup PlusLibPlusServer
+ */
+class vtkPlusServerExport vtkPlusGetServerStatisticsCommand : public vtkPlusCommand
+{
+public:
+
+  static vtkPlusGetServerStatisticsCommand* New();
+  vtkTypeMacro(vtkPlusGetServerStatisticsCommand, vtkPlusCommand);
+  virtual void PrintSelf(ostream& os, vtkIndent indent);
+  virtual vtkPlusCommand* Clone() { return New(); }
+
+  /*! Executes the command  */
+  virtual PlusStatus Execute();
+
+  /*! Read command parameters from XML */
+  virtual PlusStatus ReadConfiguration(vtkXMLDataElement* aConfig);
+
+  /*! Write command parameters to XML */
+  virtual PlusStatus WriteConfiguration(vtkXMLDataElement* aConfig);
+
+  /*! Get all the command names that this class can execute */
+  virtual void GetCommandNames(std::list<std::string>& cmdNames);
+
+  /*! Gets the description for the specified command name. */
+  virtual std::string GetDescription(const std::string& commandName);
+
+  /*! Only reads counters, so it can run concurrently with other commands */
+  virtual ExecutionModeType GetExecutionMode() const;
+
+  void SetNameToGetServerStatistics();
+
+  /*! If false then measuring lock wait and packing times is stopped after the statistics are collected (default: true) */
+  vtkGetMacro(EnableMeasurement, bool);
+  vtkSetMacro(EnableMeasurement, bool);
+
+protected:
+  vtkPlusGetServerStatisticsCommand();
+  virtual ~vtkPlusGetServerStatisticsCommand();
+
+  bool EnableMeasurement;
+
+private:
+  vtkPlusGetServerStatisticsCommand(const vtkPlusGetServerStatisticsCommand&);
+  void operator=(const vtkPlusGetServerStatisticsCommand&);
+};
+
+#endif
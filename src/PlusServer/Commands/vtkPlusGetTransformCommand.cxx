@@ -34,6 +34,12 @@ void vtkPlusGetTransformCommand::SetNameToGetTransform()
   this->SetName(GET_TRANSFORM_CMD);
 }
 
+//----------------------------------------------------------------------------
+vtkPlusCommand::ExecutionModeType vtkPlusGetTransformCommand::GetExecutionMode() const
+{
+  return EXECUTION_MODE_READ_ONLY;
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusGetTransformCommand::GetCommandNames(std::list<std::string>& cmdNames)
 {
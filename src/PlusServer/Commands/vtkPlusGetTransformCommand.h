@@ -40,6 +40,9 @@ public:
   /*! Gets the description for the specified command name. */
   virtual std::string GetDescription(const std::string& commandName);
 
+  /*! Only reads the transform repository, so it can run concurrently with other commands */
+  virtual ExecutionModeType GetExecutionMode() const;
+
   vtkGetStdStringMacro(TransformName);
   vtkSetStdStringMacro(TransformName);
 
@@ -53,6 +53,18 @@ void vtkPlusGetUsParameterCommand::PrintSelf(ostream& os, vtkIndent indent)
   this->Superclass::PrintSelf(os, indent);
 }
 
+//----------------------------------------------------------------------------
+vtkPlusCommand::ExecutionModeType vtkPlusGetUsParameterCommand::GetExecutionMode() const
+{
+  return this->UsDeviceId.empty() ? EXECUTION_MODE_EXCLUSIVE : EXECUTION_MODE_READ_ONLY;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusGetUsParameterCommand::GetExecutionDeviceId() const
+{
+  return this->UsDeviceId;
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusGetUsParameterCommand::GetCommandNames(std::list<std::string>& cmdNames)
 {
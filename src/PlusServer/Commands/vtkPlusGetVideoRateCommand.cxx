@@ -0,0 +1,126 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+#include "PlusConfigure.h"
+#include "vtkPlusCommandProcessor.h"
+#include "vtkPlusGetVideoRateCommand.h"
+#include "vtkPlusOpenIGTLinkServer.h"
+
+#include <sstream>
+
+vtkStandardNewMacro(vtkPlusGetVideoRateCommand);
+
+namespace
+{
+  static const std::string GET_VIDEO_RATE_CMD = "GetVideoRate";
+}
+
+//----------------------------------------------------------------------------
+vtkPlusGetVideoRateCommand::vtkPlusGetVideoRateCommand()
+  : TargetClientId(-1)
+{
+  // It handles only one command, set its name by default
+  this->SetName(GET_VIDEO_RATE_CMD);
+}
+
+//----------------------------------------------------------------------------
+vtkPlusGetVideoRateCommand::~vtkPlusGetVideoRateCommand()
+{
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusGetVideoRateCommand::SetNameToGetVideoRate()
+{
+  this->SetName(GET_VIDEO_RATE_CMD);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusGetVideoRateCommand::PrintSelf(ostream& os, vtkIndent indent)
+{
+  this->Superclass::PrintSelf(os, indent);
+  os << indent << "TargetClientId: " << this->TargetClientId << std::endl;
+}
+
+//----------------------------------------------------------------------------
+vtkPlusCommand::ExecutionModeType vtkPlusGetVideoRateCommand::GetExecutionMode() const
+{
+  return EXECUTION_MODE_READ_ONLY;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusGetVideoRateCommand::GetCommandNames(std::list<std::string>& cmdNames)
+{
+  cmdNames.clear();
+  cmdNames.push_back(GET_VIDEO_RATE_CMD);
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusGetVideoRateCommand::GetDescription(const std::string& commandName)
+{
+  std::string desc;
+  if (commandName.empty() || igsioCommon::IsEqualInsensitive(commandName, GET_VIDEO_RATE_CMD))
+  {
+    desc += GET_VIDEO_RATE_CMD;
+    desc += ": Get the target and achieved video rates of a client (requires AdaptiveVideoRate). Attributes: TargetClientId: ID of the client, the requesting client by default.";
+  }
+  return desc;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusGetVideoRateCommand::ReadConfiguration(vtkXMLDataElement* aConfig)
+{
+  if (vtkPlusCommand::ReadConfiguration(aConfig) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  this->TargetClientId = -1;
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, TargetClientId, aConfig);
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusGetVideoRateCommand::WriteConfiguration(vtkXMLDataElement* aConfig)
+{
+  if (vtkPlusCommand::WriteConfiguration(aConfig) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+  if (this->TargetClientId >= 0)
+  {
+    aConfig->SetIntAttribute("TargetClientId", this->TargetClientId);
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusGetVideoRateCommand::Execute()
+{
+  vtkPlusOpenIGTLinkServer* server = this->CommandProcessor->GetPlusServer();
+  int clientId = (this->TargetClientId >= 0 ? this->TargetClientId : this->ClientId);
+  ClientVideoRateStatus status;
+  if (server == NULL || server->GetClientVideoRateStatus(clientId, status) != PLUS_SUCCESS)
+  {
+    this->QueueCommandResponse(PLUS_FAIL, "Command failed. See error message.", "No adaptive video rate information is available for client " + std::to_string(clientId) + ".");
+    return PLUS_FAIL;
+  }
+
+  igtl::MessageBase::MetaDataMap metadata;
+  metadata["TargetBitrate"] = std::pair<IANA_ENCODING_TYPE, std::string>(IANA_TYPE_US_ASCII, std::to_string(status.TargetBitrate));
+  metadata["KeyFrameDistance"] = std::pair<IANA_ENCODING_TYPE, std::string>(IANA_TYPE_US_ASCII, std::to_string(status.KeyFrameDistance));
+  metadata["FrameDecimation"] = std::pair<IANA_ENCODING_TYPE, std::string>(IANA_TYPE_US_ASCII, std::to_string(status.FrameDecimation));
+  metadata["AchievedBitrate"] = std::pair<IANA_ENCODING_TYPE, std::string>(IANA_TYPE_US_ASCII, std::to_string(status.AchievedBitrate));
+  metadata["AchievedFrameRate"] = std::pair<IANA_ENCODING_TYPE, std::string>(IANA_TYPE_US_ASCII, std::to_string(status.AchievedFrameRate));
+  metadata["SendLagSec"] = std::pair<IANA_ENCODING_TYPE, std::string>(IANA_TYPE_US_ASCII, std::to_string(status.SendLagSec));
+  metadata["Congested"] = std::pair<IANA_ENCODING_TYPE, std::string>(IANA_TYPE_US_ASCII, status.Congested ? "true" : "false");
+  metadata["NumberOfAdjustments"] = std::pair<IANA_ENCODING_TYPE, std::string>(IANA_TYPE_US_ASCII, std::to_string(status.NumberOfAdjustments));
+
+  std::ostringstream message;
+  message << "Client " << clientId << ": target bitrate " << status.TargetBitrate << " bit/s, achieved bitrate " << status.AchievedBitrate
+          << " bit/s, achieved frame rate " << status.AchievedFrameRate << " fps, frame decimation " << status.FrameDecimation
+          << ", key frame distance " << status.KeyFrameDistance << ", send lag " << status.SendLagSec << " s" << (status.Congested ? ", congested." : ".");
+  this->QueueCommandResponse(PLUS_SUCCESS, message.str(), "", &metadata);
+  return PLUS_SUCCESS;
+}
@@ -0,0 +1,63 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __vtkPlusGetVideoRateCommand_h
+#define __vtkPlusGetVideoRateCommand_h
+
+#include "vtkPlusServerExport.h"
+
+#include "vtkPlusCommand.h"
+
+/*!
+  \class vtkPlusGetVideoRateCommand
+  \brief This command returns the adaptive video encoding state (target and achieved rates) of a client
+  \ingroup PlusLibPlusServer
+ */
+class vtkPlusServerExport vtkPlusGetVideoRateCommand : public vtkPlusCommand
+{
+public:
+
+  static vtkPlusGetVideoRateCommand* New();
+  vtkTypeMacro(vtkPlusGetVideoRateCommand, vtkPlusCommand);
+  virtual void PrintSelf(ostream& os, vtkIndent indent);
+  virtual vtkPlusCommand* Clone() { return New(); }
+
+  /*! Executes the command  */
+  virtual PlusStatus Execute();
+
+  /*! Read command parameters from XML */
+  virtual PlusStatus ReadConfiguration(vtkXMLDataElement* aConfig);
+
+  /*! Write command parameters to XML */
+  virtual PlusStatus WriteConfiguration(vtkXMLDataElement* aConfig);
+
+  /*! Get all the command names that this class can execute */
+  virtual void GetCommandNames(std::list<std::string>& cmdNames);
+
+  /*! Gets the description for the specified command name. */
+  virtual std::string GetDescription(const std::string& commandName);
+
+  /*! Only reads the video rate status of the clients, so it can run concurrently with other commands */
+  virtual ExecutionModeType GetExecutionMode() const;
+
+  /*! Id of the client to report the rates of. If negative then the rates of the client that sent the command are returned. */
+  vtkSetMacro(TargetClientId, int);
+  vtkGetMacro(TargetClientId, int);
+
+  void SetNameToGetVideoRate();
+
+protected:
+  vtkPlusGetVideoRateCommand();
+  virtual ~vtkPlusGetVideoRateCommand();
+
+  int TargetClientId;
+
+private:
+  vtkPlusGetVideoRateCommand(const vtkPlusGetVideoRateCommand&);
+  void operator=(const vtkPlusGetVideoRateCommand&);
+};
+
+#endif
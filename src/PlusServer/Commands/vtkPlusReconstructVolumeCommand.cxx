@@ -85,6 +85,18 @@ void vtkPlusReconstructVolumeCommand::PrintSelf(ostream& os, vtkIndent indent)
   this->Superclass::PrintSelf(os, indent);
 }
 
+//----------------------------------------------------------------------------
+vtkPlusCommand::ExecutionModeType vtkPlusReconstructVolumeCommand::GetExecutionMode() const
+{
+  return this->VolumeReconstructorDeviceId.empty() ? EXECUTION_MODE_EXCLUSIVE : EXECUTION_MODE_READ_ONLY;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusReconstructVolumeCommand::GetExecutionDeviceId() const
+{
+  return this->VolumeReconstructorDeviceId;
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusReconstructVolumeCommand::GetCommandNames(std::list<std::string>& cmdNames)
 {
@@ -44,6 +44,12 @@ public:
   /*! Gets the description for the specified command name. */
   virtual std::string GetDescription(const std::string& commandName);
 
+  /*! Only uses the volume reconstructor device. Exclusive if VolumeReconstructorDeviceId is not specified, as then the device is only selected during execution. */
+  virtual ExecutionModeType GetExecutionMode() const;
+
+  /*! Returns VolumeReconstructorDeviceId */
+  virtual std::string GetExecutionDeviceId() const;
+
   /*! File name of the sequence file that contains the image frames */
   vtkGetStdStringMacro(InputSeqFilename);
   vtkSetStdStringMacro(InputSeqFilename);
@@ -52,6 +52,12 @@ void vtkPlusRequestIdsCommand::SetNameToRequestDeviceChannelIds()
   SetName(REQUEST_DEVICE_CHANNEL_IDS_CMD);
 }
 
+//----------------------------------------------------------------------------
+vtkPlusCommand::ExecutionModeType vtkPlusRequestIdsCommand::GetExecutionMode() const
+{
+  return EXECUTION_MODE_READ_ONLY;
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusRequestIdsCommand::GetCommandNames(std::list<std::string>& cmdNames)
 {
@@ -34,6 +34,9 @@ public:
   /*! Gets the description for the specified command name. */
   virtual std::string GetDescription(const std::string& commandName);
 
+  /*! Only reads the list of channels and devices, so it can run concurrently with other commands */
+  virtual ExecutionModeType GetExecutionMode() const;
+
   void SetNameToRequestChannelIds();
   void SetNameToRequestDeviceIds();
   void SetNameToRequestInputDeviceIds();
@@ -35,6 +35,18 @@ void vtkPlusSendTextCommand::SetNameToSendText()
   this->SetName(SEND_TEXT_CMD);
 }
 
+//----------------------------------------------------------------------------
+vtkPlusCommand::ExecutionModeType vtkPlusSendTextCommand::GetExecutionMode() const
+{
+  return this->DeviceId.empty() ? EXECUTION_MODE_EXCLUSIVE : EXECUTION_MODE_READ_ONLY;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusSendTextCommand::GetExecutionDeviceId() const
+{
+  return this->DeviceId;
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusSendTextCommand::GetCommandNames(std::list<std::string>& cmdNames)
 {
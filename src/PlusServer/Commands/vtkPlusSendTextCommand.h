@@ -44,6 +44,12 @@ public:
   /*! Gets the description for the specified command name. */
   virtual std::string GetDescription(const std::string& commandName);
 
+  /*! Only communicates with the text receiver device. Exclusive if DeviceId is not specified, as then the device is only selected during execution. */
+  virtual ExecutionModeType GetExecutionMode() const;
+
+  /*! Returns DeviceId */
+  virtual std::string GetExecutionDeviceId() const;
+
   /*! Id of the device that the text will be sent to */
   virtual std::string GetDeviceId() const;
   virtual void SetDeviceId(const std::string& deviceId);
@@ -53,6 +53,18 @@ void vtkPlusSetUsParameterCommand::PrintSelf(ostream& os, vtkIndent indent)
   this->Superclass::PrintSelf(os, indent);
 }
 
+//----------------------------------------------------------------------------
+vtkPlusCommand::ExecutionModeType vtkPlusSetUsParameterCommand::GetExecutionMode() const
+{
+  return this->UsDeviceId.empty() ? EXECUTION_MODE_EXCLUSIVE : EXECUTION_MODE_READ_ONLY;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusSetUsParameterCommand::GetExecutionDeviceId() const
+{
+  return this->UsDeviceId;
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusSetUsParameterCommand::GetCommandNames(std::list<std::string>& cmdNames)
 {
@@ -42,6 +42,12 @@ public:
   /*! Gets the description for the specified command name. */
   virtual std::string GetDescription(const std::string& commandName);
 
+  /*! Only changes the imaging parameters of the ultrasound device. Exclusive if UsDeviceId is not specified, as then the device is only selected during execution. */
+  virtual ExecutionModeType GetExecutionMode() const;
+
+  /*! Returns UsDeviceId */
+  virtual std::string GetExecutionDeviceId() const;
+
   /*! Id of the ultrasound device to change the parameters of at the next Execute */
   vtkGetStdStringMacro(UsDeviceId);
   vtkSetStdStringMacro(UsDeviceId);
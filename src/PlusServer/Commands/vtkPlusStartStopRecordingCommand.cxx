@@ -45,6 +45,18 @@ void vtkPlusStartStopRecordingCommand::SetNameToSuspend() { SetName(SUSPEND_CMD)
 void vtkPlusStartStopRecordingCommand::SetNameToResume() { SetName(RESUME_CMD); }
 void vtkPlusStartStopRecordingCommand::SetNameToStop() { SetName(STOP_CMD); }
 
+//----------------------------------------------------------------------------
+vtkPlusCommand::ExecutionModeType vtkPlusStartStopRecordingCommand::GetExecutionMode() const
+{
+  return this->CaptureDeviceId.empty() ? EXECUTION_MODE_EXCLUSIVE : EXECUTION_MODE_READ_ONLY;
+}
+
+//----------------------------------------------------------------------------
+std::string vtkPlusStartStopRecordingCommand::GetExecutionDeviceId() const
+{
+  return this->CaptureDeviceId;
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusStartStopRecordingCommand::GetCommandNames(std::list<std::string>& cmdNames)
 {
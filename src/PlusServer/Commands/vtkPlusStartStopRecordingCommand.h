@@ -43,6 +43,12 @@ public:
   /*! Gets the description for the specified command name. */
   virtual std::string GetDescription(const std::string& commandName);
 
+  /*! Only changes the state of the capture device. Exclusive if CaptureDeviceId is not specified, as then the device is only selected during execution. */
+  virtual ExecutionModeType GetExecutionMode() const;
+
+  /*! Returns CaptureDeviceId */
+  virtual std::string GetExecutionDeviceId() const;
+
   vtkGetStdStringMacro(OutputFilename);
   vtkSetStdStringMacro(OutputFilename);
 
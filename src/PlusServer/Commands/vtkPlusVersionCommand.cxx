@@ -35,6 +35,12 @@ void vtkPlusVersionCommand::SetNameToVersion()
   this->SetName(VERSION_CMD);
 }
 
+//----------------------------------------------------------------------------
+vtkPlusCommand::ExecutionModeType vtkPlusVersionCommand::GetExecutionMode() const
+{
+  return EXECUTION_MODE_READ_ONLY;
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusVersionCommand::GetCommandNames(std::list<std::string>& cmdNames)
 {
@@ -33,6 +33,9 @@ public:
   /*! Gets the description for the specified command name. */
   virtual std::string GetDescription(const std::string& commandName);
 
+  /*! Does not access any server state, so it can run concurrently with other commands */
+  virtual ExecutionModeType GetExecutionMode() const;
+
   void SetNameToVersion();
 
 protected:
@@ -0,0 +1,559 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusIgtlEpollReactor.h"
+#include "vtkIGSIORecursiveCriticalSection.h"
+#include "vtkPlusIgtlMessageCommon.h"
+#include "vtkPlusIgtlMessageFactory.h"
+
+// OS includes
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+// STL includes
+#include <algorithm>
+
+namespace
+{
+  const int MAX_NUMBER_OF_EPOLL_EVENTS = 64;
+  // The event loop wakes up at least this often to check if it has to stop
+  const int EPOLL_WAIT_TIMEOUT_MSEC = 200;
+  const size_t RECEIVE_CHUNK_SIZE = 64 * 1024;
+  // Messages with a larger body are considered invalid and the connection is closed
+  const igtlUint64 MAX_RECEIVED_MESSAGE_BODY_SIZE = 256 * 1024 * 1024;
+  const double EVENT_LOOP_START_CHECK_DELAY_SEC = 0.05;
+  const int EVENT_LOOP_START_CHECK_ATTEMPTS = 40;
+}
+
+//----------------------------------------------------------------------------
+PlusIgtlEpollReactor::PlusIgtlEpollReactor(vtkPlusOpenIGTLinkServer* server)
+  : Server(server)
+  , Threader(vtkSmartPointer<vtkMultiThreader>::New())
+  , EventLoopThreadId(-1)
+  , EventLoopActive(std::make_pair(false, false))
+  , ListeningSocketDescriptor(-1)
+  , EpollDescriptor(-1)
+  , WakeUpEventDescriptor(-1)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusIgtlEpollReactor::~PlusIgtlEpollReactor()
+{
+  this->Stop();
+  if (this->WakeUpEventDescriptor >= 0)
+  {
+    close(this->WakeUpEventDescriptor);
+    this->WakeUpEventDescriptor = -1;
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIgtlEpollReactor::Start(int listeningPort)
+{
+  if (this->EventLoopThreadId >= 0)
+  {
+    LOG_WARNING("Epoll network core is already running");
+    return PLUS_SUCCESS;
+  }
+
+  this->ListeningSocketDescriptor = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (this->ListeningSocketDescriptor < 0)
+  {
+    LOG_ERROR("Cannot create a server socket: " << strerror(errno));
+    return PLUS_FAIL;
+  }
+
+  int reuseAddress = 1;
+  setsockopt(this->ListeningSocketDescriptor, SOL_SOCKET, SO_REUSEADDR, &reuseAddress, sizeof(reuseAddress));
+
+  struct sockaddr_in address;
+  memset(&address, 0, sizeof(address));
+  address.sin_family = AF_INET;
+  address.sin_addr.s_addr = htonl(INADDR_ANY);
+  address.sin_port = htons(static_cast<uint16_t>(listeningPort));
+  if (bind(this->ListeningSocketDescriptor, (struct sockaddr*)&address, sizeof(address)) < 0
+      || listen(this->ListeningSocketDescriptor, SOMAXCONN) < 0)
+  {
+    LOG_ERROR("Cannot listen on port " << listeningPort << ": " << strerror(errno));
+    this->CloseDescriptors();
+    return PLUS_FAIL;
+  }
+
+  this->EpollDescriptor = epoll_create1(EPOLL_CLOEXEC);
+  if (this->WakeUpEventDescriptor < 0)
+  {
+    this->WakeUpEventDescriptor = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  }
+  if (this->EpollDescriptor < 0 || this->WakeUpEventDescriptor < 0)
+  {
+    LOG_ERROR("Cannot create epoll instance: " << strerror(errno));
+    this->CloseDescriptors();
+    return PLUS_FAIL;
+  }
+
+  int descriptors[2] = { this->ListeningSocketDescriptor, this->WakeUpEventDescriptor };
+  for (int i = 0; i < 2; ++i)
+  {
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = descriptors[i];
+    if (epoll_ctl(this->EpollDescriptor, EPOLL_CTL_ADD, descriptors[i], &event) < 0)
+    {
+      LOG_ERROR("Cannot register socket for epoll: " << strerror(errno));
+      this->CloseDescriptors();
+      return PLUS_FAIL;
+    }
+  }
+
+  this->EventLoopActive.first = true;
+  this->EventLoopThreadId = this->Threader->SpawnThread((vtkThreadFunctionType)&EventLoopThread, this);
+
+  RETRY_UNTIL_TRUE(this->EventLoopActive.second, EVENT_LOOP_START_CHECK_ATTEMPTS, EVENT_LOOP_START_CHECK_DELAY_SEC);
+  if (!this->EventLoopActive.second)
+  {
+    LOG_ERROR("Unable to start epoll event loop thread.");
+    this->Stop();
+    return PLUS_FAIL;
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlEpollReactor::Stop()
+{
+  if (this->EventLoopThreadId >= 0)
+  {
+    this->EventLoopActive.first = false;
+    this->NotifySendQueueChanged();
+    while (this->EventLoopActive.second)
+    {
+      // Wait until the thread stops
+      vtkIGSIOAccurateTimer::Delay(0.01);
+    }
+    this->Threader->TerminateThread(this->EventLoopThreadId);
+    this->EventLoopThreadId = -1;
+  }
+
+  for (std::map<int, Connection>::iterator it = this->Connections.begin(); it != this->Connections.end(); ++it)
+  {
+    close(it->first);
+  }
+  this->Connections.clear();
+
+  this->CloseDescriptors();
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlEpollReactor::IsRunning() const
+{
+  return this->EventLoopThreadId >= 0 && this->EventLoopActive.first;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlEpollReactor::CloseClient(int clientId)
+{
+  {
+    std::lock_guard<std::mutex> closeRequestLock(this->CloseRequestMutex);
+    this->CloseRequestClientIds.push_back(clientId);
+  }
+  this->NotifySendQueueChanged();
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlEpollReactor::NotifySendQueueChanged()
+{
+  if (this->WakeUpEventDescriptor < 0)
+  {
+    return;
+  }
+  uint64_t increment = 1;
+  if (write(this->WakeUpEventDescriptor, &increment, sizeof(increment)) < 0 && errno != EAGAIN)
+  {
+    LOG_ERROR("Failed to wake up epoll event loop: " << strerror(errno));
+  }
+}
+
+//----------------------------------------------------------------------------
+void* PlusIgtlEpollReactor::EventLoopThread(vtkMultiThreader::ThreadInfo* data)
+{
+  PlusIgtlEpollReactor* self = (PlusIgtlEpollReactor*)(data->UserData);
+  self->EventLoopActive.second = true;
+
+  struct epoll_event events[MAX_NUMBER_OF_EPOLL_EVENTS];
+  while (self->EventLoopActive.first)
+  {
+    int numberOfEvents = epoll_wait(self->EpollDescriptor, events, MAX_NUMBER_OF_EPOLL_EVENTS, EPOLL_WAIT_TIMEOUT_MSEC);
+    if (numberOfEvents < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      LOG_ERROR("epoll_wait failed: " << strerror(errno));
+      break;
+    }
+
+    for (int i = 0; i < numberOfEvents; ++i)
+    {
+      int descriptor = events[i].data.fd;
+      if (descriptor == self->ListeningSocketDescriptor)
+      {
+        self->AcceptConnections();
+        continue;
+      }
+      if (descriptor == self->WakeUpEventDescriptor)
+      {
+        uint64_t counter = 0;
+        if (read(self->WakeUpEventDescriptor, &counter, sizeof(counter)) < 0 && errno != EAGAIN)
+        {
+          LOG_ERROR("Failed to read epoll wake up event: " << strerror(errno));
+        }
+        self->ProcessWakeUp();
+        continue;
+      }
+
+      std::map<int, Connection>::iterator connectionIt = self->Connections.find(descriptor);
+      if (connectionIt == self->Connections.end())
+      {
+        // Already closed while processing a previous event
+        continue;
+      }
+
+      bool keepConnection = true;
+      if (events[i].events & EPOLLIN)
+      {
+        keepConnection = self->ReceiveFromConnection(connectionIt->second);
+      }
+      if (keepConnection && (events[i].events & EPOLLOUT))
+      {
+        keepConnection = self->SendToConnection(connectionIt->second);
+      }
+      if (events[i].events & (EPOLLERR | EPOLLHUP))
+      {
+        keepConnection = false;
+      }
+      if (!keepConnection)
+      {
+        self->CloseConnection(descriptor);
+      }
+    }
+  }
+
+  // Close thread
+  self->EventLoopActive.second = false;
+  return NULL;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlEpollReactor::AcceptConnections()
+{
+  while (true)
+  {
+    struct sockaddr_in clientAddress;
+    socklen_t clientAddressLength = sizeof(clientAddress);
+    int socketDescriptor = accept4(this->ListeningSocketDescriptor, (struct sockaddr*)&clientAddress, &clientAddressLength, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (socketDescriptor < 0)
+    {
+      if (errno == EINTR)
+      {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK)
+      {
+        LOG_ERROR("Failed to accept client connection: " << strerror(errno));
+      }
+      break;
+    }
+
+    char addressString[INET_ADDRSTRLEN] = "unknown";
+    inet_ntop(AF_INET, &clientAddress.sin_addr, addressString, sizeof(addressString));
+
+    this->Server->SocketOptions.Apply(socketDescriptor);
+
+    Connection connection;
+    connection.SocketDescriptor = socketDescriptor;
+    {
+      // Lock before we change the clients list
+      igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->Server->IgtlClientsMutex);
+      ClientData newClient;
+      this->Server->IgtlClients.push_back(newClient);
+
+      ClientData* client = &(this->Server->IgtlClients.back());   // get a reference to the client data that is stored in the list
+      client->ClientId = vtkPlusOpenIGTLinkServer::ClientIdCounter;
+      vtkPlusOpenIGTLinkServer::ClientIdCounter++;
+      client->ClientAddress = addressString;
+      client->ClientInfo = this->Server->DefaultClientInfo;
+      client->ClientInfo.ResetFrameRateLimitState(); // each client has its own frame rate limit
+      client->ClientInfo.ResetStreamEncoders(); // encoder state must only be shared through the subscription key
+      client->Server = this->Server;
+      client->SendQueue = std::make_shared<ClientSendQueue>();
+      client->SendQueue->MaxLength = static_cast<unsigned int>(std::max(this->Server->ClientSendQueueLength, 1));
+      client->SendQueue->DropPolicy = this->Server->ClientSendQueueDropPolicy;
+      client->SendQueue->ItemAddedCallback = [this]() { this->NotifySendQueueChanged(); };
+      client->VideoRateController = this->Server->CreateVideoRateController();
+
+      connection.ClientId = client->ClientId;
+      connection.Client = client;
+      connection.SendQueue = client->SendQueue;
+    }
+
+    struct epoll_event event;
+    memset(&event, 0, sizeof(event));
+    event.events = EPOLLIN;
+    event.data.fd = socketDescriptor;
+    this->Connections[socketDescriptor] = connection;
+    if (epoll_ctl(this->EpollDescriptor, EPOLL_CTL_ADD, socketDescriptor, &event) < 0)
+    {
+      LOG_ERROR("Cannot register client socket for epoll: " << strerror(errno));
+      this->CloseConnection(socketDescriptor);
+      continue;
+    }
+
+    LOG_INFO("Received new client connection (client " << connection.ClientId << " at " << addressString << ":" << ntohs(clientAddress.sin_port)
+             << "). Number of connected clients: " << this->Server->GetNumberOfConnectedClients());
+  }
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlEpollReactor::ReceiveFromConnection(Connection& connection)
+{
+  std::vector<unsigned char>& buffer = connection.ReceiveBuffer;
+
+  bool peerClosed = false;
+  while (true)
+  {
+    size_t previousSize = buffer.size();
+    buffer.resize(previousSize + RECEIVE_CHUNK_SIZE);
+    ssize_t bytesReceived = recv(connection.SocketDescriptor, &buffer[previousSize], RECEIVE_CHUNK_SIZE, 0);
+    buffer.resize(previousSize + std::max<ssize_t>(bytesReceived, 0));
+    if (bytesReceived > 0)
+    {
+      continue;
+    }
+    if (bytesReceived == 0)
+    {
+      peerClosed = true;
+      break;
+    }
+    if (errno == EINTR)
+    {
+      continue;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK)
+    {
+      break;
+    }
+    LOG_DEBUG("Failed to receive from client " << connection.ClientId << ": " << strerror(errno));
+    return false;
+  }
+
+  // Process all complete messages
+  size_t offset = 0;
+  while (true)
+  {
+    igtl::MessageHeader::Pointer headerMsg = this->Server->IgtlMessageFactory->CreateHeaderMessage(IGTL_HEADER_VERSION_1);
+    headerMsg->InitBuffer();
+    size_t headerSize = static_cast<size_t>(headerMsg->GetBufferSize());
+    if (buffer.size() - offset < headerSize)
+    {
+      break;
+    }
+    memcpy(headerMsg->GetBufferPointer(), &buffer[offset], headerSize);
+    // The stream cannot be resynchronized after a corrupted header, so the connection is closed
+    if (!(headerMsg->Unpack(this->Server->IgtlMessageCrcCheckEnabled) & igtl::MessageHeader::UNPACK_HEADER))
+    {
+      LOG_ERROR("Received invalid message header from client " << connection.ClientId << ", closing the connection");
+      return false;
+    }
+    // Checking the size first also keeps headerSize + bodySize from overflowing
+    if (headerMsg->GetBodySizeToRead() > MAX_RECEIVED_MESSAGE_BODY_SIZE)
+    {
+      LOG_ERROR("Received message body size (" << headerMsg->GetBodySizeToRead() << " bytes) from client " << connection.ClientId
+                << " exceeds the limit of " << MAX_RECEIVED_MESSAGE_BODY_SIZE << " bytes, closing the connection");
+      return false;
+    }
+
+    size_t bodySize = static_cast<size_t>(headerMsg->GetBodySizeToRead());
+    if (buffer.size() - offset < headerSize + bodySize)
+    {
+      // Wait for the rest of the message
+      break;
+    }
+
+    igtl::MessageBase::Pointer bodyMessage = this->Server->IgtlMessageFactory->CreateReceiveMessage(headerMsg);
+    if (bodyMessage.IsNull())
+    {
+      LOG_ERROR("Unable to receive message from client: " << connection.ClientId);
+    }
+    else
+    {
+      bodyMessage->SetMessageHeader(headerMsg);
+      bodyMessage->AllocateBuffer();
+      if (bodyMessage->GetBufferBodySize() > 0)
+      {
+        memcpy(bodyMessage->GetBufferBodyPointer(), &buffer[offset + headerSize], std::min<size_t>(bodySize, bodyMessage->GetBufferBodySize()));
+      }
+      if (this->Server->ProcessClientMessage(*connection.Client, headerMsg, bodyMessage, connection.PreviousCommandIds) != PLUS_SUCCESS)
+      {
+        return false;
+      }
+    }
+    offset += headerSize + bodySize;
+  }
+  buffer.erase(buffer.begin(), buffer.begin() + offset);
+
+  return !peerClosed;
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlEpollReactor::SendToConnection(Connection& connection)
+{
+  ClientSendQueue& sendQueue = *connection.SendQueue;
+  while (true)
+  {
+    if (!connection.HasCurrentItem)
+    {
+      std::lock_guard<std::mutex> sendQueueLock(sendQueue.Mutex);
+      if (sendQueue.Items.empty())
+      {
+        break;
+      }
+      connection.CurrentItem = sendQueue.Items.front();
+      sendQueue.Items.pop_front();
+      sendQueue.Statistics.QueueLength = static_cast<unsigned int>(sendQueue.Items.size());
+      connection.HasCurrentItem = true;
+      connection.CurrentMessageIndex = 0;
+      connection.CurrentMessageOffset = 0;
+    }
+
+    // Messages of the item are sent in full TCP segments
+    this->Server->SocketOptions.SetCorked(connection.SocketDescriptor, true);
+    int sendResult = vtkPlusIgtlMessageCommon::SendPackedMessagesNonBlocking(connection.SocketDescriptor, connection.CurrentItem.Messages,
+                     this->Server->SocketOptions.CoalesceMessages, connection.CurrentMessageIndex, connection.CurrentMessageOffset);
+    if (sendResult == 0)
+    {
+      // Continue when the socket becomes writable
+      this->Server->SocketOptions.SetCorked(connection.SocketDescriptor, false);
+      this->SetWriteNotification(connection, true);
+      return true;
+    }
+    if (sendResult < 0)
+    {
+      igtl::MessageBase::Pointer igtlMessage = connection.CurrentItem.Messages[connection.CurrentMessageIndex];
+      LOG_INFO("Client disconnected - could not send " << igtlMessage->GetMessageType() << " message to client " << connection.ClientId
+               << " (device name: " << igtlMessage->GetDeviceName() << ").");
+      return false;
+    }
+    this->Server->SocketOptions.SetCorked(connection.SocketDescriptor, false);
+
+    {
+      std::lock_guard<std::mutex> sendQueueLock(sendQueue.Mutex);
+      unsigned long long sentBytes = 0;
+      for (std::vector<igtl::MessageBase::Pointer>::const_iterator messageIt = connection.CurrentItem.Messages.begin(); messageIt != connection.CurrentItem.Messages.end(); ++messageIt)
+      {
+        sentBytes += vtkPlusIgtlMessageCommon::GetPackedMessageSize(*messageIt);
+      }
+      double systemTime = vtkIGSIOAccurateTimer::GetSystemTime();
+      sendQueue.Statistics.AddSentItem(sentBytes, systemTime - connection.CurrentItem.QueuedTime, systemTime);
+    }
+    connection.HasCurrentItem = false;
+    connection.CurrentItem.Messages.clear();
+  }
+
+  this->SetWriteNotification(connection, false);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlEpollReactor::SetWriteNotification(Connection& connection, bool enable)
+{
+  if (connection.WriteNotificationEnabled == enable)
+  {
+    return;
+  }
+  struct epoll_event event;
+  memset(&event, 0, sizeof(event));
+  event.events = EPOLLIN | (enable ? EPOLLOUT : 0);
+  event.data.fd = connection.SocketDescriptor;
+  if (epoll_ctl(this->EpollDescriptor, EPOLL_CTL_MOD, connection.SocketDescriptor, &event) < 0)
+  {
+    LOG_ERROR("Failed to modify epoll events of client " << connection.ClientId << ": " << strerror(errno));
+    return;
+  }
+  connection.WriteNotificationEnabled = enable;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlEpollReactor::ProcessWakeUp()
+{
+  std::vector<int> closeRequestClientIds;
+  {
+    std::lock_guard<std::mutex> closeRequestLock(this->CloseRequestMutex);
+    closeRequestClientIds.swap(this->CloseRequestClientIds);
+  }
+
+  std::vector<int> descriptorsToClose;
+  for (std::map<int, Connection>::iterator it = this->Connections.begin(); it != this->Connections.end(); ++it)
+  {
+    if (std::find(closeRequestClientIds.begin(), closeRequestClientIds.end(), it->second.ClientId) != closeRequestClientIds.end())
+    {
+      descriptorsToClose.push_back(it->first);
+      continue;
+    }
+    if (!it->second.WriteNotificationEnabled && !this->SendToConnection(it->second))
+    {
+      descriptorsToClose.push_back(it->first);
+    }
+  }
+
+  for (std::vector<int>::iterator it = descriptorsToClose.begin(); it != descriptorsToClose.end(); ++it)
+  {
+    this->CloseConnection(*it);
+  }
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlEpollReactor::CloseConnection(int socketDescriptor)
+{
+  std::map<int, Connection>::iterator connectionIt = this->Connections.find(socketDescriptor);
+  if (connectionIt == this->Connections.end())
+  {
+    return;
+  }
+  int clientId = connectionIt->second.ClientId;
+
+  epoll_ctl(this->EpollDescriptor, EPOLL_CTL_DEL, socketDescriptor, NULL);
+  close(socketDescriptor);
+  this->Connections.erase(connectionIt);
+
+  this->Server->RemoveClient(clientId);
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlEpollReactor::CloseDescriptors()
+{
+  // The wake up descriptor is kept open until destruction, as other threads may still notify the reactor
+  int* descriptors[2] = { &this->ListeningSocketDescriptor, &this->EpollDescriptor };
+  for (int i = 0; i < 2; ++i)
+  {
+    if (*descriptors[i] >= 0)
+    {
+      close(*descriptors[i]);
+      *descriptors[i] = -1;
+    }
+  }
+}
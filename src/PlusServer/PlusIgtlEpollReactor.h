@@ -0,0 +1,144 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusIgtlEpollReactor_h
+#define __PlusIgtlEpollReactor_h
+
+// Local includes
+#include "vtkPlusServerExport.h"
+#include "vtkPlusOpenIGTLinkServer.h"
+
+// VTK includes
+#include <vtkMultiThreader.h>
+#include <vtkSmartPointer.h>
+
+// STL includes
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+/*!
+  \class PlusIgtlEpollReactor
+  \brief Linux epoll based network core for vtkPlusOpenIGTLinkServer
+
+  A single event loop thread accepts connections, receives and dispatches client messages, and writes the
+  clients' send queues to non-blocking sockets whenever they are ready for writing. Tracked frames are still
+  packed and queued by the server's data sender thread, so the server runs two threads in total, independently
+  from the number of connected clients.
+
+  Used by the server if NetworkBackend="EPOLL" is set in the PlusOpenIGTLinkServer element. Available on Linux only.
+
+  \ingroup PlusLibPlusServer
+*/
+class vtkPlusServerExport PlusIgtlEpollReactor
+{
+public:
+  PlusIgtlEpollReactor(vtkPlusOpenIGTLinkServer* server);
+  ~PlusIgtlEpollReactor();
+
+  /*! Start listening on the port and start the event loop thread */
+  PlusStatus Start(int listeningPort);
+
+  /*! Stop the event loop thread and close all sockets. Clients that are still in the server's client list are not removed. */
+  void Stop();
+
+  /*! Returns true if the event loop thread is running */
+  bool IsRunning() const;
+
+  /*! Close the connection of a client and remove the client from the server. Can be called from any thread. */
+  void CloseClient(int clientId);
+
+  /*! Wake up the event loop to write newly queued messages. Can be called from any thread. */
+  void NotifySendQueueChanged();
+
+protected:
+  /*! State of one client connection. Only accessed from the event loop thread. */
+  struct Connection
+  {
+    Connection()
+      : SocketDescriptor(-1)
+      , ClientId(-1)
+      , Client(NULL)
+      , WriteNotificationEnabled(false)
+      , HasCurrentItem(false)
+      , CurrentMessageIndex(0)
+      , CurrentMessageOffset(0)
+    {
+    }
+
+    int SocketDescriptor;
+    int ClientId;
+
+    /*! Client in the server's client list. Clients of the reactor are only removed by the event loop thread, so this stays valid while the connection exists. */
+    ClientData* Client;
+    std::shared_ptr<ClientSendQueue> SendQueue;
+
+    /*! IDs of recent commands to be able to detect duplicate command IDs */
+    std::deque<uint32_t> PreviousCommandIds;
+
+    /*! Received bytes that do not form a complete message yet */
+    std::vector<unsigned char> ReceiveBuffer;
+
+    /*! True if EPOLLOUT is requested, because the last write would have blocked */
+    bool WriteNotificationEnabled;
+
+    /*! Send queue item that is being written. Bytes before CurrentMessageOffset of message CurrentMessageIndex are already sent. */
+    bool HasCurrentItem;
+    ClientSendQueue::Item CurrentItem;
+    size_t CurrentMessageIndex;
+    size_t CurrentMessageOffset;
+  };
+
+  static void* EventLoopThread(vtkMultiThreader::ThreadInfo* data);
+
+  /*! Accept all pending connections and add them to the server's client list */
+  void AcceptConnections();
+
+  /*! Read the available data and process all complete messages. Returns false if the connection has to be closed. */
+  bool ReceiveFromConnection(Connection& connection);
+
+  /*! Write queued messages until the socket would block. Returns false if the connection has to be closed. */
+  bool SendToConnection(Connection& connection);
+
+  /*! Enable or disable EPOLLOUT notification for the connection */
+  void SetWriteNotification(Connection& connection, bool enable);
+
+  /*! Handle close requests and write newly queued messages */
+  void ProcessWakeUp();
+
+  /*! Close the socket and remove the client from the server */
+  void CloseConnection(int socketDescriptor);
+
+  /*! Close the listening and epoll descriptors */
+  void CloseDescriptors();
+
+private:
+  PlusIgtlEpollReactor(const PlusIgtlEpollReactor&);
+  void operator=(const PlusIgtlEpollReactor&);
+
+  vtkPlusOpenIGTLinkServer* Server;
+
+  vtkSmartPointer<vtkMultiThreader> Threader;
+  int EventLoopThreadId;
+
+  /*! Active flag for the event loop thread (first: request, second: respond ) */
+  std::pair<bool, bool> EventLoopActive;
+
+  int ListeningSocketDescriptor;
+  int EpollDescriptor;
+  int WakeUpEventDescriptor;
+
+  /*! Connections by socket descriptor */
+  std::map<int, Connection> Connections;
+
+  /*! Clients to be disconnected, requested from other threads */
+  std::mutex CloseRequestMutex;
+  std::vector<int> CloseRequestClientIds;
+};
+
+#endif
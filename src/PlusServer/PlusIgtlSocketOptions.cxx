@@ -0,0 +1,171 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusIgtlSocketOptions.h"
+#include "vtkPlusIgtlMessageCommon.h"
+
+// VTK includes
+#include <vtkXMLDataElement.h>
+
+// OS includes
+#if defined(_WIN32)
+  #include <winsock2.h>
+  #include <ws2tcpip.h>
+#else
+  #include <errno.h>
+  #include <netinet/in.h>
+  #include <netinet/tcp.h>
+  #include <string.h>
+  #include <sys/socket.h>
+#endif
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  PlusStatus SetSocketOption(int socketDescriptor, int level, int optionName, int value, const char* optionDescription)
+  {
+    if (setsockopt(socketDescriptor, level, optionName, reinterpret_cast<const char*>(&value), sizeof(value)) != 0)
+    {
+#if defined(_WIN32)
+      LOG_WARNING("Failed to set socket option " << optionDescription << " to " << value << " (error code " << WSAGetLastError() << ")");
+#else
+      LOG_WARNING("Failed to set socket option " << optionDescription << " to " << value << ": " << strerror(errno));
+#endif
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusIgtlSocketOptions::PlusIgtlSocketOptions()
+  : TcpNoDelay(true)
+  , SendBufferSize(0)
+  , ReceiveBufferSize(0)
+  , TcpCork(false)
+  , BusyPollUsec(0)
+  , CoalesceMessages(false)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIgtlSocketOptions::ReadConfiguration(vtkXMLDataElement* serverElement)
+{
+  if (serverElement == NULL)
+  {
+    LOG_ERROR("Unable to read socket options: invalid server element");
+    return PLUS_FAIL;
+  }
+  XML_READ_BOOL_ATTRIBUTE_NONMEMBER_OPTIONAL(TcpNoDelay, this->TcpNoDelay, serverElement);
+  XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, SocketSendBufferSize, this->SendBufferSize, serverElement);
+  XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, SocketReceiveBufferSize, this->ReceiveBufferSize, serverElement);
+  XML_READ_BOOL_ATTRIBUTE_NONMEMBER_OPTIONAL(TcpCork, this->TcpCork, serverElement);
+  XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(int, SocketBusyPollUsec, this->BusyPollUsec, serverElement);
+  XML_READ_BOOL_ATTRIBUTE_NONMEMBER_OPTIONAL(CoalesceMessages, this->CoalesceMessages, serverElement);
+
+  if (this->SendBufferSize < 0 || this->ReceiveBufferSize < 0 || this->BusyPollUsec < 0)
+  {
+    LOG_ERROR("SocketSendBufferSize, SocketReceiveBufferSize and SocketBusyPollUsec must not be negative");
+    return PLUS_FAIL;
+  }
+#if !defined(TCP_CORK) && !defined(TCP_NOPUSH)
+  if (this->TcpCork)
+  {
+    LOG_WARNING("TcpCork is not supported on this platform and is ignored. Use CoalesceMessages instead.");
+    this->TcpCork = false;
+  }
+#endif
+#if !defined(SO_BUSY_POLL)
+  if (this->BusyPollUsec > 0)
+  {
+    LOG_WARNING("SocketBusyPollUsec is not supported on this platform and is ignored.");
+    this->BusyPollUsec = 0;
+  }
+#endif
+  if (this->TcpCork && this->CoalesceMessages)
+  {
+    LOG_INFO("TcpCork has no effect when CoalesceMessages is enabled, each frame is written at once");
+  }
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlSocketOptions::PrintSelf(ostream& os, vtkIndent indent) const
+{
+  os << indent << "TcpNoDelay: " << (this->TcpNoDelay ? "TRUE" : "FALSE") << std::endl;
+  os << indent << "SocketSendBufferSize: " << this->SendBufferSize << std::endl;
+  os << indent << "SocketReceiveBufferSize: " << this->ReceiveBufferSize << std::endl;
+  os << indent << "TcpCork: " << (this->TcpCork ? "TRUE" : "FALSE") << std::endl;
+  os << indent << "SocketBusyPollUsec: " << this->BusyPollUsec << std::endl;
+  os << indent << "CoalesceMessages: " << (this->CoalesceMessages ? "TRUE" : "FALSE") << std::endl;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIgtlSocketOptions::Apply(int socketDescriptor) const
+{
+  if (socketDescriptor < 0)
+  {
+    return PLUS_FAIL;
+  }
+  PlusStatus status = PLUS_SUCCESS;
+  if (SetSocketOption(socketDescriptor, IPPROTO_TCP, TCP_NODELAY, this->TcpNoDelay ? 1 : 0, "TCP_NODELAY") != PLUS_SUCCESS)
+  {
+    status = PLUS_FAIL;
+  }
+  if (this->SendBufferSize > 0 && SetSocketOption(socketDescriptor, SOL_SOCKET, SO_SNDBUF, this->SendBufferSize, "SO_SNDBUF") != PLUS_SUCCESS)
+  {
+    status = PLUS_FAIL;
+  }
+  if (this->ReceiveBufferSize > 0 && SetSocketOption(socketDescriptor, SOL_SOCKET, SO_RCVBUF, this->ReceiveBufferSize, "SO_RCVBUF") != PLUS_SUCCESS)
+  {
+    status = PLUS_FAIL;
+  }
+#if defined(SO_BUSY_POLL)
+  if (this->BusyPollUsec > 0 && SetSocketOption(socketDescriptor, SOL_SOCKET, SO_BUSY_POLL, this->BusyPollUsec, "SO_BUSY_POLL") != PLUS_SUCCESS)
+  {
+    status = PLUS_FAIL;
+  }
+#endif
+  return status;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIgtlSocketOptions::Apply(igtl::Socket* socket) const
+{
+  int socketDescriptor = vtkPlusIgtlMessageCommon::GetSocketDescriptor(socket);
+  if (socketDescriptor < 0)
+  {
+    LOG_DEBUG("Socket options cannot be applied: socket descriptor is not available");
+    return PLUS_FAIL;
+  }
+  return this->Apply(socketDescriptor);
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlSocketOptions::SetCorked(int socketDescriptor, bool corked) const
+{
+  if (!this->TcpCork || socketDescriptor < 0)
+  {
+    return;
+  }
+#if defined(TCP_CORK)
+  SetSocketOption(socketDescriptor, IPPROTO_TCP, TCP_CORK, corked ? 1 : 0, "TCP_CORK");
+#elif defined(TCP_NOPUSH)
+  SetSocketOption(socketDescriptor, IPPROTO_TCP, TCP_NOPUSH, corked ? 1 : 0, "TCP_NOPUSH");
+#endif
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlSocketOptions::SetCorked(igtl::Socket* socket, bool corked) const
+{
+  if (!this->TcpCork)
+  {
+    return;
+  }
+  this->SetCorked(vtkPlusIgtlMessageCommon::GetSocketDescriptor(socket), corked);
+}
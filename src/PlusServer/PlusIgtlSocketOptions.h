@@ -0,0 +1,67 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusIgtlSocketOptions_h
+#define __PlusIgtlSocketOptions_h
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusServerExport.h"
+
+// VTK includes
+#include <vtkIndent.h>
+
+// IGTL includes
+#include <igtlSocket.h>
+
+class vtkXMLDataElement;
+
+/*!
+  \class PlusIgtlSocketOptions
+  \brief TCP options of the OpenIGTLink server's client connections
+
+  Read from the PlusOpenIGTLinkServer element:
+  - TcpNoDelay: disable Nagle's algorithm, so that small messages are sent immediately (default: TRUE)
+  - SocketSendBufferSize, SocketReceiveBufferSize: kernel buffer sizes in bytes (default: 0, system default)
+  - TcpCork: hold back partial TCP segments while the messages of one frame are written, then send them together (Linux TCP_CORK,
+    TCP_NOPUSH on BSD/macOS; default: FALSE)
+  - SocketBusyPollUsec: busy poll the network device when receiving, instead of waiting for an interrupt (Linux SO_BUSY_POLL,
+    values above the net.core.busy_read limit require CAP_NET_ADMIN; default: 0, disabled)
+  - CoalesceMessages: write all messages of one frame to a client with a single system call (default: FALSE)
+
+  Options that are not available on the platform are ignored with a warning.
+
+  \ingroup PlusLibPlusServer
+*/
+struct vtkPlusServerExport PlusIgtlSocketOptions
+{
+  PlusIgtlSocketOptions();
+
+  /*! Read the options from the server element. Attributes that are not present keep their current value. */
+  PlusStatus ReadConfiguration(vtkXMLDataElement* serverElement);
+
+  void PrintSelf(ostream& os, vtkIndent indent) const;
+
+  /*! Set the options on a connected client socket */
+  PlusStatus Apply(int socketDescriptor) const;
+  PlusStatus Apply(igtl::Socket* socket) const;
+
+  /*!
+    Start (corked=true) or end (corked=false) a batch of writes. While corked, partial segments are not sent.
+    Does nothing if TcpCork is disabled.
+  */
+  void SetCorked(int socketDescriptor, bool corked) const;
+  void SetCorked(igtl::Socket* socket, bool corked) const;
+
+  bool TcpNoDelay;
+  int SendBufferSize;
+  int ReceiveBufferSize;
+  bool TcpCork;
+  int BusyPollUsec;
+  bool CoalesceMessages;
+};
+
+#endif
@@ -0,0 +1,249 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusIgtlUdpSender.h"
+#include "vtkPlusIgtlMessageCommon.h"
+
+// IGTL includes
+#include <igtl_header.h>
+
+// STL includes
+#include <algorithm>
+#include <sstream>
+
+// OS includes
+#if defined(_WIN32)
+  #include <winsock2.h>
+  #include <ws2tcpip.h>
+  typedef int socklen_t;
+#else
+  #include <arpa/inet.h>
+  #include <errno.h>
+  #include <netinet/in.h>
+  #include <string.h>
+  #include <sys/socket.h>
+  #include <unistd.h>
+#endif
+
+namespace
+{
+  // IPv4 (20 bytes) and UDP (8 bytes) headers must fit in the 1500 bytes Ethernet MTU
+  const unsigned int DEFAULT_MAX_DATAGRAM_SIZE = 1472;
+  const int INVALID_SOCKET_DESCRIPTOR = -1;
+
+  //----------------------------------------------------------------------------
+  void CloseSocketDescriptor(int socketDescriptor)
+  {
+#if defined(_WIN32)
+    closesocket(socketDescriptor);
+#else
+    close(socketDescriptor);
+#endif
+  }
+
+  //----------------------------------------------------------------------------
+  std::string GetLastSocketErrorString()
+  {
+#if defined(_WIN32)
+    std::ostringstream errorString;
+    errorString << "error code " << WSAGetLastError();
+    return errorString.str();
+#else
+    return strerror(errno);
+#endif
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusIgtlUdpSender::PlusIgtlUdpSender()
+  : Port(0)
+  , Multicast(false)
+  , MaxDatagramSize(DEFAULT_MAX_DATAGRAM_SIZE)
+  , SocketDescriptor(INVALID_SOCKET_DESCRIPTOR)
+  , DestinationAddress(0)
+  , NextSequenceNumber(1)
+  , NumberOfSentDatagrams(0)
+  , NumberOfOversizedMessages(0)
+{
+}
+
+//----------------------------------------------------------------------------
+PlusIgtlUdpSender::~PlusIgtlUdpSender()
+{
+  this->Close();
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIgtlUdpSender::Open(const std::string& address, int port, int timeToLive, const std::string& interfaceAddress)
+{
+  this->Close();
+
+  struct in_addr destinationAddress;
+  if (inet_pton(AF_INET, address.c_str(), &destinationAddress) != 1)
+  {
+    LOG_ERROR("Invalid UDP destination address: " << address << ". An IPv4 address is expected.");
+    return PLUS_FAIL;
+  }
+  if (port <= 0 || port > 65535)
+  {
+    LOG_ERROR("Invalid UDP destination port: " << port);
+    return PLUS_FAIL;
+  }
+
+  // The socket library is initialized by OpenIGTLink (igtl::Socket) on Windows
+  int socketDescriptor = static_cast<int>(socket(AF_INET, SOCK_DGRAM, IPPROTO_UDP));
+  if (socketDescriptor < 0)
+  {
+    LOG_ERROR("Failed to create UDP socket: " << GetLastSocketErrorString());
+    return PLUS_FAIL;
+  }
+
+  // Multicast addresses are in 224.0.0.0/4
+  bool multicast = (ntohl(destinationAddress.s_addr) & 0xF0000000) == 0xE0000000;
+  if (multicast)
+  {
+    unsigned char multicastTimeToLive = static_cast<unsigned char>(std::max(0, std::min(timeToLive, 255)));
+    if (setsockopt(socketDescriptor, IPPROTO_IP, IP_MULTICAST_TTL, (const char*)&multicastTimeToLive, sizeof(multicastTimeToLive)) != 0)
+    {
+      LOG_WARNING("Failed to set multicast time to live of UDP socket: " << GetLastSocketErrorString());
+    }
+    if (!interfaceAddress.empty())
+    {
+      struct in_addr multicastInterface;
+      if (inet_pton(AF_INET, interfaceAddress.c_str(), &multicastInterface) != 1
+          || setsockopt(socketDescriptor, IPPROTO_IP, IP_MULTICAST_IF, (const char*)&multicastInterface, sizeof(multicastInterface)) != 0)
+      {
+        LOG_ERROR("Failed to select multicast interface " << interfaceAddress << " for UDP socket");
+        CloseSocketDescriptor(socketDescriptor);
+        return PLUS_FAIL;
+      }
+    }
+  }
+
+  this->Address = address;
+  this->Port = port;
+  this->Multicast = multicast;
+  this->SocketDescriptor = socketDescriptor;
+  this->DestinationAddress = destinationAddress.s_addr;
+  this->NumberOfSentDatagrams = 0;
+  this->NumberOfOversizedMessages = 0;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlUdpSender::Close()
+{
+  if (this->SocketDescriptor != INVALID_SOCKET_DESCRIPTOR)
+  {
+    CloseSocketDescriptor(this->SocketDescriptor);
+    this->SocketDescriptor = INVALID_SOCKET_DESCRIPTOR;
+  }
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlUdpSender::IsOpen() const
+{
+  return this->SocketDescriptor != INVALID_SOCKET_DESCRIPTOR;
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlUdpSender::IsMulticast() const
+{
+  return this->Multicast;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlUdpSender::SetMaxDatagramSize(unsigned int maxDatagramSize)
+{
+  this->MaxDatagramSize = maxDatagramSize;
+}
+
+//----------------------------------------------------------------------------
+unsigned int PlusIgtlUdpSender::GetMaxDatagramSize() const
+{
+  return this->MaxDatagramSize;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus PlusIgtlUdpSender::Send(igtl::MessageBase* message)
+{
+  if (this->SocketDescriptor == INVALID_SOCKET_DESCRIPTOR || message == NULL)
+  {
+    return PLUS_FAIL;
+  }
+
+  // The message ID is only available in the extended header
+  if (message->GetHeaderVersion() < IGTL_HEADER_VERSION_2)
+  {
+    message->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+  }
+  message->SetMessageID(this->NextSequenceNumber);
+  message->Pack();
+
+  std::vector<igtl::PlusScatterGatherImageMessage::Segment> segments;
+  vtkPlusIgtlMessageCommon::GetPackedMessageSegments(message, segments);
+  size_t datagramSize = 0;
+  for (std::vector<igtl::PlusScatterGatherImageMessage::Segment>::const_iterator segmentIt = segments.begin(); segmentIt != segments.end(); ++segmentIt)
+  {
+    datagramSize += segmentIt->Size;
+  }
+  if (datagramSize > this->MaxDatagramSize)
+  {
+    if (this->NumberOfOversizedMessages == 0)
+    {
+      LOG_WARNING("Message " << message->GetMessageType() << " (" << message->GetDeviceName() << ") is " << datagramSize << " bytes, which exceeds the maximum UDP datagram size ("
+                  << this->MaxDatagramSize << " bytes). Oversized messages are not sent.");
+    }
+    this->NumberOfOversizedMessages++;
+    return PLUS_FAIL;
+  }
+
+  const char* datagram = NULL;
+  if (segments.size() == 1)
+  {
+    datagram = reinterpret_cast<const char*>(segments[0].Data);
+  }
+  else
+  {
+    this->DatagramBuffer.resize(datagramSize);
+    size_t offset = 0;
+    for (std::vector<igtl::PlusScatterGatherImageMessage::Segment>::const_iterator segmentIt = segments.begin(); segmentIt != segments.end(); ++segmentIt)
+    {
+      memcpy(&this->DatagramBuffer[offset], segmentIt->Data, segmentIt->Size);
+      offset += segmentIt->Size;
+    }
+    datagram = reinterpret_cast<const char*>(this->DatagramBuffer.data());
+  }
+
+  struct sockaddr_in destination;
+  memset(&destination, 0, sizeof(destination));
+  destination.sin_family = AF_INET;
+  destination.sin_port = htons(static_cast<unsigned short>(this->Port));
+  destination.sin_addr.s_addr = this->DestinationAddress;
+  if (sendto(this->SocketDescriptor, datagram, static_cast<int>(datagramSize), 0, (const struct sockaddr*)&destination, sizeof(destination)) < 0)
+  {
+    // Datagrams are not retransmitted, the next one carries newer data anyway
+    LOG_DEBUG("Failed to send UDP datagram to " << this->Address << ":" << this->Port << ": " << GetLastSocketErrorString());
+    return PLUS_FAIL;
+  }
+  this->NextSequenceNumber++;
+  this->NumberOfSentDatagrams++;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+unsigned long long PlusIgtlUdpSender::GetNumberOfSentDatagrams() const
+{
+  return this->NumberOfSentDatagrams;
+}
+
+//----------------------------------------------------------------------------
+unsigned long long PlusIgtlUdpSender::GetNumberOfOversizedMessages() const
+{
+  return this->NumberOfOversizedMessages;
+}
@@ -0,0 +1,92 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusIgtlUdpSender_h
+#define __PlusIgtlUdpSender_h
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusServerExport.h"
+
+// IGTL includes
+#include <igtlMessageBase.h>
+
+// STL includes
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*!
+  \class PlusIgtlUdpSender
+  \brief Sends OpenIGTLink messages as UDP datagrams to a unicast or multicast address
+
+  Each message is sent in a single datagram, using OpenIGTLink header version 2. The messages are numbered
+  consecutively in the message ID field of the extended header, so that receivers can detect lost datagrams and
+  discard datagrams that arrive out of order (message ID not greater than the last one received). The timestamp
+  in the header is the acquisition time of the data. Messages larger than MaxDatagramSize are not sent.
+
+  One datagram sent to a multicast group is delivered to all subscribers of the group.
+
+  Used by vtkPlusOpenIGTLinkServer for the low-latency tracking stream (UdpStream element).
+
+  \ingroup PlusLibPlusServer
+*/
+class vtkPlusServerExport PlusIgtlUdpSender
+{
+public:
+  PlusIgtlUdpSender();
+  ~PlusIgtlUdpSender();
+
+  /*!
+    Create the socket for sending to the given address and port.
+    \param timeToLive Number of routers that multicast datagrams may pass (only used for multicast addresses)
+    \param interfaceAddress Address of the local interface for sending multicast datagrams. Empty means the system default.
+  */
+  PlusStatus Open(const std::string& address, int port, int timeToLive, const std::string& interfaceAddress);
+
+  /*! Close the socket */
+  void Close();
+
+  bool IsOpen() const;
+
+  /*! Returns true if the destination is a multicast group */
+  bool IsMulticast() const;
+
+  /*! Maximum size of a datagram (bytes). The default fits in an Ethernet frame without fragmentation. */
+  void SetMaxDatagramSize(unsigned int maxDatagramSize);
+  unsigned int GetMaxDatagramSize() const;
+
+  /*! Assign the next sequence number to the message, pack it and send it */
+  PlusStatus Send(igtl::MessageBase* message);
+
+  /*! Number of datagrams sent since the socket was opened */
+  unsigned long long GetNumberOfSentDatagrams() const;
+
+  /*! Number of messages that were not sent because they did not fit in a datagram */
+  unsigned long long GetNumberOfOversizedMessages() const;
+
+protected:
+  std::string Address;
+  int Port;
+  bool Multicast;
+  unsigned int MaxDatagramSize;
+
+  /*! Socket descriptor, -1 if not open (stored as int on all platforms, same as in igtl::Socket) */
+  int SocketDescriptor;
+  /*! IPv4 destination address, in network byte order */
+  uint32_t DestinationAddress;
+
+  unsigned int NextSequenceNumber;
+  std::vector<unsigned char> DatagramBuffer;
+  unsigned long long NumberOfSentDatagrams;
+  unsigned long long NumberOfOversizedMessages;
+
+private:
+  PlusIgtlUdpSender(const PlusIgtlUdpSender&);
+  void operator=(const PlusIgtlUdpSender&);
+};
+
+#endif
@@ -0,0 +1,226 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusIgtlVideoRateController.h"
+
+// STL includes
+#include <algorithm>
+#include <limits>
+
+namespace
+{
+  // Rates are measured over at least this period, shorter periods give noisy estimates
+  const double UPDATE_INTERVAL_SEC = 0.5;
+  // The client has to keep up for this many consecutive intervals before the encoding quality is increased
+  const int NUMBER_OF_STABLE_INTERVALS_BEFORE_INCREASE = 2;
+  // Multiplicative decrease and increase of the target bitrate
+  const double BITRATE_DECREASE_FACTOR = 0.8;
+  const double BITRATE_INCREASE_FACTOR = 1.1;
+  // Upper limit of the key frame distance, relative to the configured distance
+  const int MAX_KEY_FRAME_DISTANCE_FACTOR = 4;
+}
+
+//----------------------------------------------------------------------------
+PlusIgtlVideoRateController::PlusIgtlVideoRateController()
+  : MaxSendLagSec(0.25)
+  , MaxFrameDecimation(8)
+  , MinBitrate(64000)
+  , LastUpdateTimeSec(0.0)
+  , Initialized(false)
+  , AdaptedBitrate(0)
+  , AdaptedKeyFrameDistance(0)
+  , BitrateCeiling(0)
+  , FrameDecimation(1)
+  , FrameCounter(0)
+  , NumberOfStableIntervals(0)
+{
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlVideoRateController::SetMaxSendLagSec(double maxSendLagSec)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->MaxSendLagSec = maxSendLagSec;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlVideoRateController::SetMaxFrameDecimation(int maxFrameDecimation)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->MaxFrameDecimation = std::max(maxFrameDecimation, 1);
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlVideoRateController::SetMinBitrate(int minBitrate)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  this->MinBitrate = std::max(minBitrate, 1);
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlVideoRateController::Update(const PlusIgtlClientInfo& clientInfo, const ClientSendStatistics& statistics, double systemTimeSec)
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  if (!this->Initialized)
+  {
+    this->LastStatistics = statistics;
+    this->LastUpdateTimeSec = systemTimeSec;
+    this->Initialized = true;
+    return;
+  }
+  double elapsedTimeSec = systemTimeSec - this->LastUpdateTimeSec;
+  if (elapsedTimeSec < UPDATE_INTERVAL_SEC)
+  {
+    return;
+  }
+
+  unsigned long long sentBytes = statistics.NumberOfSentBytes - this->LastStatistics.NumberOfSentBytes;
+  unsigned long sentItems = statistics.NumberOfSentItems - this->LastStatistics.NumberOfSentItems;
+  unsigned long droppedItems = statistics.NumberOfDroppedItems - this->LastStatistics.NumberOfDroppedItems;
+  double achievedBitrate = 8.0 * sentBytes / elapsedTimeSec;
+  double achievedFrameRate = sentItems / elapsedTimeSec;
+  this->LastStatistics = statistics;
+  this->LastUpdateTimeSec = systemTimeSec;
+
+  // The bitrate and key frame distance can only be changed for lossy streams
+  bool hasVideo = !clientInfo.VideoStreams.empty()
+                  && std::find(clientInfo.IgtlMessageTypes.begin(), clientInfo.IgtlMessageTypes.end(), "VIDEO") != clientInfo.IgtlMessageTypes.end();
+  bool bitrateAdjustable = false;
+  int configuredBitrate = -1;
+  int configuredKeyFrameDistance = 0;
+  for (std::vector<PlusIgtlClientInfo::VideoStream>::const_iterator it = clientInfo.VideoStreams.begin(); it != clientInfo.VideoStreams.end(); ++it)
+  {
+    if (!it->EncodeVideoParameters.Lossless)
+    {
+      bitrateAdjustable = true;
+      configuredBitrate = std::max(configuredBitrate, it->EncodeVideoParameters.TargetBitrate);
+      configuredKeyFrameDistance = std::max(configuredKeyFrameDistance, it->EncodeVideoParameters.MaxKeyframeDistance);
+    }
+  }
+
+  bool congested = droppedItems > 0
+                   || (sentItems > 0 && statistics.LastSendLagSec > this->MaxSendLagSec)
+                   || (sentItems == 0 && statistics.QueueLength > 0);
+
+  if (!hasVideo)
+  {
+    // Nothing to adapt, start from the configured encoding when video is requested again
+    this->AdaptedBitrate = 0;
+    this->AdaptedKeyFrameDistance = 0;
+    this->BitrateCeiling = 0;
+    this->FrameDecimation = 1;
+    this->NumberOfStableIntervals = 0;
+  }
+  else if (congested)
+  {
+    this->NumberOfStableIntervals = 0;
+    int currentBitrate = (this->AdaptedBitrate > 0 ? this->AdaptedBitrate : configuredBitrate);
+    double baseBitrate = achievedBitrate;
+    if (currentBitrate > 0 && (baseBitrate <= 0 || currentBitrate < baseBitrate))
+    {
+      baseBitrate = currentBitrate;
+    }
+    if (bitrateAdjustable && baseBitrate > 0 && (currentBitrate <= 0 || currentBitrate > this->MinBitrate))
+    {
+      if (this->BitrateCeiling <= 0)
+      {
+        double ceiling = (configuredBitrate > 0 ? configuredBitrate : 2.0 * achievedBitrate);
+        this->BitrateCeiling = static_cast<int>(std::min(ceiling, static_cast<double>(std::numeric_limits<int>::max())));
+      }
+      this->AdaptedBitrate = std::max(this->MinBitrate, static_cast<int>(baseBitrate * BITRATE_DECREASE_FACTOR));
+      if (configuredKeyFrameDistance > 0)
+      {
+        int keyFrameDistance = (this->AdaptedKeyFrameDistance > 0 ? this->AdaptedKeyFrameDistance : configuredKeyFrameDistance);
+        this->AdaptedKeyFrameDistance = std::min(2 * keyFrameDistance, MAX_KEY_FRAME_DISTANCE_FACTOR * configuredKeyFrameDistance);
+      }
+      this->Status.NumberOfAdjustments++;
+    }
+    else if (this->FrameDecimation < this->MaxFrameDecimation)
+    {
+      this->FrameDecimation = std::min(2 * this->FrameDecimation, this->MaxFrameDecimation);
+      this->Status.NumberOfAdjustments++;
+    }
+  }
+  else if (++this->NumberOfStableIntervals >= NUMBER_OF_STABLE_INTERVALS_BEFORE_INCREASE)
+  {
+    this->NumberOfStableIntervals = 0;
+    if (this->FrameDecimation > 1)
+    {
+      this->FrameDecimation /= 2;
+      this->Status.NumberOfAdjustments++;
+    }
+    else if (this->AdaptedBitrate > 0)
+    {
+      double increasedBitrate = this->AdaptedBitrate * BITRATE_INCREASE_FACTOR;
+      this->AdaptedBitrate = (increasedBitrate >= this->BitrateCeiling ? 0 : static_cast<int>(increasedBitrate));
+      this->Status.NumberOfAdjustments++;
+    }
+    else if (this->AdaptedKeyFrameDistance > 0)
+    {
+      this->AdaptedKeyFrameDistance = 0;
+      this->BitrateCeiling = 0;
+      this->Status.NumberOfAdjustments++;
+    }
+  }
+
+  this->Status.TargetBitrate = (this->AdaptedBitrate > 0 ? this->AdaptedBitrate : configuredBitrate);
+  this->Status.KeyFrameDistance = (this->AdaptedKeyFrameDistance > 0 ? this->AdaptedKeyFrameDistance : configuredKeyFrameDistance);
+  this->Status.FrameDecimation = this->FrameDecimation;
+  this->Status.AchievedBitrate = achievedBitrate;
+  this->Status.AchievedFrameRate = achievedFrameRate;
+  this->Status.SendLagSec = statistics.LastSendLagSec;
+  this->Status.Congested = congested;
+}
+
+//----------------------------------------------------------------------------
+bool PlusIgtlVideoRateController::AcceptFrame()
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  if (this->FrameDecimation <= 1)
+  {
+    return true;
+  }
+  return (this->FrameCounter++ % static_cast<unsigned int>(this->FrameDecimation)) == 0;
+}
+
+//----------------------------------------------------------------------------
+int PlusIgtlVideoRateController::GetFrameDecimation() const
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return this->FrameDecimation;
+}
+
+//----------------------------------------------------------------------------
+void PlusIgtlVideoRateController::ApplyToClientInfo(PlusIgtlClientInfo& clientInfo) const
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  for (std::vector<PlusIgtlClientInfo::VideoStream>::iterator it = clientInfo.VideoStreams.begin(); it != clientInfo.VideoStreams.end(); ++it)
+  {
+    PlusIgtlClientInfo::EncodingParameters& params = it->EncodeVideoParameters;
+    if (params.Lossless)
+    {
+      continue;
+    }
+    if (this->AdaptedBitrate > 0)
+    {
+      params.TargetBitrate = this->AdaptedBitrate;
+    }
+    if (this->AdaptedKeyFrameDistance > 0)
+    {
+      params.MaxKeyframeDistance = this->AdaptedKeyFrameDistance;
+      params.MinKeyframeDistance = std::min(params.MinKeyframeDistance, params.MaxKeyframeDistance);
+    }
+  }
+}
+
+//----------------------------------------------------------------------------
+ClientVideoRateStatus PlusIgtlVideoRateController::GetStatus() const
+{
+  std::lock_guard<std::mutex> lock(this->Mutex);
+  return this->Status;
+}
@@ -0,0 +1,87 @@
+/*=Plus=header=begin======================================================
+  Program: Plus
+  Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+  See License.txt for details.
+=========================================================Plus=header=end*/
+
+#ifndef __PlusIgtlVideoRateController_h
+#define __PlusIgtlVideoRateController_h
+
+// Local includes
+#include "vtkPlusServerExport.h"
+#include "PlusIgtlClientInfo.h"
+#include "vtkPlusOpenIGTLinkServer.h"
+
+// STL includes
+#include <mutex>
+
+/*!
+  \class PlusIgtlVideoRateController
+  \brief Congestion control loop that adapts the VIDEO streams of one client to the client's send throughput
+
+  The controller periodically compares the send statistics of the client's send queue to the previous values.
+  The client is considered congested if frames were dropped from its queue, if the most recently sent frame
+  waited longer than MaxSendLagSec, or if queued frames could not be sent at all during the last interval.
+
+  When the client is congested, the encoder target bitrate of lossy video streams is reduced below the achieved
+  throughput and the key frame distance is increased. When the bitrate cannot be reduced further (or all video streams
+  are lossless), every FrameDecimation-th frame is sent only. After the client has kept up for a few intervals the
+  changes are reverted step by step: decimation first, then bitrate, then key frame distance.
+
+  Used by vtkPlusOpenIGTLinkServer if AdaptiveVideoRate is enabled.
+
+  \ingroup PlusLibPlusServer
+*/
+class vtkPlusServerExport PlusIgtlVideoRateController
+{
+public:
+  PlusIgtlVideoRateController();
+
+  /*! Maximum acceptable time between queuing and sending a frame */
+  void SetMaxSendLagSec(double maxSendLagSec);
+  /*! Maximum number of frames out of which one is sent when the bitrate cannot be reduced any further */
+  void SetMaxFrameDecimation(int maxFrameDecimation);
+  /*! Lower limit of the adapted encoder target bitrate (bit/s) */
+  void SetMinBitrate(int minBitrate);
+
+  /*! Measure the throughput since the previous update and adapt the encoding if the update interval has elapsed */
+  void Update(const PlusIgtlClientInfo& clientInfo, const ClientSendStatistics& statistics, double systemTimeSec);
+
+  /*! Returns false if the VIDEO messages of the current frame have to be skipped because of frame decimation */
+  bool AcceptFrame();
+
+  /*! Only every FrameDecimation-th frame is sent in the VIDEO streams. 1 means every frame. */
+  int GetFrameDecimation() const;
+
+  /*! Override the encoding parameters of the client's lossy video streams with the adapted values */
+  void ApplyToClientInfo(PlusIgtlClientInfo& clientInfo) const;
+
+  /*! Get a copy of the current target and achieved rates */
+  ClientVideoRateStatus GetStatus() const;
+
+protected:
+  mutable std::mutex Mutex;
+
+  double MaxSendLagSec;
+  int MaxFrameDecimation;
+  int MinBitrate;
+
+  /*! Statistics at the last update, for computing the rates */
+  ClientSendStatistics LastStatistics;
+  double LastUpdateTimeSec;
+  bool Initialized;
+
+  /*! Adapted target bitrate. 0 if the configured bitrate is used. */
+  int AdaptedBitrate;
+  /*! Adapted maximum key frame distance. 0 if the configured distance is used. */
+  int AdaptedKeyFrameDistance;
+  /*! Bitrate that the adapted bitrate is restored to when the client keeps up */
+  int BitrateCeiling;
+  int FrameDecimation;
+  unsigned int FrameCounter;
+  int NumberOfStableIntervals;
+
+  ClientVideoRateStatus Status;
+};
+
+#endif
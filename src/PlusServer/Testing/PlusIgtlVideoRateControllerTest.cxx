@@ -0,0 +1,259 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file PlusIgtlVideoRateControllerTest.cxx
+  \brief Feeds simulated send statistics to PlusIgtlVideoRateController and verifies the adaptation steps:
+  multiplicative bitrate decrease and key frame distance increase on congestion, frame decimation when the
+  bitrate cannot be reduced any further, and the step by step recovery when the client keeps up.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "PlusIgtlVideoRateController.h"
+
+// VTK includes
+#include <vtksys/CommandLineArguments.hxx>
+
+namespace
+{
+  const int CONFIGURED_BITRATE = 1000000;
+  const int CONFIGURED_KEY_FRAME_DISTANCE = 50;
+  const int MIN_BITRATE = 64000;
+  const int MAX_FRAME_DECIMATION = 8;
+  // Longer than the update interval of the controller
+  const double UPDATE_PERIOD_SEC = 0.6;
+  // More than the configured bitrate with the update period, so the decrease starts from the configured bitrate
+  const unsigned long long SENT_BYTES_PER_UPDATE = 100000;
+  const int MAX_NUMBER_OF_UPDATES = 200;
+
+  //----------------------------------------------------------------------------
+  PlusIgtlClientInfo CreateClientInfo(bool lossless)
+  {
+    PlusIgtlClientInfo clientInfo;
+    clientInfo.IgtlMessageTypes.push_back("VIDEO");
+    PlusIgtlClientInfo::VideoStream videoStream;
+    videoStream.Name = "Image";
+    videoStream.EmbeddedTransformToFrame = "Reference";
+    videoStream.EncodeVideoParameters.FourCC = "VP90";
+    videoStream.EncodeVideoParameters.Lossless = lossless;
+    videoStream.EncodeVideoParameters.TargetBitrate = CONFIGURED_BITRATE;
+    videoStream.EncodeVideoParameters.MinKeyframeDistance = CONFIGURED_KEY_FRAME_DISTANCE;
+    videoStream.EncodeVideoParameters.MaxKeyframeDistance = CONFIGURED_KEY_FRAME_DISTANCE;
+    clientInfo.VideoStreams.push_back(videoStream);
+    return clientInfo;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Simulates the send queue of one client */
+  class SimulatedClient
+  {
+  public:
+    SimulatedClient()
+      : SystemTimeSec(100.0)
+    {
+      this->Controller.SetMinBitrate(MIN_BITRATE);
+      this->Controller.SetMaxFrameDecimation(MAX_FRAME_DECIMATION);
+      this->Controller.SetMaxSendLagSec(0.25);
+    }
+
+    /*! Advance the time by one update period. Frames are dropped from the queue during the period if congested is set. */
+    void Update(const PlusIgtlClientInfo& clientInfo, bool congested)
+    {
+      this->SystemTimeSec += UPDATE_PERIOD_SEC;
+      this->Statistics.NumberOfSentItems += 10;
+      this->Statistics.NumberOfSentBytes += SENT_BYTES_PER_UPDATE;
+      this->Statistics.NumberOfDroppedItems += (congested ? 1 : 0);
+      this->Statistics.LastSendLagSec = 0.01;
+      this->Controller.Update(clientInfo, this->Statistics, this->SystemTimeSec);
+    }
+
+    /*! Encoding parameters of the first video stream, as applied by the controller */
+    PlusIgtlClientInfo::EncodingParameters GetAppliedParameters(const PlusIgtlClientInfo& clientInfo) const
+    {
+      PlusIgtlClientInfo adaptedClientInfo = clientInfo;
+      this->Controller.ApplyToClientInfo(adaptedClientInfo);
+      return adaptedClientInfo.VideoStreams[0].EncodeVideoParameters;
+    }
+
+    PlusIgtlVideoRateController Controller;
+    ClientSendStatistics Statistics;
+    double SystemTimeSec;
+  };
+
+  //----------------------------------------------------------------------------
+  /*! Count the accepted frames out of numberOfFrames offered frames */
+  int GetNumberOfAcceptedFrames(PlusIgtlVideoRateController& controller, int numberOfFrames)
+  {
+    int numberOfAcceptedFrames = 0;
+    for (int i = 0; i < numberOfFrames; ++i)
+    {
+      numberOfAcceptedFrames += (controller.AcceptFrame() ? 1 : 0);
+    }
+    return numberOfAcceptedFrames;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestLossyStream()
+  {
+    PlusIgtlClientInfo clientInfo = CreateClientInfo(false);
+    SimulatedClient client;
+
+    // The first update only initializes the measurement
+    client.Update(clientInfo, true);
+    if (client.GetAppliedParameters(clientInfo).TargetBitrate != CONFIGURED_BITRATE || client.Controller.GetFrameDecimation() != 1)
+    {
+      LOG_ERROR("Encoding must not be changed before the first measurement interval");
+      return PLUS_FAIL;
+    }
+
+    // Congestion: the bitrate is reduced, the key frame distance is doubled
+    client.Update(clientInfo, true);
+    PlusIgtlClientInfo::EncodingParameters params = client.GetAppliedParameters(clientInfo);
+    if (params.TargetBitrate != 800000 || params.MaxKeyframeDistance != 2 * CONFIGURED_KEY_FRAME_DISTANCE || !client.Controller.GetStatus().Congested)
+    {
+      LOG_ERROR("Unexpected encoding after the first congested interval: bitrate " << params.TargetBitrate << ", key frame distance " << params.MaxKeyframeDistance);
+      return PLUS_FAIL;
+    }
+    if (client.Controller.GetFrameDecimation() != 1 || GetNumberOfAcceptedFrames(client.Controller, 10) != 10)
+    {
+      LOG_ERROR("Frames must not be decimated while the bitrate can be reduced");
+      return PLUS_FAIL;
+    }
+
+    // The bitrate is decreased until the minimum, then frames are decimated
+    int previousBitrate = params.TargetBitrate;
+    int numberOfUpdates = 0;
+    while (client.Controller.GetFrameDecimation() == 1 && ++numberOfUpdates < MAX_NUMBER_OF_UPDATES)
+    {
+      client.Update(clientInfo, true);
+      params = client.GetAppliedParameters(clientInfo);
+      if (params.TargetBitrate > previousBitrate || params.TargetBitrate < MIN_BITRATE
+          || params.MaxKeyframeDistance > 4 * CONFIGURED_KEY_FRAME_DISTANCE)
+      {
+        LOG_ERROR("Unexpected encoding during congestion: bitrate " << params.TargetBitrate << " (previous: " << previousBitrate << "), key frame distance " << params.MaxKeyframeDistance);
+        return PLUS_FAIL;
+      }
+      previousBitrate = params.TargetBitrate;
+    }
+    if (client.Controller.GetFrameDecimation() != 2 || params.TargetBitrate != MIN_BITRATE)
+    {
+      LOG_ERROR("Frame decimation is expected to start at the minimum bitrate: decimation " << client.Controller.GetFrameDecimation() << ", bitrate " << params.TargetBitrate);
+      return PLUS_FAIL;
+    }
+    client.Update(clientInfo, true);
+    client.Update(clientInfo, true);
+    client.Update(clientInfo, true);
+    if (client.Controller.GetFrameDecimation() != MAX_FRAME_DECIMATION)
+    {
+      LOG_ERROR("Frame decimation is expected to double up to " << MAX_FRAME_DECIMATION << ", got " << client.Controller.GetFrameDecimation());
+      return PLUS_FAIL;
+    }
+
+    // Every MAX_FRAME_DECIMATION-th frame is accepted, starting with the first one
+    if (!client.Controller.AcceptFrame())
+    {
+      LOG_ERROR("First frame after decimation started is expected to be accepted");
+      return PLUS_FAIL;
+    }
+    int numberOfAcceptedFrames = GetNumberOfAcceptedFrames(client.Controller, 4 * MAX_FRAME_DECIMATION - 1);
+    if (numberOfAcceptedFrames != 3)
+    {
+      LOG_ERROR("Expected 3 more accepted frames out of " << 4 * MAX_FRAME_DECIMATION - 1 << ", got " << numberOfAcceptedFrames);
+      return PLUS_FAIL;
+    }
+
+    // Recovery: decimation is reverted first, then the bitrate and the key frame distance
+    int previousDecimation = client.Controller.GetFrameDecimation();
+    numberOfUpdates = 0;
+    while (++numberOfUpdates < MAX_NUMBER_OF_UPDATES)
+    {
+      client.Update(clientInfo, false);
+      params = client.GetAppliedParameters(clientInfo);
+      int decimation = client.Controller.GetFrameDecimation();
+      if (decimation > previousDecimation || (decimation > 1 && params.TargetBitrate != MIN_BITRATE))
+      {
+        LOG_ERROR("Bitrate must not be increased before decimation is stopped: decimation " << decimation << ", bitrate " << params.TargetBitrate);
+        return PLUS_FAIL;
+      }
+      previousDecimation = decimation;
+      if (params.TargetBitrate == CONFIGURED_BITRATE && params.MaxKeyframeDistance == CONFIGURED_KEY_FRAME_DISTANCE)
+      {
+        break;
+      }
+    }
+    if (numberOfUpdates >= MAX_NUMBER_OF_UPDATES || client.Controller.GetFrameDecimation() != 1 || client.Controller.GetStatus().Congested)
+    {
+      LOG_ERROR("Configured encoding is not restored after the client kept up for " << numberOfUpdates << " intervals");
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestLosslessStream()
+  {
+    // The bitrate of lossless streams cannot be changed, so frames are decimated right away
+    PlusIgtlClientInfo clientInfo = CreateClientInfo(true);
+    SimulatedClient client;
+    client.Update(clientInfo, true);
+    client.Update(clientInfo, true);
+    PlusIgtlClientInfo::EncodingParameters params = client.GetAppliedParameters(clientInfo);
+    if (client.Controller.GetFrameDecimation() != 2 || params.TargetBitrate != CONFIGURED_BITRATE || params.MaxKeyframeDistance != CONFIGURED_KEY_FRAME_DISTANCE)
+    {
+      LOG_ERROR("Lossless stream is expected to be decimated without changing its encoding: decimation " << client.Controller.GetFrameDecimation()
+                << ", bitrate " << params.TargetBitrate << ", key frame distance " << params.MaxKeyframeDistance);
+      return PLUS_FAIL;
+    }
+
+    // Adaptation is reset when video is not requested anymore
+    PlusIgtlClientInfo noVideoClientInfo;
+    noVideoClientInfo.IgtlMessageTypes.push_back("TRANSFORM");
+    client.Update(noVideoClientInfo, true);
+    if (client.Controller.GetFrameDecimation() != 1 || GetNumberOfAcceptedFrames(client.Controller, 5) != 5)
+    {
+      LOG_ERROR("Frame decimation is expected to be reset when no video is requested");
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  if (TestLossyStream() != PLUS_SUCCESS || TestLosslessStream() != PLUS_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+
+  LOG_INFO("Test completed successfully!");
+  return EXIT_SUCCESS;
+}
@@ -0,0 +1,320 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+  \file vtkPlusCommandProcessorTest.cxx
+  \brief Queues blocking test commands to a vtkPlusCommandProcessor running multiple execution threads and verifies
+  the scheduling: read-only commands of different devices run concurrently, commands of the same device run one
+  after the other, and an exclusive command waits for all earlier commands and blocks all later ones.
+*/
+
+// Local includes
+#include "PlusConfigure.h"
+#include "vtkPlusCommand.h"
+#include "vtkPlusCommandProcessor.h"
+
+// VTK includes
+#include <vtkObjectFactory.h>
+#include <vtkSmartPointer.h>
+#include <vtkXMLDataElement.h>
+#include <vtksys/CommandLineArguments.hxx>
+
+// STL includes
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <set>
+
+namespace
+{
+  const std::string READ_ONLY_CMD = "TestReadOnly";
+  const std::string EXCLUSIVE_CMD = "TestExclusive";
+  // Maximum time to wait for a command that is expected to start
+  const double START_TIMEOUT_SEC = 5.0;
+  // Time given to the execution threads to start a command that is expected to wait
+  const double NOT_STARTED_CHECK_DELAY_SEC = 0.2;
+
+  //----------------------------------------------------------------------------
+  /*! Records the started test commands and releases them when the test allows them to complete */
+  class CommandTracker
+  {
+  public:
+    void CommandStarted(const std::string& label)
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      this->StartedCommands.insert(label);
+      this->Changed.notify_all();
+    }
+
+    void WaitForRelease(const std::string& label)
+    {
+      std::unique_lock<std::mutex> lock(this->Mutex);
+      this->Changed.wait(lock, [this, &label] { return this->ReleasedCommands.find(label) != this->ReleasedCommands.end(); });
+    }
+
+    void Release(const std::string& label)
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      this->ReleasedCommands.insert(label);
+      this->Changed.notify_all();
+    }
+
+    bool WaitForStart(const std::string& label)
+    {
+      std::unique_lock<std::mutex> lock(this->Mutex);
+      return this->Changed.wait_for(lock, std::chrono::duration<double>(START_TIMEOUT_SEC),
+                                    [this, &label] { return this->StartedCommands.find(label) != this->StartedCommands.end(); });
+    }
+
+    bool IsStarted(const std::string& label)
+    {
+      std::lock_guard<std::mutex> lock(this->Mutex);
+      return this->StartedCommands.find(label) != this->StartedCommands.end();
+    }
+
+  protected:
+    std::mutex Mutex;
+    std::condition_variable Changed;
+    std::set<std::string> StartedCommands;
+    std::set<std::string> ReleasedCommands;
+  };
+
+  CommandTracker Tracker;
+}
+
+//----------------------------------------------------------------------------
+/*!
+  Command that runs until the test releases it. TestReadOnly commands operate on the device set in the DeviceId
+  attribute, TestExclusive commands are exclusive. Commands are identified by their Label attribute.
+*/
+class vtkPlusCommandProcessorTestCommand : public vtkPlusCommand
+{
+public:
+  static vtkPlusCommandProcessorTestCommand* New();
+  vtkTypeMacro(vtkPlusCommandProcessorTestCommand, vtkPlusCommand);
+  virtual vtkPlusCommand* Clone() { return New(); }
+
+  virtual PlusStatus ReadConfiguration(vtkXMLDataElement* aConfig)
+  {
+    if (vtkPlusCommand::ReadConfiguration(aConfig) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    this->Label = (aConfig->GetAttribute("Label") ? aConfig->GetAttribute("Label") : "");
+    this->ExecutionDeviceId = (aConfig->GetAttribute("DeviceId") ? aConfig->GetAttribute("DeviceId") : "");
+    return PLUS_SUCCESS;
+  }
+
+  virtual PlusStatus Execute()
+  {
+    Tracker.CommandStarted(this->Label);
+    Tracker.WaitForRelease(this->Label);
+    return PLUS_SUCCESS;
+  }
+
+  virtual void GetCommandNames(std::list<std::string>& cmdNames)
+  {
+    cmdNames.clear();
+    cmdNames.push_back(READ_ONLY_CMD);
+    cmdNames.push_back(EXCLUSIVE_CMD);
+  }
+
+  virtual std::string GetDescription(const std::string& commandName)
+  {
+    return "Test command, runs until the test releases it";
+  }
+
+  virtual ExecutionModeType GetExecutionMode() const
+  {
+    return (this->Name == EXCLUSIVE_CMD ? EXECUTION_MODE_EXCLUSIVE : EXECUTION_MODE_READ_ONLY);
+  }
+
+  virtual std::string GetExecutionDeviceId() const
+  {
+    return this->ExecutionDeviceId;
+  }
+
+protected:
+  vtkPlusCommandProcessorTestCommand() {}
+  virtual ~vtkPlusCommandProcessorTestCommand() {}
+
+  std::string Label;
+  std::string ExecutionDeviceId;
+};
+
+vtkStandardNewMacro(vtkPlusCommandProcessorTestCommand);
+
+namespace
+{
+  //----------------------------------------------------------------------------
+  PlusStatus QueueTestCommand(vtkPlusCommandProcessor* processor, const std::string& commandName, const std::string& label, const std::string& deviceId)
+  {
+    std::string commandString = "<Command Name=\"" + commandName + "\" Label=\"" + label + "\" DeviceId=\"" + deviceId + "\" />";
+    return processor->QueueCommand(true, 1, commandName, commandString, "CMD_1", 1, igtl::MessageBase::MetaDataMap());
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Check that all commands in startedLabels start and none of the commands in waitingLabels start */
+  PlusStatus CheckStartedCommands(const std::vector<std::string>& startedLabels, const std::vector<std::string>& waitingLabels)
+  {
+    for (std::vector<std::string>::const_iterator it = startedLabels.begin(); it != startedLabels.end(); ++it)
+    {
+      if (!Tracker.WaitForStart(*it))
+      {
+        LOG_ERROR("Command " << *it << " is expected to start");
+        return PLUS_FAIL;
+      }
+    }
+    vtkIGSIOAccurateTimer::Delay(NOT_STARTED_CHECK_DELAY_SEC);
+    for (std::vector<std::string>::const_iterator it = waitingLabels.begin(); it != waitingLabels.end(); ++it)
+    {
+      if (Tracker.IsStarted(*it))
+      {
+        LOG_ERROR("Command " << *it << " is expected to wait");
+        return PLUS_FAIL;
+      }
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  /*! Wait until the processor completed the expected number of commands with the given name */
+  bool WaitForExecutedCommands(vtkPlusCommandProcessor* processor, const std::string& commandName, unsigned long expectedNumberOfCommands)
+  {
+    double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    while (vtkIGSIOAccurateTimer::GetSystemTime() - startTime < START_TIMEOUT_SEC)
+    {
+      std::map<std::string, CommandExecutionStatistics> statistics;
+      processor->GetCommandExecutionStatistics(statistics);
+      if (statistics[commandName].NumberOfExecutedCommands == expectedNumberOfCommands)
+      {
+        return true;
+      }
+      vtkIGSIOAccurateTimer::Delay(0.01);
+    }
+    return false;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus TestScheduling(vtkPlusCommandProcessor* processor)
+  {
+    // Received in this order: two commands of device A, one of device B, an exclusive command, one of device C
+    if (QueueTestCommand(processor, READ_ONLY_CMD, "A1", "A") != PLUS_SUCCESS
+        || QueueTestCommand(processor, READ_ONLY_CMD, "A2", "A") != PLUS_SUCCESS
+        || QueueTestCommand(processor, READ_ONLY_CMD, "B1", "B") != PLUS_SUCCESS
+        || QueueTestCommand(processor, EXCLUSIVE_CMD, "X", "") != PLUS_SUCCESS
+        || QueueTestCommand(processor, READ_ONLY_CMD, "C1", "C") != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to queue test commands");
+      return PLUS_FAIL;
+    }
+
+    // Different devices run concurrently, the second command of device A and everything from the exclusive command waits
+    std::vector<std::string> startedLabels;
+    std::vector<std::string> waitingLabels;
+    startedLabels.push_back("A1");
+    startedLabels.push_back("B1");
+    waitingLabels.push_back("A2");
+    waitingLabels.push_back("X");
+    waitingLabels.push_back("C1");
+    if (CheckStartedCommands(startedLabels, waitingLabels) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+
+    // The next command of device A starts when the previous one is completed
+    Tracker.Release("A1");
+    startedLabels.assign(1, "A2");
+    waitingLabels.assign(1, "X");
+    waitingLabels.push_back("C1");
+    if (CheckStartedCommands(startedLabels, waitingLabels) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+
+    // The exclusive command starts when all earlier commands are completed and runs alone
+    Tracker.Release("A2");
+    Tracker.Release("B1");
+    startedLabels.assign(1, "X");
+    waitingLabels.assign(1, "C1");
+    if (CheckStartedCommands(startedLabels, waitingLabels) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+
+    Tracker.Release("X");
+    startedLabels.assign(1, "C1");
+    waitingLabels.clear();
+    if (CheckStartedCommands(startedLabels, waitingLabels) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    Tracker.Release("C1");
+
+    if (!WaitForExecutedCommands(processor, READ_ONLY_CMD, 4) || !WaitForExecutedCommands(processor, EXCLUSIVE_CMD, 1))
+    {
+      LOG_ERROR("Not all commands were completed");
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+}
+
+//----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments" << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  vtkSmartPointer<vtkPlusCommandProcessor> processor = vtkSmartPointer<vtkPlusCommandProcessor>::New();
+  processor->RegisterPlusCommand(vtkSmartPointer<vtkPlusCommandProcessorTestCommand>::New());
+  processor->SetNumberOfCommandExecutionThreads(4);
+  if (processor->Start() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to start command processing");
+    return EXIT_FAILURE;
+  }
+
+  PlusStatus status = TestScheduling(processor);
+  if (status != PLUS_SUCCESS)
+  {
+    // Let the blocked commands complete, so that the processing can be stopped
+    const char* labels[] = { "A1", "A2", "B1", "X", "C1" };
+    for (int i = 0; i < 5; ++i)
+    {
+      Tracker.Release(labels[i]);
+    }
+  }
+  processor->Stop();
+
+  if (status != PLUS_SUCCESS)
+  {
+    return EXIT_FAILURE;
+  }
+  LOG_INFO("Test completed successfully!");
+  return EXIT_SUCCESS;
+}
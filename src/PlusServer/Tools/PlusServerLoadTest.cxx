@@ -0,0 +1,831 @@
+/*=Plus=header=begin======================================================
+Program: Plus
+Copyright (c) Laboratory for Percutaneous Surgery. All rights reserved.
+See License.txt for details.
+=========================================================Plus=header=end*/
+
+/*!
+\file PlusServerLoadTest.cxx
+\brief Load generator for the Plus OpenIGTLink server.
+
+Starts an in-process server that broadcasts a synthetic video stream and a fake tracker, connects a configurable
+number of simulated clients over the loopback interface and measures, for each client, the received throughput,
+the latency of frames, tracking data and commands (percentiles) and the number of frames that the client did not receive.
+The results are written as JSON, so that runs with different numbers of clients, streams and frame rates can be compared.
+
+Example: PlusServerLoadTest --clients=IMAGE+TDATA:8,VIDEO:2,COMMAND:2 --frame-size=1280x720 --video-fps=30 --duration-sec=20
+*/
+
+#include "PlusConfigure.h"
+#include "igsioCommon.h"
+#include "igtlPlusClientInfoMessage.h"
+#include "vtkIGSIOAccurateTimer.h"
+#include "vtkIGSIOTransformRepository.h"
+#include "vtkPlusChannel.h"
+#include "vtkPlusDataCollector.h"
+#include "vtkPlusDataSource.h"
+#include "vtkPlusDevice.h"
+#include "vtkPlusDeviceFactory.h"
+#include "vtkPlusIgtlMessageFactory.h"
+#include "vtkPlusOpenIGTLinkServer.h"
+#include "vtkPlusVersionCommand.h"
+
+// VTK includes
+#include <vtkMultiThreader.h>
+#include <vtkObjectFactory.h>
+#include <vtkSmartPointer.h>
+#include <vtkXMLDataElement.h>
+#include <vtkXMLUtilities.h>
+#include <vtksys/CommandLineArguments.hxx>
+#include <vtksys/SystemTools.hxx>
+
+// OpenIGTLink includes
+#include <igtlClientSocket.h>
+#include <igtlCommandMessage.h>
+#include <igtlMessageHeader.h>
+#include <igtlRTSCommandMessage.h>
+
+// STL includes
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <vector>
+
+//----------------------------------------------------------------------------
+/*!
+  \class vtkPlusLoadTestVideoSource
+  \brief Video device that generates frames of a configurable size without any hardware or input file
+
+  The pixels change in every frame, so compressed and encoded streams do not benefit from identical frames.
+  The number of generated frames is counted, so that clients can compute how many frames they missed.
+*/
+class vtkPlusLoadTestVideoSource : public vtkPlusDevice
+{
+public:
+  static vtkPlusLoadTestVideoSource* New();
+  vtkTypeMacro(vtkPlusLoadTestVideoSource, vtkPlusDevice);
+
+  virtual bool IsTracker() const { return false; }
+
+  /*! Number of frames generated since the last ResetNumberOfGeneratedFrames() call */
+  unsigned long GetNumberOfGeneratedFrames() const { return this->NumberOfGeneratedFrames; }
+  void ResetNumberOfGeneratedFrames() { this->NumberOfGeneratedFrames = 0; }
+
+  virtual PlusStatus ReadConfiguration(vtkXMLDataElement* rootConfigElement)
+  {
+    XML_FIND_DEVICE_ELEMENT_REQUIRED_FOR_READING(deviceConfig, rootConfigElement);
+    int frameSize[2] = { static_cast<int>(this->FrameSize[0]), static_cast<int>(this->FrameSize[1]) };
+    if (deviceConfig->GetVectorAttribute("FrameSize", 2, frameSize) == 2)
+    {
+      if (frameSize[0] <= 0 || frameSize[1] <= 0)
+      {
+        LOG_ERROR("Invalid FrameSize of " << this->GetDeviceId() << ": " << frameSize[0] << "x" << frameSize[1]);
+        return PLUS_FAIL;
+      }
+      this->FrameSize[0] = static_cast<unsigned int>(frameSize[0]);
+      this->FrameSize[1] = static_cast<unsigned int>(frameSize[1]);
+    }
+    return PLUS_SUCCESS;
+  }
+
+protected:
+  vtkPlusLoadTestVideoSource()
+    : NumberOfGeneratedFrames(0)
+  {
+    this->FrameSize[0] = 640;
+    this->FrameSize[1] = 480;
+    this->FrameSize[2] = 1;
+    this->RequireImageOrientationInConfiguration = true;
+    // No callback function provided by the device, so the data capture thread will be used to add new items to the buffer
+    this->StartThreadForInternalUpdates = true;
+  }
+
+  virtual PlusStatus InternalConnect()
+  {
+    vtkPlusDataSource* videoSource(NULL);
+    if (this->GetFirstVideoSource(videoSource) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Unable to retrieve the video source of " << this->GetDeviceId());
+      return PLUS_FAIL;
+    }
+    videoSource->SetPixelType(VTK_UNSIGNED_CHAR);
+    videoSource->SetImageType(US_IMG_BRIGHTNESS);
+    videoSource->SetNumberOfScalarComponents(1);
+    videoSource->SetInputFrameSize(this->FrameSize);
+    this->Pixels.assign(static_cast<size_t>(this->FrameSize[0]) * this->FrameSize[1], 0);
+    return PLUS_SUCCESS;
+  }
+
+  virtual PlusStatus InternalUpdate()
+  {
+    vtkPlusDataSource* videoSource(NULL);
+    if (this->GetFirstVideoSource(videoSource) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    // Moving gradient
+    this->FrameNumber++;
+    for (unsigned int y = 0; y < this->FrameSize[1]; ++y)
+    {
+      unsigned char* line = &this->Pixels[static_cast<size_t>(y) * this->FrameSize[0]];
+      for (unsigned int x = 0; x < this->FrameSize[0]; ++x)
+      {
+        line[x] = static_cast<unsigned char>(x + y + this->FrameNumber);
+      }
+    }
+    PlusStatus status = videoSource->AddItem(&this->Pixels[0], videoSource->GetInputImageOrientation(), this->FrameSize, VTK_UNSIGNED_CHAR, 1, US_IMG_BRIGHTNESS, 0, this->FrameNumber);
+    if (status == PLUS_SUCCESS)
+    {
+      this->NumberOfGeneratedFrames++;
+    }
+    this->Modified();
+    return status;
+  }
+
+  FrameSizeType FrameSize;
+  std::vector<unsigned char> Pixels;
+  std::atomic<unsigned long> NumberOfGeneratedFrames;
+
+private:
+  vtkPlusLoadTestVideoSource(const vtkPlusLoadTestVideoSource&);
+  void operator=(const vtkPlusLoadTestVideoSource&);
+};
+
+vtkStandardNewMacro(vtkPlusLoadTestVideoSource);
+
+namespace
+{
+  const char* LOAD_TEST_VIDEO_DEVICE_TYPE = "LoadTestVideo";
+  const char* IMAGE_NAME = "Image";
+  const char* REFERENCE_FRAME = "Tracker";
+  // FakeTracker in Default mode moves the tools connected to ports 0-3
+  const char* TOOL_NAMES[] = { "Stylus", "Probe", "Reference", "Needle" };
+  const int NUMBER_OF_TOOLS = sizeof(TOOL_NAMES) / sizeof(TOOL_NAMES[0]);
+
+  //----------------------------------------------------------------------------
+  /*! Streams requested by a group of simulated clients */
+  struct ClientProfile
+  {
+    ClientProfile()
+      : Image(false)
+      , Video(false)
+      , TrackingData(false)
+      , Commands(false)
+      , NumberOfClients(0)
+    {
+    }
+    std::string Name;
+    bool Image;
+    bool Video;
+    bool TrackingData;
+    bool Commands;
+    int NumberOfClients;
+  };
+
+  //----------------------------------------------------------------------------
+  /*! Options shared by all simulated clients */
+  struct LoadTestOptions
+  {
+    int Port;
+    double CommandRateHz;
+    std::string VideoCodec;
+  };
+
+  //----------------------------------------------------------------------------
+  /*! State and measurements of a simulated client. The measurement vectors are only accessed by the client thread while it runs. */
+  struct SimulatedClient
+  {
+    SimulatedClient()
+      : Options(NULL)
+      , Index(0)
+      , Connected(false)
+      , NumberOfReceivedFrames(0)
+      , NumberOfReceivedTrackingMessages(0)
+      , NumberOfReceivedBytes(0)
+      , NumberOfSentCommands(0)
+      , NumberOfFailedCommands(0)
+      , NumberOfErrors(0)
+      , ThreadId(-1)
+    {
+    }
+    ClientProfile Profile;
+    const LoadTestOptions* Options;
+    int Index;
+    bool Connected;
+    std::map<std::string, unsigned long> NumberOfReceivedMessagesByType;
+    unsigned long NumberOfReceivedFrames;
+    unsigned long NumberOfReceivedTrackingMessages;
+    unsigned long long NumberOfReceivedBytes;
+    unsigned long NumberOfSentCommands;
+    unsigned long NumberOfFailedCommands;
+    unsigned long NumberOfErrors;
+    std::vector<double> FrameLatenciesSec;
+    std::vector<double> TrackingLatenciesSec;
+    std::vector<double> CommandRoundTripTimesSec;
+    int ThreadId;
+  };
+
+  // Set by the main thread, read by the client threads
+  std::atomic<bool> MeasurementActive(false);
+  std::atomic<bool> StopRequested(false);
+
+  //----------------------------------------------------------------------------
+  PlusStatus ParseClientProfiles(const std::string& profilesString, std::vector<ClientProfile>& profiles)
+  {
+    std::vector<std::string> groups = igsioCommon::SplitStringIntoTokens(profilesString, ',', false);
+    for (std::vector<std::string>::const_iterator groupIt = groups.begin(); groupIt != groups.end(); ++groupIt)
+    {
+      ClientProfile profile;
+      std::string streams = *groupIt;
+      profile.NumberOfClients = 1;
+      size_t countSeparator = groupIt->find(':');
+      if (countSeparator != std::string::npos)
+      {
+        streams = groupIt->substr(0, countSeparator);
+        profile.NumberOfClients = atoi(groupIt->substr(countSeparator + 1).c_str());
+      }
+      profile.Name = streams;
+      std::vector<std::string> streamNames = igsioCommon::SplitStringIntoTokens(streams, '+', false);
+      for (std::vector<std::string>::const_iterator streamIt = streamNames.begin(); streamIt != streamNames.end(); ++streamIt)
+      {
+        if (igsioCommon::IsEqualInsensitive(*streamIt, "IMAGE"))
+        {
+          profile.Image = true;
+        }
+        else if (igsioCommon::IsEqualInsensitive(*streamIt, "VIDEO"))
+        {
+          profile.Video = true;
+        }
+        else if (igsioCommon::IsEqualInsensitive(*streamIt, "TDATA"))
+        {
+          profile.TrackingData = true;
+        }
+        else if (igsioCommon::IsEqualInsensitive(*streamIt, "COMMAND"))
+        {
+          profile.Commands = true;
+        }
+        else
+        {
+          LOG_ERROR("Unknown stream type in client profile '" << *groupIt << "': " << *streamIt << ". Valid types are IMAGE, VIDEO, TDATA and COMMAND.");
+          return PLUS_FAIL;
+        }
+      }
+      if (profile.NumberOfClients < 1 || streamNames.empty())
+      {
+        LOG_ERROR("Invalid client profile: " << *groupIt);
+        return PLUS_FAIL;
+      }
+      profiles.push_back(profile);
+    }
+    if (profiles.empty())
+    {
+      LOG_ERROR("No simulated clients are defined");
+      return PLUS_FAIL;
+    }
+    return PLUS_SUCCESS;
+  }
+
+  //----------------------------------------------------------------------------
+  vtkSmartPointer<vtkXMLDataElement> CreateConfiguration(int port, int frameWidth, int frameHeight, double videoFps, double trackerFps, int commandExecutionThreads, int clientSendQueueLength, const std::string& socketAttributes)
+  {
+    std::ostringstream config;
+    config << "<PlusConfiguration version=\"2.1\">"
+           << "<DataCollection StartupDelaySec=\"0.5\">"
+           << "<DeviceSet Name=\"PlusServerLoadTest\" Description=\"Synthetic video and fake tracker for load testing\" />"
+           << "<Device Id=\"TrackerDevice\" Type=\"FakeTracker\" Mode=\"Default\" AcquisitionRate=\"" << trackerFps << "\" ToolReferenceFrame=\"" << REFERENCE_FRAME << "\">"
+           << "<DataSources>";
+    for (int i = 0; i < NUMBER_OF_TOOLS; ++i)
+    {
+      config << "<DataSource Type=\"Tool\" Id=\"" << TOOL_NAMES[i] << "\" PortName=\"" << i << "\" />";
+    }
+    config << "</DataSources>"
+           << "<OutputChannels><OutputChannel Id=\"TrackerStream\">";
+    for (int i = 0; i < NUMBER_OF_TOOLS; ++i)
+    {
+      config << "<DataSource Id=\"" << TOOL_NAMES[i] << "\" />";
+    }
+    config << "</OutputChannel></OutputChannels>"
+           << "</Device>"
+           << "<Device Id=\"VideoDevice\" Type=\"" << LOAD_TEST_VIDEO_DEVICE_TYPE << "\" AcquisitionRate=\"" << videoFps << "\" FrameSize=\"" << frameWidth << " " << frameHeight << "\">"
+           << "<DataSources><DataSource Type=\"Video\" Id=\"Video\" PortUsImageOrientation=\"MF\" /></DataSources>"
+           << "<OutputChannels><OutputChannel Id=\"VideoStream\" VideoDataSourceId=\"Video\" /></OutputChannels>"
+           << "</Device>"
+           << "<Device Id=\"TrackedVideoDevice\" Type=\"VirtualMixer\">"
+           << "<InputChannels><InputChannel Id=\"TrackerStream\" /><InputChannel Id=\"VideoStream\" /></InputChannels>"
+           << "<OutputChannels><OutputChannel Id=\"TrackedVideoStream\" /></OutputChannels>"
+           << "</Device>"
+           << "</DataCollection>"
+           << "<CoordinateDefinitions>"
+           << "<Transform From=\"" << IMAGE_NAME << "\" To=\"Probe\" Matrix=\"1 0 0 0 0 1 0 0 0 0 1 0 0 0 0 1\" />"
+           << "</CoordinateDefinitions>"
+           << "<PlusOpenIGTLinkServer MaxNumberOfIgtlMessagesToSend=\"1\" MaxTimeSpentWithProcessingMs=\"50\" ListeningPort=\"" << port << "\""
+           << " SendValidTransformsOnly=\"false\" OutputChannelId=\"TrackedVideoStream\""
+           << " NumberOfCommandExecutionThreads=\"" << commandExecutionThreads << "\" ClientSendQueueLength=\"" << clientSendQueueLength << "\""
+           << socketAttributes << " />"
+           << "</PlusConfiguration>";
+    return vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(config.str().c_str()));
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus SendClientInfo(igtl::ClientSocket* socket, const ClientProfile& profile, const LoadTestOptions& options)
+  {
+    PlusIgtlClientInfo clientInfo;
+    clientInfo.SetClientHeaderVersion(IGTL_HEADER_VERSION_2);
+    if (profile.Image)
+    {
+      clientInfo.IgtlMessageTypes.push_back("IMAGE");
+      PlusIgtlClientInfo::ImageStream imageStream;
+      imageStream.Name = IMAGE_NAME;
+      imageStream.EmbeddedTransformToFrame = REFERENCE_FRAME;
+      clientInfo.ImageStreams.push_back(imageStream);
+    }
+    if (profile.Video)
+    {
+      clientInfo.IgtlMessageTypes.push_back("VIDEO");
+      PlusIgtlClientInfo::VideoStream videoStream;
+      videoStream.Name = IMAGE_NAME;
+      videoStream.EmbeddedTransformToFrame = REFERENCE_FRAME;
+      videoStream.EncodeVideoParameters.FourCC = options.VideoCodec;
+      clientInfo.VideoStreams.push_back(videoStream);
+    }
+    if (profile.TrackingData)
+    {
+      clientInfo.IgtlMessageTypes.push_back("TDATA");
+      clientInfo.SetTDATARequested(true);
+      for (int i = 0; i < NUMBER_OF_TOOLS; ++i)
+      {
+        clientInfo.TransformNames.push_back(igsioTransformName(TOOL_NAMES[i], REFERENCE_FRAME));
+      }
+    }
+
+    igtl::PlusClientInfoMessage::Pointer clientInfoMsg = igtl::PlusClientInfoMessage::New();
+    clientInfoMsg->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+    clientInfoMsg->SetClientInfo(clientInfo);
+    clientInfoMsg->Pack();
+    return socket->Send(clientInfoMsg->GetBufferPointer(), clientInfoMsg->GetBufferSize()) != 0 ? PLUS_SUCCESS : PLUS_FAIL;
+  }
+
+  //----------------------------------------------------------------------------
+  PlusStatus SendVersionCommand(igtl::ClientSocket* socket, igtlUint32 commandId, const std::string& commandContent)
+  {
+    igtl::CommandMessage::Pointer commandMsg = igtl::CommandMessage::New();
+    commandMsg->SetHeaderVersion(IGTL_HEADER_VERSION_2);
+    commandMsg->SetDeviceName("PlusServerLoadTest");
+    commandMsg->SetCommandId(commandId);
+    commandMsg->SetCommandName("Version");
+    commandMsg->SetCommandContent(commandContent.c_str());
+    commandMsg->Pack();
+    return socket->Send(commandMsg->GetBufferPointer(), commandMsg->GetBufferSize()) != 0 ? PLUS_SUCCESS : PLUS_FAIL;
+  }
+
+  //----------------------------------------------------------------------------
+  void* SimulatedClientThread(vtkMultiThreader::ThreadInfo* data)
+  {
+    SimulatedClient* client = static_cast<SimulatedClient*>(data->UserData);
+    const LoadTestOptions& options = *client->Options;
+
+    igtl::ClientSocket::Pointer socket = igtl::ClientSocket::New();
+    if (socket->ConnectToServer("127.0.0.1", options.Port) != 0)
+    {
+      LOG_ERROR("Simulated client " << client->Index << " failed to connect to the server on port " << options.Port);
+      client->NumberOfErrors++;
+      return NULL;
+    }
+    client->Connected = true;
+    if (SendClientInfo(socket, client->Profile, options) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Simulated client " << client->Index << " failed to send its client info");
+      client->NumberOfErrors++;
+      socket->CloseSocket();
+      return NULL;
+    }
+
+    std::string commandContent;
+    if (client->Profile.Commands)
+    {
+      vtkSmartPointer<vtkPlusVersionCommand> versionCommand = vtkSmartPointer<vtkPlusVersionCommand>::New();
+      versionCommand->SetNameToVersion();
+      vtkSmartPointer<vtkXMLDataElement> commandConfig = vtkSmartPointer<vtkXMLDataElement>::New();
+      versionCommand->WriteConfiguration(commandConfig);
+      std::ostringstream commandXml;
+      vtkXMLUtilities::FlattenElement(commandConfig, commandXml);
+      commandContent = commandXml.str();
+    }
+    const double commandPeriodSec = (options.CommandRateHz > 0) ? 1.0 / options.CommandRateHz : 1.0;
+    double nextCommandTime = vtkIGSIOAccurateTimer::GetSystemTime();
+    igtlUint32 nextCommandId = 1;
+    std::map<igtlUint32, double> pendingCommandSendTimes;
+
+    // Short timeout, so that commands are sent on time and the thread notices the stop request
+    socket->SetReceiveTimeout(static_cast<int>(std::min(0.2, commandPeriodSec) * 1000));
+
+    vtkSmartPointer<vtkPlusIgtlMessageFactory> messageFactory = vtkSmartPointer<vtkPlusIgtlMessageFactory>::New();
+    std::vector<unsigned char> bodyBuffer;
+    while (!StopRequested)
+    {
+      if (client->Profile.Commands && vtkIGSIOAccurateTimer::GetSystemTime() >= nextCommandTime)
+      {
+        igtlUint32 commandId = nextCommandId++;
+        if (SendVersionCommand(socket, commandId, commandContent) != PLUS_SUCCESS)
+        {
+          LOG_ERROR("Simulated client " << client->Index << " failed to send command");
+          client->NumberOfErrors++;
+          break;
+        }
+        if (MeasurementActive)
+        {
+          client->NumberOfSentCommands++;
+          pendingCommandSendTimes[commandId] = vtkIGSIOAccurateTimer::GetSystemTime();
+        }
+        nextCommandTime += commandPeriodSec;
+      }
+
+      igtl::MessageHeader::Pointer headerMsg = messageFactory->CreateHeaderMessage(IGTL_HEADER_VERSION_1);
+      int numOfBytesReceived = socket->Receive(headerMsg->GetBufferPointer(), headerMsg->GetBufferSize());
+      if (numOfBytesReceived == 0)
+      {
+        if (!socket->GetConnected())
+        {
+          LOG_ERROR("Simulated client " << client->Index << " was disconnected from the server");
+          client->NumberOfErrors++;
+          break;
+        }
+        // Timeout, no data
+        continue;
+      }
+      double receiveTime = vtkIGSIOAccurateTimer::GetUniversalTime();
+      if (numOfBytesReceived != headerMsg->GetBufferSize() || !(headerMsg->Unpack(0) & igtl::MessageHeader::UNPACK_HEADER))
+      {
+        LOG_ERROR("Simulated client " << client->Index << " received an invalid message header");
+        client->NumberOfErrors++;
+        break;
+      }
+
+      std::string messageType = headerMsg->GetMessageType();
+      igtl::MessageBase::Pointer bodyMsg;
+      if (messageType == "RTS_COMMAND")
+      {
+        bodyMsg = messageFactory->CreateReceiveMessage(headerMsg);
+      }
+      int bodySize = static_cast<int>(headerMsg->GetBodySizeToRead());
+      bool bodyReceived = true;
+      if (bodyMsg.IsNotNull())
+      {
+        bodyMsg->SetMessageHeader(headerMsg);
+        bodyMsg->AllocateBuffer();
+        bodyReceived = (bodySize == 0 || socket->Receive(bodyMsg->GetBufferBodyPointer(), bodyMsg->GetBufferBodySize()) == bodySize);
+      }
+      else if (bodySize > 0)
+      {
+        // The content of data messages is not decoded, the measurement is about the server
+        bodyBuffer.resize(bodySize);
+        bodyReceived = (socket->Receive(&bodyBuffer[0], bodySize) == bodySize);
+      }
+      if (!bodyReceived)
+      {
+        LOG_ERROR("Simulated client " << client->Index << " failed to receive the body of a " << messageType << " message");
+        client->NumberOfErrors++;
+        break;
+      }
+
+      if (!MeasurementActive)
+      {
+        continue;
+      }
+      client->NumberOfReceivedMessagesByType[messageType]++;
+      client->NumberOfReceivedBytes += headerMsg->GetBufferSize() + bodySize;
+
+      igtl::TimeStamp::Pointer timestamp = igtl::TimeStamp::New();
+      headerMsg->GetTimeStamp(timestamp);
+      double latencySec = receiveTime - timestamp->GetTimeStamp();
+      if (messageType == "IMAGE" || messageType == "VIDEO" || messageType == "CIMAGE" || messageType == "TRACKEDFRAME")
+      {
+        client->NumberOfReceivedFrames++;
+        client->FrameLatenciesSec.push_back(latencySec);
+      }
+      else if (messageType == "TDATA" || messageType == "TRANSFORM" || messageType == "POSITION")
+      {
+        client->NumberOfReceivedTrackingMessages++;
+        client->TrackingLatenciesSec.push_back(latencySec);
+      }
+      else if (bodyMsg.IsNotNull() && (bodyMsg->Unpack(1) & igtl::MessageHeader::UNPACK_BODY))
+      {
+        igtl::RTSCommandMessage* replyMsg = dynamic_cast<igtl::RTSCommandMessage*>(bodyMsg.GetPointer());
+        std::map<igtlUint32, double>::iterator pendingIt = pendingCommandSendTimes.find(replyMsg->GetCommandId());
+        if (pendingIt != pendingCommandSendTimes.end())
+        {
+          client->CommandRoundTripTimesSec.push_back(vtkIGSIOAccurateTimer::GetSystemTime() - pendingIt->second);
+          pendingCommandSendTimes.erase(pendingIt);
+        }
+      }
+    }
+
+    // Commands without reply by the end of the test
+    client->NumberOfFailedCommands = pendingCommandSendTimes.size();
+    socket->CloseSocket();
+    return NULL;
+  }
+
+  //----------------------------------------------------------------------------
+  double GetPercentile(std::vector<double> values, double percentile)
+  {
+    if (values.empty())
+    {
+      return 0.0;
+    }
+    std::sort(values.begin(), values.end());
+    size_t index = static_cast<size_t>(percentile / 100.0 * (values.size() - 1) + 0.5);
+    return values[std::min(index, values.size() - 1)];
+  }
+
+  //----------------------------------------------------------------------------
+  std::string EscapeJsonString(const std::string& value)
+  {
+    std::ostringstream escaped;
+    for (std::string::const_iterator it = value.begin(); it != value.end(); ++it)
+    {
+      switch (*it)
+      {
+        case '"':
+          escaped << "\\\"";
+          break;
+        case '\\':
+          escaped << "\\\\";
+          break;
+        case '\n':
+          escaped << "\\n";
+          break;
+        default:
+          escaped << *it;
+      }
+    }
+    return escaped.str();
+  }
+
+  //----------------------------------------------------------------------------
+  void WriteLatencyJson(std::ostream& os, const char* name, const std::vector<double>& latenciesSec)
+  {
+    os << "\"" << name << "\": { \"count\": " << latenciesSec.size()
+       << ", \"p50Ms\": " << 1000.0 * GetPercentile(latenciesSec, 50)
+       << ", \"p90Ms\": " << 1000.0 * GetPercentile(latenciesSec, 90)
+       << ", \"p99Ms\": " << 1000.0 * GetPercentile(latenciesSec, 99)
+       << ", \"maxMs\": " << 1000.0 * GetPercentile(latenciesSec, 100) << " }";
+  }
+}
+
+//-----------------------------------------------------------------------------
+int main(int argc, char** argv)
+{
+  bool printHelp(false);
+  std::string clientProfilesString = "IMAGE+TDATA:4";
+  std::string frameSizeString = "640x480";
+  std::string outputFileName;
+  LoadTestOptions options;
+  options.Port = 18950;
+  options.CommandRateHz = 10.0;
+  options.VideoCodec = "VP90";
+  double videoFps(30.0);
+  double trackerFps(100.0);
+  double warmupSec(2.0);
+  double durationSec(10.0);
+  int commandExecutionThreads(0);
+  int clientSendQueueLength(0);
+  bool noTcpNoDelay(false);
+  bool tcpCork(false);
+  bool coalesceMessages(false);
+  int socketSendBufferSize(0);
+  int socketBusyPollUsec(0);
+  int verboseLevel = vtkPlusLogger::LOG_LEVEL_UNDEFINED;
+
+  vtksys::CommandLineArguments args;
+  args.Initialize(argc, argv);
+
+  args.AddArgument("--help", vtksys::CommandLineArguments::NO_ARGUMENT, &printHelp, "Print this help.");
+  args.AddArgument("--clients", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &clientProfilesString,
+                   "Simulated clients as comma-separated groups of STREAMS:COUNT, where STREAMS is a +-separated list of IMAGE, VIDEO, TDATA and COMMAND (Default: IMAGE+TDATA:4).");
+  args.AddArgument("--port", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &options.Port, "Listening port of the in-process server (Default: 18950).");
+  args.AddArgument("--frame-size", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &frameSizeString, "Size of the synthetic video frames as WIDTHxHEIGHT (Default: 640x480).");
+  args.AddArgument("--video-fps", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &videoFps, "Frame rate of the synthetic video (Default: 30).");
+  args.AddArgument("--tracker-fps", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &trackerFps, "Acquisition rate of the fake tracker (Default: 100).");
+  args.AddArgument("--video-codec", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &options.VideoCodec, "FourCC of the codec requested by VIDEO clients (Default: VP90).");
+  args.AddArgument("--command-rate", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &options.CommandRateHz, "Number of commands sent per second by each COMMAND client (Default: 10).");
+  args.AddArgument("--command-threads", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &commandExecutionThreads, "NumberOfCommandExecutionThreads of the server (Default: 0, commands are executed by the main loop).");
+  args.AddArgument("--client-send-queue-length", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &clientSendQueueLength, "ClientSendQueueLength of the server (Default: 0, no per-client sender threads).");
+  args.AddArgument("--no-tcp-nodelay", vtksys::CommandLineArguments::NO_ARGUMENT, &noTcpNoDelay, "Set TcpNoDelay=FALSE on the server (Nagle's algorithm enabled).");
+  args.AddArgument("--tcp-cork", vtksys::CommandLineArguments::NO_ARGUMENT, &tcpCork, "Set TcpCork=TRUE on the server.");
+  args.AddArgument("--coalesce-messages", vtksys::CommandLineArguments::NO_ARGUMENT, &coalesceMessages, "Set CoalesceMessages=TRUE on the server (one write per frame and client).");
+  args.AddArgument("--socket-send-buffer-size", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &socketSendBufferSize, "SocketSendBufferSize of the server in bytes (Default: 0, system default).");
+  args.AddArgument("--socket-busy-poll-usec", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &socketBusyPollUsec, "SocketBusyPollUsec of the server (Default: 0, disabled).");
+  args.AddArgument("--warmup-sec", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &warmupSec, "Time after the clients are connected before the measurement starts (Default: 2).");
+  args.AddArgument("--duration-sec", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &durationSec, "Length of the measurement (Default: 10).");
+  args.AddArgument("--output-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &outputFileName, "JSON result file. If not specified then the results are written to the standard output.");
+  args.AddArgument("--verbose", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &verboseLevel, "Verbose level (1=error only, 2=warning, 3=info, 4=debug, 5=trace)");
+
+  if (!args.Parse())
+  {
+    std::cerr << "Problem parsing arguments." << std::endl;
+    std::cout << "Help: " << args.GetHelp() << std::endl;
+    exit(EXIT_FAILURE);
+  }
+
+  if (printHelp)
+  {
+    std::cout << args.GetHelp() << std::endl;
+    exit(EXIT_SUCCESS);
+  }
+
+  vtkPlusLogger::Instance()->SetLogLevel(verboseLevel);
+
+  std::vector<ClientProfile> profiles;
+  if (ParseClientProfiles(clientProfilesString, profiles) != PLUS_SUCCESS)
+  {
+    exit(EXIT_FAILURE);
+  }
+  int frameWidth(0);
+  int frameHeight(0);
+  if (sscanf(frameSizeString.c_str(), "%dx%d", &frameWidth, &frameHeight) != 2 || frameWidth <= 0 || frameHeight <= 0)
+  {
+    LOG_ERROR("Invalid frame size: " << frameSizeString << ". Expected format: WIDTHxHEIGHT");
+    exit(EXIT_FAILURE);
+  }
+  if (videoFps <= 0 || trackerFps <= 0 || durationSec <= 0)
+  {
+    LOG_ERROR("Frame rates and duration must be positive");
+    exit(EXIT_FAILURE);
+  }
+
+  std::ostringstream socketAttributes;
+  socketAttributes << " TcpNoDelay=\"" << (noTcpNoDelay ? "FALSE" : "TRUE") << "\" TcpCork=\"" << (tcpCork ? "TRUE" : "FALSE") << "\""
+                   << " CoalesceMessages=\"" << (coalesceMessages ? "TRUE" : "FALSE") << "\" SocketSendBufferSize=\"" << socketSendBufferSize << "\""
+                   << " SocketBusyPollUsec=\"" << socketBusyPollUsec << "\"";
+
+  // Start the in-process server
+  vtkSmartPointer<vtkXMLDataElement> configRootElement = CreateConfiguration(options.Port, frameWidth, frameHeight, videoFps, trackerFps, commandExecutionThreads, clientSendQueueLength, socketAttributes.str());
+  if (configRootElement == NULL)
+  {
+    LOG_ERROR("Failed to create the server configuration");
+    exit(EXIT_FAILURE);
+  }
+  vtkPlusConfig::GetInstance()->SetDeviceSetConfigurationData(configRootElement);
+
+  vtkSmartPointer<vtkPlusDataCollector> dataCollector = vtkSmartPointer<vtkPlusDataCollector>::New();
+  dataCollector->GetDeviceFactory().RegisterDevice(LOAD_TEST_VIDEO_DEVICE_TYPE, "vtkPlusLoadTestVideoSource", (vtkPlusDeviceFactory::PointerToDevice)&vtkPlusLoadTestVideoSource::New);
+  if (dataCollector->ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Datacollector failed to read configuration");
+    exit(EXIT_FAILURE);
+  }
+  vtkPlusDevice* device(NULL);
+  if (dataCollector->GetDevice(device, "VideoDevice") != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Synthetic video device is not found");
+    exit(EXIT_FAILURE);
+  }
+  vtkPlusLoadTestVideoSource* videoDevice = dynamic_cast<vtkPlusLoadTestVideoSource*>(device);
+
+  vtkSmartPointer<vtkIGSIOTransformRepository> transformRepository = vtkSmartPointer<vtkIGSIOTransformRepository>::New();
+  if (transformRepository->ReadConfiguration(configRootElement) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Transform repository failed to read configuration");
+    exit(EXIT_FAILURE);
+  }
+  if (dataCollector->Connect() != PLUS_SUCCESS || dataCollector->Start() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Datacollector failed to start");
+    exit(EXIT_FAILURE);
+  }
+  vtkSmartPointer<vtkPlusOpenIGTLinkServer> server = vtkSmartPointer<vtkPlusOpenIGTLinkServer>::New();
+  if (server->Start(dataCollector, transformRepository, configRootElement->FindNestedElementWithName("PlusOpenIGTLinkServer"), "") != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to start OpenIGTLink server");
+    exit(EXIT_FAILURE);
+  }
+
+  // Start the simulated clients
+  std::vector<SimulatedClient> clients;
+  for (std::vector<ClientProfile>::const_iterator profileIt = profiles.begin(); profileIt != profiles.end(); ++profileIt)
+  {
+    for (int i = 0; i < profileIt->NumberOfClients; ++i)
+    {
+      SimulatedClient client;
+      client.Profile = *profileIt;
+      client.Options = &options;
+      client.Index = static_cast<int>(clients.size());
+      clients.push_back(client);
+    }
+  }
+  LOG_INFO("Starting " << clients.size() << " simulated clients");
+  vtkSmartPointer<vtkMultiThreader> threader = vtkSmartPointer<vtkMultiThreader>::New();
+  for (std::vector<SimulatedClient>::iterator clientIt = clients.begin(); clientIt != clients.end(); ++clientIt)
+  {
+    clientIt->ThreadId = threader->SpawnThread((vtkThreadFunctionType)&SimulatedClientThread, &(*clientIt));
+  }
+
+  // Warm up, measure, then stop the clients. The server needs the main thread for processing commands.
+  const double commandQueuePollIntervalSec = 0.005;
+  double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  double measurementStartTime(0.0);
+  double measurementStopTime(0.0);
+  unsigned long generatedFrames(0);
+  while (!StopRequested)
+  {
+    double now = vtkIGSIOAccurateTimer::GetSystemTime();
+    if (!MeasurementActive && measurementStartTime == 0.0 && now >= startTime + warmupSec)
+    {
+      if (videoDevice != NULL)
+      {
+        videoDevice->ResetNumberOfGeneratedFrames();
+      }
+      measurementStartTime = now;
+      MeasurementActive = true;
+      LOG_INFO("Measurement started");
+    }
+    else if (MeasurementActive && now >= measurementStartTime + durationSec)
+    {
+      MeasurementActive = false;
+      measurementStopTime = now;
+      generatedFrames = (videoDevice != NULL) ? videoDevice->GetNumberOfGeneratedFrames() : 0;
+      StopRequested = true;
+      break;
+    }
+    server->ProcessPendingCommands();
+    vtkIGSIOAccurateTimer::Delay(commandQueuePollIntervalSec);
+  }
+  for (std::vector<SimulatedClient>::iterator clientIt = clients.begin(); clientIt != clients.end(); ++clientIt)
+  {
+    if (clientIt->ThreadId >= 0)
+    {
+      threader->TerminateThread(clientIt->ThreadId);
+    }
+  }
+
+  unsigned int numberOfConnectedClients = server->GetNumberOfConnectedClients();
+  server->Stop();
+  dataCollector->Stop();
+  dataCollector->Disconnect();
+
+  // Report
+  double measuredDurationSec = measurementStopTime - measurementStartTime;
+  std::ostringstream json;
+  json << std::fixed << std::setprecision(3);
+  json << "{" << std::endl
+       << "  \"configuration\": { \"clients\": \"" << EscapeJsonString(clientProfilesString) << "\", \"frameWidth\": " << frameWidth << ", \"frameHeight\": " << frameHeight
+       << ", \"videoFps\": " << videoFps << ", \"trackerFps\": " << trackerFps << ", \"commandRateHz\": " << options.CommandRateHz
+       << ", \"commandExecutionThreads\": " << commandExecutionThreads << ", \"clientSendQueueLength\": " << clientSendQueueLength
+       << ", \"tcpNoDelay\": " << (noTcpNoDelay ? "false" : "true") << ", \"tcpCork\": " << (tcpCork ? "true" : "false")
+       << ", \"coalesceMessages\": " << (coalesceMessages ? "true" : "false") << ", \"socketSendBufferSize\": " << socketSendBufferSize
+       << ", \"socketBusyPollUsec\": " << socketBusyPollUsec
+       << ", \"durationSec\": " << measuredDurationSec << " }," << std::endl
+       << "  \"server\": { \"generatedFrames\": " << generatedFrames << ", \"connectedClientsAtEnd\": " << numberOfConnectedClients << " }," << std::endl
+       << "  \"clients\": [" << std::endl;
+  int numberOfErrors(0);
+  for (std::vector<SimulatedClient>::const_iterator clientIt = clients.begin(); clientIt != clients.end(); ++clientIt)
+  {
+    bool receivesFrames = clientIt->Profile.Image || clientIt->Profile.Video;
+    long droppedFrames = receivesFrames ? static_cast<long>(generatedFrames) - static_cast<long>(clientIt->NumberOfReceivedFrames) : 0;
+    json << "    { \"index\": " << clientIt->Index << ", \"streams\": \"" << EscapeJsonString(clientIt->Profile.Name) << "\""
+         << ", \"connected\": " << (clientIt->Connected ? "true" : "false") << ", \"errors\": " << clientIt->NumberOfErrors
+         << ", \"receivedBytes\": " << clientIt->NumberOfReceivedBytes
+         << ", \"throughputMBps\": " << (measuredDurationSec > 0 ? clientIt->NumberOfReceivedBytes / measuredDurationSec / 1e6 : 0.0)
+         << ", \"receivedFrames\": " << clientIt->NumberOfReceivedFrames
+         << ", \"frameRateFps\": " << (measuredDurationSec > 0 ? clientIt->NumberOfReceivedFrames / measuredDurationSec : 0.0)
+         << ", \"droppedFrames\": " << std::max(droppedFrames, 0L)
+         << ", \"receivedTrackingMessages\": " << clientIt->NumberOfReceivedTrackingMessages
+         << ", \"sentCommands\": " << clientIt->NumberOfSentCommands << ", \"unansweredCommands\": " << clientIt->NumberOfFailedCommands
+         << ", \"messagesByType\": {";
+    for (std::map<std::string, unsigned long>::const_iterator typeIt = clientIt->NumberOfReceivedMessagesByType.begin(); typeIt != clientIt->NumberOfReceivedMessagesByType.end(); ++typeIt)
+    {
+      json << (typeIt == clientIt->NumberOfReceivedMessagesByType.begin() ? " " : ", ") << "\"" << EscapeJsonString(typeIt->first) << "\": " << typeIt->second;
+    }
+    json << " }, ";
+    WriteLatencyJson(json, "frameLatency", clientIt->FrameLatenciesSec);
+    json << ", ";
+    WriteLatencyJson(json, "trackingLatency", clientIt->TrackingLatenciesSec);
+    json << ", ";
+    WriteLatencyJson(json, "commandRoundTrip", clientIt->CommandRoundTripTimesSec);
+    json << " }" << ((clientIt + 1 != clients.end()) ? "," : "") << std::endl;
+    numberOfErrors += clientIt->NumberOfErrors;
+  }
+  json << "  ]" << std::endl << "}" << std::endl;
+
+  if (outputFileName.empty())
+  {
+    std::cout << json.str();
+  }
+  else
+  {
+    std::ofstream outputFile(outputFileName.c_str());
+    if (!outputFile)
+    {
+      LOG_ERROR("Failed to open output file: " << outputFileName);
+      exit(EXIT_FAILURE);
+    }
+    outputFile << json.str();
+    LOG_INFO("Results are written to " << outputFileName);
+  }
+
+  return (numberOfErrors == 0) ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -38,6 +38,11 @@ See License.txt for details.
 #include <cstdlib>
 #include <cstdio>
 
+// STL includes
+#include <chrono>
+#include <future>
+#include <vector>
+
 //----------------------------------------------------------------------------
 // For CTRL-C signal handling
 static bool StopClientRequested = false;
@@ -703,6 +708,68 @@ PlusStatus RunTests(vtkPlusOpenIGTLinkClient* client)
   return PLUS_SUCCESS;
 }
 
+//----------------------------------------------------------------------------
+// Compare the command throughput of waiting for each reply and of pipelining the commands
+PlusStatus RunCommandBenchmark(vtkPlusOpenIGTLinkClient* client, int numberOfCommands)
+{
+  const double replyTimeoutSec = 10.0;
+  vtkSmartPointer<vtkPlusVersionCommand> cmd = vtkSmartPointer<vtkPlusVersionCommand>::New();
+  cmd->SetNameToVersion();
+
+  // Synchronous: the next command is sent when the reply of the previous one is received
+  double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+  for (int i = 0; i < numberOfCommands; ++i)
+  {
+    if (client->SendCommand(cmd) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Failed to send command " << i);
+      return PLUS_FAIL;
+    }
+    PlusStatus result = PLUS_FAIL;
+    int32_t originalCommandId(-1);
+    std::string errorString;
+    std::string content;
+    igtl::MessageBase::MetaDataMap parameters;
+    std::string commandName;
+    if (client->ReceiveReply(result, originalCommandId, errorString, content, parameters, commandName, replyTimeoutSec) != PLUS_SUCCESS || result != PLUS_SUCCESS)
+    {
+      LOG_ERROR("No successful reply received for command " << i);
+      return PLUS_FAIL;
+    }
+  }
+  double synchronousTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
+
+  // Pipelined: all the commands are sent before waiting for the replies
+  startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+  std::vector< std::future<vtkPlusOpenIGTLinkClient::CommandReply> > replies;
+  replies.reserve(numberOfCommands);
+  for (int i = 0; i < numberOfCommands; ++i)
+  {
+    replies.push_back(client->SendCommandAsync(cmd));
+  }
+  for (int i = 0; i < numberOfCommands; ++i)
+  {
+    if (replies[i].wait_for(std::chrono::duration<double>(replyTimeoutSec)) != std::future_status::ready)
+    {
+      LOG_ERROR("No reply received for command " << i);
+      return PLUS_FAIL;
+    }
+    vtkPlusOpenIGTLinkClient::CommandReply reply = replies[i].get();
+    if (reply.Status != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Command " << i << " failed: " << reply.ErrorString);
+      return PLUS_FAIL;
+    }
+  }
+  double pipelinedTimeSec = vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
+
+  LOG_INFO("Synchronous commands: " << numberOfCommands / synchronousTimeSec << " commands/s ("
+           << synchronousTimeSec * 1000.0 / numberOfCommands << " ms per command)");
+  LOG_INFO("Pipelined commands: " << numberOfCommands / pipelinedTimeSec << " commands/s ("
+           << pipelinedTimeSec * 1000.0 / numberOfCommands << " ms per command)");
+  return PLUS_SUCCESS;
+}
+
 // -------------------------------------------------
 // For CTRL-C signal handling
 void SignalInterruptHandler(int s)
@@ -737,6 +804,7 @@ int main(int argc, char** argv)
   bool keepConnected = false;
   std::string serverConfigFileName;
   bool runTests = false;
+  int benchmarkCommands(0);
   int serverIGTLVersion(-1);
   int commandId(0);
 
@@ -768,6 +836,7 @@ int main(int argc, char** argv)
   args.AddArgument("--response-expected", vtksys::CommandLineArguments::NO_ARGUMENT, &responseExpected, "Wait for a response after sending text");
   args.AddArgument("--server-config-file", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &serverConfigFileName, "Starts a PlusServer instance with the provided config file. When this process exits, the server is stopped.");
   args.AddArgument("--run-tests", vtksys::CommandLineArguments::NO_ARGUMENT, &runTests, "Test execution of all remote control commands. Requires a running PlusServer, which can be launched by --server-config-file");
+  args.AddArgument("--benchmark-commands", vtksys::CommandLineArguments::EQUAL_ARGUMENT, &benchmarkCommands, "Send the specified number of commands waiting for each reply, then pipelined, and print the command throughput of both methods.");
 
   if (!args.Parse())
   {
@@ -776,9 +845,9 @@ int main(int argc, char** argv)
     exit(EXIT_FAILURE);
   }
 
-  if (command.empty() && !keepConnected && !runTests)
+  if (command.empty() && !keepConnected && !runTests && benchmarkCommands <= 0)
   {
-    LOG_ERROR("The program has nothing to do, as neither --command, --keep-connected, nor --run-tests is specifed");
+    LOG_ERROR("The program has nothing to do, as neither --command, --keep-connected, --run-tests, nor --benchmark-commands is specifed");
     std::cout << "Help: " << args.GetHelp() << std::endl;
     exit(EXIT_FAILURE);
   }
@@ -941,6 +1010,16 @@ int main(int argc, char** argv)
     StopClientRequested = true;
   }
 
+  // Measure command throughput
+  if (benchmarkCommands > 0)
+  {
+    if (RunCommandBenchmark(client, benchmarkCommands) != PLUS_SUCCESS)
+    {
+      processReturnValue = EXIT_FAILURE;
+    }
+    StopClientRequested = true;
+  }
+
   // Remain connected until the user requests to stop
   if (!StopClientRequested)
   {
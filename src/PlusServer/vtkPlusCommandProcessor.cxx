@@ -21,8 +21,10 @@ See License.txt for details.
 #endif
 #include "vtkPlusAddRecordingDeviceCommand.h"
 #include "vtkPlusGetPolydataCommand.h"
+#include "vtkPlusGetServerStatisticsCommand.h"
 #include "vtkPlusGetTransformCommand.h"
 #include "vtkPlusGetUsParameterCommand.h"
+#include "vtkPlusGetVideoRateCommand.h"
 #include "vtkPlusRequestIdsCommand.h"
 #include "vtkPlusSaveConfigCommand.h"
 #include "vtkPlusSendTextCommand.h"
@@ -40,15 +42,25 @@ See License.txt for details.
 #include <vtkObjectFactory.h>
 #include <vtkXMLUtilities.h>
 
+// STL includes
+#include <algorithm>
+
 vtkStandardNewMacro(vtkPlusCommandProcessor);
 
+namespace
+{
+  const int DEFAULT_NUMBER_OF_COMMAND_EXECUTION_THREADS = 4;
+}
+
 //----------------------------------------------------------------------------
 vtkPlusCommandProcessor::vtkPlusCommandProcessor()
   : PlusServer(NULL)
   , Threader(vtkSmartPointer<vtkMultiThreader>::New())
   , Mutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
-  , CommandExecutionActive(std::make_pair(false, false))
-  , CommandExecutionThreadId(-1)
+  , NumberOfCommandExecutionThreads(DEFAULT_NUMBER_OF_COMMAND_EXECUTION_THREADS)
+  , CommandExecutionStopRequested(false)
+  , NumberOfRunningCommands(0)
+  , ExclusiveCommandRunning(false)
 {
   // Register default commands
   RegisterPlusCommand(vtkSmartPointer<vtkPlusGetImageCommand>::New());
@@ -64,6 +76,8 @@ vtkPlusCommandProcessor::vtkPlusCommandProcessor()
   RegisterPlusCommand(vtkSmartPointer<vtkPlusSetUsParameterCommand>::New());
   RegisterPlusCommand(vtkSmartPointer<vtkPlusGetUsParameterCommand>::New());
   RegisterPlusCommand(vtkSmartPointer<vtkPlusAddRecordingDeviceCommand>::New());
+  RegisterPlusCommand(vtkSmartPointer<vtkPlusGetVideoRateCommand>::New());
+  RegisterPlusCommand(vtkSmartPointer<vtkPlusGetServerStatisticsCommand>::New());
 #ifdef PLUS_USE_STEALTHLINK
   RegisterPlusCommand(vtkSmartPointer<vtkPlusStealthLinkCommand>::New());
 #endif
@@ -75,6 +89,7 @@ vtkPlusCommandProcessor::vtkPlusCommandProcessor()
 //----------------------------------------------------------------------------
 vtkPlusCommandProcessor::~vtkPlusCommandProcessor()
 {
+  Stop();
   SetPlusServer(NULL);
 }
 
@@ -87,35 +102,67 @@ void vtkPlusCommandProcessor::PrintSelf(ostream& os, vtkIndent indent)
   {
     os << indent << "  " << iter->first << std::endl;
   }
+  os << indent << "NumberOfCommandExecutionThreads: " << this->NumberOfCommandExecutionThreads << std::endl;
 }
 
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusCommandProcessor::Start()
 {
-  if (this->CommandExecutionThreadId < 0)
+  if (!this->CommandExecutionThreadIds.empty())
   {
-    this->CommandExecutionActive.first = true;
-    this->CommandExecutionThreadId = this->Threader->SpawnThread((vtkThreadFunctionType)&CommandExecutionThread, this);
+    return PLUS_SUCCESS;
+  }
+  if (this->NumberOfCommandExecutionThreads < 1)
+  {
+    LOG_ERROR("Cannot start command processing: NumberOfCommandExecutionThreads must be positive (current value: " << this->NumberOfCommandExecutionThreads << ")");
+    return PLUS_FAIL;
   }
+
+  {
+    std::lock_guard<std::mutex> lock(this->CommandQueueMutex);
+    this->CommandExecutionStopRequested = false;
+  }
+  for (int i = 0; i < this->NumberOfCommandExecutionThreads; ++i)
+  {
+    this->CommandExecutionThreadIds.push_back(this->Threader->SpawnThread((vtkThreadFunctionType)&CommandExecutionThread, this));
+  }
+
+  LOG_DEBUG("Started " << this->NumberOfCommandExecutionThreads << " command execution threads");
   return PLUS_SUCCESS;
 }
 
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusCommandProcessor::Stop()
 {
-  // Stop the command execution thread
-  if (this->CommandExecutionThreadId >= 0)
+  if (this->CommandExecutionThreadIds.empty())
   {
-    this->CommandExecutionActive.first = false;
-    while (this->CommandExecutionActive.second)
+    return PLUS_SUCCESS;
+  }
+
+  // Wake up all the idle threads, running commands are completed
+  {
+    std::lock_guard<std::mutex> lock(this->CommandQueueMutex);
+    this->CommandExecutionStopRequested = true;
+  }
+  this->CommandQueueChanged.notify_all();
+
+  for (std::vector<int>::iterator threadIt = this->CommandExecutionThreadIds.begin(); threadIt != this->CommandExecutionThreadIds.end(); ++threadIt)
+  {
+    // Waits until the thread returns
+    this->Threader->TerminateThread(*threadIt);
+  }
+  this->CommandExecutionThreadIds.clear();
+
+  {
+    std::lock_guard<std::mutex> lock(this->CommandQueueMutex);
+    if (!this->CommandQueue.empty())
     {
-      // Wait until the thread stops
-      vtkIGSIOAccurateTimer::Delay(0.2);
+      LOG_WARNING("Command processing stopped, " << this->CommandQueue.size() << " queued commands are not executed");
+      this->CommandQueue.clear();
     }
-    this->CommandExecutionThreadId = -1;
   }
 
-  LOG_DEBUG("Command execution thread stopped");
+  LOG_DEBUG("Command execution threads stopped");
 
   return PLUS_SUCCESS;
 }
@@ -125,62 +172,164 @@ void* vtkPlusCommandProcessor::CommandExecutionThread(vtkMultiThreader::ThreadIn
 {
   vtkPlusCommandProcessor* self = (vtkPlusCommandProcessor*)(data->UserData);
 
-  self->CommandExecutionActive.second = true;
-
   // Execute commands until a stop is requested
-  while (self->CommandExecutionActive.first)
+  while (true)
   {
-    self->ExecuteCommands();
-    // no commands in the queue, wait a bit before checking again
-    const double commandQueuePollIntervalSec = 0.010;
-#ifdef _WIN32
-    Sleep(commandQueuePollIntervalSec * 1000);
-#else
-    usleep(commandQueuePollIntervalSec * 1000000);
-#endif
+    QueuedCommand queuedCommand;
+    {
+      std::unique_lock<std::mutex> lock(self->CommandQueueMutex);
+      self->CommandQueueChanged.wait(lock, [self, &queuedCommand]
+      {
+        return self->CommandExecutionStopRequested || self->PopRunnableCommand(queuedCommand);
+      });
+      if (queuedCommand.Command.GetPointer() == NULL)
+      {
+        // stop requested
+        break;
+      }
+    }
+    self->ExecuteQueuedCommand(queuedCommand);
   }
 
-  // Close thread
-  self->CommandExecutionThreadId = -1;
-  self->CommandExecutionActive.second = false;
   return NULL;
 }
 
 //----------------------------------------------------------------------------
 int vtkPlusCommandProcessor::ExecuteCommands()
 {
+  if (this->IsRunning())
+  {
+    // commands are executed by the command execution threads
+    return 0;
+  }
+
   // Implemented in a while loop to not block the mutex during command execution, only during management of the queue.
   int numberOfExecutedCommands(0);
   while (1)
   {
-    vtkSmartPointer<vtkPlusCommand> cmd; // next command to be processed
+    QueuedCommand queuedCommand; // next command to be processed
     {
-      igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
-      if (this->CommandQueue.empty())
+      std::lock_guard<std::mutex> lock(this->CommandQueueMutex);
+      if (!this->PopRunnableCommand(queuedCommand))
       {
         return numberOfExecutedCommands;
       }
-      cmd = this->CommandQueue.front();
-      this->CommandQueue.pop_front();
     }
 
-    LOG_DEBUG("Executing command");
-    if (cmd->Execute() != PLUS_SUCCESS)
+    this->ExecuteQueuedCommand(queuedCommand);
+    numberOfExecutedCommands++;
+  }
+
+  // we never actually reach this point
+  return numberOfExecutedCommands;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusCommandProcessor::PopRunnableCommand(QueuedCommand& queuedCommand)
+{
+  if (this->ExclusiveCommandRunning)
+  {
+    return false;
+  }
+
+  // A command cannot start while an earlier command of the same device is running or waiting
+  std::set<std::string> blockedDevices(this->BusyDevices);
+  for (std::list<QueuedCommand>::iterator it = this->CommandQueue.begin(); it != this->CommandQueue.end(); ++it)
+  {
+    vtkPlusCommand* cmd = it->Command.GetPointer();
+    vtkPlusCommand::ExecutionModeType executionMode = cmd->GetExecutionMode();
+    std::string deviceId;
+    if (executionMode == vtkPlusCommand::EXECUTION_MODE_EXCLUSIVE)
+    {
+      // Commands received after an exclusive command must not overtake it, as they may depend on its result
+      if (it != this->CommandQueue.begin() || this->NumberOfRunningCommands > 0)
+      {
+        return false;
+      }
+      this->ExclusiveCommandRunning = true;
+    }
+    else
     {
-      LOG_ERROR("Command execution failed");
+      deviceId = cmd->GetExecutionDeviceId();
+      if (!deviceId.empty())
+      {
+        if (blockedDevices.find(deviceId) != blockedDevices.end())
+        {
+          continue;
+        }
+        this->BusyDevices.insert(deviceId);
+      }
     }
 
-    // move the response objects from the command to the processor's queue
+    queuedCommand = *it;
+    queuedCommand.ExecutionMode = executionMode;
+    queuedCommand.ExecutionDeviceId = deviceId;
+    this->CommandQueue.erase(it);
+    this->NumberOfRunningCommands++;
+    return true;
+  }
+
+  return false;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusCommandProcessor::ExecuteQueuedCommand(QueuedCommand& queuedCommand)
+{
+  vtkPlusCommand* cmd = queuedCommand.Command.GetPointer();
+  double startTime = vtkIGSIOAccurateTimer::GetSystemTime();
+
+  LOG_DEBUG("Executing command: " << cmd->GetName());
+  if (cmd->Execute() != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Command execution failed");
+  }
+
+  // move the response objects from the command to the processor's queue
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
+    cmd->PopCommandResponses(this->CommandResponseQueue);
+  }
+
+  double completionTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  double roundTripTimeSec = completionTime - queuedCommand.QueueTime;
+  double queueWaitTimeSec = startTime - queuedCommand.QueueTime;
+  LOG_DEBUG("Command " << cmd->GetName() << " completed in " << roundTripTimeSec * 1000.0 << " ms (waited in queue for " << queueWaitTimeSec * 1000.0 << " ms)");
+
+  {
+    std::lock_guard<std::mutex> lock(this->CommandQueueMutex);
+    this->NumberOfRunningCommands--;
+    if (queuedCommand.ExecutionMode == vtkPlusCommand::EXECUTION_MODE_EXCLUSIVE)
     {
-      igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
-      cmd->PopCommandResponses(this->CommandResponseQueue);
+      this->ExclusiveCommandRunning = false;
+    }
+    else if (!queuedCommand.ExecutionDeviceId.empty())
+    {
+      this->BusyDevices.erase(queuedCommand.ExecutionDeviceId);
     }
 
-    numberOfExecutedCommands++;
+    CommandExecutionStatistics& statistics = this->CommandStatistics[cmd->GetName()];
+    statistics.NumberOfExecutedCommands++;
+    statistics.LastRoundTripTimeSec = roundTripTimeSec;
+    statistics.AverageRoundTripTimeSec += (roundTripTimeSec - statistics.AverageRoundTripTimeSec) / statistics.NumberOfExecutedCommands;
+    statistics.MaxRoundTripTimeSec = std::max(statistics.MaxRoundTripTimeSec, roundTripTimeSec);
+    statistics.AverageQueueWaitTimeSec += (queueWaitTimeSec - statistics.AverageQueueWaitTimeSec) / statistics.NumberOfExecutedCommands;
   }
 
-  // we never actually reach this point
-  return numberOfExecutedCommands;
+  // Commands that were blocked by this command may be started now
+  this->CommandQueueChanged.notify_all();
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusCommandProcessor::PushCommand(vtkPlusCommand* cmd)
+{
+  QueuedCommand queuedCommand;
+  queuedCommand.Command = cmd;
+  queuedCommand.QueueTime = vtkIGSIOAccurateTimer::GetSystemTime();
+  {
+    std::lock_guard<std::mutex> lock(this->CommandQueueMutex);
+    this->CommandQueue.push_back(queuedCommand);
+  }
+  this->CommandQueueChanged.notify_one();
 }
 
 //----------------------------------------------------------------------------
@@ -279,8 +428,7 @@ PlusStatus vtkPlusCommandProcessor::QueueCommand(bool respondUsingIGTLCommand, u
   cmd->SetRespondWithCommandMessage(respondUsingIGTLCommand);
 
   // Add command to the execution queue
-  igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
-  this->CommandQueue.push_back(cmd);
+  this->PushCommand(cmd);
 
   return PLUS_SUCCESS;
 }
@@ -338,11 +486,9 @@ PlusStatus vtkPlusCommandProcessor::QueueGetImageMetaData(unsigned int clientId,
   cmdGetImage->SetDeviceName(deviceName.c_str());
   cmdGetImage->SetNameToGetImageMeta();
   cmdGetImage->SetImageId(deviceName.c_str());
-  {
-    // Add command to the execution queue
-    igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
-    this->CommandQueue.push_back(cmdGetImage);
-  }
+
+  // Add command to the execution queue
+  this->PushCommand(cmdGetImage);
   return PLUS_SUCCESS;
 }
 
@@ -355,11 +501,9 @@ PlusStatus vtkPlusCommandProcessor::QueueGetImage(unsigned int clientId, const s
   cmdGetImage->SetDeviceName(deviceName.c_str());
   cmdGetImage->SetNameToGetImage();
   cmdGetImage->SetImageId(deviceName.c_str());
-  {
-    // Add command to the execution queue
-    igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
-    this->CommandQueue.push_back(cmdGetImage);
-  }
+
+  // Add command to the execution queue
+  this->PushCommand(cmdGetImage);
   return PLUS_SUCCESS;
 }
 
@@ -376,6 +520,20 @@ void vtkPlusCommandProcessor::PopCommandResponses(PlusCommandResponseList& respo
 //------------------------------------------------------------------------------
 bool vtkPlusCommandProcessor::IsRunning()
 {
-  return this->CommandExecutionActive.second;
+  return !this->CommandExecutionThreadIds.empty();
+}
+
+//------------------------------------------------------------------------------
+void vtkPlusCommandProcessor::GetCommandExecutionStatistics(std::map<std::string, CommandExecutionStatistics>& statistics)
+{
+  std::lock_guard<std::mutex> lock(this->CommandQueueMutex);
+  statistics = this->CommandStatistics;
+}
+
+//------------------------------------------------------------------------------
+void vtkPlusCommandProcessor::ResetCommandExecutionStatistics()
+{
+  std::lock_guard<std::mutex> lock(this->CommandQueueMutex);
+  this->CommandStatistics.clear();
 }
 
@@ -14,18 +14,54 @@
 #include "vtkPlusCommand.h"
 #include "vtkPlusCommandResponse.h"
 #include "vtkPlusOpenIGTLinkServer.h"
+
+// STL includes
+#include <condition_variable>
+#include <list>
+#include <map>
+#include <mutex>
+#include <set>
 #include <string>
+#include <vector>
 
 class vtkImageData;
 class vtkMatrix4x4;
 
+/*! Round-trip time statistics of the commands with the same name */
+struct CommandExecutionStatistics
+{
+  CommandExecutionStatistics()
+    : NumberOfExecutedCommands(0)
+    , LastRoundTripTimeSec(0.0)
+    , AverageRoundTripTimeSec(0.0)
+    , MaxRoundTripTimeSec(0.0)
+    , AverageQueueWaitTimeSec(0.0)
+  {
+  }
+
+  /*! Total number of completed commands */
+  unsigned long NumberOfExecutedCommands;
+  /*! Time elapsed between queuing the most recent command and queuing its responses */
+  double LastRoundTripTimeSec;
+  /*! Average time elapsed between queuing a command and queuing its responses */
+  double AverageRoundTripTimeSec;
+  /*! Largest time elapsed between queuing a command and queuing its responses */
+  double MaxRoundTripTimeSec;
+  /*! Average time a command waited in the queue before its execution started */
+  double AverageQueueWaitTimeSec;
+};
+
 /*!
   \class vtkPlusCommandProcessor
   \brief Creates a PlusCommand from a string.
   If the commands are to be executed on the main thread then call ExecuteCommands() periodically from the main thread.
-  If the commands are to be executed on a separate thread (to allow background processing, but maybe requiring more synchronization) call Start() to start an internal processing thread.
-  Probably one of the processing models would be enough, but at this point it's not clear which one is better.
-  TODO: keep only one method and remove the other approach completely once the processing model decision is finalized.
+  If the commands are to be executed on separate threads (to allow background processing, but requiring more synchronization)
+  call Start() to start NumberOfCommandExecutionThreads worker threads that wait for queued commands.
+
+  Worker threads execute commands concurrently, depending on the execution mode of the commands (see vtkPlusCommand::GetExecutionMode):
+  read-only commands run in parallel, except commands operating on the same device, which are executed one after the other in the
+  order they were received. An exclusive command waits until all previously received commands are completed, and no command
+  is started until the exclusive command is completed.
   \ingroup PlusLibPlusServer
 */
 class vtkPlusServerExport vtkPlusCommandProcessor : public vtkObject
@@ -41,15 +77,25 @@ public:
   */
   int ExecuteCommands();
 
-  /*! Start thread for processing the commands in the queue. Must be called from the main thread. */
+  /*! Start threads for processing the commands in the queue. Must be called from the main thread. */
   virtual PlusStatus Start();
 
-  /*! Stop command processing. Must be called from the main thread. */
+  /*! Stop command processing. Commands that are still in the queue are not executed. Must be called from the main thread. */
   virtual PlusStatus Stop();
 
-  /*! Returns true if the command processing thread is running. Can be called from any thread. */
+  /*! Returns true if the command processing threads are running. Can be called from any thread. */
   virtual bool IsRunning();
 
+  /*! Number of threads that Start() creates for executing commands. Takes effect when the processing is started. */
+  vtkSetMacro(NumberOfCommandExecutionThreads, int);
+  vtkGetMacro(NumberOfCommandExecutionThreads, int);
+
+  /*! Get the round-trip time statistics of the executed commands, by command name. Can be called from any thread. */
+  void GetCommandExecutionStatistics(std::map<std::string, CommandExecutionStatistics>& statistics);
+
+  /*! Clear the round-trip time statistics. Can be called from any thread. */
+  void ResetCommandExecutionStatistics();
+
   /*!
     Register custom command. Must be called from the main thread.
     \param cmd It should point to a valid vtkPlusCommand instance. The caller can delete the cmd object after the call.
@@ -94,41 +140,74 @@ public:
 protected:
   vtkPlusCommand* CreatePlusCommand(const std::string& commandName, const std::string& commandStr, const igtl::MessageBase::MetaDataMap& metaData);
 
-  /*! Thread for client connection handling */
+  /*! Thread that waits for queued commands and executes them */
   static void* CommandExecutionThread(vtkMultiThreader::ThreadInfo* data);
 
   vtkPlusCommandProcessor();
   virtual ~vtkPlusCommandProcessor();
 
 private:
+  struct QueuedCommand
+  {
+    QueuedCommand()
+      : QueueTime(0.0)
+      , ExecutionMode(vtkPlusCommand::EXECUTION_MODE_EXCLUSIVE)
+    {
+    }
+    vtkSmartPointer<vtkPlusCommand> Command;
+    /*! System time when the command was added to the queue */
+    double QueueTime;
+    /*! Scheduling properties of the command, stored when the command is started */
+    vtkPlusCommand::ExecutionModeType ExecutionMode;
+    std::string ExecutionDeviceId;
+  };
+
+  /*! Add a command to the queue and wake up an execution thread */
+  void PushCommand(vtkPlusCommand* cmd);
+
+  /*!
+    Remove the first command from the queue that can be started without conflicting with the running commands.
+    Returns false if there is no such command. Must be called with CommandQueueMutex locked.
+  */
+  bool PopRunnableCommand(QueuedCommand& queuedCommand);
+
+  /*! Execute a command returned by PopRunnableCommand, collect its responses and update the statistics */
+  void ExecuteQueuedCommand(QueuedCommand& queuedCommand);
+
   /*! Link to the server that owns this command processor */
   vtkPlusOpenIGTLinkServer* PlusServer;
 
   /*! vtkMultiThreader instance for controlling threads */
   vtkSmartPointer<vtkMultiThreader> Threader;
 
-  /*! Mutex instance for safe data access */
+  /*! Mutex instance for safe access to the response queue */
   vtkSmartPointer<vtkIGSIORecursiveCriticalSection> Mutex;
 
-  // Active flag for threads (first: request, second: respond )
-  std::pair<bool, bool> CommandExecutionActive;
+  int NumberOfCommandExecutionThreads;
 
-  // Thread identifier
-  int CommandExecutionThreadId;
+  /*! Identifiers of the running command execution threads */
+  std::vector<int> CommandExecutionThreadIds;
 
   /*! Map command names and the New() static methods of vtkPlusCommand classes */
   std::map<std::string, vtkPlusCommand*> RegisteredCommands;
 
-  /*!
-    This queue contains all the active commands.
-    After a command's execute method is called it may still remain active (remain in the queue),
-    until it signals that it is completed.
-  */
-  //std::list<vtkPlusCommand*> CommandQueue;
-  typedef std::list< vtkSmartPointer<vtkPlusCommand> > PlusCommandList;
-  PlusCommandList CommandQueue;
+  /*! Protects the command queue, the scheduling state and the statistics */
+  std::mutex CommandQueueMutex;
+  /*! Notified when a command is queued or completed, or when the processing is stopped */
+  std::condition_variable CommandQueueChanged;
+
+  /*! Commands waiting for execution, in the order they were received */
+  std::list<QueuedCommand> CommandQueue;
   PlusCommandResponseList CommandResponseQueue;
 
+  bool CommandExecutionStopRequested;
+  int NumberOfRunningCommands;
+  bool ExclusiveCommandRunning;
+  /*! Devices that a running command operates on */
+  std::set<std::string> BusyDevices;
+
+  std::map<std::string, CommandExecutionStatistics> CommandStatistics;
+
   vtkPlusCommandProcessor(const vtkPlusCommandProcessor&);  // Not implemented.
   void operator=(const vtkPlusCommandProcessor&);  // Not implemented.
 };
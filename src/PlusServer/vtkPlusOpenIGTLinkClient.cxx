@@ -17,6 +17,9 @@ See License.txt for details.
 #include "vtkIGSIORecursiveCriticalSection.h"
 #include "vtkXMLUtilities.h"
 
+// STL includes
+#include <vector>
+
 const float vtkPlusOpenIGTLinkClient::CLIENT_SOCKET_TIMEOUT_SEC = 0.5;
 
 vtkStandardNewMacro(vtkPlusOpenIGTLinkClient);
@@ -30,6 +33,7 @@ vtkPlusOpenIGTLinkClient::vtkPlusOpenIGTLinkClient()
   , Threader(vtkSmartPointer<vtkMultiThreader>::New())
   , Mutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
   , SocketMutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
+  , SendMutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
   , ClientSocket(igtl::ClientSocket::New())
   , LastGeneratedCommandId(0)
   , ServerPort(-1)
@@ -83,6 +87,7 @@ PlusStatus vtkPlusOpenIGTLinkClient::Connect(double timeoutSec/*=-1*/)
 PlusStatus vtkPlusOpenIGTLinkClient::Disconnect()
 {
   {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> sendGuard(this->SendMutex);
     igsioLockGuard<vtkIGSIORecursiveCriticalSection> socketGuard(this->SocketMutex);
     this->ClientSocket->CloseSocket();
   }
@@ -99,21 +104,26 @@ PlusStatus vtkPlusOpenIGTLinkClient::Disconnect()
     this->DataReceiverThreadId = -1;
   }
 
+  // Replies of the commands in flight will not be received anymore
+  std::vector<igtlUint32> pendingCommandUids;
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
+    for (std::map<igtlUint32, std::promise<CommandReply> >::iterator it = this->PendingCommands.begin(); it != this->PendingCommands.end(); ++it)
+    {
+      pendingCommandUids.push_back(it->first);
+    }
+  }
+  for (std::vector<igtlUint32>::iterator uidIt = pendingCommandUids.begin(); uidIt != pendingCommandUids.end(); ++uidIt)
+  {
+    this->FailPendingCommand(*uidIt, "Disconnected from server before the reply was received.");
+  }
+
   return PLUS_SUCCESS;
 }
 
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusOpenIGTLinkClient::SendCommand(vtkPlusCommand* command)
 {
-  // Get the XML string
-  vtkSmartPointer<vtkXMLDataElement> cmdConfig = vtkSmartPointer<vtkXMLDataElement>::New();
-  command->WriteConfiguration(cmdConfig);
-  std::ostringstream xmlStr;
-  vtkXMLUtilities::FlattenElement(cmdConfig, xmlStr);
-  xmlStr << std::ends;
-
-  std::ostringstream commandUidStringStream;
-
   // Ensure commandUid is populated
   igtlUint32 commandUid;
   if (command->GetId())
@@ -130,11 +140,75 @@ PlusStatus vtkPlusOpenIGTLinkClient::SendCommand(vtkPlusCommand* command)
     else
     {
       // command UID is not specified, generate one automatically
+      igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
       commandUid = LastGeneratedCommandId;
       LastGeneratedCommandId++;
     }
   }
 
+  return this->SendCommandMessage(command, commandUid);
+}
+
+//----------------------------------------------------------------------------
+std::future<vtkPlusOpenIGTLinkClient::CommandReply> vtkPlusOpenIGTLinkClient::SendCommandAsync(vtkPlusCommand* command)
+{
+  std::future<CommandReply> replyFuture;
+  igtlUint32 commandUid(0);
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
+    if (command->GetId())
+    {
+      commandUid = command->GetId();
+    }
+    else
+    {
+      // Timestamps are not unique enough for commands in flight, so the UID is always generated from the counter
+      commandUid = LastGeneratedCommandId;
+      LastGeneratedCommandId++;
+    }
+
+    if (this->PendingCommands.find(commandUid) != this->PendingCommands.end())
+    {
+      LOG_ERROR("Cannot send command: a command with UID " << commandUid << " is already waiting for its reply");
+      std::promise<CommandReply> failedReply;
+      CommandReply reply;
+      reply.OriginalCommandId = commandUid;
+      reply.ErrorString = "Duplicate command UID.";
+      failedReply.set_value(reply);
+      return failedReply.get_future();
+    }
+
+    // The reply may arrive before SendCommandMessage returns, so the command is registered first
+    replyFuture = this->PendingCommands[commandUid].get_future();
+  }
+
+  if (this->SendCommandMessage(command, commandUid) != PLUS_SUCCESS)
+  {
+    this->FailPendingCommand(commandUid, "Failed to send command.");
+  }
+
+  return replyFuture;
+}
+
+//----------------------------------------------------------------------------
+int vtkPlusOpenIGTLinkClient::GetNumberOfPendingCommands()
+{
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
+  return static_cast<int>(this->PendingCommands.size());
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkClient::SendCommandMessage(vtkPlusCommand* command, igtlUint32 commandUid)
+{
+  // Get the XML string
+  vtkSmartPointer<vtkXMLDataElement> cmdConfig = vtkSmartPointer<vtkXMLDataElement>::New();
+  command->WriteConfiguration(cmdConfig);
+  std::ostringstream xmlStr;
+  vtkXMLUtilities::FlattenElement(cmdConfig, xmlStr);
+  xmlStr << std::ends;
+
+  std::ostringstream commandUidStringStream;
+
   // Generate the device name
   std::ostringstream deviceNameSs;
   if (igtl::IGTLProtocolToHeaderLookup(this->GetServerIGTLVersion()) >= IGTL_HEADER_VERSION_2)
@@ -175,7 +249,7 @@ PlusStatus vtkPlusOpenIGTLinkClient::SendCommand(vtkPlusCommand* command)
   LOG_DEBUG("Sending message: " << xmlStr.str());
   int success = 0;
   {
-    igsioLockGuard<vtkIGSIORecursiveCriticalSection> socketGuard(this->SocketMutex);
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> sendGuard(this->SendMutex);
     success = this->ClientSocket->Send(message->GetBufferPointer(), message->GetBufferSize());
   }
   if (!success)
@@ -191,7 +265,7 @@ PlusStatus vtkPlusOpenIGTLinkClient::SendMessage(igtl::MessageBase::Pointer pack
 {
   int success = 0;
   {
-    igsioLockGuard<vtkIGSIORecursiveCriticalSection> socketGuard(this->SocketMutex);
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> sendGuard(this->SendMutex);
     success = this->ClientSocket->Send(packedMessage->GetBufferPointer(), packedMessage->GetBufferSize());
   }
   if (!success)
@@ -216,78 +290,27 @@ PlusStatus vtkPlusOpenIGTLinkClient::ReceiveReply(PlusStatus& result, int32_t& o
       if (!this->Replies.empty())
       {
         igtl::MessageBase::Pointer message = this->Replies.front();
-        if (typeid(*message) == typeid(igtl::StringMessage))
-        {
-          // Process the command as v1/v2 string reply
-          igtl::StringMessage::Pointer strMsg = dynamic_cast<igtl::StringMessage*>(message.GetPointer());
-
-          if (vtkPlusCommand::IsReplyDeviceName(strMsg->GetDeviceName()))
-          {
-            if (igsioCommon::StringToInt<int32_t>(vtkPlusCommand::GetUidFromCommandDeviceName(strMsg->GetDeviceName()).c_str(), outOriginalCommandId) != PLUS_SUCCESS)
-            {
-              LOG_ERROR("Failed to get UID from command device name.");
-              continue;
-            }
-          }
-          vtkSmartPointer<vtkXMLDataElement> cmdElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(strMsg->GetString()));
-          if (cmdElement == NULL)
-          {
-            LOG_ERROR("Unable to parse command reply as XML. Skipping.");
-            continue;
-          }
-          if (cmdElement->GetAttribute("Status") == NULL)
-          {
-            LOG_ERROR("No status returned. Skipping.");
-            continue;
-          }
-          result = std::string(cmdElement->GetAttribute("Status")) == "SUCCESS" ? PLUS_SUCCESS : PLUS_FAIL;
-          if (cmdElement->GetAttribute("Message") == NULL)
-          {
-            LOG_ERROR("No message returned. Skipping.");
-            continue;
-          }
-          outContent = cmdElement->GetAttribute("Message");
-        }
-        else if (typeid(*message) == typeid(igtl::RTSCommandMessage))
-        {
-          // Process the command as v3 RTS_Command
-          igtl::RTSCommandMessage::Pointer rtsCommandMsg = dynamic_cast<igtl::RTSCommandMessage*>(message.GetPointer());
-
-          vtkSmartPointer<vtkXMLDataElement> cmdElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(rtsCommandMsg->GetCommandContent().c_str()));
-
-          outCommandName = rtsCommandMsg->GetCommandName();
-          outOriginalCommandId = rtsCommandMsg->GetCommandId();
-
-          XML_FIND_NESTED_ELEMENT_OPTIONAL(resultElement, cmdElement, "Result");
-          if (resultElement != NULL)
-          {
-            result = STRCASECMP(resultElement->GetCharacterData(), "true") == 0 ? PLUS_SUCCESS : PLUS_FAIL;
-          }
-          XML_FIND_NESTED_ELEMENT_OPTIONAL(errorElement, cmdElement, "Error");
-          if (!result && errorElement == NULL)
-          {
-            LOG_ERROR("Server sent error without reason. Notify server developers.");
-          }
-          else if (!result && errorElement != NULL)
-          {
-            outErrorString = errorElement->GetCharacterData();
-          }
-          XML_FIND_NESTED_ELEMENT_REQUIRED(messageElement, cmdElement, "Message");
-          outContent = messageElement->GetCharacterData();
-
-          outParameters = rtsCommandMsg->GetMetaData();
-        }
-        else if (typeid(*message) == typeid(igtl::RTSTrackingDataMessage))
-        {
-          igtl::RTSTrackingDataMessage* rtsTrackingMsg = dynamic_cast<igtl::RTSTrackingDataMessage*>(message.GetPointer());
+        this->Replies.pop_front();
 
-          result = rtsTrackingMsg->GetStatus() == 0 ? PLUS_SUCCESS : PLUS_FAIL;
-          outContent = (rtsTrackingMsg->GetStatus() == 0 ? "SUCCESS" : "FAILURE");
-          outCommandName = "RTSTrackingDataMessage";
-          outOriginalCommandId = -1;
+        CommandReply reply;
+        reply.Status = result;
+        reply.OriginalCommandId = outOriginalCommandId;
+        reply.ErrorString = outErrorString;
+        reply.Content = outContent;
+        reply.Parameters = outParameters;
+        reply.CommandName = outCommandName;
+        if (ParseReply(message.GetPointer(), reply) != PLUS_SUCCESS)
+        {
+          // invalid reply, skip it
+          continue;
         }
 
-        this->Replies.pop_front();
+        result = reply.Status;
+        outOriginalCommandId = reply.OriginalCommandId;
+        outErrorString = reply.ErrorString;
+        outContent = reply.Content;
+        outParameters = reply.Parameters;
+        outCommandName = reply.CommandName;
         return PLUS_SUCCESS;
       }
     }
@@ -301,6 +324,156 @@ PlusStatus vtkPlusOpenIGTLinkClient::ReceiveReply(PlusStatus& result, int32_t& o
   return PLUS_FAIL;
 }
 
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkClient::ParseReply(igtl::MessageBase* message, CommandReply& reply)
+{
+  if (typeid(*message) == typeid(igtl::StringMessage))
+  {
+    // Process the command as v1/v2 string reply
+    igtl::StringMessage* strMsg = dynamic_cast<igtl::StringMessage*>(message);
+
+    if (vtkPlusCommand::IsReplyDeviceName(strMsg->GetDeviceName()))
+    {
+      if (igsioCommon::StringToInt<int32_t>(vtkPlusCommand::GetUidFromCommandDeviceName(strMsg->GetDeviceName()).c_str(), reply.OriginalCommandId) != PLUS_SUCCESS)
+      {
+        LOG_ERROR("Failed to get UID from command device name.");
+        return PLUS_FAIL;
+      }
+    }
+    vtkSmartPointer<vtkXMLDataElement> cmdElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(strMsg->GetString()));
+    if (cmdElement == NULL)
+    {
+      LOG_ERROR("Unable to parse command reply as XML. Skipping.");
+      return PLUS_FAIL;
+    }
+    if (cmdElement->GetAttribute("Status") == NULL)
+    {
+      LOG_ERROR("No status returned. Skipping.");
+      return PLUS_FAIL;
+    }
+    reply.Status = std::string(cmdElement->GetAttribute("Status")) == "SUCCESS" ? PLUS_SUCCESS : PLUS_FAIL;
+    if (cmdElement->GetAttribute("Message") == NULL)
+    {
+      LOG_ERROR("No message returned. Skipping.");
+      return PLUS_FAIL;
+    }
+    reply.Content = cmdElement->GetAttribute("Message");
+  }
+  else if (typeid(*message) == typeid(igtl::RTSCommandMessage))
+  {
+    // Process the command as v3 RTS_Command
+    igtl::RTSCommandMessage* rtsCommandMsg = dynamic_cast<igtl::RTSCommandMessage*>(message);
+
+    vtkSmartPointer<vtkXMLDataElement> cmdElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(rtsCommandMsg->GetCommandContent().c_str()));
+    if (cmdElement == NULL)
+    {
+      LOG_ERROR("Unable to parse command reply as XML. Skipping.");
+      return PLUS_FAIL;
+    }
+
+    reply.CommandName = rtsCommandMsg->GetCommandName();
+    reply.OriginalCommandId = rtsCommandMsg->GetCommandId();
+
+    XML_FIND_NESTED_ELEMENT_OPTIONAL(resultElement, cmdElement, "Result");
+    if (resultElement != NULL)
+    {
+      reply.Status = STRCASECMP(resultElement->GetCharacterData(), "true") == 0 ? PLUS_SUCCESS : PLUS_FAIL;
+    }
+    XML_FIND_NESTED_ELEMENT_OPTIONAL(errorElement, cmdElement, "Error");
+    if (!reply.Status && errorElement == NULL)
+    {
+      LOG_ERROR("Server sent error without reason. Notify server developers.");
+    }
+    else if (!reply.Status && errorElement != NULL)
+    {
+      reply.ErrorString = errorElement->GetCharacterData();
+    }
+    XML_FIND_NESTED_ELEMENT_REQUIRED(messageElement, cmdElement, "Message");
+    reply.Content = messageElement->GetCharacterData();
+
+    reply.Parameters = rtsCommandMsg->GetMetaData();
+  }
+  else if (typeid(*message) == typeid(igtl::RTSTrackingDataMessage))
+  {
+    igtl::RTSTrackingDataMessage* rtsTrackingMsg = dynamic_cast<igtl::RTSTrackingDataMessage*>(message);
+
+    reply.Status = rtsTrackingMsg->GetStatus() == 0 ? PLUS_SUCCESS : PLUS_FAIL;
+    reply.Content = (rtsTrackingMsg->GetStatus() == 0 ? "SUCCESS" : "FAILURE");
+    reply.CommandName = "RTSTrackingDataMessage";
+    reply.OriginalCommandId = -1;
+  }
+
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusOpenIGTLinkClient::DispatchReply(igtl::MessageBase::Pointer message)
+{
+  igtlUint32 commandUid(0);
+  if (typeid(*message) == typeid(igtl::RTSCommandMessage))
+  {
+    commandUid = dynamic_cast<igtl::RTSCommandMessage*>(message.GetPointer())->GetCommandId();
+  }
+  else if (typeid(*message) == typeid(igtl::StringMessage))
+  {
+    int32_t uid(0);
+    if (igsioCommon::StringToInt<int32_t>(vtkPlusCommand::GetUidFromCommandDeviceName(message->GetDeviceName()).c_str(), uid) != PLUS_SUCCESS)
+    {
+      return false;
+    }
+    commandUid = static_cast<igtlUint32>(uid);
+  }
+  else
+  {
+    return false;
+  }
+
+  std::promise<CommandReply> replyPromise;
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
+    std::map<igtlUint32, std::promise<CommandReply> >::iterator pendingIt = this->PendingCommands.find(commandUid);
+    if (pendingIt == this->PendingCommands.end())
+    {
+      // reply to a command sent by SendCommand
+      return false;
+    }
+    replyPromise = std::move(pendingIt->second);
+    this->PendingCommands.erase(pendingIt);
+  }
+
+  CommandReply reply;
+  reply.OriginalCommandId = commandUid;
+  if (ParseReply(message.GetPointer(), reply) != PLUS_SUCCESS)
+  {
+    reply.Status = PLUS_FAIL;
+    reply.ErrorString = "Invalid reply received.";
+  }
+  replyPromise.set_value(reply);
+  return true;
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkClient::FailPendingCommand(igtlUint32 commandUid, const std::string& errorString)
+{
+  std::promise<CommandReply> replyPromise;
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(this->Mutex);
+    std::map<igtlUint32, std::promise<CommandReply> >::iterator pendingIt = this->PendingCommands.find(commandUid);
+    if (pendingIt == this->PendingCommands.end())
+    {
+      // already completed
+      return;
+    }
+    replyPromise = std::move(pendingIt->second);
+    this->PendingCommands.erase(pendingIt);
+  }
+
+  CommandReply reply;
+  reply.OriginalCommandId = commandUid;
+  reply.ErrorString = errorString;
+  replyPromise.set_value(reply);
+}
+
 //----------------------------------------------------------------------------
 void vtkPlusOpenIGTLinkClient::PrintSelf(ostream& os, vtkIndent indent)
 {
@@ -371,6 +544,7 @@ void* vtkPlusOpenIGTLinkClient::DataReceiverThread(vtkMultiThreader::ThreadInfo*
         LOG_ERROR("Failed to receive reply (invalid body)");
         continue;
       }
+      if (!self->DispatchReply(bodyMsg))
       {
         // save command reply
         igsioLockGuard<vtkIGSIORecursiveCriticalSection> updateMutexGuardedLock(self->Mutex);
@@ -24,6 +24,8 @@
 
 // STL includes
 #include <deque>
+#include <future>
+#include <map>
 #include <string>
 
 class vtkMultiThreader;
@@ -35,11 +37,30 @@ class vtkIGSIORecursiveCriticalSection;
 
   It connects to a Plus server, sends requests and receives responses.
 
+  SendCommand() and ReceiveReply() process one command at a time. SendCommandAsync() allows many commands to be
+  in flight: it returns a future that the data receiver thread completes when the reply with the command's UID arrives.
+
   \ingroup PlusLibPlusServer
 */
 class vtkPlusServerExport vtkPlusOpenIGTLinkClient : public vtkObject
 {
 public:
+  /*! Result of a command sent by SendCommandAsync() */
+  struct CommandReply
+  {
+    CommandReply()
+      : Status(PLUS_FAIL)
+      , OriginalCommandId(-1)
+    {
+    }
+    PlusStatus Status;
+    int32_t OriginalCommandId;
+    std::string ErrorString;
+    std::string Content;
+    igtl::MessageBase::MetaDataMap Parameters;
+    std::string CommandName;
+  };
+
   static vtkPlusOpenIGTLinkClient* New();
   vtkTypeMacro(vtkPlusOpenIGTLinkClient, vtkObject);
   virtual void PrintSelf(ostream& os, vtkIndent indent);
@@ -62,6 +83,17 @@ public:
   /*! Send a command to the connected server */
   PlusStatus SendCommand(vtkPlusCommand* command);
 
+  /*!
+    Send a command to the connected server without waiting for the replies of previously sent commands.
+    A UID is generated if the command does not have one. The returned future is completed when the reply is received,
+    or with PLUS_FAIL status if the command cannot be sent or the client is disconnected.
+    Replies to these commands are not returned by ReceiveReply(). Can be called from any thread.
+  */
+  std::future<CommandReply> SendCommandAsync(vtkPlusCommand* command);
+
+  /*! Number of commands sent by SendCommandAsync() that are waiting for their reply */
+  int GetNumberOfPendingCommands();
+
   /*! Send a packed message to the connected server */
   PlusStatus SendMessage(igtl::MessageBase::Pointer packedMessage);
 
@@ -100,6 +132,18 @@ protected:
   /*! Thread for receiving control data from clients */
   static void* DataReceiverThread(vtkMultiThreader::ThreadInfo* data);
 
+  /*! Pack the command into a STRING or COMMAND message, depending on the server version, and send it */
+  PlusStatus SendCommandMessage(vtkPlusCommand* command, igtlUint32 commandUid);
+
+  /*! Extract the command result from a received reply message. Fields that are not in the message are left unchanged. */
+  PlusStatus ParseReply(igtl::MessageBase* message, CommandReply& reply);
+
+  /*! Complete the future of the asynchronous command that the reply belongs to. Returns false if no such command is pending. */
+  bool DispatchReply(igtl::MessageBase::Pointer message);
+
+  /*! Complete the future of a pending asynchronous command with a failure */
+  void FailPendingCommand(igtlUint32 commandUid, const std::string& errorString);
+
 protected:
   /*! igtl Factory for message sending */
   vtkSmartPointer<vtkPlusIgtlMessageFactory>        IgtlMessageFactory;
@@ -114,6 +158,8 @@ protected:
   /*! Mutex instance for safe data access */
   vtkSmartPointer<vtkIGSIORecursiveCriticalSection>  Mutex;
   vtkSmartPointer<vtkIGSIORecursiveCriticalSection>  SocketMutex;
+  /*! Sending is protected separately, so that it does not wait for a receive in the data receiver thread */
+  vtkSmartPointer<vtkIGSIORecursiveCriticalSection>  SendMutex;
 
   igtl::ClientSocket::Pointer                       ClientSocket;
 
@@ -121,6 +167,9 @@ protected:
 
   std::deque<igtl::MessageBase::Pointer>            Replies;
 
+  /*! Commands sent by SendCommandAsync() waiting for their reply, by command UID */
+  std::map<igtlUint32, std::promise<CommandReply> > PendingCommands;
+
   int                                               ServerPort;
   std::string                                       ServerHost;
 
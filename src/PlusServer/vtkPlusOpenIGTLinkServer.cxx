@@ -7,6 +7,9 @@ See License.txt for details.
 // Local includes
 #include "PlusConfigure.h"
 #include "PlusCommon.h"
+#include "PlusIgtlSharedMemoryRing.h"
+#include "PlusIgtlUdpSender.h"
+#include "PlusIgtlVideoRateController.h"
 #include "PlusConfigure.h"
 #include "igsioTrackedFrame.h"
 #include "vtkPlusChannel.h"
@@ -19,6 +22,9 @@ See License.txt for details.
 #include "vtkIGSIORecursiveCriticalSection.h"
 #include "vtkIGSIOTrackedFrameList.h"
 #include "vtkIGSIOTransformRepository.h"
+#if defined(__linux__)
+  #include "PlusIgtlEpollReactor.h"
+#endif
 
 // VTK includes
 #include <vtkImageData.h>
@@ -33,6 +39,9 @@ See License.txt for details.
 #include <igtlImageMetaMessage.h>
 #include <igtlMessageHeader.h>
 #include <igtlPlusClientInfoMessage.h>
+#include <igtlPlusCompressedImageMessage.h>
+#include <igtlPlusSharedMemoryNotificationMessage.h>
+#include <igtlPlusTrackedFrameMessage.h>
 #include <igtlPointMessage.h>
 #include <igtlPolyDataMessage.h>
 #include <igtlStatusMessage.h>
@@ -51,7 +60,11 @@ See License.txt for details.
 #endif
 
 // STL includes
+#include <algorithm>
+#include <chrono>
 #include <fstream>
+#include <map>
+#include <sstream>
 #include <streambuf>
 
 namespace
@@ -68,6 +81,150 @@ namespace
   // then we skip a SAMPLING_SKIPPING_MARGIN_SEC long period to allow the application to catch up.
   // This time should be long enough to comfortably retrieve a frame from the buffer.
   const double SAMPLING_SKIPPING_MARGIN_SEC = 0.1;
+
+  //----------------------------------------------------------------------------
+  // Client id used for packing the messages of the UDP stream, ids of TCP clients start from 1
+  const int UDP_STREAM_CLIENT_ID = 0;
+  const int DEFAULT_UDP_STREAM_MAX_DATAGRAM_SIZE = 1472;
+
+  //----------------------------------------------------------------------------
+  // The shared memory transport is only offered to clients that connect through the loopback interface
+  bool IsLoopbackAddress(const std::string& address)
+  {
+    return address.compare(0, 4, "127.") == 0 || address == "::1" || address == "localhost";
+  }
+
+  //----------------------------------------------------------------------------
+  // Returns a string that is identical for two clients if and only if PackMessages
+  // would produce the same messages for them. Clients with the same key share the
+  // packed messages of a frame, so each unique stream is packed (and encoded) once.
+  // If encoderOwnerClientId is set then the client gets a different subset of the frames than
+  // other clients with the same subscription (decimated video or frame rate limit), so it must not
+  // share their encoder and published transform state.
+  std::string GetClientSubscriptionKey(const PlusIgtlClientInfo& clientInfo, int encoderOwnerClientId = -1)
+  {
+    std::ostringstream key;
+    key << "v" << clientInfo.GetClientHeaderVersion() << "|types:";
+    for (std::vector<std::string>::const_iterator it = clientInfo.IgtlMessageTypes.begin(); it != clientInfo.IgtlMessageTypes.end(); ++it)
+    {
+      key << *it << ";";
+    }
+    key << "|transforms:";
+    for (std::vector<igsioTransformName>::const_iterator it = clientInfo.TransformNames.begin(); it != clientInfo.TransformNames.end(); ++it)
+    {
+      key << it->GetTransformName() << ";";
+    }
+    key << "|strings:";
+    for (std::vector<std::string>::const_iterator it = clientInfo.StringNames.begin(); it != clientInfo.StringNames.end(); ++it)
+    {
+      key << *it << ";";
+    }
+    key << "|images:";
+    for (std::vector<PlusIgtlClientInfo::ImageStream>::const_iterator it = clientInfo.ImageStreams.begin(); it != clientInfo.ImageStreams.end(); ++it)
+    {
+      key << it->Name << "To" << it->EmbeddedTransformToFrame;
+      if (it->IsImageProcessingRequested())
+      {
+        key << "," << it->ClipRectangleOrigin[0] << "," << it->ClipRectangleOrigin[1] << "," << it->ClipRectangleSize[0] << "," << it->ClipRectangleSize[1]
+            << "," << it->DownsamplingFactor << "," << it->ScalarType;
+      }
+      if (it->IsCompressionRequested())
+      {
+        // Clients that join a predicted stream can decode it from the next key frame
+        key << "," << it->Compression << "," << it->CompressionPredictor << "," << it->CompressionKeyFrameInterval;
+      }
+      key << ";";
+    }
+    key << "|videos:";
+    for (std::vector<PlusIgtlClientInfo::VideoStream>::const_iterator it = clientInfo.VideoStreams.begin(); it != clientInfo.VideoStreams.end(); ++it)
+    {
+      const PlusIgtlClientInfo::EncodingParameters& params = it->EncodeVideoParameters;
+      key << it->Name << "To" << it->EmbeddedTransformToFrame
+          << "," << params.FourCC << "," << params.Lossless << "," << params.MinKeyframeDistance << "," << params.MaxKeyframeDistance
+          << "," << params.Speed << "," << params.RateControl << "," << params.DeadlineMode << "," << params.TargetBitrate << ";";
+    }
+    // TDATA is only packed when the client requested it and its resolution period has elapsed
+    key << "|tdata:" << clientInfo.GetTDATARequested() << "," << clientInfo.GetTDATAResolution() << "," << std::fixed << clientInfo.GetLastTDATASentTimeStamp();
+    if (clientInfo.GetSendChangedTransformsOnly())
+    {
+      // Unchanged transforms are suppressed based on what the packing client of the group was sent. All transforms are
+      // sent again when a client of the group was sent the messages of another packing client before, the refresh
+      // interval ensures that clients joining the group later still receive all transforms
+      key << "|changed:" << clientInfo.GetTransformChangeThresholdMm() << "," << clientInfo.GetTransformChangeThresholdDeg() << "," << clientInfo.GetTransformRefreshIntervalSec();
+    }
+    key << "|fields:" << std::min<int>(clientInfo.GetTrackedFrameFieldsVersion(), igtl::PlusTrackedFrameMessage::FIELDS_VERSION_LATEST);
+    if (encoderOwnerClientId >= 0)
+    {
+      key << "|encoder:" << encoderOwnerClientId;
+    }
+    return key.str();
+  }
+
+  //----------------------------------------------------------------------------
+  bool IsVideoRequested(const PlusIgtlClientInfo& clientInfo)
+  {
+    return !clientInfo.VideoStreams.empty()
+           && std::find(clientInfo.IgtlMessageTypes.begin(), clientInfo.IgtlMessageTypes.end(), std::string("VIDEO")) != clientInfo.IgtlMessageTypes.end();
+  }
+
+  //----------------------------------------------------------------------------
+  // Returns true if the client does not receive all frames and the messages packed for it depend on the
+  // previously packed frames (video, predicted compressed images, changed transforms only)
+  bool IsFrameDependentRateLimited(const PlusIgtlClientInfo& clientInfo)
+  {
+    if (!clientInfo.IsFrameRateLimited())
+    {
+      return false;
+    }
+    if (IsVideoRequested(clientInfo) || clientInfo.GetSendChangedTransformsOnly())
+    {
+      return true;
+    }
+    if (std::find(clientInfo.IgtlMessageTypes.begin(), clientInfo.IgtlMessageTypes.end(), std::string("IMAGE")) == clientInfo.IgtlMessageTypes.end())
+    {
+      return false;
+    }
+    for (std::vector<PlusIgtlClientInfo::ImageStream>::const_iterator it = clientInfo.ImageStreams.begin(); it != clientInfo.ImageStreams.end(); ++it)
+    {
+      int predictor = igtl::PlusCompressedImageMessage::PREDICTOR_NONE;
+      if (it->IsCompressionRequested()
+          && vtkPlusIgtlImageCompressor::GetPredictorFromString(it->CompressionPredictor, predictor)
+          && predictor != igtl::PlusCompressedImageMessage::PREDICTOR_NONE)
+      {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  //----------------------------------------------------------------------------
+  bool GetSendQueueDropPolicyFromString(const std::string& policyName, ClientSendQueue::DropPolicyType& policy)
+  {
+    if (policyName == "DROP_OLDEST")
+    {
+      policy = ClientSendQueue::DROP_OLDEST;
+    }
+    else if (policyName == "DROP_NEWEST")
+    {
+      policy = ClientSendQueue::DROP_NEWEST;
+    }
+    else if (policyName == "DISCONNECT")
+    {
+      policy = ClientSendQueue::DISCONNECT;
+    }
+    else
+    {
+      return false;
+    }
+    return true;
+  }
+
+  //----------------------------------------------------------------------------
+  // Time the client sender threads wait for new items before checking if they have to stop
+  const int CLIENT_SEND_QUEUE_WAIT_TIMEOUT_MSEC = 100;
+
+  // Send queue length used by the epoll network core if ClientSendQueueLength is not specified
+  const int DEFAULT_EPOLL_CLIENT_SEND_QUEUE_LENGTH = 10;
 }
 
 //----------------------------------------------------------------------------
@@ -92,16 +249,30 @@ vtkPlusOpenIGTLinkServer::vtkPlusOpenIGTLinkServer()
   , DataSenderThreadId(-1)
   , IgtlMessageFactory(vtkSmartPointer<vtkPlusIgtlMessageFactory>::New())
   , IgtlClientsMutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
-  , LastSentTrackedFrameTimestamp(0)
   , MaxTimeSpentWithProcessingMs(50)
-  , LastProcessingTimePerFrameMs(-1)
+  , SendIntervalSec(0.0)
   , SendValidTransformsOnly(true)
   , DefaultClientSendTimeoutSec(CLIENT_SOCKET_TIMEOUT_SEC)
   , DefaultClientReceiveTimeoutSec(CLIENT_SOCKET_TIMEOUT_SEC)
+  , ClientSendQueueLength(0)
+  , ClientSendQueueDropPolicy(ClientSendQueue::DROP_OLDEST)
+  , NetworkBackend(NETWORK_BACKEND_THREADS)
+  , EpollReactor(NULL)
+  , ScatterGatherImageMessages(false)
+  , AdaptiveVideoRate(false)
+  , AdaptiveVideoMaxSendLagSec(0.25)
+  , AdaptiveVideoMaxFrameDecimation(8)
+  , AdaptiveVideoMinBitrate(64000)
+  , SharedMemoryTransport(false)
+  , SharedMemoryNumberOfSlots(8)
+  , SharedMemorySlotSizeBytes(8 * 1024 * 1024)
+  , UdpStreamPort(-1)
+  , UdpStreamTimeToLive(1)
+  , UdpStreamMaxDatagramSize(DEFAULT_UDP_STREAM_MAX_DATAGRAM_SIZE)
+  , NumberOfCommandExecutionThreads(0)
   , IgtlMessageCrcCheckEnabled(0)
   , PlusCommandProcessor(vtkSmartPointer<vtkPlusCommandProcessor>::New())
   , MessageResponseQueueMutex(vtkSmartPointer<vtkIGSIORecursiveCriticalSection>::New())
-  , BroadcastChannel(NULL)
   , LogWarningOnNoDataAvailable(true)
   , KeepAliveIntervalSec(CLIENT_SOCKET_TIMEOUT_SEC / 2.0)
   , GracePeriodLogLevel(vtkPlusLogger::LOG_LEVEL_DEBUG)
@@ -115,6 +286,10 @@ vtkPlusOpenIGTLinkServer::vtkPlusOpenIGTLinkServer()
 vtkPlusOpenIGTLinkServer::~vtkPlusOpenIGTLinkServer()
 {
   this->Stop();
+#if defined(__linux__)
+  delete this->EpollReactor;
+  this->EpollReactor = NULL;
+#endif
   this->SetTransformRepository(NULL);
   this->SetDataCollector(NULL);
   this->SetConfigFilename(NULL);
@@ -152,6 +327,7 @@ PlusStatus vtkPlusOpenIGTLinkServer::QueueMessageResponseForClient(int clientId,
 void vtkPlusOpenIGTLinkServer::PrintSelf(ostream& os, vtkIndent indent)
 {
   this->Superclass::PrintSelf(os, indent);
+  this->SocketOptions.PrintSelf(os, indent);
 }
 
 //----------------------------------------------------------------------------
@@ -163,7 +339,30 @@ PlusStatus vtkPlusOpenIGTLinkServer::StartOpenIGTLinkService()
     return PLUS_FAIL;
   }
 
-  if (this->ConnectionReceiverThreadId < 0)
+  this->IgtlMessageFactory->SetScatterGatherImageMessages(this->ScatterGatherImageMessages);
+
+  bool useEpollReactor = false;
+#if defined(__linux__)
+  useEpollReactor = (this->NetworkBackend == NETWORK_BACKEND_EPOLL);
+  if (useEpollReactor && (this->EpollReactor == NULL || !this->EpollReactor->IsRunning()))
+  {
+    if (this->EpollReactor == NULL)
+    {
+      this->EpollReactor = new PlusIgtlEpollReactor(this);
+    }
+    if (this->EpollReactor->Start(this->ListeningPort) != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Unable to start the epoll network core.");
+      return PLUS_FAIL;
+    }
+    PrintServerInfo(this);
+    // Connections are accepted by the epoll event loop
+    this->ConnectionActive.Request = true;
+    this->ConnectionActive.Respond = true;
+  }
+#endif
+
+  if (!useEpollReactor && this->ConnectionReceiverThreadId < 0)
   {
     this->ConnectionActive.Request = true;
     this->ConnectionReceiverThreadId = this->Threader->SpawnThread((vtkThreadFunctionType)&ConnectionReceiverThread, this);
@@ -191,6 +390,15 @@ PlusStatus vtkPlusOpenIGTLinkServer::StartOpenIGTLinkService()
   LOG_DEBUG(ss.str());
 
   this->PlusCommandProcessor->SetPlusServer(this);
+  if (this->NumberOfCommandExecutionThreads > 0)
+  {
+    this->PlusCommandProcessor->SetNumberOfCommandExecutionThreads(this->NumberOfCommandExecutionThreads);
+    if (this->PlusCommandProcessor->Start() != PLUS_SUCCESS)
+    {
+      LOG_ERROR("Unable to start command execution threads.");
+      return PLUS_FAIL;
+    }
+  }
 
   this->BroadcastStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
 
@@ -200,6 +408,9 @@ PlusStatus vtkPlusOpenIGTLinkServer::StartOpenIGTLinkService()
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusOpenIGTLinkServer::StopOpenIGTLinkService()
 {
+  // Commands may access the clients, complete them first
+  this->PlusCommandProcessor->Stop();
+
   // Stop connection receiver thread
   if (this->ConnectionReceiverThreadId >= 0)
   {
@@ -213,6 +424,16 @@ PlusStatus vtkPlusOpenIGTLinkServer::StopOpenIGTLinkService()
     LOG_DEBUG("ConnectionReceiverThread stopped");
   }
 
+#if defined(__linux__)
+  if (this->EpollReactor != NULL && this->EpollReactor->IsRunning())
+  {
+    this->ConnectionActive.Request = false;
+    this->EpollReactor->Stop();
+    this->ConnectionActive.Respond = false;
+    LOG_DEBUG("Epoll network core stopped");
+  }
+#endif
+
   // Disconnect clients (stop receiving thread, close socket)
   std::vector< int > clientIds;
   {
@@ -266,7 +487,10 @@ void* vtkPlusOpenIGTLinkServer::ConnectionReceiverThread(vtkMultiThreader::Threa
       client->ClientSocket = newClientSocket;
       client->ClientSocket->SetReceiveTimeout(self->DefaultClientReceiveTimeoutSec * 1000);
       client->ClientSocket->SetSendTimeout(self->DefaultClientSendTimeoutSec * 1000);
+      self->SocketOptions.Apply(client->ClientSocket);
       client->ClientInfo = self->DefaultClientInfo;
+      client->ClientInfo.ResetFrameRateLimitState(); // each client has its own frame rate limit
+      client->ClientInfo.ResetStreamEncoders(); // encoder state must only be shared through the subscription key
       client->Server = self;
 
       int port = 0;
@@ -274,10 +498,21 @@ void* vtkPlusOpenIGTLinkServer::ConnectionReceiverThread(vtkMultiThreader::Threa
 #if (OPENIGTLINK_VERSION_MAJOR > 1) || ( OPENIGTLINK_VERSION_MAJOR == 1 && OPENIGTLINK_VERSION_MINOR > 9 ) || ( OPENIGTLINK_VERSION_MAJOR == 1 && OPENIGTLINK_VERSION_MINOR == 9 && OPENIGTLINK_VERSION_PATCH > 4 )
       newClientSocket->GetSocketAddressAndPort(address, port);
 #endif
+      client->ClientAddress = address;
       LOG_INFO("Received new client connection (client " << client->ClientId << " at " << address << ":" << port << "). Number of connected clients: " << self->GetNumberOfConnectedClients());
 
       client->DataReceiverActive.first = true;
       client->DataReceiverThreadId = self->Threader->SpawnThread((vtkThreadFunctionType)&DataReceiverThread, client);
+
+      if (self->ClientSendQueueLength > 0)
+      {
+        client->SendQueue = std::make_shared<ClientSendQueue>();
+        client->SendQueue->MaxLength = static_cast<unsigned int>(self->ClientSendQueueLength);
+        client->SendQueue->DropPolicy = self->ClientSendQueueDropPolicy;
+        client->VideoRateController = self->CreateVideoRateController();
+        client->DataSenderActive.first = true;
+        client->DataSenderThreadId = self->Threader->SpawnThread((vtkThreadFunctionType)&ClientDataSenderThread, client);
+      }
     }
   }
 
@@ -347,16 +582,56 @@ void* vtkPlusOpenIGTLinkServer::DataSenderThread(vtkMultiThreader::ThreadInfo* d
     LOG_WARNING("There are no channels to broadcast. Only command processing is available.");
   }
 
-  self->BroadcastChannel = aChannel;
-  if (self->BroadcastChannel)
+  self->BroadcastChannels.clear();
+  if (aChannel != NULL)
+  {
+    BroadcastChannelInfo channelInfo;
+    channelInfo.OutputChannelId = aChannel->GetChannelId();
+    channelInfo.Channel = aChannel;
+    channelInfo.SendIntervalSec = self->SendIntervalSec;
+    self->BroadcastChannels.push_back(channelInfo);
+  }
+  for (std::vector<BroadcastChannelInfo>::const_iterator channelIt = self->AdditionalBroadcastChannels.begin(); channelIt != self->AdditionalBroadcastChannels.end(); ++channelIt)
+  {
+    BroadcastChannelInfo channelInfo = *channelIt;
+    for (DeviceCollectionIterator it = aCollection.begin(); it != aCollection.end(); ++it)
+    {
+      vtkPlusChannel* channel(NULL);
+      if ((*it)->GetOutputChannelByName(channel, channelInfo.OutputChannelId) == PLUS_SUCCESS)
+      {
+        channelInfo.Channel = channel;
+        break;
+      }
+    }
+    if (channelInfo.Channel == NULL)
+    {
+      LOG_ERROR("Unable to broadcast channel " << channelInfo.OutputChannelId << ". Output channel not found.");
+      continue;
+    }
+    bool alreadyBroadcast = false;
+    for (std::vector<BroadcastChannelInfo>::const_iterator it = self->BroadcastChannels.begin(); it != self->BroadcastChannels.end(); ++it)
+    {
+      alreadyBroadcast = alreadyBroadcast || (it->Channel == channelInfo.Channel);
+    }
+    if (alreadyBroadcast)
+    {
+      LOG_WARNING("Channel " << channelInfo.OutputChannelId << " is already broadcast, the BroadcastChannel element is ignored.");
+      continue;
+    }
+    self->BroadcastChannels.push_back(channelInfo);
+  }
+  for (std::vector<BroadcastChannelInfo>::iterator it = self->BroadcastChannels.begin(); it != self->BroadcastChannels.end(); ++it)
   {
-    self->BroadcastChannel->GetMostRecentTimestamp(self->LastSentTrackedFrameTimestamp);
+    it->Channel->GetMostRecentTimestamp(it->LastSentTrackedFrameTimestamp);
   }
 
+  self->OpenUdpStream();
+
   double elapsedTimeSinceLastPacketSentSec = 0;
   while (self->ConnectionActive.Request && self->DataSenderActive.Request)
   {
-    bool clientsConnected = false;
+    // Subscribers of the UDP stream are not known, data is sent to the stream even if there are no TCP clients
+    bool clientsConnected = (self->UdpSender.get() != NULL);
     {
       igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self->IgtlClientsMutex);
       if (!self->IgtlClients.empty())
@@ -368,7 +643,10 @@ void* vtkPlusOpenIGTLinkServer::DataSenderThread(vtkMultiThreader::ThreadInfo* d
     {
       // No client connected, wait for a while
       vtkIGSIOAccurateTimer::Delay(0.2);
-      self->LastSentTrackedFrameTimestamp = 0; // next time start sending from the most recent timestamp
+      for (std::vector<BroadcastChannelInfo>::iterator it = self->BroadcastChannels.begin(); it != self->BroadcastChannels.end(); ++it)
+      {
+        it->LastSentTrackedFrameTimestamp = 0; // next time start sending from the most recent timestamp
+      }
       continue;
     }
 
@@ -385,6 +663,7 @@ void* vtkPlusOpenIGTLinkServer::DataSenderThread(vtkMultiThreader::ThreadInfo* d
     // Send image/tracking/string data
     SendLatestFramesToClients(*self, elapsedTimeSinceLastPacketSentSec);
   }
+  self->UdpSender.reset();
   // Close thread
   self->DataSenderThreadId = -1;
   self->DataSenderActive.Respond = false;
@@ -394,79 +673,108 @@ void* vtkPlusOpenIGTLinkServer::DataSenderThread(vtkMultiThreader::ThreadInfo* d
 //----------------------------------------------------------------------------
 PlusStatus vtkPlusOpenIGTLinkServer::SendLatestFramesToClients(vtkPlusOpenIGTLinkServer& self, double& elapsedTimeSinceLastPacketSentSec)
 {
-  vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
   double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
 
+  int numberOfSentFrames = 0;
+  for (std::vector<BroadcastChannelInfo>::iterator channelIt = self.BroadcastChannels.begin(); channelIt != self.BroadcastChannels.end(); ++channelIt)
+  {
+    int numberOfSentChannelFrames = 0;
+    SendLatestFramesFromChannel(self, *channelIt, numberOfSentChannelFrames);
+    numberOfSentFrames += numberOfSentChannelFrames;
+  }
+
+  // There is no new frame in the buffers
+  if (numberOfSentFrames == 0)
+  {
+    vtkIGSIOAccurateTimer::Delay(DELAY_ON_NO_NEW_FRAMES_SEC);
+    elapsedTimeSinceLastPacketSentSec += vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
+
+    // Send keep alive packet to clients
+    if (elapsedTimeSinceLastPacketSentSec > self.KeepAliveIntervalSec)
+    {
+      self.KeepAlive();
+      elapsedTimeSinceLastPacketSentSec = 0;
+      return PLUS_SUCCESS;
+    }
+
+    return PLUS_FAIL;
+  }
+
+  elapsedTimeSinceLastPacketSentSec = 0;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkServer::SendLatestFramesFromChannel(vtkPlusOpenIGTLinkServer& self, BroadcastChannelInfo& channelInfo, int& numberOfSentFrames)
+{
+  numberOfSentFrames = 0;
+  double startTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+  if (channelInfo.SendIntervalSec > 0 && startTimeSec - channelInfo.LastSendTime < channelInfo.SendIntervalSec)
+  {
+    return PLUS_SUCCESS;
+  }
+
+  vtkSmartPointer<vtkIGSIOTrackedFrameList> trackedFrameList = vtkSmartPointer<vtkIGSIOTrackedFrameList>::New();
+
   // Acquire tracked frames since last acquisition (minimum 1 frame)
-  if (self.LastProcessingTimePerFrameMs < 1)
+  if (channelInfo.LastProcessingTimePerFrameMs < 1)
   {
     // if processing was less than 1ms/frame then assume it was 1ms (1000FPS processing speed) to avoid division by zero
-    self.LastProcessingTimePerFrameMs = 1;
+    channelInfo.LastProcessingTimePerFrameMs = 1;
   }
-  int numberOfFramesToGet = std::max(self.MaxTimeSpentWithProcessingMs / self.LastProcessingTimePerFrameMs, 1);
+  int numberOfFramesToGet = std::max(self.MaxTimeSpentWithProcessingMs / channelInfo.LastProcessingTimePerFrameMs, 1);
   // Maximize the number of frames to send
   numberOfFramesToGet = std::min(numberOfFramesToGet, self.MaxNumberOfIgtlMessagesToSend);
+  if (channelInfo.SendIntervalSec > 0)
+  {
+    // Only the latest frame is sent in each interval, the frames acquired since the previous send are skipped
+    numberOfFramesToGet = 1;
+  }
 
-  if (self.BroadcastChannel != NULL)
+  vtkPlusChannel* channel = channelInfo.Channel;
+  if ((channel->HasVideoSource() && !channel->GetVideoDataAvailable())
+      || (channel->ToolCount() > 0 && !channel->GetTrackingDataAvailable())
+      || (channel->FieldCount() > 0 && !channel->GetFieldDataAvailable()))
   {
-    if ((self.BroadcastChannel->HasVideoSource() && !self.BroadcastChannel->GetVideoDataAvailable())
-        || (self.BroadcastChannel->ToolCount() > 0 && !self.BroadcastChannel->GetTrackingDataAvailable())
-        || (self.BroadcastChannel->FieldCount() > 0 && !self.BroadcastChannel->GetFieldDataAvailable()))
+    if (self.LogWarningOnNoDataAvailable)
     {
-      if (self.LogWarningOnNoDataAvailable)
-      {
-        LOG_DYNAMIC("No data is broadcasted, as no data is available yet.", self.GracePeriodLogLevel);
-      }
+      LOG_DYNAMIC("No data is broadcasted from channel " << channelInfo.OutputChannelId << ", as no data is available yet.", self.GracePeriodLogLevel);
     }
-    else
+    return PLUS_SUCCESS;
+  }
+
+  double oldestDataTimestamp = 0;
+  if (channel->GetOldestTimestamp(oldestDataTimestamp) == PLUS_SUCCESS)
+  {
+    if (channelInfo.LastSentTrackedFrameTimestamp < oldestDataTimestamp)
     {
-      double oldestDataTimestamp = 0;
-      if (self.BroadcastChannel->GetOldestTimestamp(oldestDataTimestamp) == PLUS_SUCCESS)
-      {
-        if (self.LastSentTrackedFrameTimestamp < oldestDataTimestamp)
-        {
-          LOG_INFO("OpenIGTLink broadcasting started. No data was available between " << self.LastSentTrackedFrameTimestamp << "-" << oldestDataTimestamp << "sec, therefore no data were broadcasted during this time period.");
-          self.LastSentTrackedFrameTimestamp = oldestDataTimestamp + SAMPLING_SKIPPING_MARGIN_SEC;
-        }
-        static vtkIGSIOLogHelper logHelper(60.0, 500000);
-        CUSTOM_RETURN_WITH_FAIL_IF(self.BroadcastChannel->GetTrackedFrameList(self.LastSentTrackedFrameTimestamp, trackedFrameList, numberOfFramesToGet) != PLUS_SUCCESS,
-                                   "Failed to get tracked frame list from data collector (last recorded timestamp: " << std::fixed << self.LastSentTrackedFrameTimestamp);
-      }
+      LOG_INFO("OpenIGTLink broadcasting of channel " << channelInfo.OutputChannelId << " started. No data was available between " << channelInfo.LastSentTrackedFrameTimestamp << "-" << oldestDataTimestamp << "sec, therefore no data were broadcasted during this time period.");
+      channelInfo.LastSentTrackedFrameTimestamp = oldestDataTimestamp + SAMPLING_SKIPPING_MARGIN_SEC;
     }
+    static vtkIGSIOLogHelper logHelper(60.0, 500000);
+    CUSTOM_RETURN_WITH_FAIL_IF(channel->GetTrackedFrameList(channelInfo.LastSentTrackedFrameTimestamp, trackedFrameList, numberOfFramesToGet) != PLUS_SUCCESS,
+                               "Failed to get tracked frame list from data collector (last recorded timestamp: " << std::fixed << channelInfo.LastSentTrackedFrameTimestamp);
   }
 
   // There is no new frame in the buffer
   if (trackedFrameList->GetNumberOfTrackedFrames() == 0)
   {
-    vtkIGSIOAccurateTimer::Delay(DELAY_ON_NO_NEW_FRAMES_SEC);
-    elapsedTimeSinceLastPacketSentSec += vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec;
-
-    // Send keep alive packet to clients
-    if (elapsedTimeSinceLastPacketSentSec > self.KeepAliveIntervalSec)
-    {
-      self.KeepAlive();
-      elapsedTimeSinceLastPacketSentSec = 0;
-      return PLUS_SUCCESS;
-    }
-
-    return PLUS_FAIL;
+    return PLUS_SUCCESS;
   }
 
+  // Clients only need to be told which channel a frame is from if there are multiple channels
+  std::string channelId = (self.BroadcastChannels.size() > 1 ? channelInfo.OutputChannelId : std::string());
   for (unsigned int i = 0; i < trackedFrameList->GetNumberOfTrackedFrames(); ++i)
   {
     // Send tracked frame
-    self.SendTrackedFrame(*trackedFrameList->GetTrackedFrame(i));
-    elapsedTimeSinceLastPacketSentSec = 0;
+    self.SendTrackedFrameFromChannel(*trackedFrameList->GetTrackedFrame(i), channelId);
   }
+  numberOfSentFrames = trackedFrameList->GetNumberOfTrackedFrames();
+  channelInfo.LastSendTime = startTimeSec;
 
   // Compute time spent with processing one frame in this round
   double computationTimeMs = (vtkIGSIOAccurateTimer::GetSystemTime() - startTimeSec) * 1000.0;
-
-  // Update last processing time if new tracked frames have been acquired
-  if (trackedFrameList->GetNumberOfTrackedFrames() > 0)
-  {
-    self.LastProcessingTimePerFrameMs = computationTimeMs / trackedFrameList->GetNumberOfTrackedFrames();
-  }
+  channelInfo.LastProcessingTimePerFrameMs = computationTimeMs / trackedFrameList->GetNumberOfTrackedFrames();
   return PLUS_SUCCESS;
 }
 
@@ -480,21 +788,30 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendMessageResponses(vtkPlusOpenIGTLinkServ
     {
       igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self.IgtlClientsMutex);
       igtl::ClientSocket::Pointer clientSocket = NULL;
+      std::shared_ptr<ClientSendQueue> sendQueue;
 
       for (std::list<ClientData>::iterator clientIterator = self.IgtlClients.begin(); clientIterator != self.IgtlClients.end(); ++clientIterator)
       {
         if (clientIterator->ClientId == it->first)
         {
           clientSocket = clientIterator->ClientSocket;
+          sendQueue = clientIterator->SendQueue;
           break;
         }
       }
-      if (clientSocket.IsNull())
+      if (clientSocket.IsNull() && !sendQueue)
       {
         LOG_WARNING("Message reply cannot be sent to client " << it->first << ", probably client has been disconnected.");
         continue;
       }
 
+      if (sendQueue)
+      {
+        // The socket is written by the client's sender thread
+        PushToClientSendQueue(*sendQueue, it->second, false);
+        continue;
+      }
+
       for (std::vector<igtl::MessageBase::Pointer>::iterator messageIt = it->second.begin(); messageIt != it->second.end(); ++messageIt)
       {
         clientSocket->Send((*messageIt)->GetBufferPointer(), (*messageIt)->GetBufferSize());
@@ -527,20 +844,27 @@ PlusStatus vtkPlusOpenIGTLinkServer::SendCommandResponses(vtkPlusOpenIGTLinkServ
       LOG_DEBUG("Send command reply to client " << (*responseIt)->GetClientId() << ": " << igtlResponseMessage->GetDeviceName());
       igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self.IgtlClientsMutex);
       igtl::ClientSocket::Pointer clientSocket = NULL;
+      std::shared_ptr<ClientSendQueue> sendQueue;
       for (std::list<ClientData>::iterator clientIterator = self.IgtlClients.begin(); clientIterator != self.IgtlClients.end(); ++clientIterator)
       {
         if (clientIterator->ClientId == (*responseIt)->GetClientId())
         {
           clientSocket = clientIterator->ClientSocket;
+          sendQueue = clientIterator->SendQueue;
           break;
         }
       }
 
-      if (clientSocket.IsNull())
+      if (clientSocket.IsNull() && !sendQueue)
       {
         LOG_WARNING("Message reply cannot be sent to client " << (*responseIt)->GetClientId() << ", probably client has been disconnected");
         continue;
       }
+      if (sendQueue)
+      {
+        PushToClientSendQueue(*sendQueue, std::vector<igtl::MessageBase::Pointer>(1, igtlResponseMessage), false);
+        continue;
+      }
       clientSocket->Send(igtlResponseMessage->GetBufferPointer(), igtlResponseMessage->GetBufferSize());
     }
   }
@@ -560,7 +884,6 @@ void* vtkPlusOpenIGTLinkServer::DataReceiverThread(vtkMultiThreader::ThreadInfo*
 
   // Make copy of frequently used data to avoid locking of client data
   igtl::ClientSocket::Pointer clientSocket = client->ClientSocket;
-  int clientId = client->ClientId;
 
   igtl::MessageHeader::Pointer headerMsg = self->IgtlMessageFactory->CreateHeaderMessage(IGTL_HEADER_VERSION_1);
 
@@ -578,489 +901,999 @@ void* vtkPlusOpenIGTLinkServer::DataReceiverThread(vtkMultiThreader::ThreadInfo*
 
     headerMsg->Unpack(self->IgtlMessageCrcCheckEnabled);
 
-    {
-      igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self->IgtlClientsMutex);
-      // Keep track of the highest known version of message ever sent by this client, this is the version that we reply with
-      // (upper bounded by the servers version)
-      if (headerMsg->GetHeaderVersion() > client->ClientInfo.GetClientHeaderVersion())
-      {
-        client->ClientInfo.SetClientHeaderVersion(std::min<int>(self->GetIGTLHeaderVersion(), headerMsg->GetHeaderVersion()));
-      }
-    }
-
     igtl::MessageBase::Pointer bodyMessage = self->IgtlMessageFactory->CreateReceiveMessage(headerMsg);
     if (bodyMessage.IsNull())
     {
       LOG_ERROR("Unable to receive message from client: " << client->ClientId);
+      clientSocket->Skip(headerMsg->GetBodySizeToRead(), 0);
       continue;
     }
 
-    if (typeid(*bodyMessage) == typeid(igtl::PlusClientInfoMessage))
+    // Receive the message body
+    bodyMessage->SetMessageHeader(headerMsg);
+    bodyMessage->AllocateBuffer();
+    if (bodyMessage->GetBufferBodySize() > 0)
+    {
+      clientSocket->Receive(bodyMessage->GetBufferBodyPointer(), bodyMessage->GetBufferBodySize());
+    }
+
+    if (self->ProcessClientMessage(*client, headerMsg, bodyMessage, previousCommandIds) != PLUS_SUCCESS)
+    {
+      // Stop receiving from this client
+      break;
+    }
+  } // ConnectionActive
+
+  // Close thread
+  client->DataReceiverThreadId = -1;
+  client->DataReceiverActive.second = false;
+  return NULL;
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkServer::ProcessClientMessage(ClientData& client, igtl::MessageHeader::Pointer headerMsg, igtl::MessageBase::Pointer bodyMessage, std::deque<uint32_t>& previousCommandIds)
+{
+  int clientId = client.ClientId;
+
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
+    // Keep track of the highest known version of message ever sent by this client, this is the version that we reply with
+    // (upper bounded by the servers version)
+    if (headerMsg->GetHeaderVersion() > client.ClientInfo.GetClientHeaderVersion())
+    {
+      client.ClientInfo.SetClientHeaderVersion(std::min<int>(this->GetIGTLHeaderVersion(), headerMsg->GetHeaderVersion()));
+    }
+  }
+
+  if (typeid(*bodyMessage) == typeid(igtl::PlusClientInfoMessage))
+  {
+    igtl::PlusClientInfoMessage::Pointer clientInfoMsg = dynamic_cast<igtl::PlusClientInfoMessage*>(bodyMessage.GetPointer());
+
+    int c = clientInfoMsg->Unpack(this->IgtlMessageCrcCheckEnabled);
+    if (c & igtl::MessageHeader::UNPACK_BODY)
     {
-      igtl::PlusClientInfoMessage::Pointer clientInfoMsg = dynamic_cast<igtl::PlusClientInfoMessage*>(bodyMessage.GetPointer());
-      clientInfoMsg->SetMessageHeader(headerMsg);
-      clientInfoMsg->AllocateBuffer();
+      // Message received from client, need to lock to modify client info
+      igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
+      client.ClientInfo = clientInfoMsg->GetClientInfo();
+      LOG_DEBUG("Client info message received from client " << clientId);
 
-      clientSocket->Receive(clientInfoMsg->GetBufferBodyPointer(), clientInfoMsg->GetBufferBodySize());
+      // Send all requested transforms with the next frame
+      this->IgtlMessageFactory->ResetPublishedTransforms(clientId);
 
-      int c = clientInfoMsg->Unpack(self->IgtlMessageCrcCheckEnabled);
-      if (c & igtl::MessageHeader::UNPACK_BODY)
+      if (client.SendQueue && !client.ClientInfo.GetSendQueueDropPolicy().empty())
       {
-        // Message received from client, need to lock to modify client info
-        igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(self->IgtlClientsMutex);
-        client->ClientInfo = clientInfoMsg->GetClientInfo();
-        LOG_DEBUG("Client info message received from client " << clientId);
+        ClientSendQueue::DropPolicyType dropPolicy(this->ClientSendQueueDropPolicy);
+        if (!GetSendQueueDropPolicyFromString(client.ClientInfo.GetSendQueueDropPolicy(), dropPolicy))
+        {
+          LOG_WARNING("Unknown SendQueueDropPolicy requested by client " << clientId << ": " << client.ClientInfo.GetSendQueueDropPolicy() << ". Using the server default.");
+        }
+        std::lock_guard<std::mutex> sendQueueLock(client.SendQueue->Mutex);
+        client.SendQueue->DropPolicy = dropPolicy;
       }
+
+      this->UpdateSharedMemoryTransport(client);
     }
-    else if (typeid(*bodyMessage) == typeid(igtl::GetStatusMessage))
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::GetStatusMessage))
+  {
+    // Just ping server, respond
+    igtl::StatusMessage::Pointer replyMsg = dynamic_cast<igtl::StatusMessage*>(this->IgtlMessageFactory->CreateSendMessage("STATUS", client.ClientInfo.GetClientHeaderVersion()).GetPointer());
+    replyMsg->SetCode(igtl::StatusMessage::STATUS_OK);
+    replyMsg->Pack();
+    if (client.SendQueue)
     {
-      // Just ping server, we can skip message and respond
-      clientSocket->Skip(headerMsg->GetBodySizeToRead(), 0);
-
-      igtl::StatusMessage::Pointer replyMsg = dynamic_cast<igtl::StatusMessage*>(self->IgtlMessageFactory->CreateSendMessage("STATUS", client->ClientInfo.GetClientHeaderVersion()).GetPointer());
-      replyMsg->SetCode(igtl::StatusMessage::STATUS_OK);
-      replyMsg->Pack();
-      clientSocket->Send(replyMsg->GetBufferPointer(), replyMsg->GetBufferSize());
+      // The socket is written by the client's sender thread
+      PushToClientSendQueue(*client.SendQueue, std::vector<igtl::MessageBase::Pointer>(1, replyMsg.GetPointer()), false);
     }
-    else if (typeid(*bodyMessage) == typeid(igtl::StringMessage)
-             && vtkPlusCommand::IsCommandDeviceName(headerMsg->GetDeviceName()))
+    else
     {
-      igtl::StringMessage::Pointer stringMsg = dynamic_cast<igtl::StringMessage*>(bodyMessage.GetPointer());
-      stringMsg->SetMessageHeader(headerMsg);
-      stringMsg->AllocateBuffer();
-      clientSocket->Receive(stringMsg->GetBufferBodyPointer(), stringMsg->GetBufferBodySize());
+      client.ClientSocket->Send(replyMsg->GetBufferPointer(), replyMsg->GetBufferSize());
+    }
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::StringMessage)
+           && vtkPlusCommand::IsCommandDeviceName(headerMsg->GetDeviceName()))
+  {
+    igtl::StringMessage::Pointer stringMsg = dynamic_cast<igtl::StringMessage*>(bodyMessage.GetPointer());
 
-      // We are receiving old style commands, handle it
-      int c = stringMsg->Unpack(self->IgtlMessageCrcCheckEnabled);
-      if (c & igtl::MessageHeader::UNPACK_BODY)
+    // We are receiving old style commands, handle it
+    int c = stringMsg->Unpack(this->IgtlMessageCrcCheckEnabled);
+    if (c & igtl::MessageHeader::UNPACK_BODY)
+    {
+      std::string deviceName(headerMsg->GetDeviceName());
+      if (deviceName.empty())
       {
-        std::string deviceName(headerMsg->GetDeviceName());
-        if (deviceName.empty())
-        {
-          self->PlusCommandProcessor->QueueStringResponse(PLUS_FAIL, std::string(vtkPlusCommand::DEVICE_NAME_REPLY), clientId, "Unable to read DeviceName.");
-          continue;
-        }
+        this->PlusCommandProcessor->QueueStringResponse(PLUS_FAIL, std::string(vtkPlusCommand::DEVICE_NAME_REPLY), clientId, "Unable to read DeviceName.");
+        return PLUS_SUCCESS;
+      }
 
-        uint32_t uid(0);
-        try
-        {
+      uint32_t uid(0);
+      try
+      {
 #if (_MSC_VER == 1500)
-          std::istringstream ss(vtkPlusCommand::GetUidFromCommandDeviceName(deviceName));
-          ss >> uid;
+        std::istringstream ss(vtkPlusCommand::GetUidFromCommandDeviceName(deviceName));
+        ss >> uid;
 #else
-          uid = std::stoi(vtkPlusCommand::GetUidFromCommandDeviceName(deviceName));
+        uid = std::stoi(vtkPlusCommand::GetUidFromCommandDeviceName(deviceName));
 #endif
-        }
-        catch (std::invalid_argument e)
-        {
-          LOG_ERROR("Unable to extract command UID from device name string.");
-          // Removing support for malformed command strings, reply with error
-          self->PlusCommandProcessor->QueueStringResponse(PLUS_FAIL, std::string(vtkPlusCommand::DEVICE_NAME_REPLY), clientId, "Malformed DeviceName. Expected CMD_cmdId (ex: CMD_001)");
-          continue;
-        }
-
-        deviceName = vtkPlusCommand::GetPrefixFromCommandDeviceName(deviceName);
+      }
+      catch (std::invalid_argument e)
+      {
+        LOG_ERROR("Unable to extract command UID from device name string.");
+        // Removing support for malformed command strings, reply with error
+        this->PlusCommandProcessor->QueueStringResponse(PLUS_FAIL, std::string(vtkPlusCommand::DEVICE_NAME_REPLY), clientId, "Malformed DeviceName. Expected CMD_cmdId (ex: CMD_001)");
+        return PLUS_SUCCESS;
+      }
 
-        if (std::find(previousCommandIds.begin(), previousCommandIds.end(), uid) != previousCommandIds.end())
-        {
-          // Command already exists
-          LOG_WARNING("Already received a command with id = " << uid << " from client " << clientId << ". This repeated command will be ignored.");
-          continue;
-        }
-        // New command, remember its ID
-        previousCommandIds.push_back(uid);
-        if (previousCommandIds.size() > NUMBER_OF_RECENT_COMMAND_IDS_STORED)
-        {
-          previousCommandIds.pop_front();
-        }
+      deviceName = vtkPlusCommand::GetPrefixFromCommandDeviceName(deviceName);
 
-        LOG_DEBUG("Received command from client " << clientId << ", device " << deviceName << " with UID " << uid << ": " << stringMsg->GetString());
+      if (std::find(previousCommandIds.begin(), previousCommandIds.end(), uid) != previousCommandIds.end())
+      {
+        // Command already exists
+        LOG_WARNING("Already received a command with id = " << uid << " from client " << clientId << ". This repeated command will be ignored.");
+        return PLUS_SUCCESS;
+      }
+      // New command, remember its ID
+      previousCommandIds.push_back(uid);
+      if (previousCommandIds.size() > NUMBER_OF_RECENT_COMMAND_IDS_STORED)
+      {
+        previousCommandIds.pop_front();
+      }
 
-        vtkSmartPointer<vtkXMLDataElement> cmdElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(stringMsg->GetString()));
-        std::string commandName = std::string(cmdElement->GetAttribute("Name") == NULL ? "" : cmdElement->GetAttribute("Name"));
+      LOG_DEBUG("Received command from client " << clientId << ", device " << deviceName << " with UID " << uid << ": " << stringMsg->GetString());
 
-        self->PlusCommandProcessor->QueueCommand(false, clientId, commandName, stringMsg->GetString(), deviceName, uid, stringMsg->GetMetaData());
-      }
+      vtkSmartPointer<vtkXMLDataElement> cmdElement = vtkSmartPointer<vtkXMLDataElement>::Take(vtkXMLUtilities::ReadElementFromString(stringMsg->GetString()));
+      std::string commandName = std::string(cmdElement->GetAttribute("Name") == NULL ? "" : cmdElement->GetAttribute("Name"));
 
+      this->PlusCommandProcessor->QueueCommand(false, clientId, commandName, stringMsg->GetString(), deviceName, uid, stringMsg->GetMetaData());
     }
-    else if (typeid(*bodyMessage) == typeid(igtl::CommandMessage))
+
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::CommandMessage))
+  {
+    igtl::CommandMessage::Pointer commandMsg = dynamic_cast<igtl::CommandMessage*>(bodyMessage.GetPointer());
+
+    int c = commandMsg->Unpack(this->IgtlMessageCrcCheckEnabled);
+    if (c & igtl::MessageHeader::UNPACK_BODY)
     {
-      igtl::CommandMessage::Pointer commandMsg = dynamic_cast<igtl::CommandMessage*>(bodyMessage.GetPointer());
-      commandMsg->SetMessageHeader(headerMsg);
-      commandMsg->AllocateBuffer();
-      clientSocket->Receive(commandMsg->GetBufferBodyPointer(), commandMsg->GetBufferBodySize());
+      std::string deviceName(headerMsg->GetDeviceName());
 
-      int c = commandMsg->Unpack(self->IgtlMessageCrcCheckEnabled);
-      if (c & igtl::MessageHeader::UNPACK_BODY)
+      uint32_t uid;
+      uid = commandMsg->GetCommandId();
+
+      if (std::find(previousCommandIds.begin(), previousCommandIds.end(), uid) != previousCommandIds.end())
+      {
+        // Command already exists
+        LOG_WARNING("Already received a command with id = " << uid << " from client " << clientId << ". This repeated command will be ignored.");
+        return PLUS_SUCCESS;
+      }
+      // New command, remember its ID
+      previousCommandIds.push_back(uid);
+      if (previousCommandIds.size() > NUMBER_OF_RECENT_COMMAND_IDS_STORED)
       {
-        std::string deviceName(headerMsg->GetDeviceName());
+        previousCommandIds.pop_front();
+      }
 
-        uint32_t uid;
-        uid = commandMsg->GetCommandId();
+      LOG_DEBUG("Received header version " << commandMsg->GetHeaderVersion() << " command " << commandMsg->GetCommandName()
+                << " from client " << clientId << ", device " << deviceName << " with UID " << uid << ": " << commandMsg->GetCommandContent());
 
-        if (std::find(previousCommandIds.begin(), previousCommandIds.end(), uid) != previousCommandIds.end())
-        {
-          // Command already exists
-          LOG_WARNING("Already received a command with id = " << uid << " from client " << clientId << ". This repeated command will be ignored.");
-          continue;
+      this->PlusCommandProcessor->QueueCommand(true, clientId, commandMsg->GetCommandName(), commandMsg->GetCommandContent(), deviceName, uid, commandMsg->GetMetaData());
+    }
+    else
+    {
+      LOG_ERROR("STRING message unpacking failed for client " << clientId);
+    }
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::StartTrackingDataMessage))
+  {
+    std::string deviceName("");
+
+    igtl::StartTrackingDataMessage::Pointer startTracking = dynamic_cast<igtl::StartTrackingDataMessage*>(bodyMessage.GetPointer());
+
+    int c = startTracking->Unpack(this->IgtlMessageCrcCheckEnabled);
+    if (c & igtl::MessageHeader::UNPACK_BODY)
+    {
+      client.ClientInfo.SetTDATAResolution(startTracking->GetResolution());
+      client.ClientInfo.SetTDATARequested(true);
+    }
+    else
+    {
+      LOG_ERROR("Client " << clientId << " STT_TDATA failed: could not retrieve startTracking message");
+      return PLUS_FAIL;
+    }
+
+    igtl::MessageBase::Pointer msg = this->IgtlMessageFactory->CreateSendMessage("RTS_TDATA", client.ClientInfo.GetClientHeaderVersion());
+    igtl::RTSTrackingDataMessage* rtsMsg = dynamic_cast<igtl::RTSTrackingDataMessage*>(msg.GetPointer());
+    rtsMsg->SetStatus(0);
+    rtsMsg->Pack();
+    this->QueueMessageResponseForClient(client.ClientId, msg);
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::StopTrackingDataMessage))
+  {
+    client.ClientInfo.SetTDATARequested(false);
+    igtl::MessageBase::Pointer msg = this->IgtlMessageFactory->CreateSendMessage("RTS_TDATA", client.ClientInfo.GetClientHeaderVersion());
+    igtl::RTSTrackingDataMessage* rtsMsg = dynamic_cast<igtl::RTSTrackingDataMessage*>(msg.GetPointer());
+    rtsMsg->SetStatus(0);
+    rtsMsg->Pack();
+    this->QueueMessageResponseForClient(client.ClientId, msg);
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::GetPolyDataMessage))
+  {
+    igtl::GetPolyDataMessage::Pointer polyDataMessage = dynamic_cast<igtl::GetPolyDataMessage*>(bodyMessage.GetPointer());
+
+    int c = polyDataMessage->Unpack(this->IgtlMessageCrcCheckEnabled);
+    if (c & igtl::MessageHeader::UNPACK_BODY)
+    {
+      std::string fileName;
+      // Check metadata for requisite parameters, if absent, check deviceName
+      if (polyDataMessage->GetHeaderVersion() > IGTL_HEADER_VERSION_1)
+      {
+        if (!polyDataMessage->GetMetaDataElement("filename", fileName))
+        {
+          fileName = polyDataMessage->GetDeviceName();
+          if (fileName.empty())
+          {
+            LOG_ERROR("GetPolyData message sent with no filename in either metadata or deviceName field.");
+            return PLUS_SUCCESS;
+          }
         }
-        // New command, remember its ID
-        previousCommandIds.push_back(uid);
-        if (previousCommandIds.size() > NUMBER_OF_RECENT_COMMAND_IDS_STORED)
+      }
+      else
+      {
+        fileName = polyDataMessage->GetDeviceName();
+        if (fileName.empty())
         {
-          previousCommandIds.pop_front();
+          LOG_ERROR("GetPolyData message sent with no filename in either metadata or deviceName field.");
+          return PLUS_SUCCESS;
         }
+      }
 
-        LOG_DEBUG("Received header version " << commandMsg->GetHeaderVersion() << " command " << commandMsg->GetCommandName()
-                  << " from client " << clientId << ", device " << deviceName << " with UID " << uid << ": " << commandMsg->GetCommandContent());
+      vtkSmartPointer<vtkPolyDataReader> reader = vtkSmartPointer<vtkPolyDataReader>::New();
+      reader->SetFileName(fileName.c_str());
+      reader->Update();
 
-        self->PlusCommandProcessor->QueueCommand(true, clientId, commandMsg->GetCommandName(), commandMsg->GetCommandContent(), deviceName, uid, commandMsg->GetMetaData());
-      }
-      else
+      auto polyData = reader->GetOutput();
+      if (polyData != nullptr)
       {
-        LOG_ERROR("STRING message unpacking failed for client " << clientId);
+        igtl::MessageBase::Pointer msg = this->IgtlMessageFactory->CreateSendMessage("POLYDATA", client.ClientInfo.GetClientHeaderVersion());
+        igtl::PolyDataMessage* polyMsg = dynamic_cast<igtl::PolyDataMessage*>(msg.GetPointer());
+
+        igtlioPolyDataConverter::ContentData data;
+        data.deviceName = "PlusServer";
+        data.polydata = polyData;
+
+        igtlioBaseConverter::HeaderData header;
+        header.deviceName = "PlusServer";
+
+        igtlioPolyDataConverter::toIGTL(header, data, (igtl::PolyDataMessage::Pointer*)&msg);
+        if (!msg->SetMetaDataElement("fileName", IANA_TYPE_US_ASCII, fileName))
+        {
+          LOG_ERROR("Filename too long to be sent back to client. Aborting.");
+          return PLUS_SUCCESS;
+        }
+        this->QueueMessageResponseForClient(client.ClientId, msg);
+        return PLUS_SUCCESS;
       }
+
+      igtl::MessageBase::Pointer msg = this->IgtlMessageFactory->CreateSendMessage("RTS_POLYDATA", polyDataMessage->GetHeaderVersion());
+      igtl::RTSPolyDataMessage* rtsPolyMsg = dynamic_cast<igtl::RTSPolyDataMessage*>(msg.GetPointer());
+      rtsPolyMsg->SetStatus(false);
+      this->QueueMessageResponseForClient(client.ClientId, rtsPolyMsg);
     }
-    else if (typeid(*bodyMessage) == typeid(igtl::StartTrackingDataMessage))
+    else
     {
-      std::string deviceName("");
-
-      igtl::StartTrackingDataMessage::Pointer startTracking = dynamic_cast<igtl::StartTrackingDataMessage*>(bodyMessage.GetPointer());
-      startTracking->SetMessageHeader(headerMsg);
-      startTracking->AllocateBuffer();
+      LOG_ERROR("Client " << clientId << " GET_POLYDATA failed: could not retrieve message");
+      return PLUS_FAIL;
+    }
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::StatusMessage))
+  {
+    // status message is used as a keep-alive, don't do anything
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::GetImageMetaMessage))
+  {
+    igtl::GetImageMetaMessage::Pointer getImageMetaMsg = dynamic_cast<igtl::GetImageMetaMessage*>(bodyMessage.GetPointer());
 
-      clientSocket->Receive(startTracking->GetBufferBodyPointer(), startTracking->GetBufferBodySize());
+    int c = getImageMetaMsg->Unpack(this->IgtlMessageCrcCheckEnabled);
+    if (c & igtl::MessageHeader::UNPACK_BODY)
+    {
+      // Image meta message
+      std::string deviceName("");
+      if (headerMsg->GetDeviceName() != NULL)
+      {
+        deviceName = headerMsg->GetDeviceName();
+      }
+      this->PlusCommandProcessor->QueueGetImageMetaData(clientId, deviceName);
+    }
+    else
+    {
+      LOG_ERROR("Client " << clientId << " GET_IMGMETA failed: could not retrieve message");
+      return PLUS_FAIL;
+    }
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::GetImageMessage))
+  {
+    igtl::GetImageMessage::Pointer getImageMsg = dynamic_cast<igtl::GetImageMessage*>(bodyMessage.GetPointer());
 
-      int c = startTracking->Unpack(self->IgtlMessageCrcCheckEnabled);
-      if (c & igtl::MessageHeader::UNPACK_BODY)
+    int c = getImageMsg->Unpack(this->IgtlMessageCrcCheckEnabled);
+    if (c & igtl::MessageHeader::UNPACK_BODY)
+    {
+      std::string deviceName("");
+      if (headerMsg->GetDeviceName() != NULL)
       {
-        client->ClientInfo.SetTDATAResolution(startTracking->GetResolution());
-        client->ClientInfo.SetTDATARequested(true);
+        deviceName = headerMsg->GetDeviceName();
       }
       else
       {
-        LOG_ERROR("Client " << clientId << " STT_TDATA failed: could not retrieve startTracking message");
-        return NULL;
+        LOG_ERROR("Please select the image you want to acquire");
+        return PLUS_FAIL;
       }
-
-      igtl::MessageBase::Pointer msg = self->IgtlMessageFactory->CreateSendMessage("RTS_TDATA", client->ClientInfo.GetClientHeaderVersion());
-      igtl::RTSTrackingDataMessage* rtsMsg = dynamic_cast<igtl::RTSTrackingDataMessage*>(msg.GetPointer());
-      rtsMsg->SetStatus(0);
-      rtsMsg->Pack();
-      self->QueueMessageResponseForClient(client->ClientId, msg);
+      this->PlusCommandProcessor->QueueGetImage(clientId, deviceName);
     }
-    else if (typeid(*bodyMessage) == typeid(igtl::StopTrackingDataMessage))
+    else
     {
-      igtl::StopTrackingDataMessage::Pointer stopTracking = dynamic_cast<igtl::StopTrackingDataMessage*>(bodyMessage.GetPointer());
-      stopTracking->SetMessageHeader(headerMsg);
-      stopTracking->AllocateBuffer();
+      LOG_ERROR("Client " << clientId << " GET_IMAGE failed: could not retrieve message");
+      return PLUS_FAIL;
+    }
 
-      clientSocket->Receive(stopTracking->GetBufferBodyPointer(), stopTracking->GetBufferBodySize());
+  }
+  else if (typeid(*bodyMessage) == typeid(igtl::GetPointMessage))
+  {
+    igtl::GetPointMessage* getPointMsg = dynamic_cast<igtl::GetPointMessage*>(bodyMessage.GetPointer());
 
-      client->ClientInfo.SetTDATARequested(false);
-      igtl::MessageBase::Pointer msg = self->IgtlMessageFactory->CreateSendMessage("RTS_TDATA", client->ClientInfo.GetClientHeaderVersion());
-      igtl::RTSTrackingDataMessage* rtsMsg = dynamic_cast<igtl::RTSTrackingDataMessage*>(msg.GetPointer());
-      rtsMsg->SetStatus(0);
-      rtsMsg->Pack();
-      self->QueueMessageResponseForClient(client->ClientId, msg);
-    }
-    else if (typeid(*bodyMessage) == typeid(igtl::GetPolyDataMessage))
+    int c = getPointMsg->Unpack(this->IgtlMessageCrcCheckEnabled);
+    if (c & igtl::MessageHeader::UNPACK_BODY)
     {
-      igtl::GetPolyDataMessage::Pointer polyDataMessage = dynamic_cast<igtl::GetPolyDataMessage*>(bodyMessage.GetPointer());
-      polyDataMessage->SetMessageHeader(headerMsg);
-      polyDataMessage->AllocateBuffer();
+      std::string fileName;
+      if (!getPointMsg->GetMetaDataElement("Filename", fileName))
+      {
+        fileName = getPointMsg->GetDeviceName();
+      }
 
-      clientSocket->Receive(polyDataMessage->GetBufferBodyPointer(), polyDataMessage->GetBufferBodySize());
+      if (igsioCommon::Tail(fileName, 4) != "fcsv")
+      {
+        LOG_WARNING("Filename does not end in fcsv. GetPoint behaviour may not function correctly.");
+      }
 
-      int c = polyDataMessage->Unpack(self->IgtlMessageCrcCheckEnabled);
-      if (c & igtl::MessageHeader::UNPACK_BODY)
+      if (!vtksys::SystemTools::FileExists(fileName) &&
+          !vtksys::SystemTools::FileExists(vtkPlusConfig::GetInstance()->GetImagePath(fileName)))
       {
-        std::string fileName;
-        // Check metadata for requisite parameters, if absent, check deviceName
-        if (polyDataMessage->GetHeaderVersion() > IGTL_HEADER_VERSION_1)
+        LOG_ERROR("File: " << fileName << " requested but does not exist. Cannot get POINT data from it.");
+        return PLUS_FAIL;
+      }
+
+      igtl::MessageBase::Pointer msg = this->IgtlMessageFactory->CreateSendMessage("POINT", client.ClientInfo.GetClientHeaderVersion());
+      igtl::PointMessage* pointMsg = dynamic_cast<igtl::PointMessage*>(msg.GetPointer());
+
+      std::ifstream t(fileName);
+      if (!t.is_open())
+      {
+        t.open(vtkPlusConfig::GetInstance()->GetImagePath(fileName));
+        if (!t.is_open())
         {
-          if (!polyDataMessage->GetMetaDataElement("filename", fileName))
-          {
-            fileName = polyDataMessage->GetDeviceName();
-            if (fileName.empty())
-            {
-              LOG_ERROR("GetPolyData message sent with no filename in either metadata or deviceName field.");
-              continue;
-            }
-          }
+          LOG_ERROR("Cannot read file: " << fileName);
+          return PLUS_FAIL;
         }
-        else
+      }
+      std::stringstream buffer;
+      buffer << t.rdbuf();
+      std::vector<std::string> lines = igsioCommon::SplitStringIntoTokens(buffer.str(), '\n', false);
+      for (std::vector<std::string>::iterator it = lines.begin(); it != lines.end(); ++it)
+      {
+        std::string line = igsioCommon::Trim(*it);
+        if (line[0] == '#')
         {
-          fileName = polyDataMessage->GetDeviceName();
-          if (fileName.empty())
-          {
-            LOG_ERROR("GetPolyData message sent with no filename in either metadata or deviceName field.");
-            continue;
-          }
+          continue;
         }
 
-        vtkSmartPointer<vtkPolyDataReader> reader = vtkSmartPointer<vtkPolyDataReader>::New();
-        reader->SetFileName(fileName.c_str());
-        reader->Update();
+        std::vector<std::string> tokens = igsioCommon::SplitStringIntoTokens(line, ',', true);
+        igtl::PointElement::Pointer elem = igtl::PointElement::New();
+        elem->SetPosition(std::stof(tokens[1]), std::stof(tokens[2]), std::stof(tokens[3]));
+        elem->SetName(tokens[0].c_str());
+        elem->SetGroupName("Point");
+        pointMsg->AddPointElement(elem);
+      }
 
-        auto polyData = reader->GetOutput();
-        if (polyData != nullptr)
-        {
-          igtl::MessageBase::Pointer msg = self->IgtlMessageFactory->CreateSendMessage("POLYDATA", client->ClientInfo.GetClientHeaderVersion());
-          igtl::PolyDataMessage* polyMsg = dynamic_cast<igtl::PolyDataMessage*>(msg.GetPointer());
+      this->QueueMessageResponseForClient(client.ClientId, pointMsg);
+    }
+    else
+    {
+      LOG_ERROR("Client " << clientId << " GET_POINT failed: could not retrieve message");
+      return PLUS_FAIL;
+    }
+  }
+  else
+  {
+    // if the device type is unknown, ignore the message
+    LOG_WARNING("Unknown OpenIGTLink message is received from client " << clientId << ". Device type: " << headerMsg->GetMessageType()
+                << ". Device name: " << headerMsg->GetDeviceName() << ".");
+  }
 
-          igtlioPolyDataConverter::ContentData data;
-          data.deviceName = "PlusServer";
-          data.polydata = polyData;
+  return PLUS_SUCCESS;
+}
+
+//----------------------------------------------------------------------------
+void* vtkPlusOpenIGTLinkServer::ClientDataSenderThread(vtkMultiThreader::ThreadInfo* data)
+{
+  ClientData* client = (ClientData*)(data->UserData);
+  client->DataSenderActive.second = true;
+  vtkPlusOpenIGTLinkServer* self = client->Server;
 
-          igtlioBaseConverter::HeaderData header;
-          header.deviceName = "PlusServer";
+  // Make copy of frequently used data to avoid locking of client data
+  igtl::ClientSocket::Pointer clientSocket = client->ClientSocket;
+  std::shared_ptr<ClientSendQueue> sendQueue = client->SendQueue;
+  int clientId = client->ClientId;
 
-          igtlioPolyDataConverter::toIGTL(header, data, (igtl::PolyDataMessage::Pointer*)&msg);
-          if (!msg->SetMetaDataElement("fileName", IANA_TYPE_US_ASCII, fileName))
-          {
-            LOG_ERROR("Filename too long to be sent back to client. Aborting.");
-            continue;
-          }
-          self->QueueMessageResponseForClient(client->ClientId, msg);
-          continue;
-        }
+  const int socketDescriptor = vtkPlusIgtlMessageCommon::GetSocketDescriptor(clientSocket);
 
-        igtl::MessageBase::Pointer msg = self->IgtlMessageFactory->CreateSendMessage("RTS_POLYDATA", polyDataMessage->GetHeaderVersion());
-        igtl::RTSPolyDataMessage* rtsPolyMsg = dynamic_cast<igtl::RTSPolyDataMessage*>(msg.GetPointer());
-        rtsPolyMsg->SetStatus(false);
-        self->QueueMessageResponseForClient(client->ClientId, rtsPolyMsg);
-      }
-      else
+  // Item that is being written. Bytes before messageOffset of message messageIndex are already sent.
+  ClientSendQueue::Item item;
+  bool hasItem = false;
+  size_t messageIndex = 0;
+  size_t messageOffset = 0;
+  double lastSendProgressTime = 0.0;
+  while (client->DataSenderActive.first)
+  {
+    if (!hasItem)
+    {
+      std::unique_lock<std::mutex> sendQueueLock(sendQueue->Mutex);
+      if (sendQueue->Items.empty())
       {
-        LOG_ERROR("Client " << clientId << " GET_POLYDATA failed: could not retrieve message");
-        return NULL;
+        // Wake up regularly to check if the thread has to stop
+        sendQueue->ItemAvailable.wait_for(sendQueueLock, std::chrono::milliseconds(CLIENT_SEND_QUEUE_WAIT_TIMEOUT_MSEC));
+        continue;
       }
+      item = sendQueue->Items.front();
+      sendQueue->Items.pop_front();
+      sendQueue->Statistics.QueueLength = static_cast<unsigned int>(sendQueue->Items.size());
+      hasItem = true;
+      messageIndex = 0;
+      messageOffset = 0;
+      lastSendProgressTime = vtkIGSIOAccurateTimer::GetSystemTime();
+      // Messages of the item are sent in full TCP segments
+      self->SocketOptions.SetCorked(clientSocket, true);
     }
-    else if (typeid(*bodyMessage) == typeid(igtl::StatusMessage))
+
+    bool sendFailed = false;
+    if (socketDescriptor >= 0)
     {
-      // status message is used as a keep-alive, don't do anything
-      clientSocket->Skip(headerMsg->GetBodySizeToRead(), 0);
+      size_t previousMessageIndex = messageIndex;
+      size_t previousMessageOffset = messageOffset;
+      int sendResult = vtkPlusIgtlMessageCommon::SendPackedMessagesNonBlocking(socketDescriptor, item.Messages, self->SocketOptions.CoalesceMessages, messageIndex, messageOffset);
+      if (sendResult < 0)
+      {
+        LOG_INFO("Client disconnected - could not send " << item.Messages[messageIndex]->GetMessageType() << " message to client " << clientId
+                 << " (device name: " << item.Messages[messageIndex]->GetDeviceName() << ").");
+        sendFailed = true;
+      }
+      else if (sendResult == 0)
+      {
+        // The socket buffer is full. Meanwhile new frames wait in the queue, the drop policy decides what happens if it is full.
+        double systemTime = vtkIGSIOAccurateTimer::GetSystemTime();
+        if (messageIndex != previousMessageIndex || messageOffset != previousMessageOffset)
+        {
+          lastSendProgressTime = systemTime;
+        }
+        if (systemTime - lastSendProgressTime <= self->DefaultClientSendTimeoutSec)
+        {
+          vtkPlusIgtlMessageCommon::WaitForSocketWritable(socketDescriptor, CLIENT_SEND_QUEUE_WAIT_TIMEOUT_MSEC);
+          continue;
+        }
+        LOG_INFO("Client " << clientId << " did not receive data for " << self->DefaultClientSendTimeoutSec << " s, the client will be disconnected.");
+        sendFailed = true;
+      }
     }
-    else if (typeid(*bodyMessage) == typeid(igtl::GetImageMetaMessage))
+    else if (vtkPlusIgtlMessageCommon::SendPackedMessages(clientSocket, item.Messages) == 0)
     {
-      igtl::GetImageMetaMessage::Pointer getImageMetaMsg = dynamic_cast<igtl::GetImageMetaMessage*>(bodyMessage.GetPointer());
-      getImageMetaMsg->SetMessageHeader(headerMsg);
-      getImageMetaMsg->AllocateBuffer();
-
-      clientSocket->Receive(getImageMetaMsg->GetBufferBodyPointer(), getImageMetaMsg->GetBufferBodySize());
+      // Non-blocking writes are not available on this platform, the send timeout of the socket limits the wait
+      LOG_INFO("Client disconnected - could not send " << item.Messages.size() << " messages to client " << clientId << ".");
+      sendFailed = true;
+    }
+    self->SocketOptions.SetCorked(clientSocket, false);
+    hasItem = false;
 
-      int c = getImageMetaMsg->Unpack(self->IgtlMessageCrcCheckEnabled);
-      if (c & igtl::MessageHeader::UNPACK_BODY)
+    {
+      std::lock_guard<std::mutex> sendQueueLock(sendQueue->Mutex);
+      if (sendFailed)
       {
-        // Image meta message
-        std::string deviceName("");
-        if (headerMsg->GetDeviceName() != NULL)
-        {
-          deviceName = headerMsg->GetDeviceName();
-        }
-        self->PlusCommandProcessor->QueueGetImageMetaData(clientId, deviceName);
+        // The data sender thread disconnects the client, until then nothing else is sent
+        sendQueue->SendFailed = true;
+        sendQueue->Items.clear();
+        sendQueue->Statistics.QueueLength = 0;
       }
       else
       {
-        LOG_ERROR("Client " << clientId << " GET_IMGMETA failed: could not retrieve message");
-        return NULL;
+        unsigned long long sentBytes = 0;
+        for (std::vector<igtl::MessageBase::Pointer>::const_iterator igtlMessageIterator = item.Messages.begin(); igtlMessageIterator != item.Messages.end(); ++igtlMessageIterator)
+        {
+          sentBytes += vtkPlusIgtlMessageCommon::GetPackedMessageSize(*igtlMessageIterator);
+        }
+        double systemTime = vtkIGSIOAccurateTimer::GetSystemTime();
+        sendQueue->Statistics.AddSentItem(sentBytes, systemTime - item.QueuedTime, systemTime);
       }
     }
-    else if (typeid(*bodyMessage) == typeid(igtl::GetImageMessage))
+    if (sendFailed)
     {
-      igtl::GetImageMessage::Pointer getImageMsg = dynamic_cast<igtl::GetImageMessage*>(bodyMessage.GetPointer());
-      getImageMsg->SetMessageHeader(headerMsg);
-      getImageMsg->AllocateBuffer();
+      break;
+    }
+  }
+
+  // Close thread
+  client->DataSenderThreadId = -1;
+  client->DataSenderActive.second = false;
+  return NULL;
+}
 
-      clientSocket->Receive(getImageMsg->GetBufferBodyPointer(), getImageMsg->GetBufferBodySize());
+//----------------------------------------------------------------------------
+bool vtkPlusOpenIGTLinkServer::PushToClientSendQueue(ClientSendQueue& sendQueue, const std::vector<igtl::MessageBase::Pointer>& messages, bool droppable,
+    const std::function<void()>& droppedCallback)
+{
+  // The callback of the dropped item is called after the queue is unlocked
+  std::function<void()> droppedItemCallback;
+  bool newItemDropped = false;
+  {
+    std::lock_guard<std::mutex> sendQueueLock(sendQueue.Mutex);
+    if (sendQueue.SendFailed)
+    {
+      return false;
+    }
 
-      int c = getImageMsg->Unpack(self->IgtlMessageCrcCheckEnabled);
-      if (c & igtl::MessageHeader::UNPACK_BODY)
+    if (droppable)
+    {
+      unsigned int numberOfDroppableItems = 0;
+      for (std::deque<ClientSendQueue::Item>::const_iterator it = sendQueue.Items.begin(); it != sendQueue.Items.end(); ++it)
+      {
+        numberOfDroppableItems += (it->Droppable ? 1 : 0);
+      }
+      if (numberOfDroppableItems >= sendQueue.MaxLength)
       {
-        std::string deviceName("");
-        if (headerMsg->GetDeviceName() != NULL)
+        if (sendQueue.DropPolicy == ClientSendQueue::DISCONNECT)
         {
-          deviceName = headerMsg->GetDeviceName();
+          LOG_INFO("Send queue of a client is full (" << sendQueue.MaxLength << " frames), the client will be disconnected.");
+          sendQueue.SendFailed = true;
+          return false;
+        }
+        sendQueue.Statistics.NumberOfDroppedItems++;
+        if (sendQueue.DropPolicy == ClientSendQueue::DROP_NEWEST)
+        {
+          droppedItemCallback = droppedCallback;
+          newItemDropped = true;
         }
         else
         {
-          LOG_ERROR("Please select the image you want to acquire");
-          return NULL;
+          // DROP_OLDEST: remove the oldest droppable item, replies are always kept
+          for (std::deque<ClientSendQueue::Item>::iterator it = sendQueue.Items.begin(); it != sendQueue.Items.end(); ++it)
+          {
+            if (it->Droppable)
+            {
+              droppedItemCallback = it->DroppedCallback;
+              sendQueue.Items.erase(it);
+              break;
+            }
+          }
         }
-        self->PlusCommandProcessor->QueueGetImage(clientId, deviceName);
       }
-      else
+    }
+
+    if (!newItemDropped)
+    {
+      ClientSendQueue::Item item;
+      item.Messages = messages;
+      item.QueuedTime = vtkIGSIOAccurateTimer::GetSystemTime();
+      item.Droppable = droppable;
+      item.DroppedCallback = droppedCallback;
+      sendQueue.Items.push_back(item);
+
+      sendQueue.Statistics.NumberOfQueuedItems++;
+      sendQueue.Statistics.QueueLength = static_cast<unsigned int>(sendQueue.Items.size());
+      sendQueue.Statistics.MaxQueueLength = std::max(sendQueue.Statistics.MaxQueueLength, sendQueue.Statistics.QueueLength);
+    }
+  }
+  if (droppedItemCallback)
+  {
+    droppedItemCallback();
+  }
+  if (newItemDropped)
+  {
+    return true;
+  }
+  sendQueue.ItemAvailable.notify_one();
+  if (sendQueue.ItemAddedCallback)
+  {
+    sendQueue.ItemAddedCallback();
+  }
+  return true;
+}
+
+//----------------------------------------------------------------------------
+std::function<void()> vtkPlusOpenIGTLinkServer::GetDroppedItemCallback(int packingClientId, const PlusIgtlClientInfo& clientInfo)
+{
+  std::vector<vtkSmartPointer<vtkPlusIgtlImageCompressor> > predictingCompressors;
+  if (std::find(clientInfo.IgtlMessageTypes.begin(), clientInfo.IgtlMessageTypes.end(), std::string("IMAGE")) != clientInfo.IgtlMessageTypes.end())
+  {
+    for (std::vector<PlusIgtlClientInfo::ImageStream>::const_iterator it = clientInfo.ImageStreams.begin(); it != clientInfo.ImageStreams.end(); ++it)
+    {
+      int predictor = igtl::PlusCompressedImageMessage::PREDICTOR_NONE;
+      if (it->IsCompressionRequested()
+          && vtkPlusIgtlImageCompressor::GetPredictorFromString(it->CompressionPredictor, predictor)
+          && predictor != igtl::PlusCompressedImageMessage::PREDICTOR_NONE)
       {
-        LOG_ERROR("Client " << clientId << " GET_IMAGE failed: could not retrieve message");
-        return NULL;
+        predictingCompressors.push_back(it->Compressor);
       }
+    }
+  }
+  // Transforms that did not change since the dropped frame would not be sent again
+  vtkSmartPointer<vtkPlusIgtlMessageFactory> changedTransformsFactory;
+  if (clientInfo.GetSendChangedTransformsOnly())
+  {
+    changedTransformsFactory = this->IgtlMessageFactory;
+  }
+  if (predictingCompressors.empty() && changedTransformsFactory == NULL)
+  {
+    return std::function<void()>();
+  }
+  return [predictingCompressors, changedTransformsFactory, packingClientId]()
+  {
+    // The next frame of the stream must be decodable without the dropped one
+    for (std::vector<vtkSmartPointer<vtkPlusIgtlImageCompressor> >::const_iterator it = predictingCompressors.begin(); it != predictingCompressors.end(); ++it)
+    {
+      (*it)->RequestKeyFrame();
+    }
+    if (changedTransformsFactory != NULL)
+    {
+      changedTransformsFactory->ResetPublishedTransforms(packingClientId);
+    }
+  };
+}
 
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::UpdateClientPackingClient(int clientId, int packingClientId, const std::function<void()>& resetStreamState)
+{
+  {
+    std::lock_guard<std::mutex> packingClientIdsLock(this->ClientPackingClientIdsMutex);
+    std::map<int, int>::iterator packingClientIt = this->ClientPackingClientIds.find(clientId);
+    if (packingClientIt == this->ClientPackingClientIds.end())
+    {
+      // New clients start decoding at the next key frame
+      this->ClientPackingClientIds[clientId] = packingClientId;
+      return;
+    }
+    if (packingClientIt->second == packingClientId)
+    {
+      return;
     }
-    else if (typeid(*bodyMessage) == typeid(igtl::GetPointMessage))
+    packingClientIt->second = packingClientId;
+  }
+  if (resetStreamState)
+  {
+    LOG_DEBUG("Client " << clientId << " is sent messages packed by client " << packingClientId << ", resetting the stream state of the packing client");
+    resetStreamState();
+  }
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkServer::SendTrackedFrame(igsioTrackedFrame& trackedFrame)
+{
+  return this->SendTrackedFrameFromChannel(trackedFrame, "");
+}
+
+//----------------------------------------------------------------------------
+bool vtkPlusOpenIGTLinkServer::GetFrameClientInfo(const PlusIgtlClientInfo& clientInfo, const std::string& channelId, double timestamp, PlusIgtlClientInfo& frameClientInfo) const
+{
+  const std::string& defaultChannelId = (this->BroadcastChannels.empty() ? this->OutputChannelId : this->BroadcastChannels.front().OutputChannelId);
+  return clientInfo.GetFrameClientInfo(channelId, defaultChannelId, timestamp, frameClientInfo);
+}
+
+//----------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkServer::SendTrackedFrameFromChannel(igsioTrackedFrame& trackedFrame, const std::string& channelId)
+{
+  int numberOfErrors = 0;
+
+  // Update transform repository with the tracked frame
+  if (this->TransformRepository != NULL)
+  {
+    if (this->TransformRepository->SetTransforms(trackedFrame) != PLUS_SUCCESS)
     {
-      igtl::GetPointMessage* getPointMsg = dynamic_cast<igtl::GetPointMessage*>(bodyMessage.GetPointer());
-      getPointMsg->SetMessageHeader(headerMsg);
-      getPointMsg->AllocateBuffer();
+      LOG_ERROR("Failed to set current transforms to transform repository");
+      numberOfErrors++;
+    }
+  }
+
+  // Convert relative timestamp to UTC
+  double timestampSystem = trackedFrame.GetTimestamp(); // save original timestamp, we'll restore it later
+  double timestampUniversal = vtkIGSIOAccurateTimer::GetUniversalTimeFromSystemTime(timestampSystem);
+  trackedFrame.SetTimestamp(timestampUniversal);
+
+  // Tracking data is sent to the UDP stream first, it is not delayed by slow TCP clients
+  // The UDP stream is fed from the OutputChannelId channel only
+  if (this->UdpSender && (channelId.empty() || channelId == this->BroadcastChannels.front().OutputChannelId))
+  {
+    this->SendTrackedFrameToUdpStream(trackedFrame);
+  }
+
+  std::vector<int> disconnectedClientIds;
+  if (this->ClientSendQueueLength > 0)
+  {
+    // Each client has its own sender thread, only queue the messages
+    this->QueueTrackedFrameForClients(trackedFrame, channelId, disconnectedClientIds);
+  }
+  else
+  {
+    // Lock before we send message to the clients
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
 
-      clientSocket->Receive(getPointMsg->GetBufferBodyPointer(), getPointMsg->GetBufferBodySize());
+    // Messages are packed once per unique subscription and the same packed buffers are sent to every client
+    // of that subscription. The first (longest connected) client of a group is used for packing, therefore its
+    // video encoder state is the one that is advanced; clients joining an existing video stream start
+    // decoding at the next keyframe. If the packing client changes then its stream state is reset.
+    std::map<std::string, std::vector<igtl::MessageBase::Pointer> > packedMessagesBySubscription;
+    std::map<std::string, int> packingClientIdsBySubscription;
+    std::map<std::string, std::function<void()> > resetStreamStateCallbacksBySubscription;
 
-      int c = getPointMsg->Unpack(self->IgtlMessageCrcCheckEnabled);
-      if (c & igtl::MessageHeader::UNPACK_BODY)
+    for (std::list<ClientData>::iterator clientIterator = this->IgtlClients.begin(); clientIterator != this->IgtlClients.end(); ++clientIterator)
+    {
+      igtl::ClientSocket::Pointer clientSocket = (*clientIterator).ClientSocket;
+      double sendStartTime = vtkIGSIOAccurateTimer::GetSystemTime();
+
+      // Only send the data that the client requested from this channel and that is not skipped by a frame rate limit
+      const PlusIgtlClientInfo* clientInfo = &clientIterator->ClientInfo;
+      PlusIgtlClientInfo frameClientInfo;
+      if (!channelId.empty() || clientInfo->IsFrameRateLimited())
       {
-        std::string fileName;
-        if (!getPointMsg->GetMetaDataElement("Filename", fileName))
+        if (!this->GetFrameClientInfo(clientIterator->ClientInfo, channelId, trackedFrame.GetTimestamp(), frameClientInfo))
         {
-          fileName = getPointMsg->GetDeviceName();
+          continue;
         }
+        clientInfo = &frameClientInfo;
+      }
 
-        if (igsioCommon::Tail(fileName, 4) != "fcsv")
+      // Create IGT messages, or reuse the ones already packed for an identical subscription.
+      // The frame subset of rate limited clients is not known to the other clients, so they use their own stream state.
+      int encoderOwnerClientId = (IsFrameDependentRateLimited(clientIterator->ClientInfo) ? clientIterator->ClientId : -1);
+      std::string subscriptionKey = GetClientSubscriptionKey(*clientInfo, encoderOwnerClientId);
+      std::map<std::string, std::vector<igtl::MessageBase::Pointer> >::iterator packedMessagesIterator = packedMessagesBySubscription.find(subscriptionKey);
+      if (packedMessagesIterator == packedMessagesBySubscription.end())
+      {
+        packedMessagesIterator = packedMessagesBySubscription.insert(std::make_pair(subscriptionKey, std::vector<igtl::MessageBase::Pointer>())).first;
+        if (this->IgtlMessageFactory->PackMessages(clientIterator->ClientId, *clientInfo, packedMessagesIterator->second, trackedFrame, this->SendValidTransformsOnly, this->TransformRepository) != PLUS_SUCCESS)
         {
-          LOG_WARNING("Filename does not end in fcsv. GetPoint behaviour may not function correctly.");
+          LOG_WARNING("Failed to pack all IGT messages");
         }
+        packingClientIdsBySubscription[subscriptionKey] = clientIterator->ClientId;
+        resetStreamStateCallbacksBySubscription[subscriptionKey] = this->GetDroppedItemCallback(clientIterator->ClientId, *clientInfo);
+      }
+      this->UpdateClientPackingClient(clientIterator->ClientId, packingClientIdsBySubscription[subscriptionKey], resetStreamStateCallbacksBySubscription[subscriptionKey]);
+      const std::vector<igtl::MessageBase::Pointer>& igtlMessages = packedMessagesIterator->second;
+      std::vector<igtl::MessageBase::Pointer>::const_iterator igtlMessageIterator;
 
-        if (!vtksys::SystemTools::FileExists(fileName) &&
-            !vtksys::SystemTools::FileExists(vtkPlusConfig::GetInstance()->GetImagePath(fileName)))
+      if (this->SocketOptions.CoalesceMessages)
+      {
+        // Send all messages to a client in one write
+        int retValue = 0;
+        RETRY_UNTIL_TRUE((retValue = vtkPlusIgtlMessageCommon::SendPackedMessages(clientSocket, igtlMessages)) != 0, this->NumberOfRetryAttempts, this->DelayBetweenRetryAttemptsSec);
+        if (retValue == 0)
+        {
+          disconnectedClientIds.push_back(clientIterator->ClientId);
+          LOG_INFO("Client disconnected - could not send " << igtlMessages.size() << " messages to client " << clientIterator->ClientId << ".");
+          continue;
+        }
+        if (clientInfo->GetTDATARequested() || channelId.empty())
         {
-          LOG_ERROR("File: " << fileName << " requested but does not exist. Cannot get POINT data from it.");
-          return NULL;
+          clientIterator->ClientInfo.SetLastTDATASentTimeStamp(trackedFrame.GetTimestamp());
         }
+        unsigned long long sentBytes = 0;
+        for (igtlMessageIterator = igtlMessages.begin(); igtlMessageIterator != igtlMessages.end(); ++igtlMessageIterator)
+        {
+          sentBytes += vtkPlusIgtlMessageCommon::GetPackedMessageSize(*igtlMessageIterator);
+        }
+        double systemTime = vtkIGSIOAccurateTimer::GetSystemTime();
+        clientIterator->DirectSendStatistics.AddSentItem(sentBytes, systemTime - sendStartTime, systemTime);
+        continue;
+      }
 
-        igtl::MessageBase::Pointer msg = self->IgtlMessageFactory->CreateSendMessage("POINT", client->ClientInfo.GetClientHeaderVersion());
-        igtl::PointMessage* pointMsg = dynamic_cast<igtl::PointMessage*>(msg.GetPointer());
+      // Send all messages to a client
+      bool sendFailed = false;
+      unsigned long long sentBytes = 0;
+      this->SocketOptions.SetCorked(clientSocket, true);
+      for (igtlMessageIterator = igtlMessages.begin(); igtlMessageIterator != igtlMessages.end(); ++igtlMessageIterator)
+      {
+        igtl::MessageBase::Pointer igtlMessage = (*igtlMessageIterator);
+        if (igtlMessage.IsNull())
+        {
+          continue;
+        }
 
-        std::ifstream t(fileName);
-        if (!t.is_open())
+        int retValue = 0;
+        RETRY_UNTIL_TRUE((retValue = vtkPlusIgtlMessageCommon::SendPackedMessage(clientSocket, igtlMessage)) != 0, this->NumberOfRetryAttempts, this->DelayBetweenRetryAttemptsSec);
+        if (retValue == 0)
         {
-          t.open(vtkPlusConfig::GetInstance()->GetImagePath(fileName));
-          if (!t.is_open())
-          {
-            LOG_ERROR("Cannot read file: " << fileName);
-            return NULL;
-          }
+          disconnectedClientIds.push_back(clientIterator->ClientId);
+          igtl::TimeStamp::Pointer ts = igtl::TimeStamp::New();
+          igtlMessage->GetTimeStamp(ts);
+          LOG_INFO("Client disconnected - could not send " << igtlMessage->GetMessageType() << " message to client (device name: " << igtlMessage->GetDeviceName()
+                   << "  Timestamp: " << std::fixed << ts->GetTimeStamp() << ").");
+          sendFailed = true;
+          break;
         }
-        std::stringstream buffer;
-        buffer << t.rdbuf();
-        std::vector<std::string> lines = igsioCommon::SplitStringIntoTokens(buffer.str(), '\n', false);
-        for (std::vector<std::string>::iterator it = lines.begin(); it != lines.end(); ++it)
+        sentBytes += vtkPlusIgtlMessageCommon::GetPackedMessageSize(igtlMessage);
+
+        // Update the TDATA timestamp, even if TDATA isn't sent (cheaper than checking for existing TDATA message type),
+        // but not for frames of a channel that the client does not receive TDATA from
+        if (clientInfo->GetTDATARequested() || channelId.empty())
         {
-          std::string line = igsioCommon::Trim(*it);
-          if (line[0] == '#')
-          {
-            continue;
-          }
+          clientIterator->ClientInfo.SetLastTDATASentTimeStamp(trackedFrame.GetTimestamp());
+        }
+      }
+      this->SocketOptions.SetCorked(clientSocket, false);
+      if (!sendFailed && sentBytes > 0)
+      {
+        double systemTime = vtkIGSIOAccurateTimer::GetSystemTime();
+        clientIterator->DirectSendStatistics.AddSentItem(sentBytes, systemTime - sendStartTime, systemTime);
+      }
+    }
+  }
+
+  // Clean up disconnected clients
+  for (std::vector< int >::iterator it = disconnectedClientIds.begin(); it != disconnectedClientIds.end(); ++it)
+  {
+    DisconnectClient(*it);
+  }
+
+  // restore original timestamp
+  trackedFrame.SetTimestamp(timestampSystem);
+
+  return (numberOfErrors == 0 ? PLUS_SUCCESS : PLUS_FAIL);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::QueueTrackedFrameForClients(igsioTrackedFrame& trackedFrame, const std::string& channelId, std::vector<int>& disconnectedClientIds)
+{
+  // Copy the client list, so that it is not locked while messages are packed
+  std::vector<ClientData> clients;
+  std::vector<int> rateLimitedEncoderOwnerClientIds;
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
+    for (std::list<ClientData>::const_iterator clientIterator = this->IgtlClients.begin(); clientIterator != this->IgtlClients.end(); ++clientIterator)
+    {
+      if (channelId.empty() && !clientIterator->ClientInfo.IsFrameRateLimited())
+      {
+        clients.push_back(*clientIterator);
+        continue;
+      }
+      // Only send the data that the client requested from this channel and that is not skipped by a frame rate limit.
+      // Skipped frames are not packed for the client.
+      if (IsFrameDependentRateLimited(clientIterator->ClientInfo))
+      {
+        rateLimitedEncoderOwnerClientIds.push_back(clientIterator->ClientId);
+      }
+      PlusIgtlClientInfo frameClientInfo;
+      if (this->GetFrameClientInfo(clientIterator->ClientInfo, channelId, trackedFrame.GetTimestamp(), frameClientInfo))
+      {
+        clients.push_back(*clientIterator);
+        clients.back().ClientInfo = frameClientInfo;
+      }
+    }
+  }
+
+  std::map<std::string, std::vector<igtl::MessageBase::Pointer> > packedMessagesBySubscription;
+  std::map<std::string, int> packingClientIdsBySubscription;
+  std::map<std::string, std::function<void()> > droppedItemCallbacksBySubscription;
+  std::vector<int> tdataUpdatedClientIds;
+  double systemTimeSec = vtkIGSIOAccurateTimer::GetSystemTime();
+  for (std::vector<ClientData>::iterator clientIterator = clients.begin(); clientIterator != clients.end(); ++clientIterator)
+  {
+    if (!clientIterator->SendQueue)
+    {
+      continue;
+    }
+    ClientSendStatistics sendStatistics;
+    {
+      std::lock_guard<std::mutex> sendQueueLock(clientIterator->SendQueue->Mutex);
+      if (clientIterator->SendQueue->SendFailed)
+      {
+        disconnectedClientIds.push_back(clientIterator->ClientId);
+        continue;
+      }
+      sendStatistics = clientIterator->SendQueue->Statistics;
+    }
 
-          std::vector<std::string> tokens = igsioCommon::SplitStringIntoTokens(line, ',', true);
-          igtl::PointElement::Pointer elem = igtl::PointElement::New();
-          elem->SetPosition(std::stof(tokens[1]), std::stof(tokens[2]), std::stof(tokens[3]));
-          elem->SetName(tokens[0].c_str());
-          elem->SetGroupName("Point");
-          pointMsg->AddPointElement(elem);
+    // The frame subset of rate limited clients is not known to the other clients, so they use their own stream state
+    int encoderOwnerClientId = -1;
+    if (std::find(rateLimitedEncoderOwnerClientIds.begin(), rateLimitedEncoderOwnerClientIds.end(), clientIterator->ClientId) != rateLimitedEncoderOwnerClientIds.end())
+    {
+      encoderOwnerClientId = clientIterator->ClientId;
+    }
+    if (clientIterator->VideoRateController)
+    {
+      // Adapt the copied client info only, the adapted encoding becomes part of the subscription key
+      clientIterator->VideoRateController->Update(clientIterator->ClientInfo, sendStatistics, systemTimeSec);
+      if (clientIterator->VideoRateController->AcceptFrame())
+      {
+        clientIterator->VideoRateController->ApplyToClientInfo(clientIterator->ClientInfo);
+        if (clientIterator->VideoRateController->GetFrameDecimation() > 1 && IsVideoRequested(clientIterator->ClientInfo))
+        {
+          // Decimated video frames are predicted from the previously sent decimated frame, so use the client's own encoders
+          encoderOwnerClientId = clientIterator->ClientId;
         }
+      }
+      else
+      {
+        std::vector<std::string>& messageTypes = clientIterator->ClientInfo.IgtlMessageTypes;
+        messageTypes.erase(std::remove(messageTypes.begin(), messageTypes.end(), std::string("VIDEO")), messageTypes.end());
+      }
+    }
+
+    std::string subscriptionKey = GetClientSubscriptionKey(clientIterator->ClientInfo, encoderOwnerClientId);
+    std::map<std::string, std::vector<igtl::MessageBase::Pointer> >::iterator packedMessagesIterator = packedMessagesBySubscription.find(subscriptionKey);
+    if (packedMessagesIterator == packedMessagesBySubscription.end())
+    {
+      packedMessagesIterator = packedMessagesBySubscription.insert(std::make_pair(subscriptionKey, std::vector<igtl::MessageBase::Pointer>())).first;
+      if (this->IgtlMessageFactory->PackMessages(clientIterator->ClientId, clientIterator->ClientInfo, packedMessagesIterator->second, trackedFrame, this->SendValidTransformsOnly, this->TransformRepository) != PLUS_SUCCESS)
+      {
+        LOG_WARNING("Failed to pack all IGT messages");
+      }
+      // The dropped item callback refers to the encoder and published transform state that was used for packing
+      packingClientIdsBySubscription[subscriptionKey] = clientIterator->ClientId;
+      droppedItemCallbacksBySubscription[subscriptionKey] = this->GetDroppedItemCallback(clientIterator->ClientId, clientIterator->ClientInfo);
+    }
+    if (packedMessagesIterator->second.empty())
+    {
+      continue;
+    }
+    this->UpdateClientPackingClient(clientIterator->ClientId, packingClientIdsBySubscription[subscriptionKey], droppedItemCallbacksBySubscription[subscriptionKey]);
 
-        self->QueueMessageResponseForClient(client->ClientId, pointMsg);
+    const std::vector<igtl::MessageBase::Pointer>* messagesToQueue = &packedMessagesIterator->second;
+    std::vector<igtl::MessageBase::Pointer> notificationMessages;
+    if (clientIterator->SharedMemoryRing)
+    {
+      uint64_t sequence = clientIterator->SharedMemoryRing->WriteItem(packedMessagesIterator->second);
+      if (sequence > 0)
+      {
+        notificationMessages.push_back(this->CreateSharedMemoryNotification(clientIterator->SharedMemoryRing.get(), sequence, clientIterator->ClientInfo.GetClientHeaderVersion()));
+        messagesToQueue = &notificationMessages;
       }
       else
       {
-        LOG_ERROR("Client " << clientId << " GET_POINT failed: could not retrieve message");
-        return NULL;
+        LOG_DEBUG("Tracked frame messages do not fit in a shared memory slot of client " << clientIterator->ClientId << ", sending them on the socket");
       }
     }
-    else
+
+    if (!PushToClientSendQueue(*clientIterator->SendQueue, *messagesToQueue, true, droppedItemCallbacksBySubscription[subscriptionKey]))
     {
-      // if the device type is unknown, skip reading.
-      LOG_WARNING("Unknown OpenIGTLink message is received from client " << clientId << ". Device type: " << headerMsg->GetMessageType()
-                  << ". Device name: " << headerMsg->GetDeviceName() << ".");
-      clientSocket->Skip(headerMsg->GetBodySizeToRead(), 0);
+      disconnectedClientIds.push_back(clientIterator->ClientId);
       continue;
     }
-  } // ConnectionActive
-
-  // Close thread
-  client->DataReceiverThreadId = -1;
-  client->DataReceiverActive.second = false;
-  return NULL;
-}
-
-//----------------------------------------------------------------------------
-PlusStatus vtkPlusOpenIGTLinkServer::SendTrackedFrame(igsioTrackedFrame& trackedFrame)
-{
-  int numberOfErrors = 0;
-
-  // Update transform repository with the tracked frame
-  if (this->TransformRepository != NULL)
-  {
-    if (this->TransformRepository->SetTransforms(trackedFrame) != PLUS_SUCCESS)
+    if (clientIterator->ClientInfo.GetTDATARequested() || channelId.empty())
     {
-      LOG_ERROR("Failed to set current transforms to transform repository");
-      numberOfErrors++;
+      tdataUpdatedClientIds.push_back(clientIterator->ClientId);
     }
   }
 
-  // Convert relative timestamp to UTC
-  double timestampSystem = trackedFrame.GetTimestamp(); // save original timestamp, we'll restore it later
-  double timestampUniversal = vtkIGSIOAccurateTimer::GetUniversalTimeFromSystemTime(timestampSystem);
-  trackedFrame.SetTimestamp(timestampUniversal);
-
-  std::vector<int> disconnectedClientIds;
+  // Update the TDATA timestamp, even if TDATA isn't sent (cheaper than checking for existing TDATA message type)
+  if (!tdataUpdatedClientIds.empty())
   {
-    // Lock before we send message to the clients
     igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
     for (std::list<ClientData>::iterator clientIterator = this->IgtlClients.begin(); clientIterator != this->IgtlClients.end(); ++clientIterator)
     {
-      igtl::ClientSocket::Pointer clientSocket = (*clientIterator).ClientSocket;
-
-      // Create IGT messages
-      std::vector<igtl::MessageBase::Pointer> igtlMessages;
-      std::vector<igtl::MessageBase::Pointer>::iterator igtlMessageIterator;
-
-      if (this->IgtlMessageFactory->PackMessages(clientIterator->ClientId, clientIterator->ClientInfo, igtlMessages, trackedFrame, this->SendValidTransformsOnly, this->TransformRepository) != PLUS_SUCCESS)
-      {
-        LOG_WARNING("Failed to pack all IGT messages");
-      }
-
-      // Send all messages to a client
-      for (igtlMessageIterator = igtlMessages.begin(); igtlMessageIterator != igtlMessages.end(); ++igtlMessageIterator)
+      if (std::find(tdataUpdatedClientIds.begin(), tdataUpdatedClientIds.end(), clientIterator->ClientId) != tdataUpdatedClientIds.end())
       {
-        igtl::MessageBase::Pointer igtlMessage = (*igtlMessageIterator);
-        if (igtlMessage.IsNull())
-        {
-          continue;
-        }
-
-        int retValue = 0;
-        RETRY_UNTIL_TRUE((retValue = clientSocket->Send(igtlMessage->GetBufferPointer(), igtlMessage->GetBufferSize())) != 0, this->NumberOfRetryAttempts, this->DelayBetweenRetryAttemptsSec);
-        if (retValue == 0)
-        {
-          disconnectedClientIds.push_back(clientIterator->ClientId);
-          igtl::TimeStamp::Pointer ts = igtl::TimeStamp::New();
-          igtlMessage->GetTimeStamp(ts);
-          LOG_INFO("Client disconnected - could not send " << igtlMessage->GetMessageType() << " message to client (device name: " << igtlMessage->GetDeviceName()
-                   << "  Timestamp: " << std::fixed << ts->GetTimeStamp() << ").");
-          break;
-        }
-
-        // Update the TDATA timestamp, even if TDATA isn't sent (cheaper than checking for existing TDATA message type)
         clientIterator->ClientInfo.SetLastTDATASentTimeStamp(trackedFrame.GetTimestamp());
       }
     }
   }
-
-  // Clean up disconnected clients
-  for (std::vector< int >::iterator it = disconnectedClientIds.begin(); it != disconnectedClientIds.end(); ++it)
-  {
-    DisconnectClient(*it);
-  }
-
-  // restore original timestamp
-  trackedFrame.SetTimestamp(timestampSystem);
-
-  return (numberOfErrors == 0 ? PLUS_SUCCESS : PLUS_FAIL);
 }
 
 //----------------------------------------------------------------------------
 void vtkPlusOpenIGTLinkServer::DisconnectClient(int clientId)
 {
+#if defined(__linux__)
+  if (this->EpollReactor != NULL && this->EpollReactor->IsRunning())
+  {
+    // The connection is owned by the event loop, it closes the socket and removes the client
+    this->EpollReactor->CloseClient(clientId);
+    return;
+  }
+#endif
+
   // Stop the client's data receiver thread
   {
     // Request thread stop
@@ -1072,6 +1905,11 @@ void vtkPlusOpenIGTLinkServer::DisconnectClient(int clientId)
         continue;
       }
       clientIterator->DataReceiverActive.first = false;
+      clientIterator->DataSenderActive.first = false;
+      if (clientIterator->SendQueue)
+      {
+        clientIterator->SendQueue->ItemAvailable.notify_all();
+      }
       break;
     }
   }
@@ -1090,6 +1928,19 @@ void vtkPlusOpenIGTLinkServer::DisconnectClient(int clientId)
         {
           continue;
         }
+        if (clientIterator->DataSenderThreadId > 0)
+        {
+          if (clientIterator->DataSenderActive.second)
+          {
+            // thread still running
+            clientDataReceiverThreadStillActive = true;
+          }
+          else
+          {
+            // thread stopped
+            clientIterator->DataSenderThreadId = -1;
+          }
+        }
         if (clientIterator->DataReceiverThreadId > 0)
         {
           if (clientIterator->DataReceiverActive.second)
@@ -1114,6 +1965,12 @@ void vtkPlusOpenIGTLinkServer::DisconnectClient(int clientId)
   }
   while (clientDataReceiverThreadStillActive);
 
+  this->RemoveClient(clientId);
+}
+
+//----------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::RemoveClient(int clientId)
+{
   // Close socket and remove client from the list
   int port = 0;
   std::string address = "unknown";
@@ -1132,10 +1989,22 @@ void vtkPlusOpenIGTLinkServer::DisconnectClient(int clientId)
 #endif
         clientIterator->ClientSocket->CloseSocket();
       }
+      if (clientIterator->SendQueue)
+      {
+        std::lock_guard<std::mutex> sendQueueLock(clientIterator->SendQueue->Mutex);
+        const ClientSendStatistics& stats = clientIterator->SendQueue->Statistics;
+        LOG_DEBUG("Client " << clientId << " send statistics: queued " << stats.NumberOfQueuedItems << ", sent " << stats.NumberOfSentItems
+                  << ", dropped " << stats.NumberOfDroppedItems << ", max queue length " << stats.MaxQueueLength << ", max lag " << stats.MaxSendLagSec << "s");
+      }
       this->IgtlClients.erase(clientIterator);
       break;
     }
   }
+  this->IgtlMessageFactory->ResetPublishedTransforms(clientId);
+  {
+    std::lock_guard<std::mutex> packingClientIdsLock(this->ClientPackingClientIdsMutex);
+    this->ClientPackingClientIds.erase(clientId);
+  }
 
   LOG_INFO("Client disconnected (" <<  address << ":" << port << "). Number of connected clients: " << GetNumberOfConnectedClients());
 }
@@ -1157,6 +2026,16 @@ void vtkPlusOpenIGTLinkServer::KeepAlive()
       replyMsg->SetCode(igtl::StatusMessage::STATUS_OK);
       replyMsg->Pack();
 
+      if (clientIterator->SendQueue)
+      {
+        // Queuing does not block, so it is done while the client list is locked
+        if (!PushToClientSendQueue(*clientIterator->SendQueue, std::vector<igtl::MessageBase::Pointer>(1, replyMsg.GetPointer()), false))
+        {
+          disconnectedClientIds.push_back(clientIterator->ClientId);
+        }
+        continue;
+      }
+
       int retValue = 0;
       RETRY_UNTIL_TRUE(
         (retValue = clientIterator->ClientSocket->Send(replyMsg->GetPackPointer(), replyMsg->GetPackSize())) != 0,
@@ -1188,6 +2067,23 @@ unsigned int vtkPlusOpenIGTLinkServer::GetNumberOfConnectedClients() const
   return this->IgtlClients.size();
 }
 
+//------------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::GetConnectedClientIds(std::vector<unsigned int>& clientIds) const
+{
+  clientIds.clear();
+  igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
+  for (std::list<ClientData>::const_iterator it = this->IgtlClients.begin(); it != this->IgtlClients.end(); ++it)
+  {
+    clientIds.push_back(it->ClientId);
+  }
+}
+
+//------------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::GetMessagePackStatistics(std::map<std::string, vtkPlusIgtlMessageFactory::MessagePackStatistics>& statistics) const
+{
+  this->IgtlMessageFactory->GetMessagePackStatistics(statistics);
+}
+
 //------------------------------------------------------------------------------
 PlusStatus vtkPlusOpenIGTLinkServer::GetClientInfo(unsigned int clientId, PlusIgtlClientInfo& outClientInfo) const
 {
@@ -1204,6 +2100,184 @@ PlusStatus vtkPlusOpenIGTLinkServer::GetClientInfo(unsigned int clientId, PlusIg
   return PLUS_FAIL;
 }
 
+//------------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkServer::GetClientSendStatistics(unsigned int clientId, ClientSendStatistics& outStatistics) const
+{
+  std::shared_ptr<ClientSendQueue> sendQueue;
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
+    std::list<ClientData>::const_iterator it = this->IgtlClients.begin();
+    for (; it != this->IgtlClients.end(); ++it)
+    {
+      if (it->ClientId == clientId)
+      {
+        break;
+      }
+    }
+    if (it == this->IgtlClients.end())
+    {
+      return PLUS_FAIL;
+    }
+    sendQueue = it->SendQueue;
+    if (!sendQueue)
+    {
+      outStatistics = it->DirectSendStatistics;
+    }
+  }
+  if (sendQueue)
+  {
+    std::lock_guard<std::mutex> sendQueueLock(sendQueue->Mutex);
+    outStatistics = sendQueue->Statistics;
+  }
+
+  // Rates are only updated when items are sent, do not report a stale rate for an idle client
+  if (vtkIGSIOAccurateTimer::GetSystemTime() - outStatistics.RateWindowStartTime > 2.0)
+  {
+    outStatistics.SentItemsPerSec = 0.0;
+    outStatistics.SentBytesPerSec = 0.0;
+  }
+  return PLUS_SUCCESS;
+}
+
+//------------------------------------------------------------------------------
+PlusStatus vtkPlusOpenIGTLinkServer::GetClientVideoRateStatus(unsigned int clientId, ClientVideoRateStatus& outStatus) const
+{
+  std::shared_ptr<PlusIgtlVideoRateController> videoRateController;
+  {
+    igsioLockGuard<vtkIGSIORecursiveCriticalSection> igtlClientsMutexGuardedLock(this->IgtlClientsMutex);
+    for (std::list<ClientData>::const_iterator it = this->IgtlClients.begin(); it != this->IgtlClients.end(); ++it)
+    {
+      if (it->ClientId == clientId)
+      {
+        videoRateController = it->VideoRateController;
+        break;
+      }
+    }
+  }
+  if (!videoRateController)
+  {
+    return PLUS_FAIL;
+  }
+
+  outStatus = videoRateController->GetStatus();
+  return PLUS_SUCCESS;
+}
+
+//------------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::UpdateSharedMemoryTransport(ClientData& client)
+{
+  if (!client.ClientInfo.GetSharedMemoryTransport())
+  {
+    if (client.SharedMemoryRing)
+    {
+      LOG_INFO("Shared memory transport of client " << client.ClientId << " is stopped");
+      client.SharedMemoryRing.reset();
+      PushToClientSendQueue(*client.SendQueue, std::vector<igtl::MessageBase::Pointer>(1, this->CreateSharedMemoryNotification(NULL, 0, client.ClientInfo.GetClientHeaderVersion())), false);
+    }
+    return;
+  }
+  if (client.SharedMemoryRing)
+  {
+    // Already active
+    return;
+  }
+  if (!this->SharedMemoryTransport || !client.SendQueue)
+  {
+    LOG_WARNING("Client " << client.ClientId << " requested shared memory transport, but it is not enabled on the server. Data is sent on the socket.");
+    return;
+  }
+  if (!IsLoopbackAddress(client.ClientAddress))
+  {
+    LOG_WARNING("Client " << client.ClientId << " requested shared memory transport, but it is not connected from the local host (" << client.ClientAddress << "). Data is sent on the socket.");
+    return;
+  }
+  if (!PlusIgtlSharedMemoryRing::IsSupported())
+  {
+    LOG_WARNING("Client " << client.ClientId << " requested shared memory transport, but it is not supported on this platform. Data is sent on the socket.");
+    return;
+  }
+
+  std::ostringstream namePrefix;
+  namePrefix << "PlusServer_" << this->ListeningPort << "_" << client.ClientId;
+  std::shared_ptr<PlusIgtlSharedMemoryRing> ring = std::make_shared<PlusIgtlSharedMemoryRing>();
+  if (ring->Create(PlusIgtlSharedMemoryRing::GetUniqueName(namePrefix.str()), this->SharedMemoryNumberOfSlots, this->SharedMemorySlotSizeBytes) != PLUS_SUCCESS)
+  {
+    LOG_WARNING("Failed to create shared memory ring for client " << client.ClientId << ". Data is sent on the socket.");
+    return;
+  }
+  client.SharedMemoryRing = ring;
+  LOG_INFO("Shared memory transport of client " << client.ClientId << " is started (ring " << ring->GetName() << ")");
+
+  // Announce the ring before the first notification
+  PushToClientSendQueue(*client.SendQueue, std::vector<igtl::MessageBase::Pointer>(1, this->CreateSharedMemoryNotification(ring.get(), 0, client.ClientInfo.GetClientHeaderVersion())), false);
+}
+
+//------------------------------------------------------------------------------
+igtl::MessageBase::Pointer vtkPlusOpenIGTLinkServer::CreateSharedMemoryNotification(const PlusIgtlSharedMemoryRing* ring, uint64_t sequence, int headerVersion)
+{
+  igtl::PlusSharedMemoryNotificationMessage::Pointer notificationMsg = dynamic_cast<igtl::PlusSharedMemoryNotificationMessage*>(this->IgtlMessageFactory->CreateSendMessage("SHMNOTIFY", headerVersion).GetPointer());
+  notificationMsg->SetSequence(sequence);
+  if (ring != NULL)
+  {
+    notificationMsg->SetRingName(ring->GetName());
+    notificationMsg->SetNumberOfSlots(ring->GetNumberOfSlots());
+    notificationMsg->SetSlotSize(ring->GetSlotSize());
+  }
+  notificationMsg->Pack();
+  return notificationMsg.GetPointer();
+}
+
+//------------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::OpenUdpStream()
+{
+  this->UdpSender.reset();
+  if (this->UdpStreamPort <= 0)
+  {
+    return;
+  }
+  std::shared_ptr<PlusIgtlUdpSender> udpSender = std::make_shared<PlusIgtlUdpSender>();
+  if (udpSender->Open(this->UdpStreamAddress, this->UdpStreamPort, this->UdpStreamTimeToLive, this->UdpStreamInterfaceAddress) != PLUS_SUCCESS)
+  {
+    LOG_ERROR("Failed to open UDP stream to " << this->UdpStreamAddress << ":" << this->UdpStreamPort << ". Tracking data is sent to TCP clients only.");
+    return;
+  }
+  udpSender->SetMaxDatagramSize(static_cast<unsigned int>(this->UdpStreamMaxDatagramSize));
+  this->UdpSender = udpSender;
+  LOG_INFO("Sending tracking data to " << (udpSender->IsMulticast() ? "UDP multicast group " : "UDP address ") << this->UdpStreamAddress << ":" << this->UdpStreamPort);
+}
+
+//------------------------------------------------------------------------------
+void vtkPlusOpenIGTLinkServer::SendTrackedFrameToUdpStream(igsioTrackedFrame& trackedFrame)
+{
+  std::vector<igtl::MessageBase::Pointer> udpMessages;
+  if (this->IgtlMessageFactory->PackMessages(UDP_STREAM_CLIENT_ID, this->UdpStreamClientInfo, udpMessages, trackedFrame, this->SendValidTransformsOnly, this->TransformRepository) != PLUS_SUCCESS)
+  {
+    LOG_WARNING("Failed to pack all IGT messages for the UDP stream");
+  }
+  for (std::vector<igtl::MessageBase::Pointer>::iterator messageIt = udpMessages.begin(); messageIt != udpMessages.end(); ++messageIt)
+  {
+    if ((*messageIt).IsNotNull())
+    {
+      this->UdpSender->Send(*messageIt);
+    }
+  }
+  this->UdpStreamClientInfo.SetLastTDATASentTimeStamp(trackedFrame.GetTimestamp());
+}
+
+//------------------------------------------------------------------------------
+std::shared_ptr<PlusIgtlVideoRateController> vtkPlusOpenIGTLinkServer::CreateVideoRateController() const
+{
+  if (!this->AdaptiveVideoRate)
+  {
+    return std::shared_ptr<PlusIgtlVideoRateController>();
+  }
+  std::shared_ptr<PlusIgtlVideoRateController> videoRateController = std::make_shared<PlusIgtlVideoRateController>();
+  videoRateController->SetMaxSendLagSec(this->AdaptiveVideoMaxSendLagSec);
+  videoRateController->SetMaxFrameDecimation(this->AdaptiveVideoMaxFrameDecimation);
+  videoRateController->SetMinBitrate(this->AdaptiveVideoMinBitrate);
+  return videoRateController;
+}
+
 //------------------------------------------------------------------------------
 PlusStatus vtkPlusOpenIGTLinkServer::ReadConfiguration(vtkXMLDataElement* serverElement, const std::string& aFilename)
 {
@@ -1220,6 +2294,26 @@ PlusStatus vtkPlusOpenIGTLinkServer::ReadConfiguration(vtkXMLDataElement* server
   XML_READ_STRING_ATTRIBUTE_REQUIRED(OutputChannelId, serverElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, MissingInputGracePeriodSec, serverElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, MaxTimeSpentWithProcessingMs, serverElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, SendIntervalSec, serverElement);
+
+  this->AdditionalBroadcastChannels.clear();
+  for (int i = 0; i < serverElement->GetNumberOfNestedElements(); ++i)
+  {
+    vtkXMLDataElement* channelElement = serverElement->GetNestedElement(i);
+    if (channelElement == NULL || STRCASECMP(channelElement->GetName(), "BroadcastChannel") != 0)
+    {
+      continue;
+    }
+    BroadcastChannelInfo channelInfo;
+    XML_READ_STRING_ATTRIBUTE_NONMEMBER_OPTIONAL(OutputChannelId, channelInfo.OutputChannelId, channelElement);
+    XML_READ_SCALAR_ATTRIBUTE_NONMEMBER_OPTIONAL(double, SendIntervalSec, channelInfo.SendIntervalSec, channelElement);
+    if (channelInfo.OutputChannelId.empty())
+    {
+      LOG_WARNING("OutputChannelId attribute of BroadcastChannel element #" << i << " is missing. This element will be ignored.");
+      continue;
+    }
+    this->AdditionalBroadcastChannels.push_back(channelInfo);
+  }
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, MaxNumberOfIgtlMessagesToSend, serverElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfRetryAttempts, serverElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, DelayBetweenRetryAttemptsSec, serverElement);
@@ -1248,6 +2342,109 @@ PlusStatus vtkPlusOpenIGTLinkServer::ReadConfiguration(vtkXMLDataElement* server
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(float, DefaultClientSendTimeoutSec, serverElement);
   XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(float, DefaultClientReceiveTimeoutSec, serverElement);
 
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, ClientSendQueueLength, serverElement);
+  XML_READ_ENUM3_ATTRIBUTE_OPTIONAL(ClientSendQueueDropPolicy, serverElement,
+                                    "DROP_OLDEST", ClientSendQueue::DROP_OLDEST,
+                                    "DROP_NEWEST", ClientSendQueue::DROP_NEWEST,
+                                    "DISCONNECT", ClientSendQueue::DISCONNECT);
+
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(ScatterGatherImageMessages, serverElement);
+
+  this->SocketOptions = PlusIgtlSocketOptions();
+  if (this->SocketOptions.ReadConfiguration(serverElement) != PLUS_SUCCESS)
+  {
+    return PLUS_FAIL;
+  }
+
+  XML_READ_ENUM2_ATTRIBUTE_OPTIONAL(NetworkBackend, serverElement,
+                                    "THREADS", NETWORK_BACKEND_THREADS,
+                                    "EPOLL", NETWORK_BACKEND_EPOLL);
+  if (this->NetworkBackend == NETWORK_BACKEND_EPOLL)
+  {
+#if defined(__linux__)
+    if (this->ClientSendQueueLength <= 0)
+    {
+      // The epoll network core sends all data through the clients' send queues
+      this->ClientSendQueueLength = DEFAULT_EPOLL_CLIENT_SEND_QUEUE_LENGTH;
+    }
+#else
+    LOG_WARNING("NetworkBackend=\"EPOLL\" is only available on Linux. Using THREADS instead.");
+    this->NetworkBackend = NETWORK_BACKEND_THREADS;
+#endif
+  }
+
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(AdaptiveVideoRate, serverElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(double, AdaptiveVideoMaxSendLagSec, serverElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, AdaptiveVideoMaxFrameDecimation, serverElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, AdaptiveVideoMinBitrate, serverElement);
+  if (this->AdaptiveVideoRate && this->ClientSendQueueLength <= 0)
+  {
+    // Throughput and latency are measured on the send queues
+    LOG_WARNING("AdaptiveVideoRate requires ClientSendQueueLength to be set to a positive value. Adaptive video rate is disabled.");
+    this->AdaptiveVideoRate = false;
+  }
+
+  XML_READ_BOOL_ATTRIBUTE_OPTIONAL(SharedMemoryTransport, serverElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, SharedMemoryNumberOfSlots, serverElement);
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, SharedMemorySlotSizeBytes, serverElement);
+  if (this->SharedMemoryTransport && this->ClientSendQueueLength <= 0)
+  {
+    // Notifications are sent through the send queues
+    LOG_WARNING("SharedMemoryTransport requires ClientSendQueueLength to be set to a positive value. Shared memory transport is disabled.");
+    this->SharedMemoryTransport = false;
+  }
+  if (this->SharedMemoryTransport && (this->SharedMemoryNumberOfSlots <= 0 || this->SharedMemorySlotSizeBytes <= 0))
+  {
+    LOG_WARNING("SharedMemoryNumberOfSlots and SharedMemorySlotSizeBytes must be positive. Shared memory transport is disabled.");
+    this->SharedMemoryTransport = false;
+  }
+
+  XML_READ_SCALAR_ATTRIBUTE_OPTIONAL(int, NumberOfCommandExecutionThreads, serverElement);
+
+  this->UdpStreamPort = -1;
+  vtkXMLDataElement* udpStreamElement = serverElement->FindNestedElementWithName("UdpStream");
+  if (udpStreamElement != NULL)
+  {
+    int udpStreamPort(-1);
+    if (udpStreamElement->GetAttribute("Address") == NULL || !udpStreamElement->GetScalarAttribute("Port", udpStreamPort))
+    {
+      LOG_ERROR("Unable to find required Address or Port attribute in UdpStream element");
+      return PLUS_FAIL;
+    }
+    this->UdpStreamAddress = udpStreamElement->GetAttribute("Address");
+    this->UdpStreamPort = udpStreamPort;
+    udpStreamElement->GetScalarAttribute("TimeToLive", this->UdpStreamTimeToLive);
+    if (udpStreamElement->GetAttribute("InterfaceAddress") != NULL)
+    {
+      this->UdpStreamInterfaceAddress = udpStreamElement->GetAttribute("InterfaceAddress");
+    }
+    udpStreamElement->GetScalarAttribute("MaxDatagramSize", this->UdpStreamMaxDatagramSize);
+
+    this->UdpStreamClientInfo = PlusIgtlClientInfo();
+    if (this->UdpStreamClientInfo.SetClientInfoFromXmlData(udpStreamElement) != PLUS_SUCCESS)
+    {
+      return PLUS_FAIL;
+    }
+    // Only small, self-contained messages are suitable for unreliable delivery
+    std::vector<std::string>& messageTypes = this->UdpStreamClientInfo.IgtlMessageTypes;
+    for (std::vector<std::string>::iterator messageTypeIt = messageTypes.begin(); messageTypeIt != messageTypes.end();)
+    {
+      if (*messageTypeIt != "TRANSFORM" && *messageTypeIt != "POSITION" && *messageTypeIt != "TDATA")
+      {
+        LOG_WARNING("Message type " << *messageTypeIt << " cannot be sent to the UDP stream. Only TRANSFORM, POSITION and TDATA messages are supported.");
+        messageTypeIt = messageTypes.erase(messageTypeIt);
+        continue;
+      }
+      ++messageTypeIt;
+    }
+    if (std::find(messageTypes.begin(), messageTypes.end(), std::string("TDATA")) != messageTypes.end())
+    {
+      this->UdpStreamClientInfo.SetTDATARequested(true);
+    }
+    // Sequence numbers are sent in the message ID field of the extended header
+    this->UdpStreamClientInfo.SetClientHeaderVersion(IGTL_HEADER_VERSION_2);
+  }
+
   return PLUS_SUCCESS;
 }
 
@@ -10,6 +10,7 @@
 // Local includes
 #include "vtkPlusServerExport.h"
 #include "PlusIgtlClientInfo.h"
+#include "PlusIgtlSocketOptions.h"
 #include "vtkPlusDataCollector.h"
 #include "vtkPlusIgtlMessageFactory.h"
 #include "vtkIGSIOTransformRepository.h"
@@ -20,7 +21,12 @@
 #include <vtkSmartPointer.h>
 
 // STL includes
+#include <algorithm>
+#include <condition_variable>
 #include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
 
 // OS includes
 #if (_MSC_VER == 1500)
@@ -29,6 +35,7 @@
 
 // IGTL includes
 #include <igtlMessageBase.h>
+#include <igtlMessageHeader.h>
 #include <igtlServerSocket.h>
 
 //class igsioTrackedFrame; 
@@ -39,6 +46,169 @@ class vtkPlusCommandProcessor;
 class vtkPlusCommandResponse;
 class vtkIGSIORecursiveCriticalSection;
 //class vtkIGSIOTransformRepository;
+class PlusIgtlEpollReactor;
+class PlusIgtlVideoRateController;
+class PlusIgtlSharedMemoryRing;
+class PlusIgtlUdpSender;
+
+/*! Counters describing how well a client keeps up with the data that the server sends to it */
+struct ClientSendStatistics
+{
+  ClientSendStatistics()
+    : QueueLength(0)
+    , MaxQueueLength(0)
+    , NumberOfQueuedItems(0)
+    , NumberOfSentItems(0)
+    , NumberOfDroppedItems(0)
+    , NumberOfSentBytes(0)
+    , LastSendLagSec(0.0)
+    , MaxSendLagSec(0.0)
+    , SentItemsPerSec(0.0)
+    , SentBytesPerSec(0.0)
+    , RateWindowStartTime(0.0)
+    , RateWindowSentItems(0)
+    , RateWindowSentBytes(0)
+  {
+  }
+
+  /*! Count an item that is completely sent. The send rates are updated once per second. */
+  void AddSentItem(unsigned long long sentBytes, double sendLagSec, double systemTime)
+  {
+    const double rateWindowSec = 1.0;
+    this->NumberOfSentItems++;
+    this->NumberOfSentBytes += sentBytes;
+    this->LastSendLagSec = sendLagSec;
+    this->MaxSendLagSec = std::max(this->MaxSendLagSec, sendLagSec);
+    if (this->RateWindowStartTime <= 0.0)
+    {
+      this->RateWindowStartTime = systemTime;
+    }
+    this->RateWindowSentItems++;
+    this->RateWindowSentBytes += sentBytes;
+    double elapsedTimeSec = systemTime - this->RateWindowStartTime;
+    if (elapsedTimeSec >= rateWindowSec)
+    {
+      this->SentItemsPerSec = this->RateWindowSentItems / elapsedTimeSec;
+      this->SentBytesPerSec = this->RateWindowSentBytes / elapsedTimeSec;
+      this->RateWindowStartTime = systemTime;
+      this->RateWindowSentItems = 0;
+      this->RateWindowSentBytes = 0;
+    }
+  }
+
+  /*! Number of items currently waiting in the send queue */
+  unsigned int QueueLength;
+  /*! Largest number of items that were waiting in the send queue at the same time */
+  unsigned int MaxQueueLength;
+  /*! Total number of items added to the send queue */
+  unsigned long NumberOfQueuedItems;
+  /*! Total number of items completely sent to the client */
+  unsigned long NumberOfSentItems;
+  /*! Total number of items dropped because the send queue was full */
+  unsigned long NumberOfDroppedItems;
+  /*! Total size of the messages completely sent to the client */
+  unsigned long long NumberOfSentBytes;
+  /*! Time elapsed between queuing and completing the sending of the most recent item */
+  double LastSendLagSec;
+  /*! Largest time elapsed between queuing and completing the sending of an item */
+  double MaxSendLagSec;
+  /*! Number of items sent per second, measured over about one second */
+  double SentItemsPerSec;
+  /*! Number of bytes sent per second, measured over about one second */
+  double SentBytesPerSec;
+  /*! Start of the current rate measurement interval (system time) and the items sent since then */
+  double RateWindowStartTime;
+  unsigned long RateWindowSentItems;
+  unsigned long long RateWindowSentBytes;
+};
+
+/*! Current state of the adaptive encoding of a client's VIDEO streams (see PlusIgtlVideoRateController) */
+struct ClientVideoRateStatus
+{
+  ClientVideoRateStatus()
+    : TargetBitrate(-1)
+    , KeyFrameDistance(0)
+    , FrameDecimation(1)
+    , AchievedBitrate(0.0)
+    , AchievedFrameRate(0.0)
+    , SendLagSec(0.0)
+    , Congested(false)
+    , NumberOfAdjustments(0)
+  {
+  }
+
+  /*! Encoder target bitrate (bit/s) of the lossy video streams. Negative if the encoder default is used. */
+  int TargetBitrate;
+  /*! Maximum number of frames between key frames of the lossy video streams */
+  int KeyFrameDistance;
+  /*! Only every FrameDecimation-th frame is sent */
+  int FrameDecimation;
+  /*! Data rate sent to the client in the last measurement interval (bit/s), including all message types */
+  double AchievedBitrate;
+  /*! Number of tracked frames sent to the client per second in the last measurement interval */
+  double AchievedFrameRate;
+  /*! Time elapsed between queuing and sending the most recent tracked frame */
+  double SendLagSec;
+  /*! True if the client could not keep up in the last measurement interval */
+  bool Congested;
+  /*! Number of changes made to the encoding since the client connected */
+  unsigned long NumberOfAdjustments;
+};
+
+/*!
+  Bounded queue of packed messages that are waiting to be sent to a client by the client's own sender thread.
+  One item contains all the messages packed from one tracked frame (or one reply), items are sent in order.
+*/
+struct ClientSendQueue
+{
+  /*! What to do with a new tracked frame if the queue is full */
+  enum DropPolicyType
+  {
+    DROP_OLDEST, ///< Remove the oldest queued tracked frame to make room for the new one
+    DROP_NEWEST, ///< Discard the new tracked frame
+    DISCONNECT   ///< Disconnect the client
+  };
+
+  struct Item
+  {
+    Item()
+      : QueuedTime(0.0)
+      , Droppable(true)
+    {
+    }
+    /*! Packed messages. They may be shared with other clients' queues, therefore they must not be modified. */
+    std::vector<igtl::MessageBase::Pointer> Messages;
+    /*! System time when the item was added to the queue */
+    double QueuedTime;
+    /*! Tracked frame data can be dropped if the client cannot keep up, replies and keep-alive messages cannot */
+    bool Droppable;
+    /*! Called if the item is dropped because the queue is full, so that the streams that depend on the dropped data can recover */
+    std::function<void()> DroppedCallback;
+  };
+
+  ClientSendQueue()
+    : MaxLength(1)
+    , DropPolicy(DROP_OLDEST)
+    , SendFailed(false)
+  {
+  }
+
+  std::mutex Mutex;
+  std::condition_variable ItemAvailable;
+  std::deque<Item> Items;
+
+  /*! Maximum number of droppable items in the queue */
+  unsigned int MaxLength;
+  DropPolicyType DropPolicy;
+
+  /*! Set if the client cannot be reached anymore. The client is then disconnected by the server's data sender thread. */
+  bool SendFailed;
+
+  /*! Called after an item is added, if the queue is not drained by a dedicated sender thread */
+  std::function<void()> ItemAddedCallback;
+
+  ClientSendStatistics Statistics;
+};
 
 struct ClientData
 {
@@ -47,6 +217,8 @@ struct ClientData
     , ClientSocket(NULL)
     , DataReceiverActive(std::make_pair(false, false))
     , DataReceiverThreadId(-1)
+    , DataSenderActive(std::make_pair(false, false))
+    , DataSenderThreadId(-1)
     , Server(NULL)
   {
   }
@@ -54,6 +226,9 @@ struct ClientData
   /// Unique client identifier. First valid value is 1.
   int ClientId;
 
+  /// Address of the client, as reported by the socket when the connection was accepted
+  std::string ClientAddress;
+
   /// IGTL client socket instance
   igtl::ClientSocket::Pointer ClientSocket;
 
@@ -65,6 +240,22 @@ struct ClientData
   std::pair<bool, bool> DataReceiverActive;
   int DataReceiverThreadId;
 
+  /*! Outgoing messages, only used if the server is configured with ClientSendQueueLength > 0 */
+  std::shared_ptr<ClientSendQueue> SendQueue;
+
+  /*! Send counters if the client has no send queue. Protected by the server's client list mutex. */
+  ClientSendStatistics DirectSendStatistics;
+
+  /*! Adapts the client's VIDEO streams to its send throughput, only used if the server is configured with AdaptiveVideoRate */
+  std::shared_ptr<PlusIgtlVideoRateController> VideoRateController;
+
+  /*! Ring that the client's tracked frame messages are written to, only used if the client negotiated the shared memory transport */
+  std::shared_ptr<PlusIgtlSharedMemoryRing> SharedMemoryRing;
+
+  /// Active flag for the thread that sends the queued messages (first: request, second: respond )
+  std::pair<bool, bool> DataSenderActive;
+  int DataSenderThreadId;
+
   PlusIgtlClientInfo ClientInfo;
 
   vtkPlusOpenIGTLinkServer* Server;
@@ -83,13 +274,70 @@ struct ClientData
   requested image and tracking information in the same format as in the DefaultClientInfo element in the device set
   configuration file.
 
+  By default data is sent to all clients one after the other from a single thread. If ClientSendQueueLength is set to a
+  positive value then each client gets a bounded send queue and its own sender thread, so that a slow client cannot
+  delay the others. When a client's queue is full, ClientSendQueueDropPolicy (DROP_OLDEST, DROP_NEWEST or DISCONNECT)
+  decides what happens with new tracked frames. A client can override the drop policy in its client info
+  (SendQueueDropPolicy attribute). The sender threads write without blocking: while the socket buffer of a client is full its
+  frames wait in the queue, and a client that does not accept any data for DefaultClientSendTimeoutSec is disconnected.
+
+  On Linux, NetworkBackend="EPOLL" replaces the connection receiver, per-client receiver and per-client sender threads
+  by a single epoll event loop with non-blocking sockets (see PlusIgtlEpollReactor). This backend always uses send
+  queues; if ClientSendQueueLength is not set then a default queue length is used.
+
+  TCP options of the client connections (TcpNoDelay, SocketSendBufferSize, SocketReceiveBufferSize, TcpCork,
+  SocketBusyPollUsec) can be set in the PlusOpenIGTLinkServer element (see PlusIgtlSocketOptions). If CoalesceMessages is
+  enabled then all messages of a tracked frame are written to a client with a single system call, instead of one call
+  per message; this reduces the overhead of clients that receive many small messages, such as TRANSFORMs.
+
+  If ScatterGatherImageMessages is enabled then IMAGE messages reference the frame pixels instead of containing a copy
+  of them, and they are written to the socket with a single gather write (see igtl::PlusScatterGatherImageMessage).
+
+  If AdaptiveVideoRate is enabled then the server measures each client's send throughput and queue latency and adapts the
+  encoder bitrate, key frame distance and frame rate of the client's VIDEO streams (see PlusIgtlVideoRateController).
+  The current targets and achieved rates can be queried by the GetVideoRate command. Requires send queues.
+
+  If SharedMemoryTransport is enabled then clients on the same host can request (SharedMemoryTransport attribute in their
+  client info) that tracked frame messages are written into a POSIX shared memory ring (see PlusIgtlSharedMemoryRing)
+  instead of the socket. The socket then only carries small SHMNOTIFY notifications, replies and keep-alive messages.
+  Clients read the ring using vtkPlusIgtlSharedMemoryReceiver. Requires send queues, not available on Windows.
+
+  The server broadcasts the tracked frames of the channel in OutputChannelId. Further channels of the same data collector
+  can be broadcast by adding BroadcastChannel elements (OutputChannelId and SendIntervalSec attributes). If SendIntervalSec
+  is positive then new frames of the channel are only sent that often, otherwise as soon as they are available (the
+  SendIntervalSec attribute of the PlusOpenIGTLinkServer element sets the interval of the OutputChannelId channel).
+  Clients select the channel of each image and video stream with the OutputChannelId attribute of the Image and Video
+  elements in their client info; all other data is sent from the channel in the OutputChannelId attribute of the client
+  info. If these are not set then the data is sent from the server's OutputChannelId channel.
+  The MaxFrameRate and FrameDecimation attributes of the client info limit how many frames of its channel are sent to
+  the client; the same attributes of the Image and Video elements limit a single stream. Skipped frames are not packed.
+
+  If a UdpStream element is present then TRANSFORM, POSITION and TDATA messages are also sent as UDP datagrams to a
+  unicast or multicast address (Address, Port, TimeToLive, InterfaceAddress and MaxDatagramSize attributes), before
+  they are sent to the TCP clients. The transforms are selected the same way as in DefaultClientInfo. Datagrams are
+  numbered in the message ID field of the header, receivers should discard datagrams that are not newer than the last
+  one received (see PlusIgtlUdpSender).
+
+  By default received commands are executed by the thread that calls ProcessPendingCommands(). If
+  NumberOfCommandExecutionThreads is positive then commands are executed by that many worker threads of the command
+  processor instead, so that a long command (such as a volume reconstruction snapshot) does not delay short read-only
+  commands (see vtkPlusCommandProcessor).
+
   \ingroup PlusLibPlusServer
 */
 class vtkPlusServerExport vtkPlusOpenIGTLinkServer: public vtkObject
 {
   typedef std::map<int, std::vector<igtl::MessageBase::Pointer> > ClientIdToMessageListMap;
+  friend class PlusIgtlEpollReactor;
 
 public:
+  /*! Implementation of client connection handling */
+  enum NetworkBackendType
+  {
+    NETWORK_BACKEND_THREADS, ///< Threads for accepting connections and for receiving from each client
+    NETWORK_BACKEND_EPOLL    ///< Single epoll event loop, Linux only
+  };
+
   static vtkPlusOpenIGTLinkServer* New();
   vtkTypeMacro(vtkPlusOpenIGTLinkServer, vtkObject);
   virtual void PrintSelf(ostream& os, vtkIndent indent) VTK_OVERRIDE;
@@ -117,6 +365,10 @@ public:
   vtkSetMacro(MaxTimeSpentWithProcessingMs, double);
   vtkGetMacroConst(MaxTimeSpentWithProcessingMs, double);
 
+  /*! Minimum time between two sends of new frames of the OutputChannelId channel. 0 means as soon as they are available. */
+  vtkSetMacro(SendIntervalSec, double);
+  vtkGetMacroConst(SendIntervalSec, double);
+
   vtkSetMacro(SendValidTransformsOnly, bool);
   vtkGetMacroConst(SendValidTransformsOnly, bool);
 
@@ -126,6 +378,34 @@ public:
   vtkSetMacro(DefaultClientReceiveTimeoutSec, float);
   vtkGetMacroConst(DefaultClientReceiveTimeoutSec, float);
 
+  /*! Maximum number of tracked frames waiting to be sent to each client. If 0 then frames are sent directly, without per-client queues. */
+  vtkSetMacro(ClientSendQueueLength, int);
+  vtkGetMacroConst(ClientSendQueueLength, int);
+
+  /*! Default action when a client's send queue is full */
+  vtkSetMacro(ClientSendQueueDropPolicy, ClientSendQueue::DropPolicyType);
+  vtkGetMacroConst(ClientSendQueueDropPolicy, ClientSendQueue::DropPolicyType);
+
+  /*! Implementation of client connection handling. Takes effect when the server is started. */
+  vtkSetMacro(NetworkBackend, NetworkBackendType);
+  vtkGetMacroConst(NetworkBackend, NetworkBackendType);
+
+  /*! Send IMAGE messages without copying the pixels into the message. Takes effect when the server is started. */
+  vtkSetMacro(ScatterGatherImageMessages, bool);
+  vtkGetMacroConst(ScatterGatherImageMessages, bool);
+
+  /*! Adapt the clients' VIDEO streams to their send throughput. Takes effect for clients that connect afterwards. */
+  vtkSetMacro(AdaptiveVideoRate, bool);
+  vtkGetMacroConst(AdaptiveVideoRate, bool);
+
+  /*! Allow same-host clients to receive tracked frames through shared memory. Takes effect when a client requests it. */
+  vtkSetMacro(SharedMemoryTransport, bool);
+  vtkGetMacroConst(SharedMemoryTransport, bool);
+
+  /*! Number of threads executing the received commands. If 0 then ProcessPendingCommands() executes them. Takes effect when the server is started. */
+  vtkSetMacro(NumberOfCommandExecutionThreads, int);
+  vtkGetMacroConst(NumberOfCommandExecutionThreads, int);
+
   /*! Set data collector instance */
   vtkSetMacro(DataCollector, vtkPlusDataCollector*);
   vtkGetMacroConst(DataCollector, vtkPlusDataCollector*);
@@ -137,11 +417,23 @@ public:
   /*! Get number of connected clients */
   virtual unsigned int GetNumberOfConnectedClients() const;
 
+  /*! Get the IDs of the connected clients */
+  virtual void GetConnectedClientIds(std::vector<unsigned int>& clientIds) const;
+
   /*! Retrieve a COPY of client info for a given clientId
     Locks access to the client info for the duration of the function
     */
   virtual PlusStatus GetClientInfo(unsigned int clientId, PlusIgtlClientInfo& outClientInfo) const;
 
+  /*! Retrieve a COPY of the send statistics of a given client. Clients without a send queue report the counters of the direct send path. Fails if the client does not exist. */
+  virtual PlusStatus GetClientSendStatistics(unsigned int clientId, ClientSendStatistics& outStatistics) const;
+
+  /*! Retrieve a COPY of the adaptive video encoding state of a given client. Fails if the client does not exist or AdaptiveVideoRate is disabled. */
+  virtual PlusStatus GetClientVideoRateStatus(unsigned int clientId, ClientVideoRateStatus& outStatus) const;
+
+  /*! Get the time spent packing the outgoing messages, by message type */
+  void GetMessagePackStatistics(std::map<std::string, vtkPlusIgtlMessageFactory::MessagePackStatistics>& statistics) const;
+
   /*! Start server */
   PlusStatus StartOpenIGTLinkService();
 
@@ -175,6 +467,32 @@ protected:
   /*! Attempt to send any unsent frames to clients, if unsuccessful, accumulate an elapsed time */
   static PlusStatus SendLatestFramesToClients(vtkPlusOpenIGTLinkServer& self, double& elapsedTimeSinceLastPacketSentSec);
 
+  /*! A channel whose tracked frames are sent to the clients */
+  struct BroadcastChannelInfo
+  {
+    BroadcastChannelInfo()
+      : Channel(NULL)
+      , SendIntervalSec(0.0)
+      , LastSentTrackedFrameTimestamp(0.0)
+      , LastProcessingTimePerFrameMs(-1)
+      , LastSendTime(0.0)
+    {
+    }
+    std::string OutputChannelId;
+    vtkPlusChannel* Channel;
+    /*! Minimum time between two sends of new frames, 0 means as soon as they are available. If set then only the latest frame is sent. */
+    double SendIntervalSec;
+    /*! Last sent tracked frame timestamp */
+    double LastSentTrackedFrameTimestamp;
+    /*! Time needed to process one frame in the latest recording round (in milliseconds) */
+    int LastProcessingTimePerFrameMs;
+    /*! System time when new frames of the channel were last sent */
+    double LastSendTime;
+  };
+
+  /*! Send the unsent frames of one channel to the clients, if the send interval of the channel has elapsed */
+  static PlusStatus SendLatestFramesFromChannel(vtkPlusOpenIGTLinkServer& self, BroadcastChannelInfo& channelInfo, int& numberOfSentFrames);
+
   /*! Process the message replies queue and send messages */
   static PlusStatus SendMessageResponses(vtkPlusOpenIGTLinkServer& self);
 
@@ -184,9 +502,75 @@ protected:
   /*! Thread for receiving control data from clients */
   static void* DataReceiverThread(vtkMultiThreader::ThreadInfo* data);
 
+  /*!
+    Handle a message received from a client. The message body must be already received into bodyMessage.
+    \return PLUS_FAIL if no more messages should be received from the client
+  */
+  PlusStatus ProcessClientMessage(ClientData& client, igtl::MessageHeader::Pointer headerMsg, igtl::MessageBase::Pointer bodyMessage, std::deque<uint32_t>& previousCommandIds);
+
+  /*! Thread for sending the contents of one client's send queue */
+  static void* ClientDataSenderThread(vtkMultiThreader::ThreadInfo* data);
+
+  /*!
+    Add messages to the client's send queue, applying the queue's drop policy if the queue is full.
+    droppedCallback is called if the added item is dropped later (or right away, with DROP_NEWEST policy).
+    \return false if the client has to be disconnected
+  */
+  static bool PushToClientSendQueue(ClientSendQueue& sendQueue, const std::vector<igtl::MessageBase::Pointer>& messages, bool droppable,
+                                    const std::function<void()>& droppedCallback = std::function<void()>());
+
+  /*!
+    Get the function to call if tracked frame messages that packingClientId packed for clientInfo are dropped from a send queue.
+    Predicted (DELTA) compressed image streams are made to send a key frame and all transforms are sent again if only changed
+    transforms are sent, as the client cannot reconstruct the current state from the following messages otherwise.
+    Returns an empty function if the messages can be dropped without consequences.
+  */
+  std::function<void()> GetDroppedItemCallback(int packingClientId, const PlusIgtlClientInfo& clientInfo);
+
+  /*!
+    Record that the tracked frame messages sent to clientId were packed by packingClientId. If the client received messages
+    of another packing client before, then the stream state of packingClientId does not match what the client received.
+    In this case resetStreamState (see GetDroppedItemCallback) is called, so that the next packed frame is complete again.
+  */
+  void UpdateClientPackingClient(int clientId, int packingClientId, const std::function<void()>& resetStreamState);
+
   /*! Tracked frame interface, sends the selected message type and data to all clients */
   virtual PlusStatus SendTrackedFrame(igsioTrackedFrame& trackedFrame);
 
+  /*!
+    Send a tracked frame of a broadcast channel. Each client only gets the data that it requested from that channel.
+    If channelId is empty then the channels requested by the clients are ignored.
+  */
+  PlusStatus SendTrackedFrameFromChannel(igsioTrackedFrame& trackedFrame, const std::string& channelId);
+
+  /*!
+    Get the client info of a client restricted to the data that has to be sent from a tracked frame of a broadcast channel,
+    taking the frame rate limits of the client and its streams into account.
+    Returns false if nothing has to be sent to the client from the frame.
+  */
+  bool GetFrameClientInfo(const PlusIgtlClientInfo& clientInfo, const std::string& channelId, double timestamp, PlusIgtlClientInfo& frameClientInfo) const;
+
+  /*! Pack the tracked frame and add the messages to the clients' send queues. The client list is locked only while it is copied. */
+  void QueueTrackedFrameForClients(igsioTrackedFrame& trackedFrame, const std::string& channelId, std::vector<int>& disconnectedClientIds);
+
+  /*! Returns a rate controller for a new client, or an empty pointer if AdaptiveVideoRate is disabled */
+  std::shared_ptr<PlusIgtlVideoRateController> CreateVideoRateController() const;
+
+  /*!
+    Create or remove the client's shared memory ring according to its client info and notify the client.
+    The client list must be locked by the caller.
+  */
+  void UpdateSharedMemoryTransport(ClientData& client);
+
+  /*! Create a packed SHMNOTIFY message for an item of the ring (sequence 0 announces the ring, NULL ring stops the transport) */
+  igtl::MessageBase::Pointer CreateSharedMemoryNotification(const PlusIgtlSharedMemoryRing* ring, uint64_t sequence, int headerVersion);
+
+  /*! Create the socket of the UDP stream, if the stream is configured */
+  void OpenUdpStream();
+
+  /*! Send the tracking data of the frame to the UDP stream */
+  void SendTrackedFrameToUdpStream(igsioTrackedFrame& trackedFrame);
+
   /*! Converts a command response to an OpenIGTLink message that can be sent to the client */
   igtl::MessageBase::Pointer CreateIgtlMessageFromCommandResponse(vtkPlusCommandResponse* response);
 
@@ -196,6 +580,9 @@ protected:
   /*! Stops client's data receiving thread, closes the socket, and removes the client from the client list */
   void DisconnectClient(int clientId);
 
+  /*! Closes the client's socket and removes the client from the client list. The client's threads must be already stopped. */
+  void RemoveClient(int clientId);
+
   /*! Set IGTL CRC check flag (0: disabled, 1: enabled) */
   vtkSetMacro(IgtlMessageCrcCheckEnabled, bool);
   /*! Get IGTL CRC check flag (0: disabled, 1: enabled) */
@@ -276,17 +663,18 @@ private:
   /*! igtl Factory for message sending */
   vtkSmartPointer<vtkPlusIgtlMessageFactory> IgtlMessageFactory;
 
+  /*! Client that packed the last tracked frame messages of each client, see UpdateClientPackingClient */
+  std::map<int, int> ClientPackingClientIds;
+  std::mutex ClientPackingClientIdsMutex;
+
   /*! Mutex instance for accessing client data list */
   vtkSmartPointer<vtkIGSIORecursiveCriticalSection> IgtlClientsMutex;
 
-  /*! Last sent tracked frame timestamp */
-  double LastSentTrackedFrameTimestamp;
-
   /*! Maximum time spent with processing (getting tracked frames, sending messages) per second (in milliseconds) */
   int MaxTimeSpentWithProcessingMs;
 
-  /*! Time needed to process one frame in the latest recording round (in milliseconds) */
-  int LastProcessingTimePerFrameMs;
+  /*! Minimum time between two sends of new frames of the OutputChannelId channel */
+  double SendIntervalSec;
 
   /*! Whether or not the server should send invalid transforms through the IGT Link */
   bool SendValidTransformsOnly;
@@ -300,6 +688,48 @@ private:
   float DefaultClientSendTimeoutSec;
   float DefaultClientReceiveTimeoutSec;
 
+  /*! Maximum number of tracked frames in a client's send queue. 0 means that clients have no send queue. */
+  int ClientSendQueueLength;
+
+  /*! Action when a client's send queue is full, if the client did not specify one */
+  ClientSendQueue::DropPolicyType ClientSendQueueDropPolicy;
+
+  NetworkBackendType NetworkBackend;
+
+  /*! Network core used if NetworkBackend is NETWORK_BACKEND_EPOLL */
+  PlusIgtlEpollReactor* EpollReactor;
+
+  bool ScatterGatherImageMessages;
+
+  /*! TCP options of the client connections and coalesced writes */
+  PlusIgtlSocketOptions SocketOptions;
+
+  /*! Adaptive video encoding settings, see PlusIgtlVideoRateController */
+  bool AdaptiveVideoRate;
+  double AdaptiveVideoMaxSendLagSec;
+  int AdaptiveVideoMaxFrameDecimation;
+  int AdaptiveVideoMinBitrate;
+
+  /*! Shared memory transport settings, see PlusIgtlSharedMemoryRing */
+  bool SharedMemoryTransport;
+  int SharedMemoryNumberOfSlots;
+  int SharedMemorySlotSizeBytes;
+
+  /*! UDP tracking stream settings, read from the UdpStream element. The stream is disabled if UdpStreamPort is not positive. */
+  std::string UdpStreamAddress;
+  int UdpStreamPort;
+  int UdpStreamTimeToLive;
+  std::string UdpStreamInterfaceAddress;
+  int UdpStreamMaxDatagramSize;
+  /*! Message types and transforms sent to the UDP stream */
+  PlusIgtlClientInfo UdpStreamClientInfo;
+
+  /*! Socket of the UDP stream, only used by the data sender thread */
+  std::shared_ptr<PlusIgtlUdpSender> UdpSender;
+
+  /*! Number of command processor threads, commands are executed by ProcessPendingCommands() if 0 */
+  int NumberOfCommandExecutionThreads;
+
   /*! Flag for IGTL CRC check */
   bool IgtlMessageCrcCheckEnabled;
 
@@ -315,8 +745,11 @@ private:
   /*! Channel ID to request the data from */
   std::string OutputChannelId;
 
-  /*! Channel to use for broadcasting */
-  vtkPlusChannel* BroadcastChannel;
+  /*! Further channels to broadcast, as configured in the BroadcastChannel elements */
+  std::vector<BroadcastChannelInfo> AdditionalBroadcastChannels;
+
+  /*! Channels to use for broadcasting, the first one is the OutputChannelId channel. Only accessed by the data sender thread. */
+  std::vector<BroadcastChannelInfo> BroadcastChannels;
 
   bool LogWarningOnNoDataAvailable;
 